@@ -0,0 +1,141 @@
+/// Encryption throughput of the AES implementations, in GB/s.
+///
+/// The benchmark compares:
+///   legacy      AES_encodeMsg(), byte-wise reference cipher in ECB mode
+///   ctr-table   AESCTR on T-tables
+///   ctr-hw      AESCTR on AES-NI / ARMv8, if the CPU has them
+///   ctr-mt      AESCTR on Threads threads, each seek()ing to its part
+///   gcm-table   AESGCM on T-tables and 4 bit GHASH tables
+///   gcm-hw      AESGCM on AES-NI and PCLMULQDQ
+///
+/// Usage: AESBench Size=4194304 Rounds=20 Threads=4
+
+#include <cstdio>
+#include <vector>
+#include <string>
+
+#include <base/Svar/Svar.h>
+#include <base/Time/Timestamp.h>
+#include <base/Thread/Thread.h>
+#include <base/Crypto/AES.h>
+#include <base/Crypto/AESCipher.h>
+
+using namespace std;
+using namespace pi;
+using namespace pi::crypto;
+
+static uint32_t checksum;
+
+static void report(const std::string& name, size_t bytes, int rounds, pi::Timestamp::TimeDiff us)
+{
+    double total = (double) bytes * rounds / 1e9;
+    printf("%-10s %8.3f GB/s\n", name.c_str(), total / (us * 1e-6));
+}
+
+static void benchLegacy(std::vector<uint8_t>& data, int rounds)
+{
+    AES_KEY key(16, 7);
+    AES aes(key);
+    std::vector<uint8_t> out;
+
+    pi::Timestamp start;
+    for (int k = 0; k < rounds; k++)
+    {
+        aes.encode(data, out);
+        checksum += out[0];
+    }
+    report("legacy", data.size(), rounds, start.elapsed());
+}
+
+static void benchCTR(const std::string& name, std::vector<uint8_t>& data, int rounds, AESKernel kernel)
+{
+    uint8_t key[16] = { 7 }, iv[16] = { 1 };
+    AESKey aes(key, 16, kernel);
+
+    pi::Timestamp start;
+    for (int k = 0; k < rounds; k++)
+    {
+        AESCTR ctr(aes, iv);
+        ctr.process(data);
+        checksum += data[0];
+    }
+    report(name, data.size(), rounds, start.elapsed());
+}
+
+struct CTRJob
+{
+    const AESKey*   key;
+    const uint8_t*  iv;
+    uint8_t*        data;
+    size_t          offset;
+    size_t          length;
+
+    void operator()()
+    {
+        AESCTR ctr(*key, iv);
+        ctr.seek(offset);
+        ctr.process(data + offset, length);
+    }
+};
+
+static void benchParallelCTR(std::vector<uint8_t>& data, int rounds, int threads)
+{
+    uint8_t key[16] = { 7 }, iv[16] = { 1 };
+    AESKey aes(key, 16);
+    size_t chunk = (data.size() / threads) & ~(size_t) 15;
+
+    pi::Timestamp start;
+    for (int k = 0; k < rounds; k++)
+    {
+        std::vector<Thread> workers(threads);
+        for (int i = 0; i < threads; i++)
+        {
+            CTRJob job;
+            job.key    = &aes;
+            job.iv     = iv;
+            job.data   = &data[0];
+            job.offset = i*chunk;
+            job.length = (i == threads - 1) ? data.size() - i*chunk : chunk;
+            workers[i].startFunc(job);
+        }
+        for (int i = 0; i < threads; i++) workers[i].join();
+        checksum += data[0];
+    }
+    report("ctr-mt", data.size(), rounds, start.elapsed());
+}
+
+static void benchGCM(const std::string& name, std::vector<uint8_t>& data, int rounds, AESKernel kernel)
+{
+    uint8_t key[16] = { 7 }, iv[12] = { 1 }, tag[16];
+    AESKey aes(key, 16, kernel);
+
+    pi::Timestamp start;
+    for (int k = 0; k < rounds; k++)
+    {
+        AESGCM::seal(aes, iv, 12, "header", 6, &data[0], &data[0], data.size(), tag);
+        checksum += tag[0];
+    }
+    report(name, data.size(), rounds, start.elapsed());
+}
+
+int main(int argc, char** argv)
+{
+    svar.ParseMain(argc, argv);
+    size_t size    = svar.GetInt("Size", 4 << 20);
+    int    rounds  = svar.GetInt("Rounds", 20);
+    int    threads = svar.GetInt("Threads", 4);
+
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) data[i] = (uint8_t) i;
+
+    printf("AES instructions: %s\n", AESKey::hasHardware() ? "yes" : "no");
+    benchLegacy(data, rounds / 10 + 1);
+    benchCTR("ctr-table", data, rounds, AES_KERNEL_TABLE);
+    benchCTR("ctr-hw", data, rounds, AES_KERNEL_HARDWARE);
+    benchParallelCTR(data, rounds, threads);
+    benchGCM("gcm-table", data, rounds, AES_KERNEL_TABLE);
+    benchGCM("gcm-hw", data, rounds, AES_KERNEL_HARDWARE);
+
+    printf("checksum %u\n", checksum);
+    return 0;
+}
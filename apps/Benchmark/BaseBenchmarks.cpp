@@ -0,0 +1,311 @@
+/// Benchmarks of Svar, the data streams, NotificationQueue and the
+/// sharing of read mostly state.
+
+#include <string>
+#include <vector>
+
+#include <base/Svar/Svar.h>
+#include <base/Thread/NotificationQueue.h>
+#include <base/Thread/Mutex.h>
+#include <base/Thread/RcuPtr.h>
+#include <base/Types/SPtr.h>
+#include <base/Types/DataStream.h>
+#include <base/Types/DataStream2.h>
+#include <base/Utils/utils_str.h>
+
+#include "BenchHarness.h"
+
+using namespace std;
+using namespace pi;
+using namespace pi::bench;
+
+
+class SvarBenchmark : public Benchmark
+{
+public:
+    SvarBenchmark() : Benchmark("svar") {}
+
+    void run(BenchContext& ctx)
+    {
+        svar.GetInt("Bench.Value", 1);
+        svar.insert("Bench.String", "value", true);
+        string threads = itos(ctx.threads()) + "t";
+
+        ctx.measure("svar/get/1t", 0, [](uint64_t n) {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < n; i++) sum += svar.GetInt("Bench.Value");
+            BenchContext::keep(sum);
+        });
+
+        // all threads hit the same mutex and map
+        ctx.measure("svar/get/" + threads, 0, [&ctx](uint64_t n) {
+            ctx.parallel(n, [](int, uint64_t count) {
+                uint64_t sum = 0;
+                for (uint64_t i = 0; i < count; i++) sum += svar.GetInt("Bench.Value");
+                BenchContext::keep(sum);
+            });
+        });
+
+        ctx.measure("svar/set/" + threads, 0, [&ctx](uint64_t n) {
+            ctx.parallel(n, [](int index, uint64_t count) {
+                for (uint64_t i = 0; i < count; i++) svar.GetInt("Bench.Value") = (int) (i + index);
+            });
+        });
+
+        ctx.measure("svar/getstring/" + threads, 0, [&ctx](uint64_t n) {
+            ctx.parallel(n, [](int, uint64_t count) {
+                uint64_t sum = 0;
+                for (uint64_t i = 0; i < count; i++) sum += svar.GetString("Bench.String", "").size();
+                BenchContext::keep(sum);
+            });
+        });
+    }
+};
+
+SvarBenchmark SvarBenchmarkInstance;
+
+
+/// A telemetry record like in DataStreamBench.
+struct BenchRecord
+{
+    int64_t             timestamp;
+    double              pose[6];
+    std::string         name;
+    std::vector<float>  points;
+};
+
+class DataStreamBenchmark : public Benchmark
+{
+public:
+    DataStreamBenchmark() : Benchmark("datastream") {}
+
+    void run(BenchContext& ctx)
+    {
+        // one iteration writes or reads 100 records
+        std::vector<BenchRecord> records(100);
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            records[i].timestamp = i;
+            for (int j = 0; j < 6; j++) records[i].pose[j] = i + j * 0.1;
+            records[i].name = "sensor" + itos(i % 16);
+            records[i].points.assign(64, (float) i);
+        }
+
+        RDataStream v1;
+        writeV1(v1, records);
+        RDataStream2 v2;
+        writeV2(v2, records);
+        DataStreamArena arena(1 << 20);
+
+        ctx.measure("datastream/v1/encode", v1.size(), [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                RDataStream ds;
+                writeV1(ds, records);
+                BenchContext::keep(ds.size());
+            }
+        });
+
+        ctx.measure("datastream/v1/decode", v1.size(), [&](uint64_t n) {
+            BenchRecord r;
+            r.points.resize(64);
+            for (uint64_t i = 0; i < n; i++)
+            {
+                RDataStream in(v1.data(), v1.size());
+                for (size_t k = 0; k < records.size(); k++)
+                {
+                    in >> r.timestamp;
+                    for (int j = 0; j < 6; j++) in >> r.pose[j];
+                    in >> r.name;
+                    in.read((uint8_t*) &r.points[0], (int) (r.points.size() * sizeof(float)));
+                }
+                BenchContext::keep(r.timestamp);
+            }
+        });
+
+        ctx.measure("datastream/v2/encode", v2.size(), [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                RDataStream2 ds;
+                writeV2(ds, records);
+                BenchContext::keep(ds.size());
+            }
+        });
+
+        ctx.measure("datastream/v2arena/encode", v2.size(), [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                arena.reset();
+                RDataStream2 ds(&arena);
+                writeV2(ds, records);
+                BenchContext::keep(ds.size());
+            }
+        });
+
+        ctx.measure("datastream/v2/decode", v2.size(), [&](uint64_t n) {
+            BenchRecord r;
+            r.points.resize(64);
+            DataSpan name;
+            for (uint64_t i = 0; i < n; i++)
+            {
+                RDataStream2 in(v2.data(), v2.size());
+                for (size_t k = 0; k < records.size(); k++)
+                {
+                    in >> r.timestamp;
+                    in.readArray(r.pose, 6);
+                    in >> name;
+                    in.readArray(&r.points[0], (uint32_t) r.points.size());
+                }
+                BenchContext::keep(r.timestamp);
+            }
+        });
+    }
+
+    static void writeV1(RDataStream& ds, std::vector<BenchRecord>& records)
+    {
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            BenchRecord& rec = records[i];
+            ds << rec.timestamp;
+            for (int j = 0; j < 6; j++) ds << rec.pose[j];
+            ds << rec.name;
+            ds.write((uint8_t*) &rec.points[0], (uint32_t) (rec.points.size() * sizeof(float)));
+        }
+    }
+
+    static void writeV2(RDataStream2& ds, const std::vector<BenchRecord>& records)
+    {
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const BenchRecord& rec = records[i];
+            ds << rec.timestamp;
+            ds.writeArray(rec.pose, 6);
+            ds << rec.name;
+            ds.writeArray(&rec.points[0], (uint32_t) rec.points.size());
+        }
+        ds.finalize();
+    }
+};
+
+DataStreamBenchmark DataStreamBenchmarkInstance;
+
+
+class NotificationQueueBenchmark : public Benchmark
+{
+public:
+    NotificationQueueBenchmark() : Benchmark("notificationqueue") {}
+
+    void run(BenchContext& ctx)
+    {
+        NotificationQueue queue;
+        string threads = itos(ctx.threads()) + "t";
+
+        ctx.measure("notificationqueue/roundtrip", 0, [&queue](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                queue.enqueueNotification(new Notification);
+                Notification::Ptr p(queue.dequeueNotification());
+            }
+        });
+
+        // producers on worker threads, one consumer
+        ctx.measure("notificationqueue/mpsc/" + threads, 0, [&](uint64_t n) {
+            pi::Thread consumer;
+            consumer.startFunc([&queue, n]() {
+                for (uint64_t i = 0; i < n; i++)
+                    Notification::Ptr p(queue.waitDequeueNotification());
+            });
+            ctx.parallel(n, [&queue](int, uint64_t count) {
+                for (uint64_t i = 0; i < count; i++)
+                    queue.enqueueNotification(new Notification);
+            });
+            consumer.join();
+        });
+    }
+};
+
+NotificationQueueBenchmark NotificationQueueBenchmarkInstance;
+
+
+/// Read mostly state like a configuration or a pose.
+struct BenchState
+{
+    double values[16];
+};
+
+class SharedStateBenchmark : public Benchmark
+{
+public:
+    SharedStateBenchmark() : Benchmark("sharedstate") {}
+
+    void run(BenchContext& ctx)
+    {
+        string threads = itos(ctx.threads()) + "t";
+
+        // the usual pattern: copy the SPtr under a mutex, then read
+        pi::FastMutex     mutex;
+        SPtr<BenchState>  shared(new BenchState());
+        ctx.measure("sharedstate/sptr-mutex/" + threads, 0, [&](uint64_t n) {
+            ctx.parallel(n, [&](int, uint64_t count) {
+                double sum = 0;
+                for (uint64_t i = 0; i < count; i++)
+                {
+                    SPtr<BenchState> p;
+                    {
+                        pi::FastMutex::ScopedLock lock(mutex);
+                        p = shared;
+                    }
+                    sum += p->values[i & 15];
+                }
+                BenchContext::keep((uint64_t) sum);
+            });
+        });
+
+        // the atomic reference count alone
+        ctx.measure("sharedstate/sptr-copy/" + threads, 0, [&](uint64_t n) {
+            ctx.parallel(n, [&](int, uint64_t count) {
+                double sum = 0;
+                for (uint64_t i = 0; i < count; i++)
+                {
+                    SPtr<BenchState> p = shared;
+                    sum += p->values[i & 15];
+                }
+                BenchContext::keep((uint64_t) sum);
+            });
+        });
+
+        RcuPtr<BenchState> rcu(new BenchState());
+        ctx.measure("sharedstate/rcu-read/" + threads, 0, [&](uint64_t n) {
+            ctx.parallel(n, [&](int, uint64_t count) {
+                double sum = 0;
+                for (uint64_t i = 0; i < count; i++)
+                {
+                    RcuPtr<BenchState>::ReadPtr p = rcu.read();
+                    sum += p->values[i & 15];
+                }
+                BenchContext::keep((uint64_t) sum);
+            });
+        });
+
+        // readers while worker 0 publishes a new version every 64 reads
+        ctx.measure("sharedstate/rcu-update/" + threads, 0, [&](uint64_t n) {
+            ctx.parallel(n, [&](int index, uint64_t count) {
+                double sum = 0;
+                for (uint64_t i = 0; i < count; i++)
+                {
+                    if (index == 0 && (i & 63) == 0)
+                    {
+                        rcu.update([i](BenchState& s) { s.values[0] = (double) i; });
+                        continue;
+                    }
+                    RcuPtr<BenchState>::ReadPtr p = rcu.read();
+                    sum += p->values[i & 15];
+                }
+                BenchContext::keep((uint64_t) sum);
+            });
+        });
+        Epoch::synchronize();
+    }
+};
+
+SharedStateBenchmark SharedStateBenchmarkInstance;
@@ -0,0 +1,196 @@
+#include "BenchHarness.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <base/Platform/CPU.h>
+#include <base/PIL_VERSION.h>
+
+
+namespace pi {
+namespace bench {
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+static volatile uint64_t g_sink;
+
+BenchContext::BenchContext(const BenchOptions& options)
+    : _options(options)
+{
+    if (_options.repetitions < 1) _options.repetitions = 1;
+    if (_options.warmup < 0)      _options.warmup = 0;
+    if (_options.threads < 1)     _options.threads = 1;
+}
+
+bool BenchContext::enabled(const std::string& name) const
+{
+    return _options.filter.empty() || name.find(_options.filter) != std::string::npos;
+}
+
+void BenchContext::pinWorker(int index) const
+{
+    if (_options.cpus.empty()) return;
+    pinThread(_options.cpus[(index + 1) % _options.cpus.size()]);
+}
+
+void BenchContext::keep(uint64_t value)
+{
+    g_sink = g_sink + value;
+}
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    // nearest rank
+    size_t rank = (size_t) (p * sorted.size() + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > sorted.size()) rank = sorted.size();
+    return sorted[rank - 1];
+}
+
+void BenchContext::add(const std::string& name, uint64_t iterations, double bytesPerOp,
+                       std::vector<double>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult r;
+    r.name       = name;
+    r.iterations = iterations;
+    r.bytesPerOp = bytesPerOp;
+    r.minNs      = samples.front();
+    r.p50Ns      = percentile(samples, 0.50);
+    r.p90Ns      = percentile(samples, 0.90);
+    r.p99Ns      = percentile(samples, 0.99);
+    r.meanNs     = 0;
+    for (size_t i = 0; i < samples.size(); i++) r.meanNs += samples[i];
+    r.meanNs /= samples.size();
+    _results.push_back(r);
+
+    printf("%-36s %12.1f %12.1f %12.1f %12.1f", name.c_str(), r.minNs, r.p50Ns, r.p90Ns, r.p99Ns);
+    if (bytesPerOp > 0) printf(" %10.1f MB/s", r.mbPerSecond());
+    printf("\n");
+    fflush(stdout);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+Benchmark::Benchmark(const std::string& name)
+    : _name(name)
+{
+    all().push_back(this);
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+std::vector<Benchmark*>& Benchmark::all()
+{
+    static std::vector<Benchmark*> benchmarks;
+    return benchmarks;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+bool pinThread(int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void) cpu;
+    return false;
+#endif
+}
+
+static std::string jsonEscape(const std::string& s)
+{
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '"' || s[i] == '\\') out += '\\';
+        out += s[i];
+    }
+    return out;
+}
+
+void writeJson(const std::string& file, const std::vector<BenchResult>& results)
+{
+    FILE* fp = fopen(file.c_str(), "w");
+    if (!fp)
+    {
+        fprintf(stderr, "Can't write %s\n", file.c_str());
+        return;
+    }
+
+    fprintf(fp, "{\n  \"suite\": \"pil_bench\",\n  \"version\": \"%d.%d.%d\",\n  \"cpu\": \"%s\",\n  \"results\": [\n",
+            PIL_VERSION_MAJOR, PIL_VERSION_MINOR, PIL_VERSION_PATCH, jsonEscape(cpu::describe()).c_str());
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        fprintf(fp, "    {\"name\": \"%s\", \"iterations\": %llu, \"bytes_per_op\": %.0f, "
+                    "\"ns_per_op\": {\"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"mean\": %.3f}, "
+                    "\"mb_per_s\": %.3f}%s\n",
+                jsonEscape(r.name).c_str(), (unsigned long long) r.iterations, r.bytesPerOp,
+                r.minNs, r.p50Ns, r.p90Ns, r.p99Ns, r.meanNs, r.mbPerSecond(),
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+}
+
+int compareBaseline(const std::string& file, const std::vector<BenchResult>& results,
+                    double threshold)
+{
+    std::ifstream in(file.c_str());
+    if (!in) return -1;
+
+    // reads back what writeJson() wrote, one case per line
+    std::map<std::string, double> baseline;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t name = line.find("\"name\": \"");
+        size_t p50  = line.find("\"p50\": ");
+        if (name == std::string::npos || p50 == std::string::npos) continue;
+        name += 9;
+        size_t end = line.find('"', name);
+        if (end == std::string::npos) continue;
+        baseline[line.substr(name, end - name)] = atof(line.c_str() + p50 + 7);
+    }
+
+    int regressions = 0;
+    printf("\n%-36s %12s %12s %9s\n", "compared to baseline", "base p50", "p50", "change");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        std::map<std::string, double>::const_iterator it = baseline.find(results[i].name);
+        if (it == baseline.end() || it->second <= 0) continue;
+
+        double change = results[i].p50Ns / it->second - 1;
+        bool   slower = change > threshold;
+        if (slower) regressions++;
+        printf("%-36s %12.1f %12.1f %+8.1f%%%s\n", results[i].name.c_str(), it->second,
+               results[i].p50Ns, change * 100, slower ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+
+}} // end of namespace pi::bench
@@ -0,0 +1,172 @@
+#ifndef PIL_BENCH_HARNESS_H
+#define PIL_BENCH_HARNESS_H
+
+/// A small harness for reproducible microbenchmarks.
+///
+/// Every benchmark measures one or more cases. A case is an operation
+/// which the harness runs in batches of N iterations: N grows until
+/// a batch takes MinTime, then Warmup batches are discarded and
+/// Repetitions batches are timed. The report gives the time per
+/// iteration as minimum, median, 90th and 99th percentile, and the
+/// throughput at the median.
+///
+/// Results can be written as JSON and compared against an earlier file;
+/// see main.cpp for the options.
+
+#include <stdint.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <base/Thread/Thread.h>
+
+
+namespace pi {
+namespace bench {
+
+
+struct BenchOptions
+{
+    double              minTime;        ///< seconds per timed batch
+    int                 warmup;         ///< discarded batches
+    int                 repetitions;    ///< timed batches
+    int                 threads;        ///< threads of the contention cases
+    std::vector<int>    cpus;           ///< CPUs to pin to, empty for none
+    std::string         filter;         ///< substring of the case names to run
+
+    BenchOptions(): minTime(0.02), warmup(2), repetitions(15), threads(4) {}
+};
+
+
+struct BenchResult
+{
+    std::string name;
+    uint64_t    iterations;     ///< per batch
+    double      bytesPerOp;     ///< 0 if not meaningful
+    double      minNs, p50Ns, p90Ns, p99Ns, meanNs;
+
+    double mbPerSecond() const
+    {
+        return p50Ns > 0 && bytesPerOp > 0 ? bytesPerOp / p50Ns * 1e9 / (1 << 20) : 0;
+    }
+};
+
+
+class BenchContext
+{
+public:
+    BenchContext(const BenchOptions& options);
+
+    const BenchOptions& options() const { return _options; }
+    int threads() const { return _options.threads; }
+
+    bool enabled(const std::string& name) const;
+        /// Returns true if the case passes the filter; benchmarks can skip
+        /// expensive setup otherwise.
+
+    template <class Op>
+    void measure(const std::string& name, double bytesPerOp, Op op)
+        /// Measures a case. op(n) runs n iterations.
+    {
+        if (!enabled(name)) return;
+
+        uint64_t iterations = 1;
+        for (;;)
+        {
+            double t = time(op, iterations);
+            if (t >= _options.minTime || iterations >= (1ULL << 40)) break;
+            // aim a bit above the minimum, at most 16 times more per step
+            double scale = t > 0 ? _options.minTime * 1.2 / t : 16;
+            iterations = (uint64_t) (iterations * (scale < 2 ? 2 : scale > 16 ? 16 : scale));
+        }
+
+        for (int i = 0; i < _options.warmup; i++) time(op, iterations);
+
+        std::vector<double> samples(_options.repetitions);
+        for (int i = 0; i < _options.repetitions; i++)
+            samples[i] = time(op, iterations) * 1e9 / iterations;
+
+        add(name, iterations, bytesPerOp, samples);
+    }
+
+    template <class F>
+    void parallel(uint64_t iterations, F f) const
+        /// Runs f(index, n) on threads() threads, which share the
+        /// iterations. Used by the contention cases.
+    {
+        int n = threads();
+        std::vector<pi::Thread> workers(n);
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t count = iterations / n + (i < (int) (iterations % n) ? 1 : 0);
+            workers[i].startFunc([this, i, count, &f]() {
+                pinWorker(i);
+                f(i, count);
+            });
+        }
+        for (int i = 0; i < n; i++) workers[i].join();
+    }
+
+    void pinWorker(int index) const;
+        /// Pins the calling worker thread of a contention case to the
+        /// CPU after the one of the main thread, if CPUs are given.
+
+    static void keep(uint64_t value);
+        /// Consumes a result so the compiler can not drop its computation.
+
+    const std::vector<BenchResult>& results() const { return _results; }
+
+private:
+    template <class Op>
+    static double time(Op& op, uint64_t iterations)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        op(iterations);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void add(const std::string& name, uint64_t iterations, double bytesPerOp,
+             std::vector<double>& samples);
+
+    BenchOptions                _options;
+    std::vector<BenchResult>    _results;
+};
+
+
+class Benchmark
+    /// Base class of the benchmarks. Like a TestCase, a benchmark
+    /// registers itself through a global instance.
+{
+public:
+    Benchmark(const std::string& name);
+    virtual ~Benchmark();
+
+    const std::string& name() const { return _name; }
+
+    virtual void run(BenchContext& context) = 0;
+
+    static std::vector<Benchmark*>& all();
+
+private:
+    std::string _name;
+};
+
+
+bool pinThread(int cpu);
+    /// Pins the calling thread to a CPU. Returns false if that is not
+    /// supported or fails.
+
+void writeJson(const std::string& file, const std::vector<BenchResult>& results);
+    /// Writes the results, one case per line.
+
+int compareBaseline(const std::string& file, const std::vector<BenchResult>& results,
+                    double threshold);
+    /// Prints the change of the median against a file written by
+    /// writeJson(). Returns the number of cases slower by more than
+    /// threshold (0.1 for 10%), or -1 if the file can not be read.
+
+
+}} // end of namespace pi::bench
+
+#endif // PIL_BENCH_HARNESS_H
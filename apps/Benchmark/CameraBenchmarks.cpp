@@ -0,0 +1,93 @@
+/// Benchmarks of the camera models and the undistortion, built when
+/// pi_cv is available.
+
+#if defined(HAS_PI_CV)
+
+#include <vector>
+
+#include <base/Svar/Svar.h>
+#include <cv/Camera/Camera.h>
+#include <cv/Camera/Undistorter.h>
+
+#include "BenchHarness.h"
+
+using namespace std;
+using namespace pi;
+using namespace pi::bench;
+
+
+class CameraBenchmark : public Benchmark
+{
+public:
+    CameraBenchmark() : Benchmark("camera") {}
+
+    void run(BenchContext& ctx)
+    {
+        // the models of CameraTest
+        svar.ParseLine("Bench.PinHole.CameraType=PinHole");
+        svar.ParseLine("Bench.PinHole.Paraments=[1920 1080 1110 1110 960 540]");
+        svar.ParseLine("Bench.ATAN.CameraType=ATAN");
+        svar.ParseLine("Bench.ATAN.Paraments=[1920 1080 0.418092 0.759142 0.508446 0.493286 -0.838056]");
+        svar.ParseLine("Bench.OpenCV.CameraType=OpenCV");
+        svar.ParseLine("Bench.OpenCV.Paraments=[1920,1080,1123.37,1122.63,983.199,528.513,"
+                       "-0.274764,0.123371,0.000527734,-0.000986113,-0.0362192]");
+
+        const char* models[] = { "PinHole", "ATAN", "OpenCV" };
+        for (int m = 0; m < 3; m++)
+        {
+            Camera camera(string("Bench.") + models[m]);
+            if (!camera.isValid()) continue;
+
+            // one iteration handles 1024 points spread over the image
+            std::vector<Point2d> pixels(1024);
+            std::vector<Point3d> rays(pixels.size());
+            for (size_t i = 0; i < pixels.size(); i++)
+            {
+                pixels[i] = Point2d((i * 37) % camera.width(), (i * 101) % camera.height());
+                rays[i]   = camera.UnProject(pixels[i]);
+            }
+
+            string name = string("camera/") + models[m];
+            ctx.measure(name + "/project/1024", 0, [&](uint64_t n) {
+                double sum = 0;
+                for (uint64_t k = 0; k < n; k++)
+                    for (size_t i = 0; i < rays.size(); i++) sum += camera.Project(rays[i]).x;
+                BenchContext::keep((uint64_t) sum);
+            });
+
+            ctx.measure(name + "/unproject/1024", 0, [&](uint64_t n) {
+                double sum = 0;
+                for (uint64_t k = 0; k < n; k++)
+                    for (size_t i = 0; i < pixels.size(); i++) sum += camera.UnProject(pixels[i]).x;
+                BenchContext::keep((uint64_t) sum);
+            });
+        }
+
+        if (!ctx.enabled("undistort")) return;
+
+        Camera      in("Bench.OpenCV");
+        Camera      out = in.estimateIdealCamera();
+        Undistorter undistorter(in, out);
+        if (!undistorter.prepareReMap()) return;
+
+        cv::Mat image(in.height(), in.width(), CV_8UC3), result;
+        for (int y = 0; y < image.rows; y++)
+            for (int x = 0; x < image.cols * 3; x++)
+                image.ptr<uchar>(y)[x] = (uchar) (x * 7 + y * 13);
+        double bytes = (double) image.total() * image.elemSize();
+
+        ctx.measure("undistort/bilinear/1080p", bytes, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) undistorter.undistort(image, result);
+            BenchContext::keep(result.data[0]);
+        });
+
+        ctx.measure("undistort/fast/1080p", bytes, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) undistorter.undistortFast(image, result);
+            BenchContext::keep(result.data[0]);
+        });
+    }
+};
+
+CameraBenchmark CameraBenchmarkInstance;
+
+#endif // HAS_PI_CV
@@ -0,0 +1,215 @@
+/// Benchmarks of compression, checksums and ciphers.
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <base/Compress/lzfse++.h>
+#include <base/Compress/LZFSEStream.h>
+#include <base/Crypto/AES.h>
+#include <base/Crypto/AESCipher.h>
+#include <base/Crypto/FileIntegrity.h>
+#include <base/Crypto/MD5.h>
+#include <base/Path/Path.h>
+#include <base/Utils/crc.h>
+#include <base/Utils/utils_str.h>
+
+#include "BenchHarness.h"
+
+using namespace std;
+using namespace pi;
+using namespace pi::bench;
+using namespace pi::compress;
+using namespace pi::crypto;
+
+
+/// Compressible data: text with some noise, the same on every run.
+static std::vector<uint8_t> benchData(size_t size)
+{
+    std::vector<uint8_t> data(size);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < size; i++)
+    {
+        seed = seed*1103515245 + 12345;
+        data[i] = (i % 7 == 0) ? (uint8_t) (seed >> 24) : (uint8_t) ('a' + i % 13);
+    }
+    return data;
+}
+
+
+class LZFSEBenchmark : public Benchmark
+{
+public:
+    LZFSEBenchmark() : Benchmark("lzfse") {}
+
+    void run(BenchContext& ctx)
+    {
+        std::vector<uint8_t> data = benchData(1 << 20), packed, out;
+        lzfse_encode(data, packed);
+
+        ctx.measure("lzfse/encode/1M", data.size(), [&](uint64_t n) {
+            std::vector<uint8_t> buf;
+            for (uint64_t i = 0; i < n; i++) lzfse_encode(data, buf);
+            BenchContext::keep(buf.size());
+        });
+
+        ctx.measure("lzfse/decode/1M", data.size(), [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) lzfse_decode(packed, out);
+            BenchContext::keep(out.size());
+        });
+
+        // 256K blocks on the worker threads
+        std::vector<uint8_t> big = benchData(8 << 20), chunked;
+        string threads = itos(ctx.threads()) + "t";
+        lzfse_compress_chunked(big, chunked, 256 << 10, ctx.threads());
+
+        ctx.measure("lzfse/chunked-encode/8M/" + threads, big.size(), [&](uint64_t n) {
+            std::vector<uint8_t> buf;
+            for (uint64_t i = 0; i < n; i++) lzfse_compress_chunked(big, buf, 256 << 10, ctx.threads());
+            BenchContext::keep(buf.size());
+        });
+
+        ctx.measure("lzfse/chunked-decode/8M/" + threads, big.size(), [&](uint64_t n) {
+            std::vector<uint8_t> buf;
+            for (uint64_t i = 0; i < n; i++) lzfse_decompress_chunked(chunked, buf, ctx.threads());
+            BenchContext::keep(buf.size());
+        });
+    }
+};
+
+LZFSEBenchmark LZFSEBenchmarkInstance;
+
+
+class CRC32Benchmark : public Benchmark
+{
+public:
+    CRC32Benchmark() : Benchmark("crc32") {}
+
+    void run(BenchContext& ctx)
+    {
+        std::vector<uint8_t> data = benchData(1 << 20);
+
+        const CRC32Kernel kernels[]     = { CRC32_KERNEL_SLICE8, CRC32_KERNEL_HARDWARE };
+        const char*       kernelNames[] = { "slice8", "hw" };
+        const CRC32Type   types[]       = { CRC32_IEEE, CRC32_CASTAGNOLI };
+        const char*       typeNames[]   = { "crc32", "crc32c" };
+
+        for (int t = 0; t < 2; t++)
+        {
+            for (int k = 0; k < 2; k++)
+            {
+                if (kernels[k] == CRC32_KERNEL_HARDWARE && !crc32_hasHardware(types[t])) continue;
+
+                CRC32Type   type   = types[t];
+                CRC32Kernel kernel = kernels[k];
+                ctx.measure(string(typeNames[t]) + "/" + kernelNames[k] + "/1M", data.size(), [&](uint64_t n) {
+                    uint32_t crc = 0;
+                    for (uint64_t i = 0; i < n; i++) crc = crc32_update(crc, &data[0], data.size(), type, kernel);
+                    BenchContext::keep(crc);
+                });
+            }
+        }
+    }
+};
+
+CRC32Benchmark CRC32BenchmarkInstance;
+
+
+class AESBenchmark : public Benchmark
+{
+public:
+    AESBenchmark() : Benchmark("aes") {}
+
+    void run(BenchContext& ctx)
+    {
+        std::vector<uint8_t> key(16), iv(16, 7);
+        for (int i = 0; i < 16; i++) key[i] = (uint8_t) i;
+        std::vector<uint8_t> data = benchData(1 << 20);
+
+        AESKey table(&key[0], key.size(), AES_KERNEL_TABLE);
+        AESKey aes(&key[0], key.size());
+
+        ctx.measure("aes/ctr-table/1M", data.size(), [&](uint64_t n) {
+            AESCTR ctr(table, &iv[0]);
+            for (uint64_t i = 0; i < n; i++) ctr.process(data);
+            BenchContext::keep(data[0]);
+        });
+
+        if (aes.hardware())
+        {
+            ctx.measure("aes/ctr-hw/1M", data.size(), [&](uint64_t n) {
+                AESCTR ctr(aes, &iv[0]);
+                for (uint64_t i = 0; i < n; i++) ctr.process(data);
+                BenchContext::keep(data[0]);
+            });
+        }
+
+        ctx.measure(string("aes/gcm-") + (aes.hardware() ? "hw" : "table") + "/1M", data.size(), [&](uint64_t n) {
+            uint8_t tag[16];
+            for (uint64_t i = 0; i < n; i++)
+                AESGCM::seal(aes, &iv[0], 12, 0, 0, &data[0], &data[0], data.size(), tag);
+            BenchContext::keep(tag[0]);
+        });
+
+        // the legacy ECB functions are slow, a smaller buffer will do
+        std::vector<uint8_t> small(data.begin(), data.begin() + (16 << 10)), out;
+        AES legacy(key);
+        ctx.measure("aes/legacy-ecb/16K", small.size(), [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) legacy.encode(small, out);
+            BenchContext::keep(out[0]);
+        });
+    }
+};
+
+AESBenchmark AESBenchmarkInstance;
+
+
+class MD5Benchmark : public Benchmark
+{
+public:
+    MD5Benchmark() : Benchmark("md5") {}
+
+    void run(BenchContext& ctx)
+    {
+        std::vector<uint8_t> data = benchData(1 << 20);
+
+        ctx.measure("md5/data/1M", data.size(), [&](uint64_t n) {
+            MD5Engine md5;
+            uint8_t   digest[16];
+            for (uint64_t i = 0; i < n; i++)
+            {
+                md5.update(&data[0], data.size());
+                md5.finish(digest);
+            }
+            BenchContext::keep(digest[0]);
+        });
+
+        if (!ctx.enabled("md5/file") && !ctx.enabled("md5/tree")) return;
+
+        // files in the page cache, so the hashing is measured, not the disk
+        std::string file = Path::temp() + "pil_bench_md5.tmp";
+        std::vector<uint8_t> big = benchData(32 << 20);
+        FILE* fp = fopen(file.c_str(), "wb");
+        if (!fp) return;
+        fwrite(&big[0], 1, big.size(), fp);
+        fclose(fp);
+
+        ctx.measure("md5/file/32M", big.size(), [&](uint64_t n) {
+            std::vector<uint8_t> digest;
+            for (uint64_t i = 0; i < n; i++) md5_file(file, digest);
+            BenchContext::keep(digest[0]);
+        });
+
+        ctx.measure("md5/tree/32M/" + itos(ctx.threads()) + "t", big.size(), [&](uint64_t n) {
+            std::vector<uint8_t> digest;
+            for (uint64_t i = 0; i < n; i++) md5_file_tree(file, digest, 4 << 20, ctx.threads());
+            BenchContext::keep(digest[0]);
+        });
+
+        unlink(file.c_str());
+    }
+};
+
+MD5Benchmark MD5BenchmarkInstance;
@@ -0,0 +1,329 @@
+/// Benchmarks of the PLY and OBJ readers and writers and of the mesh
+/// processing of MeshInterleaved on large meshes, built when pi_gui is
+/// available.
+
+#if defined(HAS_PI_GUI)
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <base/Path/Path.h>
+#include <gui/gl/ply/PlyIO.h>
+#include <gui/gl/obj/ObjIO.h>
+#include <gui/gl/MeshInterleaved.h>
+
+#include "BenchHarness.h"
+
+using namespace std;
+using namespace pi;
+using namespace pi::bench;
+using pi::gl::MeshInterleaved;
+
+
+class PlyBenchmark : public Benchmark
+{
+public:
+    PlyBenchmark() : Benchmark("ply") {}
+
+    struct Vertex
+    {
+        float   x, y, z;
+        float   nx, ny, nz;
+        uint8_t r, g, b, a;
+    };
+
+    void run(BenchContext& ctx)
+    {
+        // a 1024 x 1024 grid, one million vertices and two million triangles
+        const uint32_t side = 1024;
+        std::vector<Vertex>   vertices(side * side);
+        std::vector<uint32_t> faces;
+        faces.reserve((side - 1) * (side - 1) * 6);
+        for (uint32_t y = 0; y < side; y++)
+            for (uint32_t x = 0; x < side; x++)
+            {
+                Vertex& v = vertices[y * side + x];
+                v.x = (float) x; v.y = (float) y; v.z = (float) ((x * 7 + y * 13) % 17);
+                v.nx = 0; v.ny = 0; v.nz = 1;
+                v.r = (uint8_t) x; v.g = (uint8_t) y; v.b = 128; v.a = 255;
+                if (x + 1 == side || y + 1 == side) continue;
+                uint32_t i = y * side + x;
+                uint32_t quad[6] = { i, i + 1, i + side, i + 1, i + side + 1, i + side };
+                faces.insert(faces.end(), quad, quad + 6);
+            }
+
+        string file = Path::temp() + "pil_bench_mesh.ply";
+        write(file, vertices, faces);
+        double bytes = (double) (vertices.size() * 27 + faces.size() / 3 * 13);
+
+        ctx.measure("ply/write/PlyWriter/1M", bytes, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) write(file, vertices, faces);
+        });
+
+        ctx.measure("ply/write/tinyply/1M", bytes, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                std::vector<float>    xyz(vertices.size() * 3);
+                std::vector<uint32_t> tris(faces);
+                for (size_t v = 0; v < vertices.size(); v++)
+                {
+                    xyz[v*3] = vertices[v].x; xyz[v*3+1] = vertices[v].y; xyz[v*3+2] = vertices[v].z;
+                }
+                PlyFile ply;
+                ply.add_properties_to_element("vertex", {"x", "y", "z"}, xyz);
+                ply.add_properties_to_element("face", {"vertex_indices"}, tris, 3, PlyProperty::Type::UINT8);
+                std::ostringstream os;
+                ply.write(os, true);
+                std::ofstream out(file.c_str(), std::ios::binary);
+                out << os.str();
+            }
+            write(file, vertices, faces);
+        });
+
+        std::vector<Vertex>   readVertices(vertices.size());
+        std::vector<uint32_t> readFaces;
+
+        ctx.measure("ply/read/PlyReader/1M", bytes, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                PlyReader ply(file, ctx.threads());
+                ply.read("vertex", {"x", "y", "z"}, &readVertices[0].x, PlyProperty::Type::FLOAT32, sizeof(Vertex));
+                ply.read("vertex", {"nx", "ny", "nz"}, &readVertices[0].nx, PlyProperty::Type::FLOAT32, sizeof(Vertex));
+                ply.read("vertex", {"red", "green", "blue"}, &readVertices[0].r, PlyProperty::Type::UINT8, sizeof(Vertex));
+                ply.readList("face", "vertex_indices", readFaces);
+            }
+            BenchContext::keep(readFaces.back());
+        });
+
+        ctx.measure("ply/read/tinyply/1M", bytes, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                std::ifstream         is(file.c_str(), std::ios::binary);
+                PlyFile               ply(is);
+                std::vector<float>    xyz, normals;
+                std::vector<uint8_t>  colors;
+                ply.request_properties_from_element("vertex", {"x", "y", "z"}, xyz);
+                ply.request_properties_from_element("vertex", {"nx", "ny", "nz"}, normals);
+                ply.request_properties_from_element("vertex", {"red", "green", "blue"}, colors);
+                ply.request_properties_from_element("face", {"vertex_indices"}, readFaces, 3);
+                ply.read(is);
+            }
+            BenchContext::keep(readFaces.back());
+        });
+
+        unlink(file.c_str());
+    }
+
+    static void write(const string& file, const std::vector<Vertex>& v, const std::vector<uint32_t>& faces)
+    {
+        PlyWriter ply(file);
+        ply.addElement("vertex", v.size());
+        ply.addProperties({"x", "y", "z"}, PlyProperty::Type::FLOAT32, &v[0].x, sizeof(Vertex));
+        ply.addProperties({"nx", "ny", "nz"}, PlyProperty::Type::FLOAT32, &v[0].nx, sizeof(Vertex));
+        ply.addProperties({"red", "green", "blue"}, PlyProperty::Type::UINT8, &v[0].r, sizeof(Vertex));
+        ply.addElement("face", faces.size() / 3);
+        ply.addList("vertex_indices", PlyProperty::Type::UINT8, PlyProperty::Type::UINT32, &faces[0], 3);
+        ply.write();
+    }
+};
+
+PlyBenchmark PlyBenchmarkInstance;
+
+
+class ObjBenchmark : public Benchmark
+{
+public:
+    ObjBenchmark() : Benchmark("obj") {}
+
+    void run(BenchContext& ctx)
+    {
+        // a textured 1024 x 1024 grid, two million triangles
+        const uint32_t side = 1024;
+        std::vector<float> xyz(side * side * 3), uv(side * side * 2);
+        for (uint32_t i = 0; i < side * side; i++)
+        {
+            xyz[i*3]   = (i % side) * 0.001f;
+            xyz[i*3+1] = (i / side) * 0.001f;
+            xyz[i*3+2] = ((i * 7) % 17) * 0.01f;
+            uv[i*2]    = (i % side) / (float) side;
+            uv[i*2+1]  = (i / side) / (float) side;
+        }
+
+        string file = Path::temp() + "pil_bench_mesh.obj";
+        auto write = [&]() {
+            ObjWriter obj(file);
+            for (uint32_t i = 0; i < side * side; i++) obj.vertex(xyz[i*3], xyz[i*3+1], xyz[i*3+2]);
+            for (uint32_t i = 0; i < side * side; i++) obj.texcoord(uv[i*2], uv[i*2+1]);
+            for (uint32_t y = 0; y + 1 < side; y++)
+                for (uint32_t x = 0; x + 1 < side; x++)
+                {
+                    unsigned int v[4] = { y * side + x, y * side + x + 1, (y + 1) * side + x + 1, (y + 1) * side + x };
+                    obj.face(v, v, 0, 4);
+                }
+            obj.close();
+        };
+        write();
+
+        std::ifstream in(file.c_str(), std::ios::binary | std::ios::ate);
+        double bytes = (double) in.tellg();
+        in.close();
+
+        ctx.measure("obj/write/ObjWriter/1M", bytes, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) write();
+        });
+
+        ctx.measure("obj/write/fstream/1M", bytes, [&](uint64_t n) {
+            // the way writeOBJ wrote before
+            for (uint64_t i = 0; i < n; i++)
+            {
+                std::fstream out(file.c_str(), std::ios::out);
+                for (uint32_t v = 0; v < side * side; v++)
+                    out << "\nv " << xyz[v*3] << " " << xyz[v*3+1] << " " << xyz[v*3+2];
+                for (uint32_t v = 0; v < side * side; v++)
+                    out << "\nvt " << uv[v*2] << " " << uv[v*2+1];
+                for (uint32_t y = 0; y + 1 < side; y++)
+                    for (uint32_t x = 0; x + 1 < side; x++)
+                    {
+                        uint32_t v[4] = { y * side + x + 1, y * side + x + 2, (y + 1) * side + x + 2, (y + 1) * side + x + 1 };
+                        out << "\nf";
+                        for (int j = 0; j < 4; j++) out << " " << v[j] << "/" << v[j];
+                    }
+            }
+            write();
+        });
+
+        ctx.measure("obj/read/ObjReader/1M", bytes, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                ObjReader obj(file, ctx.threads());
+                BenchContext::keep(obj.indices().back());
+            }
+        });
+
+        unlink(file.c_str());
+    }
+};
+
+ObjBenchmark ObjBenchmarkInstance;
+
+class MeshProcessingBenchmark : public Benchmark
+{
+public:
+    MeshProcessingBenchmark() : Benchmark("meshops") {}
+
+    void run(BenchContext& ctx)
+    {
+        // wavy grids read back from PLY files; every iteration works on a
+        // fresh copy, whose cost is included
+        MeshInterleaved large, medium, soup;
+        load(large, 1024);
+        load(medium, 512);
+        for (size_t k = 0; k < medium.faces.size(); k++)
+        {
+            soup.vertices.push_back(medium.vertices[medium.faces[k]]);
+            soup.faces.push_back((unsigned int) k);
+        }
+        int threads = ctx.threads();
+
+        std::vector<const MeshInterleaved*> parts(8, &medium);
+        ctx.measure("meshops/merge/push_back/8x256k", 0, [&](uint64_t n) {
+            // the way operator+= appended before
+            for (uint64_t i = 0; i < n; i++)
+            {
+                MeshInterleaved merged;
+                for (size_t p = 0; p < parts.size(); p++)
+                {
+                    unsigned int offset = merged.vertices.size();
+                    for (size_t v = 0; v < parts[p]->vertices.size(); v++) merged.vertices.push_back(parts[p]->vertices[v]);
+                    for (size_t v = 0; v < parts[p]->colors.size(); v++) merged.colors.push_back(parts[p]->colors[v]);
+                    for (size_t f = 0; f < parts[p]->faces.size(); f++) merged.faces.push_back(parts[p]->faces[f] + offset);
+                }
+                BenchContext::keep(merged.faces.back());
+            }
+        });
+        ctx.measure("meshops/merge/merge/8x256k", 0, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                MeshInterleaved merged;
+                merged.merge(parts, threads);
+                BenchContext::keep(merged.faces.back());
+            }
+        });
+
+        ctx.measure("meshops/weld/soup/1.5M", 0, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                MeshInterleaved mesh(soup);
+                BenchContext::keep(mesh.weldVertices(1e-4f, threads));
+            }
+        });
+
+        ctx.measure("meshops/normals/2M", 0, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                MeshInterleaved mesh(large);
+                mesh.computeNormals(threads);
+                BenchContext::keep(mesh.normals.back().x);
+            }
+        });
+
+        ctx.measure("meshops/decimate/512k->50k", 0, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                MeshInterleaved mesh(medium);
+                BenchContext::keep(mesh.decimate(50000, 1e30f, threads));
+            }
+        });
+
+        // triangles in random order, as from a triangle soup
+        MeshInterleaved shuffled(large);
+        srand(1);
+        for (size_t t = shuffled.faces.size() / 3 - 1; t > 0; t--)
+        {
+            size_t o = rand() % (t + 1);
+            for (int j = 0; j < 3; j++) std::swap(shuffled.faces[t * 3 + j], shuffled.faces[o * 3 + j]);
+        }
+        ctx.measure("meshops/vertexcache/2M", 0, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                MeshInterleaved mesh(shuffled);
+                mesh.optimizeVertexCache(32);
+                BenchContext::keep(mesh.faces.back());
+            }
+        });
+    }
+
+    static void load(MeshInterleaved& mesh, uint32_t side)
+    {
+        std::vector<PlyBenchmark::Vertex> vertices(side * side);
+        std::vector<uint32_t>             faces;
+        for (uint32_t y = 0; y < side; y++)
+            for (uint32_t x = 0; x < side; x++)
+            {
+                PlyBenchmark::Vertex& v = vertices[y * side + x];
+                v.x = (float) x; v.y = (float) y; v.z = sinf(x * 0.05f) * cosf(y * 0.07f) * 8;
+                v.nx = 0; v.ny = 0; v.nz = 1;
+                v.r = (uint8_t) x; v.g = (uint8_t) y; v.b = 128; v.a = 255;
+                if (x + 1 == side || y + 1 == side) continue;
+                uint32_t i = y * side + x;
+                uint32_t quad[6] = { i, i + 1, i + side, i + 1, i + side + 1, i + side };
+                faces.insert(faces.end(), quad, quad + 6);
+            }
+        string file = Path::temp() + "pil_bench_meshops.ply";
+        PlyBenchmark::write(file, vertices, faces);
+        mesh.loadPLY(file);
+        mesh.normals.clear();
+        unlink(file.c_str());
+    }
+};
+
+MeshProcessingBenchmark MeshProcessingBenchmarkInstance;
+
+#endif // HAS_PI_GUI
@@ -0,0 +1,111 @@
+/// Benchmarks of TCP sockets on the loopback interface.
+
+#include <vector>
+
+#include <base/Thread/Event.h>
+#include <base/Thread/Mutex.h>
+#include <base/Thread/Thread.h>
+#include <network/ServerSocket.h>
+#include <network/StreamSocket.h>
+#include <network/SocketAddress.h>
+
+#include "BenchHarness.h"
+
+using namespace std;
+using namespace pi;
+using namespace pi::bench;
+
+
+class SocketBenchmark : public Benchmark
+{
+public:
+    SocketBenchmark() : Benchmark("socket") {}
+
+    void run(BenchContext& ctx)
+    {
+        if (ctx.enabled("socket/pingpong")) pingPong(ctx);
+        if (ctx.enabled("socket/stream"))   stream(ctx);
+    }
+
+    /// Latency: the peer echoes every 64 byte message.
+    static void pingPong(BenchContext& ctx)
+    {
+        ServerSocket server(SocketAddress("127.0.0.1", 0));
+        StreamSocket client(SocketAddress("127.0.0.1", server.address().port()));
+        StreamSocket peer = server.acceptConnection();
+        client.setNoDelay(true);
+        peer.setNoDelay(true);
+
+        pi::Thread echo;
+        echo.startFunc([&peer]() {
+            char buf[64];
+            int  n;
+            while ((n = peer.receiveBytes(buf, sizeof(buf))) > 0)
+                peer.sendBytes(buf, n);
+        });
+
+        char msg[64] = { 0 };
+        ctx.measure("socket/pingpong/64B", 0, [&](uint64_t n) {
+            char reply[64];
+            for (uint64_t i = 0; i < n; i++)
+            {
+                client.sendBytes(msg, sizeof(msg));
+                int got = 0;
+                while (got < (int) sizeof(reply))
+                {
+                    int r = client.receiveBytes(reply + got, sizeof(reply) - got);
+                    if (r <= 0) return;
+                    got += r;
+                }
+            }
+        });
+
+        client.shutdownSend();
+        echo.join();
+    }
+
+    /// Throughput: 64K messages to a peer which only receives. A batch
+    /// ends when the peer has received all its bytes.
+    static void stream(BenchContext& ctx)
+    {
+        ServerSocket server(SocketAddress("127.0.0.1", 0));
+        StreamSocket client(SocketAddress("127.0.0.1", server.address().port()));
+        StreamSocket peer = server.acceptConnection();
+
+        pi::FastMutex mutex;
+        pi::Event     reached;
+        pi::Int64     received = 0, target = -1;
+
+        pi::Thread drain;
+        drain.startFunc([&]() {
+            std::vector<char> buf(1 << 20);
+            int n;
+            while ((n = peer.receiveBytes(&buf[0], (int) buf.size())) > 0)
+            {
+                pi::FastMutex::ScopedLock lock(mutex);
+                received += n;
+                if (target >= 0 && received >= target)
+                {
+                    target = -1;
+                    reached.set();
+                }
+            }
+        });
+
+        std::vector<char> msg(64 << 10, 'p');
+        ctx.measure("socket/stream/64K", msg.size(), [&](uint64_t n) {
+            {
+                pi::FastMutex::ScopedLock lock(mutex);
+                target = received + (pi::Int64) (n * msg.size());
+            }
+            for (uint64_t i = 0; i < n; i++)
+                client.sendBytes(&msg[0], (int) msg.size());
+            reached.wait();
+        });
+
+        client.shutdownSend();
+        drain.join();
+    }
+};
+
+SocketBenchmark SocketBenchmarkInstance;
@@ -0,0 +1,101 @@
+/// Benchmarks of drawing a scene with OffscreenRenderer, built when pi_gui
+/// has EGL, so they run without a display or a GPU.
+
+#if defined(HAS_PI_GUI) && defined(HAS_EGL)
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include <gui/gl/GL_FatherObject.h>
+#include <gui/gl/MeshInterleaved.h>
+#include <gui/gl/OffscreenRenderer.h>
+
+#include "BenchHarness.h"
+
+using namespace std;
+using namespace pi;
+using namespace pi::bench;
+using namespace pi::gl;
+
+
+class DiscardingSink : public OffscreenRenderer::FrameSink
+{
+public:
+    virtual void write(const OffscreenRenderer::Frame& frame)
+    {
+        BenchContext::keep(frame.pixels[frame.pixels.size() / 2]);
+    }
+};
+
+
+class RenderBenchmark : public Benchmark
+{
+public:
+    RenderBenchmark() : Benchmark("render") {}
+
+    void run(BenchContext& ctx)
+    {
+        const int width = 640, height = 480;
+        if (!ctx.enabled("render/frame/pbo/640x480") && !ctx.enabled("render/frame/sync/640x480")) return;
+
+        OffscreenRenderer renderer(width, height);
+
+        // 16 x 16 wavy tiles of 64 x 64 vertices, half a million triangles,
+        // seen from above one corner
+        Father_Object scene;
+        for (int t = 0; t < 256; t++)
+        {
+            SPtr<MeshInterleaved> mesh(new MeshInterleaved);
+            mesh->_displayMode = MeshInterleaved::MeshMode;
+            for (int y = 0; y < 64; y++)
+                for (int x = 0; x < 64; x++)
+                {
+                    float wx = (t % 16) * 63 + x, wy = (t / 16) * 63 + y;
+                    mesh->vertices.push_back(Vertex3f(wx, wy, sinf(wx * 0.05f) * cosf(wy * 0.07f) * 8));
+                    mesh->colors.push_back(Color3b(x * 4, y * 4, t));
+                    if (!x || !y) continue;
+                    unsigned int a = (y - 1) * 64 + x - 1, b = a + 1, c = y * 64 + x, d = c - 1;
+                    unsigned int f[6] = { a, b, c, a, c, d };
+                    mesh->faces.insert(mesh->faces.end(), f, f + 6);
+                }
+            scene.insert(mesh);
+        }
+        SE3f pose(SO3f::exp(Point3f(1.0f, 0, 0)) * SO3f::exp(Point3f(0, 0, -0.7f)), Point3f(-100, -100, 300));
+        DiscardingSink sink;
+        renderer.setCamera(500, 500, width / 2, height / 2);
+        renderer.setClipping(1, 5000);
+        renderer.setPose(pose);
+        renderer.setSink(&sink);
+
+        // the readback of a frame overlaps drawing the next ones
+        ctx.measure("render/frame/pbo/640x480", width * height * 3, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) renderer.render(scene);
+            renderer.finish();
+        });
+        report("pbo", renderer.stats());
+
+        // every frame waited for, as with a plain glReadPixels
+        renderer.resetStats();
+        ctx.measure("render/frame/sync/640x480", width * height * 3, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                renderer.render(scene);
+                renderer.finish();
+            }
+        });
+        report("sync", renderer.stats());
+    }
+
+    static void report(const char* name, const OffscreenRenderer::Stats& stats)
+    {
+        printf("render/%s: %d frames, draw %.2f ms (max %.2f), gpu %.2f ms (max %.2f), readback %.2f ms (max %.2f)\n",
+               name, (int) stats.delivered, stats.meanDrawMs, stats.maxDrawMs,
+               stats.meanGpuMs, stats.maxGpuMs, stats.meanReadMs, stats.maxReadMs);
+    }
+};
+
+RenderBenchmark RenderBenchmarkInstance;
+
+#endif // HAS_PI_GUI && HAS_EGL
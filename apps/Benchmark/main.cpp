@@ -0,0 +1,98 @@
+/// pil_bench: microbenchmarks of the hot paths of PIL.
+///
+/// Usage: pil_bench [Filter=crc] [List=1] [MinTime=0.02] [Warmup=2]
+///                  [Repetitions=15] [Threads=4] [Cpus=2,3,4,5]
+///                  [Json=result.json] [Baseline=old.json] [Threshold=0.1]
+///
+///   Filter        run only the cases whose name contains this string
+///   List          print the benchmarks and exit
+///   MinTime       seconds per timed batch
+///   Warmup        batches run before timing
+///   Repetitions   timed batches, the percentiles are taken over them
+///   Threads       threads of the contention and parallel cases
+///   Cpus          pin the main thread to the first CPU and the workers
+///                 to the others, for repeatable numbers
+///   Json          write the results to this file
+///   Baseline      compare the medians with an earlier Json file; the
+///                 exit code is 2 if a case got slower by more than
+///                 Threshold
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include <base/Svar/Svar.h>
+#include <base/Platform/CPU.h>
+
+#include "BenchHarness.h"
+
+using namespace std;
+using namespace pi;
+using namespace pi::bench;
+
+
+static std::vector<int> parseCpus(const std::string& list)
+{
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size())
+    {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        if (end > pos) cpus.push_back(atoi(list.substr(pos, end - pos).c_str()));
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+int main(int argc, char** argv)
+{
+    svar.ParseMain(argc, argv);
+
+    BenchOptions options;
+    options.filter      = svar.GetString("Filter", "");
+    options.minTime     = svar.GetDouble("MinTime", 0.02);
+    options.warmup      = svar.GetInt("Warmup", 2);
+    options.repetitions = svar.GetInt("Repetitions", 15);
+    options.threads     = svar.GetInt("Threads", 4);
+    options.cpus        = parseCpus(svar.GetString("Cpus", ""));
+
+    std::string json      = svar.GetString("Json", "");
+    std::string baseline  = svar.GetString("Baseline", "");
+    double      threshold = svar.GetDouble("Threshold", 0.1);
+
+    std::vector<Benchmark*>& benchmarks = Benchmark::all();
+    if (svar.GetInt("List", 0))
+    {
+        for (size_t i = 0; i < benchmarks.size(); i++)
+            printf("%s\n", benchmarks[i]->name().c_str());
+        return 0;
+    }
+
+    if (!options.cpus.empty() && !pinThread(options.cpus[0]))
+        fprintf(stderr, "Can't pin to CPU %d\n", options.cpus[0]);
+
+    printf("CPU %s\n", cpu::describe().c_str());
+    printf("%-36s %12s %12s %12s %12s  (ns per iteration)\n", "case", "min", "p50", "p90", "p99");
+
+    BenchContext context(options);
+    for (size_t i = 0; i < benchmarks.size(); i++)
+        benchmarks[i]->run(context);
+
+    if (!json.empty()) writeJson(json, context.results());
+
+    if (!baseline.empty())
+    {
+        int regressions = compareBaseline(baseline, context.results(), threshold);
+        if (regressions < 0)
+        {
+            fprintf(stderr, "Can't read baseline %s\n", baseline.c_str());
+            return 1;
+        }
+        if (regressions > 0) return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/// Serialization throughput of RDataStream and RDataStream2.
+///
+/// Each round serializes Records telemetry records, a timestamp, a
+/// pose, a name and a block of Points floats, into a fresh stream and
+/// reads them back. The benchmark compares:
+///   v1        RDataStream
+///   v2        RDataStream2 with the heap allocator
+///   v2arena   RDataStream2 with a DataStreamArena reset every round
+///
+/// Usage: DataStreamBench Records=1000 Points=64 Rounds=2000
+
+#include <cstdio>
+#include <vector>
+#include <string>
+
+#include <base/Svar/Svar.h>
+#include <base/Utils/utils_str.h>
+#include <base/Time/Timestamp.h>
+#include <base/Types/DataStream.h>
+#include <base/Types/DataStream2.h>
+
+using namespace std;
+using namespace pi;
+
+struct Record
+{
+    int64_t             timestamp;
+    double              pose[6];
+    std::string         name;
+    std::vector<float>  points;
+};
+
+static double checksum;
+
+static void report(const std::string& name, size_t bytes, int rounds, pi::Timestamp::TimeDiff writeUs, pi::Timestamp::TimeDiff readUs)
+{
+    double total = (double) bytes * rounds / (1 << 20);
+    printf("%-8s write %8.1f MB/s  read %8.1f MB/s  (%lu bytes per round)\n", name.c_str(),
+           total / (writeUs * 1e-6), total / (readUs * 1e-6), (unsigned long) bytes);
+}
+
+static void benchV1(const std::vector<Record>& records, int rounds)
+{
+    pi::Timestamp::TimeDiff writeUs = 0, readUs = 0;
+    size_t bytes = 0;
+    Record r;
+    r.points.resize(records[0].points.size());
+
+    for (int k = 0; k < rounds; k++)
+    {
+        pi::Timestamp start;
+        RDataStream ds;
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            Record& rec = const_cast<Record&>(records[i]);
+            ds << rec.timestamp;
+            for (int j = 0; j < 6; j++) ds << rec.pose[j];
+            ds << rec.name;
+            ds.write((uint8_t*) &rec.points[0], (uint32_t) (rec.points.size() * sizeof(float)));
+        }
+        writeUs += start.elapsed();
+        bytes = ds.size();
+
+        start.update();
+        RDataStream in(ds.data(), ds.size());
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            in >> r.timestamp;
+            for (int j = 0; j < 6; j++) in >> r.pose[j];
+            in >> r.name;
+            in.read((uint8_t*) &r.points[0], (int) (r.points.size() * sizeof(float)));
+            checksum += r.pose[0];
+        }
+        readUs += start.elapsed();
+    }
+    report("v1", bytes, rounds, writeUs, readUs);
+}
+
+static void benchV2(const std::vector<Record>& records, int rounds, DataStreamArena* arena)
+{
+    pi::Timestamp::TimeDiff writeUs = 0, readUs = 0;
+    size_t bytes = 0;
+    Record r;
+    r.points.resize(records[0].points.size());
+
+    for (int k = 0; k < rounds; k++)
+    {
+        if (arena) arena->reset();
+
+        pi::Timestamp start;
+        RDataStream2 ds(arena);
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const Record& rec = records[i];
+            ds << rec.timestamp;
+            ds.writeArray(rec.pose, 6);
+            ds << rec.name;
+            ds.writeArray(&rec.points[0], (uint32_t) rec.points.size());
+        }
+        ds.finalize();
+        writeUs += start.elapsed();
+        bytes = ds.size();
+
+        start.update();
+        RDataStream2 in(ds.data(), ds.size());
+        DataSpan name;
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            in >> r.timestamp;
+            in.readArray(r.pose, 6);
+            in >> name;
+            in.readArray(&r.points[0], (uint32_t) r.points.size());
+            checksum += r.pose[0];
+        }
+        readUs += start.elapsed();
+    }
+    report(arena ? "v2arena" : "v2", bytes, rounds, writeUs, readUs);
+}
+
+int main(int argc, char** argv)
+{
+    svar.ParseMain(argc, argv);
+    int nRecords = svar.GetInt("Records", 1000);
+    int nPoints  = svar.GetInt("Points", 64);
+    int rounds   = svar.GetInt("Rounds", 2000);
+
+    std::vector<Record> records(nRecords);
+    for (int i = 0; i < nRecords; i++)
+    {
+        records[i].timestamp = i;
+        for (int j = 0; j < 6; j++) records[i].pose[j] = i + j * 0.1;
+        records[i].name = "sensor" + pi::itos(i % 16);
+        records[i].points.assign(nPoints, (float) i);
+    }
+
+    benchV1(records, rounds);
+    benchV2(records, rounds, NULL);
+
+    DataStreamArena arena(1 << 20);
+    benchV2(records, rounds, &arena);
+
+    printf("checksum %g\n", checksum);
+    return 0;
+}
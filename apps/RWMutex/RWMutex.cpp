@@ -1,180 +1,204 @@
-#include <base/Time/Global_Timer.h>
+/// RWMutex: scaling of the locks of pi::Thread with the number of threads.
+///
+/// Usage: RWMutex [Threads=8] [Circle=200000] [WriteRatio=1] [Work=20]
+///                [Locks=MutexRW,BiasedMutexRW,FastMutex,TicketSpinLock,MCSSpinLock,SeqLock]
+///
+///   Threads       the largest thread count, measured are 1, 2, 4 .. Threads
+///   Circle        operations per thread
+///   WriteRatio    percentage of the operations which write
+///   Work          loop iterations inside the critical section
+///   Locks         the locks to compare
+///
+/// Every thread reads or writes a small table guarded by the lock; the
+/// result is the total throughput in million operations per second.
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
 #include <base/Svar/Svar.h>
 #include <base/Debug/StackTrace.h>
-#include <thread>
-#include <list>
-#include <binders.h>
-#include <functional>
-
+#include <base/Time/Timestamp.h>
+#include <base/Thread/Thread.h>
+#include <base/Thread/Mutex.h>
+#include <base/Thread/MutexRW.h>
+#include <base/Thread/BiasedMutexRW.h>
+#include <base/Thread/SpinLock.h>
+#include <base/Thread/SeqLock.h>
 
 using namespace std;
 using namespace pi;
 
-int THREAD_COUNT= 4;
 
-class Queue
+/// The shared data, written as a whole so torn reads are detected.
+struct Table
 {
-public:
-    void write(int value)
-    {
-        pi::WriteMutex   lockWrite(m_piMutex);
-        m_list.push_back(value);
-    }
+    long values[8];
+};
 
-    int  read(int pos)
-    {
-        pi::ReadMutex  lockRead(m_piMutex);
+static int workLoops = 20;
+
+static long readTable(const Table& table)
+{
+    long sum = 0;
+    for (int w = 0; w < workLoops; w++)
+        for (int i = 0; i < 8; i++) sum += table.values[i] ^ w;
+    return sum;
+}
 
-        if(size()==0 || pos>=size())
-            return -1;
+static void writeTable(Table& table, long value)
+{
+    for (int i = 0; i < 8; i++) table.values[i] = value;
+}
 
-        std::list<int>::iterator itr = m_list.begin();
-        std::advance(itr , pos);
-        int value = *itr;
 
-        return value;
-    }
+/// Reader writer locks: MutexRW and BiasedMutexRW.
+template <class M>
+struct RWGuarded
+{
+    M     mutex;
+    Table table;
 
-    void remove(int pos)
+    long read()
     {
-        pi::WriteMutex   lockWrite(m_piMutex);
-        if(m_list.size()==0 || pos>=m_list.size())
-            return;
-
-//        cout<<"size:"<<m_list.size()<<",remove "<<pos<<endl;
-        std::list<int>::iterator itr = m_list.begin();
-        std::advance(itr , pos);
-        m_list.erase(itr);
+        ReadLock<M> lock(mutex);
+        return readTable(table);
     }
 
-    int  size()
+    void write(long value)
     {
-        pi::ReadMutex  lockRead(m_piMutex);
-        return m_list.size();
+        WriteLock<M> lock(mutex);
+        writeTable(table, value);
     }
-
-private:
-    std::list<int>  m_list;
-
-    pi::MutexRW     m_piMutex;
-    pi::Mutex       m_Mutex;
 };
 
-class QueueOperates : public pi::Runnable
+/// Exclusive locks: readers serialize like writers.
+template <class M>
+struct ExclusiveGuarded
 {
-public:
-    QueueOperates(Queue& queue,int mode=0)
-        :que(queue),md(mode)
-    {
+    M     mutex;
+    Table table;
 
+    long read()
+    {
+        ScopedLock<M> lock(mutex);
+        return readTable(table);
     }
 
-    virtual void run()
+    void write(long value)
     {
-//        std::cout<<"Thread with mode "<<md<<" started.\n";
-        int circulate=svar.GetInt("Circle",100000);
-        for(int i=0;i<circulate;i++)
-        {
-//            pi::sleep(1);
-            switch (md) {
+        ScopedLock<M> lock(mutex);
+        writeTable(table, value);
+    }
+};
 
-            case 0:
-            {
-                // write
-                pi::timer.enter("Write");
-//                if(que.size()<1000) que.write(rand());
-                pi::timer.leave("Write");
-                break;
-            }
-            case 1:
-                // read
-                pi::timer.enter("Read");
-//                if(que.size())
-//                    que.read(rand()%que.size());
-                pi::timer.leave("Read");
-                break;
-            case 2:
-                // remove
-                pi::timer.enter("Remove");
-//                if(que.size())
-//                    que.remove(rand()%que.size());
-                pi::timer.leave("Remove");
-                break;
-            default:
-                break;
-            }
-        }
-//        std::cout<<"Thread with mode "<<md<<" stoped.\n";
+/// SeqLock: readers copy the table and never write shared memory.
+struct SeqGuarded
+{
+    SeqLock<Table> table;
+
+    long read()
+    {
+        Table copy;
+        table.read(copy);
+        return readTable(copy);
     }
 
-    Queue& que;
-    int    md;
+    void write(long value)
+    {
+        SeqLock<Table>::ScopedLock lock(table);
+        writeTable(table.value(), value);
+    }
 };
 
-void run(Queue *que,int md)
+
+template <class G>
+double measure(int threadCount, int circle, int writeRatio)
 {
-    //        std::cout<<"Thread with mode "<<md<<" started.\n";
-    int circulate=svar.GetInt("Circle",1000000);
-    for(int i=0;i<circulate;i++)
-    {
-//        pi::sleep(1);
-        switch (md) {
+    G guarded;
+    std::vector<pi::Thread*> threads;
+    volatile long            sink = 0;
 
-        case 0:
-        {
-            // write
-            pi::timer.enter("Write");
-            if(que->size()<10) que->write(rand());
-            pi::timer.leave("Write");
-            break;
-        }
-        case 1:
-        {
-            // read
-            pi::timer.enter("Read");
-            int sz=que->size();
-            if(sz)
-                que->read(rand()%sz);
-            pi::timer.leave("Read");
-            break;
-        }
-        case 2:
-            // remove
-        {
-            pi::timer.enter("Remove");
-            int sz=que->size();
-            if(sz)
-            que->remove(rand()%sz);
-            pi::timer.leave("Remove");
-            break;
-        }
-        default:
-            break;
-        }
+    double start = Timestamp::getTimestampF();
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.push_back(new pi::Thread);
+        threads.back()->startFunc([&guarded, &sink, circle, writeRatio, t]() {
+            unsigned int seed = 12345 + t;
+            long         sum  = 0;
+            for (int i = 0; i < circle; i++)
+            {
+                seed = seed*1103515245 + 12345;
+                if ((int) ((seed >> 16) % 100) < writeRatio)
+                    guarded.write(i);
+                else
+                    sum += guarded.read();
+            }
+            sink += sum;
+        });
     }
-    //        std::cout<<"Thread with mode "<<md<<" stoped.\n";
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads[t]->join();
+        delete threads[t];
+    }
+    double elapsed = Timestamp::getTimestampF() - start;
+
+    return threadCount * (double) circle / elapsed * 1e-6;
 }
 
-int main(int argc , char* argv[])
+
+typedef double (*MeasureFunc)(int threadCount, int circle, int writeRatio);
+
+struct LockCase
+{
+    const char* name;
+    MeasureFunc func;
+};
+
+int main(int argc, char* argv[])
 {
     pi::dbg_stacktrace_setup();
-    svar.ParseMain(argc,argv);
-    vector<thread> threads;
-    timer.disable();
-    try{
+    svar.ParseMain(argc, argv);
 
-        Queue                 queue;
-        for(int i=0;i<20;i++)
-            threads.push_back(thread(run,&queue,i%3));
+    int    maxThreads = svar.GetInt("Threads", 8);
+    int    circle     = svar.GetInt("Circle", 200000);
+    int    writeRatio = svar.GetInt("WriteRatio", 1);
+    string locks      = svar.GetString("Locks", "MutexRW,BiasedMutexRW,FastMutex,TicketSpinLock,MCSSpinLock,SeqLock");
+    workLoops         = svar.GetInt("Work", 20);
 
-        for(thread& th:threads)
+    const LockCase cases[] =
+    {
+        { "MutexRW",        measure< RWGuarded<MutexRW> > },
+        { "BiasedMutexRW",  measure< RWGuarded<BiasedMutexRW> > },
+        { "FastMutex",      measure< ExclusiveGuarded<FastMutex> > },
+        { "TicketSpinLock", measure< ExclusiveGuarded<TicketSpinLock> > },
+        { "MCSSpinLock",    measure< ExclusiveGuarded<MCSSpinLock> > },
+        { "SeqLock",        measure< SeqGuarded > },
+    };
+
+    std::vector<int> threadCounts;
+    for (int n = 1; n < maxThreads; n *= 2) threadCounts.push_back(n);
+    threadCounts.push_back(maxThreads);
+
+    printf("%d%% writes, %d operations per thread, Mops/s\n", writeRatio, circle);
+    printf("%-16s", "threads");
+    for (size_t i = 0; i < threadCounts.size(); i++) printf("%10d", threadCounts[i]);
+    printf("\n");
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        if (("," + locks + ",").find(string(",") + cases[c].name + ",") == string::npos) continue;
+
+        printf("%-16s", cases[c].name);
+        for (size_t i = 0; i < threadCounts.size(); i++)
         {
-            if(th.joinable()) th.join();
+            printf("%10.2f", cases[c].func(threadCounts[i], circle, writeRatio));
+            fflush(stdout);
         }
+        printf("\n");
     }
-    catch(const std::exception& e)
-    {
-        cout<<e.what()<<endl;
-    }
+
     return 0;
 }
@@ -0,0 +1,154 @@
+/// Encode/decode throughput of arrays of SE3d poses.
+///
+/// The benchmark compares:
+///   manual      hand-written operator<< / operator>> per field, RDataStream
+///   schema      serialize()/deserialize() of the vector, RDataStream
+///   schema2     serialize()/deserialize() of the vector, RDataStream2
+///   fieldwise   serialize() of every pose on its own, RDataStream2
+///   text        toText()/fromText() of the vector
+///
+/// Usage: SerializationBench Poses=10000 Rounds=200
+
+#include <cstdio>
+#include <vector>
+#include <string>
+
+#include <base/Svar/Svar.h>
+#include <base/Time/Timestamp.h>
+#include <base/Types/Serialization.h>
+
+using namespace std;
+using namespace pi;
+
+static double checksum;
+
+static void report(const std::string& name, size_t bytes, int rounds, pi::Timestamp::TimeDiff encodeUs, pi::Timestamp::TimeDiff decodeUs)
+{
+    double total = (double) bytes * rounds / (1 << 20);
+    printf("%-10s encode %8.1f MB/s  decode %8.1f MB/s  (%lu bytes)\n", name.c_str(),
+           total / (encodeUs * 1e-6), total / (decodeUs * 1e-6), (unsigned long) bytes);
+}
+
+static void benchManual(const std::vector<SE3d>& poses, int rounds)
+{
+    pi::Timestamp::TimeDiff encodeUs = 0, decodeUs = 0;
+    size_t bytes = 0;
+    std::vector<SE3d> out(poses.size());
+
+    for (int k = 0; k < rounds; k++)
+    {
+        pi::Timestamp start;
+        RDataStream ds;
+        uint32_t n = (uint32_t) poses.size();
+        ds << n;
+        for (size_t i = 0; i < poses.size(); i++)
+        {
+            SO3d r = poses[i].get_rotation();
+            Point3d t = poses[i].get_translation();
+            ds << r.x << r.y << r.z << r.w << t.x << t.y << t.z;
+        }
+        encodeUs += start.elapsed();
+        bytes = ds.size();
+
+        start.update();
+        ds.rewind();
+        ds >> n;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            SO3d& r = out[i].get_rotation();
+            Point3d& t = out[i].get_translation();
+            ds >> r.x >> r.y >> r.z >> r.w >> t.x >> t.y >> t.z;
+        }
+        decodeUs += start.elapsed();
+        checksum += out.back().get_translation().x;
+    }
+    report("manual", bytes, rounds, encodeUs, decodeUs);
+}
+
+template <class Stream>
+static void benchSchema(const std::string& name, const std::vector<SE3d>& poses, int rounds)
+{
+    pi::Timestamp::TimeDiff encodeUs = 0, decodeUs = 0;
+    size_t bytes = 0;
+    std::vector<SE3d> out;
+
+    for (int k = 0; k < rounds; k++)
+    {
+        pi::Timestamp start;
+        Stream ds;
+        serialize(ds, poses);
+        encodeUs += start.elapsed();
+        bytes = ds.size();
+
+        start.update();
+        ds.rewind();
+        deserialize(ds, out);
+        decodeUs += start.elapsed();
+        checksum += out.back().get_translation().x;
+    }
+    report(name, bytes, rounds, encodeUs, decodeUs);
+}
+
+static void benchFieldwise(const std::vector<SE3d>& poses, int rounds)
+{
+    pi::Timestamp::TimeDiff encodeUs = 0, decodeUs = 0;
+    size_t bytes = 0;
+    std::vector<SE3d> out(poses.size());
+
+    for (int k = 0; k < rounds; k++)
+    {
+        pi::Timestamp start;
+        RDataStream2 ds;
+        for (size_t i = 0; i < poses.size(); i++) serialize(ds, poses[i]);
+        encodeUs += start.elapsed();
+        bytes = ds.size();
+
+        start.update();
+        ds.rewind();
+        for (size_t i = 0; i < out.size(); i++) deserialize(ds, out[i]);
+        decodeUs += start.elapsed();
+        checksum += out.back().get_translation().x;
+    }
+    report("fieldwise", bytes, rounds, encodeUs, decodeUs);
+}
+
+static void benchText(const std::vector<SE3d>& poses, int rounds)
+{
+    pi::Timestamp::TimeDiff encodeUs = 0, decodeUs = 0;
+    size_t bytes = 0;
+    std::vector<SE3d> out;
+
+    for (int k = 0; k < rounds; k++)
+    {
+        pi::Timestamp start;
+        std::string text = toText(poses);
+        encodeUs += start.elapsed();
+        bytes = text.size();
+
+        start.update();
+        fromText(text, out);
+        decodeUs += start.elapsed();
+        checksum += out.back().get_translation().x;
+    }
+    report("text", bytes, rounds, encodeUs, decodeUs);
+}
+
+int main(int argc, char** argv)
+{
+    svar.ParseMain(argc, argv);
+    int nPoses = svar.GetInt("Poses", 10000);
+    int rounds = svar.GetInt("Rounds", 200);
+
+    std::vector<SE3d> poses;
+    for (int i = 0; i < nPoses; i++)
+        poses.push_back(SE3d(i, 0.5*i, 0.25*i, 0, 0, 0.38268343236508978, 0.92387953251128674));
+
+    benchManual(poses, rounds);
+    benchSchema<RDataStream>("schema", poses, rounds);
+    benchSchema<RDataStream2>("schema2", poses, rounds);
+    benchFieldwise(poses, rounds);
+    benchText(poses, rounds / 20 + 1);
+
+    printf("checksum %g\n", checksum);
+    return 0;
+}
@@ -0,0 +1,131 @@
+/// Loopback throughput of the StreamSocket send paths.
+///
+/// Every message consists of a small header and a large payload, like
+/// an image frame. The benchmark compares:
+///   copy      memcpy header and payload into one buffer, sendBytes()
+///   sendv     gather write of header and payload with sendv()
+///   zerocopy  sendv() of the header, sendBytesZeroCopy() of the payload
+///   sendfile  sendFile() of a file with the same total size
+///
+/// Usage: StreamSocketBench Payload=1048576 Messages=2000 Mode=all
+
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include <base/Svar/Svar.h>
+#include <base/Thread/Thread.h>
+#include <base/Time/Timestamp.h>
+#include <base/Path/Path.h>
+#include <network/ServerSocket.h>
+#include <network/StreamSocket.h>
+#include <network/SocketAddress.h>
+
+using namespace std;
+using namespace pi;
+
+static void drain(StreamSocket peer, pi::Int64& received)
+{
+    std::vector<char> buffer(1 << 20);
+    int n;
+    while ((n = peer.receiveBytes(&buffer[0], (int) buffer.size())) > 0)
+        received += n;
+}
+
+static void report(const std::string& name, pi::Int64 bytes, pi::Timestamp::TimeDiff us)
+{
+    printf("%-10s %10.1f MB/s  (%lld bytes in %.3f s)\n", name.c_str(),
+           bytes / (us * 1e-6) / (1 << 20), (long long) bytes, us * 1e-6);
+}
+
+static void bench(const std::string& mode, int payloadSize, int messages, const std::string& file)
+{
+    ServerSocket server(SocketAddress("127.0.0.1", 0));
+    StreamSocket client(SocketAddress("127.0.0.1", server.address().port()));
+    StreamSocket peer = server.acceptConnection();
+
+    pi::Int64 received = 0;
+    pi::Thread receiver("Receiver");
+    receiver.startFunc([&]() { drain(peer, received); });
+
+    char header[32];
+    memset(header, 'h', sizeof(header));
+    std::vector<char> payload(payloadSize, 'p');
+    std::vector<char> message(sizeof(header) + payloadSize);
+
+    pi::Timestamp start;
+    if (mode == "copy")
+    {
+        for (int i = 0; i < messages; i++)
+        {
+            memcpy(&message[0], header, sizeof(header));
+            memcpy(&message[sizeof(header)], &payload[0], payloadSize);
+            client.sendBytes(&message[0], (int) message.size());
+        }
+    }
+    else if (mode == "sendv")
+    {
+        SocketBufVec buffers;
+        buffers.push_back(Socket::makeBuffer(header, sizeof(header)));
+        buffers.push_back(Socket::makeBuffer(&payload[0], payloadSize));
+        for (int i = 0; i < messages; i++)
+            client.sendv(buffers);
+    }
+    else if (mode == "zerocopy")
+    {
+        for (int i = 0; i < messages; i++)
+        {
+            client.sendBytes(header, sizeof(header));
+            client.sendBytesZeroCopy(&payload[0], payloadSize);
+            // the payload is reused, so wait whenever too many sends are in flight
+            while (client.zeroCopySent() - client.zeroCopyCompleted() > 64)
+                client.zeroCopyCompleted(pi::Timespan(1000));
+        }
+        while (client.zeroCopyCompleted(pi::Timespan(1000)) != client.zeroCopySent())
+            ;
+    }
+    else if (mode == "sendfile")
+    {
+        for (int i = 0; i < messages; i++)
+            client.sendFile(file);
+    }
+    client.shutdownSend();
+    receiver.join();
+
+    report(mode, received, start.elapsed());
+    if (mode == "zerocopy" && client.zeroCopyCopied())
+        printf("           (the kernel copied the zero-copy data, as usual on loopback)\n");
+}
+
+int main(int argc, char** argv)
+{
+    svar.ParseMain(argc, argv);
+
+    int         payloadSize = svar.GetInt("Payload", 1 << 20);
+    int         messages    = svar.GetInt("Messages", 2000);
+    std::string mode        = svar.GetString("Mode", "all");
+
+    std::string file = Path::temp() + "StreamSocketBench.tmp";
+    {
+        std::vector<char> content(32 + payloadSize, 'f');
+        FILE* fp = fopen(file.c_str(), "wb");
+        if (!fp)
+        {
+            cerr << "Can't create " << file << endl;
+            return 1;
+        }
+        fwrite(&content[0], 1, content.size(), fp);
+        fclose(fp);
+    }
+
+    const char* modes[] = {"copy", "sendv", "zerocopy", "sendfile"};
+    for (int i = 0; i < 4; i++)
+    {
+        if (mode == "all" || mode == modes[i])
+            bench(modes[i], payloadSize, messages, file);
+    }
+
+    remove(file.c_str());
+    return 0;
+}
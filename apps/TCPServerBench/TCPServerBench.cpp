@@ -0,0 +1,204 @@
+/// Load generator comparing the thread-per-connection TCPServer with the
+/// event-driven TCPReactorServer.
+///
+/// A number of idle connections is opened first, then a few active client
+/// threads run request/response round trips until the duration elapses.
+///
+/// Usage: TCPServerBench Mode=both Idle=500 Active=8 Duration=5 Threads=0 Size=64
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+
+#include <base/Svar/Svar.h>
+#include <base/Thread/Thread.h>
+#include <base/Thread/ThreadPool.h>
+#include <base/Thread/Mutex.h>
+#include <base/Time/Timestamp.h>
+#include <network/TCPServer.h>
+#include <network/TCPServerConnection.h>
+#include <network/TCPServerConnectionFactory.h>
+#include <network/TCPReactorServer.h>
+#include <network/StreamSocket.h>
+#include <network/SocketAddress.h>
+
+using namespace std;
+using namespace pi;
+
+class EchoServerConnection: public TCPServerConnection
+{
+public:
+    EchoServerConnection(const StreamSocket& s): TCPServerConnection(s)
+    {
+    }
+
+    void run()
+    {
+        StreamSocket& ss = socket();
+        try
+        {
+            char buffer[16384];
+            int n = ss.receiveBytes(buffer, sizeof(buffer));
+            while (n > 0)
+            {
+                ss.sendBytes(buffer, n);
+                n = ss.receiveBytes(buffer, sizeof(buffer));
+            }
+        }
+        catch (pi::Exception&)
+        {
+        }
+    }
+};
+
+class EchoReactorConnection: public TCPReactorConnection
+{
+public:
+    EchoReactorConnection(const StreamSocket& s): TCPReactorConnection(s)
+    {
+    }
+
+    void onData(const char* data, int length)
+    {
+        send(data, length);
+    }
+};
+
+struct BenchResult
+{
+    BenchResult(): requests(0), seconds(0) {}
+
+    pi::Int64              requests;
+    double                 seconds;
+    std::vector<pi::Int64> latencies; // microseconds
+};
+
+static void runClient(const SocketAddress& sa, int size, double duration,
+                      BenchResult& result, pi::FastMutex& mutex)
+{
+    std::vector<pi::Int64> latencies;
+    std::string request(size, 'x');
+    std::vector<char> response(size);
+
+    StreamSocket ss(sa);
+    ss.setNoDelay(true);
+
+    pi::Timestamp start;
+    while (start.elapsed() < (pi::Timestamp::TimeDiff)(duration * 1e6))
+    {
+        pi::Timestamp t;
+        ss.sendBytes(request.data(), size);
+        int got = 0;
+        while (got < size)
+        {
+            int n = ss.receiveBytes(&response[got], size - got);
+            if (n <= 0) return;
+            got += n;
+        }
+        latencies.push_back(t.elapsed());
+    }
+    ss.close();
+
+    pi::FastMutex::ScopedLock lock(mutex);
+    result.requests += latencies.size();
+    result.latencies.insert(result.latencies.end(), latencies.begin(), latencies.end());
+}
+
+static BenchResult runLoad(const SocketAddress& sa, int idle, int active, int size, double duration)
+{
+    BenchResult   result;
+    pi::FastMutex mutex;
+
+    std::vector<StreamSocket> idleSockets;
+    idleSockets.reserve(idle);
+    for (int i = 0; i < idle; i++)
+        idleSockets.push_back(StreamSocket(sa));
+
+    std::vector<pi::Thread*> clients;
+    pi::Timestamp start;
+    for (int i = 0; i < active; i++)
+    {
+        pi::Thread* thread = new pi::Thread("BenchClient");
+        thread->startFunc([&]() { runClient(sa, size, duration, result, mutex); });
+        clients.push_back(thread);
+    }
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->join();
+        delete clients[i];
+    }
+    result.seconds = start.elapsed() * 1e-6;
+
+    for (size_t i = 0; i < idleSockets.size(); i++)
+        idleSockets[i].close();
+    return result;
+}
+
+static void report(const std::string& name, int serverThreads, int connections, BenchResult& r)
+{
+    std::sort(r.latencies.begin(), r.latencies.end());
+    pi::Int64 p50 = 0, p99 = 0;
+    if (!r.latencies.empty())
+    {
+        p50 = r.latencies[r.latencies.size() / 2];
+        p99 = r.latencies[std::min(r.latencies.size() - 1, r.latencies.size() * 99 / 100)];
+    }
+    printf("%-10s threads=%-5d connections=%-6d requests/s=%-10.0f p50=%lldus p99=%lldus\n",
+           name.c_str(), serverThreads, connections,
+           r.seconds > 0 ? r.requests / r.seconds : 0.0,
+           (long long) p50, (long long) p99);
+}
+
+static void benchThreaded(int idle, int active, int size, double duration)
+{
+    // every connection occupies one pooled thread for its whole lifetime
+    int capacity = idle + active + 1;
+    pi::ThreadPool pool("TCPServerBench", 2, capacity);
+
+    TCPServerParams* pParams = new TCPServerParams;
+    pParams->setMaxThreads(capacity);
+    pParams->setMaxQueued(capacity);
+
+    ServerSocket socket(SocketAddress(IPAddress(), 0), 1024);
+    TCPServer srv(new TCPServerConnectionFactoryImpl<EchoServerConnection>(), pool, socket, pParams);
+    srv.start();
+
+    BenchResult r = runLoad(SocketAddress("127.0.0.1", socket.address().port()), idle, active, size, duration);
+    report("threaded", srv.maxThreads(), srv.maxConcurrentConnections(), r);
+    srv.stop();
+    pool.joinAll();
+}
+
+static void benchReactor(int idle, int active, int size, double duration, int threads)
+{
+    TCPReactorServer srv(new TCPReactorConnectionFactoryImpl<EchoReactorConnection>(),
+                         SocketAddress(IPAddress(), 0), threads, 1024);
+    srv.start();
+
+    BenchResult r = runLoad(SocketAddress("127.0.0.1", srv.port()), idle, active, size, duration);
+    report("reactor", srv.threads(), srv.maxConcurrentConnections(), r);
+    srv.stop();
+}
+
+int main(int argc, char** argv)
+{
+    svar.ParseMain(argc, argv);
+
+    std::string mode = svar.GetString("Mode", "both");
+    int    idle      = svar.GetInt("Idle", 500);
+    int    active    = svar.GetInt("Active", 8);
+    int    size      = svar.GetInt("Size", 64);
+    int    threads   = svar.GetInt("Threads", 0);
+    double duration  = svar.GetDouble("Duration", 5);
+
+    cout << "TCPServerBench: idle=" << idle << " active=" << active
+         << " size=" << size << " duration=" << duration << "s" << endl;
+
+    if (mode == "threaded" || mode == "both")
+        benchThreaded(idle, active, size, duration);
+    if (mode == "reactor" || mode == "both")
+        benchReactor(idle, active, size, duration, threads);
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include <string.h>
+
+#include <base/Utils/TestCase.h>
+#include <base/Debug/Exception.h>
+#include <base/Crypto/AES.h>
+#include <base/Crypto/AESCipher.h>
+#include <base/Crypto/Crypto_utils.h>
+
+using namespace pi;
+using namespace pi::crypto;
+using namespace std;
+
+class AESTest : public pi::TestCase
+{
+public:
+    AESTest():pi::TestCase("AESTest"){}
+
+    virtual void run()
+    {
+        testBlock();
+        testCTR();
+        testGCM();
+        testStreaming();
+    }
+
+    void testBlock();
+    void testCTR();
+    void testGCM();
+    void testStreaming();
+
+    static std::vector<uint8_t> hex(const std::string& s)
+    {
+        return str2hex(s);
+    }
+};
+
+AESTest AESTestInstance;
+
+
+static const AESKernel kernels[] = { AES_KERNEL_TABLE, AES_KERNEL_HARDWARE };
+
+
+void AESTest::testBlock()
+{
+    // FIPS-197, appendix C
+    std::vector<uint8_t> plain = hex("00112233445566778899aabbccddeeff");
+    const char* keys[] = {
+        "000102030405060708090a0b0c0d0e0f",
+        "000102030405060708090a0b0c0d0e0f1011121314151617",
+        "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    };
+    const char* expected[] = {
+        "69c4e0d86a7b0430d8cdb78070b4c55a",
+        "dda97ca4864cdfe06eaf70a0ec0d7191",
+        "8ea2b7ca516745bfeafc49904b496089"
+    };
+
+    for (int k = 0; k < 2; k++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            std::vector<uint8_t> key = hex(keys[i]);
+            AESKey aes(&key[0], key.size(), kernels[k]);
+            uint8_t out[16];
+            aes.encryptBlocks(&plain[0], out, 1);
+            pi_assert (hex2str(std::vector<uint8_t>(out, out + 16)) == expected[i]);
+        }
+    }
+
+    // same cipher as the legacy ECB functions
+    std::vector<uint8_t> key = hex(keys[0]), legacy;
+    AES old(key);
+    old.encode(plain, legacy);
+    pi_assert (hex2str(legacy) == expected[0]);
+
+    try
+    {
+        AESKey bad(&key[0], 15);
+        pi_assert (false);
+    }
+    catch (InvalidArgumentException&)
+    {
+    }
+}
+
+
+void AESTest::testCTR()
+{
+    // NIST SP 800-38A, F.5.1
+    std::vector<uint8_t> key    = hex("2b7e151628aed2a6abf7158809cf4f3c");
+    std::vector<uint8_t> iv     = hex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+    std::vector<uint8_t> plain  = hex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                                      "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    std::string          cipher = "874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff"
+                                  "5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee";
+
+    for (int k = 0; k < 2; k++)
+    {
+        AESKey aes(&key[0], key.size(), kernels[k]);
+        std::vector<uint8_t> data = plain;
+        AESCTR ctr(aes, &iv[0]);
+        ctr.process(data);
+        pi_assert (hex2str(data) == cipher);
+
+        AESCTR back(aes, &iv[0]);
+        back.process(data);
+        pi_assert (data == plain);
+    }
+
+    // the counter carries over 64 bit boundaries
+    std::vector<uint8_t> wrap = hex("0000000000000000fffffffffffffffa");
+    AESKey table(&key[0], key.size(), AES_KERNEL_TABLE);
+    AESKey aes(&key[0], key.size());
+    std::vector<uint8_t> a(320, 0), b(320, 0);
+    AESCTR(table, &wrap[0]).process(a);
+    AESCTR(aes, &wrap[0]).process(b);
+    pi_assert (a == b);
+    std::vector<uint8_t> c(16, 0);
+    std::vector<uint8_t> next = hex("00000000000000010000000000000000");
+    AESCTR(table, &next[0]).process(c);
+    pi_assert (memcmp(&c[0], &a[6*16], 16) == 0);
+}
+
+
+void AESTest::testGCM()
+{
+    // test cases 1, 2 and 4 of "The Galois/Counter Mode of Operation"
+    for (int k = 0; k < 2; k++)
+    {
+        std::vector<uint8_t> zero(16, 0);
+        AESKey aes0(&zero[0], 16, kernels[k]);
+        uint8_t tag[16], out[16];
+
+        AESGCM::seal(aes0, &zero[0], 12, 0, 0, 0, 0, 0, tag);
+        pi_assert (hex2str(std::vector<uint8_t>(tag, tag + 16)) == "58e2fccefa7e3061367f1d57a4e7455a");
+
+        AESGCM::seal(aes0, &zero[0], 12, 0, 0, &zero[0], out, 16, tag);
+        pi_assert (hex2str(std::vector<uint8_t>(out, out + 16)) == "0388dace60b6a392f328c2b971b2fe78");
+        pi_assert (hex2str(std::vector<uint8_t>(tag, tag + 16)) == "ab6e47d42cec13bdf53a67b21257bddf");
+
+        std::vector<uint8_t> key   = hex("feffe9928665731c6d6a8f9467308308");
+        std::vector<uint8_t> iv    = hex("cafebabefacedbaddecaf888");
+        std::vector<uint8_t> aad   = hex("feedfacedeadbeeffeedfacedeadbeefabaddad2");
+        std::vector<uint8_t> plain = hex("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+                                         "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39");
+        AESKey aes(&key[0], key.size(), kernels[k]);
+        std::vector<uint8_t> data(plain.size());
+        AESGCM::seal(aes, &iv[0], iv.size(), &aad[0], aad.size(), &plain[0], &data[0], data.size(), tag);
+        pi_assert (hex2str(data) == "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+                                    "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091");
+        pi_assert (hex2str(std::vector<uint8_t>(tag, tag + 16)) == "5bc94fbc3221a5db94fae95ae7121a47");
+
+        // decryption in place, and a forged message
+        pi_assert (AESGCM::open(aes, &iv[0], iv.size(), &aad[0], aad.size(), &data[0], &data[0], data.size(), tag));
+        pi_assert (data == plain);
+        AESGCM::seal(aes, &iv[0], iv.size(), &aad[0], aad.size(), &plain[0], &data[0], data.size(), tag);
+        data[5] ^= 1;
+        pi_assert (!AESGCM::open(aes, &iv[0], iv.size(), &aad[0], aad.size(), &data[0], &data[0], data.size(), tag));
+        pi_assert (data[0] == 0 && data[5] == 0);
+
+        // test case 6, a 60 byte IV
+        std::vector<uint8_t> longIv = hex("9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728"
+                                          "c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b");
+        AESGCM::seal(aes, &longIv[0], longIv.size(), &aad[0], aad.size(), &plain[0], &data[0], data.size(), tag);
+        pi_assert (hex2str(std::vector<uint8_t>(tag, tag + 16)) == "619cc5aefffe0bfa462af43c1699d050");
+    }
+}
+
+
+void AESTest::testStreaming()
+{
+    std::vector<uint8_t> key = hex("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+    std::vector<uint8_t> iv(16, 0x5a);
+    std::vector<uint8_t> plain(1000);
+    for (size_t i = 0; i < plain.size(); i++) plain[i] = (uint8_t) (i * 7);
+
+    AESKey table(&key[0], key.size(), AES_KERNEL_TABLE);
+    AESKey aes(&key[0], key.size());
+
+    // pieces of odd sizes give the same stream as one call, on any kernel
+    std::vector<uint8_t> whole = plain, pieces = plain;
+    AESCTR(table, &iv[0]).process(whole);
+    AESCTR ctr(aes, &iv[0]);
+    for (size_t pos = 0, n = 1; pos < pieces.size(); pos += n, n += 7)
+        ctr.process(&pieces[pos], std::min(n, pieces.size() - pos));
+    pi_assert (pieces == whole);
+
+    // random access into the key stream
+    std::vector<uint8_t> part(plain.begin() + 333, plain.begin() + 600);
+    AESCTR seeker(aes, &iv[0]);
+    seeker.seek(333);
+    seeker.process(part);
+    pi_assert (memcmp(&part[0], &whole[333], part.size()) == 0);
+
+    // GCM in pieces
+    uint8_t tag[16], tag2[16];
+    std::vector<uint8_t> sealed(plain.size()), opened(plain.size());
+    AESGCM::seal(table, &iv[0], 12, "header", 6, &plain[0], &sealed[0], plain.size(), tag);
+
+    AESGCM gcm(aes);
+    gcm.start(&iv[0], 12);
+    gcm.addAAD("hea", 3);
+    gcm.addAAD("der", 3);
+    std::vector<uint8_t> out(plain.size());
+    for (size_t pos = 0, n = 3; pos < plain.size(); pos += n, n += 11)
+        gcm.encrypt(&plain[pos], &out[pos], std::min(n, plain.size() - pos));
+    gcm.finish(tag2);
+    pi_assert (out == sealed);
+    pi_assert (memcmp(tag, tag2, 16) == 0);
+
+    gcm.start(&iv[0], 12);
+    gcm.addAAD("header", 6);
+    gcm.decrypt(&sealed[0], &opened[0], 500);
+    gcm.decrypt(&sealed[500], &opened[500], 500);
+    pi_assert (gcm.verify(tag, 12));
+    pi_assert (opened == plain);
+
+    try
+    {
+        gcm.addAAD("late", 4);
+        pi_assert (false);
+    }
+    catch (IllegalStateException&)
+    {
+    }
+}
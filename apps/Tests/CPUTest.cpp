@@ -0,0 +1,129 @@
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <base/Platform/CPU.h>
+
+#if defined(PIL_CPU_HAS_X86_VARIANTS)
+#include <immintrin.h>
+#endif
+
+using namespace pi;
+using namespace std;
+
+class CPUTest : public pi::TestCase
+{
+public:
+    CPUTest():pi::TestCase("CPUTest"){}
+
+    virtual void run()
+    {
+        testFeatures();
+        testDispatch();
+        testKernel();
+    }
+
+    void testFeatures();
+    void testDispatch();
+    void testKernel();
+};
+
+CPUTest CPUTestInstance;
+
+
+typedef int (*AnswerFunc)();
+
+static int answerGeneric() { return 1; }
+static int answerA()       { return 2; }
+static int answerB()       { return 3; }
+
+
+typedef float (*SumFunc)(const float* p, int n);
+
+static float sumGeneric(const float* p, int n)
+{
+    float s = 0;
+    for (int i = 0; i < n; i++) s += p[i];
+    return s;
+}
+
+#if defined(PIL_CPU_HAS_X86_VARIANTS)
+PIL_TARGET_AVX2 static float sumAvx2(const float* p, int n)
+{
+    __m256 acc = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) acc = _mm256_add_ps(acc, _mm256_loadu_ps(p + i));
+    float lanes[8];
+    _mm256_storeu_ps(lanes, acc);
+    float s = 0;
+    for (int k = 0; k < 8; k++) s += lanes[k];
+    for (; i < n; i++) s += p[i];
+    return s;
+}
+#endif
+
+
+void CPUTest::testFeatures()
+{
+    cpu::Features f = cpu::features();
+    pi_assert (cpu::has(0));
+    pi_assert (cpu::has(cpu::AVX2) == ((f & cpu::AVX2) != 0));
+
+#if defined(__x86_64__)
+    pi_assert (cpu::has(cpu::SSE2));
+#endif
+#if defined(__aarch64__)
+    pi_assert (cpu::has(cpu::NEON));
+#endif
+
+    // the wide vector features come with their base
+    if (cpu::has(cpu::AVX2))    pi_assert (cpu::has(cpu::AVX));
+    if (cpu::has(cpu::AVX512F)) pi_assert (cpu::has(cpu::AVX));
+
+    pi_assert (string(cpu::featureName(cpu::AVX2)) == "avx2");
+    pi_assert (string(cpu::featureName(cpu::ARM_CRC32)) == "crc32");
+
+    string text = cpu::describe();
+    pi_assert (text.find(':') != string::npos);
+    if (cpu::has(cpu::SSE42)) pi_assert (text.find("sse4.2") != string::npos);
+}
+
+
+void CPUTest::testDispatch()
+{
+    const cpu::Features never = ~(cpu::Features) 0;
+
+    cpu::Dispatch<AnswerFunc> none(answerGeneric);
+    pi_assert (none.function() == answerGeneric && string(none.name()) == "generic");
+
+    // the first matching variant wins
+    cpu::Dispatch<AnswerFunc> d(answerGeneric);
+    d.add(never, answerA, "a").add(0, answerB, "b").add(0, answerA, "a2");
+    pi_assert (d.function()() == 3 && string(d.name()) == "b");
+
+    AnswerFunc f = cpu::Dispatch<AnswerFunc>(answerGeneric).add(never, answerA, "a").function();
+    pi_assert (f() == 1);
+}
+
+
+void CPUTest::testKernel()
+{
+    static const cpu::Dispatch<SumFunc> sum = cpu::Dispatch<SumFunc>(sumGeneric)
+#if defined(PIL_CPU_HAS_X86_VARIANTS)
+        .add(cpu::AVX2, sumAvx2, "avx2")
+#endif
+        ;
+
+    // small integers are summed exactly in any order
+    vector<float> data(1003);
+    float expected = 0;
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = (float) (i % 17);
+        expected += data[i];
+    }
+    pi_assert (sum.function()(&data[0], (int) data.size()) == expected);
+
+#if defined(PIL_CPU_HAS_X86_VARIANTS)
+    pi_assert ((string(sum.name()) == "avx2") == cpu::has(cpu::AVX2));
+#endif
+}
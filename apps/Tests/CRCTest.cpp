@@ -0,0 +1,124 @@
+#include <string.h>
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <base/Utils/crc.h>
+
+using namespace pi;
+using namespace std;
+
+class CRCTest : public pi::TestCase
+{
+public:
+    CRCTest():pi::TestCase("CRCTest"){}
+
+    virtual void run()
+    {
+        testCheckValues();
+        testKernels();
+        testUpdate();
+        testCombine();
+    }
+
+    void testCheckValues();
+    void testKernels();
+    void testUpdate();
+    void testCombine();
+
+    static std::vector<uint8_t> sample(size_t size)
+    {
+        std::vector<uint8_t> data(size);
+        uint32_t seed = 7;
+        for (size_t i = 0; i < size; i++)
+        {
+            seed = seed*1103515245 + 12345;
+            data[i] = (uint8_t) (seed >> 16);
+        }
+        return data;
+    }
+};
+
+CRCTest CRCTestInstance;
+
+
+void CRCTest::testCheckValues()
+{
+    const char* check = "123456789";
+    pi_assert (crc32(check, 9) == 0xCBF43926);
+    pi_assert (crc32c(check, 9) == 0xE3069283);
+    pi_assert (crc32(check, 0) == 0);
+
+    const CRC32Kernel kernels[] = { CRC32_KERNEL_BYTE, CRC32_KERNEL_SLICE8, CRC32_KERNEL_HARDWARE };
+    for (int k = 0; k < 3; k++)
+    {
+        pi_assert (crc32_update(0, check, 9, CRC32_IEEE, kernels[k]) == 0xCBF43926);
+        pi_assert (crc32_update(0, check, 9, CRC32_CASTAGNOLI, kernels[k]) == 0xE3069283);
+    }
+}
+
+
+void CRCTest::testKernels()
+{
+    // every length and alignment around the block sizes of the kernels
+    std::vector<uint8_t> data = sample(4096 + 64);
+    const CRC32Type types[] = { CRC32_IEEE, CRC32_CASTAGNOLI };
+    for (int t = 0; t < 2; t++)
+    {
+        for (size_t offset = 0; offset < 16; offset += 3)
+        {
+            for (size_t length = 0; length < 300; length++)
+            {
+                uint32_t byte = crc32_update(0, &data[offset], length, types[t], CRC32_KERNEL_BYTE);
+                pi_assert (crc32_update(0, &data[offset], length, types[t], CRC32_KERNEL_SLICE8) == byte);
+                pi_assert (crc32_update(0, &data[offset], length, types[t], CRC32_KERNEL_HARDWARE) == byte);
+            }
+        }
+        uint32_t byte = crc32_update(0, &data[1], 4096, types[t], CRC32_KERNEL_BYTE);
+        pi_assert (crc32_update(0, &data[1], 4096, types[t]) == byte);
+    }
+}
+
+
+void CRCTest::testUpdate()
+{
+    std::vector<uint8_t> data = sample(10000);
+    uint32_t whole = crc32(&data[0], (int) data.size());
+
+    CRC32 crc;
+    for (size_t pos = 0; pos < data.size(); pos += 777)
+        crc.update(&data[pos], std::min<size_t>(777, data.size() - pos));
+    pi_assert (crc.checksum() == whole);
+
+    crc.reset();
+    crc.update(0, 0);
+    pi_assert (crc.checksum() == 0);
+
+    CRC32 crcC(CRC32_CASTAGNOLI);
+    crcC.update(&data[0], 5000);
+    crcC.update(&data[5000], 5000);
+    pi_assert (crcC.checksum() == crc32c(&data[0], data.size()));
+}
+
+
+void CRCTest::testCombine()
+{
+    std::vector<uint8_t> data = sample(100000);
+    const CRC32Type types[] = { CRC32_IEEE, CRC32_CASTAGNOLI };
+    for (int t = 0; t < 2; t++)
+    {
+        uint32_t whole = crc32_update(0, &data[0], data.size(), types[t]);
+
+        // checksums of chunks, merged in order
+        const size_t chunk = 16384;
+        uint32_t merged = 0;
+        for (size_t pos = 0; pos < data.size(); pos += chunk)
+        {
+            size_t n = std::min(chunk, data.size() - pos);
+            merged = crc32_combine(merged, crc32_update(0, &data[pos], n, types[t]), n, types[t]);
+        }
+        pi_assert (merged == whole);
+
+        uint32_t first = crc32_update(0, &data[0], 1, types[t]);
+        pi_assert (crc32_combine(first, 0, 0, types[t]) == first);
+    }
+}
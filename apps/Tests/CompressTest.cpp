@@ -0,0 +1,221 @@
+#include <string.h>
+#include <sstream>
+
+#include <base/Utils/TestCase.h>
+#include <base/Debug/Exception.h>
+#include <base/Compress/lzfse++.h>
+#include <base/Compress/LZFSEStream.h>
+
+using namespace pi;
+using namespace pi::compress;
+using namespace std;
+
+class CompressTest : public pi::TestCase
+{
+public:
+    CompressTest():pi::TestCase("CompressTest"){}
+
+    virtual void run()
+    {
+        testBuffer();
+        testStream();
+        testParallel();
+        testRandomAccess();
+        testCorruption();
+    }
+
+    void testBuffer();
+    void testStream();
+    void testParallel();
+    void testRandomAccess();
+    void testCorruption();
+
+    static std::vector<uint8_t> sample(size_t size)
+    {
+        // compressible text with some noise
+        std::vector<uint8_t> data(size);
+        uint32_t seed = 12345;
+        for (size_t i = 0; i < size; i++)
+        {
+            seed = seed*1103515245 + 12345;
+            data[i] = (i % 7 == 0) ? (uint8_t) (seed >> 24) : (uint8_t) ('a' + i % 13);
+        }
+        return data;
+    }
+};
+
+CompressTest CompressTestInstance;
+
+
+void CompressTest::testBuffer()
+{
+    // incompressible input must not need a retry
+    std::vector<uint8_t> in(1000), packed, out;
+    uint32_t seed = 1;
+    for (size_t i = 0; i < in.size(); i++)
+    {
+        seed = seed*1103515245 + 12345;
+        in[i] = (uint8_t) (seed >> 16);
+    }
+    pi_assert (lzfse_encode(in, packed) == 0);
+    pi_assert (packed.size() <= in.size() + 12);
+    pi_assert (lzfse_decode(packed, out) == 0);
+    pi_assert (out == in);
+}
+
+
+void CompressTest::testStream()
+{
+    std::vector<uint8_t> in = sample(100000);
+
+    std::stringstream buffer;
+    StreamChunkSink sink(buffer);
+    LZFSEChunkWriter writer(sink, 4096, 0);
+    // uneven writes across block boundaries
+    for (size_t pos = 0; pos < in.size(); pos += 1000)
+        writer.write(&in[pos], std::min<size_t>(1000, in.size() - pos));
+    writer.close();
+    pi_assert (writer.bytesIn() == in.size());
+    pi_assert (writer.bytesOut() == buffer.str().size());
+    pi_assert (writer.bytesOut() < in.size());
+
+    buffer.seekg(0);
+    StreamChunkSource source(buffer);
+    LZFSEChunkReader reader(source, 0);
+    pi_assert (reader.blockSize() == 4096);
+
+    std::vector<uint8_t> out(in.size() + 10);
+    size_t n = 0, r;
+    while ((r = reader.read(&out[n], std::min<size_t>(777, out.size() - n))) > 0) n += r;
+    pi_assert (n == in.size());
+    out.resize(n);
+    pi_assert (out == in);
+
+    // file descriptors
+    FILE* file = tmpfile();
+    {
+        FileChunkSink fileSink(fileno(file));
+        LZFSEChunkWriter fileWriter(fileSink, 4096, 2);
+        fileWriter.write(&in[0], in.size());
+    }
+    fseek(file, 0, SEEK_SET);
+    FileChunkSource fileSource(fileno(file));
+    LZFSEChunkReader fileReader(fileSource, 2);
+    pi_assert (fileSource.seekable() && fileReader.size() == in.size());
+    std::vector<uint8_t> part(5000);
+    fileReader.readAt(50000, &part[0], part.size());
+    fclose(file);
+    pi_assert (memcmp(&part[0], &in[50000], part.size()) == 0);
+
+    // empty input
+    std::vector<uint8_t> empty, packed;
+    lzfse_compress_chunked(empty, packed);
+    lzfse_decompress_chunked(packed, out);
+    pi_assert (out.empty());
+}
+
+
+void CompressTest::testParallel()
+{
+    std::vector<uint8_t> in = sample(1000000), packed, packed1, out;
+
+    lzfse_compress_chunked(in, packed, 65536, 4);
+    lzfse_compress_chunked(in, packed1, 65536, 0);
+    // blocks are independent, the output is the same for any thread count
+    pi_assert (packed == packed1);
+
+    lzfse_decompress_chunked(packed, out, 4);
+    pi_assert (out == in);
+
+    MemoryChunkSource source(&packed[0], packed.size());
+    LZFSEChunkReader reader(source, 3);
+    std::vector<uint8_t> seq(in.size());
+    pi_assert (reader.read(&seq[0], seq.size()) == in.size());
+    pi_assert (seq == in);
+    uint8_t extra;
+    pi_assert (reader.read(&extra, 1) == 0);
+}
+
+
+void CompressTest::testRandomAccess()
+{
+    std::vector<uint8_t> in = sample(300000), packed;
+    lzfse_compress_chunked(in, packed, 8192, 2);
+
+    MemoryChunkSource source(&packed[0], packed.size());
+    LZFSEChunkReader reader(source, 2);
+    pi_assert (reader.size() == in.size());
+    pi_assert (reader.blockCount() == (int) ((in.size() + 8191) / 8192));
+
+    std::vector<uint8_t> out(50000);
+    reader.readAt(12345, &out[0], out.size());
+    pi_assert (memcmp(&out[0], &in[12345], out.size()) == 0);
+    reader.readAt(in.size() - 10, &out[0], 10);
+    pi_assert (memcmp(&out[0], &in[in.size() - 10], 10) == 0);
+
+    try
+    {
+        reader.readAt(in.size() - 10, &out[0], 11);
+        pi_assert (false);
+    }
+    catch (RangeException&)
+    {
+    }
+
+    // without the index the block headers are scanned
+    std::vector<uint8_t> noIndex(packed.begin(), packed.end() - 20 - 8*reader.blockCount());
+    MemoryChunkSource source2(&noIndex[0], noIndex.size());
+    LZFSEChunkReader reader2(source2, 0);
+    pi_assert (reader2.size() == in.size());
+    reader2.readAt(200000, &out[0], 1000);
+    pi_assert (memcmp(&out[0], &in[200000], 1000) == 0);
+}
+
+
+void CompressTest::testCorruption()
+{
+    std::vector<uint8_t> in = sample(50000), packed, out;
+    lzfse_compress_chunked(in, packed, 16384, 2);
+
+    // flip a bit in the crc of the second block
+    MemoryChunkSource source(&packed[0], packed.size());
+    LZFSEChunkReader reader(source, 0);
+    pi_assert (reader.blockCount() == 4);
+    std::vector<uint8_t> bad(packed);
+    size_t second = 8 + 12 + (bad[8 + 4] | bad[8 + 5] << 8 | bad[8 + 6] << 16 | bad[8 + 7] << 24);
+    bad[second + 8] ^= 1;
+
+    try
+    {
+        lzfse_decompress_chunked(bad, out, 2);
+        pi_assert (false);
+    }
+    catch (DataFormatException&)
+    {
+    }
+
+    MemoryChunkSource badSource(&bad[0], bad.size());
+    LZFSEChunkReader badReader(badSource, 2);
+    out.resize(in.size());
+    // the first block is still fine
+    badReader.readAt(0, &out[0], 16384);
+    pi_assert (memcmp(&out[0], &in[0], 16384) == 0);
+    try
+    {
+        badReader.read(&out[0], out.size());
+        pi_assert (false);
+    }
+    catch (DataFormatException&)
+    {
+    }
+
+    try
+    {
+        std::vector<uint8_t> notChunked(in.begin(), in.begin() + 100);
+        lzfse_decompress_chunked(notChunked, out);
+        pi_assert (false);
+    }
+    catch (DataFormatException&)
+    {
+    }
+}
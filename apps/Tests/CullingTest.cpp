@@ -0,0 +1,174 @@
+#if defined(HAS_PI_GUI)
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <gui/gl/Culling.h>
+#include <gui/gl/PosedObject.h>
+#include <gui/gl/ColorfulLine.h>
+
+using namespace pi;
+using namespace pi::gl;
+using namespace std;
+
+class CullingTest : public pi::TestCase
+{
+public:
+    CullingTest():pi::TestCase("CullingTest"){}
+
+    virtual void run()
+    {
+        testBoxes();
+        testFrustum();
+        testBVH();
+    }
+
+    // column major, as glFrustum would load them
+    static void perspective(float* p, float n, float f)
+    {
+        std::fill(p, p + 16, 0.f);
+        p[0]  = 1;                  // 90 degrees field of view, square
+        p[5]  = 1;
+        p[10] = -(f + n) / (f - n);
+        p[11] = -1;
+        p[14] = -2 * f * n / (f - n);
+    }
+
+    static void identity(float* m)
+    {
+        std::fill(m, m + 16, 0.f);
+        m[0] = m[5] = m[10] = m[15] = 1;
+    }
+
+    void testBoxes()
+    {
+        BoundingBox box;
+        pi_assert(box.empty() && box.radius() == 0);
+        box.extend(Point3f(1, 2, 3));
+        box.extend(Point3f(-1, 0, 3));
+        pi_assert(!box.empty() && box.min.x == -1 && box.max.y == 2 && box.min.z == 3);
+
+        // a quarter turn about z
+        SE3f turn(SO3f(0, 0, sinf(M_PI / 4), cosf(M_PI / 4)), Point3f(10, 0, 0));
+        BoundingBox moved = BoundingBox(Point3f(0, 0, 0), Point3f(2, 1, 1)).transformed(turn);
+        pi_assert(fabs(moved.min.x - 9) < 1e-5 && fabs(moved.max.x - 10) < 1e-5 && fabs(moved.max.y - 2) < 1e-5);
+
+        // objects report what they draw
+        std::vector<ColorfulPoint> track;
+        track.push_back(ColorfulPoint(Point3f(0, 0, 0)));
+        track.push_back(ColorfulPoint(Point3f(1, 5, 0)));
+        GL_ObjectPtr line(new ColorfulLine(track));
+        PosedObject  posed(line);
+        posed.setPose(SE3f(SO3f(), Point3f(0, 0, 7)));
+        BoundingBox b;
+        pi_assert(posed.bounds(b) && b.max.y == 5 && b.min.z == 7);
+        pi_assert(!PosedObject().bounds(b) && !GL_Object().bounds(b));
+    }
+
+    void testFrustum()
+    {
+        float p[16], m[16];
+        perspective(p, 1, 100);
+        identity(m);
+        Frustum frustum(p, m, 500);
+
+        int planes = 0x3f;
+        pi_assert(frustum.test(BoundingBox(Point3f(-1, -1, -10), Point3f(1, 1, -9)), planes) == Frustum::Inside);
+        pi_assert(planes == 0);
+        planes = 0x3f;
+        pi_assert(frustum.test(BoundingBox(Point3f(-1, -1, 1), Point3f(1, 1, 2)), planes) == Frustum::Outside);
+        planes = 0x3f;
+        pi_assert(frustum.test(BoundingBox(Point3f(20, 0, -10), Point3f(21, 1, -9)), planes) == Frustum::Outside);
+        planes = 0x3f;
+        pi_assert(frustum.test(BoundingBox(Point3f(9, 0, -10), Point3f(11, 1, -9)), planes) == Frustum::Intersecting);
+        planes = 0x3f;
+        pi_assert(frustum.test(BoundingBox(Point3f(0, 0, -200), Point3f(1, 1, -150)), planes) == Frustum::Outside);
+
+        // a unit box 50 units away is about 1 * 500 / 50 pixels across
+        float px = frustum.pixels(BoundingBox(Point3f(-0.5f, -0.5f, -50.5f), Point3f(0.5f, 0.5f, -49.5f)));
+        pi_assert(px > 8 && px < 10);
+        pi_assert(frustum.pixels(BoundingBox(Point3f(-1, -1, 0), Point3f(1, 1, 1))) > 1e20f);
+
+        // the camera moved back: the modelview translates by -20 along z
+        m[14] = -20;
+        Frustum moved(p, m, 500);
+        planes = 0x3f;
+        pi_assert(moved.test(BoundingBox(Point3f(-1, -1, 1), Point3f(1, 1, 2)), planes) == Frustum::Inside);
+    }
+
+    void testBVH()
+    {
+        float p[16], m[16];
+        perspective(p, 1, 1000);
+        identity(m);
+        Frustum frustum(p, m, 500);
+
+        // a field of small boxes in front of and around the camera
+        const int n = 5000;
+        std::vector<BoundingBox> boxes(n);
+        std::vector<int>         items;
+        srand(3);
+        for (int i = 0; i < n; i++)
+        {
+            Point3f c(rand() % 400 - 200.f, rand() % 400 - 200.f, rand() % 400 - 300.f);
+            float   s = (rand() % 100) * 0.02f;
+            boxes[i] = BoundingBox(c, c + Point3f(s, s, s));
+            if (i % 10) items.push_back(i);     // not all of them are indexed
+        }
+
+        BVH bvh;
+        bvh.build(boxes, items);
+        pi_assert(bvh.size() == items.size());
+        size_t nodes = checkQuery(bvh, frustum, boxes, items, 0);
+        pi_assert(nodes < items.size() / 2);
+        pi_assert(checkQuery(bvh, frustum, boxes, items, 3) <= nodes);
+
+        // small moves are refitted, large ones ask for a rebuild
+        for (int i = 0; i < n; i++) boxes[i].min.z -= 0.5f, boxes[i].max.z -= 0.5f;
+        pi_assert(bvh.refit(boxes));
+        checkQuery(bvh, frustum, boxes, items, 0);
+        for (int i = 0; i < n; i++)
+        {
+            Point3f c(rand() % 4000 - 2000.f, rand() % 4000 - 2000.f, rand() % 400 - 300.f);
+            boxes[i] = BoundingBox(c, c + Point3f(1, 1, 1));
+        }
+        pi_assert(!bvh.refit(boxes));
+        checkQuery(bvh, frustum, boxes, items, 0);
+        bvh.build(boxes, items);
+        pi_assert(bvh.refit(boxes));
+        pi_assert(checkQuery(bvh, frustum, boxes, items, 0) < items.size() / 10);
+    }
+
+    size_t checkQuery(const BVH& bvh, const Frustum& frustum, const std::vector<BoundingBox>& boxes,
+                      const std::vector<int>& items, float minPixels)
+    {
+        // the same result as testing every box
+        std::vector<char> found(boxes.size(), 0);
+        CullStats stats;
+        bvh.query(frustum, minPixels, boxes, stats, [&found](int i) { found[i]++; });
+
+        int missing = 0, twice = 0, extra = 0, visible = 0;
+        for (size_t k = 0; k < items.size(); k++)
+        {
+            int  i      = items[k];
+            int  planes = 0x3f;
+            bool inside = frustum.test(boxes[i], planes) != Frustum::Outside &&
+                          (minPixels <= 0 || frustum.pixels(boxes[i]) >= minPixels);
+            visible += inside;
+            if (inside && !found[i]) missing++;
+            if (found[i] > 1) twice++;
+            if (!inside && found[i]) extra++;
+        }
+        pi_assert(visible > 0 && missing == 0 && twice == 0 && extra == 0);
+        pi_assert(stats.outside + stats.small + visible == items.size());
+        return stats.nodes;
+    }
+};
+
+CullingTest CullingTestInstance;
+
+#endif // HAS_PI_GUI
@@ -0,0 +1,233 @@
+#include <base/Utils/TestCase.h>
+#include <base/Types/DataStream2.h>
+
+using namespace pi;
+using namespace std;
+
+struct PaddedRecord
+{
+    uint8_t     flag;
+    double      value;
+
+    int write(RDataStream2& ds) const
+    {
+        return ds.write(flag) || ds.write(value) ? -1 : 0;
+    }
+
+    int read(RDataStream2& ds)
+    {
+        return ds.read(flag) || ds.read(value) ? -1 : 0;
+    }
+};
+
+class DataStreamTest : public pi::TestCase
+{
+public:
+    DataStreamTest():pi::TestCase("DataStreamTest"){}
+
+    virtual void run()
+    {
+        testRoundTrip();
+        testWireFormat();
+        testSpans();
+        testArena();
+        testErrors();
+        testElements();
+    }
+
+    void testRoundTrip();
+    void testWireFormat();
+    void testSpans();
+    void testArena();
+    void testErrors();
+    void testElements();
+};
+
+DataStreamTest DataStreamTestInstance;
+
+
+void DataStreamTest::testRoundTrip()
+{
+    RDataStream2 ds;
+    ds.setHeader(0x1234, 2);
+
+    std::vector<double> values;
+    for (int i = 0; i < 1000; i++) values.push_back(i * 0.5);
+    float points[3] = { 1.f, -2.f, 3.5f };
+    std::vector<std::string> names;
+    names.push_back("a");
+    names.push_back("");
+    names.push_back("long name");
+
+    ds << (int8_t) -1 << (uint16_t) 65535 << (int32_t) -100000 << (int64_t) -(1LL << 40)
+       << 1.25f << 2.5 << true << std::string("hello") << "world" << values << names;
+    ds.writeArray(points, 3);
+
+    RDataStream2 in(ds.data(), ds.size());
+    int8_t i8 = 0; uint16_t u16 = 0; int32_t i32 = 0; int64_t i64 = 0; float f = 0; double d = 0; bool b = false;
+    std::string s1, s2;
+    std::vector<double> v;
+    std::vector<std::string> n;
+    float p[3];
+    in >> i8 >> u16 >> i32 >> i64 >> f >> d >> b >> s1 >> s2 >> v >> n;
+    pi_assert (in.readArray(p, 3) == 0);
+
+    pi_assert (i8 == -1 && u16 == 65535 && i32 == -100000 && i64 == -(1LL << 40));
+    pi_assert (f == 1.25f && d == 2.5 && b);
+    pi_assert (s1 == "hello" && s2 == "world");
+    pi_assert (v == values && n == names);
+    pi_assert (p[0] == 1.f && p[1] == -2.f && p[2] == 3.5f);
+    pi_assert (in.remaining() == 0);
+
+    uint32_t magic, ver;
+    in.getHeader(magic, ver);
+    pi_assert (magic == 0x1234 && ver == 2);
+
+    // copies own their data
+    RDataStream2 copy(ds);
+    ds.clear();
+    ds << (int32_t) 7;
+    copy.rewind();
+    copy >> i8;
+    pi_assert (i8 == -1 && copy.size() == in.size());
+}
+
+
+void DataStreamTest::testWireFormat()
+{
+    RDataStream2 ds;
+    ds.setHeader(0x5044, 1);
+    ds << (uint32_t) 0x01020304 << 1.0f << std::string("ab");
+
+    const uint8_t expected[] = {
+        0x44, 0x50, 0x01, 0x00,     // magic, version
+        0x16, 0x00, 0x00, 0x00,     // size
+        0x04, 0x03, 0x02, 0x01,
+        0x00, 0x00, 0x80, 0x3F,     // 1.0f
+        0x02, 0x00, 0x00, 0x00, 'a', 'b'
+    };
+    pi_assert (ds.size() == sizeof(expected));
+    pi_assert (memcmp(ds.data(), expected, sizeof(expected)) == 0);
+
+    // an empty stream still has a valid header
+    RDataStream2 empty;
+    pi_assert (empty.size() == 8);
+    pi_assert (empty.data()[4] == 8);
+}
+
+
+void DataStreamTest::testSpans()
+{
+    RDataStream2 inner;
+    inner << std::string("nested") << (int32_t) 42;
+
+    RDataStream2 outer;
+    outer << std::string("topic") << inner << (int32_t) 1;
+
+    DataSpan topic;
+    RDataStream2 view;
+    int32_t tail;
+    RDataStream2 in(outer.span());
+    in >> topic >> view >> tail;
+
+    pi_assert (topic == "topic");
+    pi_assert (topic.data > outer.data() && topic.data < outer.data() + outer.size());
+    pi_assert (view.readOnly() && view.size() == inner.size());
+    pi_assert (tail == 1);
+
+    DataSpan name;
+    int32_t value = 0;
+    view >> name >> value;
+    pi_assert (name.toString() == "nested" && value == 42);
+}
+
+
+void DataStreamTest::testArena()
+{
+    DataStreamArena arena(4096);
+    {
+        RDataStream2 a(&arena), b(&arena);
+        for (int i = 0; i < 100; i++)
+        {
+            a << (int32_t) i;
+            b << (double) i;
+        }
+        // b outgrew its first block
+        for (int i = 0; i < 1000; i++) b << (double) i;
+
+        RDataStream2 in(a.data(), a.size());
+        int32_t v = -1;
+        in.seek(99 * 4, SEEK_CUR);
+        in >> v;
+        pi_assert (v == 99);
+        pi_assert (arena.bytesUsed() > 0);
+    }
+    size_t reserved = arena.bytesReserved();
+    arena.reset();
+    pi_assert (arena.bytesUsed() == 0);
+
+    RDataStream2 c(&arena);
+    c << std::string("reuse");
+    pi_assert (arena.bytesReserved() == reserved);
+}
+
+
+void DataStreamTest::testErrors()
+{
+    RDataStream2 ds;
+    ds << (int16_t) 1 << std::string("truncated");
+
+    // a truncated copy fails to read and keeps its position
+    RDataStream2 in(ds.data(), ds.size() - 1);
+    int16_t i16;
+    std::string s;
+    pi_assert (in.read(i16) == 0);
+    pi_assert (in.read(s) == -1);
+    pi_assert (in.position() == 10);
+
+    // so does a vector whose last element is cut
+    RDataStream2 strings;
+    strings << std::vector<std::string>(2, "ab");
+    RDataStream2 cut(strings.data(), strings.size() - 1);
+    std::vector<std::string> names;
+    pi_assert (cut.read(names) == -1 && cut.position() == RDataStream2::HEADER_SIZE);
+    int32_t i32;
+    in.seek(-3, SEEK_END);
+    pi_assert (in.read(i32) == -1);
+
+    try
+    {
+        in << (int32_t) 1;
+        pi_assert (false);
+    }
+    catch (IllegalStateException&)
+    {
+    }
+}
+
+
+void DataStreamTest::testElements()
+{
+    std::vector<PaddedRecord> records(2);
+    records[0].flag = 1; records[0].value = 0.5;
+    records[1].flag = 2; records[1].value = -4.0;
+    std::vector<bool> flags;
+    flags.push_back(true);
+    flags.push_back(false);
+    flags.push_back(true);
+
+    RDataStream2 ds;
+    ds << records << flags;
+
+    // fields one by one, without the padding of PaddedRecord, and a byte per bool
+    pi_assert (sizeof(PaddedRecord) > 9);
+    pi_assert (ds.size() == RDataStream2::HEADER_SIZE + 4 + 2*9 + 4 + 3);
+
+    RDataStream2 in(ds.data(), ds.size());
+    std::vector<PaddedRecord> r;
+    std::vector<bool> f;
+    in >> r >> f;
+    pi_assert (r.size() == 2 && r[0].flag == 1 && r[0].value == 0.5);
+    pi_assert (r[1].flag == 2 && r[1].value == -4.0);
+    pi_assert (f == flags && in.remaining() == 0);
+}
@@ -14,11 +14,13 @@ public:
         testEcho();
         testSendToReceiveFrom();
         testBroadcast();
+        testBatch();
     }
 
     void testEcho();
     void testSendToReceiveFrom();
     void testBroadcast();
+    void testBatch();
 
 };
 DatagramSocketTest DatagramSocketTestInstance;
@@ -85,3 +87,49 @@ void DatagramSocketTest::testBroadcast()
     pi_assert (std::string(buffer, n) == "hello");
     ss.close();
 }
+
+
+void DatagramSocketTest::testBatch()
+{
+    DatagramSocket receiver(SocketAddress("127.0.0.1", 0));
+    DatagramSocket sender(SocketAddress("127.0.0.1", 0));
+    SocketAddress target("127.0.0.1", receiver.address().port());
+#if PIL_OS == PIL_OS_LINUX
+    receiver.setReceiveTimestamps(true);
+#endif
+
+    DatagramBatch out(8, 256);
+    for (int i = 0; i < 8; i++)
+    {
+        std::string msg = "packet" + std::string(1, (char) ('0' + i));
+        out.add(msg.data(), (int) msg.size(), target);
+    }
+    pi_assert (out.count() == 8);
+    pi_assert (sender.sendBatch(out) == 8);
+
+    DatagramBatch in(16, 256);
+    int received = 0;
+    while (received < 8)
+    {
+        int n = receiver.receiveBatch(in);
+        pi_assert (n > 0);
+        for (int i = 0; i < n; i++)
+        {
+            std::string msg = "packet" + std::string(1, (char) ('0' + received + i));
+            pi_assert (std::string(in.data(i), in.length(i)) == msg);
+            pi_assert (in.address(i) == sender.address());
+            pi_assert (!in.truncated(i));
+#if PIL_OS == PIL_OS_LINUX
+            pi_assert (in.timestamp(i) > 0);
+#endif
+        }
+        received += n;
+    }
+
+    DatagramBatch small(1, 4);
+    sender.sendTo("truncated", 9, target);
+    pi_assert (receiver.receiveBatch(small) == 1);
+    pi_assert (small.length(0) == 4);
+    pi_assert (std::string(small.data(0), 4) == "trun");
+    pi_assert (small.truncated(0));
+}
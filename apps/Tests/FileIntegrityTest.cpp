@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <base/Utils/TestCase.h>
+#include <base/Debug/Exception.h>
+#include <base/Crypto/MD5.h>
+#include <base/Crypto/FileIntegrity.h>
+#include <base/Crypto/Crypto_utils.h>
+
+using namespace pi;
+using namespace pi::crypto;
+using namespace std;
+
+class FileIntegrityTest : public pi::TestCase
+{
+public:
+    FileIntegrityTest():pi::TestCase("FileIntegrityTest"){}
+
+    virtual void run()
+    {
+        testMD5();
+        testTree();
+        testManifest();
+    }
+
+    void testMD5();
+    void testTree();
+    void testManifest();
+
+    static std::string tempName(const char* name)
+    {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "/tmp/pil_fi_%d_%s", (int) getpid(), name);
+        return buf;
+    }
+
+    static std::vector<uint8_t> sample(size_t size, uint32_t seed)
+    {
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            seed = seed*1103515245 + 12345;
+            data[i] = (uint8_t) (seed >> 24);
+        }
+        return data;
+    }
+
+    static void writeFile(const std::string& name, const std::vector<uint8_t>& data)
+    {
+        FILE* f = fopen(name.c_str(), "wb");
+        pi_assert (f != NULL);
+        if (!data.empty()) fwrite(&data[0], 1, data.size(), f);
+        fclose(f);
+    }
+
+    static void setMtime(const std::string& name, time_t t)
+    {
+        struct utimbuf times;
+        times.actime  = t;
+        times.modtime = t;
+        pi_assert (utime(name.c_str(), &times) == 0);
+    }
+};
+
+FileIntegrityTest FileIntegrityTestInstance;
+
+
+void FileIntegrityTest::testMD5()
+{
+    std::vector<uint8_t> md5;
+    md5_data(std::string(), md5);
+    pi_assert (hex2str(md5) == "d41d8cd98f00b204e9800998ecf8427e");
+    md5_data(std::string("abc"), md5);
+    pi_assert (hex2str(md5) == "900150983cd24fb0d6963f7d28e17f72");
+
+    // pieces of any size and alignment give the same digest
+    std::vector<uint8_t> data = sample(100000, 7), whole;
+    md5_data(data, whole);
+    MD5Engine engine;
+    for (size_t pos = 0, n = 1; pos < data.size(); pos += n, n += 13)
+        engine.update(&data[pos], std::min(n, data.size() - pos));
+    pi_assert (engine.digest() == whole);
+
+    // the engine is reset by finish()
+    engine.update("abc", 3);
+    pi_assert (hex2str(engine.digest()) == "900150983cd24fb0d6963f7d28e17f72");
+
+    std::string name = tempName("md5");
+    writeFile(name, data);
+    pi_assert (md5_file(name, md5) == 0);
+    pi_assert (md5 == whole);
+
+    engine.reset();
+    pi_assert (md5_file_range(name, 4097, 50000, engine) == 0);
+    std::vector<uint8_t> part;
+    md5_data(&data[4097], 50000, part);
+    pi_assert (engine.digest() == part);
+    pi_assert (md5_file_range(name, 60000, 50000, engine) == -1);
+
+    writeFile(name, std::vector<uint8_t>());
+    pi_assert (md5_file(name, md5) == 0);
+    pi_assert (hex2str(md5) == "d41d8cd98f00b204e9800998ecf8427e");
+    unlink(name.c_str());
+
+    pi_assert (md5_file(name, md5) == -1);
+}
+
+
+void FileIntegrityTest::testTree()
+{
+    std::string name = tempName("tree");
+    std::vector<uint8_t> data = sample(1000000, 3);
+    writeFile(name, data);
+
+    // the tree hash does not depend on the number of threads
+    std::vector<uint8_t> h0, h1, h4, other;
+    pi_assert (md5_file_tree(name, h0, 65536, 0) == 0);
+    pi_assert (md5_file_tree(name, h1, 65536, 1) == 0);
+    pi_assert (md5_file_tree(name, h4, 65536, 4) == 0);
+    pi_assert (h0.size() == 16 && h0 == h1 && h0 == h4);
+
+    // but on the block size
+    pi_assert (md5_file_tree(name, other, 32768, 4) == 0);
+    pi_assert (other != h0);
+
+    // root = MD5(le64 block size, le64 size, leaf digests)
+    std::vector<uint8_t> leaves(16, 0);
+    leaves[0] = 0x00; leaves[1] = 0x00; leaves[2] = 0x01;                  // 65536
+    leaves[8] = 0x40; leaves[9] = 0x42; leaves[10] = 0x0f;                 // 1000000
+    for (size_t off = 0; off < data.size(); off += 65536)
+    {
+        std::vector<uint8_t> leaf;
+        md5_data(&data[off], (int) std::min<size_t>(65536, data.size() - off), leaf);
+        leaves.insert(leaves.end(), leaf.begin(), leaf.end());
+    }
+    std::vector<uint8_t> root;
+    md5_data(leaves, root);
+    pi_assert (root == h0);
+
+    unlink(name.c_str());
+}
+
+
+void FileIntegrityTest::testManifest()
+{
+    std::string a = tempName("a"), b = tempName("b"), manifest = tempName("manifest");
+    writeFile(a, sample(300000, 1));
+    writeFile(b, sample(1000, 2));
+    // files changed within the last moments would be hashed again
+    time_t old = time(NULL) - 3600;
+    setMtime(a, old);
+    setMtime(b, old);
+
+    std::vector<std::string> paths;
+    paths.push_back(a);
+    paths.push_back(b);
+
+    FileIntegrity fi(2, 65536);
+    std::vector<FileIntegrity::Result> r = fi.check(paths);
+    pi_assert (r.size() == 2);
+    pi_assert (r[0].status == FileIntegrity::ADDED && r[1].status == FileIntegrity::ADDED);
+
+    std::vector<uint8_t> tree;
+    md5_file_tree(a, tree, 65536, 0);
+    pi_assert (fi.find(a) && fi.find(a)->hash == tree && fi.find(a)->size == 300000);
+
+    r = fi.check(paths);
+    pi_assert (r[0].status == FileIntegrity::UNCHANGED && r[1].status == FileIntegrity::UNCHANGED);
+    r = fi.check(paths, true);
+    pi_assert (r[0].status == FileIntegrity::VERIFIED && r[1].status == FileIntegrity::VERIFIED);
+
+    // only the mtime changed
+    setMtime(a, old + 10);
+    r = fi.check(paths);
+    pi_assert (r[0].status == FileIntegrity::VERIFIED && r[1].status == FileIntegrity::UNCHANGED);
+
+    // same size, other content
+    writeFile(b, sample(1000, 5));
+    setMtime(b, old + 20);
+    r = fi.check(paths);
+    pi_assert (r[0].status == FileIntegrity::UNCHANGED && r[1].status == FileIntegrity::MODIFIED);
+
+    // a fresh change is not trusted until it is old enough
+    writeFile(b, sample(1000, 6));
+    r = fi.check(paths);
+    pi_assert (r[1].status == FileIntegrity::MODIFIED && fi.find(b)->mtime == -1);
+    r = fi.check(paths);
+    pi_assert (r[1].status == FileIntegrity::VERIFIED);
+    setMtime(b, old + 30);
+
+    fi.save(manifest);
+    FileIntegrity loaded(0);
+    pi_assert (loaded.load(manifest));
+    pi_assert (loaded.records().size() == 2);
+    pi_assert (loaded.find(a)->blockSize == 65536 && loaded.find(a)->hash == tree);
+    r = loaded.check(paths);
+    pi_assert (r[0].status == FileIntegrity::UNCHANGED && r[1].status == FileIntegrity::VERIFIED);
+
+    unlink(a.c_str());
+    r = loaded.check(paths);
+    pi_assert (r[0].status == FileIntegrity::MISSING && loaded.find(a) != NULL);
+    pi_assert (loaded.remove(a) && !loaded.remove(a));
+
+    // plain MD5 records match md5_file()
+    FileIntegrity plain(1);
+    paths.resize(1);
+    paths[0] = b;
+    plain.check(paths);
+    std::vector<uint8_t> md5;
+    md5_file(b, md5);
+    pi_assert (plain.find(b)->blockSize == 0 && plain.find(b)->hash == md5);
+
+    pi_assert (!plain.load(tempName("none")));
+    FILE* f = fopen(manifest.c_str(), "w");
+    fputs("sha1\t00\t1\t1\t/x\n", f);
+    fclose(f);
+    try
+    {
+        plain.load(manifest);
+        pi_assert (false);
+    }
+    catch (DataFormatException&)
+    {
+    }
+
+    unlink(b.c_str());
+    unlink(manifest.c_str());
+}
@@ -0,0 +1,133 @@
+#include <string>
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <base/Thread/Thread.h>
+#include <base/Thread/MPSCQueue.h>
+#include <base/Thread/TripleBuffer.h>
+
+using namespace pi;
+using namespace std;
+
+class HandoffTest : public pi::TestCase
+{
+public:
+    HandoffTest():pi::TestCase("HandoffTest"){}
+
+    virtual void run()
+    {
+        testQueue();
+        testQueueThreads();
+        testTripleBuffer();
+    }
+
+    void testQueue()
+    {
+        MPSCQueue<string> queue;
+        pi_assert(queue.empty());
+        queue.push("a");
+        queue.push("b");
+        queue.push("c");
+        pi_assert(!queue.empty());
+
+        string all;
+        pi_assert(queue.consume([&all](string& s) { all += s; }) == 3);
+        pi_assert(all == "abc" && queue.empty());
+        pi_assert(queue.consume([&all](string& s) { all += s; }) == 0);
+
+        // a throwing consumer drops the rest of its batch only
+        queue.push("x");
+        queue.push("y");
+        bool thrown = false;
+        try
+        {
+            queue.consume([](string&) { throw 1; });
+        }
+        catch (int)
+        {
+            thrown = true;
+        }
+        pi_assert(thrown && queue.empty());
+
+        // left over items are deleted with the queue
+        queue.push("z");
+    }
+
+    void testQueueThreads()
+    {
+        const int THREADS = 4, ROUNDS = 50000;
+        MPSCQueue<int> queue;
+
+        std::vector<pi::Thread*> threads;
+        for (int t = 0; t < THREADS; t++)
+        {
+            threads.push_back(new pi::Thread);
+            threads.back()->startFunc([&queue, t]() {
+                for (int i = 0; i < ROUNDS; i++) queue.push(t * ROUNDS + i);
+            });
+        }
+
+        // every producer's items arrive once and in order
+        std::vector<int> last(THREADS, -1);
+        int received = 0, unordered = 0;
+        while (received < THREADS * ROUNDS)
+        {
+            received += (int) queue.consume([&](int& v) {
+                int t = v / ROUNDS;
+                if (v % ROUNDS != last[t] + 1) unordered++;
+                last[t] = v % ROUNDS;
+            });
+        }
+        for (int t = 0; t < THREADS; t++)
+        {
+            threads[t]->join();
+            delete threads[t];
+        }
+        pi_assert(unordered == 0 && queue.empty());
+    }
+
+    struct State
+    {
+        std::vector<long> values;
+        long              stamp;
+        State(): stamp(0) {}
+    };
+
+    void testTripleBuffer()
+    {
+        TripleBuffer<State> buffer;
+        pi_assert(!buffer.update() && buffer.front().stamp == 0);
+
+        const long ROUNDS = 20000;
+        pi::Thread writer;
+        writer.startFunc([&buffer, ROUNDS]() {
+            for (long i = 1; i <= ROUNDS; i++)
+            {
+                State& s = buffer.back();
+                s.stamp = i;
+                s.values.assign(16, i);
+                buffer.publish();
+            }
+        });
+
+        // the reader sees whole states, never older than the last one
+        long last = 0;
+        int  torn = 0;
+        while (last < ROUNDS)
+        {
+            const State& s = buffer.read();
+            for (size_t i = 0; i < s.values.size(); i++)
+                if (s.values[i] != s.stamp) torn++;
+            if (s.stamp < last) torn++;
+            last = s.stamp;
+        }
+        writer.join();
+        pi_assert(torn == 0);
+        pi_assert(!buffer.update());
+
+        buffer.write(State());
+        pi_assert(buffer.update() && buffer.front().stamp == 0);
+    }
+};
+
+HandoffTest HandoffTestInstance;
@@ -0,0 +1,201 @@
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <base/Thread/Event.h>
+#include <base/Thread/Thread.h>
+#include <base/Thread/SpinLock.h>
+#include <base/Thread/BiasedMutexRW.h>
+#include <base/Thread/SeqLock.h>
+
+using namespace pi;
+using namespace std;
+
+class LockTest : public pi::TestCase
+{
+public:
+    LockTest():pi::TestCase("LockTest"){}
+
+    virtual void run()
+    {
+        testTicketSpinLock();
+        testMCSSpinLock();
+        testBiasedMutexRW();
+        testBiasedRevoke();
+        testSeqLock();
+    }
+
+    template <class M>
+    void testExclusion(M& mutex)
+    {
+        const int THREADS = 4, ROUNDS = 20000;
+        long      counter = 0;
+
+        std::vector<pi::Thread*> threads;
+        for (int t = 0; t < THREADS; t++)
+        {
+            threads.push_back(new pi::Thread);
+            threads.back()->startFunc([&mutex, &counter]() {
+                for (int i = 0; i < ROUNDS; i++)
+                {
+                    typename M::ScopedLock lock(mutex);
+                    long c = counter;
+                    if (i % 1024 == 0) pi::Thread::yield();
+                    counter = c + 1;
+                }
+            });
+        }
+        for (int t = 0; t < THREADS; t++)
+        {
+            threads[t]->join();
+            delete threads[t];
+        }
+        pi_assert(counter == THREADS * ROUNDS);
+    }
+
+    void testTicketSpinLock()
+    {
+        TicketSpinLock lock;
+        pi_assert(lock.tryLock());
+        pi_assert(!lock.tryLock());
+        pi_assert(lock.isLocked());
+        lock.unlock();
+        pi_assert(!lock.isLocked());
+
+        testExclusion(lock);
+    }
+
+    void testMCSSpinLock()
+    {
+        MCSSpinLock a, b;
+        pi_assert(a.tryLock());
+        pi_assert(!a.tryLock());
+
+        // nested locks use separate queue nodes, released in any order
+        b.lock();
+        a.unlock();
+        pi_assert(!a.isLocked());
+        b.unlock();
+        pi_assert(!b.isLocked());
+
+        testExclusion(a);
+    }
+
+    void testBiasedMutexRW()
+    {
+        BiasedMutexRW rw;
+
+        // nested reads, through the slot and the MutexRW
+        rw.readLock();
+        pi_assert(rw.tryReadLock());
+        pi_assert(!rw.tryWriteLock());
+        rw.unlock();
+        pi_assert(!rw.tryWriteLock());
+        rw.unlock();
+
+        pi_assert(rw.tryWriteLock());
+        pi_assert(!rw.readBiased());
+        rw.unlock();
+
+        // writers keep the two halves equal, readers must never see them differ
+        const int THREADS = 4, ROUNDS = 20000;
+        long      a = 0, b = 0;
+        int       torn = 0;
+
+        std::vector<pi::Thread*> threads;
+        for (int t = 0; t < THREADS; t++)
+        {
+            threads.push_back(new pi::Thread);
+            threads.back()->startFunc([&, t]() {
+                for (int i = 0; i < ROUNDS; i++)
+                {
+                    if (t == 0 && i % 16 == 0)
+                    {
+                        ScopedRWLock<BiasedMutexRW> lock(rw, true);
+                        a++;
+                        if (i % 64 == 0) pi::Thread::yield();
+                        b++;
+                    }
+                    else
+                    {
+                        BiasedMutexRW::ScopedReadLock lock(rw);
+                        if (a != b) torn++;
+                    }
+                }
+            });
+        }
+        for (int t = 0; t < THREADS; t++)
+        {
+            threads[t]->join();
+            delete threads[t];
+        }
+
+        pi_assert(torn == 0);
+        pi_assert(a == ROUNDS / 16 && b == a);
+    }
+
+    void testBiasedRevoke()
+    {
+        BiasedMutexRW rw;
+        Event         reading, done;
+        pi::Thread    reader;
+
+        // a fast path reader on another thread blocks tryWriteLock()
+        reader.startFunc([&]() {
+            rw.readLock();
+            reading.set();
+            done.wait();
+            rw.unlock();
+        });
+        reading.wait();
+        pi_assert(!rw.tryWriteLock());
+
+        done.set();
+        reader.join();
+        pi_assert(rw.tryWriteLock());
+        rw.unlock();
+    }
+
+    struct Pose
+    {
+        double x, y, z;
+        long   stamp;
+    };
+
+    void testSeqLock()
+    {
+        SeqLock<Pose> pose;
+        Pose p = pose.read();
+        pi_assert(p.stamp == 0 && p.x == 0);
+
+        const int ROUNDS = 20000;
+        int       torn   = 0;
+
+        pi::Thread writer;
+        writer.startFunc([&pose]() {
+            for (int i = 1; i <= ROUNDS; i++)
+            {
+                Pose q = { (double) i, 2.0 * i, 3.0 * i, i };
+                pose.write(q);
+            }
+        });
+
+        long last = 0;
+        while (last < ROUNDS)
+        {
+            Pose q = pose.read();
+            if (q.x != q.stamp || q.y != 2.0 * q.stamp || q.z != 3.0 * q.stamp || q.stamp < last) torn++;
+            last = q.stamp;
+        }
+        writer.join();
+        pi_assert(torn == 0);
+
+        // writers updating in place
+        {
+            SeqLock<Pose>::ScopedLock lock(pose);
+            pose.value().stamp = -1;
+        }
+        pi_assert(pose.read().stamp == -1);
+    }
+};
+
+LockTest LockTestInstance;
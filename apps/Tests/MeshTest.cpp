@@ -0,0 +1,249 @@
+#if defined(HAS_PI_GUI)
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <gui/gl/MeshInterleaved.h>
+
+using namespace pi;
+using namespace pi::gl;
+using namespace std;
+
+class MeshTest : public pi::TestCase
+{
+public:
+    MeshTest():pi::TestCase("MeshTest"){}
+
+    virtual void run()
+    {
+        testMerge();
+        testWeld();
+        testNormals();
+        testDecimate();
+        testVertexCache();
+    }
+
+    // a side x side grid in the z=0 plane, two triangles per square
+    static void grid(MeshInterleaved& mesh,unsigned int side,bool withColors=true)
+    {
+        mesh.clear();
+        for(unsigned int y=0;y<side;y++)
+            for(unsigned int x=0;x<side;x++){
+                mesh.vertices.push_back(Vertex3f(x,y,0));
+                if(withColors) mesh.colors.push_back(Color3b(x,y,7));
+                if(!x||!y) continue;
+                unsigned int a=(y-1)*side+x-1,b=a+1,c=y*side+x,d=c-1;
+                unsigned int f[6]={a,b,c,a,c,d};
+                mesh.faces.insert(mesh.faces.end(),f,f+6);
+            }
+    }
+
+    // a sphere of radius 1 from a latitude/longitude grid, poles welded
+    static void sphere(MeshInterleaved& mesh,unsigned int rings)
+    {
+        mesh.clear();
+        unsigned int segments=rings*2;
+        for(unsigned int r=0;r<=rings;r++)
+            for(unsigned int s=0;s<segments;s++){
+                float theta=M_PI*r/rings,phi=2*M_PI*s/segments;
+                mesh.vertices.push_back(Vertex3f(sinf(theta)*cosf(phi),sinf(theta)*sinf(phi),cosf(theta)));
+            }
+        for(unsigned int r=0;r<rings;r++)
+            for(unsigned int s=0;s<segments;s++){
+                unsigned int a=r*segments+s,b=r*segments+(s+1)%segments,c=b+segments,d=a+segments;
+                unsigned int f[6]={a,c,b,a,d,c};
+                mesh.faces.insert(mesh.faces.end(),f,f+6);
+            }
+        mesh.weldVertices(1e-5f);
+    }
+
+    // triangles as sorted triples of positions, to compare meshes whose
+    // vertices and triangles were reordered
+    static vector<vector<float> > triangleSet(const MeshInterleaved& mesh)
+    {
+        vector<vector<float> > set;
+        for(size_t t=0;t*3<mesh.faces.size();t++){
+            vector<vector<float> > corners;
+            for(int j=0;j<3;j++){
+                const Vertex3f& p=mesh.vertices[mesh.faces[t*3+j]];
+                corners.push_back(vector<float>{p.x,p.y,p.z});
+            }
+            // rotations are the same triangle
+            rotate(corners.begin(),min_element(corners.begin(),corners.end()),corners.end());
+            vector<float> flat;
+            for(int j=0;j<3;j++) flat.insert(flat.end(),corners[j].begin(),corners[j].end());
+            set.push_back(flat);
+        }
+        sort(set.begin(),set.end());
+        return set;
+    }
+
+    static float missRatio(const vector<unsigned int>& faces,size_t cacheSize)
+    {
+        deque<unsigned int> fifo;
+        size_t misses=0;
+        for(size_t k=0;k<faces.size();k++){
+            if(find(fifo.begin(),fifo.end(),faces[k])!=fifo.end()) continue;
+            misses++;
+            fifo.push_back(faces[k]);
+            if(fifo.size()>cacheSize) fifo.pop_front();
+        }
+        return misses/(float)(faces.size()/3);
+    }
+
+    void testMerge()
+    {
+        MeshInterleaved a,b,c;
+        grid(a,10);
+        grid(b,20);
+        grid(c,5,false);
+
+        MeshInterleaved merged(a);
+        merged+=b;
+        pi_assert(merged.vertices.size()==500&&merged.colors.size()==500);
+        pi_assert(merged.faces.size()==a.faces.size()+b.faces.size());
+        pi_assert(merged.faces[a.faces.size()]==b.faces[0]+100);
+        pi_assert(merged.vertices[100+21].x==1&&merged.vertices[100+21].y==1);
+
+        // colors only where every mesh has them
+        vector<const MeshInterleaved*> meshes{&b,&c,&a};
+        MeshInterleaved bulk(a);
+        bulk.merge(meshes,4);
+        pi_assert(bulk.vertices.size()==100+400+25+100&&bulk.colors.empty());
+        pi_assert(bulk.faces.back()==a.faces.back()+525);
+        pi_assert(bulk.faces[a.faces.size()+b.faces.size()]==c.faces[0]+500);
+
+        MeshInterleaved twice(a);
+        twice+=twice;
+        pi_assert(twice.vertices.size()==200&&twice.faces.size()==a.faces.size()*2);
+        pi_assert(twice.faces.back()==a.faces.back()+100);
+    }
+
+    void testWeld()
+    {
+        // a triangle soup of a grid, every corner a vertex of its own
+        MeshInterleaved mesh,soup;
+        grid(mesh,50);
+        for(size_t k=0;k<mesh.faces.size();k++){
+            soup.vertices.push_back(mesh.vertices[mesh.faces[k]]);
+            soup.colors.push_back(mesh.colors[mesh.faces[k]]);
+            soup.faces.push_back(k);
+        }
+        MeshInterleaved exact(soup);
+        pi_assert(exact.weldVertices(0)==soup.vertices.size()-2500);
+        pi_assert(exact.vertices.size()==2500&&exact.colors.size()==2500&&exact.faces.size()==mesh.faces.size());
+        pi_assert(triangleSet(exact)==triangleSet(mesh));
+
+        // jittered corners only meet within epsilon
+        srand(7);
+        for(size_t i=0;i<soup.vertices.size();i++){
+            soup.vertices[i].x+=(rand()%2000-1000)*1e-6f;
+            soup.vertices[i].y+=(rand()%2000-1000)*1e-6f;
+        }
+        MeshInterleaved jittered(soup);
+        pi_assert(jittered.weldVertices(0)==0);
+        pi_assert(soup.weldVertices(1e-2f)==soup.faces.size()-2500);
+        pi_assert(soup.vertices.size()==2500&&soup.faces.size()==mesh.faces.size());
+
+        // triangles which collapse go away
+        pi_assert(soup.weldVertices(1.5f)>0);
+        for(size_t t=0;t*3<soup.faces.size();t++){
+            const unsigned int* f=&soup.faces[t*3];
+            pi_assert(f[0]!=f[1]&&f[1]!=f[2]&&f[0]!=f[2]);
+        }
+    }
+
+    void testNormals()
+    {
+        MeshInterleaved flat;
+        grid(flat,30);
+        flat.computeNormals(3);
+        pi_assert(flat.normals.size()==flat.vertices.size());
+        for(size_t i=0;i<flat.normals.size();i++)
+            pi_assert(fabs(flat.normals[i].z-1)<1e-6);
+
+        MeshInterleaved ball;
+        sphere(ball,40);
+        ball.computeNormals();
+        for(size_t i=0;i<ball.vertices.size();i++)
+            pi_assert(ball.normals[i]*ball.vertices[i]>0.99f);
+    }
+
+    void testDecimate()
+    {
+        MeshInterleaved ball;
+        sphere(ball,100);
+        ball.computeNormals();
+        size_t before=ball.faces.size()/3;
+        size_t removed=ball.decimate(2000);
+        pi_assert(removed>0&&ball.faces.size()/3==before-removed&&ball.faces.size()/3<=2000);
+        pi_assert(ball.faces.size()/3>1500);
+        pi_assert(ball.normals.size()==ball.vertices.size());
+        for(size_t i=0;i<ball.vertices.size();i++){
+            // still a sphere: vertices stay near it and nothing turned over
+            pi_assert(fabs(ball.vertices[i].norm()-1)<0.02f);
+            pi_assert(ball.normals[i]*ball.vertices[i]>0.9f);
+        }
+        for(size_t k=0;k<ball.faces.size();k++) pi_assert(ball.faces[k]<ball.vertices.size());
+        for(size_t t=0;t*3<ball.faces.size();t++){
+            const unsigned int* f=&ball.faces[t*3];
+            Vertex3f n=(ball.vertices[f[1]]-ball.vertices[f[0]])^(ball.vertices[f[2]]-ball.vertices[f[0]]);
+            pi_assert(n*ball.vertices[f[0]]>0);
+        }
+
+        // a plane folds into very few triangles and keeps its outline
+        MeshInterleaved flat;
+        grid(flat,40);
+        flat.decimate(10);
+        pi_assert(flat.faces.size()/3<=10&&flat.colors.size()==flat.vertices.size());
+        BoundingBox box;
+        flat.bounds(box);
+        pi_assert(box.min.x==0&&box.min.y==0&&box.max.x==39&&box.max.y==39);
+        for(size_t i=0;i<flat.vertices.size();i++) pi_assert(fabs(flat.vertices[i].z)<1e-6);
+
+        // a small error bound stops early on a curved surface
+        MeshInterleaved bounded;
+        sphere(bounded,50);
+        size_t n=bounded.faces.size()/3;
+        bounded.decimate(0,1e-9f);
+        pi_assert(bounded.faces.size()/3>n/2);
+    }
+
+    void testVertexCache()
+    {
+        MeshInterleaved mesh;
+        grid(mesh,100);
+        // shuffled triangles use the cache badly
+        srand(11);
+        for(size_t t=mesh.faces.size()/3-1;t>0;t--){
+            size_t o=rand()%(t+1);
+            for(int j=0;j<3;j++) swap(mesh.faces[t*3+j],mesh.faces[o*3+j]);
+        }
+        vector<vector<float> > triangles=triangleSet(mesh);
+        float shuffled=missRatio(mesh.faces,32);
+
+        mesh.optimizeVertexCache(32);
+        float optimized=missRatio(mesh.faces,32);
+        pi_assert(optimized<0.8f&&optimized<shuffled/2);
+        pi_assert(triangleSet(mesh)==triangles);
+        pi_assert(mesh.colors.size()==mesh.vertices.size());
+        for(size_t i=0;i<mesh.vertices.size();i++)
+            pi_assert(mesh.colors[i].x==mesh.vertices[i].x&&mesh.colors[i].y==mesh.vertices[i].y);
+
+        // vertices come in the order they are first used
+        unsigned int next=0;
+        for(size_t k=0;k<mesh.faces.size();k++){
+            pi_assert(mesh.faces[k]<=next);
+            if(mesh.faces[k]==next) next++;
+        }
+    }
+};
+
+MeshTest MeshTestInstance;
+
+#endif // HAS_PI_GUI
@@ -0,0 +1,306 @@
+#include <base/Thread/Thread.h>
+#include <base/Thread/Mutex.h>
+#include <base/Utils/TestCase.h>
+#include <base/Utils/utils_str.h>
+#include <network/MessagePublisher.h>
+#include <network/MessageSubscriber.h>
+#include <network/TCPMessageTransport.h>
+#include <network/MulticastMessageTransport.h>
+#include <network/MessageFrame.h>
+
+using namespace pi;
+using namespace std;
+
+namespace {
+
+class CollectHandler: public MessageHandler
+{
+public:
+    CollectHandler(): delay(0) {}
+
+    void onMessage(const Message& message)
+    {
+        if (delay) Thread::sleep(delay);
+        FastMutex::ScopedLock lock(mutex);
+        messages.push_back(message);
+    }
+
+    int count()
+    {
+        FastMutex::ScopedLock lock(mutex);
+        return (int) messages.size();
+    }
+
+    bool waitFor(int n)
+    {
+        for (int i = 0; i < 300 && count() < n; i++)
+            Thread::sleep(10);
+        return count() >= n;
+    }
+
+    int               delay;
+    vector<Message>   messages;
+    pi::FastMutex     mutex;
+};
+
+}
+
+class MessagingTest : public pi::TestCase
+{
+public:
+    MessagingTest():pi::TestCase("MessagingTest"){}
+
+    virtual void run()
+    {
+        testFrames();
+        testInProcess();
+        testCoalescing();
+        testDropPolicies();
+        testTCP();
+        testMulticast();
+    }
+
+    void testFrames();
+    void testInProcess();
+    void testCoalescing();
+    void testDropPolicies();
+    void testTCP();
+    void testMulticast();
+};
+
+MessagingTest MessagingTestInstance;
+
+
+void MessagingTest::testFrames()
+{
+    std::string stream;
+    MessageFrame::encode(stream, "pose", "abc", 3, 42);
+    MessageFrame::encode(stream, "image", "", 0, 43);
+    pi_assert ((int) stream.size() == MessageFrame::frameSize("pose", 3) + MessageFrame::frameSize("image", 0));
+    pi_assert (datastream_get_length((uint8_t*) stream.data()) == (uint32_t) MessageFrame::frameSize("pose", 3));
+
+    // feed byte by byte, as a stream socket may deliver it
+    MessageFrameReader reader;
+    vector<Message> messages;
+    for (size_t i = 0; i < stream.size(); i++)
+    {
+        reader.feed(&stream[i], 1);
+        const char* frame;
+        int length;
+        while (reader.next(frame, length))
+        {
+            messages.push_back(Message());
+            MessageFrame::decode(frame, length, messages.back());
+        }
+    }
+    pi_assert (messages.size() == 2);
+    pi_assert (messages[0].topic == "pose" && messages[0].payload == "abc" && messages[0].timestamp == 42);
+    pi_assert (messages[1].topic == "image" && messages[1].payload.empty());
+    pi_assert (reader.buffered() == 0);
+
+    // the frame is a valid RDataStream
+    RDataStream ds((uint8_t*) stream.data(), MessageFrame::frameSize("pose", 3));
+    std::string topic;
+    int64_t timestamp;
+    ds >> topic >> timestamp;
+    pi_assert (topic == "pose" && timestamp == 42);
+
+    reader.reset();
+    reader.feed("garbage!garbage!", 16);
+    const char* frame;
+    int length;
+    try
+    {
+        reader.next(frame, length);
+        pi_assert (false);
+    }
+    catch (DataFormatException&)
+    {
+    }
+}
+
+
+void MessagingTest::testInProcess()
+{
+    InProcessTransport pubTransport("testInProcess");
+    InProcessTransport subTransport("testInProcess");
+    MessageSubscriber subscriber(subTransport);
+    CollectHandler poses, images;
+    subscriber.subscribe("pose", &poses);
+    subscriber.subscribe("image", &images);
+
+    MessagePublisher publisher(pubTransport, 0);
+    RDataStream ds;
+    double x = 1.5;
+    ds << x;
+    publisher.publish("pose", ds);
+    publisher.publish("image", "pixels", 6);
+    publisher.publish("other", "ignored", 7);
+
+    pi_assert (poses.waitFor(1));
+    pi_assert (images.waitFor(1));
+    RDataStream in;
+    poses.messages[0].toStream(in);
+    double y = 0;
+    in >> y;
+    pi_assert (y == 1.5);
+    pi_assert (images.messages[0].payload == "pixels");
+
+    TopicStatistics stats = subscriber.statistics("image");
+    pi_assert (stats.messages == 1 && stats.bytes == 6 && stats.delivered == 1);
+    pi_assert (publisher.statistics("other").messages == 1);
+    pi_assert (subscriber.statistics("other").messages == 0);
+
+    subscriber.unsubscribe("image");
+    publisher.publish("image", "pixels", 6);
+    publisher.publish("pose", ds);
+    pi_assert (poses.waitFor(2));
+    pi_assert (images.count() == 1);
+}
+
+
+void MessagingTest::testCoalescing()
+{
+    InProcessTransport pubTransport("testCoalescing");
+    InProcessTransport subTransport("testCoalescing");
+    MessageSubscriber subscriber(subTransport);
+    CollectHandler handler;
+    subscriber.subscribe("t", &handler, 1000);
+
+    // nothing is sent before the latency budget expires
+    MessagePublisher publisher(pubTransport, pi::Timespan(200000));
+    for (int i = 0; i < 10; i++)
+        publisher.publish("t", pi::itos(i).data(), 1);
+    pi_assert (publisher.pendingBytes() > 0);
+    Thread::sleep(50);
+    pi_assert (handler.count() == 0);
+    pi_assert (handler.waitFor(10));
+    pi_assert (publisher.pendingBytes() == 0);
+    for (int i = 0; i < 10; i++)
+        pi_assert (handler.messages[i].payload == pi::itos(i));
+
+    publisher.publish("t", "x", 1);
+    publisher.flush();
+    pi_assert (handler.waitFor(11));
+}
+
+
+void MessagingTest::testDropPolicies()
+{
+    InProcessTransport pubTransport("testDropPolicies");
+    InProcessTransport subTransport("testDropPolicies");
+    MessageSubscriber subscriber(subTransport);
+    CollectHandler oldest, newest;
+    oldest.delay = 20;
+    newest.delay = 20;
+    subscriber.subscribe("oldest", &oldest, 2, MessageSubscriber::DROP_OLDEST);
+    subscriber.subscribe("newest", &newest, 2, MessageSubscriber::DROP_NEWEST);
+
+    MessagePublisher publisher(pubTransport, 0);
+    for (int i = 0; i < 20; i++)
+    {
+        publisher.publish("oldest", pi::itos(i).data(), (int) pi::itos(i).size());
+        publisher.publish("newest", pi::itos(i).data(), (int) pi::itos(i).size());
+    }
+    Thread::sleep(200);
+
+    TopicStatistics stats = subscriber.statistics("oldest");
+    pi_assert (stats.messages == 20);
+    pi_assert (stats.dropped > 0);
+    pi_assert (stats.dropped + stats.delivered + stats.queued == 20);
+    pi_assert (oldest.messages.back().payload == "19");
+
+    stats = subscriber.statistics("newest");
+    pi_assert (stats.dropped > 0);
+    pi_assert (newest.messages.front().payload == "0");
+    pi_assert (newest.messages.back().payload != "19");
+}
+
+
+void MessagingTest::testTCP()
+{
+    TCPMessageTransport server(TCPMessageTransport::ROLE_SERVER, SocketAddress("127.0.0.1", 0));
+    TCPMessageTransport client1(TCPMessageTransport::ROLE_CLIENT, SocketAddress("127.0.0.1", server.port()));
+    TCPMessageTransport client2(TCPMessageTransport::ROLE_CLIENT, SocketAddress("127.0.0.1", server.port()));
+    for (int i = 0; i < 100 && server.peers() < 2; i++)
+        Thread::sleep(10);
+    pi_assert (server.peers() == 2);
+
+    MessageSubscriber sub1(client1), sub2(client2);
+    CollectHandler h1, h2;
+    sub1.subscribe("data", &h1, 10000, MessageSubscriber::BLOCK);
+    sub2.subscribe("data", &h2, 10000, MessageSubscriber::BLOCK);
+
+    MessagePublisher publisher(server);
+    std::string big(100000, 'b');
+    for (int i = 0; i < 1000; i++)
+        publisher.publish("data", pi::itos(i).data(), (int) pi::itos(i).size());
+    publisher.publish("data", big.data(), (int) big.size());
+    publisher.flush();
+
+    pi_assert (h1.waitFor(1001));
+    pi_assert (h2.waitFor(1001));
+    for (int i = 0; i < 1000; i++)
+        pi_assert (h1.messages[i].payload == pi::itos(i));
+    pi_assert (h2.messages[1000].payload == big);
+    pi_assert (sub1.statistics("data").dropped == 0);
+
+    // subscribers may publish back to the server
+    MessageSubscriber serverSub(server);
+    CollectHandler hs;
+    serverSub.subscribe("reply", &hs);
+    MessagePublisher replier(client1, 0);
+    replier.publish("reply", "ok", 2);
+    pi_assert (hs.waitFor(1));
+}
+
+
+void MessagingTest::testMulticast()
+{
+#ifdef PIL_NET_HAS_INTERFACE
+    SocketAddress group("239.255.1.3", 12346);
+    MulticastMessageTransport pubTransport(group, 200);
+    MulticastMessageTransport subTransport(group, 200);
+    MessageSubscriber subscriber(subTransport);
+    CollectHandler handler;
+    subscriber.subscribe("m", &handler);
+
+    MessagePublisher publisher(pubTransport);
+    for (int i = 0; i < 50; i++)
+        publisher.publish("m", pi::itos(i).data(), (int) pi::itos(i).size());
+    publisher.flush();
+
+    // several frames per datagram, none split across datagrams
+    pi_assert (handler.waitFor(50));
+    pi_assert (handler.messages[49].payload == "49");
+
+    std::string big(300, 'x');
+    MessagePublisher direct(pubTransport, 0);
+    try
+    {
+        direct.publish("m", big.data(), (int) big.size());
+        pi_assert (false);
+    }
+    catch (DataFormatException&)
+    {
+    }
+
+    // a batch with a frame too large sends none of its frames, even
+    // those filling the datagrams before it
+    std::string frames;
+    for (int i = 0; i < 10; i++)
+        MessageFrame::encode(frames, "m", "lost", 4, 0);
+    MessageFrame::encode(frames, "m", big.data(), (int) big.size(), 0);
+    try
+    {
+        pubTransport.send(frames.data(), (int) frames.size());
+        pi_assert (false);
+    }
+    catch (DataFormatException&)
+    {
+    }
+    direct.publish("m", "end", 3);
+    pi_assert (handler.waitFor(51));
+    pi_assert (handler.messages[50].payload == "end");
+#endif
+}
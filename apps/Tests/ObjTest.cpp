@@ -0,0 +1,267 @@
+#if defined(HAS_PI_GUI)
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <clocale>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <base/Path/Path.h>
+#include <gui/gl/obj/ObjIO.h>
+
+using namespace pi;
+using namespace std;
+
+class ObjTest : public pi::TestCase
+{
+public:
+    ObjTest():pi::TestCase("ObjTest"){}
+
+    virtual void run()
+    {
+        testGrid();
+        testSmall();
+        testFormat();
+        testNumbers();
+        testErrors();
+    }
+
+    static void writeText(const string& file, const string& text)
+    {
+        std::ofstream out(file.c_str(), std::ios::binary);
+        out << text;
+    }
+
+    void testGrid()
+    {
+        // quads with a texcoord per position and a single normal, large
+        // enough for several chunks; the second half of the faces uses
+        // relative indices and another material
+        const unsigned int side = 301;
+        string dir  = Path::temp();
+        string file = dir + "pil_objtest.obj";
+        {
+            ObjWriter obj(file);
+            obj.comment("ObjTest");
+            obj.line("mtllib", "pil_objtest.mtl");
+            for (unsigned int y = 0; y < side; y++)
+                for (unsigned int x = 0; x < side; x++)
+                {
+                    obj.vertex(x * 0.25f, y * 0.5f, (float) ((x + y) % 7));
+                    obj.texcoord(x / (float) side, y / (float) side);
+                }
+            obj.normal(0, 0, 1);
+            obj.line("usemtl", "first");
+            for (unsigned int y = 0; y + 1 < side; y++)
+            {
+                if (y == side / 2) obj.line("usemtl", "second");
+                for (unsigned int x = 0; x + 1 < side; x++)
+                {
+                    unsigned int v[4] = { y * side + x, y * side + x + 1, (y + 1) * side + x + 1, (y + 1) * side + x };
+                    unsigned int n[4] = { 0, 0, 0, 0 };
+                    obj.face(v, v, n, 4);
+                }
+            }
+            obj.close();
+        }
+        writeText(dir + "pil_objtest.mtl",
+                  "newmtl first\nKd 1 0.5 0.25\nmap_Kd first.png\n\n"
+                  "newmtl second\nmap_Kd -s 1 1 1 /textures/second.png\n");
+
+        ObjReader obj(file, 4);
+        pi_assert(obj.vertexCount() == side * side);
+        pi_assert(obj.texcoords().size() == side * side * 2);
+        pi_assert(obj.normals().size() == side * side * 3);
+        pi_assert(obj.colors().empty());
+        pi_assert(obj.indices().size() == (side - 1) * (side - 1) * 6);
+
+        // every corner has the attributes of the position it was written with
+        const std::vector<float>&    xyz = obj.positions();
+        const std::vector<float>&    uv  = obj.texcoords();
+        const std::vector<uint32_t>& idx = obj.indices();
+        bool same = true;
+        for (unsigned int y = 0, k = 0; y + 1 < side; y++)
+            for (unsigned int x = 0; x + 1 < side; x++)
+            {
+                unsigned int v[4] = { y * side + x, y * side + x + 1, (y + 1) * side + x + 1, (y + 1) * side + x };
+                unsigned int fan[6] = { v[0], v[1], v[2], v[0], v[2], v[3] };
+                for (int j = 0; j < 6; j++, k++)
+                {
+                    unsigned int p = fan[j], i = idx[k];
+                    same &= xyz[i * 3] == (p % side) * 0.25f && xyz[i * 3 + 1] == (p / side) * 0.5f &&
+                            fabs(uv[i * 2] - (p % side) / (float) side) < 1e-5f &&
+                            obj.normals()[i * 3 + 2] == 1.0f;
+                }
+            }
+        pi_assert(same);
+
+        pi_assert(obj.materials().size() == 2);
+        pi_assert(obj.materials()[0].diffuse[1] == 0.5f);
+        pi_assert(obj.materials()[0].diffuseMap == dir + "first.png");
+        pi_assert(obj.materials()[1].diffuseMap == "/textures/second.png");
+        pi_assert(obj.materialRuns().size() == 2);
+        pi_assert(obj.materialRuns()[0].first == 0 && obj.materialRuns()[0].material == 0);
+        pi_assert(obj.materialRuns()[1].first == (side / 2) * (side - 1) * 6 && obj.materialRuns()[1].material == 1);
+
+        // one thread gives the same result
+        ObjReader single(file, 1);
+        pi_assert(single.indices() == obj.indices() && single.positions() == obj.positions());
+
+        unlink(file.c_str());
+        unlink((dir + "pil_objtest.mtl").c_str());
+    }
+
+    void testSmall()
+    {
+        string file = Path::temp() + "pil_objtest_small.obj";
+
+        // positions only: all are kept, in order, colors included
+        writeText(file, "# points\r\nv 1 2 3 1 0 0\r\nv 4 5 6 0 1 0\r\nv 7 8 9 0 0 1\r\n"
+                        "v 0 0 0 0.5 0.5 0.5\r\nf 1 2 3\r\nf -1 -2 -4 # comment\r\n");
+        {
+            ObjReader obj(file);
+            pi_assert(obj.vertexCount() == 4 && obj.positions()[4] == 5);
+            pi_assert(obj.colors().size() == 12 && obj.colors()[5] == 0 && obj.colors()[4] == 1);
+            uint32_t expected[6] = { 0, 1, 2, 3, 2, 0 };
+            pi_assert(obj.indices() == std::vector<uint32_t>(expected, expected + 6));
+            pi_assert(obj.texcoords().empty() && obj.normals().empty() && obj.materialRuns().empty());
+        }
+
+        // a texture seam splits a position, the unused one is dropped
+        writeText(file, "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 1\nv 9 9 9\n"
+                        "vt 0 0\nvt 1 0\nvt 0 1\nvt 0.5 0.5\n"
+                        "usemtl unknown\nf 1/1 2/2 3/3\nf 2/4 4/4 3/3\n");
+        {
+            ObjReader obj(file);
+            pi_assert(obj.vertexCount() == 5);
+            const std::vector<uint32_t>& idx = obj.indices();
+            pi_assert(idx[0] != idx[3] && idx[2] == idx[5]);
+            pi_assert(obj.texcoords()[idx[3] * 2] == 0.5f && obj.positions()[idx[3] * 3] == 1);
+            pi_assert(obj.materialRuns().size() == 1 && obj.materialRuns()[0].material == -1);
+        }
+
+        unlink(file.c_str());
+    }
+
+    void testFormat()
+    {
+        // the number formatting matches printf("%g")
+        string file = Path::temp() + "pil_objtest_format.obj";
+        std::vector<float> values;
+        srand(7);
+        for (int i = 0; i < 100000; i++)
+        {
+            float scale = (float) pow(10.0, rand() % 16 - 8);
+            values.push_back((rand() / (float) RAND_MAX - 0.5f) * scale);
+        }
+        float special[] = { 0.0f, -0.0f, 1.0f, 0.1f, 1e-4f, 9.999995e-5f, 999999.5f, 999999.4f, 123456.7f, -2.5f, 1e30f };
+        values.insert(values.end(), special, special + sizeof(special) / sizeof(float));
+        {
+            ObjWriter obj(file);
+            obj.values("x", &values[0], (int) values.size());
+            obj.close();
+        }
+
+        std::ifstream in(file.c_str());
+        string keyword, text;
+        in >> keyword;
+        int mismatches = 0;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            char expected[64];
+            snprintf(expected, sizeof(expected), "%g", values[i]);
+            in >> text;
+            if (text != expected) mismatches++;
+        }
+        pi_assert(mismatches == 0);
+
+        unsigned int v[3] = { 0, 9, 99 }, n[3] = { 1, 1, 1 };
+        {
+            ObjWriter obj(file);
+            obj.face(v, 0, 0, 3);
+            obj.face(v, 0, n, 3);
+            obj.face(v, v, n, 3);
+            obj.close();
+        }
+        std::ifstream faces(file.c_str());
+        std::stringstream all;
+        all << faces.rdbuf();
+        pi_assert(all.str() == "f 1 10 100\nf 1//2 10//2 100//2\nf 1/1/2 10/10/2 100/100/2\n");
+
+        unlink(file.c_str());
+    }
+
+    void testNumbers()
+    {
+        // numbers beyond the exact conversion, read with a comma for the
+        // decimal point of the locale where one is installed
+        const char* comma[] = { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "ru_RU.UTF-8" };
+        string previous = setlocale(LC_NUMERIC, NULL);
+        for (int i = 0; i < 4 && !setlocale(LC_NUMERIC, comma[i]); i++) {}
+
+        string file = Path::temp() + "pil_objtest_numbers.obj";
+        writeText(file, "v 0.12345678901234567890123 1.5e30 -2.5e-30\n"
+                        "v 12345678901234567890123 1e-50 -1e50\n"
+                        "v nan -inf Infinity\n");
+        bool read = false;
+        try
+        {
+            ObjReader obj(file);
+            const std::vector<float>& xyz = obj.positions();
+            read = xyz.size() == 9 &&
+                   xyz[0] == 0.12345678901234567890123f && xyz[1] == 1.5e30f && xyz[2] == -2.5e-30f &&
+                   xyz[3] == 12345678901234567890123.0f && xyz[4] == 0 && xyz[5] == -std::numeric_limits<float>::infinity() &&
+                   xyz[6] != xyz[6] && xyz[7] == -std::numeric_limits<float>::infinity() &&
+                   xyz[8] == std::numeric_limits<float>::infinity();
+        }
+        catch (...)
+        {
+        }
+        setlocale(LC_NUMERIC, previous.c_str());
+        unlink(file.c_str());
+        pi_assert(read);
+    }
+
+    void testErrors()
+    {
+        string file = Path::temp() + "pil_objtest_bad.obj";
+        const char* bad[] = { "v 0 0 0\nf 1 2 3\n", "v 0 0 0\nf 0 1 1\n", "v 0 0\n", "v 0 0 0\nf 1/a 1 1\n" };
+        for (int i = 0; i < 4; i++)
+        {
+            writeText(file, bad[i]);
+            bool thrown = false;
+            try
+            {
+                ObjReader obj(file);
+            }
+            catch (DataFormatException&)
+            {
+                thrown = true;
+            }
+            pi_assert(thrown);
+        }
+        unlink(file.c_str());
+
+        bool thrown = false;
+        try
+        {
+            ObjReader obj(file);
+        }
+        catch (FileNotFoundException&)
+        {
+            thrown = true;
+        }
+        pi_assert(thrown);
+    }
+};
+
+ObjTest ObjTestInstance;
+
+#endif // HAS_PI_GUI
@@ -0,0 +1,381 @@
+#if defined(HAS_PI_GUI)
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <base/Path/Path.h>
+#include <base/Debug/Exception.h>
+#include <gui/gl/lod/PointOctree.h>
+#include <gui/gl/lod/OctreeCloud.h>
+
+using namespace pi;
+using namespace pi::gl;
+using namespace std;
+
+struct PointLess
+{
+    bool operator()(const OctreePoint& l,const OctreePoint& r) const
+    {
+        return memcmp(&l,&r,sizeof(OctreePoint))<0;
+    }
+};
+
+class OctreeTest : public pi::TestCase
+{
+public:
+    OctreeTest():pi::TestCase("OctreeTest"){}
+
+    virtual void run()
+    {
+        file = Path::temp() + "pil_octreetest.pct";
+        makeCloud();
+        testBuild();
+        testErrors();
+        testStreaming();
+        testMesh();
+        remove(file.c_str());
+    }
+
+    void makeCloud()
+    {
+        // a sphere of radius 10 around the origin, and a pile of equal
+        // points which no grid can tell apart
+        srand(5);
+        const int n = 200000;
+        for (int i = 0; i < n; i++)
+        {
+            float x = rand() / (float) RAND_MAX - 0.5f, y = rand() / (float) RAND_MAX - 0.5f;
+            float z = rand() / (float) RAND_MAX - 0.5f;
+            float s = 10 / sqrtf(x * x + y * y + z * z + 1e-12f);
+            xyz.push_back(x * s);
+            xyz.push_back(y * s);
+            xyz.push_back(z * s);
+            rgb.push_back(i & 255);
+            rgb.push_back((i >> 8) & 255);
+            rgb.push_back(i >> 16);
+        }
+        for (int i = 0; i < 3000; i++)
+        {
+            xyz.push_back(1); xyz.push_back(2); xyz.push_back(3);
+            rgb.push_back(7); rgb.push_back(8); rgb.push_back(9);
+        }
+    }
+
+    void testBuild()
+    {
+        size_t n = xyz.size() / 3;
+        PointOctreeBuilder builder(file, 5000, 32);
+        builder.add(&xyz[0], &rgb[0], n / 2);
+        builder.add(&xyz[n / 2 * 3], &rgb[n / 2 * 3], n - n / 2);
+        size_t nodeCount = builder.build();
+
+        PointOctreeFile octree(file);
+        const vector<PointOctreeFile::Node>& nodes = octree.nodes();
+        pi_assert(nodes.size() == nodeCount && nodeCount > 20);
+        pi_assert(octree.pointCount() == n && octree.grid() == 32);
+
+        vector<OctreePoint> all, points;
+        vector<uint8_t>     scratch;
+        size_t              packed = 0;
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            const PointOctreeFile::Node& node = nodes[i];
+            octree.read((int) i, points, scratch);
+            pi_assert(points.size() == node.points && node.points > 0);
+            packed += node.packedBytes;
+
+            bool leaf = true;
+            for (int k = 0; k < 8; k++)
+            {
+                int c = node.children[k];
+                if (c < 0) continue;
+                leaf = false;
+                // children are the octants of their parent
+                Point3f center = node.box.center();
+                pi_assert(nodes[c].box.min.x == ((k & 1) ? center.x : node.box.min.x));
+                pi_assert(nodes[c].box.max.z == ((k & 4) ? node.box.max.z : center.z));
+            }
+            // inner nodes keep at most one point per cell
+            pi_assert(leaf || node.points <= 32 * 32 * 32);
+            for (size_t j = 0; j < points.size(); j++)
+            {
+                const OctreePoint& p = points[j];
+                pi_assert(p.x >= node.box.min.x && p.x <= node.box.max.x &&
+                          p.y >= node.box.min.y && p.y <= node.box.max.y &&
+                          p.z >= node.box.min.z && p.z <= node.box.max.z);
+            }
+            all.insert(all.end(), points.begin(), points.end());
+        }
+        pi_assert(packed < n * sizeof(OctreePoint));
+
+        // every point is in exactly one node
+        vector<OctreePoint> input(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            OctreePoint& p = input[i];
+            p.x = xyz[i * 3]; p.y = xyz[i * 3 + 1]; p.z = xyz[i * 3 + 2];
+            p.r = rgb[i * 3]; p.g = rgb[i * 3 + 1]; p.b = rgb[i * 3 + 2];
+            p.a = 255;
+        }
+        sort(all.begin(), all.end(), PointLess());
+        sort(input.begin(), input.end(), PointLess());
+        pi_assert(all.size() == input.size() && memcmp(&all[0], &input[0], all.size() * sizeof(OctreePoint)) == 0);
+    }
+
+    void testErrors()
+    {
+        bool thrown = false;
+        try { PointOctreeFile missing(Path::temp() + "pil_octreetest_missing.pct"); }
+        catch (FileNotFoundException&) { thrown = true; }
+        pi_assert(thrown);
+
+        string bad = Path::temp() + "pil_octreetest_bad.pct";
+        {
+            std::ofstream out(bad.c_str(), std::ios::binary);
+            out << "not an octree, but long enough to hold a header";
+        }
+        thrown = false;
+        try { PointOctreeFile garbage(bad); }
+        catch (DataFormatException&) { thrown = true; }
+        pi_assert(thrown);
+
+        // cut off in the node table
+        {
+            std::ifstream in(file.c_str(), std::ios::binary);
+            vector<char>  data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            std::ofstream out(bad.c_str(), std::ios::binary);
+            out.write(&data[0], data.size() - 10);
+        }
+        thrown = false;
+        try { PointOctreeFile truncated(bad); }
+        catch (DataFormatException&) { thrown = true; }
+        pi_assert(thrown);
+        remove(bad.c_str());
+    }
+
+    // a camera at the origin looking down -z with a 90 degrees field of
+    // view, the cloud moved to (dx, 0, -distance)
+    static Frustum view(float dx, float distance)
+    {
+        float p[16], m[16];
+        std::fill(p, p + 16, 0.f);
+        p[0]  = p[5] = 1;
+        p[10] = -1001.f / 999.f;
+        p[11] = -1;
+        p[14] = -2000.f / 999.f;
+        std::fill(m, m + 16, 0.f);
+        m[0]  = m[5] = m[10] = m[15] = 1;
+        m[12] = dx;
+        m[14] = -distance;
+        return Frustum(p, m, 500);
+    }
+
+    static void settle(OctreeCloud& cloud, const Frustum& frustum)
+    {
+        for (int i = 0; i < 5000; i++)
+        {
+            cloud.update(frustum);
+            if (!cloud.stats().queued) return;
+            usleep(1000);
+        }
+        pi_assert(false);
+    }
+
+    static void checkSelection(const OctreeCloud& cloud)
+    {
+        // a node is only drawn together with its parent
+        const vector<PointOctreeFile::Node>& nodes = cloud.file().nodes();
+        vector<char> drawn(nodes.size(), 0);
+        for (size_t i = 0; i < cloud.selected().size(); i++) drawn[cloud.selected()[i]] = 1;
+        pi_assert(nodes.empty() || drawn[0]);
+        for (size_t i = 0; i < nodes.size(); i++)
+            for (int k = 0; k < 8; k++)
+                pi_assert(nodes[i].children[k] < 0 || !drawn[nodes[i].children[k]] || drawn[i]);
+    }
+
+    void testStreaming()
+    {
+        OctreeCloud cloud(file);
+        BoundingBox box;
+        pi_assert(cloud.bounds(box) && box.min.x < -9.9f && box.max.z > 9.9f);
+
+        // far away the root is fine enough
+        settle(cloud, view(0, 900));
+        pi_assert(cloud.selected().size() == 1 && cloud.stats().loaded == 1);
+        vector<OctreePoint> root;
+        pi_assert(cloud.nodePoints(0, root) && root.size() == cloud.file().nodes()[0].points);
+
+        // closer up more is loaded
+        settle(cloud, view(0, 100));
+        const OctreeCloud::Stats& stats = cloud.stats();
+        size_t near = stats.drawn;
+        pi_assert(near > 1 && near < stats.nodes && stats.loads == stats.loaded && stats.evictions == 0);
+        checkSelection(cloud);
+
+        // a smaller error needs more nodes
+        cloud.setMaxError(0.5f);
+        settle(cloud, view(0, 100));
+        pi_assert(stats.drawn > near);
+        checkSelection(cloud);
+
+        // nodes out of view are not drawn
+        settle(cloud, view(-12, 12));
+        pi_assert(stats.visible < stats.nodes && stats.drawn == stats.visible);
+        checkSelection(cloud);
+
+        // with a small budget, looking at one side and then the other
+        // drops the nodes of the first
+        cloud.setMemoryBudget(stats.bytes / 2);
+        settle(cloud, view(-12, 8));
+        settle(cloud, view(12, 8));
+        pi_assert(stats.evictions > 0);
+        pi_assert(stats.bytes <= cloud.memoryBudget() || stats.loaded == stats.drawn);
+        checkSelection(cloud);
+        pi_assert(stats.failures == 0);
+    }
+
+    static bool sameTriangle(const OctreePoint* l, const OctreePoint* r)
+    {
+        return memcmp(l, r, 3 * sizeof(OctreePoint)) == 0;
+    }
+
+    void testMesh()
+    {
+        // a sphere of radius 10 from 40000 triangles
+        const int rings = 100, segments = 200;
+        vector<float>    vertices;
+        vector<uint8_t>  colors;
+        vector<uint32_t> indices;
+        for (int i = 0; i <= rings; i++)
+        {
+            for (int j = 0; j < segments; j++)
+            {
+                float theta = (float) M_PI * i / rings, phi = 2 * (float) M_PI * j / segments;
+                vertices.push_back(10 * sinf(theta) * cosf(phi));
+                vertices.push_back(10 * sinf(theta) * sinf(phi));
+                vertices.push_back(10 * cosf(theta));
+                colors.push_back(i); colors.push_back(j); colors.push_back(0);
+            }
+        }
+        for (int i = 0; i < rings; i++)
+        {
+            for (int j = 0; j < segments; j++)
+            {
+                uint32_t a = i * segments + j, b = i * segments + (j + 1) % segments;
+                uint32_t c = a + segments, d = b + segments;
+                uint32_t quad[6] = {a, c, b, b, c, d};
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+        size_t triangleCount = indices.size() / 3;
+
+        string meshFile = Path::temp() + "pil_octreetest_mesh.pct";
+        {
+            PointOctreeBuilder builder(meshFile, 6000, 32);
+            builder.addTriangles(&vertices[0], &colors[0], vertices.size() / 3, &indices[0], triangleCount);
+
+            bool thrown = false;
+            try { builder.add(&xyz[0], &rgb[0], 1); }
+            catch (IllegalStateException&) { thrown = true; }
+            pi_assert(thrown);
+            thrown = false;
+            uint32_t bad[3] = {0, 1, (uint32_t) (vertices.size() / 3)};
+            try { builder.addTriangles(&vertices[0], 0, vertices.size() / 3, bad, 1); }
+            catch (InvalidArgumentException&) { thrown = true; }
+            pi_assert(thrown);
+            builder.build();
+        }
+
+        {
+            PointOctreeFile octree(meshFile);
+            const vector<PointOctreeFile::Node>& nodes = octree.nodes();
+            pi_assert(octree.triangles() && nodes.size() > 8);
+
+            // the leaves hold the triangles as they were, the inner nodes
+            // a coarser version of their box
+            vector<OctreePoint> leaves, points;
+            vector<uint8_t>     scratch;
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                const PointOctreeFile::Node& node = nodes[i];
+                octree.read((int) i, points, scratch);
+                pi_assert(points.size() % 3 == 0);
+                for (size_t j = 0; j < points.size(); j++)
+                {
+                    const OctreePoint& p = points[j];
+                    pi_assert(p.x >= node.box.min.x && p.x <= node.box.max.x &&
+                              p.y >= node.box.min.y && p.y <= node.box.max.y &&
+                              p.z >= node.box.min.z && p.z <= node.box.max.z);
+                }
+
+                bool leaf = true;
+                for (int k = 0; k < 8; k++) leaf = leaf && node.children[k] < 0;
+                if (leaf) leaves.insert(leaves.end(), points.begin(), points.end());
+                else      pi_assert(node.points > 0);
+            }
+            pi_assert(nodes[0].points < triangleCount * 3 / 4);
+            pi_assert(leaves.size() == triangleCount * 3);
+
+            // every input triangle is in some leaf
+            vector<OctreePoint> input;
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                OctreePoint p;
+                p.x = vertices[indices[i] * 3]; p.y = vertices[indices[i] * 3 + 1]; p.z = vertices[indices[i] * 3 + 2];
+                p.r = colors[indices[i] * 3]; p.g = colors[indices[i] * 3 + 1]; p.b = colors[indices[i] * 3 + 2];
+                p.a = 255;
+                input.push_back(p);
+            }
+            for (size_t i = 0; i < input.size(); i += 3)
+            {
+                bool found = false;
+                for (size_t j = 0; j < leaves.size() && !found; j += 3)
+                    found = sameTriangle(&input[i], &leaves[j]);
+                pi_assert(found);
+                if (i > 3000) break;    // enough of them, this is quadratic
+            }
+        }
+
+        {
+            OctreeCloud mesh(meshFile);
+            const OctreeCloud::Stats& stats = mesh.stats();
+
+            // far away the root alone stands for the mesh
+            settle(mesh, view(0, 900));
+            pi_assert(mesh.selected().size() == 1 && mesh.selected()[0] == 0);
+
+            // closer up its children replace it, never drawn with it
+            settle(mesh, view(0, 30));
+            pi_assert(stats.drawn > 1 && stats.failures == 0);
+            const vector<PointOctreeFile::Node>& nodes = mesh.file().nodes();
+            vector<char> drawn(nodes.size(), 0), below(nodes.size(), 0);
+            for (size_t i = 0; i < mesh.selected().size(); i++) drawn[mesh.selected()[i]] = 1;
+            for (size_t i = nodes.size(); i-- > 0; )
+            {
+                for (int k = 0; k < 8; k++)
+                {
+                    int c = nodes[i].children[k];
+                    if (c >= 0) below[i] |= drawn[c] | below[c];
+                }
+                pi_assert(!drawn[i] || !below[i]);
+            }
+        }
+        remove(meshFile.c_str());
+    }
+
+    string          file;
+    vector<float>   xyz;
+    vector<uint8_t> rgb;
+};
+
+OctreeTest OctreeTestInstance;
+
+#endif // HAS_PI_GUI
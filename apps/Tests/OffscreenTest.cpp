@@ -0,0 +1,188 @@
+#if defined(HAS_PI_GUI) && defined(HAS_EGL)
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <base/Utils/TestCase.h>
+#include <base/Path/Path.h>
+#include <gui/gl/OpenGL.h>
+#include <gui/gl/GL_FatherObject.h>
+#include <gui/gl/OffscreenRenderer.h>
+
+using namespace pi;
+using namespace pi::gl;
+using namespace std;
+
+// a quad at z=-5 over the left half of a 90 degrees view, green on top
+// and red below, its blue the number of the frame
+class Quad : public GL_Object
+{
+public:
+    Quad():frame(0){}
+
+    virtual void draw()
+    {
+        glDisable(GL_LIGHTING);
+        glBegin(GL_QUADS);
+        glColor3ub(255,0,frame);
+        glVertex3f(-5,-5,-5); glVertex3f(0,-5,-5); glVertex3f(0,0,-5); glVertex3f(-5,0,-5);
+        glColor3ub(0,255,frame);
+        glVertex3f(-5,0,-5); glVertex3f(0,0,-5); glVertex3f(0,5,-5); glVertex3f(-5,5,-5);
+        glEnd();
+        frame++;
+    }
+
+    virtual bool bounds(BoundingBox& box)
+    {
+        box=BoundingBox(Point3f(-5,-5,-5),Point3f(0,5,-5));
+        return true;
+    }
+
+    int frame;
+};
+
+class CountingSink : public OffscreenRenderer::FrameSink
+{
+public:
+    CountingSink():frames(0),last(-1){}
+
+    virtual void write(const OffscreenRenderer::Frame& frame)
+    {
+        pi_assert((int64_t)frame.number==last+1);
+        last=frame.number;
+        frames++;
+    }
+
+    int     frames;
+    int64_t last;
+};
+
+class OffscreenTest : public pi::TestCase
+{
+public:
+    OffscreenTest():pi::TestCase("OffscreenTest"){}
+
+    enum { W=64, H=48 };
+
+    virtual void run()
+    {
+        OffscreenRenderer renderer(W,H);
+        renderer.setCamera(W/2,W/2,W/2,H/2);
+        SPtr<Quad> quad(new Quad);
+        Father_Object scene;
+        scene.insert(quad);
+
+        testFrames(renderer,scene,*quad);
+        testPose(renderer,scene);
+        testSinks(renderer,scene);
+        testRelease(scene);
+    }
+
+    static const uint8_t* pixel(const OffscreenRenderer::Frame& frame,int x,int y)
+    {
+        return &frame.pixels[(y*frame.width+x)*3];
+    }
+
+    void testFrames(OffscreenRenderer& renderer,Father_Object& scene,Quad& quad)
+    {
+        // more frames than pixel buffers, all come back in order
+        for(int i=0;i<10;i++) pi_assert(renderer.render(scene)==(uint64_t)i);
+        renderer.finish();
+        const OffscreenRenderer::Stats& stats=renderer.stats();
+        pi_assert(stats.rendered==10&&stats.delivered==10&&stats.dropped==0);
+        pi_assert(stats.meanDrawMs>=0&&stats.maxDrawMs>=stats.meanDrawMs);
+
+        OffscreenRenderer::Frame frame;
+        for(int i=0;i<10;i++){
+            pi_assert(renderer.takeFrame(frame));
+            pi_assert(frame.number==(uint64_t)i&&frame.width==W&&frame.height==H);
+            pi_assert(frame.pixels.size()==W*H*3);
+            // BGR, the first row at the top
+            const uint8_t* top=pixel(frame,W/4,H/8);
+            const uint8_t* bottom=pixel(frame,W/4,H-1-H/8);
+            const uint8_t* right=pixel(frame,W*3/4,H/2);
+            pi_assert(top[0]==i&&top[1]==255&&top[2]==0);
+            pi_assert(bottom[0]==i&&bottom[1]==0&&bottom[2]==255);
+            pi_assert(right[0]==0x33&&right[1]==0x33&&right[2]==0x33);
+        }
+        pi_assert(!renderer.takeFrame(frame)&&quad.frame==10);
+    }
+
+    void testPose(OffscreenRenderer& renderer,Father_Object& scene)
+    {
+        // the camera moved to the right and turned a quarter to the right
+        // looks along +x, away from the quad
+        renderer.setPose(SE3f(SO3f::exp(Point3f(0,-M_PI/2,0)),Point3f(20,0,0)));
+        renderer.setBackground(Color3b(10,20,30));
+        renderer.render(scene);
+        renderer.finish();
+        OffscreenRenderer::Frame frame;
+        pi_assert(renderer.takeFrame(frame));
+        for(int y=0;y<H;y++)
+            for(int x=0;x<W;x++){
+                const uint8_t* p=pixel(frame,x,y);
+                pi_assert(p[0]==30&&p[1]==20&&p[2]==10);
+            }
+        renderer.setPose(SE3f());
+    }
+
+    void testSinks(OffscreenRenderer& renderer,Father_Object& scene)
+    {
+        // a full queue keeps the newest frames
+        renderer.resetStats();
+        renderer.setQueueLimit(2);
+        uint64_t last=0;
+        for(int i=0;i<5;i++) last=renderer.render(scene);
+        renderer.finish();
+        pi_assert(renderer.stats().dropped==3&&renderer.stats().delivered==5);
+        OffscreenRenderer::Frame frame;
+        pi_assert(renderer.takeFrame(frame)&&frame.number==last-1);
+        pi_assert(renderer.takeFrame(frame)&&frame.number==last);
+        pi_assert(!renderer.takeFrame(frame));
+
+        CountingSink counter;
+        renderer.setSink(&counter);
+        counter.last=last;
+        for(int i=0;i<7;i++) renderer.render(scene);
+        renderer.finish();
+        pi_assert(counter.frames==7&&!renderer.takeFrame(frame));
+
+        // raw video through a command
+        string file=Path::temp()+"pil_offscreentest.bgr";
+        {
+            VideoPipe video("cat > "+file);
+            renderer.setSink(&video);
+            for(int i=0;i<4;i++) renderer.render(scene);
+            renderer.finish();
+            pi_assert(video.frames()==4);
+        }
+        renderer.setSink(NULL);
+        struct stat info;
+        pi_assert(stat(file.c_str(),&info)==0&&info.st_size==4*W*H*3);
+        unlink(file.c_str());
+    }
+
+    void testRelease(Father_Object& scene)
+    {
+        // a renderer in the current context leaves its GL objects to release()
+        OffscreenRenderer borrowed(W,H,false);
+        pi_assert(borrowed.render(scene)==0);
+        borrowed.finish();
+        OffscreenRenderer::Frame frame;
+        pi_assert(borrowed.takeFrame(frame)&&pixel(frame,W*3/4,H/2)[0]==0x33);
+        borrowed.release();
+        bool thrown=false;
+        try{
+            borrowed.render(scene);
+        }
+        catch(IllegalStateException&){
+            thrown=true;
+        }
+        pi_assert(thrown);
+    }
+};
+
+OffscreenTest OffscreenTestInstance;
+
+#endif // HAS_PI_GUI && HAS_EGL
@@ -0,0 +1,286 @@
+#if defined(HAS_PI_GUI)
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <base/Path/Path.h>
+#include <gui/gl/ply/PlyIO.h>
+
+using namespace pi;
+using namespace std;
+
+struct PlyTestVertex
+{
+    float   x, y, z;
+    uint8_t r, g, b;
+};
+
+class PlyTest : public pi::TestCase
+{
+public:
+    PlyTest():pi::TestCase("PlyTest"){}
+
+    virtual void run()
+    {
+        testRoundTrip(true);
+        testRoundTrip(false);
+        testMixedFaces();
+        testBigEndian();
+        testBadFiles();
+    }
+
+    void makeMesh(size_t n, std::vector<PlyTestVertex>& v, std::vector<uint32_t>& faces)
+    {
+        v.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            v[i].x = i * 0.5f;
+            v[i].y = -(float) i;
+            v[i].z = 1e-3f * i;
+            v[i].r = (uint8_t) i;
+            v[i].g = (uint8_t) (i >> 8);
+            v[i].b = 7;
+        }
+        faces.resize((n - 2) * 3);
+        for (size_t f = 0; f + 2 < n; f++)
+        {
+            faces[f*3]   = (uint32_t) f;
+            faces[f*3+1] = (uint32_t) f + 1;
+            faces[f*3+2] = (uint32_t) f + 2;
+        }
+    }
+
+    void testRoundTrip(bool binary)
+    {
+        // enough records for the worker threads
+        size_t n = binary ? 200000 : 1000;
+        std::vector<PlyTestVertex> v;
+        std::vector<uint32_t>      faces;
+        makeMesh(n, v, faces);
+
+        string file = Path::temp() + "pil_plytest.ply";
+        {
+            PlyWriter ply(file, binary);
+            ply.addComment("PlyTest");
+            ply.addElement("vertex", n);
+            ply.addProperties({"x", "y", "z"}, PlyProperty::Type::FLOAT32, &v[0].x, sizeof(PlyTestVertex));
+            ply.addProperties({"red", "green", "blue"}, PlyProperty::Type::UINT8, &v[0].r, sizeof(PlyTestVertex));
+            ply.addElement("face", faces.size() / 3);
+            ply.addList("vertex_indices", PlyProperty::Type::UINT8, PlyProperty::Type::UINT32, &faces[0], 3);
+            ply.write();
+        }
+
+        if (!binary)
+        {
+            // ASCII goes through tinyply
+            std::ifstream is(file.c_str(), std::ios::binary);
+            PlyFile ply(is);
+            std::vector<float>    xyz;
+            std::vector<uint32_t> idx;
+            pi_assert(ply.request_properties_from_element("vertex", {"x", "y", "z"}, xyz) == (int) n);
+            ply.request_properties_from_element("face", {"vertex_indices"}, idx, 3);
+            ply.read(is);
+            pi_assert(xyz.size() == n * 3 && xyz[3 * 999 + 2] == v[999].z);
+            pi_assert(idx == faces);
+            unlink(file.c_str());
+            return;
+        }
+
+        PlyReader ply(file, 4);
+        pi_assert(ply.isBinary());
+        pi_assert(ply.count("vertex") == n && ply.count("face") == n - 2);
+        pi_assert(ply.has("vertex", "green") && !ply.has("vertex", "nx"));
+
+        // strided gather into a struct
+        std::vector<PlyTestVertex> back(n);
+        pi_assert(ply.read("vertex", {"x", "y", "z"}, &back[0].x, PlyProperty::Type::FLOAT32, sizeof(PlyTestVertex)) == n);
+        pi_assert(ply.read("vertex", {"red", "green", "blue"}, &back[0].r, PlyProperty::Type::UINT8, sizeof(PlyTestVertex)) == n);
+        bool same = true;
+        for (size_t i = 0; i < n; i++)
+            same &= back[i].x == v[i].x && back[i].y == v[i].y && back[i].z == v[i].z &&
+                    back[i].r == v[i].r && back[i].g == v[i].g && back[i].b == v[i].b;
+        pi_assert(same);
+
+        // conversion, and the bulk copy of whole records
+        std::vector<double> green;
+        pi_assert(ply.read("vertex", {"green"}, green) == n);
+        pi_assert(green[300] == (double) (uint8_t) (300 >> 8));
+        std::vector<PlyTestVertex> bulk(n);
+        pi_assert(ply.read("vertex", {"x", "y", "z"}, &bulk[0].x, PlyProperty::Type::FLOAT32, sizeof(PlyTestVertex)) == n);
+        pi_assert(bulk[n - 1].z == v[n - 1].z);
+        pi_assert(ply.read("vertex", {"x", "nx"}, &bulk[0].x, PlyProperty::Type::FLOAT32, 8) == 0);
+
+        std::vector<uint32_t> idx, counts;
+        pi_assert(ply.readList("face", "vertex_indices", idx, &counts) == 3);
+        pi_assert(idx == faces);
+        pi_assert(counts.size() == n - 2 && counts[5] == 3);
+        std::vector<float> wide;
+        pi_assert(ply.readList("face", "vertex_indices", wide) == 3 && wide.back() == (float) (n - 1));
+        pi_assert(ply.readList("face", "texcoord", idx) == -1);
+
+        unlink(file.c_str());
+    }
+
+    void testMixedFaces()
+    {
+        // triangles and quads, with a property after the list
+        string file = Path::temp() + "pil_plytest_mixed.ply";
+        FILE* fp = fopen(file.c_str(), "wb");
+        pi_assert(fp != NULL);
+        const char header[] = "ply\nformat binary_little_endian 1.0\n"
+                              "element vertex 2\nproperty float x\n"
+                              "element face 200000\nproperty list uchar int vertex_indices\nproperty uchar flag\n"
+                              "element edge 1\nproperty int vertex1\nproperty int vertex2\nend_header\n";
+        fwrite(header, 1, sizeof(header) - 1, fp);
+        float xs[2] = { 1.5f, 2.5f };
+        fwrite(xs, sizeof(float), 2, fp);
+        std::vector<int32_t> expected;
+        std::vector<uint8_t> flags;
+        for (int f = 0; f < 200000; f++)
+        {
+            uint8_t size = (f % 3 == 0) ? 4 : 3;
+            fwrite(&size, 1, 1, fp);
+            for (int j = 0; j < size; j++)
+            {
+                int32_t idx = f + j;
+                fwrite(&idx, 4, 1, fp);
+                expected.push_back(idx);
+            }
+            uint8_t flag = (uint8_t) f;
+            fwrite(&flag, 1, 1, fp);
+            flags.push_back(flag);
+        }
+        int32_t edge[2] = { 0, 1 };
+        fwrite(edge, 4, 2, fp);
+        fclose(fp);
+
+        PlyReader ply(file, 4);
+        std::vector<int32_t>  idx;
+        std::vector<uint32_t> counts;
+        pi_assert(ply.readList("face", "vertex_indices", idx, &counts) == 0);
+        pi_assert(idx == expected);
+        pi_assert(counts[0] == 4 && counts[1] == 3);
+
+        std::vector<uint8_t> f;
+        pi_assert(ply.read("face", {"flag"}, f) == 200000);
+        pi_assert(f == flags);
+
+        // the element after the variable sized one
+        std::vector<int32_t> e;
+        pi_assert(ply.read("edge", {"vertex1", "vertex2"}, e) == 1 && e[1] == 1);
+
+        unlink(file.c_str());
+    }
+
+    template <class T>
+    static void putBigEndian(FILE* fp, T value)
+    {
+        uint8_t b[sizeof(T)];
+        memcpy(b, &value, sizeof(T));
+#if !defined(PIL_ARCH_BIG_ENDIAN)
+        std::reverse(b, b + sizeof(T));
+#endif
+        fwrite(b, 1, sizeof(T), fp);
+    }
+
+    void testBigEndian()
+    {
+        // fixed size vertices, triangles with a 16 bit count and polygons
+        // of varying size
+        string file = Path::temp() + "pil_plytest_be.ply";
+        FILE* fp = fopen(file.c_str(), "wb");
+        pi_assert(fp != NULL);
+        const int n = 100000;
+        const char header[] = "ply\nformat binary_big_endian 1.0\n"
+                              "element vertex 100000\nproperty float x\nproperty float y\nproperty double z\nproperty uchar red\n"
+                              "element face 100000\nproperty list ushort int vertex_indices\n"
+                              "element polygon 3\nproperty list int uint vertex_indices\nend_header\n";
+        fwrite(header, 1, sizeof(header) - 1, fp);
+        for (int i = 0; i < n; i++)
+        {
+            putBigEndian(fp, i * 0.5f);
+            putBigEndian(fp, -(float) i);
+            putBigEndian(fp, 1e-3 * i);
+            putBigEndian(fp, (uint8_t) i);
+        }
+        for (int f = 0; f < n; f++)
+        {
+            putBigEndian(fp, (uint16_t) 3);
+            for (int j = 0; j < 3; j++) putBigEndian(fp, (int32_t) (f + j * 65536));
+        }
+        for (int f = 0; f < 3; f++)
+        {
+            putBigEndian(fp, (int32_t) (3 + f));
+            for (int j = 0; j < 3 + f; j++) putBigEndian(fp, (uint32_t) (70000 + j));
+        }
+        fclose(fp);
+
+        PlyReader ply(file, 4);
+        pi_assert(ply.isBinary() && ply.count("vertex") == (size_t) n);
+
+        std::vector<float>  xy;
+        std::vector<double> z;
+        std::vector<int>    red;
+        pi_assert(ply.read("vertex", {"x", "y"}, xy) == (size_t) n);
+        pi_assert(ply.read("vertex", {"z"}, z) == (size_t) n);
+        pi_assert(ply.read("vertex", {"red"}, red) == (size_t) n);
+        for (int i = 0; i < n; i++)
+            pi_assert(xy[i * 2] == i * 0.5f && xy[i * 2 + 1] == -(float) i && z[i] == 1e-3 * i && red[i] == (uint8_t) i);
+
+        std::vector<uint32_t> faces;
+        pi_assert(ply.readList("face", "vertex_indices", faces) == 3 && faces.size() == (size_t) n * 3);
+        for (int f = 0; f < n; f++)
+            pi_assert(faces[f * 3] == (uint32_t) f && faces[f * 3 + 2] == (uint32_t) (f + 2 * 65536));
+
+        std::vector<uint32_t> polygons, counts;
+        pi_assert(ply.readList("polygon", "vertex_indices", polygons, &counts) == 0);
+        pi_assert(polygons.size() == 12 && counts[2] == 5 && polygons[11] == 70004);
+
+        unlink(file.c_str());
+    }
+
+    void testBadFiles()
+    {
+        string file = Path::temp() + "pil_plytest_bad.ply";
+        FILE* fp = fopen(file.c_str(), "wb");
+        const char header[] = "ply\nformat binary_little_endian 1.0\nelement vertex 100\nproperty float x\nend_header\n";
+        fwrite(header, 1, sizeof(header) - 1, fp);
+        fclose(fp);
+
+        bool thrown = false;
+        try
+        {
+            PlyReader ply(file);
+            std::vector<float> x;
+            ply.read("vertex", {"x"}, x);
+        }
+        catch (DataFormatException&)
+        {
+            thrown = true;
+        }
+        pi_assert(thrown);
+
+        thrown = false;
+        try
+        {
+            PlyReader ply(file + ".missing");
+        }
+        catch (FileNotFoundException&)
+        {
+            thrown = true;
+        }
+        pi_assert(thrown);
+
+        unlink(file.c_str());
+    }
+};
+
+PlyTest PlyTestInstance;
+
+#endif // HAS_PI_GUI
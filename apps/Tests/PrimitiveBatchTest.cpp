@@ -0,0 +1,68 @@
+#if defined(HAS_PI_GUI)
+
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <gui/gl/PrimitiveBatch.h>
+#include <gui/gl/ColorfulLine.h>
+
+using namespace pi;
+using namespace pi::gl;
+using namespace std;
+
+class PrimitiveBatchTest : public pi::TestCase
+{
+public:
+    PrimitiveBatchTest():pi::TestCase("PrimitiveBatchTest"){}
+
+    virtual void run()
+    {
+        // nothing here draws, so no GL context is needed
+        PrimitiveBatch batch;
+        pi_assert(batch.empty());
+
+        float   xyz[6] = { 0, 1, 2, 3, 4, 5 };
+        uint8_t rgb[6] = { 1, 2, 3, 4, 5, 6 };
+        batch.addPoints(xyz, rgb, 2);
+        batch.addPoints(xyz, 0, 1);
+        batch.addPoint(Point3f(7, 8, 9), Color3b(0, 0, 0));
+        pi_assert(batch.size(PrimitiveBatch::Points) == 4);
+
+        // strided records
+        struct Record { float x, y, z, w; } records[3] = { {0,0,0,0}, {1,1,1,1}, {2,2,2,2} };
+        batch.addPoints(&records[0].x, 0, 3, 4);
+        pi_assert(batch.size(PrimitiveBatch::Points) == 7);
+
+        Point3f strip[4] = { Point3f(0,0,0), Point3f(1,0,0), Point3f(1,1,0), Point3f(0,1,0) };
+        batch.addLineStrip(strip, 0, 4);
+        batch.addLine(strip[0], strip[2]);
+        pi_assert(batch.size(PrimitiveBatch::Lines) == 4);
+
+        batch.addPose(SE3f(), 0.5f);
+        pi_assert(batch.size(PrimitiveBatch::Poses) == 1);
+
+        // small objects append themselves
+        PrimitiveBatch scene;
+        ColorfulPoint point(Point3f(1, 2, 3));
+        pi_assert(point.batch(scene));
+        vector<ColorfulPoint> track(5, point);
+        pi_assert(ColorfulLine(track).batch(scene));
+        pi_assert(scene.size(PrimitiveBatch::Points) == 1 && scene.size(PrimitiveBatch::Lines) == 4);
+        pi_assert(!GL_Object().batch(scene));
+
+        pi_assert(batch.batch(scene));
+        pi_assert(scene.size(PrimitiveBatch::Points) == 8 && scene.size(PrimitiveBatch::Lines) == 8);
+
+        PrimitiveBatch copy(scene);
+        pi_assert(copy.size(PrimitiveBatch::Poses) == 1);
+        copy = batch;
+        pi_assert(copy.size(PrimitiveBatch::Lines) == 4);
+
+        scene.clear();
+        pi_assert(scene.empty());
+    }
+};
+
+PrimitiveBatchTest PrimitiveBatchTestInstance;
+
+#endif // HAS_PI_GUI
@@ -0,0 +1,226 @@
+#include <atomic>
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <base/Thread/Event.h>
+#include <base/Thread/Thread.h>
+#include <base/Thread/Epoch.h>
+#include <base/Thread/HazardPointer.h>
+#include <base/Thread/RcuPtr.h>
+
+using namespace pi;
+using namespace std;
+
+/// An object which notices use after free.
+struct Tracked
+{
+    enum { ALIVE = 0x600DF00D, DEAD = 0xDEADBEEF };
+
+    Tracked(int v = 0): magic(ALIVE), value(v) { live++; }
+    Tracked(const Tracked& o): magic(ALIVE), value(o.value) { live++; }
+    ~Tracked() { magic = DEAD; live--; }
+
+    unsigned int magic;
+    int          value;
+
+    static std::atomic<int> live;
+};
+
+std::atomic<int> Tracked::live(0);
+
+
+class ReclaimTest : public pi::TestCase
+{
+public:
+    ReclaimTest():pi::TestCase("ReclaimTest"){}
+
+    virtual void run()
+    {
+        testEpoch();
+        testEpochConcurrent();
+        testHazardPointer();
+        testHazardConcurrent();
+        testRcuPtr();
+    }
+
+    void testEpoch()
+    {
+        int live = Tracked::live;
+
+        // a reader on another thread keeps the object alive
+        Event      inside, release;
+        pi::Thread reader;
+        reader.startFunc([&]() {
+            Epoch::Guard guard;
+            inside.set();
+            release.wait();
+        });
+        inside.wait();
+
+        Epoch::retire(new Tracked(1));
+        pi_assert(Epoch::pending() == 1);
+        for (int i = 0; i < 4; i++) Epoch::reclaim();
+        pi_assert(Tracked::live == live + 1);
+
+        release.set();
+        reader.join();
+        Epoch::synchronize();
+        pi_assert(Epoch::pending() == 0);
+        pi_assert(Tracked::live == live);
+
+        // read sections nest
+        {
+            Epoch::Guard a;
+            Epoch::Guard b;
+            pi_assert(Epoch::inside());
+        }
+        pi_assert(!Epoch::inside());
+    }
+
+    void testEpochConcurrent()
+    {
+        std::atomic<Tracked*> shared(new Tracked(0));
+        std::atomic<bool>     stop(false);
+        std::atomic<int>      errors(0);
+
+        std::vector<pi::Thread*> readers;
+        for (int t = 0; t < 3; t++)
+        {
+            readers.push_back(new pi::Thread);
+            readers.back()->startFunc([&]() {
+                while (!stop.load())
+                {
+                    Epoch::Guard guard;
+                    Tracked* p = shared.load(std::memory_order_acquire);
+                    if (p->magic != Tracked::ALIVE) errors++;
+                }
+            });
+        }
+
+        for (int i = 1; i <= 20000; i++)
+        {
+            Epoch::retire(shared.exchange(new Tracked(i)));
+            if (i % 1000 == 0) pi::Thread::yield();
+        }
+        stop = true;
+        for (size_t t = 0; t < readers.size(); t++)
+        {
+            readers[t]->join();
+            delete readers[t];
+        }
+
+        delete shared.load();
+        Epoch::synchronize();
+        pi_assert(errors == 0);
+        pi_assert(Epoch::pending() == 0);
+    }
+
+    void testHazardPointer()
+    {
+        int live = Tracked::live;
+        std::atomic<Tracked*> shared(new Tracked(1));
+
+        {
+            HazardPointer hp;
+            Tracked* p = hp.protect(shared);
+            pi_assert(p->value == 1);
+
+            HazardPointer::retire(shared.exchange(new Tracked(2)));
+            HazardPointer::reclaim();
+            pi_assert(p->magic == Tracked::ALIVE);
+            pi_assert(HazardPointer::pending() == 1);
+
+            hp.reset();
+            HazardPointer::reclaim();
+            pi_assert(HazardPointer::pending() == 0);
+        }
+
+        delete shared.load();
+        pi_assert(Tracked::live == live);
+    }
+
+    void testHazardConcurrent()
+    {
+        std::atomic<Tracked*> shared(new Tracked(0));
+        std::atomic<bool>     stop(false);
+        std::atomic<int>      errors(0);
+
+        std::vector<pi::Thread*> readers;
+        for (int t = 0; t < 3; t++)
+        {
+            readers.push_back(new pi::Thread);
+            readers.back()->startFunc([&]() {
+                HazardPointer hp;
+                while (!stop.load())
+                {
+                    Tracked* p = hp.protect(shared);
+                    if (p->magic != Tracked::ALIVE) errors++;
+                    hp.reset();
+                }
+            });
+        }
+
+        for (int i = 1; i <= 20000; i++)
+        {
+            HazardPointer::retire(shared.exchange(new Tracked(i)));
+            if (i % 1000 == 0) pi::Thread::yield();
+        }
+        stop = true;
+        for (size_t t = 0; t < readers.size(); t++)
+        {
+            readers[t]->join();
+            delete readers[t];
+        }
+
+        delete shared.load();
+        HazardPointer::reclaim();
+        pi_assert(errors == 0);
+        pi_assert(HazardPointer::pending() == 0);
+    }
+
+    void testRcuPtr()
+    {
+        int live = Tracked::live;
+        {
+            RcuPtr<Tracked> value;
+            pi_assert(!value.read());
+
+            value.update([](Tracked& t) { t.value = 1; });
+            pi_assert(value.read()->value == 1);
+
+            std::atomic<bool> stop(false);
+            std::atomic<int>  errors(0);
+            pi::Thread        reader;
+            reader.startFunc([&]() {
+                int last = 0;
+                while (!stop.load())
+                {
+                    RcuPtr<Tracked>::ReadPtr p = value.read();
+                    if (p->magic != Tracked::ALIVE || p->value < last) errors++;
+                    last = p->value;
+                }
+            });
+
+            // two writers, no update may get lost
+            pi::Thread writer;
+            writer.startFunc([&]() {
+                for (int i = 0; i < 5000; i++) value.update([](Tracked& t) { t.value++; });
+            });
+            for (int i = 0; i < 5000; i++) value.update([](Tracked& t) { t.value++; });
+            writer.join();
+            stop = true;
+            reader.join();
+
+            pi_assert(errors == 0);
+            pi_assert(value.copy().value == 10001);
+
+            value.store(new Tracked(7));
+            pi_assert(value.read()->value == 7);
+            RcuPtr<Tracked>::synchronize();
+        }
+        Epoch::synchronize();
+        pi_assert(Tracked::live == live);
+    }
+};
+
+ReclaimTest ReclaimTestInstance;
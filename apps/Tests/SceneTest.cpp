@@ -0,0 +1,117 @@
+#if defined(HAS_PI_GUI)
+
+#include <atomic>
+#include <vector>
+
+#include <base/Utils/TestCase.h>
+#include <base/Thread/Thread.h>
+#include <gui/gl/GL_FatherObject.h>
+#include <gui/gl/PosedObject.h>
+#include <gui/gl/ColorfulPoint.h>
+
+using namespace pi;
+using namespace pi::gl;
+using namespace std;
+
+struct SceneTestObject : public GL_Object
+{
+    SceneTestObject(std::atomic<int>& counter):draws(counter){}
+
+    virtual void draw(){draws++;}
+
+    std::atomic<int>& draws;
+};
+
+class SceneTest : public pi::TestCase
+{
+public:
+    SceneTest():pi::TestCase("SceneTest"){}
+
+    virtual void run()
+    {
+        testCommands();
+        testProducers();
+    }
+
+    void testCommands()
+    {
+        // nothing drawn here issues GL calls, so no context is needed
+        Father_Object    scene;
+        std::atomic<int> draws(0);
+        GL_ObjectPtr     a(new SceneTestObject(draws)), b(new SceneTestObject(draws));
+
+        scene.insert(a);
+        scene.insert(b);
+        pi_assert(scene.size() == 0);
+        pi_assert(scene.apply() == 2 && scene.size() == 2);
+
+        scene.remove(a);
+        scene.draw();
+        pi_assert(scene.size() == 1 && draws == 1);
+
+        // objects by reference are batched, by pointer they stay children
+        pi_assert(scene.insert(ColorfulPoint()));
+        pi_assert(!scene.insert(GL_Object()));
+        GL_ObjectPtr point(new ColorfulPoint());
+        scene.insert(point);
+        scene.insert(SPtr<PrimitiveBatch>(new PrimitiveBatch));
+        pi_assert(scene.apply() == 3 && scene.size() == 3);
+        scene.remove(point);
+        pi_assert(scene.apply() == 1 && scene.size() == 2);
+
+        // poses are set in command order
+        SPtr<PosedObject> posed(new PosedObject(a));
+        scene.setPose(posed, SE3f(1, 2, 3, 0, 0, 0, 1));
+        pi_assert(posed->getPose().get_translation().x == 0);
+        scene.apply();
+        pi_assert(posed->getPose().get_translation().z == 3);
+
+        scene.clear();
+        pi_assert(scene.apply() == 1 && scene.size() == 0);
+    }
+
+    void testProducers()
+    {
+        const int THREADS = 4, ROUNDS = 2000;
+        Father_Object    scene;
+        std::atomic<int> draws(0), running(THREADS);
+
+        // producers insert objects and remove every other one while the
+        // "render thread" keeps drawing
+        std::vector<pi::Thread*> threads;
+        for (int t = 0; t < THREADS; t++)
+        {
+            threads.push_back(new pi::Thread);
+            threads.back()->startFunc([&]() {
+                for (int i = 0; i < ROUNDS; i++)
+                {
+                    GL_ObjectPtr obj(new SceneTestObject(draws));
+                    scene.insert(obj);
+                    if (i % 2) scene.remove(obj);
+                }
+                running--;
+            });
+        }
+
+        int frames = 0;
+        while (running > 0)
+        {
+            scene.draw();
+            frames++;
+        }
+        for (int t = 0; t < THREADS; t++)
+        {
+            threads[t]->join();
+            delete threads[t];
+        }
+
+        draws = 0;
+        scene.draw();
+        pi_assert(frames > 0);
+        pi_assert(scene.size() == (size_t) THREADS * ROUNDS / 2 && draws == THREADS * ROUNDS / 2);
+    }
+};
+
+SceneTest SceneTestInstance;
+
+#endif // HAS_PI_GUI
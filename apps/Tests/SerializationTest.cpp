@@ -0,0 +1,226 @@
+#include <base/Utils/TestCase.h>
+#include <base/Types/Serialization.h>
+
+using namespace pi;
+using namespace std;
+
+namespace {
+
+struct Sample
+{
+    Sample(): id(0), valid(false) {}
+
+    int32_t             id;
+    std::string         name;
+    bool                valid;
+    SE3d                pose;
+    std::vector<float>  values;
+    std::vector<Point3d> points;
+};
+
+struct RecordV1
+{
+    RecordV1(): a(0) {}
+
+    int32_t     a;
+    std::string b;
+};
+
+struct RecordV2
+{
+    RecordV2(): a(0), c(-1) {}
+
+    int32_t     a;
+    std::string b;
+    double      c;
+};
+
+}
+
+namespace pi {
+
+PIL_SERIALIZABLE(Sample, 1, id, name, valid, pose, values, points)
+PIL_SERIALIZABLE(RecordV1, 1, a, b)
+
+template <>
+struct Schema<RecordV2>: SchemaBase<RecordV2, 2>
+{
+    PIL_SCHEMA_FIELD(a, 1)
+    PIL_SCHEMA_FIELD(b, 1)
+    PIL_SCHEMA_FIELD(c, 2)
+    typedef PIL_SCHEMA_FIELDS(a, b, c) Fields;
+};
+
+}
+
+class SerializationTest : public pi::TestCase
+{
+public:
+    SerializationTest():pi::TestCase("SerializationTest"){}
+
+    virtual void run()
+    {
+        testBinary();
+        testBulk();
+        testVersions();
+        testText();
+    }
+
+    void testBinary();
+    void testBulk();
+    void testVersions();
+    void testText();
+
+    static Sample sample()
+    {
+        Sample s;
+        s.id    = 7;
+        s.name  = "imu \"0\"";
+        s.valid = true;
+        s.pose  = SE3d(1, 2, 3, 0, 0, 0.70710678118654757, 0.70710678118654757);
+        s.values.push_back(0.1f);
+        s.values.push_back(-2.5f);
+        s.points.push_back(Point3d(1, 2, 3));
+        s.points.push_back(Point3d(4, 5, 6));
+        return s;
+    }
+
+    static bool equal(const Point3d& a, const Point3d& b)
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+
+    static bool equal(const Sample& a, const Sample& b)
+    {
+        return a.id == b.id && a.name == b.name && a.valid == b.valid
+            && equal(a.pose.get_translation(), b.pose.get_translation())
+            && a.pose.get_rotation().w == b.pose.get_rotation().w
+            && a.pose.get_rotation().z == b.pose.get_rotation().z
+            && a.values == b.values && a.points.size() == b.points.size()
+            && equal(a.points[1], b.points[1]);
+    }
+};
+
+SerializationTest SerializationTestInstance;
+
+
+void SerializationTest::testBinary()
+{
+    Sample in = sample(), out;
+
+    RDataStream ds;
+    serialize(ds, in);
+    ds.rewind();
+    deserialize(ds, out);
+    pi_assert (equal(in, out));
+
+    RDataStream2 ds2;
+    serialize(ds2, in);
+    RDataStream2 view(ds2.data(), ds2.size());
+    Sample out2;
+    deserialize(view, out2);
+    pi_assert (equal(in, out2));
+    pi_assert (view.remaining() == 0);
+
+    // a truncated stream is detected
+    RDataStream2 truncated(ds2.data(), ds2.size() - 1);
+    try
+    {
+        deserialize(truncated, out2);
+        pi_assert (false);
+    }
+    catch (DataFormatException&)
+    {
+    }
+}
+
+
+void SerializationTest::testBulk()
+{
+    pi_assert (SchemaLayout::isFixed<SE3d>());
+    pi_assert (SchemaLayout::isFixed<SIM3d>());
+    pi_assert (SchemaLayout::isFixed<Point3f>());
+    pi_assert (!SchemaLayout::isFixed<Sample>());
+
+    std::vector<SE3d> poses;
+    for (int i = 0; i < 100; i++)
+        poses.push_back(SE3d(i, 2*i, 3*i, 0, 0, 0, 1));
+
+    // count and the memory image
+    RDataStream2 ds;
+    serialize(ds, poses);
+    pi_assert (ds.size() == 8 + 4 + 100*sizeof(SE3d));
+
+    // which is the same as the element-wise encoding
+    RDataStream2 fieldwise;
+    fieldwise << (uint32_t) poses.size();
+    for (int i = 0; i < 100; i++) serialize(fieldwise, poses[i]);
+    pi_assert (fieldwise.size() == ds.size());
+    pi_assert (memcmp(fieldwise.data(), ds.data(), ds.size()) == 0);
+
+    std::vector<SE3d> out;
+    RDataStream2 in(ds.data(), ds.size());
+    deserialize(in, out);
+    pi_assert (out.size() == 100);
+    pi_assert (equal(out[99].get_translation(), poses[99].get_translation()));
+}
+
+
+void SerializationTest::testVersions()
+{
+    RecordV1 v1;
+    v1.a = 3;
+    v1.b = "old";
+
+    // old data, new schema: the new field keeps its default
+    RDataStream2 ds;
+    serialize(ds, v1);
+    RecordV2 v2;
+    RDataStream2 in(ds.data(), ds.size());
+    deserialize(in, v2);
+    pi_assert (v2.a == 3 && v2.b == "old" && v2.c == -1);
+
+    // new data, old schema
+    v2.c = 2;
+    RDataStream2 ds2;
+    serialize(ds2, v2);
+    RDataStream2 in2(ds2.data(), ds2.size());
+    try
+    {
+        deserialize(in2, v1);
+        pi_assert (false);
+    }
+    catch (DataFormatException&)
+    {
+    }
+
+    // text is matched by name, unknown fields are skipped
+    RecordV1 t1;
+    fromText(toText(v2), t1);
+    pi_assert (t1.a == 3 && t1.b == "old");
+}
+
+
+void SerializationTest::testText()
+{
+    Sample in = sample(), out;
+    std::string text = toText(in);
+    pi_assert (text.find("name = \"imu \\\"0\\\"\"") != std::string::npos);
+
+    fromText(text, out);
+    pi_assert (equal(in, out));
+
+    SIM3d sim(SE3d(1, 2, 3, 0, 0, 0, 1), 0.1);
+    SIM3d sim2;
+    fromText(toText(sim), sim2);
+    pi_assert (sim2.get_scale() == 0.1);
+
+    try
+    {
+        fromText("{ version = 1 id = x }", out);
+        pi_assert (false);
+    }
+    catch (DataFormatException&)
+    {
+    }
+}
@@ -0,0 +1,160 @@
+#include <base/Time/Global_Timer.h>
+#include <base/Thread/Thread.h>
+#include <network/SocketReactor.h>
+#include <network/EchoServer.h>
+#include <network/StreamSocket.h>
+#include <network/ServerSocket.h>
+#include <network/DatagramSocket.h>
+#include <network/SocketAddress.h>
+#include <base/Utils/TestCase.h>
+
+using namespace pi;
+using namespace std;
+
+class SocketReactorTest : public pi::TestCase, public SocketEventHandler, public SocketTimerHandler
+{
+public:
+    SocketReactorTest():pi::TestCase("SocketReactorTest"),_readable(0),_timers(0){}
+
+    virtual void run()
+    {
+        testStreamEcho();
+        testAccept();
+        testDatagram();
+        testTimer();
+        testWakeUp();
+    }
+
+    void testStreamEcho();
+    void testAccept();
+    void testDatagram();
+    void testTimer();
+    void testWakeUp();
+
+    virtual void onSocketReady(Socket& socket, int events)
+    {
+        if (!(events & SocketReactor::EVENT_READ)) return;
+        ++_readable;
+        char buffer[256];
+        if (socket == _server)
+        {
+            _accepted = _server.acceptConnection();
+            return;
+        }
+        // edge-triggered: drain until the socket would block
+        int n;
+        while ((n = socket.impl()->receiveBytes(buffer, sizeof(buffer))) > 0)
+            _received.append(buffer, n);
+    }
+
+    virtual void onTimer(int /*timerId*/)
+    {
+        ++_timers;
+    }
+
+private:
+    int          _readable;
+    int          _timers;
+    std::string  _received;
+    ServerSocket _server;
+    StreamSocket _accepted;
+};
+
+SocketReactorTest SocketReactorTestInstance;
+
+
+void SocketReactorTest::testStreamEcho()
+{
+    EchoServer echoServer;
+    StreamSocket ss;
+    ss.connect(SocketAddress("localhost", echoServer.port()));
+
+    SocketReactor reactor;
+    _received.clear();
+    reactor.addSocket(ss, this, SocketReactor::EVENT_READ);
+    pi_assert (reactor.hasSocket(ss));
+    pi_assert (reactor.countSockets() == 1);
+    pi_assert (!ss.getBlocking());
+
+    ss.sendBytes("hello", 5);
+    for (int i = 0; i < 20 && _received.size() < 5; i++)
+        reactor.runOnce(Timespan(100000));
+    pi_assert (_received == "hello");
+
+    reactor.removeSocket(ss);
+    pi_assert (!reactor.hasSocket(ss));
+    ss.close();
+}
+
+
+void SocketReactorTest::testAccept()
+{
+    _server.bind(SocketAddress());
+    _server.listen();
+
+    SocketReactor reactor;
+    reactor.addSocket(_server, this, SocketReactor::EVENT_READ);
+
+    StreamSocket ss;
+    ss.connect(SocketAddress("localhost", _server.address().port()));
+    for (int i = 0; i < 20 && !_accepted.impl()->initialized(); i++)
+        reactor.runOnce(Timespan(100000));
+    pi_assert (_accepted.impl()->initialized());
+    pi_assert (_accepted.peerAddress().port() == ss.address().port());
+    _accepted.close();
+    _server.close();
+    ss.close();
+}
+
+
+void SocketReactorTest::testDatagram()
+{
+    DatagramSocket receiver(SocketAddress("127.0.0.1", 0));
+    DatagramSocket sender(IPAddress::IPv4);
+
+    SocketReactor reactor;
+    _received.clear();
+    reactor.addSocket(receiver, this, SocketReactor::EVENT_READ);
+
+    sender.sendTo("ping", 4, SocketAddress("127.0.0.1", receiver.address().port()));
+    for (int i = 0; i < 20 && _received.size() < 4; i++)
+        reactor.runOnce(Timespan(100000));
+    pi_assert (_received == "ping");
+}
+
+
+void SocketReactorTest::testTimer()
+{
+    SocketReactor reactor;
+    _timers = 0;
+    reactor.addTimer(Timespan(10000), this);
+    int periodic = reactor.addTimer(Timespan(10000), this, Timespan(10000));
+
+    pi::TicTac sw;
+    while (_timers < 4 && sw.Tac() < 2)
+        reactor.runOnce(Timespan(1000000));
+    pi_assert (_timers >= 4);
+    pi_assert (sw.Tac() < 1);
+
+    reactor.cancelTimer(periodic);
+    int fired = _timers;
+    reactor.runOnce(Timespan(50000));
+    pi_assert (_timers == fired);
+}
+
+
+void SocketReactorTest::testWakeUp()
+{
+    SocketReactor reactor(Timespan(5, 0));
+    Thread thread;
+    thread.startFunc([&reactor]() {
+        Thread::sleep(50);
+        reactor.stop();
+    });
+
+    pi::TicTac sw;
+    reactor.run();
+    thread.join();
+    pi_assert (reactor.isStopped());
+    pi_assert (sw.Tac() < 2);
+}
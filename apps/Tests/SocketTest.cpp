@@ -6,6 +6,8 @@
 #include <network/ServerSocket.h>
 #include <network/NetException.h>
 #include <base/Utils/TestCase.h>
+#include <base/Path/Path.h>
+#include <cstdio>
 
 using namespace pi;
 using namespace std;
@@ -33,6 +35,9 @@ public:
         testSelect();
         testSelect2();
         testSelect3();
+        testScatterGather();
+        testSendFile();
+        testZeroCopy();
     }
 
     void testEcho();
@@ -51,6 +56,9 @@ public:
     void testSelect();
     void testSelect2();
     void testSelect3();
+    void testScatterGather();
+    void testSendFile();
+    void testZeroCopy();
 
     void setUp();
     void tearDown();
@@ -514,6 +522,104 @@ void SocketTest::testSelect3()
 }
 
 
+void SocketTest::testScatterGather()
+{
+    EchoServer echoServer;
+    StreamSocket ss;
+    ss.connect(SocketAddress("localhost", echoServer.port()));
+
+    char header[] = "head:";
+    char payload[] = "payload";
+    SocketBufVec out;
+    out.push_back(Socket::makeBuffer(header, 5));
+    out.push_back(Socket::makeBuffer(payload, 7));
+    int n = ss.sendv(out);
+    pi_assert (n == 12);
+
+    char in1[5];
+    char in2[64];
+    SocketBufVec in;
+    in.push_back(Socket::makeBuffer(in1, sizeof(in1)));
+    in.push_back(Socket::makeBuffer(in2, sizeof(in2)));
+    n = ss.receivev(in);
+    pi_assert (n == 12);
+    pi_assert (std::string(in1, 5) == "head:");
+    pi_assert (std::string(in2, 7) == "payload");
+    ss.close();
+}
+
+
+void SocketTest::testSendFile()
+{
+    std::string path = Path::temp() + "SocketTest_sendFile.tmp";
+    std::string content;
+    for (int i = 0; i < 100000; i++)
+        content += (char) ('a' + i % 26);
+    FILE* file = fopen(path.c_str(), "wb");
+    pi_assert (file);
+    fwrite(content.data(), 1, content.size(), file);
+    fclose(file);
+
+    ServerSocket server(SocketAddress("127.0.0.1", 0));
+    StreamSocket client(SocketAddress("127.0.0.1", server.address().port()));
+    StreamSocket peer = server.acceptConnection();
+
+    pi_assert (client.sendFile(path, 1000, 50000) == 50000);
+    pi_assert (client.sendFile(path, 99000) == 1000);
+    client.shutdownSend();
+
+    std::string received;
+    char buffer[8192];
+    int n;
+    while ((n = peer.receiveBytes(buffer, sizeof(buffer))) > 0)
+        received.append(buffer, n);
+    pi_assert (received == content.substr(1000, 50000) + content.substr(99000));
+
+    remove(path.c_str());
+}
+
+
+void SocketTest::testZeroCopy()
+{
+    ServerSocket server(SocketAddress("127.0.0.1", 0));
+    StreamSocket client(SocketAddress("127.0.0.1", server.address().port()));
+    StreamSocket peer = server.acceptConnection();
+
+    std::string data(256 * 1024, 'z');
+    pi_assert (client.sendBytesZeroCopy(data.data(), 100) == 100);
+    pi_assert (client.zeroCopySent() == 0);
+
+    int total = 0;
+    int expected = 100 + (int) data.size();
+    bool done = false;
+    client.setBlocking(false);
+    int sent = 0;
+    char buffer[65536];
+    while (total < expected)
+    {
+        if (sent < (int) data.size())
+        {
+            try
+            {
+                sent += client.sendBytesZeroCopy(data.data() + sent, (int) data.size() - sent);
+            }
+            catch (NetException&)
+            {
+            }
+        }
+        if (peer.poll(Timespan(10000), Socket::SELECT_READ))
+        {
+            int n = peer.receiveBytes(buffer, sizeof(buffer));
+            pi_assert (n > 0);
+            total += n;
+        }
+    }
+    for (int i = 0; i < 100 && !done; i++)
+        done = client.zeroCopyCompleted(Timespan(10000)) == client.zeroCopySent();
+    pi_assert (done);
+}
+
+
 void SocketTest::onReadable(bool& b)
 {
     if (b) ++_notToReadable;
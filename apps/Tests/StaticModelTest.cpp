@@ -0,0 +1,97 @@
+#if defined(HAS_PI_GUI)
+
+#include <string>
+
+#include <base/Utils/TestCase.h>
+#include <gui/gl/StaticModel.h>
+
+using namespace pi;
+using namespace pi::gl;
+using namespace std;
+
+static int loads=0;
+
+static SPtr<StaticModel> loadQuad(const string& filename)
+{
+    loads++;
+    if(filename=="missing") return SPtr<StaticModel>();
+    SPtr<StaticModel> model(new StaticModel);
+    StaticModel::Material white={{0,0,0,1},{1,1,1,1},{0,0,0,1},0};
+    unsigned int m=model->addMaterial(white);
+    StaticModel::Vertex a={{0,0,0},{0,0,1}},b={{1,0,0},{0,0,1}},c={{1,1,0},{0,0,1}},d={{0,1,0},{0,0,1}};
+    StaticModel::Vertex first[3]={a,b,c},second[3]={a,c,d};
+    model->addTriangle(m,first);
+    model->addTriangle(m,second);
+    return model;
+}
+
+class StaticModelTest : public pi::TestCase
+{
+public:
+    StaticModelTest():pi::TestCase("StaticModelTest"){}
+
+    virtual void run()
+    {
+        testGroups();
+        testCache();
+    }
+
+    void testGroups()
+    {
+        StaticModel model;
+        StaticModel::Material material={{0,0,0,1},{1,0,0,1},{0,0,0,1},0};
+        unsigned int red=model.addMaterial(material);
+        unsigned int unused=model.addMaterial(material);
+        unsigned int green=model.addMaterial(material);
+        pi_assert(red==0&&unused==1&&green==2);
+
+        // materials in any order; corners equal in position and normal
+        // are one vertex
+        StaticModel::Vertex a={{0,0,0},{0,0,1}},b={{1,0,0},{0,0,1}},c={{1,1,0},{0,0,1}};
+        StaticModel::Vertex flipped={{1,1,0},{0,0,-1}},far={{5,-2,3},{0,0,1}};
+        StaticModel::Vertex t0[3]={a,b,c},t1[3]={a,c,far},t2[3]={b,a,flipped};
+        model.addTriangle(green,t0);
+        model.addTriangle(red,t1);
+        model.addTriangle(green,t2);
+
+        pi_assert(model.triangles()==3);
+        pi_assert(model.vertices().size()==5);
+        const vector<StaticModel::Group>& groups=model.groups();
+        pi_assert(groups.size()==2);
+        pi_assert(groups[0].material==red&&groups[0].first==0&&groups[0].count==3);
+        pi_assert(groups[1].material==green&&groups[1].first==3&&groups[1].count==6);
+
+        const vector<unsigned int>& indices=model.indices();
+        unsigned int expected[9]={0,2,3,0,1,2,1,0,4};
+        pi_assert(indices.size()==9);
+        for(int i=0;i<9;i++) pi_assert(indices[i]==expected[i]);
+
+        pi_assert(model.box().min.x==0&&model.box().min.y==-2&&model.box().max.x==5&&model.box().max.z==3);
+    }
+
+    void testCache()
+    {
+        loads=0;
+        SPtr<StaticModel> first=StaticModel::cached("quad",loadQuad);
+        SPtr<StaticModel> second=StaticModel::cached("quad",loadQuad);
+        pi_assert(first&&first.get()==second.get()&&loads==1);
+        pi_assert(first->triangles()==2&&first->vertices().size()==4);
+
+        SPtr<StaticModel> other=StaticModel::cached("other",loadQuad);
+        pi_assert(other.get()!=first.get()&&loads==2);
+
+        // failures are tried again
+        pi_assert(!StaticModel::cached("missing",loadQuad));
+        pi_assert(!StaticModel::cached("missing",loadQuad)&&loads==4);
+
+        // once nobody holds it, the model is loaded again
+        first.reset();
+        second.reset();
+        SPtr<StaticModel> again=StaticModel::cached("quad",loadQuad);
+        pi_assert(again&&loads==5);
+    }
+};
+
+StaticModelTest StaticModelTestInstance;
+
+#endif // HAS_PI_GUI
@@ -0,0 +1,129 @@
+#include <base/Thread/Thread.h>
+#include <network/TCPReactorServer.h>
+#include <network/StreamSocket.h>
+#include <network/SocketAddress.h>
+#include <base/Utils/TestCase.h>
+#include <base/Utils/utils_str.h>
+
+using namespace pi;
+using namespace std;
+
+namespace {
+
+class EchoConnection: public TCPReactorConnection
+{
+public:
+    EchoConnection(const StreamSocket& s): TCPReactorConnection(s)
+    {
+    }
+
+    void onData(const char* data, int length)
+    {
+        if (length >= 4 && std::string(data, 4) == "quit")
+            close();
+        else
+            send(data, length);
+    }
+};
+
+}
+
+class TCPReactorServerTest : public pi::TestCase
+{
+public:
+    TCPReactorServerTest():pi::TestCase("TCPReactorServerTest"){}
+
+    virtual void run()
+    {
+        testEcho();
+        testManyConnections();
+        testServerClose();
+    }
+
+    void testEcho();
+    void testManyConnections();
+    void testServerClose();
+
+    static bool waitFor(const TCPReactorServer& srv, int current)
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            if (srv.currentConnections() == current) return true;
+            Thread::sleep(10);
+        }
+        return false;
+    }
+};
+
+TCPReactorServerTest TCPReactorServerTestInstance;
+
+
+void TCPReactorServerTest::testEcho()
+{
+    TCPReactorServer srv(new TCPReactorConnectionFactoryImpl<EchoConnection>(), 0, 2);
+    srv.start();
+    pi_assert (srv.threads() == 2);
+    pi_assert (srv.currentConnections() == 0);
+    pi_assert (srv.totalConnections() == 0);
+
+    SocketAddress sa("localhost", srv.port());
+    StreamSocket ss1(sa);
+    std::string data("hello, world");
+    ss1.sendBytes(data.data(), (int) data.size());
+    char buffer[256];
+    int n = ss1.receiveBytes(buffer, sizeof(buffer));
+    pi_assert (n > 0);
+    pi_assert (std::string(buffer, n) == data);
+    pi_assert (waitFor(srv, 1));
+    pi_assert (srv.totalConnections() == 1);
+    ss1.close();
+    pi_assert (waitFor(srv, 0));
+    srv.stop();
+}
+
+
+void TCPReactorServerTest::testManyConnections()
+{
+    TCPReactorServer srv(new TCPReactorConnectionFactoryImpl<EchoConnection>(), 0, 2);
+    srv.start();
+
+    SocketAddress sa("localhost", srv.port());
+    std::vector<StreamSocket> clients;
+    for (int i = 0; i < 64; i++)
+        clients.push_back(StreamSocket(sa));
+
+    // far more connections than reactor threads, all served concurrently
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        std::string data("ping");
+        data += pi::itos((int) i);
+        clients[i].sendBytes(data.data(), (int) data.size());
+        char buffer[256];
+        int n = clients[i].receiveBytes(buffer, sizeof(buffer));
+        pi_assert (std::string(buffer, n) == data);
+    }
+    pi_assert (waitFor(srv, 64));
+    pi_assert (srv.maxConcurrentConnections() == 64);
+
+    for (size_t i = 0; i < clients.size(); i++)
+        clients[i].close();
+    pi_assert (waitFor(srv, 0));
+    pi_assert (srv.totalConnections() == 64);
+    srv.stop();
+}
+
+
+void TCPReactorServerTest::testServerClose()
+{
+    TCPReactorServer srv(new TCPReactorConnectionFactoryImpl<EchoConnection>(), 0, 1);
+    srv.start();
+
+    StreamSocket ss(SocketAddress("localhost", srv.port()));
+    ss.sendBytes("quit", 4);
+    char buffer[256];
+    int n = ss.receiveBytes(buffer, sizeof(buffer));
+    pi_assert (n == 0);
+    pi_assert (waitFor(srv, 0));
+    ss.close();
+    srv.stop();
+}
@@ -0,0 +1,22 @@
+# EGL lets pi_gui render without a window, see gui/gl/OffscreenRenderer.h
+
+FIND_PATH(EGL_INCLUDES EGL/egl.h
+    /usr/include
+    /usr/local/include
+    /opt/local/include
+  )
+
+FIND_LIBRARY(EGL_LIBRARIES NAMES EGL
+  PATHS
+  /usr/lib
+  /usr/local/lib
+  /opt/local/lib
+  )
+
+
+IF(EGL_INCLUDES AND EGL_LIBRARIES)
+  SET(EGL_FOUND TRUE)
+	MESSAGE("-- Found EGL: ${EGL_LIBRARIES}")
+ELSE(EGL_INCLUDES AND EGL_LIBRARIES)
+  SET(EGL_FOUND FALSE)
+ENDIF(EGL_INCLUDES AND EGL_LIBRARIES)
@@ -0,0 +1,985 @@
+#include "LZFSEStream.h"
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(PIL_OS_FAMILY_UNIX)
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+extern "C" {
+#include "lzfse.h"
+}
+
+#include "base/Debug/Exception.h"
+#include "base/Debug/ErrorHandler.h"
+#include "base/Thread/Event.h"
+#include "base/Thread/Mutex.h"
+#include "base/Thread/Runnable.h"
+#include "base/Thread/Thread.h"
+#include "base/Types/ByteOrder.h"
+#include "base/Utils/Environment.h"
+#include "base/Utils/crc.h"
+
+
+namespace pi {
+namespace compress {
+
+
+namespace
+{
+    const char      STREAM_MAGIC[4] = { 'P', 'L', 'Z', 'F' };
+    const char      INDEX_MAGIC[4]  = { 'P', 'L', 'Z', 'X' };
+    const int       HEADER_SIZE       = 8;
+    const int       BLOCK_HEADER_SIZE = 12;
+    const int       FOOTER_SIZE       = 20;
+    const int       MAX_BLOCK_SIZE    = 1 << 30;
+    const int       ENCODE_OVERHEAD   = 12;
+        // lzfse_encode_buffer() always succeeds with this much room,
+        // storing incompressible data as an uncompressed block.
+
+    inline void put32(UInt8* p, UInt32 value)
+    {
+        value = ByteOrder::toLittleEndian(value);
+        memcpy(p, &value, 4);
+    }
+
+    inline void put64(UInt8* p, UInt64 value)
+    {
+        value = ByteOrder::toLittleEndian(value);
+        memcpy(p, &value, 8);
+    }
+
+    inline UInt32 get32(const UInt8* p)
+    {
+        UInt32 value;
+        memcpy(&value, p, 4);
+        return ByteOrder::fromLittleEndian(value);
+    }
+
+    inline UInt64 get64(const UInt8* p)
+    {
+        UInt64 value;
+        memcpy(&value, p, 8);
+        return ByteOrder::fromLittleEndian(value);
+    }
+
+    std::size_t readFully(ChunkSource& source, void* data, std::size_t length)
+    {
+        std::size_t done = 0;
+        while (done < length)
+        {
+            std::size_t n = source.read((char*) data + done, length - done);
+            if (n == 0) break;
+            done += n;
+        }
+        return done;
+    }
+
+    int threadCount(int threads)
+    {
+        if (threads < 0) return std::max(1, (int) Environment::processorCount());
+        return threads;
+    }
+}
+
+
+//
+// Jobs and workers
+//
+
+
+struct LZFSEScratch
+    /// LZFSE scratch memory, owned by one thread.
+{
+    std::vector<UInt8> encode;
+    std::vector<UInt8> decode;
+};
+
+
+struct LZFSEChunkJob
+    /// One block, compressed or decompressed by a worker.
+{
+    enum Mode
+    {
+        COMPRESS,
+        DECOMPRESS
+    };
+
+    LZFSEChunkJob(): mode(COMPRESS), rawSize(0), packedSize(0), crc(0), done(true), pending(false)
+    {
+    }
+
+    void process(LZFSEScratch& scratch);
+        /// Runs the job. Errors are stored in error.
+
+    Mode                mode;
+    std::vector<UInt8>  raw;
+    std::vector<UInt8>  packed;
+    std::size_t         rawSize;
+    std::size_t         packedSize;
+    UInt32              crc;
+    Event               done;
+    bool                pending;
+    std::string         error;
+};
+
+
+void LZFSEChunkJob::process(LZFSEScratch& scratch)
+{
+    error.clear();
+    if (mode == COMPRESS)
+    {
+        if (scratch.encode.empty()) scratch.encode.resize(lzfse_encode_scratch_size() + 1);
+        if (packed.size() < rawSize + ENCODE_OVERHEAD) packed.resize(rawSize + ENCODE_OVERHEAD);
+
+        packedSize = lzfse_encode_buffer(&packed[0], packed.size(), &raw[0], rawSize, &scratch.encode[0]);
+        crc = pi::crc32(&raw[0], (int) rawSize);
+        if (packedSize == 0) error = "LZFSE compression failed";
+    }
+    else
+    {
+        if (scratch.decode.empty()) scratch.decode.resize(lzfse_decode_scratch_size() + 1);
+        // one spare byte tells a complete block from a truncated one
+        if (raw.size() < rawSize + 1) raw.resize(rawSize + 1);
+
+        std::size_t n = lzfse_decode_buffer(&raw[0], rawSize + 1, &packed[0], packedSize, &scratch.decode[0]);
+        if (n != rawSize)
+            error = "corrupt LZFSE block";
+        else if (pi::crc32(&raw[0], (int) rawSize) != crc)
+            error = "LZFSE block checksum mismatch";
+    }
+}
+
+
+class LZFSEWorkerPool: public Runnable
+    /// A fixed number of threads working off a queue of jobs.
+    /// Every thread has its own scratch memory.
+{
+public:
+    LZFSEWorkerPool(int threads): _stop(false)
+    {
+        for (int i = 0; i < threads; i++)
+        {
+            Thread* pThread = new Thread;
+            pThread->setName("LZFSEWorker");
+            _threads.push_back(pThread);
+        }
+        for (std::size_t i = 0; i < _threads.size(); i++)
+            _threads[i]->start(*this);
+    }
+
+    ~LZFSEWorkerPool()
+    {
+        {
+            FastMutex::ScopedLock lock(_mutex);
+            _stop = true;
+        }
+        _wake.set();
+        for (std::size_t i = 0; i < _threads.size(); i++)
+        {
+            _threads[i]->join();
+            delete _threads[i];
+        }
+    }
+
+    void enqueue(LZFSEChunkJob* pJob)
+    {
+        {
+            FastMutex::ScopedLock lock(_mutex);
+            _queue.push_back(pJob);
+        }
+        _wake.set();
+    }
+
+    void run()
+    {
+        LZFSEScratch scratch;
+        for (;;)
+        {
+            LZFSEChunkJob* pJob = 0;
+            bool more = false;
+            {
+                FastMutex::ScopedLock lock(_mutex);
+                if (_stop)
+                {
+                    more = true;
+                }
+                else if (!_queue.empty())
+                {
+                    pJob = _queue.front();
+                    _queue.pop_front();
+                    more = !_queue.empty();
+                }
+            }
+            // the event wakes a single thread, which passes it on
+            if (more) _wake.set();
+            if (!pJob)
+            {
+                if (_stop) return;
+                _wake.wait();
+                continue;
+            }
+            pJob->process(scratch);
+            pJob->done.set();
+        }
+    }
+
+private:
+    std::vector<Thread*>        _threads;
+    std::deque<LZFSEChunkJob*>  _queue;
+    FastMutex                   _mutex;
+    Event                       _wake;
+    bool                        _stop;
+};
+
+
+//
+// Sinks and sources
+//
+
+
+ChunkSink::~ChunkSink()
+{
+}
+
+
+StreamChunkSink::StreamChunkSink(std::ostream& stream): _stream(stream)
+{
+}
+
+
+void StreamChunkSink::write(const void* data, std::size_t length)
+{
+    _stream.write((const char*) data, length);
+    if (!_stream) throw WriteFileException("cannot write compressed stream");
+}
+
+
+FileChunkSink::FileChunkSink(int fd): _fd(fd)
+{
+}
+
+
+void FileChunkSink::write(const void* data, std::size_t length)
+{
+#if defined(PIL_OS_FAMILY_UNIX)
+    const char* p = (const char*) data;
+    while (length > 0)
+    {
+        ssize_t n = ::write(_fd, p, length);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            throw WriteFileException("cannot write compressed file", strerror(errno));
+        }
+        p      += n;
+        length -= n;
+    }
+#else
+    throw NotImplementedException("FileChunkSink");
+#endif
+}
+
+
+ChunkSource::~ChunkSource()
+{
+}
+
+
+bool ChunkSource::seekable() const
+{
+    return false;
+}
+
+
+UInt64 ChunkSource::size()
+{
+    throw NotImplementedException("random access to this ChunkSource");
+}
+
+
+void ChunkSource::readAt(UInt64, void*, std::size_t)
+{
+    throw NotImplementedException("random access to this ChunkSource");
+}
+
+
+StreamChunkSource::StreamChunkSource(std::istream& stream):
+    _stream(stream),
+    _pMutex(new FastMutex),
+    _seekable(false)
+{
+    std::istream::pos_type pos = _stream.tellg();
+    if (pos != std::istream::pos_type(-1))
+    {
+        _seekable = bool(_stream.seekg(0, std::ios::end));
+        _stream.seekg(pos);
+    }
+    _stream.clear();
+}
+
+
+StreamChunkSource::~StreamChunkSource()
+{
+    delete _pMutex;
+}
+
+
+std::size_t StreamChunkSource::read(void* data, std::size_t length)
+{
+    FastMutex::ScopedLock lock(*_pMutex);
+    _stream.read((char*) data, length);
+    return _stream.gcount();
+}
+
+
+bool StreamChunkSource::seekable() const
+{
+    return _seekable;
+}
+
+
+UInt64 StreamChunkSource::size()
+{
+    if (!_seekable) return ChunkSource::size();
+
+    FastMutex::ScopedLock lock(*_pMutex);
+    _stream.clear();
+    std::istream::pos_type pos = _stream.tellg();
+    _stream.seekg(0, std::ios::end);
+    UInt64 result = _stream.tellg();
+    _stream.seekg(pos);
+    return result;
+}
+
+
+void StreamChunkSource::readAt(UInt64 offset, void* data, std::size_t length)
+{
+    if (!_seekable) ChunkSource::readAt(offset, data, length);
+
+    FastMutex::ScopedLock lock(*_pMutex);
+    _stream.clear();
+    std::istream::pos_type pos = _stream.tellg();
+    _stream.seekg(offset);
+    _stream.read((char*) data, length);
+    std::size_t n = _stream.gcount();
+    _stream.clear();
+    _stream.seekg(pos);
+    if (n != length) throw ReadFileException("unexpected end of compressed stream");
+}
+
+
+FileChunkSource::FileChunkSource(int fd): _fd(fd)
+{
+}
+
+
+std::size_t FileChunkSource::read(void* data, std::size_t length)
+{
+#if defined(PIL_OS_FAMILY_UNIX)
+    for (;;)
+    {
+        ssize_t n = ::read(_fd, data, length);
+        if (n >= 0) return n;
+        if (errno != EINTR) throw ReadFileException("cannot read compressed file", strerror(errno));
+    }
+#else
+    throw NotImplementedException("FileChunkSource");
+#endif
+}
+
+
+bool FileChunkSource::seekable() const
+{
+#if defined(PIL_OS_FAMILY_UNIX)
+    struct stat st;
+    return fstat(_fd, &st) == 0 && S_ISREG(st.st_mode);
+#else
+    return false;
+#endif
+}
+
+
+UInt64 FileChunkSource::size()
+{
+#if defined(PIL_OS_FAMILY_UNIX)
+    struct stat st;
+    if (fstat(_fd, &st) != 0) throw ReadFileException("cannot stat compressed file", strerror(errno));
+    return st.st_size;
+#else
+    return ChunkSource::size();
+#endif
+}
+
+
+void FileChunkSource::readAt(UInt64 offset, void* data, std::size_t length)
+{
+#if defined(PIL_OS_FAMILY_UNIX)
+    char* p = (char*) data;
+    while (length > 0)
+    {
+        ssize_t n = ::pread(_fd, p, length, offset);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            throw ReadFileException("cannot read compressed file", strerror(errno));
+        }
+        if (n == 0) throw ReadFileException("unexpected end of compressed file");
+        p      += n;
+        offset += n;
+        length -= n;
+    }
+#else
+    ChunkSource::readAt(offset, data, length);
+#endif
+}
+
+
+MemoryChunkSource::MemoryChunkSource(const void* data, std::size_t length):
+    _data((const char*) data),
+    _length(length),
+    _position(0)
+{
+}
+
+
+std::size_t MemoryChunkSource::read(void* data, std::size_t length)
+{
+    std::size_t n = std::min(length, _length - _position);
+    memcpy(data, _data + _position, n);
+    _position += n;
+    return n;
+}
+
+
+bool MemoryChunkSource::seekable() const
+{
+    return true;
+}
+
+
+UInt64 MemoryChunkSource::size()
+{
+    return _length;
+}
+
+
+void MemoryChunkSource::readAt(UInt64 offset, void* data, std::size_t length)
+{
+    if (offset > _length || length > _length - offset)
+        throw ReadFileException("unexpected end of compressed data");
+    memcpy(data, _data + offset, length);
+}
+
+
+//
+// LZFSEChunkWriter
+//
+
+
+LZFSEChunkWriter::LZFSEChunkWriter(ChunkSink& sink, int blockSize, int threads):
+    _sink(sink),
+    _blockSize(blockSize),
+    _pPool(0),
+    _pScratch(0),
+    _pCurrent(0),
+    _bytesIn(0),
+    _bytesOut(0),
+    _closed(false)
+{
+    if (blockSize <= 0 || blockSize > MAX_BLOCK_SIZE)
+        throw InvalidArgumentException("LZFSE block size out of range");
+
+    threads = threadCount(threads);
+    if (threads > 0) _pPool = new LZFSEWorkerPool(threads);
+    else _pScratch = new LZFSEScratch;
+    _maxInFlight = 2*std::max(threads, 1);
+
+    UInt8 header[HEADER_SIZE];
+    memcpy(header, STREAM_MAGIC, 4);
+    put32(header + 4, blockSize);
+    output(header, HEADER_SIZE);
+}
+
+
+LZFSEChunkWriter::~LZFSEChunkWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+        ErrorHandler::handle();
+    }
+
+    // a failed close() may leave jobs with the workers
+    for (std::size_t i = 0; i < _inFlight.size(); i++)
+    {
+        if (_inFlight[i]->pending) _inFlight[i]->done.wait();
+        _free.push_back(_inFlight[i]);
+    }
+    delete _pPool;
+    delete _pScratch;
+    delete _pCurrent;
+    for (std::size_t i = 0; i < _free.size(); i++) delete _free[i];
+}
+
+
+void LZFSEChunkWriter::write(const void* data, std::size_t length)
+{
+    if (_closed) throw IllegalStateException("LZFSEChunkWriter is closed");
+
+    const UInt8* p = (const UInt8*) data;
+    while (length > 0)
+    {
+        if (!_pCurrent)
+        {
+            if (_free.empty())
+            {
+                _pCurrent = new LZFSEChunkJob;
+            }
+            else
+            {
+                _pCurrent = _free.back();
+                _free.pop_back();
+            }
+            _pCurrent->mode    = LZFSEChunkJob::COMPRESS;
+            _pCurrent->rawSize = 0;
+            if (_pCurrent->raw.size() < _blockSize) _pCurrent->raw.resize(_blockSize);
+        }
+
+        std::size_t n = std::min(length, _blockSize - _pCurrent->rawSize);
+        memcpy(&_pCurrent->raw[_pCurrent->rawSize], p, n);
+        _pCurrent->rawSize += n;
+        _bytesIn += n;
+        p        += n;
+        length   -= n;
+
+        if (_pCurrent->rawSize == _blockSize) submitBlock();
+    }
+}
+
+
+void LZFSEChunkWriter::close()
+{
+    if (_closed) return;
+
+    if (_pCurrent && _pCurrent->rawSize > 0) submitBlock();
+    while (!_inFlight.empty()) writeBlock();
+    _closed = true;
+
+    UInt8 end[BLOCK_HEADER_SIZE] = { 0 };
+    output(end, BLOCK_HEADER_SIZE);
+
+    std::vector<UInt8> index(_index.size()*8 + FOOTER_SIZE);
+    for (std::size_t i = 0; i < _index.size(); i++)
+        put64(&index[i*8], _index[i]);
+    UInt8* footer = &index[_index.size()*8];
+    put64(footer, _bytesIn);
+    put32(footer + 8, (UInt32) _index.size());
+    memcpy(footer + 12, INDEX_MAGIC, 4);
+    output(&index[0], index.size());
+}
+
+
+void LZFSEChunkWriter::submitBlock()
+{
+    LZFSEChunkJob* pJob = _pCurrent;
+    _pCurrent = 0;
+
+    if (_pPool)
+    {
+        while (_inFlight.size() >= _maxInFlight) writeBlock();
+        pJob->pending = true;
+        _inFlight.push_back(pJob);
+        _pPool->enqueue(pJob);
+    }
+    else
+    {
+        pJob->process(*_pScratch);
+        _inFlight.push_back(pJob);
+        writeBlock();
+    }
+}
+
+
+void LZFSEChunkWriter::writeBlock()
+{
+    LZFSEChunkJob* pJob = _inFlight.front();
+    if (pJob->pending)
+    {
+        pJob->done.wait();
+        pJob->pending = false;
+    }
+    _inFlight.pop_front();
+    _free.push_back(pJob);
+    if (!pJob->error.empty()) throw DataFormatException(pJob->error);
+
+    UInt8 header[BLOCK_HEADER_SIZE];
+    put32(header,     (UInt32) pJob->rawSize);
+    put32(header + 4, (UInt32) pJob->packedSize);
+    put32(header + 8, pJob->crc);
+
+    _index.push_back(_bytesOut);
+    output(header, BLOCK_HEADER_SIZE);
+    output(&pJob->packed[0], pJob->packedSize);
+}
+
+
+void LZFSEChunkWriter::output(const void* data, std::size_t length)
+{
+    _sink.write(data, length);
+    _bytesOut += length;
+}
+
+
+//
+// LZFSEChunkReader
+//
+
+
+LZFSEChunkReader::LZFSEChunkReader(ChunkSource& source, int threads):
+    _source(source),
+    _blockSize(0),
+    _pPool(0),
+    _pScratch(0),
+    _consumed(0),
+    _end(false),
+    _indexLoaded(false),
+    _size(0)
+{
+    UInt8 header[HEADER_SIZE];
+    if (readFully(_source, header, HEADER_SIZE) != HEADER_SIZE || memcmp(header, STREAM_MAGIC, 4) != 0)
+        throw DataFormatException("not a chunked LZFSE stream");
+    UInt32 blockSize = get32(header + 4);
+    if (blockSize == 0 || blockSize > (UInt32) MAX_BLOCK_SIZE)
+        throw DataFormatException("bad LZFSE block size");
+    _blockSize = blockSize;
+
+    threads = threadCount(threads);
+    if (threads > 0) _pPool = new LZFSEWorkerPool(threads);
+    else _pScratch = new LZFSEScratch;
+    _maxInFlight = 2*std::max(threads, 1);
+}
+
+
+LZFSEChunkReader::~LZFSEChunkReader()
+{
+    for (std::size_t i = 0; i < _inFlight.size(); i++)
+    {
+        if (_inFlight[i]->pending) _inFlight[i]->done.wait();
+        _free.push_back(_inFlight[i]);
+    }
+    delete _pPool;
+    delete _pScratch;
+    for (std::size_t i = 0; i < _free.size(); i++) delete _free[i];
+}
+
+
+std::size_t LZFSEChunkReader::read(void* data, std::size_t length)
+{
+    UInt8* p = (UInt8*) data;
+    std::size_t done = 0;
+    while (done < length)
+    {
+        while (!_end && _inFlight.size() < _maxInFlight)
+        {
+            if (!readAhead()) break;
+        }
+        if (_inFlight.empty()) break;
+
+        LZFSEChunkJob* pJob = _inFlight.front();
+        if (pJob->pending)
+        {
+            pJob->done.wait();
+            pJob->pending = false;
+        }
+        if (!pJob->error.empty())
+        {
+            _inFlight.pop_front();
+            _free.push_back(pJob);
+            throw DataFormatException(pJob->error);
+        }
+
+        std::size_t n = std::min(length - done, pJob->rawSize - _consumed);
+        memcpy(p + done, &pJob->raw[_consumed], n);
+        done      += n;
+        _consumed += n;
+        if (_consumed == pJob->rawSize)
+        {
+            _inFlight.pop_front();
+            _free.push_back(pJob);
+            _consumed = 0;
+        }
+    }
+    return done;
+}
+
+
+bool LZFSEChunkReader::readAhead()
+{
+    UInt8 header[BLOCK_HEADER_SIZE];
+    std::size_t n = readFully(_source, header, BLOCK_HEADER_SIZE);
+    if (n == 0)
+    {
+        // a stream without end marker, e.g. from a writer that crashed
+        _end = true;
+        return false;
+    }
+    if (n != BLOCK_HEADER_SIZE) throw DataFormatException("truncated LZFSE block header");
+
+    UInt32 rawSize    = get32(header);
+    UInt32 packedSize = get32(header + 4);
+    if (rawSize == 0)
+    {
+        _end = true;
+        return false;
+    }
+    if (rawSize > _blockSize || packedSize == 0 || packedSize > rawSize + ENCODE_OVERHEAD)
+        throw DataFormatException("bad LZFSE block header");
+
+    LZFSEChunkJob* pJob = newJob();
+    pJob->rawSize    = rawSize;
+    pJob->packedSize = packedSize;
+    pJob->crc        = get32(header + 8);
+    if (pJob->packed.size() < packedSize) pJob->packed.resize(packedSize);
+    if (readFully(_source, &pJob->packed[0], packedSize) != packedSize)
+    {
+        _free.push_back(pJob);
+        throw DataFormatException("truncated LZFSE block");
+    }
+
+    _inFlight.push_back(pJob);
+    if (_pPool)
+    {
+        pJob->pending = true;
+        _pPool->enqueue(pJob);
+    }
+    else
+    {
+        pJob->process(*_pScratch);
+    }
+    return true;
+}
+
+
+LZFSEChunkJob* LZFSEChunkReader::newJob()
+{
+    LZFSEChunkJob* pJob;
+    if (_free.empty())
+    {
+        pJob = new LZFSEChunkJob;
+    }
+    else
+    {
+        pJob = _free.back();
+        _free.pop_back();
+    }
+    pJob->mode = LZFSEChunkJob::DECOMPRESS;
+    return pJob;
+}
+
+
+void LZFSEChunkReader::loadIndex()
+{
+    if (_indexLoaded) return;
+    if (!_source.seekable()) throw IllegalStateException("random access needs a seekable source");
+
+    UInt64 sourceSize = _source.size();
+    std::vector<UInt64> index;
+    UInt64 total = 0;
+
+    UInt8 footer[FOOTER_SIZE];
+    bool hasIndex = false;
+    if (sourceSize >= HEADER_SIZE + BLOCK_HEADER_SIZE + FOOTER_SIZE)
+    {
+        _source.readAt(sourceSize - FOOTER_SIZE, footer, FOOTER_SIZE);
+        UInt64 count = get32(footer + 8);
+        hasIndex = memcmp(footer + 16, INDEX_MAGIC, 4) == 0
+                && count*8 <= sourceSize - HEADER_SIZE - BLOCK_HEADER_SIZE - FOOTER_SIZE;
+        if (hasIndex)
+        {
+            total = get64(footer);
+            index.resize(count);
+            if (count > 0)
+            {
+                std::vector<UInt8> raw(count*8);
+                _source.readAt(sourceSize - FOOTER_SIZE - count*8, &raw[0], raw.size());
+                for (std::size_t i = 0; i < count; i++) index[i] = get64(&raw[i*8]);
+            }
+            if (count > 0 ? total <= (count - 1)*_blockSize || total > count*_blockSize : total != 0)
+                throw DataFormatException("bad LZFSE block index");
+        }
+    }
+
+    if (!hasIndex)
+    {
+        // no index, walk the block headers
+        UInt64 offset = HEADER_SIZE;
+        while (offset + BLOCK_HEADER_SIZE <= sourceSize)
+        {
+            UInt8 header[BLOCK_HEADER_SIZE];
+            _source.readAt(offset, header, BLOCK_HEADER_SIZE);
+            UInt32 rawSize = get32(header);
+            if (rawSize == 0) break;
+            if (rawSize > _blockSize || total % _blockSize != 0)
+                throw DataFormatException("bad LZFSE block header");
+            index.push_back(offset);
+            total  += rawSize;
+            offset += BLOCK_HEADER_SIZE + get32(header + 4);
+        }
+    }
+
+    _index.swap(index);
+    _size = total;
+    _indexLoaded = true;
+}
+
+
+int LZFSEChunkReader::blockCount()
+{
+    loadIndex();
+    return (int) _index.size();
+}
+
+
+UInt64 LZFSEChunkReader::size()
+{
+    loadIndex();
+    return _size;
+}
+
+
+void LZFSEChunkReader::readAt(UInt64 offset, void* data, std::size_t length)
+{
+    loadIndex();
+    if (offset > _size || length > _size - offset)
+        throw RangeException("read beyond the end of the LZFSE data");
+    if (length == 0) return;
+
+    std::size_t first = offset / _blockSize;
+    std::size_t last  = (offset + length - 1) / _blockSize;
+    UInt8* p = (UInt8*) data;
+
+    std::deque<LZFSEChunkJob*> jobs;
+    std::size_t next = first;
+    try
+    {
+        for (std::size_t block = first; block <= last; block++)
+        {
+            // keep a window of blocks with the workers
+            while (next <= last && jobs.size() < _maxInFlight)
+            {
+                UInt8 header[BLOCK_HEADER_SIZE];
+                _source.readAt(_index[next], header, BLOCK_HEADER_SIZE);
+                UInt32 rawSize    = get32(header);
+                UInt32 packedSize = get32(header + 4);
+                UInt64 expected   = std::min<UInt64>(_blockSize, _size - (UInt64) next*_blockSize);
+                if (rawSize != expected || packedSize == 0 || packedSize > rawSize + ENCODE_OVERHEAD)
+                    throw DataFormatException("bad LZFSE block header");
+
+                LZFSEChunkJob* pJob = newJob();
+                jobs.push_back(pJob);
+                pJob->rawSize    = rawSize;
+                pJob->packedSize = packedSize;
+                pJob->crc        = get32(header + 8);
+                if (pJob->packed.size() < packedSize) pJob->packed.resize(packedSize);
+                _source.readAt(_index[next] + BLOCK_HEADER_SIZE, &pJob->packed[0], packedSize);
+
+                if (_pPool)
+                {
+                    pJob->pending = true;
+                    _pPool->enqueue(pJob);
+                }
+                else
+                {
+                    pJob->process(*_pScratch);
+                }
+                next++;
+            }
+
+            LZFSEChunkJob* pJob = jobs.front();
+            if (pJob->pending)
+            {
+                pJob->done.wait();
+                pJob->pending = false;
+            }
+            jobs.pop_front();
+            _free.push_back(pJob);
+            if (!pJob->error.empty()) throw DataFormatException(pJob->error);
+
+            UInt64 blockStart = (UInt64) block*_blockSize;
+            std::size_t from = offset > blockStart ? offset - blockStart : 0;
+            std::size_t n    = std::min<UInt64>(pJob->rawSize - from, offset + length - blockStart - from);
+            memcpy(p, &pJob->raw[from], n);
+            p += n;
+        }
+    }
+    catch (...)
+    {
+        for (std::size_t i = 0; i < jobs.size(); i++)
+        {
+            if (jobs[i]->pending)
+            {
+                jobs[i]->done.wait();
+                jobs[i]->pending = false;
+            }
+            _free.push_back(jobs[i]);
+        }
+        throw;
+    }
+}
+
+
+//
+// Buffer helpers
+//
+
+
+namespace
+{
+    class VectorChunkSink: public ChunkSink
+    {
+    public:
+        VectorChunkSink(std::vector<uint8_t>& out): _out(out)
+        {
+        }
+
+        void write(const void* data, std::size_t length)
+        {
+            const uint8_t* p = (const uint8_t*) data;
+            _out.insert(_out.end(), p, p + length);
+        }
+
+    private:
+        std::vector<uint8_t>& _out;
+    };
+}
+
+
+void lzfse_compress_chunked(const std::vector<uint8_t>& in, std::vector<uint8_t>& out, int blockSize, int threads)
+{
+    out.clear();
+    out.reserve(in.size() / 2 + 64);
+    VectorChunkSink sink(out);
+    LZFSEChunkWriter writer(sink, blockSize, threads);
+    if (!in.empty()) writer.write(&in[0], in.size());
+    writer.close();
+}
+
+
+void lzfse_decompress_chunked(const std::vector<uint8_t>& in, std::vector<uint8_t>& out, int threads)
+{
+    MemoryChunkSource source(in.empty() ? 0 : &in[0], in.size());
+    LZFSEChunkReader reader(source, threads);
+    out.resize(reader.size());
+    if (!out.empty()) reader.readAt(0, &out[0], out.size());
+}
+
+
+} } // namespace pi::compress
@@ -0,0 +1,316 @@
+#ifndef PIL_LZFSEStream_INCLUDED
+#define PIL_LZFSEStream_INCLUDED
+
+
+#include "base/Environment.h"
+#include "base/Types/Int.h"
+#include <deque>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+
+namespace pi {
+
+class FastMutex;
+
+namespace compress {
+
+
+class LZFSEWorkerPool;
+struct LZFSEChunkJob;
+struct LZFSEScratch;
+
+
+class PIL_API ChunkSink
+    /// Destination of the chunked LZFSE format.
+{
+public:
+    virtual ~ChunkSink();
+
+    virtual void write(const void* data, std::size_t length) = 0;
+        /// Writes all bytes or throws an IOException.
+};
+
+
+class PIL_API StreamChunkSink: public ChunkSink
+    /// Writes to a std::ostream.
+{
+public:
+    StreamChunkSink(std::ostream& stream);
+
+    void write(const void* data, std::size_t length);
+
+private:
+    std::ostream& _stream;
+};
+
+
+class PIL_API FileChunkSink: public ChunkSink
+    /// Writes to a file descriptor.
+{
+public:
+    FileChunkSink(int fd);
+        /// The descriptor is not closed by the sink.
+
+    void write(const void* data, std::size_t length);
+
+private:
+    int _fd;
+};
+
+
+class PIL_API ChunkSource
+    /// Origin of the chunked LZFSE format.
+    ///
+    /// Sources that know their size also support random access
+    /// through readAt(), which must be safe to call from several
+    /// threads.
+{
+public:
+    virtual ~ChunkSource();
+
+    virtual std::size_t read(void* data, std::size_t length) = 0;
+        /// Reads up to length bytes at the current position.
+        /// Returns 0 at the end of the source.
+
+    virtual bool seekable() const;
+        /// Returns true if size() and readAt() are supported.
+        /// The default implementation returns false.
+
+    virtual pi::UInt64 size();
+        /// Returns the total size of the source.
+        /// The default implementation throws a NotImplementedException.
+
+    virtual void readAt(pi::UInt64 offset, void* data, std::size_t length);
+        /// Reads exactly length bytes at the given offset, without
+        /// changing the position of read(). Throws a ReadFileException
+        /// if not all bytes are available.
+        /// The default implementation throws a NotImplementedException.
+};
+
+
+class PIL_API StreamChunkSource: public ChunkSource
+    /// Reads from a std::istream. Random access is supported if the
+    /// stream can seek; it is serialized by a mutex.
+{
+public:
+    StreamChunkSource(std::istream& stream);
+    ~StreamChunkSource();
+
+    std::size_t read(void* data, std::size_t length);
+    bool seekable() const;
+    pi::UInt64 size();
+    void readAt(pi::UInt64 offset, void* data, std::size_t length);
+
+private:
+    std::istream&   _stream;
+    pi::FastMutex*  _pMutex;
+    bool            _seekable;
+};
+
+
+class PIL_API FileChunkSource: public ChunkSource
+    /// Reads from a file descriptor, using pread() for random access.
+{
+public:
+    FileChunkSource(int fd);
+        /// The descriptor is not closed by the source.
+
+    std::size_t read(void* data, std::size_t length);
+    bool seekable() const;
+    pi::UInt64 size();
+    void readAt(pi::UInt64 offset, void* data, std::size_t length);
+
+private:
+    int _fd;
+};
+
+
+class PIL_API MemoryChunkSource: public ChunkSource
+    /// Reads from a memory buffer, which must outlive the source.
+{
+public:
+    MemoryChunkSource(const void* data, std::size_t length);
+
+    std::size_t read(void* data, std::size_t length);
+    bool seekable() const;
+    pi::UInt64 size();
+    void readAt(pi::UInt64 offset, void* data, std::size_t length);
+
+private:
+    const char* _data;
+    std::size_t _length;
+    std::size_t _position;
+};
+
+
+class PIL_API LZFSEChunkWriter
+    /// Compresses a byte stream of any length into the chunked LZFSE
+    /// format.
+    ///
+    /// The input is split into blocks of blockSize bytes, which are
+    /// compressed independently, in parallel on a pool of worker
+    /// threads. Each worker keeps its LZFSE scratch and output buffers
+    /// between blocks. At most two blocks per thread are in flight,
+    /// which bounds the memory used.
+    ///
+    /// Format, all integers little-endian:
+    ///     header      "PLZF", uint32 block size
+    ///     blocks      uint32 raw size, uint32 compressed size,
+    ///                 uint32 crc32 of the raw data, LZFSE data
+    ///     end         a block header of zeros
+    ///     index       uint64 offset of every block header,
+    ///                 uint64 total raw size, uint32 block count, "PLZX"
+    ///
+    /// All blocks except the last hold exactly block size raw bytes,
+    /// so an offset in the raw data maps directly to its block.
+{
+public:
+    enum
+    {
+        DEFAULT_BLOCK_SIZE = 1024*1024
+    };
+
+    LZFSEChunkWriter(ChunkSink& sink, int blockSize = DEFAULT_BLOCK_SIZE, int threads = -1);
+        /// Creates the writer and writes the header.
+        ///
+        /// threads is the number of worker threads; 0 compresses in
+        /// the calling thread, -1 uses one thread per processor.
+
+    ~LZFSEChunkWriter();
+        /// Calls close(), errors are reported to the ErrorHandler.
+
+    void write(const void* data, std::size_t length);
+        /// Compresses the given bytes. Complete blocks are handed to
+        /// the workers, compressed blocks are written in order.
+
+    void close();
+        /// Compresses the last partial block and writes the end
+        /// marker and the index. Further writes are not allowed.
+
+    pi::UInt64 bytesIn() const;
+        /// Returns the number of raw bytes written so far.
+
+    pi::UInt64 bytesOut() const;
+        /// Returns the number of bytes handed to the sink so far.
+
+private:
+    LZFSEChunkWriter(const LZFSEChunkWriter&);
+    LZFSEChunkWriter& operator = (const LZFSEChunkWriter&);
+
+    void submitBlock();
+    void writeBlock();
+    void output(const void* data, std::size_t length);
+
+    ChunkSink&                  _sink;
+    std::size_t                 _blockSize;
+    LZFSEWorkerPool*            _pPool;
+    LZFSEScratch*               _pScratch;
+    LZFSEChunkJob*              _pCurrent;
+    std::deque<LZFSEChunkJob*>  _inFlight;
+    std::vector<LZFSEChunkJob*> _free;
+    std::size_t                 _maxInFlight;
+    std::vector<pi::UInt64>     _index;
+    pi::UInt64                  _bytesIn;
+    pi::UInt64                  _bytesOut;
+    bool                        _closed;
+};
+
+
+class PIL_API LZFSEChunkReader
+    /// Decompresses the chunked LZFSE format written by LZFSEChunkWriter.
+    ///
+    /// read() decompresses sequentially, with the workers decoding
+    /// the blocks ahead. readAt() decompresses the blocks covering a
+    /// range of the raw data in parallel; it requires a seekable
+    /// source and uses the index, or scans the block headers if the
+    /// index is missing, e.g. for a file whose writer crashed.
+    ///
+    /// The crc32 of every block is verified. Corrupt data causes a
+    /// DataFormatException.
+{
+public:
+    LZFSEChunkReader(ChunkSource& source, int threads = -1);
+        /// Creates the reader and reads the header.
+        /// threads has the same meaning as for LZFSEChunkWriter.
+
+    ~LZFSEChunkReader();
+
+    std::size_t read(void* data, std::size_t length);
+        /// Reads up to length decompressed bytes. Returns 0 at the end
+        /// of the data.
+
+    int blockSize() const;
+        /// Returns the block size of the data.
+
+    int blockCount();
+        /// Returns the number of blocks. Requires a seekable source.
+
+    pi::UInt64 size();
+        /// Returns the decompressed size. Requires a seekable source.
+
+    void readAt(pi::UInt64 offset, void* data, std::size_t length);
+        /// Decompresses length bytes starting at the given offset in
+        /// the raw data. Throws a RangeException if the range exceeds
+        /// the data. Requires a seekable source. Independent of, and
+        /// not to be called concurrently with, read().
+
+private:
+    LZFSEChunkReader(const LZFSEChunkReader&);
+    LZFSEChunkReader& operator = (const LZFSEChunkReader&);
+
+    bool readAhead();
+    void loadIndex();
+    LZFSEChunkJob* newJob();
+
+    ChunkSource&                _source;
+    std::size_t                 _blockSize;
+    LZFSEWorkerPool*            _pPool;
+    LZFSEScratch*               _pScratch;
+    std::deque<LZFSEChunkJob*>  _inFlight;
+    std::vector<LZFSEChunkJob*> _free;
+    std::size_t                 _maxInFlight;
+    std::size_t                 _consumed;
+    bool                        _end;
+    bool                        _indexLoaded;
+    std::vector<pi::UInt64>     _index;
+    pi::UInt64                  _size;
+};
+
+
+void PIL_API lzfse_compress_chunked(const std::vector<uint8_t>& in, std::vector<uint8_t>& out,
+                                    int blockSize = LZFSEChunkWriter::DEFAULT_BLOCK_SIZE, int threads = -1);
+    /// Compresses in into the chunked format.
+
+
+void PIL_API lzfse_decompress_chunked(const std::vector<uint8_t>& in, std::vector<uint8_t>& out, int threads = -1);
+    /// Decompresses data in the chunked format, using all blocks in
+    /// parallel.
+
+
+//
+// inlines
+//
+inline pi::UInt64 LZFSEChunkWriter::bytesIn() const
+{
+    return _bytesIn;
+}
+
+
+inline pi::UInt64 LZFSEChunkWriter::bytesOut() const
+{
+    return _bytesOut;
+}
+
+
+inline int LZFSEChunkReader::blockSize() const
+{
+    return (int) _blockSize;
+}
+
+
+} } // namespace pi::compress
+
+
+#endif // PIL_LZFSEStream_INCLUDED
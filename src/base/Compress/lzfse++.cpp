@@ -39,34 +39,21 @@ int lzfse_encode(const std::vector<uint8_t>& inBuf, std::vector<uint8_t>& outBuf
 {
     size_t aux_allocated = lzfse_encode_scratch_size();
     size_t in_size = inBuf.size();
-    size_t out_allocated = in_size;
+    // lzfse stores incompressible input as an uncompressed block, which
+    // always fits into in_size + 12 bytes, so no retry is needed
+    size_t out_allocated = in_size + 12;
     size_t out_size = 0;
 
     void *aux = aux_allocated ? malloc(aux_allocated) : 0;
     if( outBuf.size() < out_allocated ) outBuf.resize(out_allocated);
 
-    const uint8_t *in = inBuf.data();
-    uint8_t *out = outBuf.data();
-
-    while(1) {
-        out_size = lzfse_encode_buffer(out, out_allocated, in, in_size, aux);
-
-        if( out_size == 0 ) {
-            out_allocated <<= 1;
-            outBuf.resize(out_allocated);
-            out = outBuf.data();
-
-            continue;
-        }
-
-        break;
-    }
+    out_size = lzfse_encode_buffer(outBuf.data(), out_allocated, inBuf.data(), in_size, aux);
 
     outBuf.resize(out_size);
 
     if( aux ) free(aux);
 
-    return 0;
+    return out_size ? 0 : -1;
 }
 
 int lzfse_decode(const std::vector<uint8_t>& inBuf, std::vector<uint8_t>& outBuf)
@@ -108,38 +95,26 @@ int lzfse_encode(const uint8_t* inBuf, const size_t inSize, uint8_t** outBuf, si
 {
     size_t aux_allocated = lzfse_encode_scratch_size();
     size_t in_size = inSize;
-    size_t out_allocated = in_size;
+    size_t out_allocated = in_size + 12;
     size_t out_size = 0;
 
     const uint8_t *in = inBuf;
     uint8_t *out = *outBuf;
 
-    void *aux = aux_allocated ? malloc(aux_allocated) : 0;
     if( outSize < out_allocated ) {
         out = (uint8_t*) realloc(out, out_allocated);
         if( out == NULL ) return -1;
     }
 
-    while(1) {
-        out_size = lzfse_encode_buffer(out, out_allocated, in, in_size, aux);
-
-        if( out_size == 0 ) {
-            out_allocated <<= 1;
-            out = (uint8_t*) realloc(out, out_allocated);
-            if( out == NULL ) return -1;
-
-            continue;
-        }
-
-        break;
-    }
+    void *aux = aux_allocated ? malloc(aux_allocated) : 0;
+    out_size = lzfse_encode_buffer(out, out_allocated, in, in_size, aux);
 
     *outBuf = out;
     outSize =  out_size;
 
     if( aux ) free(aux);
 
-    return 0;
+    return out_size ? 0 : -1;
 }
 
 int lzfse_decode(const uint8_t* inBuf, const size_t inSize, uint8_t** outBuf, size_t& outSize)
@@ -36,6 +36,10 @@ namespace crypto {
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
+// The functions below encrypt every 16 byte block on its own (ECB) and pad
+// with zeros, which leaks patterns of the plain text. New code should use
+// the stream modes of AESCipher.h.
+
 typedef size_t                  AES_CONTEX;
 typedef std::vector<uint8_t>    AES_KEY;
 
@@ -69,6 +73,8 @@ public:
         if( m_key ) AES_freeKey(m_key);
 
         m_key = AES_setKey(key);
+
+        return 0;
     }
 
     int isKeySet(void) {
@@ -0,0 +1,940 @@
+/*******************************************************************************
+
+  Pilot Intelligence Library
+    http://www.pilotintelligence.com/
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include <string.h>
+
+#include "AESCipher.h"
+#include "base/Debug/Exception.h"
+#include "base/Platform/CPU.h"
+
+#if defined(PIL_CPU_HAS_X86_VARIANTS)
+#define PIL_AES_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRYPTO) && defined(PIL_CPU_HAS_NEON_VARIANTS)
+#define PIL_AES_ARM 1
+#include <arm_neon.h>
+#endif
+
+
+namespace pi {
+namespace crypto {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Tables and CPU features, built once
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct AESTables
+{
+    AESTables();
+
+    uint8_t     sbox[256];
+    uint32_t    te[4][256];     ///< S-box and MixColumns, one per byte position
+    bool        aesni;          ///< AES instructions
+    bool        clmul;          ///< carry-less multiplication for GHASH
+};
+
+
+inline uint8_t xtime(uint8_t x)
+{
+    return (uint8_t) ((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+}
+
+
+AESTables::AESTables()
+{
+    // the S-box is the multiplicative inverse in GF(2^8) followed by an
+    // affine map; walk the field with the generator 3 to find inverses
+    uint8_t exp[256], log[256];
+    uint8_t x = 1;
+    for (int i = 0; i < 255; i++)
+    {
+        exp[i] = x;
+        log[x] = (uint8_t) i;
+        x ^= xtime(x);
+    }
+    for (int i = 0; i < 256; i++)
+    {
+        uint8_t inv = i ? exp[(255 - log[i]) % 255] : 0;
+        uint8_t s = inv;
+        for (int k = 1; k < 5; k++)
+            s ^= (uint8_t) ((inv << k) | (inv >> (8 - k)));
+        sbox[i] = s ^ 0x63;
+    }
+
+    for (int i = 0; i < 256; i++)
+    {
+        uint8_t  s = sbox[i];
+        uint32_t t = ((uint32_t) xtime(s) << 24) | ((uint32_t) s << 16) |
+                     ((uint32_t) s << 8) | (uint32_t) (xtime(s) ^ s);
+        for (int k = 0; k < 4; k++)
+        {
+            te[k][i] = t;
+            t = (t >> 8) | (t << 24);
+        }
+    }
+
+    aesni = false;
+    clmul = false;
+#if defined(PIL_AES_X86)
+    aesni = cpu::has(cpu::AESNI | cpu::SSE41);
+    clmul = cpu::has(cpu::PCLMUL | cpu::SSE41);
+#elif defined(PIL_AES_ARM)
+    aesni = cpu::has(cpu::ARM_AES);
+#endif
+}
+
+
+const AESTables& aesTables()
+{
+    // C++11 guarantees thread safe initialisation
+    static const AESTables tables;
+    return tables;
+}
+
+
+inline uint32_t load32be(const uint8_t* p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+
+inline void store32be(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+}
+
+
+inline void increment(uint8_t counter[16], bool increment32)
+{
+    int end = increment32 ? 12 : 0;
+    for (int i = 15; i >= end; i--)
+        if (++counter[i]) break;
+}
+
+
+inline void xorBlock(uint8_t* out, const uint8_t* in, const uint8_t* stream, size_t n)
+{
+    for (size_t i = 0; i < n; i++) out[i] = in[i] ^ stream[i];
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// T-table kernel
+////////////////////////////////////////////////////////////////////////////////
+
+void encryptTable(const AESTables& t, const uint32_t* rk, int rounds, const uint8_t* in, uint8_t* out)
+{
+    uint32_t s0 = load32be(in)      ^ rk[0];
+    uint32_t s1 = load32be(in + 4)  ^ rk[1];
+    uint32_t s2 = load32be(in + 8)  ^ rk[2];
+    uint32_t s3 = load32be(in + 12) ^ rk[3];
+    uint32_t t0, t1, t2, t3;
+
+    const uint32_t* te0 = t.te[0];
+    const uint32_t* te1 = t.te[1];
+    const uint32_t* te2 = t.te[2];
+    const uint32_t* te3 = t.te[3];
+
+    for (int r = 1; r < rounds; r++)
+    {
+        rk += 4;
+        t0 = te0[s0 >> 24] ^ te1[(s1 >> 16) & 0xff] ^ te2[(s2 >> 8) & 0xff] ^ te3[s3 & 0xff] ^ rk[0];
+        t1 = te0[s1 >> 24] ^ te1[(s2 >> 16) & 0xff] ^ te2[(s3 >> 8) & 0xff] ^ te3[s0 & 0xff] ^ rk[1];
+        t2 = te0[s2 >> 24] ^ te1[(s3 >> 16) & 0xff] ^ te2[(s0 >> 8) & 0xff] ^ te3[s1 & 0xff] ^ rk[2];
+        t3 = te0[s3 >> 24] ^ te1[(s0 >> 16) & 0xff] ^ te2[(s1 >> 8) & 0xff] ^ te3[s2 & 0xff] ^ rk[3];
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+
+    // the last round has no MixColumns
+    const uint8_t* sb = t.sbox;
+    rk += 4;
+    t0 = ((uint32_t) sb[s0 >> 24] << 24) ^ ((uint32_t) sb[(s1 >> 16) & 0xff] << 16) ^
+         ((uint32_t) sb[(s2 >> 8) & 0xff] << 8) ^ sb[s3 & 0xff] ^ rk[0];
+    t1 = ((uint32_t) sb[s1 >> 24] << 24) ^ ((uint32_t) sb[(s2 >> 16) & 0xff] << 16) ^
+         ((uint32_t) sb[(s3 >> 8) & 0xff] << 8) ^ sb[s0 & 0xff] ^ rk[1];
+    t2 = ((uint32_t) sb[s2 >> 24] << 24) ^ ((uint32_t) sb[(s3 >> 16) & 0xff] << 16) ^
+         ((uint32_t) sb[(s0 >> 8) & 0xff] << 8) ^ sb[s1 & 0xff] ^ rk[2];
+    t3 = ((uint32_t) sb[s3 >> 24] << 24) ^ ((uint32_t) sb[(s0 >> 16) & 0xff] << 16) ^
+         ((uint32_t) sb[(s1 >> 8) & 0xff] << 8) ^ sb[s2 & 0xff] ^ rk[3];
+
+    store32be(out,      t0);
+    store32be(out + 4,  t1);
+    store32be(out + 8,  t2);
+    store32be(out + 12, t3);
+}
+
+
+void ctrTable(const AESTables& t, const uint32_t* rk, int rounds, uint8_t counter[16],
+              const uint8_t* in, uint8_t* out, size_t nBlocks, bool increment32)
+{
+    uint8_t stream[16];
+    for (size_t i = 0; i < nBlocks; i++)
+    {
+        encryptTable(t, rk, rounds, counter, stream);
+        increment(counter, increment32);
+        xorBlock(out, in, stream, 16);
+        in  += 16;
+        out += 16;
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// AES-NI kernel
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(PIL_AES_X86)
+
+PIL_TARGET_AESNI
+void encryptAesni(const uint8_t* rkBytes, int rounds, const uint8_t* in, uint8_t* out, size_t nBlocks)
+{
+    __m128i rk[15];
+    for (int r = 0; r <= rounds; r++)
+        rk[r] = _mm_loadu_si128((const __m128i*) (rkBytes + 16*r));
+
+    for (size_t i = 0; i < nBlocks; i++)
+    {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (in + 16*i)), rk[0]);
+        for (int r = 1; r < rounds; r++)
+            b = _mm_aesenc_si128(b, rk[r]);
+        _mm_storeu_si128((__m128i*) (out + 16*i), _mm_aesenclast_si128(b, rk[rounds]));
+    }
+}
+
+
+PIL_TARGET_AESNI
+void ctrAesni(const uint8_t* rkBytes, int rounds, uint8_t counter[16],
+              const uint8_t* in, uint8_t* out, size_t nBlocks, bool increment32)
+{
+    __m128i rk[15];
+    for (int r = 0; r <= rounds; r++)
+        rk[r] = _mm_loadu_si128((const __m128i*) (rkBytes + 16*r));
+
+    // eight independent blocks hide the latency of aesenc
+    while (nBlocks >= 8)
+    {
+        __m128i b[8];
+#if defined(__x86_64__)
+        uint64_t low;
+        memcpy(&low, counter + 8, 8);
+        low = __builtin_bswap64(low);
+        bool carry = increment32 ? (uint32_t) low > 0xFFFFFFFFU - 8 : low > ~(uint64_t) 0 - 8;
+        if (!carry)
+        {
+            // no carry out of the low word within this batch
+            __m128i c = _mm_loadu_si128((const __m128i*) counter);
+            for (int j = 0; j < 8; j++)
+                b[j] = _mm_xor_si128(_mm_insert_epi64(c, (long long) __builtin_bswap64(low + j), 1), rk[0]);
+            low = __builtin_bswap64(low + 8);
+            memcpy(counter + 8, &low, 8);
+        }
+        else
+#endif
+        {
+            for (int j = 0; j < 8; j++)
+            {
+                b[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i*) counter), rk[0]);
+                increment(counter, increment32);
+            }
+        }
+        for (int r = 1; r < rounds; r++)
+        {
+            for (int j = 0; j < 8; j++)
+                b[j] = _mm_aesenc_si128(b[j], rk[r]);
+        }
+        for (int j = 0; j < 8; j++)
+        {
+            b[j] = _mm_aesenclast_si128(b[j], rk[rounds]);
+            __m128i d = _mm_loadu_si128((const __m128i*) (in + 16*j));
+            _mm_storeu_si128((__m128i*) (out + 16*j), _mm_xor_si128(d, b[j]));
+        }
+        in      += 128;
+        out     += 128;
+        nBlocks -= 8;
+    }
+
+    for (; nBlocks > 0; nBlocks--)
+    {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*) counter), rk[0]);
+        increment(counter, increment32);
+        for (int r = 1; r < rounds; r++)
+            b = _mm_aesenc_si128(b, rk[r]);
+        b = _mm_aesenclast_si128(b, rk[rounds]);
+        __m128i d = _mm_loadu_si128((const __m128i*) in);
+        _mm_storeu_si128((__m128i*) out, _mm_xor_si128(d, b));
+        in  += 16;
+        out += 16;
+    }
+}
+
+
+PIL_TARGET_PCLMUL
+__m128i gfmul(__m128i a, __m128i b)
+    /// Multiplication in GF(2^128) of byte reversed operands, see
+    /// "Intel Carry-Less Multiplication Instruction and its Usage for
+    /// Computing the GCM Mode", Intel 2010.
+{
+    __m128i t2, t3, t4, t5, t6, t7, t8, t9;
+
+    t3 = _mm_clmulepi64_si128(a, b, 0x00);
+    t4 = _mm_clmulepi64_si128(a, b, 0x10);
+    t5 = _mm_clmulepi64_si128(a, b, 0x01);
+    t6 = _mm_clmulepi64_si128(a, b, 0x11);
+    t4 = _mm_xor_si128(t4, t5);
+    t5 = _mm_slli_si128(t4, 8);
+    t4 = _mm_srli_si128(t4, 8);
+    t3 = _mm_xor_si128(t3, t5);
+    t6 = _mm_xor_si128(t6, t4);
+
+    // shift the 256 bit product left by one bit
+    t7 = _mm_srli_epi32(t3, 31);
+    t8 = _mm_srli_epi32(t6, 31);
+    t3 = _mm_slli_epi32(t3, 1);
+    t6 = _mm_slli_epi32(t6, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    t3 = _mm_or_si128(t3, t7);
+    t6 = _mm_or_si128(t6, t8);
+    t6 = _mm_or_si128(t6, t9);
+
+    // reduce modulo x^128 + x^7 + x^2 + x + 1
+    t7 = _mm_slli_epi32(t3, 31);
+    t8 = _mm_slli_epi32(t3, 30);
+    t9 = _mm_slli_epi32(t3, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    t3 = _mm_xor_si128(t3, t7);
+    t2 = _mm_srli_epi32(t3, 1);
+    t4 = _mm_srli_epi32(t3, 2);
+    t5 = _mm_srli_epi32(t3, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    t3 = _mm_xor_si128(t3, t2);
+    return _mm_xor_si128(t6, t3);
+}
+
+
+PIL_TARGET_PCLMUL
+void ghashClmul(const uint8_t h[16], uint8_t x[16], const uint8_t* data, size_t nBlocks)
+{
+    const __m128i swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i h1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) h), swap);
+    __m128i xv = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) x), swap);
+
+    if (nBlocks >= 4)
+    {
+        // X = (X + D0) H^4 + D1 H^3 + D2 H^2 + D3 H, four independent products
+        __m128i h2 = gfmul(h1, h1);
+        __m128i h3 = gfmul(h2, h1);
+        __m128i h4 = gfmul(h3, h1);
+        while (nBlocks >= 4)
+        {
+            __m128i d0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data +  0)), swap);
+            __m128i d1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 16)), swap);
+            __m128i d2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 32)), swap);
+            __m128i d3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 48)), swap);
+            xv = _mm_xor_si128(_mm_xor_si128(gfmul(_mm_xor_si128(xv, d0), h4), gfmul(d1, h3)),
+                               _mm_xor_si128(gfmul(d2, h2), gfmul(d3, h1)));
+            data    += 64;
+            nBlocks -= 4;
+        }
+    }
+
+    for (size_t i = 0; i < nBlocks; i++)
+    {
+        __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 16*i)), swap);
+        xv = gfmul(_mm_xor_si128(xv, d), h1);
+    }
+    _mm_storeu_si128((__m128i*) x, _mm_shuffle_epi8(xv, swap));
+}
+
+#endif // PIL_AES_X86
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// ARMv8 crypto extension kernel
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(PIL_AES_ARM)
+
+inline uint8x16_t encryptArmBlock(const uint8x16_t* rk, int rounds, uint8x16_t b)
+{
+    // aese combines AddRoundKey, SubBytes and ShiftRows
+    for (int r = 0; r < rounds - 1; r++)
+        b = vaesmcq_u8(vaeseq_u8(b, rk[r]));
+    b = vaeseq_u8(b, rk[rounds - 1]);
+    return veorq_u8(b, rk[rounds]);
+}
+
+
+void encryptArm(const uint8_t* rkBytes, int rounds, const uint8_t* in, uint8_t* out, size_t nBlocks)
+{
+    uint8x16_t rk[15];
+    for (int r = 0; r <= rounds; r++)
+        rk[r] = vld1q_u8(rkBytes + 16*r);
+
+    for (size_t i = 0; i < nBlocks; i++)
+        vst1q_u8(out + 16*i, encryptArmBlock(rk, rounds, vld1q_u8(in + 16*i)));
+}
+
+
+void ctrArm(const uint8_t* rkBytes, int rounds, uint8_t counter[16],
+            const uint8_t* in, uint8_t* out, size_t nBlocks, bool increment32)
+{
+    uint8x16_t rk[15];
+    for (int r = 0; r <= rounds; r++)
+        rk[r] = vld1q_u8(rkBytes + 16*r);
+
+    while (nBlocks >= 4)
+    {
+        uint8x16_t b[4];
+        for (int j = 0; j < 4; j++)
+        {
+            b[j] = vld1q_u8(counter);
+            increment(counter, increment32);
+        }
+        for (int r = 0; r < rounds - 1; r++)
+        {
+            for (int j = 0; j < 4; j++)
+                b[j] = vaesmcq_u8(vaeseq_u8(b[j], rk[r]));
+        }
+        for (int j = 0; j < 4; j++)
+        {
+            b[j] = veorq_u8(vaeseq_u8(b[j], rk[rounds - 1]), rk[rounds]);
+            vst1q_u8(out + 16*j, veorq_u8(vld1q_u8(in + 16*j), b[j]));
+        }
+        in      += 64;
+        out     += 64;
+        nBlocks -= 4;
+    }
+
+    for (; nBlocks > 0; nBlocks--)
+    {
+        uint8x16_t b = encryptArmBlock(rk, rounds, vld1q_u8(counter));
+        increment(counter, increment32);
+        vst1q_u8(out, veorq_u8(vld1q_u8(in), b));
+        in  += 16;
+        out += 16;
+    }
+}
+
+#endif // PIL_AES_ARM
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// GHASH with 4 bit tables
+////////////////////////////////////////////////////////////////////////////////
+
+const uint64_t g_last4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+
+void ghashTables(const uint8_t h[16], uint64_t hl[16], uint64_t hh[16])
+{
+    uint64_t vh = ((uint64_t) load32be(h) << 32) | load32be(h + 4);
+    uint64_t vl = ((uint64_t) load32be(h + 8) << 32) | load32be(h + 12);
+
+    hl[8] = vl;
+    hh[8] = vh;
+    hl[0] = 0;
+    hh[0] = 0;
+
+    for (int i = 4; i > 0; i >>= 1)
+    {
+        uint32_t t = (vl & 1) * 0xe1000000U;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ ((uint64_t) t << 32);
+        hl[i] = vl;
+        hh[i] = vh;
+    }
+    for (int i = 2; i <= 8; i *= 2)
+    {
+        for (int j = 1; j < i; j++)
+        {
+            hh[i + j] = hh[i] ^ hh[j];
+            hl[i + j] = hl[i] ^ hl[j];
+        }
+    }
+}
+
+
+void ghashMult(const uint64_t hl[16], const uint64_t hh[16], uint8_t x[16])
+    /// x = x * H
+{
+    uint8_t  lo = x[15] & 0xf;
+    uint64_t zh = hh[lo];
+    uint64_t zl = hl[lo];
+
+    for (int i = 15; i >= 0; i--)
+    {
+        lo = x[i] & 0xf;
+        uint8_t hi = (x[i] >> 4) & 0xf;
+
+        if (i != 15)
+        {
+            uint8_t rem = (uint8_t) (zl & 0xf);
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (g_last4[rem] << 48) ^ hh[lo];
+            zl ^= hl[lo];
+        }
+
+        uint8_t rem = (uint8_t) (zl & 0xf);
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ (g_last4[rem] << 48) ^ hh[hi];
+        zl ^= hl[hi];
+    }
+
+    store32be(x,      (uint32_t) (zh >> 32));
+    store32be(x + 4,  (uint32_t) zh);
+    store32be(x + 8,  (uint32_t) (zl >> 32));
+    store32be(x + 12, (uint32_t) zl);
+}
+
+} // end of anonymous namespace
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// AESKey
+////////////////////////////////////////////////////////////////////////////////
+
+AESKey::AESKey(const void* key, size_t length, AESKernel kernel)
+{
+    int nk;
+    switch (length)
+    {
+    case 16: nk = 4; _rounds = 10; break;
+    case 24: nk = 6; _rounds = 12; break;
+    case 32: nk = 8; _rounds = 14; break;
+    default:
+        throw InvalidArgumentException("AES key must have 16, 24 or 32 bytes");
+    }
+
+    const AESTables& t = aesTables();
+    _hardware = kernel != AES_KERNEL_TABLE && t.aesni;
+
+    const uint8_t* k = (const uint8_t*) key;
+    int words = 4*(_rounds + 1);
+    uint32_t rcon = 0x01;
+    for (int i = 0; i < nk; i++)
+        _rk[i] = load32be(k + 4*i);
+    for (int i = nk; i < words; i++)
+    {
+        uint32_t temp = _rk[i - 1];
+        if (i % nk == 0)
+        {
+            // RotWord, SubWord and the round constant
+            temp = ((uint32_t) t.sbox[(temp >> 16) & 0xff] << 24) |
+                   ((uint32_t) t.sbox[(temp >> 8) & 0xff] << 16) |
+                   ((uint32_t) t.sbox[temp & 0xff] << 8) |
+                   t.sbox[temp >> 24];
+            temp ^= rcon << 24;
+            rcon = xtime((uint8_t) rcon);
+        }
+        else if (nk > 6 && i % nk == 4)
+        {
+            temp = ((uint32_t) t.sbox[temp >> 24] << 24) |
+                   ((uint32_t) t.sbox[(temp >> 16) & 0xff] << 16) |
+                   ((uint32_t) t.sbox[(temp >> 8) & 0xff] << 8) |
+                   t.sbox[temp & 0xff];
+        }
+        _rk[i] = _rk[i - nk] ^ temp;
+    }
+    for (int i = words; i < 60; i++) _rk[i] = 0;
+    for (int i = 0; i < 60; i++) store32be(_rkBytes + 4*i, _rk[i]);
+}
+
+
+AESKey::~AESKey()
+{
+    volatile uint8_t* p = (volatile uint8_t*) _rk;
+    for (size_t i = 0; i < sizeof(_rk); i++) p[i] = 0;
+    p = (volatile uint8_t*) _rkBytes;
+    for (size_t i = 0; i < sizeof(_rkBytes); i++) p[i] = 0;
+}
+
+
+bool AESKey::hasHardware()
+{
+    return aesTables().aesni;
+}
+
+
+const char* AESKey::kernelName() const
+{
+    if (!_hardware) return "table";
+#if defined(PIL_AES_ARM)
+    return "armv8-aes";
+#else
+    return "aes-ni";
+#endif
+}
+
+
+void AESKey::encryptBlocks(const uint8_t* in, uint8_t* out, size_t nBlocks) const
+{
+#if defined(PIL_AES_X86)
+    if (_hardware) return encryptAesni(_rkBytes, _rounds, in, out, nBlocks);
+#elif defined(PIL_AES_ARM)
+    if (_hardware) return encryptArm(_rkBytes, _rounds, in, out, nBlocks);
+#endif
+    const AESTables& t = aesTables();
+    for (size_t i = 0; i < nBlocks; i++)
+        encryptTable(t, _rk, _rounds, in + 16*i, out + 16*i);
+}
+
+
+void AESKey::ctr(uint8_t counter[16], const uint8_t* in, uint8_t* out, size_t nBlocks,
+                 bool increment32) const
+{
+#if defined(PIL_AES_X86)
+    if (_hardware) return ctrAesni(_rkBytes, _rounds, counter, in, out, nBlocks, increment32);
+#elif defined(PIL_AES_ARM)
+    if (_hardware) return ctrArm(_rkBytes, _rounds, counter, in, out, nBlocks, increment32);
+#endif
+    ctrTable(aesTables(), _rk, _rounds, counter, in, out, nBlocks, increment32);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// AESCTR
+////////////////////////////////////////////////////////////////////////////////
+
+AESCTR::AESCTR(const AESKey& key, const uint8_t iv[16]):
+    _key(key),
+    _used(16)
+{
+    memcpy(_iv, iv, 16);
+    memcpy(_counter, iv, 16);
+}
+
+
+void AESCTR::process(const void* in_, void* out_, size_t length)
+{
+    const uint8_t* in  = (const uint8_t*) in_;
+    uint8_t*       out = (uint8_t*) out_;
+
+    // rest of the last key stream block
+    if (_used < 16)
+    {
+        size_t n = length < 16 - _used ? length : 16 - _used;
+        xorBlock(out, in, _stream + _used, n);
+        _used  += n;
+        in     += n;
+        out    += n;
+        length -= n;
+    }
+
+    size_t blocks = length / 16;
+    if (blocks)
+    {
+        _key.ctr(_counter, in, out, blocks);
+        in     += 16*blocks;
+        out    += 16*blocks;
+        length -= 16*blocks;
+    }
+
+    if (length)
+    {
+        memset(_stream, 0, 16);
+        _key.ctr(_counter, _stream, _stream, 1);
+        xorBlock(out, in, _stream, length);
+        _used = length;
+    }
+}
+
+
+void AESCTR::seek(uint64_t offset)
+{
+    // counter = iv + offset/16, as a 128 bit big-endian number
+    memcpy(_counter, _iv, 16);
+    uint64_t add = offset / 16;
+    for (int i = 15; i >= 0 && add; i--)
+    {
+        uint64_t sum = (uint64_t) _counter[i] + (add & 0xff);
+        _counter[i] = (uint8_t) sum;
+        add = (add >> 8) + (sum >> 8);
+    }
+
+    _used = 16;
+    size_t skip = (size_t) (offset % 16);
+    if (skip)
+    {
+        memset(_stream, 0, 16);
+        _key.ctr(_counter, _stream, _stream, 1);
+        _used = skip;
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// AESGCM
+////////////////////////////////////////////////////////////////////////////////
+
+AESGCM::AESGCM(const AESKey& key):
+    _key(key),
+    _used(16),
+    _pendingLength(0),
+    _aadLength(0),
+    _dataLength(0),
+    _state(IDLE)
+{
+    memset(_h, 0, 16);
+    _key.encryptBlocks(_h, _h, 1);
+    ghashTables(_h, _hl, _hh);
+    _clmul = aesTables().clmul && _key.hardware();
+}
+
+
+AESGCM::~AESGCM()
+{
+    volatile uint8_t* p = (volatile uint8_t*) _h;
+    for (size_t i = 0; i < sizeof(_h); i++) p[i] = 0;
+    p = (volatile uint8_t*) _hl;
+    for (size_t i = 0; i < sizeof(_hl); i++) p[i] = 0;
+    p = (volatile uint8_t*) _hh;
+    for (size_t i = 0; i < sizeof(_hh); i++) p[i] = 0;
+}
+
+
+void AESGCM::start(const void* iv, size_t ivLength)
+{
+    if (ivLength == 0) throw InvalidArgumentException("GCM needs an IV");
+
+    memset(_x, 0, 16);
+    _pendingLength = 0;
+    _aadLength     = 0;
+    _dataLength    = 0;
+
+    if (ivLength == 12)
+    {
+        memcpy(_j0, iv, 12);
+        _j0[12] = 0;
+        _j0[13] = 0;
+        _j0[14] = 0;
+        _j0[15] = 1;
+    }
+    else
+    {
+        // J0 = GHASH(IV || padding || bit length of IV)
+        ghash((const uint8_t*) iv, ivLength);
+        ghashFlush();
+        uint8_t lengths[16] = { 0 };
+        uint64_t bits = (uint64_t) ivLength * 8;
+        store32be(lengths + 8,  (uint32_t) (bits >> 32));
+        store32be(lengths + 12, (uint32_t) bits);
+        ghashBlocks(lengths, 1);
+        memcpy(_j0, _x, 16);
+        memset(_x, 0, 16);
+    }
+
+    memcpy(_counter, _j0, 16);
+    increment(_counter, true);
+    _used  = 16;
+    _state = AAD;
+}
+
+
+void AESGCM::addAAD(const void* data, size_t length)
+{
+    if (_state != AAD) throw IllegalStateException("GCM additional data must come before the message");
+    ghash((const uint8_t*) data, length);
+    _aadLength += length;
+}
+
+
+void AESGCM::encrypt(const void* in, void* out, size_t length)
+{
+    crypt((const uint8_t*) in, (uint8_t*) out, length, true);
+}
+
+
+void AESGCM::decrypt(const void* in, void* out, size_t length)
+{
+    crypt((const uint8_t*) in, (uint8_t*) out, length, false);
+}
+
+
+void AESGCM::crypt(const uint8_t* in, uint8_t* out, size_t length, bool encrypting)
+{
+    if (_state == IDLE) throw IllegalStateException("GCM message not started");
+    if (_state == AAD)
+    {
+        ghashFlush();
+        _state = DATA;
+    }
+    _dataLength += length;
+
+    // the ciphertext is hashed, before decryption or after encryption
+    size_t chunk = 4096;
+    while (length > 0)
+    {
+        size_t n = length < chunk ? length : chunk;
+        if (!encrypting) ghash(in, n);
+
+        size_t done = 0;
+        if (_used < 16)
+        {
+            done = n < 16 - _used ? n : 16 - _used;
+            xorBlock(out, in, _stream + _used, done);
+            _used += done;
+        }
+        size_t blocks = (n - done) / 16;
+        if (blocks)
+        {
+            _key.ctr(_counter, in + done, out + done, blocks, true);
+            done += 16*blocks;
+        }
+        if (done < n)
+        {
+            memset(_stream, 0, 16);
+            _key.ctr(_counter, _stream, _stream, 1, true);
+            xorBlock(out + done, in + done, _stream, n - done);
+            _used = n - done;
+        }
+
+        if (encrypting) ghash(out, n);
+        in     += n;
+        out    += n;
+        length -= n;
+    }
+}
+
+
+void AESGCM::finish(uint8_t tag[16])
+{
+    if (_state == IDLE) throw IllegalStateException("GCM message not started");
+    ghashFlush();
+
+    uint8_t lengths[16];
+    uint64_t aadBits  = _aadLength * 8;
+    uint64_t dataBits = _dataLength * 8;
+    store32be(lengths,      (uint32_t) (aadBits >> 32));
+    store32be(lengths + 4,  (uint32_t) aadBits);
+    store32be(lengths + 8,  (uint32_t) (dataBits >> 32));
+    store32be(lengths + 12, (uint32_t) dataBits);
+    ghashBlocks(lengths, 1);
+
+    uint8_t ekj0[16];
+    _key.encryptBlocks(_j0, ekj0, 1);
+    xorBlock(tag, _x, ekj0, 16);
+    _state = IDLE;
+}
+
+
+bool AESGCM::verify(const void* tag, size_t tagLength)
+{
+    if (tagLength < 4 || tagLength > 16) throw InvalidArgumentException("GCM tag length");
+
+    uint8_t expected[16];
+    finish(expected);
+    const uint8_t* t = (const uint8_t*) tag;
+    uint8_t diff = 0;
+    for (size_t i = 0; i < tagLength; i++) diff |= expected[i] ^ t[i];
+    return diff == 0;
+}
+
+
+void AESGCM::ghash(const uint8_t* data, size_t length)
+{
+    if (_pendingLength)
+    {
+        size_t n = length < 16 - _pendingLength ? length : 16 - _pendingLength;
+        memcpy(_pending + _pendingLength, data, n);
+        _pendingLength += n;
+        data   += n;
+        length -= n;
+        if (_pendingLength < 16) return;
+        ghashBlocks(_pending, 1);
+        _pendingLength = 0;
+    }
+
+    size_t blocks = length / 16;
+    if (blocks) ghashBlocks(data, blocks);
+
+    _pendingLength = length % 16;
+    memcpy(_pending, data + 16*blocks, _pendingLength);
+}
+
+
+void AESGCM::ghashFlush()
+{
+    if (_pendingLength == 0) return;
+    memset(_pending + _pendingLength, 0, 16 - _pendingLength);
+    ghashBlocks(_pending, 1);
+    _pendingLength = 0;
+}
+
+
+void AESGCM::ghashBlocks(const uint8_t* data, size_t nBlocks)
+{
+#if defined(PIL_AES_X86)
+    if (_clmul) return ghashClmul(_h, _x, data, nBlocks);
+#endif
+    for (size_t i = 0; i < nBlocks; i++)
+    {
+        for (int j = 0; j < 16; j++) _x[j] ^= data[16*i + j];
+        ghashMult(_hl, _hh, _x);
+    }
+}
+
+
+void AESGCM::seal(const AESKey& key, const void* iv, size_t ivLength,
+                  const void* aad, size_t aadLength,
+                  const void* in, void* out, size_t length, uint8_t tag[16])
+{
+    AESGCM gcm(key);
+    gcm.start(iv, ivLength);
+    if (aadLength) gcm.addAAD(aad, aadLength);
+    gcm.encrypt(in, out, length);
+    gcm.finish(tag);
+}
+
+
+bool AESGCM::open(const AESKey& key, const void* iv, size_t ivLength,
+                  const void* aad, size_t aadLength,
+                  const void* in, void* out, size_t length, const uint8_t tag[16])
+{
+    AESGCM gcm(key);
+    gcm.start(iv, ivLength);
+    if (aadLength) gcm.addAAD(aad, aadLength);
+    gcm.decrypt(in, out, length);
+    if (gcm.verify(tag, 16)) return true;
+
+    memset(out, 0, length);
+    return false;
+}
+
+
+}} // end of namespace pi::crypto
@@ -0,0 +1,217 @@
+/*******************************************************************************
+
+  Pilot Intelligence Library
+    http://www.pilotintelligence.com/
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef __AES_CIPHER_H__
+#define __AES_CIPHER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+
+namespace pi {
+namespace crypto {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Streaming AES in CTR and GCM mode.
+///
+/// Unlike AES_encodeMsg(), which runs every block on its own (ECB) and pads
+/// with zeros, the stream modes turn AES into a key stream: data of any
+/// length is encrypted in place or from one buffer into another, without
+/// copies or padding, and may be fed in pieces of any size. GCM also
+/// authenticates the data.
+///
+/// The block cipher runs on AES-NI on x86 or the ARMv8 crypto extension when
+/// available, otherwise on 32 bit T-tables. CTR mode keeps eight blocks in
+/// flight to fill the AES pipeline. The GHASH of GCM uses PCLMULQDQ on x86
+/// and 4 bit tables otherwise.
+///
+/// Never use a key with the same IV or initial counter twice.
+////////////////////////////////////////////////////////////////////////////////
+
+enum AESKernel
+{
+    AES_KERNEL_AUTO,        ///< the fastest kernel available
+    AES_KERNEL_TABLE,       ///< portable T-table implementation
+    AES_KERNEL_HARDWARE     ///< AES instructions, see AESKey::hasHardware()
+};
+
+
+class AESKey
+    /// An expanded AES-128, AES-192 or AES-256 encryption key.
+{
+public:
+    AESKey(const void* key, size_t length, AESKernel kernel = AES_KERNEL_AUTO);
+        /// Expands a key of 16, 24 or 32 bytes. Throws an
+        /// InvalidArgumentException for other lengths.
+        /// AES_KERNEL_HARDWARE falls back to the tables if the CPU
+        /// lacks the instructions.
+
+    ~AESKey();
+        /// Wipes the round keys.
+
+    int rounds() const { return _rounds; }
+
+    bool hardware() const { return _hardware; }
+        /// Returns true if the key uses the AES instructions.
+
+    const char* kernelName() const;
+
+    void encryptBlocks(const uint8_t* in, uint8_t* out, size_t nBlocks) const;
+        /// Encrypts nBlocks independent 16 byte blocks. in and out may
+        /// be the same.
+
+    void ctr(uint8_t counter[16], const uint8_t* in, uint8_t* out, size_t nBlocks,
+             bool increment32 = false) const;
+        /// XORs nBlocks blocks with the encrypted counter and advances
+        /// the big-endian counter by nBlocks, in its last 32 bits only
+        /// if increment32 is set (as GCM does).
+
+    static bool hasHardware();
+        /// Returns true if the CPU has AES instructions.
+
+    const uint32_t* roundKeys() const { return _rk; }
+    const uint8_t*  roundKeyBytes() const { return _rkBytes; }
+
+private:
+    AESKey(const AESKey&);
+    AESKey& operator = (const AESKey&);
+
+    uint32_t    _rk[60];        ///< round keys as big-endian words
+    uint8_t     _rkBytes[240];  ///< the same in memory order
+    int         _rounds;
+    bool        _hardware;
+};
+
+
+class AESCTR
+    /// AES in counter mode (NIST SP 800-38A) with a 128 bit big-endian
+    /// counter. Encryption and decryption are the same operation.
+{
+public:
+    AESCTR(const AESKey& key, const uint8_t iv[16]);
+        /// Starts with the given initial counter block.
+
+    void process(const void* in, void* out, size_t length);
+        /// Encrypts or decrypts length bytes; in may equal out.
+        /// Calls may have any length, the key stream continues.
+
+    void process(void* data, size_t length) { process(data, data, length); }
+
+    void process(std::vector<uint8_t>& data) { if (!data.empty()) process(&data[0], data.size()); }
+
+    void seek(uint64_t offset);
+        /// Moves to the given byte offset in the key stream. Lets several
+        /// threads work on parts of one stream.
+
+private:
+    const AESKey&   _key;
+    uint8_t         _iv[16];
+    uint8_t         _counter[16];
+    uint8_t         _stream[16];    ///< key stream of the current block
+    size_t          _used;          ///< bytes of _stream consumed
+};
+
+
+class AESGCM
+    /// AES in Galois/Counter Mode (NIST SP 800-38D): CTR encryption with
+    /// a 128 bit authentication tag over the ciphertext and additional
+    /// authenticated data (AAD).
+    ///
+    /// Usage:
+    ///     start(iv); addAAD(header)...; encrypt(data)...; finish(tag)
+    /// or for the receiver
+    ///     start(iv); addAAD(header)...; decrypt(data)...; verify(tag)
+    ///
+    /// Decrypted data must not be used before verify() returned true.
+{
+public:
+    AESGCM(const AESKey& key);
+    ~AESGCM();
+
+    void start(const void* iv, size_t ivLength = 12);
+        /// Starts a message. 12 byte IVs are recommended.
+
+    void addAAD(const void* data, size_t length);
+        /// Adds data that is authenticated but not encrypted. Must come
+        /// before encrypt() or decrypt().
+
+    void encrypt(const void* in, void* out, size_t length);
+    void decrypt(const void* in, void* out, size_t length);
+        /// Process the message in pieces of any length; in may equal out.
+
+    void finish(uint8_t tag[16]);
+        /// Computes the tag of the message.
+
+    bool verify(const void* tag, size_t tagLength = 16);
+        /// Computes the tag and compares it in constant time with the
+        /// first tagLength (4 to 16) bytes of the given one.
+
+    static void seal(const AESKey& key, const void* iv, size_t ivLength,
+                     const void* aad, size_t aadLength,
+                     const void* in, void* out, size_t length, uint8_t tag[16]);
+        /// Encrypts a whole message.
+
+    static bool open(const AESKey& key, const void* iv, size_t ivLength,
+                     const void* aad, size_t aadLength,
+                     const void* in, void* out, size_t length, const uint8_t tag[16]);
+        /// Decrypts a whole message, returns false and wipes the output if
+        /// the tag does not match.
+
+private:
+    AESGCM(const AESGCM&);
+    AESGCM& operator = (const AESGCM&);
+
+    enum State
+    {
+        IDLE,
+        AAD,
+        DATA
+    };
+
+    void ghash(const uint8_t* data, size_t length);
+    void ghashBlocks(const uint8_t* data, size_t nBlocks);
+    void ghashFlush();
+    void crypt(const uint8_t* in, uint8_t* out, size_t length, bool encrypting);
+
+    const AESKey&   _key;
+    uint8_t         _h[16];         ///< hash key E(K, 0)
+    uint64_t        _hl[16];        ///< 4 bit tables of the hash key
+    uint64_t        _hh[16];
+    bool            _clmul;
+    uint8_t         _j0[16];        ///< pre-counter block
+    uint8_t         _counter[16];
+    uint8_t         _stream[16];
+    size_t          _used;
+    uint8_t         _x[16];         ///< GHASH state
+    uint8_t         _pending[16];   ///< partial GHASH block
+    size_t          _pendingLength;
+    uint64_t        _aadLength;
+    uint64_t        _dataLength;
+    State           _state;
+};
+
+
+}} // end of namespace pi::crypto
+
+#endif // end of __AES_CIPHER_H__
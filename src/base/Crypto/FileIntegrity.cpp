@@ -0,0 +1,405 @@
+/*******************************************************************************
+
+  Pilot Intelligence Library
+    http://www.pilotintelligence.com/
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "base/Environment.h"
+#include "base/Debug/Exception.h"
+#include "base/Thread/AtomicCounter.h"
+#include "base/Thread/Runnable.h"
+#include "base/Thread/Thread.h"
+#include "base/Utils/Environment.h"
+
+#include "MD5.h"
+#include "FileIntegrity.h"
+
+namespace pi {
+namespace crypto {
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+/// records of files changed this close to the check are not trusted
+const int64_t RACY_WINDOW = 2000000000LL;
+
+struct HashTask
+{
+    const std::string*  path;
+    uint64_t            offset;
+    int64_t             length;
+    uint8_t             digest[MD5Engine::DIGEST_SIZE];
+    bool                ok;
+};
+
+/// Takes the next task until none is left; every thread runs one of these.
+class HashWorker : public Runnable
+{
+public:
+    HashWorker(std::vector<HashTask>& tasks, AtomicCounter& next)
+        : _tasks(tasks), _next(next) {}
+
+    void run()
+    {
+        MD5Engine md5;
+        for(;;) {
+            int i = _next++;
+            if( i >= (int) _tasks.size() ) break;
+
+            HashTask& t = _tasks[i];
+            md5.reset();
+            t.ok = md5_file_range(*t.path, t.offset, t.length, md5) == 0;
+            md5.finish(t.digest);
+        }
+    }
+
+private:
+    std::vector<HashTask>&  _tasks;
+    AtomicCounter&          _next;
+};
+
+void runTasks(std::vector<HashTask>& tasks, int threads)
+{
+    if( threads < 0 ) threads = Environment::processorCount();
+    threads = std::min<int>(threads, tasks.size());
+
+    AtomicCounter next;
+    HashWorker    worker(tasks, next);
+
+    // the calling thread is one of the workers
+    std::vector<Thread*> pool;
+    for(int i=1; i<threads; i++) {
+        Thread* t = new Thread;
+        t->setName("FileIntegrity");
+        t->start(worker);
+        pool.push_back(t);
+    }
+
+    worker.run();
+
+    for(size_t i=0; i<pool.size(); i++) {
+        pool[i]->join();
+        delete pool[i];
+    }
+}
+
+bool fileStat(const std::string& path, uint64_t& size, int64_t& mtime)
+{
+    struct stat st;
+    if( stat(path.c_str(), &st) != 0 ) return false;
+    if( !S_ISREG(st.st_mode) ) return false;
+
+    size = st.st_size;
+#if defined(__APPLE__)
+    mtime = (int64_t) st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#elif defined(PIL_OS_FAMILY_UNIX)
+    mtime = (int64_t) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+    mtime = (int64_t) st.st_mtime * 1000000000LL;
+#endif
+    return true;
+}
+
+int64_t nowNs()
+{
+#if defined(PIL_OS_FAMILY_UNIX)
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+    return (int64_t) time(NULL) * 1000000000LL;
+#endif
+}
+
+/// Appends the tasks which hash a file of the given size.
+void addTasks(std::vector<HashTask>& tasks, const std::string& path,
+              uint64_t size, size_t blockSize)
+{
+    HashTask t;
+    t.path = &path;
+    t.ok   = false;
+
+    if( blockSize == 0 ) {
+        t.offset = 0;
+        t.length = size;
+        tasks.push_back(t);
+        return;
+    }
+
+    for(uint64_t off=0; off<size; off+=blockSize) {
+        t.offset = off;
+        t.length = std::min<uint64_t>(blockSize, size - off);
+        tasks.push_back(t);
+    }
+}
+
+size_t taskCount(uint64_t size, size_t blockSize)
+{
+    if( blockSize == 0 ) return 1;
+    return (size + blockSize - 1) / blockSize;
+}
+
+void putLE64(uint8_t* p, uint64_t v)
+{
+    for(int i=0; i<8; i++) p[i] = (uint8_t) (v >> (8*i));
+}
+
+/// Combines the results of the tasks of one file; false if any failed.
+bool finishHash(const HashTask* tasks, size_t n, uint64_t size, size_t blockSize,
+                std::vector<uint8_t>& hash)
+{
+    for(size_t i=0; i<n; i++)
+        if( !tasks[i].ok ) return false;
+
+    if( blockSize == 0 ) {
+        hash.assign(tasks[0].digest, tasks[0].digest + MD5Engine::DIGEST_SIZE);
+        return true;
+    }
+
+    MD5Engine md5;
+    uint8_t   head[16];
+    putLE64(head, blockSize);
+    putLE64(head + 8, size);
+    md5.update(head, sizeof(head));
+    for(size_t i=0; i<n; i++)
+        md5.update(tasks[i].digest, MD5Engine::DIGEST_SIZE);
+
+    hash = md5.digest();
+    return true;
+}
+
+std::string modeName(size_t blockSize)
+{
+    if( blockSize == 0 ) return "md5";
+
+    std::ostringstream os;
+    os << "md5tree:" << blockSize;
+    return os.str();
+}
+
+} // end of anonymous namespace
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+int md5_file_tree(const std::string& fname, std::vector<uint8_t>& hash,
+                  size_t blockSize, int threads)
+{
+    if( blockSize == 0 )
+        throw InvalidArgumentException("md5_file_tree: block size must not be 0");
+
+    uint64_t size;
+    int64_t  mtime;
+    if( !fileStat(fname, size, mtime) ) return -1;
+
+    std::vector<HashTask> tasks;
+    addTasks(tasks, fname, size, blockSize);
+    runTasks(tasks, threads);
+
+    const HashTask* first = tasks.empty() ? NULL : &tasks[0];
+    return finishHash(first, tasks.size(), size, blockSize, hash) ? 0 : -1;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+FileIntegrity::FileIntegrity(int threads, size_t treeBlockSize)
+    : _threads(threads), _treeBlockSize(treeBlockSize)
+{
+}
+
+bool FileIntegrity::load(const std::string& manifest)
+{
+    std::ifstream in(manifest.c_str());
+    if( !in ) return false;
+
+    std::map<std::string, FileRecord> records;
+    std::string line;
+    int         lineNo = 0;
+
+    while( std::getline(in, line) ) {
+        lineNo++;
+        if( line.empty() || line[0] == '#' ) continue;
+
+        // the path is last, it may contain tabs
+        size_t p[4], pos = 0;
+        for(int i=0; i<4; i++) {
+            p[i] = line.find('\t', pos);
+            if( p[i] == std::string::npos )
+                throw DataFormatException("FileIntegrity: malformed line in " + manifest, lineNo);
+            pos = p[i] + 1;
+        }
+
+        std::string mode = line.substr(0, p[0]);
+        std::string hex  = line.substr(p[0] + 1, p[1] - p[0] - 1);
+
+        FileRecord r;
+        r.path  = line.substr(p[3] + 1);
+        r.size  = strtoull(line.c_str() + p[1] + 1, NULL, 10);
+        r.mtime = strtoll(line.c_str() + p[2] + 1, NULL, 10);
+
+        if( mode == "md5" )
+            r.blockSize = 0;
+        else if( mode.compare(0, 8, "md5tree:") == 0 && (r.blockSize = strtoul(mode.c_str() + 8, NULL, 10)) > 0 )
+            ;
+        else
+            throw DataFormatException("FileIntegrity: unknown hash mode " + mode, lineNo);
+
+        if( hex.size() != 2*MD5Engine::DIGEST_SIZE ||
+            hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos )
+            throw DataFormatException("FileIntegrity: malformed hash in " + manifest, lineNo);
+        r.hash = str2hex(hex);
+
+        records[r.path] = r;
+    }
+
+    _records.swap(records);
+    return true;
+}
+
+void FileIntegrity::save(const std::string& manifest) const
+{
+    std::string tmp = manifest + ".tmp";
+
+    {
+        std::ofstream out(tmp.c_str(), std::ios::trunc);
+        if( !out ) throw WriteFileException(tmp);
+
+        std::map<std::string, FileRecord>::const_iterator it;
+        for(it=_records.begin(); it!=_records.end(); it++) {
+            const FileRecord& r = it->second;
+            out << modeName(r.blockSize) << '\t' << hex2str(r.hash) << '\t'
+                << r.size << '\t' << r.mtime << '\t' << r.path << '\n';
+        }
+
+        out.flush();
+        if( !out ) throw WriteFileException(tmp);
+    }
+
+    if( rename(tmp.c_str(), manifest.c_str()) != 0 ) {
+        ::remove(tmp.c_str());
+        throw WriteFileException(manifest);
+    }
+}
+
+std::vector<FileIntegrity::Result> FileIntegrity::check(const std::vector<std::string>& paths, bool force)
+{
+    struct Pending
+    {
+        size_t      result;
+        uint64_t    size;
+        int64_t     mtime;
+        size_t      blockSize;
+        size_t      firstTask;
+    };
+
+    std::vector<Result>   results(paths.size());
+    std::vector<Pending>  pending;
+    std::vector<HashTask> tasks;
+
+    for(size_t i=0; i<paths.size(); i++) {
+        Result& res = results[i];
+        res.path = paths[i];
+
+        Pending p;
+        p.result = i;
+        if( !fileStat(paths[i], p.size, p.mtime) ) {
+            res.status = MISSING;
+            continue;
+        }
+
+        const FileRecord* rec = find(paths[i]);
+        if( rec && !force && rec->mtime >= 0 &&
+            rec->size == p.size && rec->mtime == p.mtime ) {
+            res.status = UNCHANGED;
+            continue;
+        }
+
+        p.blockSize = rec ? rec->blockSize : _treeBlockSize;
+        p.firstTask = tasks.size();
+        pending.push_back(p);
+        addTasks(tasks, paths[i], p.size, p.blockSize);
+    }
+
+    // small files and the blocks of large ones share the same workers
+    runTasks(tasks, _threads);
+    int64_t done = nowNs();
+
+    for(size_t i=0; i<pending.size(); i++) {
+        const Pending& p = pending[i];
+        Result&        res = results[p.result];
+
+        size_t n = taskCount(p.size, p.blockSize);
+        const HashTask* first = n ? &tasks[p.firstTask] : NULL;
+
+        FileRecord r;
+        r.path      = res.path;
+        r.size      = p.size;
+        r.mtime     = p.mtime + RACY_WINDOW > done ? -1 : p.mtime;
+        r.blockSize = p.blockSize;
+        if( !finishHash(first, n, p.size, p.blockSize, r.hash) ) {
+            res.status = FAILED;
+            res.error  = "can not read " + res.path;
+            continue;
+        }
+
+        std::map<std::string, FileRecord>::iterator it = _records.find(res.path);
+        if( it == _records.end() )
+            res.status = ADDED;
+        else if( it->second.hash == r.hash )
+            res.status = VERIFIED;
+        else
+            res.status = MODIFIED;
+
+        _records[res.path] = r;
+    }
+
+    return results;
+}
+
+const FileRecord* FileIntegrity::find(const std::string& path) const
+{
+    std::map<std::string, FileRecord>::const_iterator it = _records.find(path);
+    if( it == _records.end() ) return NULL;
+    return &it->second;
+}
+
+bool FileIntegrity::remove(const std::string& path)
+{
+    return _records.erase(path) > 0;
+}
+
+
+}} // end of namespace pi::crypto
@@ -0,0 +1,146 @@
+/*******************************************************************************
+
+  Pilot Intelligence Library
+    http://www.pilotintelligence.com/
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef __FILE_INTEGRITY_H__
+#define __FILE_INTEGRITY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace pi {
+namespace crypto {
+
+////////////////////////////////////////////////////////////////////////////////
+/// File integrity checks based on MD5.
+///
+/// FileIntegrity keeps a manifest of (path, size, mtime, hash) records and
+/// verifies many files at once on a set of worker threads. Files whose size
+/// and modification time still match their record are not read again.
+///
+/// In tree mode a file is cut into blocks of a fixed size, which are hashed
+/// in parallel, so a single large file uses all processors. The result is
+///     MD5( le64(block size) | le64(file size) | MD5(block 0) | MD5(block 1) ... )
+/// and differs from the plain MD5 of the file.
+///
+/// The hashes detect accidental changes, not tampering: MD5 is broken for
+/// collision resistance.
+////////////////////////////////////////////////////////////////////////////////
+
+int md5_file_tree(const std::string& fname, std::vector<uint8_t>& hash,
+                  size_t blockSize = 4*1024*1024, int threads = -1);
+    /// Computes the tree hash of a file, with threads workers (-1 uses one
+    /// per processor, 0 the calling thread only). Returns -1 if the file
+    /// can not be read.
+
+
+struct FileRecord
+    /// What the manifest knows about one file.
+{
+    std::string             path;
+    uint64_t                size;
+    int64_t                 mtime;      ///< nanoseconds since the epoch, -1 if unknown
+    size_t                  blockSize;  ///< tree hash block size, 0 for plain MD5
+    std::vector<uint8_t>    hash;
+
+    FileRecord(): size(0), mtime(-1), blockSize(0) {}
+};
+
+
+class FileIntegrity
+    /// A manifest of file hashes.
+    ///
+    /// Usage:
+    ///     FileIntegrity fi;
+    ///     fi.load("files.md5");
+    ///     std::vector<FileIntegrity::Result> r = fi.check(paths);
+    ///     fi.save("files.md5");
+    ///
+    /// The manifest is a text file with one line per file:
+    ///     mode <tab> hex hash <tab> size <tab> mtime <tab> path
+    /// where mode is "md5" or "md5tree:<block size>". Paths must not
+    /// contain line breaks.
+    ///
+    /// A file modified within the timestamp granularity of its file
+    /// system after it was hashed would keep its size and mtime. Records
+    /// of files changed shortly before a check are therefore stored with
+    /// an unknown mtime, and are hashed again by the next check.
+{
+public:
+    enum Status
+    {
+        UNCHANGED,      ///< size and mtime match the record, not read
+        VERIFIED,       ///< read again, the hash matches the record
+        MODIFIED,       ///< the hash differs from the record
+        ADDED,          ///< there was no record, one was created
+        MISSING,        ///< the file does not exist
+        FAILED          ///< the file could not be read, see error
+    };
+
+    struct Result
+    {
+        std::string     path;
+        Status          status;
+        std::string     error;
+    };
+
+    FileIntegrity(int threads = -1, size_t treeBlockSize = 0);
+        /// threads as for md5_file_tree(). New records use tree hashes
+        /// with the given block size, or plain MD5 if it is 0. Existing
+        /// records are checked in the mode they were created with.
+
+    bool load(const std::string& manifest);
+        /// Replaces the records by those of the manifest. Returns false if
+        /// the manifest does not exist; throws a DataFormatException if it
+        /// is malformed.
+
+    void save(const std::string& manifest) const;
+        /// Writes the records, through a temporary file that replaces the
+        /// manifest. Throws a WriteFileException on errors.
+
+    std::vector<Result> check(const std::vector<std::string>& paths, bool force = false);
+        /// Checks the given files against their records and updates the
+        /// records of changed and added files. With force every file is
+        /// read. Records of missing files are kept; see remove().
+
+    const FileRecord* find(const std::string& path) const;
+        /// Returns the record of a file, or NULL.
+
+    const std::map<std::string, FileRecord>& records() const { return _records; }
+
+    bool remove(const std::string& path);
+        /// Drops the record of a file. Returns false if there was none.
+
+private:
+    int                                 _threads;
+    size_t                              _treeBlockSize;
+    std::map<std::string, FileRecord>   _records;
+};
+
+
+}} // end of namespace pi::crypto
+
+#endif // end of __FILE_INTEGRITY_H__
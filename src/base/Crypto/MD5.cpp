@@ -41,8 +41,18 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
+#include "base/Environment.h"
 #include "MD5.h"
 
+#ifdef PIL_OS_FAMILY_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 namespace pi {
 namespace crypto {
 
@@ -52,11 +62,7 @@ namespace crypto {
 
 #define MD5_HASHBYTES 16
 
-typedef struct MD5Context {
-    uint32_t buf[4];
-        uint32_t bits[2];
-        unsigned char in[64];
-} MD5_CTX;
+typedef MD5Context MD5_CTX;
 
 
 static void MD5Init(MD5_CTX *context);
@@ -67,7 +73,7 @@ static char* MD5End(MD5_CTX *, char *);
 
 
 
-#if __BYTE_ORDER == 1234
+#if defined(PIL_ARCH_LITTLE_ENDIAN)
 #define byteReverse(buf, len)   /* Nothing */
 #else
 void byteReverse(unsigned char *buf, unsigned longs);
@@ -85,7 +91,7 @@ void byteReverse(unsigned char *buf, unsigned longs)
         buf += 4;
     } while (--longs);
 }
-#endif /* ! __BYTE_ORDER == 1234 */
+#endif /* ! PIL_ARCH_LITTLE_ENDIAN */
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -162,6 +168,17 @@ void MD5Update(MD5_CTX *ctx, unsigned char const *buf, unsigned len)
     }
     /* Process data in 64-byte chunks */
 
+#if defined(PIL_ARCH_LITTLE_ENDIAN)
+    /* Aligned input needs no copy */
+    if (((size_t) buf & 3) == 0) {
+        while (len >= 64) {
+            MD5Transform(ctx->buf, (uint32_t const *) buf);
+            buf += 64;
+            len -= 64;
+        }
+    }
+#endif
+
     while (len >= 64) {
         memcpy(ctx->in, buf, 64);
         byteReverse(ctx->in, 16);
@@ -217,7 +234,7 @@ void MD5Final(unsigned char digest[16], MD5_CTX *ctx)
     MD5Transform(ctx->buf, (uint32_t *) ctx->in);
     byteReverse((unsigned char *) ctx->buf, 4);
     memcpy(digest, ctx->buf, 16);
-    memset((char *) ctx, 0, sizeof(ctx));       /* In case it's sensitive */
+    memset((char *) ctx, 0, sizeof(*ctx));       /* In case it's sensitive */
 }
 
 /* The four core functions - F1 is optimized somewhat */
@@ -325,31 +342,104 @@ void MD5Transform(uint32_t buf[4], uint32_t const in[16])
 ////////////////////////////////////////////////////////////////////////////////
 
 
-int md5_file(const std::string& fname, std::vector<uint8_t>& md5_hex)
+void MD5Engine::reset()
 {
-    MD5_CTX ctx;
+    MD5Init(&m_ctx);
+}
 
-    unsigned char buffer[BUFSIZ];
-    int l = 0;
+void MD5Engine::update(const void *dat, size_t len)
+{
+    const unsigned char *p = (const unsigned char*) dat;
+
+    // MD5Update counts bits in 32 bit steps
+    while( len > 0 ) {
+        unsigned n = len > (1u << 28) ? (1u << 28) : (unsigned) len;
+        MD5Update(&m_ctx, p, n);
+        p   += n;
+        len -= n;
+    }
+}
 
-    MD5Init(&ctx);
+void MD5Engine::finish(uint8_t digest[DIGEST_SIZE])
+{
+    MD5Final(digest, &m_ctx);
+    MD5Init(&m_ctx);
+}
+
+int md5_file_range(const std::string& fname, uint64_t offset, int64_t length,
+                   MD5Engine& md5)
+{
+#ifdef PIL_OS_FAMILY_UNIX
+    int fd = open(fname.c_str(), O_RDONLY);
+    if( fd < 0 ) return -1;
+
+    struct stat st;
+    if( fstat(fd, &st) != 0 ) { close(fd); return -1; }
+
+    uint64_t fsize = st.st_size;
+    if( offset > fsize ) { close(fd); return -1; }
+    uint64_t end = length < 0 ? fsize : offset + length;
+    if( end > fsize ) { close(fd); return -1; }
+
+    // map the range in windows, so 32 bit hosts and huge files work too
+    const uint64_t window = 64*1024*1024;
+    const uint64_t page   = sysconf(_SC_PAGESIZE);
+
+    uint64_t pos = offset;
+    while( pos < end ) {
+        uint64_t mapStart = pos - pos % page;
+        uint64_t mapEnd   = std::min(end, mapStart + window);
+        size_t   mapLen   = mapEnd - mapStart;
+
+        void *p = mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE, fd, mapStart);
+        if( p == MAP_FAILED ) break;
+        madvise(p, mapLen, MADV_SEQUENTIAL);
+
+        md5.update((const char*) p + (pos - mapStart), mapEnd - pos);
+        munmap(p, mapLen);
+        pos = mapEnd;
+    }
+
+    // files which can not be mapped, e.g. on some special file systems
+    std::vector<char> buf;
+    while( pos < end ) {
+        if( buf.empty() ) buf.resize(1024*1024);
+        size_t  n = std::min<uint64_t>(buf.size(), end - pos);
+        ssize_t r = pread(fd, buf.data(), n, pos);
+        if( r <= 0 ) { close(fd); return -1; }
+        md5.update(buf.data(), r);
+        pos += r;
+    }
 
-    // read & process data
+    close(fd);
+    return 0;
+#else
     FILE *fp = fopen(fname.c_str(), "rb");
     if( fp == NULL ) return -1;
 
-    while( 1 ) {
-        l = fread(buffer, 1, BUFSIZ, fp);
-        if( l <= 0 ) break;
+    if( offset > 0 && fseek(fp, (long) offset, SEEK_SET) != 0 ) { fclose(fp); return -1; }
 
-        MD5Update(&ctx, buffer, l);
+    std::vector<char> buf(1024*1024);
+    while( length != 0 ) {
+        size_t n = buf.size();
+        if( length > 0 && (uint64_t) length < n ) n = (size_t) length;
+        size_t r = fread(buf.data(), 1, n, fp);
+        if( r == 0 ) break;
+        md5.update(buf.data(), r);
+        if( length > 0 ) length -= r;
     }
-
     fclose(fp);
 
-    // get the digest
-    md5_hex.resize(MD5_HASHBYTES);
-    MD5Final((unsigned char*)md5_hex.data(), &ctx);
+    return length > 0 ? -1 : 0;
+#endif
+}
+
+int md5_file(const std::string& fname, std::vector<uint8_t>& md5_hex)
+{
+    MD5Engine md5;
+    if( md5_file_range(fname, 0, -1, md5) != 0 ) return -1;
+
+    md5_hex = md5.digest();
 
     return 0;
 }
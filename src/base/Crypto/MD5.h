@@ -33,8 +33,47 @@
 namespace pi {
 namespace crypto {
 
+struct MD5Context {
+    uint32_t        buf[4];
+    uint32_t        bits[2];
+    unsigned char   in[64];
+};
+
+/// Streaming MD5: feed data of any size with update(), then finish().
+class MD5Engine
+{
+public:
+    enum { DIGEST_SIZE = 16 };
+
+    MD5Engine() { reset(); }
+
+    void reset();
+
+    void update(const void *dat, size_t len);
+
+    /// Writes the digest and resets the engine.
+    void finish(uint8_t digest[DIGEST_SIZE]);
+
+    std::vector<uint8_t> digest() {
+        std::vector<uint8_t> d(DIGEST_SIZE);
+        finish(d.data());
+        return d;
+    }
+
+private:
+    MD5Context  m_ctx;
+};
+
+
+/// Returns the MD5 of a file, read through mmap where possible.
 int md5_file(const std::string& fname, std::vector<uint8_t>& md5_hex);
 
+/// Feeds length bytes of a file starting at offset into md5, or up to the
+/// end of the file if length is negative. Returns -1 if the file can not be
+/// read or is shorter than the range.
+int md5_file_range(const std::string& fname, uint64_t offset, int64_t length,
+                   MD5Engine& md5);
+
 int md5_data(const std::vector<uint8_t>& data, std::vector<uint8_t>& md5_hex);
 int md5_data(const std::string& msg, std::vector<uint8_t>& md5_hex);
 int md5_data(const void *dat, int len, std::vector<uint8_t>& md5_hex);
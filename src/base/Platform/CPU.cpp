@@ -0,0 +1,236 @@
+#include "CPU.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIL_CPU_X86 1
+#include <cpuid.h>
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#define PIL_CPU_ARM_LINUX 1
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+
+namespace pi {
+namespace cpu {
+
+
+namespace
+{
+	struct FeatureInfo
+	{
+		Feature     feature;
+		const char* name;
+	};
+
+	const FeatureInfo FEATURES[] =
+	{
+		{ SSE2,      "sse2" },
+		{ SSE3,      "sse3" },
+		{ SSSE3,     "ssse3" },
+		{ SSE41,     "sse4.1" },
+		{ SSE42,     "sse4.2" },
+		{ POPCNT,    "popcnt" },
+		{ AVX,       "avx" },
+		{ AVX2,      "avx2" },
+		{ FMA,       "fma" },
+		{ BMI1,      "bmi1" },
+		{ BMI2,      "bmi2" },
+		{ F16C,      "f16c" },
+		{ AVX512F,   "avx512f" },
+		{ AVX512DQ,  "avx512dq" },
+		{ AVX512BW,  "avx512bw" },
+		{ AVX512VL,  "avx512vl" },
+		{ AESNI,     "aes" },
+		{ PCLMUL,    "pclmul" },
+		{ SHA,       "sha" },
+		{ VAES,      "vaes" },
+		{ VPCLMUL,   "vpclmul" },
+		{ NEON,      "neon" },
+		{ ARM_CRC32, "crc32" },
+		{ ARM_AES,   "arm-aes" },
+		{ ARM_PMULL, "pmull" },
+		{ ARM_SHA2,  "sha2" }
+	};
+
+	const int FEATURE_COUNT = sizeof(FEATURES)/sizeof(FEATURES[0]);
+
+
+	struct CPUInfo
+	{
+		CPUInfo();
+
+		Features    features;
+		char        vendor[13];
+	};
+
+
+#if defined(PIL_CPU_X86)
+	unsigned long long xgetbv0()
+	{
+		unsigned int eax, edx;
+		__asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+		return ((unsigned long long) edx << 32) | eax;
+	}
+#endif
+
+
+	Features parseDisabled(const char* list)
+	{
+		Features disabled = 0;
+		std::string names(list);
+		std::string::size_type pos = 0;
+		while (pos <= names.size())
+		{
+			std::string::size_type end = names.find(',', pos);
+			if (end == std::string::npos) end = names.size();
+			std::string name = names.substr(pos, end - pos);
+			for (int i = 0; i < FEATURE_COUNT; i++)
+			{
+				if (name == FEATURES[i].name) disabled |= FEATURES[i].feature;
+			}
+			pos = end + 1;
+		}
+		return disabled;
+	}
+
+
+	CPUInfo::CPUInfo():
+		features(0)
+	{
+		memset(vendor, 0, sizeof(vendor));
+
+#if defined(PIL_CPU_X86)
+		unsigned int eax, ebx, ecx, edx;
+		unsigned int maxLeaf = __get_cpuid_max(0, 0);
+		if (maxLeaf >= 1)
+		{
+			__cpuid(0, eax, ebx, ecx, edx);
+			memcpy(vendor, &ebx, 4);
+			memcpy(vendor + 4, &edx, 4);
+			memcpy(vendor + 8, &ecx, 4);
+
+			__cpuid(1, eax, ebx, ecx, edx);
+			if (edx & bit_SSE2)   features |= SSE2;
+			if (ecx & bit_SSE3)   features |= SSE3;
+			if (ecx & bit_SSSE3)  features |= SSSE3;
+			if (ecx & bit_SSE4_1) features |= SSE41;
+			if (ecx & bit_SSE4_2) features |= SSE42;
+			if (ecx & bit_POPCNT) features |= POPCNT;
+			if (ecx & bit_AES)    features |= AESNI;
+			if (ecx & bit_PCLMUL) features |= PCLMUL;
+
+			// the wider registers also need support by the OS
+			bool osYmm = false, osZmm = false;
+			if (ecx & bit_OSXSAVE)
+			{
+				unsigned long long xcr0 = xgetbv0();
+				osYmm = (xcr0 & 0x06) == 0x06;
+				osZmm = (xcr0 & 0xE6) == 0xE6;
+			}
+			if (osYmm)
+			{
+				if (ecx & bit_AVX)  features |= AVX;
+				if (ecx & bit_FMA)  features |= FMA;
+				if (ecx & bit_F16C) features |= F16C;
+			}
+
+			if (maxLeaf >= 7)
+			{
+				__cpuid_count(7, 0, eax, ebx, ecx, edx);
+				if (ebx & (1u << 3))  features |= BMI1;
+				if (ebx & (1u << 8))  features |= BMI2;
+				if (ebx & (1u << 29)) features |= SHA;
+				if (osYmm)
+				{
+					if (ebx & (1u << 5))  features |= AVX2;
+					if (ecx & (1u << 9))  features |= VAES;
+					if (ecx & (1u << 10)) features |= VPCLMUL;
+				}
+				if (osZmm)
+				{
+					if (ebx & (1u << 16)) features |= AVX512F;
+					if (ebx & (1u << 17)) features |= AVX512DQ;
+					if (ebx & (1u << 30)) features |= AVX512BW;
+					if (ebx & (1u << 31)) features |= AVX512VL;
+				}
+			}
+		}
+#elif defined(__aarch64__)
+		strcpy(vendor, "AArch64");
+		features |= NEON;
+#if defined(PIL_CPU_ARM_LINUX)
+		unsigned long hwcap = getauxval(AT_HWCAP);
+		if (hwcap & HWCAP_CRC32) features |= ARM_CRC32;
+		if (hwcap & HWCAP_AES)   features |= ARM_AES;
+		if (hwcap & HWCAP_PMULL) features |= ARM_PMULL;
+		if (hwcap & HWCAP_SHA2)  features |= ARM_SHA2;
+#elif defined(__APPLE__)
+		// every Apple CPU has the ARMv8 crypto extension
+		features |= ARM_CRC32 | ARM_AES | ARM_PMULL | ARM_SHA2;
+#endif
+#elif defined(__ARM_NEON)
+		strcpy(vendor, "ARM");
+		features |= NEON;
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+		// required by the build flags anyway
+		features |= ARM_CRC32;
+#endif
+#if defined(__ARM_FEATURE_CRYPTO)
+		features |= ARM_AES | ARM_PMULL | ARM_SHA2;
+#endif
+
+		const char* disabled = getenv("PIL_CPU_DISABLE");
+		if (disabled) features &= ~parseDisabled(disabled);
+	}
+
+
+	const CPUInfo& cpuInfo()
+	{
+		// C++11 guarantees thread safe initialisation
+		static const CPUInfo info;
+		return info;
+	}
+}
+
+
+Features features()
+{
+	return cpuInfo().features;
+}
+
+
+const char* featureName(Feature feature)
+{
+	for (int i = 0; i < FEATURE_COUNT; i++)
+	{
+		if (FEATURES[i].feature == feature) return FEATURES[i].name;
+	}
+	return "unknown";
+}
+
+
+std::string describe()
+{
+	const CPUInfo& info = cpuInfo();
+	std::string result(info.vendor[0] ? info.vendor : "unknown");
+	result += ":";
+	for (int i = 0; i < FEATURE_COUNT; i++)
+	{
+		if (info.features & FEATURES[i].feature)
+		{
+			result += " ";
+			result += FEATURES[i].name;
+		}
+	}
+	return result;
+}
+
+
+} } // namespace pi::cpu
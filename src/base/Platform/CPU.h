@@ -0,0 +1,177 @@
+#ifndef PIL_CPU_INCLUDED
+#define PIL_CPU_INCLUDED
+
+
+#include "base/Environment.h"
+#include "base/Types/Int.h"
+#include <string>
+
+
+//
+// Kernel variants
+//
+// Variants of a kernel for newer instruction sets are compiled with
+// function target attributes, so the rest of the library keeps the
+// baseline flags and one binary runs on every CPU. Mark a variant with
+// one of the PIL_TARGET_* macros, guarded by the matching
+// PIL_CPU_HAS_*_VARIANTS, and select it at run time with cpu::Dispatch:
+//
+//     #if defined(PIL_CPU_HAS_X86_VARIANTS)
+//     PIL_TARGET_AVX2 void scaleAvx2(float* p, int n, float s) { ... }
+//     #endif
+//
+// Building with PIL_NO_CPU_DISPATCH (CMake option PIL_CPU_DISPATCH=OFF)
+// leaves out all variants.
+//
+#if !defined(PIL_NO_CPU_DISPATCH) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define PIL_CPU_HAS_X86_VARIANTS 1
+	#define PIL_TARGET(features) __attribute__((target(features)))
+	#define PIL_TARGET_SSE42   PIL_TARGET("sse4.2,popcnt")
+	#define PIL_TARGET_AVX2    PIL_TARGET("avx2,fma,bmi,bmi2")
+	#define PIL_TARGET_AVX512  PIL_TARGET("avx512f,avx512dq,avx512bw,avx512vl")
+	#define PIL_TARGET_AESNI   PIL_TARGET("aes,sse4.1")
+	#define PIL_TARGET_PCLMUL  PIL_TARGET("pclmul,sse4.1")
+#endif
+
+#if !defined(PIL_NO_CPU_DISPATCH) && defined(__GNUC__) && defined(__aarch64__)
+	// NEON is part of the AArch64 baseline, no attribute is needed
+	#define PIL_CPU_HAS_NEON_VARIANTS 1
+	#define PIL_TARGET_NEON
+#endif
+
+
+namespace pi {
+namespace cpu {
+
+
+typedef pi::UInt64 Features;
+	/// A set of CPU features, see Feature.
+
+
+enum Feature
+	/// CPU features which kernels may depend on. The AVX and AVX-512
+	/// features are only reported if the operating system saves the
+	/// wider registers.
+{
+	SSE2        = 1ULL << 0,
+	SSE3        = 1ULL << 1,
+	SSSE3       = 1ULL << 2,
+	SSE41       = 1ULL << 3,
+	SSE42       = 1ULL << 4,
+	POPCNT      = 1ULL << 5,
+	AVX         = 1ULL << 6,
+	AVX2        = 1ULL << 7,
+	FMA         = 1ULL << 8,
+	BMI1        = 1ULL << 9,
+	BMI2        = 1ULL << 10,
+	F16C        = 1ULL << 11,
+	AVX512F     = 1ULL << 12,
+	AVX512DQ    = 1ULL << 13,
+	AVX512BW    = 1ULL << 14,
+	AVX512VL    = 1ULL << 15,
+	AESNI       = 1ULL << 16,
+	PCLMUL      = 1ULL << 17,
+	SHA         = 1ULL << 18,
+	VAES        = 1ULL << 19,
+	VPCLMUL     = 1ULL << 20,
+
+	NEON        = 1ULL << 32,
+	ARM_CRC32   = 1ULL << 33,
+	ARM_AES     = 1ULL << 34,
+	ARM_PMULL   = 1ULL << 35,
+	ARM_SHA2    = 1ULL << 36
+};
+
+
+enum Level
+	/// Groups of features matching the PIL_TARGET_* macros.
+{
+	LEVEL_GENERIC = 0,
+	LEVEL_SSE42   = SSE2 | SSE3 | SSSE3 | SSE41 | SSE42 | POPCNT,
+	LEVEL_AVX2    = LEVEL_SSE42 | AVX | AVX2 | FMA | BMI1 | BMI2,
+	LEVEL_AVX512  = LEVEL_AVX2 | AVX512F | AVX512DQ | AVX512BW | AVX512VL,
+	LEVEL_NEON    = NEON
+};
+
+
+Features PIL_API features();
+	/// Returns the features of the CPU, detected once with cpuid or the
+	/// auxiliary vector.
+	///
+	/// Features named in the environment variable PIL_CPU_DISABLE, e.g.
+	/// "avx512f,avx2", are removed, which lets the generic kernels be
+	/// tested and benchmarked on any machine.
+
+
+inline bool has(Features required)
+	/// Returns true if the CPU has all of the given features.
+{
+	return (features() & required) == required;
+}
+
+
+const char* PIL_API featureName(Feature feature);
+	/// Returns the lower case name of a feature, e.g. "avx2".
+
+
+std::string PIL_API describe();
+	/// Returns the vendor and the names of all features, for logs.
+
+
+template <class Func>
+class Dispatch
+	/// Selects one variant of a kernel for the running CPU.
+	///
+	/// Add the variants from the fastest to the slowest; the first one
+	/// whose features are all present wins, otherwise the generic one.
+	/// Resolve once, e.g. into a function-local static, and call the
+	/// result directly afterwards:
+	///
+	///     static const ScaleFunc scale = cpu::Dispatch<ScaleFunc>(scaleGeneric)
+	///         .add(cpu::LEVEL_AVX2, scaleAvx2, "avx2")
+	///         .add(cpu::LEVEL_SSE42, scaleSse42, "sse4.2")
+	///         .function();
+{
+public:
+	explicit Dispatch(Func generic, const char* name = "generic"):
+		_func(generic),
+		_name(name),
+		_resolved(false)
+	{
+	}
+
+	Dispatch& add(Features required, Func variant, const char* name)
+		/// Adds a variant for CPUs with all the required features.
+	{
+		if (!_resolved && has(required))
+		{
+			_func     = variant;
+			_name     = name;
+			_resolved = true;
+		}
+		return *this;
+	}
+
+	Func function() const
+		/// Returns the selected variant.
+	{
+		return _func;
+	}
+
+	const char* name() const
+		/// Returns the name of the selected variant.
+	{
+		return _name;
+	}
+
+private:
+	Func        _func;
+	const char* _name;
+	bool        _resolved;
+};
+
+
+} } // namespace pi::cpu
+
+
+#endif // PIL_CPU_INCLUDED
@@ -0,0 +1,185 @@
+#include "BiasedMutexRW.h"
+#include "SpinLock.h"
+
+#include <stdint.h>
+#include <chrono>
+
+
+namespace pi {
+
+
+namespace {
+
+enum
+{
+    READER_SLOTS = 4096,    // shared by all locks, like the table of BRAVO
+    MAX_FAST_READS = 16     // fast path reads one thread may hold at once
+};
+
+/// The visible readers: a slot holds the lock its reader is reading.
+std::atomic<BiasedMutexRW*> readerSlots[READER_SLOTS];
+
+/// The fast path reads of the calling thread, so unlock() can tell them
+/// from reads and writes on the underlying MutexRW.
+struct FastReads
+{
+    const BiasedMutexRW* locks[MAX_FAST_READS];
+    int                  slots[MAX_FAST_READS];
+    int                  count;
+    unsigned int         slowReads;
+};
+
+#if defined(__GNUC__)
+// a fixed offset from the thread pointer, without a call to __tls_get_addr
+// when built into a shared library
+#define PIL_TLS_INITIAL_EXEC __attribute__((tls_model("initial-exec")))
+#else
+#define PIL_TLS_INITIAL_EXEC
+#endif
+
+thread_local FastReads fastReads PIL_TLS_INITIAL_EXEC;
+
+
+inline int64_t nowNS()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+inline int readerSlot(const BiasedMutexRW* lock)
+{
+    // the address of a thread local identifies the thread
+    uint64_t h = (uint64_t) (uintptr_t) &fastReads * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t) (uintptr_t) lock;
+    h *= 0xC2B2AE3D27D4EB4Full;
+    return (int) (h >> 52) & (READER_SLOTS - 1);
+}
+
+} // namespace
+
+
+BiasedMutexRW::BiasedMutexRW(): _readBias(true), _inhibitUntil(0)
+{
+}
+
+
+bool BiasedMutexRW::fastReadLock()
+{
+    FastReads& reads = fastReads;
+    if (reads.count >= MAX_FAST_READS) return false;
+
+    int            slot     = readerSlot(this);
+    BiasedMutexRW* expected = 0;
+    if (!readerSlots[slot].compare_exchange_strong(expected, this, std::memory_order_seq_cst))
+        return false;
+
+    // pairs with the store of revokeBias(): either the writer sees our
+    // slot or we see the bias gone
+    if (!_readBias.load(std::memory_order_seq_cst))
+    {
+        readerSlots[slot].store(0, std::memory_order_release);
+        return false;
+    }
+
+    reads.locks[reads.count] = this;
+    reads.slots[reads.count] = slot;
+    reads.count++;
+    return true;
+}
+
+
+void BiasedMutexRW::slowReadLocked()
+{
+    // holding the read lock, no writer can be revoking right now; the
+    // clock is only looked at every few slow reads, it costs more than
+    // the read itself
+    if (!_readBias.load(std::memory_order_relaxed) &&
+        (fastReads.slowReads++ & 15) == 0 &&
+        nowNS() >= _inhibitUntil.load(std::memory_order_relaxed))
+    {
+        _readBias.store(true, std::memory_order_seq_cst);
+    }
+}
+
+
+bool BiasedMutexRW::revokeBias(bool wait)
+{
+    int64_t start = nowNS();
+    _readBias.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    for (int i = 0; i < READER_SLOTS; i++)
+    {
+        if (readerSlots[i].load(std::memory_order_relaxed) != this) continue;
+        if (!wait)
+        {
+            _readBias.store(true, std::memory_order_seq_cst);
+            return false;
+        }
+        SpinBackoff backoff;
+        while (readerSlots[i].load(std::memory_order_acquire) == this) backoff.pause();
+    }
+
+    int64_t end = nowNS();
+    _inhibitUntil.store(end + (end - start) * INHIBIT_MULTIPLIER, std::memory_order_relaxed);
+    return true;
+}
+
+
+void BiasedMutexRW::readLock()
+{
+    if (_readBias.load(std::memory_order_acquire) && fastReadLock()) return;
+
+    _rw.readLock();
+    slowReadLocked();
+}
+
+
+bool BiasedMutexRW::tryReadLock()
+{
+    if (_readBias.load(std::memory_order_acquire) && fastReadLock()) return true;
+
+    if (!_rw.tryReadLock()) return false;
+    slowReadLocked();
+    return true;
+}
+
+
+void BiasedMutexRW::writeLock()
+{
+    _rw.writeLock();
+    if (_readBias.load(std::memory_order_relaxed)) revokeBias(true);
+}
+
+
+bool BiasedMutexRW::tryWriteLock()
+{
+    if (!_rw.tryWriteLock()) return false;
+    if (_readBias.load(std::memory_order_relaxed) && !revokeBias(false))
+    {
+        _rw.unlock();
+        return false;
+    }
+    return true;
+}
+
+
+void BiasedMutexRW::unlock()
+{
+    FastReads& reads = fastReads;
+    for (int i = reads.count - 1; i >= 0; i--)
+    {
+        if (reads.locks[i] != this) continue;
+
+        readerSlots[reads.slots[i]].store(0, std::memory_order_release);
+        reads.count--;
+        reads.locks[i] = reads.locks[reads.count];
+        reads.slots[i] = reads.slots[reads.count];
+        return;
+    }
+    _rw.unlock();
+}
+
+
+} // namespace pi
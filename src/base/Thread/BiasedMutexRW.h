@@ -0,0 +1,92 @@
+#ifndef PIL_BiasedMutexRW_INCLUDED
+#define PIL_BiasedMutexRW_INCLUDED
+
+#include <atomic>
+
+#include "../Environment.h"
+#include "MutexRW.h"
+#include "ScopedLock.h"
+
+
+namespace pi {
+
+
+class PIL_API BiasedMutexRW
+    /// A reader-biased reader writer lock after BRAVO (Dice and Kogan,
+    /// "BRAVO - Biased Locking for Reader-Writer Locks").
+    ///
+    /// A MutexRW keeps its reader count in one word, so every readLock()
+    /// and unlock() moves that cache line between the cores, and read
+    /// mostly data does not scale beyond a few threads. While the lock is
+    /// read biased, a reader instead publishes itself in a process wide
+    /// table of reader slots, picked by hashing the thread and the lock,
+    /// and never touches the shared word. A writer takes the underlying
+    /// MutexRW, revokes the bias and waits until the slots of this lock
+    /// drained. Since the revocation scans the whole table, the bias
+    /// stays off for a multiple of the scan time afterwards, which keeps
+    /// write heavy workloads at the speed of a plain MutexRW.
+    ///
+    /// The interface is that of MutexRW, so the lock works with the
+    /// ReadLock, WriteLock and ScopedRWLock classes. Reads may be nested,
+    /// writes may not.
+{
+public:
+    typedef pi::ReadLock<BiasedMutexRW>     ScopedReadLock;
+    typedef pi::WriteLock<BiasedMutexRW>    ScopedWriteLock;
+
+    enum
+    {
+        INHIBIT_MULTIPLIER = 9  /// the bias stays off this many revocation times
+    };
+
+    BiasedMutexRW();
+        /// Creates the lock, read biased.
+
+    ~BiasedMutexRW() {}
+
+    void lock() { writeLock(); }
+        /// Default is write lock
+
+    void readLock();
+        /// Acquires a read lock. If another thread currently holds a write lock,
+        /// waits until the write lock is released.
+
+    bool tryReadLock();
+        /// Tries to acquire a read lock. Immediately returns true if successful, or
+        /// false if another thread currently holds a write lock.
+
+    void writeLock();
+        /// Acquires a write lock, revoking the read bias. Waits until all
+        /// readers are gone.
+
+    bool tryWriteLock();
+        /// Tries to acquire a write lock. Returns false immediately if
+        /// another thread holds a read or write lock.
+
+    void unlock();
+        /// Releases the read or write lock of the calling thread.
+
+    bool readBiased() const
+        /// Returns true if readers currently take the fast path.
+    {
+        return _readBias.load(std::memory_order_relaxed);
+    }
+
+private:
+    BiasedMutexRW(const BiasedMutexRW&);
+    BiasedMutexRW& operator = (const BiasedMutexRW&);
+
+    bool fastReadLock();
+    void slowReadLocked();
+    bool revokeBias(bool wait);
+
+    MutexRW             _rw;
+    std::atomic<bool>   _readBias;
+    std::atomic<int64_t> _inhibitUntil;  // steady clock, in ns
+};
+
+
+} // namespace pi
+
+
+#endif // PIL_BiasedMutexRW_INCLUDED
@@ -0,0 +1,233 @@
+#include "Epoch.h"
+#include "Mutex.h"
+#include "SpinLock.h"
+#include "../Debug/Exception.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+
+namespace pi {
+
+
+namespace {
+
+enum
+{
+    RECLAIM_INTERVAL = 64   // retire() tries to reclaim every this many objects
+};
+
+struct Retired
+{
+    void*          p;
+    Epoch::Deleter deleter;
+    uint64_t       epoch;
+};
+
+/// The state of one thread. Records are never freed; the record of an
+/// exited thread is taken over by the next new thread.
+struct EpochRecord
+{
+    std::atomic<uint64_t> state;    // epoch << 1 | inside a read section
+    char                  pad[64];  // keeps the states of two threads apart
+
+    std::atomic<bool>     inUse;
+    EpochRecord*          next;
+    int                   depth;
+    std::vector<Retired>  retired;
+    unsigned int          sinceReclaim;
+};
+
+std::atomic<uint64_t>     globalEpoch(2);
+std::atomic<EpochRecord*> records((EpochRecord*) 0);
+
+FastMutex                 orphanMutex;
+std::vector<Retired>      orphans;  // objects of exited threads
+
+
+EpochRecord* acquireRecord()
+{
+    for (EpochRecord* r = records.load(std::memory_order_acquire); r; r = r->next)
+    {
+        bool expected = false;
+        if (!r->inUse.load(std::memory_order_relaxed) &&
+            r->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return r;
+    }
+
+    EpochRecord* r = new EpochRecord;
+    r->state.store(0, std::memory_order_relaxed);
+    r->inUse.store(true, std::memory_order_relaxed);
+    r->depth        = 0;
+    r->sinceReclaim = 0;
+
+    EpochRecord* head = records.load(std::memory_order_relaxed);
+    do
+    {
+        r->next = head;
+    } while (!records.compare_exchange_weak(head, r, std::memory_order_release,
+                                            std::memory_order_relaxed));
+    return r;
+}
+
+
+/// Hands the record of a thread back when the thread exits.
+struct EpochThread
+{
+    EpochRecord* record;
+
+    EpochRecord* get()
+    {
+        if (!record) record = acquireRecord();
+        return record;
+    }
+
+    ~EpochThread()
+    {
+        if (!record) return;
+        if (!record->retired.empty())
+        {
+            FastMutex::ScopedLock lock(orphanMutex);
+            orphans.insert(orphans.end(), record->retired.begin(), record->retired.end());
+            record->retired.clear();
+        }
+        record->state.store(0, std::memory_order_release);
+        record->inUse.store(false, std::memory_order_release);
+    }
+};
+
+thread_local EpochThread epochThread;
+
+
+/// Advances the global epoch if every thread inside a read section has
+/// seen the current one.
+bool tryAdvance()
+{
+    uint64_t epoch = globalEpoch.load(std::memory_order_relaxed);
+
+    // pairs with the exchange of enter()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (EpochRecord* r = records.load(std::memory_order_acquire); r; r = r->next)
+    {
+        uint64_t state = r->state.load(std::memory_order_relaxed);
+        if ((state & 1) && (state >> 1) != epoch) return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return globalEpoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+}
+
+
+/// Deletes the objects of list retired two epochs or more before epoch.
+void reclaimList(std::vector<Retired>& list, uint64_t epoch)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        if (list[i].epoch + 2 <= epoch)
+            list[i].deleter(list[i].p);
+        else
+            list[kept++] = list[i];
+    }
+    list.resize(kept);
+}
+
+
+void reclaimAll(EpochRecord* record)
+{
+    uint64_t epoch = globalEpoch.load(std::memory_order_acquire);
+    reclaimList(record->retired, epoch);
+
+    if (orphanMutex.tryLock())
+    {
+        reclaimList(orphans, epoch);
+        orphanMutex.unlock();
+    }
+}
+
+} // namespace
+
+
+void Epoch::enter()
+{
+    EpochRecord* r = epochThread.get();
+    if (r->depth++) return;
+
+    uint64_t epoch = globalEpoch.load(std::memory_order_relaxed);
+
+    // the state must be visible before the reads of the section; an
+    // exchange is a cheaper full barrier than a store and a fence on x86
+    r->state.exchange(epoch << 1 | 1, std::memory_order_seq_cst);
+}
+
+
+void Epoch::leave()
+{
+    EpochRecord* r = epochThread.get();
+    if (--r->depth) return;
+
+    r->state.store(0, std::memory_order_release);
+}
+
+
+bool Epoch::inside()
+{
+    return epochThread.get()->depth > 0;
+}
+
+
+void Epoch::retire(void* p, Deleter deleter)
+{
+    if (!p) return;
+
+    EpochRecord* r = epochThread.get();
+    Retired      item = { p, deleter, globalEpoch.load(std::memory_order_acquire) };
+    r->retired.push_back(item);
+
+    if (++r->sinceReclaim >= RECLAIM_INTERVAL)
+    {
+        r->sinceReclaim = 0;
+        tryAdvance();
+        reclaimAll(r);
+    }
+}
+
+
+void Epoch::synchronize()
+{
+    EpochRecord* r = epochThread.get();
+    if (r->depth)
+        throw IllegalStateException("Epoch::synchronize() inside a read section");
+
+    uint64_t    target = globalEpoch.load(std::memory_order_acquire) + 2;
+    SpinBackoff backoff;
+    while (globalEpoch.load(std::memory_order_acquire) < target)
+    {
+        if (!tryAdvance()) backoff.pause();
+    }
+    reclaimAll(r);
+}
+
+
+bool Epoch::reclaim()
+{
+    bool advanced = tryAdvance();
+    reclaimAll(epochThread.get());
+    return advanced;
+}
+
+
+size_t Epoch::pending()
+{
+    return epochThread.get()->retired.size();
+}
+
+
+unsigned long long Epoch::current()
+{
+    return globalEpoch.load(std::memory_order_relaxed);
+}
+
+
+} // namespace pi
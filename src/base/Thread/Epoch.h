@@ -0,0 +1,106 @@
+#ifndef PIL_Epoch_INCLUDED
+#define PIL_Epoch_INCLUDED
+
+#include <cstddef>
+
+#include "../Environment.h"
+
+
+namespace pi {
+
+
+class PIL_API Epoch
+    /// Epoch based memory reclamation (EBR, Fraser 2004).
+    ///
+    /// Readers of a shared, lock-free data structure enclose their
+    /// accesses in a read section (an Epoch::Guard). A writer which
+    /// unlinked an object hands it to retire() instead of deleting it;
+    /// the object is deleted once every read section which might still
+    /// see it has ended. Entering and leaving a read section costs a
+    /// store and a fence on a thread private cache line, so readers are
+    /// wait-free and scale with the number of cores.
+    ///
+    /// The global epoch advances when all threads inside a read section
+    /// have observed it, and an object retired in epoch e is deleted in
+    /// epoch e+2. A thread which stays inside a read section holds back
+    /// the reclamation of all threads, so keep the sections short and
+    /// never block in them. Read sections nest.
+    ///
+    ///     struct Node { int value; std::atomic<Node*> next; };
+    ///
+    ///     {
+    ///         Epoch::Guard guard;                 // reader
+    ///         Node* n = head.load(std::memory_order_acquire);
+    ///         use(n->value);
+    ///     }
+    ///
+    ///     Node* old = head.exchange(newHead);     // writer
+    ///     Epoch::retire(old);
+{
+public:
+    class Guard
+        /// A read section from construction to destruction.
+    {
+    public:
+        Guard()  { Epoch::enter(); }
+        ~Guard() { Epoch::leave(); }
+
+    private:
+        Guard(const Guard&);
+        Guard& operator = (const Guard&);
+    };
+
+    typedef void (*Deleter)(void* p);
+
+    static void enter();
+        /// Starts a read section of the calling thread.
+
+    static void leave();
+        /// Ends the read section started by the matching enter().
+
+    static bool inside();
+        /// Returns true if the calling thread is inside a read section.
+
+    static void retire(void* p, Deleter deleter);
+        /// Deletes p with deleter once no read section can access it any
+        /// more. May reclaim objects retired earlier.
+
+    template <class T>
+    static void retire(T* p)
+        /// Retires an object allocated with new.
+    {
+        retire((void*) p, &deleteObject<T>);
+    }
+
+    static void synchronize();
+        /// Waits until all read sections active at the time of the call
+        /// have ended, then deletes the objects the calling thread has
+        /// retired. Must not be called inside a read section.
+
+    static bool reclaim();
+        /// Tries to advance the epoch and deletes the objects of the
+        /// calling thread (and of exited threads) which became safe.
+        /// Returns true if the epoch advanced.
+
+    static size_t pending();
+        /// Returns the number of objects the calling thread has retired
+        /// which are not deleted yet.
+
+    static unsigned long long current();
+        /// Returns the global epoch.
+
+private:
+    Epoch();
+
+    template <class T>
+    static void deleteObject(void* p)
+    {
+        delete (T*) p;
+    }
+};
+
+
+} // namespace pi
+
+
+#endif // PIL_Epoch_INCLUDED
@@ -0,0 +1,168 @@
+#include "HazardPointer.h"
+#include "Mutex.h"
+
+#include <algorithm>
+#include <vector>
+
+
+namespace pi {
+
+
+struct HazardPointer::Slot
+{
+    std::atomic<const void*> pointer;
+    char                     pad[64];   // keeps the pointers of two threads apart
+    std::atomic<bool>        inUse;
+    Slot*                    next;
+};
+
+
+namespace {
+
+enum
+{
+    RECLAIM_MINIMUM = 64    // retire() scans when this many objects and
+                            // twice the number of slots are pending
+};
+
+struct Retired
+{
+    void*                  p;
+    HazardPointer::Deleter deleter;
+};
+
+/// The slots are never freed, a released slot is taken by the next
+/// HazardPointer.
+std::atomic<HazardPointer::Slot*> slots((HazardPointer::Slot*) 0);
+std::atomic<int>                  slotCount(0);
+
+FastMutex                         orphanMutex;
+std::vector<Retired>              orphans;  // objects of exited threads
+
+
+/// The objects a thread retired, handed over when it exits.
+struct HazardThread
+{
+    std::vector<Retired> retired;
+
+    ~HazardThread()
+    {
+        if (retired.empty()) return;
+        FastMutex::ScopedLock lock(orphanMutex);
+        orphans.insert(orphans.end(), retired.begin(), retired.end());
+    }
+};
+
+thread_local HazardThread hazardThread;
+
+
+/// Deletes the objects of list which no slot announces.
+void scan(std::vector<Retired>& list)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    std::vector<const void*> hazards;
+    for (HazardPointer::Slot* s = slots.load(std::memory_order_acquire); s; s = s->next)
+    {
+        const void* p = s->pointer.load(std::memory_order_relaxed);
+        if (p) hazards.push_back(p);
+    }
+    std::sort(hazards.begin(), hazards.end());
+
+    size_t kept = 0;
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        if (std::binary_search(hazards.begin(), hazards.end(), (const void*) list[i].p))
+            list[kept++] = list[i];
+        else
+            list[i].deleter(list[i].p);
+    }
+    list.resize(kept);
+}
+
+} // namespace
+
+
+HazardPointer::HazardPointer()
+{
+    for (Slot* s = slots.load(std::memory_order_acquire); s; s = s->next)
+    {
+        bool expected = false;
+        if (!s->inUse.load(std::memory_order_relaxed) &&
+            s->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            _slot = s;
+            return;
+        }
+    }
+
+    _slot = new Slot;
+    _slot->pointer.store(0, std::memory_order_relaxed);
+    _slot->inUse.store(true, std::memory_order_relaxed);
+
+    Slot* head = slots.load(std::memory_order_relaxed);
+    do
+    {
+        _slot->next = head;
+    } while (!slots.compare_exchange_weak(head, _slot, std::memory_order_release,
+                                          std::memory_order_relaxed));
+    slotCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+HazardPointer::~HazardPointer()
+{
+    _slot->pointer.store(0, std::memory_order_release);
+    _slot->inUse.store(false, std::memory_order_release);
+}
+
+
+void HazardPointer::set(const void* p)
+{
+    _slot->pointer.store(p, std::memory_order_relaxed);
+
+    // the announcement must be visible before the caller checks that p
+    // is still reachable
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+
+void HazardPointer::reset()
+{
+    _slot->pointer.store(0, std::memory_order_release);
+}
+
+
+void HazardPointer::retire(void* p, Deleter deleter)
+{
+    if (!p) return;
+
+    std::vector<Retired>& retired = hazardThread.retired;
+    Retired item = { p, deleter };
+    retired.push_back(item);
+
+    size_t threshold = std::max((size_t) RECLAIM_MINIMUM,
+                                (size_t) slotCount.load(std::memory_order_relaxed) * 2);
+    if (retired.size() >= threshold) reclaim();
+}
+
+
+void HazardPointer::reclaim()
+{
+    scan(hazardThread.retired);
+
+    if (orphanMutex.tryLock())
+    {
+        scan(orphans);
+        orphanMutex.unlock();
+    }
+}
+
+
+size_t HazardPointer::pending()
+{
+    return hazardThread.retired.size();
+}
+
+
+} // namespace pi
@@ -0,0 +1,102 @@
+#ifndef PIL_HazardPointer_INCLUDED
+#define PIL_HazardPointer_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+
+#include "../Environment.h"
+
+
+namespace pi {
+
+
+class PIL_API HazardPointer
+    /// Hazard pointer based memory reclamation (Michael 2004).
+    ///
+    /// A HazardPointer owns a slot that announces the object its thread
+    /// is about to access. Objects handed to retire() are only deleted
+    /// when no slot points to them. Unlike the read sections of Epoch, a
+    /// stalled reader protects only the objects it announced, so the
+    /// memory held back is bounded; the price is a fence per protected
+    /// pointer instead of one per read section.
+    ///
+    ///     HazardPointer hp;
+    ///     Node* n = hp.protect(head);     // n stays valid until reset()
+    ///     use(n->value);
+    ///     hp.reset();
+    ///
+    ///     Node* old = head.exchange(newHead);
+    ///     HazardPointer::retire(old);
+    ///
+    /// A HazardPointer must be used by one thread at a time. The slots are
+    /// recycled, so creating one on the stack is cheap.
+{
+public:
+    typedef void (*Deleter)(void* p);
+
+    struct Slot;
+
+    HazardPointer();
+        /// Acquires a free slot.
+
+    ~HazardPointer();
+        /// Clears the slot and releases it.
+
+    template <class T>
+    T* protect(const std::atomic<T*>& src)
+        /// Loads src and protects the result; loops until the pointer
+        /// announced is still the one in src.
+    {
+        T* p = src.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            set(p);
+            T* q = src.load(std::memory_order_acquire);
+            if (q == p) return p;
+            p = q;
+        }
+    }
+
+    void set(const void* p);
+        /// Announces p. The caller has to check that p is still reachable
+        /// afterwards, as protect() does.
+
+    void reset();
+        /// Clears the slot, the object may be deleted from now on.
+
+    static void retire(void* p, Deleter deleter);
+        /// Deletes p with deleter once no hazard pointer announces it.
+
+    template <class T>
+    static void retire(T* p)
+        /// Retires an object allocated with new.
+    {
+        retire((void*) p, &deleteObject<T>);
+    }
+
+    static void reclaim();
+        /// Deletes the objects retired by the calling thread (and by exited
+        /// threads) which are not protected any more.
+
+    static size_t pending();
+        /// Returns the number of objects the calling thread has retired
+        /// which are not deleted yet.
+
+private:
+    HazardPointer(const HazardPointer&);
+    HazardPointer& operator = (const HazardPointer&);
+
+    template <class T>
+    static void deleteObject(void* p)
+    {
+        delete (T*) p;
+    }
+
+    Slot* _slot;
+};
+
+
+} // namespace pi
+
+
+#endif // PIL_HazardPointer_INCLUDED
@@ -0,0 +1,125 @@
+#ifndef PIL_MPSCQueue_INCLUDED
+#define PIL_MPSCQueue_INCLUDED
+
+#include <stddef.h>
+#include <atomic>
+
+#include "../Environment.h"
+
+
+namespace pi {
+
+
+template <class T>
+class MPSCQueue
+    /// An unbounded queue which any number of threads push to without
+    /// locks, drained by a single consumer thread.
+    ///
+    /// push() links a new node in front of a list with one compare and
+    /// swap. consume() takes the whole list with one exchange, restores
+    /// the order of the pushes and hands the items to a functor. Since
+    /// producers never look at a node after pushing it and the consumer
+    /// only takes complete lists, there is no ABA problem and nodes are
+    /// deleted right away. Items pushed by one thread are consumed in the
+    /// order they were pushed.
+    ///
+    ///     MPSCQueue<Command> commands;
+    ///     commands.push(c);                               // any thread
+    ///     commands.consume([&](Command& c) { run(c); });  // consumer thread
+{
+public:
+    MPSCQueue(): _head(0)
+    {
+    }
+
+    ~MPSCQueue()
+    {
+        release(_head.exchange(0, std::memory_order_acquire));
+    }
+
+    void push(const T& value)
+        /// Appends a copy of value. Lock-free; allocates one node.
+    {
+        Node* node = new Node(value);
+        Node* head = _head.load(std::memory_order_relaxed);
+        do
+        {
+            node->next = head;
+        }
+        while (!_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    template <class F>
+    size_t consume(F func)
+        /// Calls func(T&) for every item pushed so far, oldest first, and
+        /// returns their number. Items pushed meanwhile are left for the
+        /// next call. If func throws, the remaining items of the batch are
+        /// dropped.
+    {
+        Node* node = _head.exchange(0, std::memory_order_acquire);
+
+        // the list is newest first
+        Node* first = 0;
+        while (node)
+        {
+            Node* next = node->next;
+            node->next = first;
+            first = node;
+            node = next;
+        }
+
+        size_t n = 0;
+        try
+        {
+            for (; first; n++)
+            {
+                Node* next = first->next;
+                func(first->value);
+                delete first;
+                first = next;
+            }
+        }
+        catch (...)
+        {
+            release(first);
+            throw;
+        }
+        return n;
+    }
+
+    bool empty() const
+        /// A hint only while producers are pushing.
+    {
+        return _head.load(std::memory_order_relaxed) == 0;
+    }
+
+private:
+    MPSCQueue(const MPSCQueue&);
+    MPSCQueue& operator = (const MPSCQueue&);
+
+    struct Node
+    {
+        Node(const T& v): value(v), next(0) {}
+
+        T     value;
+        Node* next;
+    };
+
+    static void release(Node* node)
+    {
+        while (node)
+        {
+            Node* next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    std::atomic<Node*> _head;
+};
+
+
+} // namespace pi
+
+
+#endif // PIL_MPSCQueue_INCLUDED
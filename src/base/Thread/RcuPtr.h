@@ -0,0 +1,146 @@
+#ifndef PIL_RcuPtr_INCLUDED
+#define PIL_RcuPtr_INCLUDED
+
+#include <atomic>
+
+#include "../Environment.h"
+#include "Epoch.h"
+#include "Mutex.h"
+
+
+namespace pi {
+
+
+template <class T>
+class RcuPtr
+    /// Read-copy-update for read mostly shared state, such as settings,
+    /// maps or poses shared between threads.
+    ///
+    /// Readers get the current version without a lock and without
+    /// touching a reference count: read() only starts an Epoch read
+    /// section, which is wait-free and stays on the cache line of the
+    /// reading thread. Writers publish a complete new version; the old
+    /// one is deleted when the last reader which may see it is done.
+    /// Writers are serialized with a FastMutex.
+    ///
+    ///     RcuPtr<Config> config(new Config);
+    ///
+    ///     {
+    ///         RcuPtr<Config>::ReadPtr c = config.read();     // reader
+    ///         use(c->value);
+    ///     }
+    ///
+    ///     config.update([](Config& c) { c.value = 1; });   // writer
+    ///
+    /// A ReadPtr must not outlive the read section of its thread; do not
+    /// keep it across blocking calls, it delays the reclamation of all
+    /// objects retired through Epoch.
+{
+public:
+    class ReadPtr
+        /// A version of the value, valid while the ReadPtr exists.
+    {
+    public:
+        ReadPtr(const ReadPtr& other): _p(other._p)
+        {
+            Epoch::enter();
+        }
+
+        ~ReadPtr()
+        {
+            Epoch::leave();
+        }
+
+        const T* get() const        { return _p; }
+        const T* operator -> () const { return _p; }
+        const T& operator * () const  { return *_p; }
+        operator bool () const      { return _p != 0; }
+
+    private:
+        friend class RcuPtr;
+
+        explicit ReadPtr(const std::atomic<T*>& src)
+        {
+            Epoch::enter();
+            _p = src.load(std::memory_order_acquire);
+        }
+
+        ReadPtr& operator = (const ReadPtr&);
+
+        const T* _p;
+    };
+
+    explicit RcuPtr(T* value = 0): _p(value)
+        /// Takes ownership of value.
+    {
+    }
+
+    ~RcuPtr()
+        /// Deletes the current version. Readers must be done.
+    {
+        delete _p.load(std::memory_order_relaxed);
+    }
+
+    ReadPtr read() const
+        /// Returns the current version.
+    {
+        return ReadPtr(_p);
+    }
+
+    T copy() const
+        /// Returns a copy of the current version, which must exist.
+    {
+        ReadPtr p = read();
+        return *p;
+    }
+
+    void store(T* value)
+        /// Publishes value, taking ownership of it, and retires the old
+        /// version.
+    {
+        FastMutex::ScopedLock lock(_writer);
+        Epoch::retire(_p.exchange(value, std::memory_order_acq_rel));
+    }
+
+    template <class F>
+    void update(F func)
+        /// Copies the current version, or default constructs one if there
+        /// is none, calls func(T&) on the copy and publishes it. Concurrent
+        /// updates do not lose each other's changes.
+    {
+        FastMutex::ScopedLock lock(_writer);
+        T* old   = _p.load(std::memory_order_relaxed);
+        T* value = old ? new T(*old) : new T();
+        try
+        {
+            func(*value);
+        }
+        catch (...)
+        {
+            delete value;
+            throw;
+        }
+        _p.store(value, std::memory_order_release);
+        Epoch::retire(old);
+    }
+
+    static void synchronize()
+        /// Waits until the readers of replaced versions are done and
+        /// deletes the versions the calling thread retired.
+    {
+        Epoch::synchronize();
+    }
+
+private:
+    RcuPtr(const RcuPtr&);
+    RcuPtr& operator = (const RcuPtr&);
+
+    std::atomic<T*> _p;
+    FastMutex       _writer;
+};
+
+
+} // namespace pi
+
+
+#endif // PIL_RcuPtr_INCLUDED
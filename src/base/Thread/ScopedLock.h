@@ -87,6 +87,35 @@ private:
     M* m;
 };
 
+template <class M>
+class ScopedRWLock
+    /// A class that simplifies thread synchronization
+    /// with a reader writer lock (MutexRW, BiasedMutexRW).
+    /// The constructor acquires a read lock, or a write lock
+    /// if write is true. The destructor releases it.
+{
+public:
+    ScopedRWLock(M& mutex, bool write = false): _mutex(mutex)
+    {
+        if (write)
+            _mutex.writeLock();
+        else
+            _mutex.readLock();
+    }
+
+    ~ScopedRWLock()
+    {
+        _mutex.unlock();
+    }
+
+private:
+    M& _mutex;
+
+    ScopedRWLock();
+    ScopedRWLock(const ScopedRWLock&);
+    ScopedRWLock& operator = (const ScopedRWLock&);
+};
+
 } // end of namespace pi
 
 #endif // end of SCOPEDLOCK_H
@@ -0,0 +1,122 @@
+#ifndef PIL_SeqLock_INCLUDED
+#define PIL_SeqLock_INCLUDED
+
+#include <string.h>
+#include <atomic>
+
+#include "../Environment.h"
+#include "ScopedLock.h"
+#include "SpinLock.h"
+
+
+namespace pi {
+
+
+template <class T, class M = TicketSpinLock>
+class SeqLock
+    /// A sequence lock publishes a small value to readers which never
+    /// write shared memory: a reader copies the value and retries if the
+    /// sequence number changed meanwhile. Writers are serialized with a
+    /// mutex of type M and make the sequence odd while they write.
+    ///
+    /// Meant for values read far more often than written, like poses,
+    /// timestamps or statistics. T must be trivially copyable, since a
+    /// reader may copy it while it is being written. Readers never block
+    /// writers, so a stream of writes can delay a reader; keep T small.
+    ///
+    ///     SeqLock<Pose> pose;
+    ///     pose.write(p);          // writer thread
+    ///     Pose q = pose.read();   // any number of reader threads
+{
+public:
+    typedef pi::ScopedLock<SeqLock> ScopedLock;
+
+    SeqLock(): _seq(0), _value()
+    {
+    }
+
+    explicit SeqLock(const T& value): _seq(0), _value(value)
+    {
+    }
+
+    T read() const
+        /// Returns a consistent copy of the value.
+    {
+        T result;
+        read(result);
+        return result;
+    }
+
+    void read(T& result) const
+    {
+        SpinBackoff backoff;
+        for (;;)
+        {
+            unsigned int seq = readBegin();
+            memcpy((void*) &result, (const void*) &_value, sizeof(T));
+            if (!readRetry(seq)) return;
+            backoff.pause();
+        }
+    }
+
+    void write(const T& value)
+        /// Replaces the value.
+    {
+        lock();
+        memcpy((void*) &_value, (const void*) &value, sizeof(T));
+        unlock();
+    }
+
+    unsigned int readBegin() const
+        /// Starts a read section and returns the sequence to pass to
+        /// readRetry(). Waits while a writer is active.
+    {
+        unsigned int seq;
+        while ((seq = _seq.load(std::memory_order_acquire)) & 1) SpinBackoff::relax();
+        return seq;
+    }
+
+    bool readRetry(unsigned int seq) const
+        /// Returns true if a writer changed the value since readBegin(),
+        /// in which case what was read must be discarded.
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return _seq.load(std::memory_order_relaxed) != seq;
+    }
+
+    void lock()
+        /// Starts a write section, for writers which update the value in
+        /// place through value().
+    {
+        _writer.lock();
+        _seq.store(_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void unlock()
+        /// Ends a write section.
+    {
+        _seq.store(_seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        _writer.unlock();
+    }
+
+    T& value()
+        /// The value, only to be touched inside a write section.
+    {
+        return _value;
+    }
+
+private:
+    SeqLock(const SeqLock&);
+    SeqLock& operator = (const SeqLock&);
+
+    std::atomic<unsigned int> _seq;
+    M                         _writer;
+    T                         _value;
+};
+
+
+} // namespace pi
+
+
+#endif // PIL_SeqLock_INCLUDED
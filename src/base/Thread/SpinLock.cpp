@@ -0,0 +1,149 @@
+#include "SpinLock.h"
+#include "Thread.h"
+#include "../Debug/Exception.h"
+
+
+namespace pi {
+
+
+//
+// SpinBackoff
+//
+void SpinBackoff::pause()
+{
+    if (_spins <= SPIN_LIMIT)
+    {
+        for (int i = 0; i < _spins; i++) relax();
+        _spins *= 2;
+    }
+    else
+    {
+        Thread::yield();
+    }
+}
+
+
+//
+// TicketSpinLock
+//
+void TicketSpinLock::lock()
+{
+    unsigned int ticket = _next.fetch_add(1, std::memory_order_relaxed);
+    SpinBackoff  backoff;
+
+    for (;;)
+    {
+        unsigned int serving = _serving.load(std::memory_order_acquire);
+        if (serving == ticket) return;
+
+        // far back in the queue the wait is long anyway, give up the CPU
+        // to whoever is ahead of us
+        if (ticket - serving > 4)
+            Thread::yield();
+        else
+            backoff.pause();
+    }
+}
+
+
+bool TicketSpinLock::tryLock()
+{
+    unsigned int serving = _serving.load(std::memory_order_acquire);
+    unsigned int ticket  = serving;
+    return _next.compare_exchange_strong(ticket, serving + 1, std::memory_order_acquire,
+                                         std::memory_order_relaxed);
+}
+
+
+//
+// MCSSpinLock
+//
+namespace {
+
+/// The queue nodes of one thread. A node is in use from lock() until the
+/// matching unlock(), so a thread can hold up to 32 MCS locks at once.
+struct MCSNodePool
+{
+    MCSSpinLock::Node nodes[32];
+    unsigned int      used;
+
+    MCSSpinLock::Node* acquire()
+    {
+        for (int i = 0; i < 32; i++)
+        {
+            if (!(used & (1u << i)))
+            {
+                used |= 1u << i;
+                nodes[i].next.store(0, std::memory_order_relaxed);
+                nodes[i].locked.store(true, std::memory_order_relaxed);
+                return &nodes[i];
+            }
+        }
+        throw IllegalStateException("a thread holds too many MCSSpinLocks");
+    }
+
+    void release(MCSSpinLock::Node* node)
+    {
+        used &= ~(1u << (node - nodes));
+    }
+};
+
+thread_local MCSNodePool mcsPool;
+
+} // namespace
+
+
+void MCSSpinLock::lock()
+{
+    Node* node = mcsPool.acquire();
+    Node* prev = _tail.exchange(node, std::memory_order_acq_rel);
+    if (prev)
+    {
+        prev->next.store(node, std::memory_order_release);
+        SpinBackoff backoff;
+        while (node->locked.load(std::memory_order_acquire)) backoff.pause();
+    }
+    _owner = node;
+}
+
+
+bool MCSSpinLock::tryLock()
+{
+    if (_tail.load(std::memory_order_relaxed)) return false;
+
+    Node* node     = mcsPool.acquire();
+    Node* expected = 0;
+    if (!_tail.compare_exchange_strong(expected, node, std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+    {
+        mcsPool.release(node);
+        return false;
+    }
+    _owner = node;
+    return true;
+}
+
+
+void MCSSpinLock::unlock()
+{
+    Node* node = _owner;
+    Node* next = node->next.load(std::memory_order_acquire);
+    if (!next)
+    {
+        // no known successor: leave the queue unless one is just enqueueing
+        Node* expected = node;
+        if (_tail.compare_exchange_strong(expected, (Node*) 0, std::memory_order_release,
+                                          std::memory_order_relaxed))
+        {
+            mcsPool.release(node);
+            return;
+        }
+        SpinBackoff backoff;
+        while (!(next = node->next.load(std::memory_order_acquire))) backoff.pause();
+    }
+    next->locked.store(false, std::memory_order_release);
+    mcsPool.release(node);
+}
+
+
+} // namespace pi
@@ -0,0 +1,157 @@
+#ifndef PIL_SpinLock_INCLUDED
+#define PIL_SpinLock_INCLUDED
+
+#include <atomic>
+
+#include "../Environment.h"
+#include "ScopedLock.h"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+
+namespace pi {
+
+
+#if defined(_MSC_VER)
+#define PIL_CACHE_ALIGNED __declspec(align(64))
+#else
+#define PIL_CACHE_ALIGNED __attribute__((aligned(64)))
+#endif
+
+
+class PIL_API SpinBackoff
+    /// Adaptive backoff for spin loops. The first waits only execute
+    /// the CPU pause hint, doubling their number every round; once the
+    /// wait exceeds the spin limit the thread yields its time slice, so
+    /// a lock holder which was preempted can run.
+{
+public:
+    enum
+    {
+        SPIN_LIMIT = 64
+    };
+
+    SpinBackoff(): _spins(1)
+    {
+    }
+
+    void pause();
+        /// Waits a little longer than the last time.
+
+    void reset()
+    {
+        _spins = 1;
+    }
+
+    static void relax()
+        /// The CPU pause hint of one spin.
+    {
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield" ::: "memory");
+#endif
+    }
+
+private:
+    int _spins;
+};
+
+
+class PIL_API TicketSpinLock
+    /// A fair spinlock: every locker draws a ticket and waits until it
+    /// is served, so the lock is granted in FIFO order. Waiters back off
+    /// adaptively, and those far back in the queue yield right away.
+    ///
+    /// Spinlocks are only worth it for critical sections of a few
+    /// hundred cycles; use a FastMutex when the holder can block.
+    /// Not recursive. Works with the ScopedLock class.
+{
+public:
+    typedef pi::ScopedLock<TicketSpinLock> ScopedLock;
+
+    TicketSpinLock(): _next(0), _serving(0)
+    {
+    }
+
+    void lock();
+        /// Locks the spinlock, spinning while it is held by another thread.
+
+    bool tryLock();
+        /// Returns true if the spinlock was free and is now held by the
+        /// caller, false immediately otherwise.
+
+    void unlock()
+        /// Unlocks the spinlock, serving the next ticket.
+    {
+        _serving.store(_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool isLocked() const
+    {
+        return _next.load(std::memory_order_relaxed) != _serving.load(std::memory_order_relaxed);
+    }
+
+private:
+    TicketSpinLock(const TicketSpinLock&);
+    TicketSpinLock& operator = (const TicketSpinLock&);
+
+    std::atomic<unsigned int> _next;
+    std::atomic<unsigned int> _serving;
+};
+
+
+class PIL_API MCSSpinLock
+    /// The queue lock of Mellor-Crummey and Scott: every waiter spins on
+    /// a flag in its own queue node, so a handover only touches the cache
+    /// line of the next waiter instead of broadcasting to all of them.
+    /// Scales better than the TicketSpinLock when many cores contend.
+    ///
+    /// The queue nodes come from a per-thread pool, so lock() and unlock()
+    /// take no arguments and the lock works with the ScopedLock class.
+    /// Not recursive.
+{
+public:
+    typedef pi::ScopedLock<MCSSpinLock> ScopedLock;
+
+    struct PIL_CACHE_ALIGNED Node
+    {
+        std::atomic<Node*> next;
+        std::atomic<bool>  locked;
+    };
+
+    MCSSpinLock(): _tail((Node*) 0), _owner(0)
+    {
+    }
+
+    void lock();
+        /// Locks the spinlock, waiting in the queue while it is held by
+        /// another thread.
+
+    bool tryLock();
+        /// Returns true if the spinlock was free and is now held by the
+        /// caller, false immediately otherwise.
+
+    void unlock();
+        /// Unlocks the spinlock, handing it over to the next waiter.
+
+    bool isLocked() const
+    {
+        return _tail.load(std::memory_order_relaxed) != 0;
+    }
+
+private:
+    MCSSpinLock(const MCSSpinLock&);
+    MCSSpinLock& operator = (const MCSSpinLock&);
+
+    std::atomic<Node*> _tail;
+    Node*              _owner;  // only accessed by the holder
+};
+
+
+} // namespace pi
+
+
+#endif // PIL_SpinLock_INCLUDED
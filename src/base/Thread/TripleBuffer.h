@@ -0,0 +1,95 @@
+#ifndef PIL_TripleBuffer_INCLUDED
+#define PIL_TripleBuffer_INCLUDED
+
+#include <atomic>
+
+#include "../Environment.h"
+
+
+namespace pi {
+
+
+template <class T>
+class TripleBuffer
+    /// Hands the latest value from one writer thread to one reader thread
+    /// without either of them ever waiting.
+    ///
+    /// Three slots rotate between the writer, the reader and a middle
+    /// slot holding the most recent value not yet taken. publish() swaps
+    /// the writer's slot with the middle one, update() swaps the reader's
+    /// slot with it if it is newer. Values the reader did not pick up in
+    /// time are overwritten, so this suits states like poses, not streams
+    /// of events. Unlike SeqLock, T may be any copyable type.
+    ///
+    ///     TripleBuffer<SE3f> pose;
+    ///     pose.write(p);              // writer thread
+    ///     SE3f q = pose.read();       // reader thread, the newest value
+{
+public:
+    TripleBuffer(const T& value = T()): _back(0), _front(2), _middle(1)
+    {
+        _slots[0] = _slots[1] = _slots[2] = value;
+    }
+
+    T& back()
+        /// The writer's slot, which holds an older value.
+    {
+        return _slots[_back];
+    }
+
+    void publish()
+        /// Makes the writer's slot the newest value and gives the writer
+        /// another slot.
+    {
+        _back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    void write(const T& value)
+    {
+        _slots[_back] = value;
+        publish();
+    }
+
+    bool update()
+        /// Takes the newest value into the reader's slot. Returns false if
+        /// nothing was published since the last update().
+    {
+        if (!(_middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T& front() const
+        /// The reader's slot, as of the last update().
+    {
+        return _slots[_front];
+    }
+
+    const T& read()
+        /// Updates and returns the reader's slot.
+    {
+        update();
+        return _slots[_front];
+    }
+
+private:
+    TripleBuffer(const TripleBuffer&);
+    TripleBuffer& operator = (const TripleBuffer&);
+
+    enum
+    {
+        INDEX = 3,
+        FRESH = 4   ///< set in _middle while it holds a value the reader has not taken
+    };
+
+    T                _slots[3];
+    int              _back;     ///< only used by the writer
+    int              _front;    ///< only used by the reader
+    std::atomic<int> _middle;
+};
+
+
+} // namespace pi
+
+
+#endif // PIL_TripleBuffer_INCLUDED
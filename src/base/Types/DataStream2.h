@@ -0,0 +1,900 @@
+/*******************************************************************************
+
+  Pilot Intelligence Library
+    http://www.pilotintelligence.com/
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef __RTK_DATASTREAM2_H__
+#define __RTK_DATASTREAM2_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <type_traits>
+#include <utility>
+
+#include "base/Types/ByteOrder.h"
+#include "base/Debug/Exception.h"
+
+namespace pi {
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+///
+/// \brief The DataStreamAllocator class
+///
+/// Supplies the buffers of RDataStream2. The default allocator uses
+/// malloc/free, DataStreamArena serves many short-lived streams from
+/// a few large blocks.
+///
+class DataStreamAllocator
+{
+public:
+    virtual ~DataStreamAllocator() {}
+
+    ///
+    /// \brief allocate a buffer of n bytes, throws OutOfMemoryException on failure
+    ///
+    virtual void* allocate(size_t n) = 0;
+
+    ///
+    /// \brief release a buffer returned by allocate()
+    /// \param p    - buffer
+    /// \param n    - size given to allocate()
+    ///
+    virtual void deallocate(void* p, size_t n) = 0;
+
+    ///
+    /// \brief the default, heap based allocator
+    ///
+    static DataStreamAllocator* heap();
+};
+
+
+///
+/// \brief The DataStreamArena class
+///
+/// A bump allocator: allocations are carved from blocks of blockSize
+/// bytes and only released all at once by reset() or the destructor.
+/// Freeing the most recent allocation returns its bytes to the arena.
+///
+/// \note Not thread-safe, use one arena per thread.
+///
+class DataStreamArena : public DataStreamAllocator
+{
+public:
+    DataStreamArena(size_t blockSize = 64*1024)
+        : m_blockSize(blockSize), m_current(0), m_last(NULL) {}
+
+    ~DataStreamArena() {
+        for(size_t i=0; i<m_blocks.size(); i++) free(m_blocks[i].data);
+    }
+
+    void* allocate(size_t n) {
+        n = (n + 15) & ~(size_t) 15;
+
+        while( m_current < m_blocks.size() ) {
+            Block& b = m_blocks[m_current];
+            if( b.used + n <= b.size ) {
+                m_last = b.data + b.used;
+                b.used += n;
+                return m_last;
+            }
+            m_current++;
+        }
+
+        Block b;
+        b.size = n > m_blockSize ? n : m_blockSize;
+        b.used = n;
+        b.data = (uint8_t*) malloc(b.size);
+        if( b.data == NULL ) throw OutOfMemoryException("DataStreamArena");
+        m_blocks.push_back(b);
+        m_current = m_blocks.size() - 1;
+        m_last = b.data;
+        return m_last;
+    }
+
+    void deallocate(void* p, size_t n) {
+        if( p == NULL || p != m_last ) return;
+
+        n = (n + 15) & ~(size_t) 15;
+        m_blocks[m_current].used -= n;
+        m_last = NULL;
+    }
+
+    ///
+    /// \brief release all allocations, keeping the blocks for reuse
+    ///
+    void reset(void) {
+        for(size_t i=0; i<m_blocks.size(); i++) m_blocks[i].used = 0;
+        m_current = 0;
+        m_last = NULL;
+    }
+
+    ///
+    /// \brief bytes handed out since the last reset()
+    ///
+    size_t bytesUsed(void) const {
+        size_t n = 0;
+        for(size_t i=0; i<m_blocks.size(); i++) n += m_blocks[i].used;
+        return n;
+    }
+
+    ///
+    /// \brief bytes held by the arena's blocks
+    ///
+    size_t bytesReserved(void) const {
+        size_t n = 0;
+        for(size_t i=0; i<m_blocks.size(); i++) n += m_blocks[i].size;
+        return n;
+    }
+
+private:
+    DataStreamArena(const DataStreamArena&);
+    DataStreamArena& operator = (const DataStreamArena&);
+
+    struct Block
+    {
+        uint8_t*    data;
+        size_t      size;
+        size_t      used;
+    };
+
+    std::vector<Block>      m_blocks;
+    size_t                  m_blockSize;
+    size_t                  m_current;                  ///< block serving allocations
+    void*                   m_last;                     ///< most recent allocation
+};
+
+
+class DataStreamHeapAllocator : public DataStreamAllocator
+{
+public:
+    void* allocate(size_t n) {
+        void* p = malloc(n);
+        if( p == NULL ) throw OutOfMemoryException("RDataStream2");
+        return p;
+    }
+
+    void deallocate(void* p, size_t) {
+        free(p);
+    }
+};
+
+inline DataStreamAllocator* DataStreamAllocator::heap()
+{
+    static DataStreamHeapAllocator allocator;
+    return &allocator;
+}
+
+
+///
+/// \brief The DataSpan struct
+///
+/// A read-only view into the buffer of an RDataStream2, valid as long
+/// as the buffer is neither modified nor released.
+///
+struct DataSpan
+{
+    DataSpan() : data(NULL), size(0) {}
+    DataSpan(const uint8_t* d, uint32_t s) : data(d), size(s) {}
+
+    std::string toString(void) const {
+        return std::string((const char*) data, size);
+    }
+
+    bool operator == (const std::string& s) const {
+        return s.size() == size && (size == 0 || memcmp(s.data(), data, size) == 0);
+    }
+
+    const uint8_t*          data;
+    uint32_t                size;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+/// unsigned integer type with the size of a primitive value
+template <int N> struct DataStreamBits;
+template <> struct DataStreamBits<1> { typedef uint8_t  Type; };
+template <> struct DataStreamBits<2> { typedef uint16_t Type; };
+template <> struct DataStreamBits<4> { typedef uint32_t Type; };
+template <> struct DataStreamBits<8> { typedef uint64_t Type; };
+
+///
+/// \brief The RDataStream2 class
+///
+/// Successor of RDataStream with a defined wire format:
+///     - the 8 byte header (magic/version word, total size) and all
+///       values are stored little-endian, floating point values as
+///       their IEEE 754 bit pattern
+///     - strings are a uint32 length followed by the bytes, without
+///       the terminating NUL RDataStream writes
+///     - nested streams are embedded with their own header
+///
+/// Arrays and vectors of arithmetic types other than bool are copied
+/// with a single memcpy on little-endian hosts; vectors of other types,
+/// such as strings, bools or structs, are written element by element, so
+/// no padding reaches the stream. A struct takes part by providing
+/// int write(RDataStream2&) const and int read(RDataStream2&). The size word of the header is written by
+/// data() or finalize() instead of on every write.
+///
+/// A stream either owns its buffer, obtained from a DataStreamAllocator,
+/// or is a read-only view of external memory. Reading strings as
+/// DataSpan and nested streams as views does not copy any data.
+///
+/// Reading past the end returns -1 and leaves the position unchanged.
+/// Modifying a read-only view throws an IllegalStateException.
+///
+/// \note Strings are not compatible with the RDataStream encoding.
+///
+class RDataStream2
+{
+public:
+    enum
+    {
+        HEADER_SIZE     = 2*sizeof(uint32_t),
+        INITIAL_SIZE    = 256
+    };
+
+    ///
+    /// \brief types whose arrays are copied as bytes
+    ///
+    template <class T>
+    struct isBulk
+    {
+        enum { value = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value };
+    };
+
+    ///
+    /// \brief RDataStream2 - empty stream, the buffer is allocated on the first write
+    /// \param alloc    - allocator, NULL for the heap
+    ///
+    RDataStream2(DataStreamAllocator* alloc = NULL) {
+        init(alloc);
+    }
+
+    ///
+    /// \brief RDataStream2 - empty stream with n bytes reserved
+    ///
+    explicit RDataStream2(uint32_t n, DataStreamAllocator* alloc = NULL) {
+        init(alloc);
+        reserve(n);
+    }
+
+    ///
+    /// \brief RDataStream2 - read-only view of raw data (no copy)
+    /// \param d    - stream data, including the header
+    /// \param l    - data size
+    ///
+    RDataStream2(const uint8_t* d, uint32_t l) {
+        init(NULL);
+        setView(d, l);
+    }
+
+    ///
+    /// \brief RDataStream2 - read-only view of a span (no copy)
+    ///
+    explicit RDataStream2(const DataSpan& s) {
+        init(NULL);
+        setView(s.data, s.size);
+    }
+
+    ///
+    /// \brief copy constructor, views stay views, owned data is copied
+    ///
+    RDataStream2(const RDataStream2& s) {
+        init(s.m_alloc);
+        assign(s);
+    }
+
+    ~RDataStream2() {
+        release();
+    }
+
+    RDataStream2& operator = (const RDataStream2& s) {
+        if( this != &s ) assign(s);
+        return *this;
+    }
+
+    ///
+    /// \brief discard the contents, keeping the buffer
+    ///
+    void clear(void) {
+        checkWritable();
+
+        m_size = HEADER_SIZE;
+        m_idx  = HEADER_SIZE;
+    }
+
+    ///
+    /// \brief make sure n bytes fit without reallocation
+    ///
+    void reserve(uint32_t n) {
+        checkWritable();
+
+        if( n > m_sizeReserved ) grow(n);
+    }
+
+    ///
+    /// \brief copy raw data into the stream
+    /// \param d    - stream data, including the header
+    /// \param l    - data size
+    ///
+    RDataStream2& fromRawData(const uint8_t* d, uint32_t l) {
+        if( l < HEADER_SIZE )
+            throw InvalidArgumentException("RDataStream2: data smaller than the header");
+
+        if( m_readOnly ) init(m_alloc);
+        if( l > m_sizeReserved ) grow(l);
+        memcpy(m_arrData, d, l);
+        m_size = l;
+        m_idx  = HEADER_SIZE;
+
+        return *this;
+    }
+
+    ///
+    /// \brief make the stream a read-only view of raw data (no copy)
+    ///
+    RDataStream2& fromRawData_noCopy(const uint8_t* d, uint32_t l) {
+        release();
+        setView(d, l);
+        return *this;
+    }
+
+    ///
+    /// \brief rewind to beginning position
+    ///
+    int rewind(void) {
+        m_idx = HEADER_SIZE;
+        return 0;
+    }
+
+    ///
+    /// \brief seek pointer position
+    /// \param offset       - offset
+    /// \param whence       - SEEK_SET, SEEK_CUR or SEEK_END
+    /// \return
+    ///     0   - success
+    ///     -1  - given position outside the stream
+    ///
+    int seek(int32_t offset, int whence=SEEK_SET) {
+        int64_t np = offset;
+
+        if( whence == SEEK_CUR ) np += m_idx;
+        if( whence == SEEK_END ) np += m_size;
+
+        if( np > (int64_t) m_size ) return -1;
+        if( np < HEADER_SIZE ) np = HEADER_SIZE;
+
+        m_idx = (uint32_t) np;
+        return 0;
+    }
+
+    uint32_t headerSize(void) const {
+        return HEADER_SIZE;
+    }
+
+    ///
+    /// \brief get the size of stream, including the header
+    ///
+    uint32_t size(void) const {
+        return m_size;
+    }
+
+    ///
+    /// \brief get current position
+    ///
+    uint32_t position(void) const {
+        return m_idx;
+    }
+
+    ///
+    /// \brief get the number of bytes left to read
+    ///
+    uint32_t remaining(void) const {
+        return m_size - m_idx;
+    }
+
+    ///
+    /// \brief stream is a read-only view
+    ///
+    bool readOnly(void) const {
+        return m_readOnly;
+    }
+
+    ///
+    /// \brief return stream raw data with a finalized header
+    ///
+    const uint8_t* data(void) {
+        finalize();
+        return m_arrData;
+    }
+
+    ///
+    /// \brief return the finalized stream as span
+    ///
+    DataSpan span(void) {
+        finalize();
+        return DataSpan(m_arrData, m_size);
+    }
+
+    ///
+    /// \brief write the size word of the header
+    ///
+    void finalize(void) {
+        if( m_readOnly ) return;
+
+        if( m_arrData == NULL ) grow(INITIAL_SIZE);
+        storeLE(m_arrData + sizeof(uint32_t), m_size);
+    }
+
+    ///
+    /// \brief set RDataStream2 header
+    ///
+    /// \param magic    - magic number
+    /// \param ver      - version
+    ///
+    void setHeader(uint32_t magic, uint32_t ver) {
+        checkWritable();
+
+        if( m_arrData == NULL ) grow(INITIAL_SIZE);
+        m_magicVer = (ver << 16) | (magic & 0x0000FFFF);
+        storeLE(m_arrData, m_magicVer);
+    }
+
+    ///
+    /// \brief get RDataStream2 header
+    ///
+    /// \param magic    - magic number
+    /// \param ver      - version
+    ///
+    void getHeader(uint32_t& magic, uint32_t& ver) const {
+        uint32_t mv = m_arrData ? loadLE<uint32_t>(m_arrData) : m_magicVer;
+
+        magic   = mv & 0x0000FFFF;
+        ver     = mv >> 16;
+    }
+
+
+public:
+
+    int write(int8_t d)   { return put(d); }
+    int write(uint8_t d)  { return put(d); }
+    int write(int16_t d)  { return put(d); }
+    int write(uint16_t d) { return put(d); }
+    int write(int32_t d)  { return put(d); }
+    int write(uint32_t d) { return put(d); }
+    int write(int64_t d)  { return put(d); }
+    int write(uint64_t d) { return put(d); }
+    int write(float d)    { return put(d); }
+    int write(double d)   { return put(d); }
+
+    int write(bool d) {
+        uint8_t b = d ? 1 : 0;
+        return put(b);
+    }
+
+    ///
+    /// \brief write binary data
+    /// \param d   - binary data array
+    /// \param len - length in byte
+    ///
+    int write(const void* d, uint32_t len) {
+        uint8_t* p = append(len);
+        if( len ) memcpy(p, d, len);
+        return 0;
+    }
+
+    ///
+    /// \brief write a std::string obj, as length and bytes
+    ///
+    int write(const std::string& s) {
+        uint32_t sl = (uint32_t) s.size();
+        uint8_t* p = append(sizeof(uint32_t) + sl);
+
+        storeLE(p, sl);
+        if( sl ) memcpy(p + sizeof(uint32_t), s.data(), sl);
+        return 0;
+    }
+
+    ///
+    /// \brief write a C string, read back as std::string or DataSpan
+    ///
+    int write(const char* s) {
+        uint32_t sl = (uint32_t) strlen(s);
+        uint8_t* p = append(sizeof(uint32_t) + sl);
+
+        storeLE(p, sl);
+        memcpy(p + sizeof(uint32_t), s, sl);
+        return 0;
+    }
+
+    ///
+    /// \brief write a nested stream, including its header
+    ///
+    int write(const RDataStream2& d) {
+        uint32_t dl = d.m_size;
+        uint8_t* p = append(dl);
+
+        if( d.m_arrData ) memcpy(p, d.m_arrData, dl);
+        storeLE(p, d.m_arrData ? loadLE<uint32_t>(d.m_arrData) : d.m_magicVer);
+        storeLE(p + sizeof(uint32_t), dl);
+        return 0;
+    }
+
+    ///
+    /// \brief write an object which writes its fields itself
+    ///
+    template <class T>
+    typename std::enable_if<std::is_class<T>::value, int>::type
+    write(const T& d) {
+        return d.write(*this);
+    }
+
+    ///
+    /// \brief write an array of primitive values, without count
+    ///
+    template <class T>
+    int writeArray(const T* d, uint32_t count) {
+        static_assert(isBulk<T>::value,
+                      "RDataStream2: arrays are copied as bytes, write other types one by one");
+        uint8_t* p = append(count*sizeof(T));
+
+#if defined(PIL_ARCH_LITTLE_ENDIAN)
+        if( count ) memcpy(p, d, count*sizeof(T));
+#else
+        for(uint32_t i=0; i<count; i++, p+=sizeof(T)) storeLE(p, d[i]);
+#endif
+        return 0;
+    }
+
+    ///
+    /// \brief write a vector of primitive values, as count and elements
+    ///
+    template <class T>
+    typename std::enable_if<isBulk<T>::value, int>::type
+    write(const std::vector<T>& v) {
+        put((uint32_t) v.size());
+        return writeArray(v.empty() ? (const T*) NULL : &v[0], (uint32_t) v.size());
+    }
+
+    ///
+    /// \brief write a vector of other values, as count and each element
+    ///
+    template <class T>
+    typename std::enable_if<!isBulk<T>::value, int>::type
+    write(const std::vector<T>& v) {
+        put((uint32_t) v.size());
+        for(size_t i=0; i<v.size(); i++)
+            if( write(v[i]) ) return -1;
+        return 0;
+    }
+
+
+    int read(int8_t& d)   { return get(d); }
+    int read(uint8_t& d)  { return get(d); }
+    int read(int16_t& d)  { return get(d); }
+    int read(uint16_t& d) { return get(d); }
+    int read(int32_t& d)  { return get(d); }
+    int read(uint32_t& d) { return get(d); }
+    int read(int64_t& d)  { return get(d); }
+    int read(uint64_t& d) { return get(d); }
+    int read(float& d)    { return get(d); }
+    int read(double& d)   { return get(d); }
+
+    int read(bool& d) {
+        uint8_t b;
+        if( get(b) ) return -1;
+        d = b != 0;
+        return 0;
+    }
+
+    ///
+    /// \brief read binary data
+    /// \param d   - binary data array
+    /// \param len - length in byte
+    ///
+    int read(void* d, uint32_t len) {
+        if( len > m_size - m_idx ) return -1;
+
+        if( len ) memcpy(d, m_arrData + m_idx, len);
+        m_idx += len;
+        return 0;
+    }
+
+    ///
+    /// \brief read a std::string obj
+    ///
+    int read(std::string& s) {
+        DataSpan span;
+        if( read(span) ) return -1;
+
+        s.assign((const char*) span.data, span.size);
+        return 0;
+    }
+
+    ///
+    /// \brief read a string without copying it
+    /// \param s - span pointing into the stream buffer
+    ///
+    int read(DataSpan& s) {
+        uint32_t sl;
+
+        if( sizeof(uint32_t) > m_size - m_idx ) return -1;
+        sl = loadLE<uint32_t>(m_arrData + m_idx);
+        if( sl > m_size - m_idx - sizeof(uint32_t) ) return -1;
+
+        s.data = m_arrData + m_idx + sizeof(uint32_t);
+        s.size = sl;
+        m_idx += sizeof(uint32_t) + sl;
+        return 0;
+    }
+
+    ///
+    /// \brief read a nested stream as read-only view (no copy)
+    ///
+    int read(RDataStream2& d) {
+        uint32_t dl;
+
+        if( HEADER_SIZE > m_size - m_idx ) return -1;
+        dl = loadLE<uint32_t>(m_arrData + m_idx + sizeof(uint32_t));
+        if( dl < HEADER_SIZE || dl > m_size - m_idx ) return -1;
+
+        d.fromRawData_noCopy(m_arrData + m_idx, dl);
+        m_idx += dl;
+        return 0;
+    }
+
+    ///
+    /// \brief read an object which reads its fields itself
+    ///
+    template <class T>
+    typename std::enable_if<std::is_class<T>::value, int>::type
+    read(T& d) {
+        return d.read(*this);
+    }
+
+    ///
+    /// \brief read an array of primitive values written by writeArray()
+    ///
+    template <class T>
+    int readArray(T* d, uint32_t count) {
+        static_assert(isBulk<T>::value,
+                      "RDataStream2: arrays are copied as bytes, read other types one by one");
+        if( count > (m_size - m_idx) / sizeof(T) ) return -1;
+
+        const uint8_t* p = m_arrData + m_idx;
+#if defined(PIL_ARCH_LITTLE_ENDIAN)
+        if( count ) memcpy(d, p, count*sizeof(T));
+#else
+        for(uint32_t i=0; i<count; i++, p+=sizeof(T)) d[i] = loadLE<T>(p);
+#endif
+        m_idx += count*sizeof(T);
+        return 0;
+    }
+
+    ///
+    /// \brief read a vector of primitive values
+    ///
+    template <class T>
+    typename std::enable_if<isBulk<T>::value, int>::type
+    read(std::vector<T>& v) {
+        uint32_t n = 0, idx = m_idx;
+
+        if( get(n) ) return -1;
+        if( n > (m_size - m_idx) / sizeof(T) ) {
+            m_idx = idx;
+            return -1;
+        }
+
+        v.resize(n);
+        return readArray(n ? &v[0] : (T*) NULL, n);
+    }
+
+    ///
+    /// \brief read a vector written element by element
+    ///
+    template <class T>
+    typename std::enable_if<!isBulk<T>::value, int>::type
+    read(std::vector<T>& v) {
+        uint32_t n = 0, idx = m_idx;
+
+        // every element takes a byte at least, which bounds the allocation
+        if( get(n) ) return -1;
+        if( n > m_size - m_idx ) {
+            m_idx = idx;
+            return -1;
+        }
+
+        // read into a temporary, std::vector<bool> has no bool& elements
+        v.clear();
+        v.reserve(n);
+        for(uint32_t i=0; i<n; i++) {
+            T e = T();
+            if( read(e) ) {
+                m_idx = idx;
+                return -1;
+            }
+            v.push_back(std::move(e));
+        }
+        return 0;
+    }
+
+
+    template <class T>
+    RDataStream2& operator << (const T& d) {
+        write(d);
+        return *this;
+    }
+
+    template <class T>
+    RDataStream2& operator >> (T& d) {
+        read(d);
+        return *this;
+    }
+
+
+protected:
+
+    void init(DataStreamAllocator* alloc) {
+        m_alloc         = alloc ? alloc : DataStreamAllocator::heap();
+        m_arrData       = NULL;
+        m_idx           = HEADER_SIZE;
+        m_size          = HEADER_SIZE;
+        m_sizeReserved  = 0;
+        m_magicVer      = 0;
+        m_readOnly      = false;
+    }
+
+    void setView(const uint8_t* d, uint32_t l) {
+        if( l < HEADER_SIZE )
+            throw InvalidArgumentException("RDataStream2: data smaller than the header");
+
+        m_arrData       = const_cast<uint8_t*>(d);
+        m_size          = l;
+        m_sizeReserved  = l;
+        m_idx           = HEADER_SIZE;
+        m_readOnly      = true;
+    }
+
+    void release(void) {
+        if( !m_readOnly && m_arrData ) m_alloc->deallocate(m_arrData, m_sizeReserved);
+        init(m_alloc);
+    }
+
+    void assign(const RDataStream2& s) {
+        if( s.m_readOnly ) {
+            release();
+            setView(s.m_arrData, s.m_size);
+        } else {
+            if( m_readOnly ) init(m_alloc);
+            m_size = HEADER_SIZE;
+            if( s.m_size > m_sizeReserved ) grow(s.m_size);
+            if( s.m_arrData ) memcpy(m_arrData, s.m_arrData, s.m_size);
+            else storeLE(m_arrData, s.m_magicVer);
+            m_size      = s.m_size;
+            m_magicVer  = s.m_magicVer;
+        }
+        m_idx = s.m_idx;
+    }
+
+    void checkWritable(void) const {
+        if( m_readOnly )
+            throw IllegalStateException("RDataStream2 is a read-only view");
+    }
+
+    ///
+    /// \brief reallocate the buffer to hold at least n bytes
+    ///
+    void grow(uint32_t n) {
+        uint32_t nr = m_sizeReserved ? m_sizeReserved : (uint32_t) INITIAL_SIZE;
+        while( nr < n ) nr *= 2;
+
+        uint8_t* arrN = (uint8_t*) m_alloc->allocate(nr);
+        if( m_arrData ) {
+            memcpy(arrN, m_arrData, m_size);
+            m_alloc->deallocate(m_arrData, m_sizeReserved);
+        } else {
+            storeLE(arrN, m_magicVer);
+            storeLE(arrN + sizeof(uint32_t), (uint32_t) HEADER_SIZE);
+        }
+
+        m_arrData = arrN;
+        m_sizeReserved = nr;
+    }
+
+    ///
+    /// \brief make room for n bytes at the current position
+    /// \return pointer to the room
+    ///
+    uint8_t* append(uint32_t n) {
+        checkWritable();
+
+        uint32_t sn = m_idx + n;
+        if( sn > m_sizeReserved || m_arrData == NULL ) grow(sn);
+
+        uint8_t* p = m_arrData + m_idx;
+        m_idx = sn;
+        if( m_idx > m_size ) m_size = m_idx;
+        return p;
+    }
+
+    template <class T>
+    int put(T d) {
+        storeLE(append(sizeof(T)), d);
+        return 0;
+    }
+
+    template <class T>
+    int get(T& d) {
+        if( sizeof(T) > m_size - m_idx ) return -1;
+
+        d = loadLE<T>(m_arrData + m_idx);
+        m_idx += sizeof(T);
+        return 0;
+    }
+
+    static uint8_t  toLE(uint8_t v)  { return v; }
+    static uint16_t toLE(uint16_t v) { return ByteOrder::toLittleEndian((UInt16) v); }
+    static uint32_t toLE(uint32_t v) { return ByteOrder::toLittleEndian((UInt32) v); }
+    static uint64_t toLE(uint64_t v) { return ByteOrder::toLittleEndian((UInt64) v); }
+
+    template <class T>
+    static void storeLE(uint8_t* p, T v) {
+        typename DataStreamBits<sizeof(T)>::Type u;
+
+        memcpy(&u, &v, sizeof(T));
+        u = toLE(u);
+        memcpy(p, &u, sizeof(T));
+    }
+
+    template <class T>
+    static T loadLE(const uint8_t* p) {
+        typename DataStreamBits<sizeof(T)>::Type u;
+        T v;
+
+        memcpy(&u, p, sizeof(T));
+        u = toLE(u);
+        memcpy(&v, &u, sizeof(T));
+        return v;
+    }
+
+protected:
+    DataStreamAllocator*    m_alloc;                    ///< buffer allocator
+    uint8_t*                m_arrData;                  ///< data array, NULL before the first write
+
+    uint32_t                m_idx;                      ///< current position
+    uint32_t                m_size;                     ///< current length
+    uint32_t                m_sizeReserved;             ///< buffer size
+    uint32_t                m_magicVer;                 ///< header word, for streams without buffer
+
+    bool                    m_readOnly;                 ///< view of external data
+};
+
+} // end of namespace pi
+
+#endif // __RTK_DATASTREAM2_H__
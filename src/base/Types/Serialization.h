@@ -0,0 +1,882 @@
+#ifndef PIL_Serialization_INCLUDED
+#define PIL_Serialization_INCLUDED
+
+
+#include "base/Types/TypeList.h"
+#include "base/Types/MetaProgramming.h"
+#include "base/Types/DataStream.h"
+#include "base/Types/DataStream2.h"
+#include "base/Debug/Exception.h"
+#include "base/Platform/Platform.h"
+#include "base/Types/Point.h"
+#include "base/Types/SE3.h"
+#include "base/Types/SIM3.h"
+#include "base/Types/VecParament.h"
+#include <type_traits>
+#include <cctype>
+#include <cstring>
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace pi {
+
+
+//
+// Schemas
+//
+
+
+template <class T>
+struct Schema
+    /// Describes the serialized fields of T.
+    ///
+    /// A type becomes serializable by specializing Schema, either with
+    /// PIL_SERIALIZABLE for plain structs:
+    ///
+    ///     namespace pi {
+    ///     PIL_SERIALIZABLE(Record, 1, timestamp, pose, name)
+    ///     }
+    ///
+    /// or by hand, to add fields in later versions or to access
+    /// fields through accessor functions returning a reference:
+    ///
+    ///     template <>
+    ///     struct Schema<Record>: SchemaBase<Record, 2>
+    ///     {
+    ///         PIL_SCHEMA_FIELD(timestamp, 1)
+    ///         PIL_SCHEMA_FIELD(pose, 1)
+    ///         PIL_SCHEMA_ACCESSOR(name, getName, 2)
+    ///         typedef PIL_SCHEMA_FIELDS(timestamp, pose, name) Fields;
+    ///     };
+    ///
+    /// Fields is a TypeList of field descriptors, which the readers and
+    /// writers below walk at compile time. A field may be of arithmetic
+    /// type, std::string, std::vector or another type with a Schema.
+{
+    enum
+    {
+        DEFINED = 0,
+        VERSION = 0
+    };
+};
+
+
+template <class C, int Version>
+struct SchemaBase
+    /// Base class for Schema specializations.
+{
+    typedef C Class;
+
+    enum
+    {
+        DEFINED = 1,
+        VERSION = Version ///< written in front of every object
+    };
+};
+
+
+#define PIL_SCHEMA_FIELD(member, since) \
+    struct Field_##member \
+    { \
+        enum { SINCE = since }; \
+        static const char* name() { return #member; } \
+        template <class C> static auto get(C& c) -> decltype((c.member)) { return c.member; } \
+    };
+    /// Declares the data member as field, present since the given
+    /// schema version.
+
+
+#define PIL_SCHEMA_ACCESSOR(field, accessor, since) \
+    struct Field_##field \
+    { \
+        enum { SINCE = since }; \
+        static const char* name() { return #field; } \
+        template <class C> static auto get(C& c) -> decltype((c.accessor())) { return c.accessor(); } \
+    };
+    /// Declares a field accessed through the given member function,
+    /// which must return a reference for non-const objects.
+
+
+#define PIL_PP_CAT(a, b) PIL_PP_CAT_(a, b)
+#define PIL_PP_CAT_(a, b) a##b
+#define PIL_PP_NARG(...) PIL_PP_NARG_(__VA_ARGS__, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define PIL_PP_NARG_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, N, ...) N
+
+#define PIL_SCHEMA_DECLARE_1(m)      PIL_SCHEMA_FIELD(m, 1)
+#define PIL_SCHEMA_DECLARE_2(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_1(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_3(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_2(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_4(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_3(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_5(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_4(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_6(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_5(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_7(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_6(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_8(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_7(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_9(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_8(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_10(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_9(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_11(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_10(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_12(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_11(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_13(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_12(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_14(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_13(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_15(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_14(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_16(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_15(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_17(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_16(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_18(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_17(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_19(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_18(__VA_ARGS__)
+#define PIL_SCHEMA_DECLARE_20(m, ...) PIL_SCHEMA_FIELD(m, 1) PIL_SCHEMA_DECLARE_19(__VA_ARGS__)
+
+#define PIL_SCHEMA_LIST_1(m)      pi::TypeList<Field_##m, pi::NullTypeList>
+#define PIL_SCHEMA_LIST_2(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_1(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_3(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_2(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_4(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_3(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_5(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_4(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_6(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_5(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_7(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_6(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_8(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_7(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_9(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_8(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_10(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_9(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_11(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_10(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_12(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_11(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_13(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_12(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_14(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_13(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_15(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_14(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_16(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_15(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_17(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_16(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_18(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_17(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_19(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_18(__VA_ARGS__) >
+#define PIL_SCHEMA_LIST_20(m, ...) pi::TypeList<Field_##m, PIL_SCHEMA_LIST_19(__VA_ARGS__) >
+
+
+#define PIL_SCHEMA_FIELDS(...) PIL_PP_CAT(PIL_SCHEMA_LIST_, PIL_PP_NARG(__VA_ARGS__))(__VA_ARGS__)
+    /// Expands to the TypeList of the declared fields with the given
+    /// names, in serialization order.
+
+
+#define PIL_SERIALIZABLE(Class, version, ...) \
+    template <> \
+    struct Schema<Class>: pi::SchemaBase<Class, version> \
+    { \
+        PIL_PP_CAT(PIL_SCHEMA_DECLARE_, PIL_PP_NARG(__VA_ARGS__))(__VA_ARGS__) \
+        typedef PIL_SCHEMA_FIELDS(__VA_ARGS__) Fields; \
+    };
+    /// Declares the Schema of a struct with up to 20 public data
+    /// members, all present since version 1. Must be used in
+    /// namespace pi.
+
+
+template <class List>
+struct SchemaFields;
+    /// Walks the field TypeList of a Schema.
+
+
+template <>
+struct SchemaFields<NullTypeList>
+{
+    template <class V, class C>
+    static void write(V&, const C&)
+    {
+    }
+
+    template <class V, class C>
+    static void read(V&, C&, int)
+    {
+    }
+
+    template <class V, class C>
+    static bool readNamed(V&, C&, const std::string&)
+    {
+        return false;
+    }
+
+    template <class L, class C>
+    static bool flat(const char*, C&, std::size_t&)
+    {
+        return true;
+    }
+};
+
+
+template <class Head, class Tail>
+struct SchemaFields<TypeList<Head, Tail> >
+{
+    template <class V, class C>
+    static void write(V& v, const C& c)
+    {
+        v.field(Head::name(), Head::get(c));
+        SchemaFields<Tail>::write(v, c);
+    }
+
+    template <class V, class C>
+    static void read(V& v, C& c, int version)
+        /// Reads the fields present in the given version, the
+        /// others keep their value.
+    {
+        if ((int) Head::SINCE <= version) v.field(Head::name(), Head::get(c));
+        SchemaFields<Tail>::read(v, c, version);
+    }
+
+    template <class V, class C>
+    static bool readNamed(V& v, C& c, const std::string& name)
+        /// Reads the field with the given name, returns false if
+        /// there is none.
+    {
+        if (name == Head::name())
+        {
+            v.value(Head::get(c));
+            return true;
+        }
+        return SchemaFields<Tail>::readNamed(v, c, name);
+    }
+
+    template <class L, class C>
+    static bool flat(const char* base, C& c, std::size_t& offset)
+    {
+        return L::flat(base, Head::get(c), offset) && SchemaFields<Tail>::template flat<L>(base, c, offset);
+    }
+};
+
+
+struct SchemaLayout
+    /// Classifies types by their memory layout.
+    ///
+    /// A type is fixed if it is trivially copyable, its fields are
+    /// arithmetic (except bool) or fixed types, and they are laid out
+    /// in field order without padding, like SE3 or Point3_. Its binary
+    /// encoding is then a fixed sequence of values, written without
+    /// version, and equals the memory image on little-endian hosts.
+    /// Arrays of such types are copied as a whole there.
+{
+    template <class T>
+    static bool isFixed()
+    {
+        static const bool result = computeFixed<T>();
+        return result;
+    }
+
+    template <class T>
+    static bool isBulk()
+        /// Returns true if arrays of T can be copied with memcpy.
+    {
+#if defined(PIL_ARCH_LITTLE_ENDIAN)
+        return isFixed<T>();
+#else
+        return false;
+#endif
+    }
+
+    template <class T>
+    static typename std::enable_if<std::is_arithmetic<T>::value, bool>::type
+    flat(const char* base, T& v, std::size_t& offset)
+    {
+        if (std::is_same<T, bool>::value || (const char*) &v - base != (std::ptrdiff_t) offset) return false;
+        offset += sizeof(T);
+        return true;
+    }
+
+    template <class T>
+    static typename std::enable_if<Schema<T>::DEFINED, bool>::type
+    flat(const char* base, T& v, std::size_t& offset)
+    {
+        return SchemaFields<typename Schema<T>::Fields>::template flat<SchemaLayout>(base, v, offset);
+    }
+
+    template <class T>
+    static typename std::enable_if<!std::is_arithmetic<T>::value && !Schema<T>::DEFINED, bool>::type
+    flat(const char*, T&, std::size_t&)
+    {
+        return false;
+    }
+
+private:
+    template <class T>
+    static typename std::enable_if<std::is_trivially_copyable<T>::value, bool>::type computeFixed()
+    {
+        T probe;
+        std::size_t offset = 0;
+        return flat((const char*) &probe, probe, offset) && offset == sizeof(T);
+    }
+
+    template <class T>
+    static typename std::enable_if<!std::is_trivially_copyable<T>::value, bool>::type computeFixed()
+    {
+        return false;
+    }
+};
+
+
+template <class T>
+struct SchemaStreamType
+    /// The fixed size type an arithmetic value is written as.
+{
+    typedef typename std::conditional<std::is_same<T, bool>::value, uint8_t,
+            typename std::conditional<std::is_floating_point<T>::value, T,
+            typename std::conditional<sizeof(T) == 1, typename std::conditional<std::is_signed<T>::value, int8_t, uint8_t>::type,
+            typename std::conditional<sizeof(T) == 2, typename std::conditional<std::is_signed<T>::value, int16_t, uint16_t>::type,
+            typename std::conditional<sizeof(T) == 4, typename std::conditional<std::is_signed<T>::value, int32_t, uint32_t>::type,
+            typename std::conditional<std::is_signed<T>::value, int64_t, uint64_t>::type
+            >::type>::type>::type>::type>::type Type;
+};
+
+
+//
+// Binary backend
+//
+
+
+template <class Stream>
+class SchemaWriter
+    /// Writes objects with a Schema to an RDataStream or RDataStream2.
+    ///
+    /// Objects start with the uint16 version of their schema, followed
+    /// by their fields; objects of fixed types (see SchemaLayout) have
+    /// no version. Strings use the encoding of the stream. Vectors are
+    /// a uint32 count followed by the elements, which share a single
+    /// version.
+{
+public:
+    SchemaWriter(Stream& stream): _stream(stream)
+    {
+    }
+
+    template <class T>
+    void write(const T& value)
+        /// Writes a value of any supported type.
+    {
+        this->value(value);
+    }
+
+    template <class T>
+    void field(const char*, const T& v)
+    {
+        value(v);
+    }
+
+    template <class T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type value(T v)
+    {
+        typename SchemaStreamType<T>::Type s = (typename SchemaStreamType<T>::Type) v;
+        _stream.write(s);
+    }
+
+    void value(const std::string& s)
+    {
+        _stream.write(s);
+    }
+
+    template <class T>
+    typename std::enable_if<Schema<T>::DEFINED>::type value(const T& v)
+    {
+        if (!SchemaLayout::isFixed<T>()) writeVersion<T>();
+        SchemaFields<typename Schema<T>::Fields>::write(*this, v);
+    }
+
+    template <class T>
+    void value(const std::vector<T>& v)
+    {
+        uint32_t n = (uint32_t) v.size();
+        _stream.write(n);
+        array(v.empty() ? 0 : &v[0], n);
+    }
+
+    template <class T>
+    void array(const T* v, uint32_t n)
+        /// Writes n elements without count.
+    {
+        if (Schema<T>::DEFINED && !SchemaLayout::isFixed<T>()) writeVersion<T>();
+        if (SchemaLayout::isBulk<T>())
+        {
+            _stream.write((uint8_t*) v, (uint32_t) (n*sizeof(T)));
+            return;
+        }
+        for (uint32_t i = 0; i < n; i++) element(v[i]);
+    }
+
+private:
+    template <class T>
+    void writeVersion()
+    {
+        uint16_t version = (uint16_t) Schema<T>::VERSION;
+        _stream.write(version);
+    }
+
+    template <class T>
+    typename std::enable_if<Schema<T>::DEFINED>::type element(const T& v)
+    {
+        SchemaFields<typename Schema<T>::Fields>::write(*this, v);
+    }
+
+    template <class T>
+    typename std::enable_if<!Schema<T>::DEFINED>::type element(const T& v)
+    {
+        value(v);
+    }
+
+    Stream& _stream;
+};
+
+
+template <class Stream>
+class SchemaReader
+    /// Reads objects written by SchemaWriter.
+    ///
+    /// Fields added after the version found in the stream keep their
+    /// value. Objects of a newer version than the Schema, and
+    /// truncated streams, cause a DataFormatException.
+{
+public:
+    SchemaReader(Stream& stream): _stream(stream)
+    {
+    }
+
+    template <class T>
+    void read(T& value)
+        /// Reads a value of any supported type.
+    {
+        this->value(value);
+    }
+
+    template <class T>
+    void field(const char*, T& v)
+    {
+        value(v);
+    }
+
+    template <class T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type value(T& v)
+    {
+        typename SchemaStreamType<T>::Type s = 0;
+        check(_stream.read(s));
+        v = (T) s;
+    }
+
+    void value(std::string& s)
+    {
+        check(_stream.read(s));
+    }
+
+    template <class T>
+    typename std::enable_if<Schema<T>::DEFINED>::type value(T& v)
+    {
+        int version = SchemaLayout::isFixed<T>() ? (int) Schema<T>::VERSION : readVersion<T>();
+        SchemaFields<typename Schema<T>::Fields>::read(*this, v, version);
+    }
+
+    template <class T>
+    void value(std::vector<T>& v)
+    {
+        uint32_t n = 0;
+        check(_stream.read(n));
+        if (n > _stream.size())
+            throw DataFormatException("SchemaReader: invalid vector size");
+        v.resize(n);
+        array(n ? &v[0] : 0, n);
+    }
+
+    template <class T>
+    void array(T* v, uint32_t n)
+        /// Reads n elements written by SchemaWriter::array().
+    {
+        int version = (int) Schema<T>::VERSION;
+        if (Schema<T>::DEFINED && !SchemaLayout::isFixed<T>()) version = readVersion<T>();
+        if (SchemaLayout::isBulk<T>())
+        {
+            check(_stream.read((uint8_t*) v, (uint32_t) (n*sizeof(T))));
+            return;
+        }
+        for (uint32_t i = 0; i < n; i++) element(v[i], version);
+    }
+
+private:
+    template <class T>
+    int readVersion()
+    {
+        uint16_t version = 0;
+        check(_stream.read(version));
+        if (version > Schema<T>::VERSION)
+            throw DataFormatException("SchemaReader: object version newer than its schema");
+        return version;
+    }
+
+    template <class T>
+    typename std::enable_if<Schema<T>::DEFINED>::type element(T& v, int version)
+    {
+        SchemaFields<typename Schema<T>::Fields>::read(*this, v, version);
+    }
+
+    template <class T>
+    typename std::enable_if<!Schema<T>::DEFINED>::type element(T& v, int)
+    {
+        value(v);
+    }
+
+    static void check(int rc)
+    {
+        if (rc != 0) throw DataFormatException("SchemaReader: stream truncated");
+    }
+
+    Stream& _stream;
+};
+
+
+//
+// Text backend
+//
+
+
+class SchemaTextWriter
+    /// Writes objects with a Schema as indented text:
+    ///
+    ///     {
+    ///         version = 1
+    ///         name = "imu"
+    ///         pose = { version = 1 x = 1.5 ... }
+    ///         samples = [ 1 2 3 ]
+    ///     }
+    ///
+    /// Floating point values are written with enough digits to be
+    /// read back exactly.
+{
+public:
+    SchemaTextWriter(std::ostream& stream): _stream(stream), _indent(0)
+    {
+    }
+
+    template <class T>
+    void write(const T& value)
+    {
+        this->value(value);
+        _stream << "\n";
+    }
+
+    template <class T>
+    void field(const char* name, const T& v)
+    {
+        newLine();
+        _stream << name << " = ";
+        value(v);
+    }
+
+    template <class T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type value(T v)
+    {
+        if (std::is_floating_point<T>::value)
+            _stream << std::setprecision(sizeof(T) == 4 ? 9 : 17) << v;
+        else if (sizeof(T) == 1)
+            _stream << (int) v;
+        else
+            _stream << v;
+    }
+
+    void value(const std::string& s)
+    {
+        _stream << '"';
+        for (std::size_t i = 0; i < s.size(); i++)
+        {
+            if (s[i] == '"' || s[i] == '\\') _stream << '\\';
+            _stream << s[i];
+        }
+        _stream << '"';
+    }
+
+    template <class T>
+    typename std::enable_if<Schema<T>::DEFINED>::type value(const T& v)
+    {
+        _stream << "{";
+        _indent++;
+        field("version", (int) Schema<T>::VERSION);
+        SchemaFields<typename Schema<T>::Fields>::write(*this, v);
+        _indent--;
+        newLine();
+        _stream << "}";
+    }
+
+    template <class T>
+    void value(const std::vector<T>& v)
+    {
+        _stream << "[";
+        for (std::size_t i = 0; i < v.size(); i++)
+        {
+            _stream << " ";
+            value(v[i]);
+        }
+        _stream << " ]";
+    }
+
+private:
+    void newLine()
+    {
+        _stream << "\n" << std::string(4*_indent, ' ');
+    }
+
+    std::ostream& _stream;
+    int           _indent;
+};
+
+
+class SchemaTextReader
+    /// Reads the text written by SchemaTextWriter.
+    ///
+    /// Fields are matched by name, so they may appear in any order.
+    /// Missing fields keep their value and unknown fields are skipped,
+    /// which also allows reading text of newer schema versions.
+    /// Malformed text causes a DataFormatException.
+{
+public:
+    SchemaTextReader(std::istream& stream): _stream(stream)
+    {
+    }
+
+    template <class T>
+    void read(T& value)
+    {
+        this->value(value);
+    }
+
+    template <class T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type value(T& v)
+    {
+        std::string token = next();
+        std::istringstream is(token);
+        if (std::is_floating_point<T>::value)
+        {
+            is >> v;
+        }
+        else
+        {
+            typename std::conditional<std::is_signed<T>::value, long long, unsigned long long>::type i;
+            is >> i;
+            v = (T) i;
+        }
+        if (!is || !is.eof()) throw DataFormatException("SchemaTextReader: invalid number", token);
+    }
+
+    void value(std::string& s)
+    {
+        skipSpace();
+        if (_stream.get() != '"') throw DataFormatException("SchemaTextReader: string expected");
+        s.clear();
+        for (;;)
+        {
+            int c = _stream.get();
+            if (c == '\\') c = _stream.get();
+            else if (c == '"') break;
+            if (c == EOF) throw DataFormatException("SchemaTextReader: unterminated string");
+            s += (char) c;
+        }
+    }
+
+    template <class T>
+    typename std::enable_if<Schema<T>::DEFINED>::type value(T& v)
+    {
+        expect("{");
+        for (;;)
+        {
+            std::string name = next();
+            if (name == "}") break;
+            expect("=");
+            if (name == "version")
+            {
+                int version;
+                value(version);
+            }
+            else if (!SchemaFields<typename Schema<T>::Fields>::readNamed(*this, v, name))
+            {
+                skipValue();
+            }
+        }
+    }
+
+    template <class T>
+    void value(std::vector<T>& v)
+    {
+        expect("[");
+        v.clear();
+        while (peek() != ']')
+        {
+            v.push_back(T());
+            value(v.back());
+        }
+        expect("]");
+    }
+
+private:
+    void skipSpace()
+    {
+        while (std::isspace(_stream.peek())) _stream.get();
+    }
+
+    int peek()
+    {
+        skipSpace();
+        return _stream.peek();
+    }
+
+    std::string next()
+        /// Returns the next bracket, '=' or bare word.
+    {
+        skipSpace();
+        std::string token;
+        int c = _stream.peek();
+        if (c == EOF) throw DataFormatException("SchemaTextReader: unexpected end of text");
+        if (std::strchr("{}[]=", c))
+        {
+            token += (char) _stream.get();
+            return token;
+        }
+        while ((c = _stream.peek()) != EOF && !std::isspace(c) && !std::strchr("{}[]=\"", c))
+            token += (char) _stream.get();
+        return token;
+    }
+
+    void expect(const char* token)
+    {
+        std::string t = next();
+        if (t != token) throw DataFormatException(std::string("SchemaTextReader: expected ") + token, t);
+    }
+
+    void skipValue()
+    {
+        int c = peek();
+        if (c == '"')
+        {
+            std::string s;
+            value(s);
+        }
+        else if (c == '{' || c == '[')
+        {
+            next();
+            while (peek() != (c == '{' ? '}' : ']'))
+            {
+                if (c == '{')
+                {
+                    next();
+                    expect("=");
+                }
+                skipValue();
+            }
+            next();
+        }
+        else
+        {
+            next();
+        }
+    }
+
+    std::istream& _stream;
+};
+
+
+//
+// Schemas of the PIL types
+//
+
+
+template <class P>
+struct Schema<Point2_<P> >: SchemaBase<Point2_<P>, 1>
+{
+    PIL_SCHEMA_FIELD(x, 1)
+    PIL_SCHEMA_FIELD(y, 1)
+    typedef PIL_SCHEMA_FIELDS(x, y) Fields;
+};
+
+
+template <class P>
+struct Schema<Point3_<P> >: SchemaBase<Point3_<P>, 1>
+{
+    PIL_SCHEMA_FIELD(x, 1)
+    PIL_SCHEMA_FIELD(y, 1)
+    PIL_SCHEMA_FIELD(z, 1)
+    typedef PIL_SCHEMA_FIELDS(x, y, z) Fields;
+};
+
+
+template <class P>
+struct Schema<SO3<P> >: SchemaBase<SO3<P>, 1>
+    /// The rotation as quaternion.
+{
+    PIL_SCHEMA_FIELD(x, 1)
+    PIL_SCHEMA_FIELD(y, 1)
+    PIL_SCHEMA_FIELD(z, 1)
+    PIL_SCHEMA_FIELD(w, 1)
+    typedef PIL_SCHEMA_FIELDS(x, y, z, w) Fields;
+};
+
+
+template <class P>
+struct Schema<SE3<P> >: SchemaBase<SE3<P>, 1>
+    /// Rotation first, as in memory, so arrays of poses are flat.
+{
+    PIL_SCHEMA_ACCESSOR(rotation, get_rotation, 1)
+    PIL_SCHEMA_ACCESSOR(translation, get_translation, 1)
+    typedef PIL_SCHEMA_FIELDS(rotation, translation) Fields;
+};
+
+
+template <class P>
+struct Schema<SIM3<P> >: SchemaBase<SIM3<P>, 1>
+{
+    PIL_SCHEMA_ACCESSOR(se3, get_se3, 1)
+    PIL_SCHEMA_ACCESSOR(scale, get_scale, 1)
+    typedef PIL_SCHEMA_FIELDS(se3, scale) Fields;
+};
+
+
+template <class T>
+struct Schema<VecParament<T> >: SchemaBase<VecParament<T>, 1>
+{
+    PIL_SCHEMA_FIELD(data, 1)
+    typedef PIL_SCHEMA_FIELDS(data) Fields;
+};
+
+
+//
+// Convenience functions
+//
+
+
+template <class Stream, class T>
+void serialize(Stream& stream, const T& value)
+    /// Appends value to an RDataStream or RDataStream2.
+{
+    SchemaWriter<Stream> writer(stream);
+    writer.write(value);
+}
+
+
+template <class Stream, class T>
+void deserialize(Stream& stream, T& value)
+    /// Reads value from an RDataStream or RDataStream2.
+{
+    SchemaReader<Stream> reader(stream);
+    reader.read(value);
+}
+
+
+template <class T>
+std::string toText(const T& value)
+    /// Returns the text representation of value.
+{
+    std::ostringstream os;
+    SchemaTextWriter writer(os);
+    writer.write(value);
+    return os.str();
+}
+
+
+template <class T>
+void fromText(const std::string& text, T& value)
+    /// Parses text written by toText() into value.
+{
+    std::istringstream is(text);
+    SchemaTextReader reader(is);
+    reader.read(value);
+}
+
+
+} // namespace pi
+
+
+#endif // PIL_Serialization_INCLUDED
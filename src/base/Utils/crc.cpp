@@ -20,321 +20,408 @@
 
 *******************************************************************************/
 
+#include <string.h>
 #include <stdint.h>
 
 #include "crc.h"
+#include "base/Platform/CPU.h"
+#include "base/Types/ByteOrder.h"
+
+#if defined(PIL_CPU_HAS_X86_VARIANTS)
+#define PIL_CRC_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32) && !defined(PIL_NO_CPU_DISPATCH)
+#define PIL_CRC_ARM 1
+#include <arm_acle.h>
+#endif
 
 namespace pi {
 
 ////////////////////////////////////////////////////////////////////////////////
+/// Tables and kernels
+///
+/// The kernels work on the raw remainder, i.e. the inverted checksum, of
+/// the reflected polynomials:
+///     CRC32_IEEE          0x04C11DB7, reflected 0xEDB88320
+///     CRC32_CASTAGNOLI    0x1EDC6F41, reflected 0x82F63B78
 ////////////////////////////////////////////////////////////////////////////////
 
-#define FALSE	0
-#define TRUE	!FALSE
+namespace {
 
-/*
- * Select the CRC standard from the list that follows.
- */
-//#define CRC_CCITT
-#define CRC32
+const uint32_t g_crcPolynomials[2] = { 0xEDB88320, 0x82F63B78 };
 
+typedef uint32_t (*CRCKernelFunc)(uint32_t crc, const uint8_t* p, size_t length,
+                                  const uint32_t table[8][256]);
 
-#if defined(CRC_CCITT)
-
-typedef uint16_t  crc;
-
-#define CRC_NAME			"CRC-CCITT"
-#define POLYNOMIAL			0x1021
-#define INITIAL_REMAINDER	0xFFFF
-#define FINAL_XOR_VALUE		0x0000
-#define REFLECT_DATA		FALSE
-#define REFLECT_REMAINDER	FALSE
-#define CHECK_VALUE			0x29B1
+struct CRCContext
+    /// Everything the checksums need, built once by crcContext().
+{
+    CRCContext();
 
-#elif defined(CRC16)
+    uint32_t        table[2][8][256];   ///< slicing-by-8 tables per type
+    uint32_t        x2n[2][32];         ///< x^(2^n) modulo the polynomial
+    CRCKernelFunc   hardware[2];        ///< 0 if not supported
+    const char*     hardwareName[2];
+};
 
-typedef uint16_t  crc;
 
-#define CRC_NAME			"CRC-16"
-#define POLYNOMIAL			0x8005
-#define INITIAL_REMAINDER	0x0000
-#define FINAL_XOR_VALUE		0x0000
-#define REFLECT_DATA		TRUE
-#define REFLECT_REMAINDER	TRUE
-#define CHECK_VALUE			0xBB3D
+inline uint32_t load32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return ByteOrder::fromLittleEndian(value);
+}
 
-#elif defined(CRC32)
 
-typedef uint32_t  crc;
+uint32_t crcByte(uint32_t crc, const uint8_t* p, size_t length, const uint32_t table[8][256])
+{
+    while (length--)
+        crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
 
-#define CRC_NAME			"CRC-32"
-#define POLYNOMIAL			0x04C11DB7
-#define INITIAL_REMAINDER	0xFFFFFFFF
-#define FINAL_XOR_VALUE		0xFFFFFFFF
-#define REFLECT_DATA		TRUE
-#define REFLECT_REMAINDER	TRUE
-#define CHECK_VALUE			0xCBF43926
 
-#else
+uint32_t crcSlice8(uint32_t crc, const uint8_t* p, size_t length, const uint32_t table[8][256])
+{
+    while (length && ((uintptr_t) p & 7))
+    {
+        crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        length--;
+    }
+    while (length >= 8)
+    {
+        uint32_t one = load32(p) ^ crc;
+        uint32_t two = load32(p + 4);
+        crc = table[7][one & 0xFF] ^ table[6][(one >> 8) & 0xFF] ^
+              table[5][(one >> 16) & 0xFF] ^ table[4][one >> 24] ^
+              table[3][two & 0xFF] ^ table[2][(two >> 8) & 0xFF] ^
+              table[1][(two >> 16) & 0xFF] ^ table[0][two >> 24];
+        p      += 8;
+        length -= 8;
+    }
+    return crcByte(crc, p, length, table);
+}
 
-#error "One of CRC_CCITT, CRC16, or CRC32 must be #define'd."
 
-#endif
+uint32_t multModP(uint32_t a, uint32_t b, uint32_t poly)
+    /// Returns a*b modulo the polynomial, in the reflected bit order.
+{
+    uint32_t m = 1u << 31, p = 0;
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ poly : b >> 1;
+    }
+    return p;
+}
 
 
-////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
+#if defined(PIL_CRC_X86)
 
-/*
- * Derive parameters from the standard-specific parameters in crc.h.
- */
-#define WIDTH    (8 * sizeof(crc))
-#define TOPBIT   (1 << (WIDTH - 1))
-
-#if (REFLECT_DATA == TRUE)
-#undef  REFLECT_DATA
-#define REFLECT_DATA(X)			((unsigned char) reflect((X), 8))
-#else
-#undef  REFLECT_DATA
-#define REFLECT_DATA(X)			(X)
-#endif
+PIL_TARGET_PCLMUL
+uint32_t crcPclmul(uint32_t crc, const uint8_t* p, size_t length, const uint32_t table[8][256])
+    /// Folds 64 bytes per step with carry-less multiplication, see
+    /// "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+    /// Instruction", Intel 2009. Only for CRC32_IEEE.
+{
+    if (length < 64) return crcSlice8(crc, p, length, table);
 
-#if (REFLECT_REMAINDER == TRUE)
-#undef  REFLECT_REMAINDER
-#define REFLECT_REMAINDER(X)	((crc) reflect((X), WIDTH))
-#else
-#undef  REFLECT_REMAINDER
-#define REFLECT_REMAINDER(X)	(X)
-#endif
+    static const uint64_t k1k2[2] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    static const uint64_t k3k4[2] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+    static const uint64_t k5k0[2] = { 0x0163cd6124ULL, 0x0000000000ULL };
+    static const uint64_t poly[2] = { 0x01db710641ULL, 0x01f7011641ULL };
 
+    size_t tail = length & 15;
+    length -= tail;
 
-////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
 
-/*********************************************************************
- *
- * Function:    reflect()
- * 
- * Description: Reorder the bits of a binary sequence, by reflecting
- *				them about the middle position.
- *
- * Notes:		No checking is done that nBits <= 32.
- *
- * Returns:		The reflection of the original data.
- *
- *********************************************************************/
-static unsigned long
-reflect(unsigned long data, unsigned char nBits)
-{
-	unsigned long  reflection = 0x00000000;
-	unsigned char  bit;
-
-	/*
-	 * Reflect the data about the center bit.
-	 */
-	for (bit = 0; bit < nBits; ++bit)
-	{
-		/*
-		 * If the LSB bit is set, set the reflection of it.
-		 */
-		if (data & 0x01)
-		{
-			reflection |= (1 << ((nBits - 1) - bit));
-		}
-
-		data = (data >> 1);
-	}
-
-	return (reflection);
-
-}	/* reflect() */
-
-
-/*********************************************************************
- *
- * Function:    crcSlow()
- * 
- * Description: Compute the CRC of a given message.
- *
- * Notes:		
- *
- * Returns:		The CRC of the message.
- *
- *********************************************************************/
-crc
-crcSlow(unsigned char const message[], int nBytes)
-{
-    crc            remainder = INITIAL_REMAINDER;
-	int            byte;
-	unsigned char  bit;
+    x1 = _mm_loadu_si128((const __m128i*) (p + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*) (p + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*) (p + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*) (p + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_loadu_si128((const __m128i*) k1k2);
+    p      += 64;
+    length -= 64;
 
+    // four 128 bit lanes in parallel
+    while (length >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*) (p + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*) (p + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*) (p + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*) (p + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        p      += 64;
+        length -= 64;
+    }
 
-    /*
-     * Perform modulo-2 division, a byte at a time.
-     */
-    for (byte = 0; byte < nBytes; ++byte)
+    // fold the lanes into one
+    x0 = _mm_loadu_si128((const __m128i*) k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (length >= 16)
     {
-        /*
-         * Bring the next byte into the remainder.
-         */
-        remainder ^= (REFLECT_DATA(message[byte]) << (WIDTH - 8));
-
-        /*
-         * Perform modulo-2 division, a bit at a time.
-         */
-        for (bit = 8; bit > 0; --bit)
-        {
-            /*
-             * Try to divide the current data bit.
-             */
-            if (remainder & TOPBIT)
-            {
-                remainder = (remainder << 1) ^ POLYNOMIAL;
-            }
-            else
-            {
-                remainder = (remainder << 1);
-            }
-        }
+        x2 = _mm_loadu_si128((const __m128i*) p);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        p      += 16;
+        length -= 16;
     }
 
-    /*
-     * The final remainder is the CRC result.
-     */
-    return (REFLECT_REMAINDER(remainder) ^ FINAL_XOR_VALUE);
+    // 128 to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*) k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_loadu_si128((const __m128i*) poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    crc = _mm_extract_epi32(x1, 1);
+
+    return crcSlice8(crc, p, tail, table);
+}
 
-}   /* crcSlow() */
 
+PIL_TARGET_SSE42
+uint32_t crcSse42(uint32_t crc, const uint8_t* p, size_t length, const uint32_t [8][256])
+    /// The crc32 instruction, which computes CRC32C only.
+{
+    while (length && ((uintptr_t) p & 7))
+    {
+        crc = _mm_crc32_u8(crc, *p++);
+        length--;
+    }
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (length >= 8)
+    {
+        uint64_t value;
+        memcpy(&value, p, 8);
+        crc64 = _mm_crc32_u64(crc64, value);
+        p      += 8;
+        length -= 8;
+    }
+    crc = (uint32_t) crc64;
+#endif
+    while (length >= 4)
+    {
+        uint32_t value;
+        memcpy(&value, p, 4);
+        crc = _mm_crc32_u32(crc, value);
+        p      += 4;
+        length -= 4;
+    }
+    while (length--)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
 
-crc  crcTable[256];
+#endif // PIL_CRC_X86
 
 
-/*********************************************************************
- *
- * Function:    crcInit()
- * 
- * Description: Populate the partial CRC lookup table.
- *
- * Notes:		This function must be rerun any time the CRC standard
- *				is changed.  If desired, it can be run "offline" and
- *				the table results stored in an embedded system's ROM.
- *
- * Returns:		None defined.
- *
- *********************************************************************/
-void
-crcInit(void)
+#if defined(PIL_CRC_ARM)
+
+template <bool Castagnoli>
+uint32_t crcArm(uint32_t crc, const uint8_t* p, size_t length, const uint32_t table[8][256])
+    /// The ARMv8 crc32 instructions, which compute both checksums.
 {
-    crc			   remainder;
-	int			   dividend;
-	unsigned char  bit;
+    while (length && ((uintptr_t) p & 7))
+    {
+        crc = Castagnoli ? __crc32cb(crc, *p++) : __crc32b(crc, *p++);
+        length--;
+    }
+    while (length >= 8)
+    {
+        uint64_t value;
+        memcpy(&value, p, 8);
+        crc = Castagnoli ? __crc32cd(crc, value) : __crc32d(crc, value);
+        p      += 8;
+        length -= 8;
+    }
+    while (length--)
+        crc = Castagnoli ? __crc32cb(crc, *p++) : __crc32b(crc, *p++);
+    return crc;
+}
+
+#endif // PIL_CRC_ARM
 
 
-    /*
-     * Compute the remainder of each possible dividend.
-     */
-    for (dividend = 0; dividend < 256; ++dividend)
+CRCContext::CRCContext()
+{
+    for (int type = 0; type < 2; type++)
     {
-        /*
-         * Start with the dividend followed by zeros.
-         */
-        remainder = dividend << (WIDTH - 8);
-
-        /*
-         * Perform modulo-2 division, a bit at a time.
-         */
-        for (bit = 8; bit > 0; --bit)
+        uint32_t poly = g_crcPolynomials[type];
+        for (uint32_t n = 0; n < 256; n++)
         {
-            /*
-             * Try to divide the current data bit.
-             */			
-            if (remainder & TOPBIT)
-            {
-                remainder = (remainder << 1) ^ POLYNOMIAL;
-            }
-            else
+            uint32_t c = n;
+            for (int bit = 0; bit < 8; bit++)
+                c = (c & 1) ? (c >> 1) ^ poly : c >> 1;
+            table[type][0][n] = c;
+        }
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = table[type][0][n];
+            for (int k = 1; k < 8; k++)
             {
-                remainder = (remainder << 1);
+                c = table[type][0][c & 0xFF] ^ (c >> 8);
+                table[type][k][n] = c;
             }
         }
 
-        /*
-         * Store the result into the table.
-         */
-        crcTable[dividend] = remainder;
+        uint32_t p = 1u << 30;  // x^1
+        x2n[type][0] = p;
+        for (int n = 1; n < 32; n++)
+            x2n[type][n] = p = multModP(p, p, poly);
+
+        hardware[type]     = 0;
+        hardwareName[type] = 0;
     }
 
-}   /* crcInit() */
-
-
-/*********************************************************************
- *
- * Function:    crcFast()
- * 
- * Description: Compute the CRC of a given message.
- *
- * Notes:		crcInit() must be called first.
- *
- * Returns:		The CRC of the message.
- *
- *********************************************************************/
-crc
-crcFast(unsigned char const message[], int nBytes)
-{
-    crc	           remainder = INITIAL_REMAINDER;
-    unsigned char  data;
-	int            byte;
-
-    /*
-     * Divide the message by the polynomial, a byte at a time.
-     */
-    for (byte = 0; byte < nBytes; ++byte)
+#if defined(PIL_CRC_X86)
+    if (cpu::has(cpu::PCLMUL | cpu::SSE41))
+    {
+        hardware[CRC32_IEEE]     = crcPclmul;
+        hardwareName[CRC32_IEEE] = "pclmulqdq";
+    }
+    if (cpu::has(cpu::SSE42))
     {
-        data = REFLECT_DATA(message[byte]) ^ (remainder >> (WIDTH - 8));
-  		remainder = crcTable[data] ^ (remainder << 8);
+        hardware[CRC32_CASTAGNOLI]     = crcSse42;
+        hardwareName[CRC32_CASTAGNOLI] = "sse4.2";
     }
+#elif defined(PIL_CRC_ARM)
+    if (cpu::has(cpu::ARM_CRC32))
+    {
+        hardware[CRC32_IEEE]           = crcArm<false>;
+        hardware[CRC32_CASTAGNOLI]     = crcArm<true>;
+        hardwareName[CRC32_IEEE]       = "armv8-crc32";
+        hardwareName[CRC32_CASTAGNOLI] = "armv8-crc32";
+    }
+#endif
+}
+
 
-    /*
-     * The final remainder is the CRC.
-     */
-    return (REFLECT_REMAINDER(remainder) ^ FINAL_XOR_VALUE);
+const CRCContext& crcContext()
+{
+    // built once, C++11 guarantees thread safe initialisation
+    static const CRCContext context;
+    return context;
+}
 
-}   /* crcFast() */
+} // end of anonymous namespace
 
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-int g_crcInited = 0;
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length,
+                      CRC32Type type, CRC32Kernel kernel)
+{
+    const CRCContext& context = crcContext();
+    const uint8_t*    p       = (const uint8_t*) data;
+    CRCKernelFunc     func;
+
+    switch (kernel)
+    {
+    case CRC32_KERNEL_BYTE:
+        func = crcByte;
+        break;
+    case CRC32_KERNEL_SLICE8:
+        func = crcSlice8;
+        break;
+    default:
+        func = context.hardware[type] ? context.hardware[type] : crcSlice8;
+        break;
+    }
+
+    return ~func(~crc, p, length, context.table[type]);
+}
+
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length, CRC32Type type)
+{
+    return crc32_update(crc, data, length, type, CRC32_KERNEL_AUTO);
+}
+
 
 uint32_t crc32(const void *dat, int nBytes)
 {
-    uint8_t        *message = (uint8_t*) dat;
-    crc	           remainder = INITIAL_REMAINDER;
-    unsigned char  data;
-    int            byte;
-
-    // initial CRC table
-    if( !g_crcInited ) {
-        g_crcInited = 1;
-        crcInit();
-    }
+    return crc32_update(0, dat, nBytes > 0 ? nBytes : 0, CRC32_IEEE);
+}
+
 
-    /*
-     * Divide the message by the polynomial, a byte at a time.
-     */
-    for (byte = 0; byte < nBytes; ++byte)
+uint32_t crc32c(const void *data, size_t length)
+{
+    return crc32_update(0, data, length, CRC32_CASTAGNOLI);
+}
+
+
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t length2, CRC32Type type)
+{
+    // crc1 * x^(8*length2) + crc2, the inversions cancel out
+    const CRCContext& context = crcContext();
+    uint32_t poly = g_crcPolynomials[type];
+    uint32_t p = 1u << 31;  // x^0
+    int      k = 3;         // 8*length2 = length2 * 2^3
+    while (length2)
     {
-        data = REFLECT_DATA(message[byte]) ^ (remainder >> (WIDTH - 8));
-        remainder = crcTable[data] ^ (remainder << 8);
+        if (length2 & 1) p = multModP(context.x2n[type][k & 31], p, poly);
+        length2 >>= 1;
+        k++;
     }
+    return multModP(p, crc1, poly) ^ crc2;
+}
+
 
-    /*
-     * The final remainder is the CRC.
-     */
-    return (REFLECT_REMAINDER(remainder) ^ FINAL_XOR_VALUE);
+bool crc32_hasHardware(CRC32Type type)
+{
+    return crcContext().hardware[type] != 0;
 }
 
 
-} // end of namespace pi
+const char* crc32_kernelName(CRC32Type type)
+{
+    const CRCContext& context = crcContext();
+    return context.hardware[type] ? context.hardwareName[type] : "slice8";
+}
+
 
+} // end of namespace pi
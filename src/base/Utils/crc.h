@@ -23,14 +23,92 @@
 #ifndef __CRC_H__
 #define __CRC_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 
 namespace pi {
 
 
+/// CRC-32 checksums of the reflected polynomials, with initial value and
+/// final xor 0xFFFFFFFF.
+///
+/// CRC32_IEEE is the checksum of zlib, Ethernet and PNG (check value of
+/// "123456789" is 0xCBF43926); CRC32_CASTAGNOLI, known as CRC32C, is the
+/// one of iSCSI, ext4 and SSE4.2 (check value 0xE3069283).
+///
+/// The work is done by the fastest kernel the CPU supports, selected once
+/// at the first call: PCLMULQDQ folding (CRC32) or the SSE4.2 crc32
+/// instruction (CRC32C) on x86, the ARMv8 CRC32 instructions on ARM, and
+/// a slicing-by-8 table otherwise. All functions are thread safe.
+enum CRC32Type
+{
+    CRC32_IEEE,
+    CRC32_CASTAGNOLI
+};
+
+enum CRC32Kernel
+{
+    CRC32_KERNEL_AUTO,      ///< the fastest kernel available
+    CRC32_KERNEL_BYTE,      ///< one table lookup per byte
+    CRC32_KERNEL_SLICE8,    ///< eight table lookups per 8 bytes
+    CRC32_KERNEL_HARDWARE   ///< CPU instructions, see crc32_hasHardware()
+};
+
+
+/// Returns the CRC-32 of nBytes bytes.
 uint32_t crc32(const void *dat, int nBytes);
 
+/// Returns the CRC32C of the given bytes.
+uint32_t crc32c(const void *data, size_t length);
+
+/// Continues a checksum with more data. Start with crc 0; the result of
+/// every call is the checksum of all data so far, so
+/// crc32_update(crc32_update(0, a, n), b, m) is the checksum of a and b.
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length,
+                      CRC32Type type = CRC32_IEEE);
+
+/// Same as crc32_update() with the given kernel, for tests and benchmarks.
+/// CRC32_KERNEL_HARDWARE falls back to CRC32_KERNEL_SLICE8 if the CPU
+/// lacks the instructions.
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length,
+                      CRC32Type type, CRC32Kernel kernel);
+
+/// Returns the checksum of the concatenation of two blocks, given the
+/// checksum crc1 of the first, crc2 of the second and the length of the
+/// second. Lets checksums of chunks be computed in parallel and merged.
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t length2,
+                       CRC32Type type = CRC32_IEEE);
+
+/// Returns true if the CPU has instructions for the given checksum.
+bool crc32_hasHardware(CRC32Type type = CRC32_IEEE);
+
+/// Returns the name of the kernel crc32_update() uses for the given type.
+const char* crc32_kernelName(CRC32Type type = CRC32_IEEE);
+
+
+class CRC32
+    /// Incremental CRC-32 or CRC32C of a sequence of buffers.
+{
+public:
+    CRC32(CRC32Type type = CRC32_IEEE): _type(type), _value(0) {}
+
+    void update(const void *data, size_t length)
+    {
+        _value = crc32_update(_value, data, length, _type);
+    }
+
+    uint32_t checksum() const { return _value; }
+
+    void reset() { _value = 0; }
+
+    CRC32Type type() const { return _type; }
+
+private:
+    CRC32Type   _type;
+    uint32_t    _value;
+};
+
 
 } // end of namespace pi
 
@@ -17,16 +17,30 @@ public:
     {
         if(points.size()>=2)
         {
-            glBegin(GL_LINE);
+            glBegin(GL_LINE_STRIP);
             for(size_t i=0,iend=points.size();i<iend;i++)
             {
-                glColor3b(points[i].color.x,points[i].color.y,points[i].color.z);
+                glColor3ub(points[i].color.x,points[i].color.y,points[i].color.z);
                 glVertex3f(points[i].point.x,points[i].point.y,points[i].point.z);
             }
             glEnd();
         }
     }
 
+    virtual bool batch(PrimitiveBatch& batch) const
+    {
+        for(size_t i=1;i<points.size();i++)
+            batch.addLine(points[i-1].point,points[i].point,points[i-1].color,points[i].color);
+        return true;
+    }
+
+    virtual bool bounds(BoundingBox& box)
+    {
+        box=BoundingBox();
+        for(size_t i=0;i<points.size();i++) box.extend(points[i].point);
+        return true;
+    }
+
 private:
     std::vector<ColorfulPoint> points;
 };
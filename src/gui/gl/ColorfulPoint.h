@@ -4,6 +4,8 @@
 #include <base/Types/Point.h>
 #include "GL_Object.h"
 #include "OpenGL.h"
+#include "PrimitiveBatch.h"
+#include "Culling.h"
 
 namespace pi{
 namespace gl{
@@ -17,12 +19,24 @@ struct ColorfulPoint:public GL_Object
 
     virtual void draw()
     {
-        glBegin(GL_POINT);
-        glColor3b(color.x,color.y,color.z);
+        glBegin(GL_POINTS);
+        glColor3ub(color.x,color.y,color.z);
         glVertex3f(point.x,point.y,point.z);
         glEnd();
     }
 
+    virtual bool batch(PrimitiveBatch& batch) const
+    {
+        batch.addPoint(point,color);
+        return true;
+    }
+
+    virtual bool bounds(BoundingBox& box)
+    {
+        box=BoundingBox(point,point);
+        return true;
+    }
+
     pi::Point3f  point;
     Color3b      color;
 };
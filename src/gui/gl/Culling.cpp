@@ -0,0 +1,182 @@
+#include "Culling.h"
+#include "OpenGL.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace pi{
+namespace gl{
+
+namespace {
+
+/// Items per leaf.
+const int LEAF_SIZE=4;
+
+/// Refitting may grow the leaves this much before the hierarchy is built again.
+const float REBUILD_GROWTH=2.f;
+
+struct CenterLess
+{
+    CenterLess(const std::vector<BoundingBox>& b,int a):boxes(b),axis(a){}
+
+    bool operator()(int l,int r) const
+    {
+        return boxes[l].min[axis]+boxes[l].max[axis]<boxes[r].min[axis]+boxes[r].max[axis];
+    }
+
+    const std::vector<BoundingBox>& boxes;
+    int                             axis;
+};
+
+}
+
+void BoundingBox::extend(const float* xyz,size_t n)
+{
+    for(size_t i=0;i<n;i++,xyz+=3)
+        extend(pi::Point3f(xyz[0],xyz[1],xyz[2]));
+}
+
+BoundingBox BoundingBox::transformed(const pi::SE3f& pose) const
+{
+    BoundingBox box;
+    if(empty()) return box;
+    for(int i=0;i<8;i++)
+        box.extend(pose*pi::Point3f(i&1?max.x:min.x,i&2?max.y:min.y,i&4?max.z:min.z));
+    return box;
+}
+
+float BoundingBox::area() const
+{
+    if(empty()) return 0;
+    pi::Point3f d=max-min;
+    return 2.f*(d.x*d.y+d.y*d.z+d.z*d.x);
+}
+
+Frustum::Frustum(const float* p,const float* m,float viewportHeight)
+{
+    // the planes are sums and differences of the rows of projection*modelview
+    float mvp[16];
+    for(int c=0;c<4;c++)
+        for(int r=0;r<4;r++){
+            float sum=0;
+            for(int k=0;k<4;k++) sum+=p[k*4+r]*m[c*4+k];
+            mvp[c*4+r]=sum;
+        }
+    for(int i=0;i<6;i++){
+        int   row=i/2;
+        float sign=(i&1)?-1.f:1.f;
+        float norm=0;
+        for(int c=0;c<4;c++){
+            plane[i][c]=mvp[c*4+3]+sign*mvp[c*4+row];
+            if(c<3) norm+=plane[i][c]*plane[i][c];
+        }
+        norm=norm>0?1.f/sqrtf(norm):1.f;
+        for(int c=0;c<4;c++) plane[i][c]*=norm;
+    }
+    for(int c=0;c<4;c++) wRow[c]=mvp[c*4+3];
+    pixelScale=fabsf(p[5])*viewportHeight;
+}
+
+Frustum Frustum::fromGL()
+{
+    float projection[16],modelview[16];
+    int   viewport[4];
+    glGetFloatv(GL_PROJECTION_MATRIX,projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX,modelview);
+    glGetIntegerv(GL_VIEWPORT,viewport);
+    return Frustum(projection,modelview,(float)viewport[3]);
+}
+
+int Frustum::test(const BoundingBox& box,int& planes) const
+{
+    for(int i=0;i<6;i++){
+        if(!(planes&(1<<i))) continue;
+        const float* pl=plane[i];
+        // the corners farthest along and against the normal
+        float outer=pl[3],inner=pl[3];
+        for(int c=0;c<3;c++){
+            float lo=pl[c]*box.min[c],hi=pl[c]*box.max[c];
+            outer+=std::max(lo,hi);
+            inner+=std::min(lo,hi);
+        }
+        if(outer<0) return Outside;
+        if(inner>=0) planes&=~(1<<i);
+    }
+    return planes?Intersecting:Inside;
+}
+
+float Frustum::pixels(const BoundingBox& box) const
+{
+    pi::Point3f c=box.center();
+    float w=wRow[0]*c.x+wRow[1]*c.y+wRow[2]*c.z+wRow[3];
+    float r=box.radius();
+    if(w<=0) return 1e30f;
+    return r*pixelScale/w;
+}
+
+void BVH::build(const std::vector<BoundingBox>& boxes,const std::vector<int>& items)
+{
+    _nodes.clear();
+    _items=items;
+    if(!_items.empty()){
+        _nodes.reserve(2*_items.size()/LEAF_SIZE+1);
+        build(boxes,0,(int)_items.size());
+    }
+    _builtArea=leafArea();
+}
+
+int BVH::build(const std::vector<BoundingBox>& boxes,int first,int count)
+{
+    int n=(int)_nodes.size();
+    _nodes.push_back(Node());
+    Node& node=_nodes.back();
+    node.first=first;
+    node.count=count;
+    node.right=-1;
+
+    BoundingBox centers;
+    for(int i=first;i<first+count;i++){
+        node.box.extend(boxes[_items[i]]);
+        centers.extend(boxes[_items[i]].center());
+    }
+    if(count<=LEAF_SIZE) return n;
+
+    pi::Point3f extent=centers.max-centers.min;
+    int axis=extent.x>extent.y?(extent.x>extent.z?0:2):(extent.y>extent.z?1:2);
+    int half=count/2;
+    std::nth_element(_items.begin()+first,_items.begin()+first+half,_items.begin()+first+count,
+                     CenterLess(boxes,axis));
+
+    build(boxes,first,half);
+    int right=build(boxes,first+half,count-half);
+    _nodes[n].right=right;
+    return n;
+}
+
+bool BVH::refit(const std::vector<BoundingBox>& boxes)
+{
+    // children always come after their parent
+    for(int n=(int)_nodes.size()-1;n>=0;n--){
+        Node& node=_nodes[n];
+        node.box=BoundingBox();
+        if(node.right<0){
+            for(int i=node.first;i<node.first+node.count;i++)
+                node.box.extend(boxes[_items[i]]);
+        }
+        else{
+            node.box.extend(_nodes[n+1].box);
+            node.box.extend(_nodes[node.right].box);
+        }
+    }
+    return leafArea()<=REBUILD_GROWTH*_builtArea;
+}
+
+float BVH::leafArea() const
+{
+    float area=0;
+    for(size_t n=0;n<_nodes.size();n++)
+        if(_nodes[n].right<0) area+=_nodes[n].box.area();
+    return area;
+}
+
+}}
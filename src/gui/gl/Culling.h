@@ -0,0 +1,170 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <vector>
+#include <stddef.h>
+
+#include <base/Types/Point.h>
+#include <base/Types/SE3.h>
+
+namespace pi{
+namespace gl{
+
+struct BoundingBox
+    /// An axis aligned box, empty until extended.
+{
+    BoundingBox():min(1e30f,1e30f,1e30f),max(-1e30f,-1e30f,-1e30f){}
+    BoundingBox(const pi::Point3f& lo,const pi::Point3f& hi):min(lo),max(hi){}
+
+    bool empty() const{return min.x>max.x;}
+
+    void extend(const pi::Point3f& p)
+    {
+        min.x=p.x<min.x?p.x:min.x; max.x=p.x>max.x?p.x:max.x;
+        min.y=p.y<min.y?p.y:min.y; max.y=p.y>max.y?p.y:max.y;
+        min.z=p.z<min.z?p.z:min.z; max.z=p.z>max.z?p.z:max.z;
+    }
+
+    void extend(const BoundingBox& box)
+    {
+        if(box.empty()) return;
+        extend(box.min);
+        extend(box.max);
+    }
+
+    void extend(const float* xyz,size_t n);
+        /// Extends by n packed x,y,z points.
+
+    BoundingBox transformed(const pi::SE3f& pose) const;
+        /// The box around this one moved by pose.
+
+    pi::Point3f center() const{return (min+max)*0.5f;}
+    float       radius() const{return empty()?0.f:(max-min).norm()*0.5f;}
+    float       area() const;
+
+    pi::Point3f min,max;
+};
+
+struct CullStats
+    /// What the last culled draw did.
+{
+    CullStats(){reset();}
+    void reset(){objects=unbounded=nodes=outside=small=drawn=rebuilds=0;}
+
+    size_t objects;     ///< children
+    size_t unbounded;   ///< children without bounds, always drawn
+    size_t nodes;       ///< hierarchy nodes tested
+    size_t outside;     ///< bounded children outside the view frustum
+    size_t small;       ///< bounded children below the pixel threshold
+    size_t drawn;       ///< children drawn, unbounded ones included
+    size_t rebuilds;    ///< hierarchy rebuilds since the scene was made
+};
+
+class Frustum
+    /// The view frustum of the current GL projection and modelview
+    /// matrices, as loaded by QGLViewer's camera or any other code.
+{
+public:
+    enum Result{Outside=0,Intersecting=1,Inside=2};
+
+    Frustum(){}
+    Frustum(const float* projection,const float* modelview,float viewportHeight);
+        /// Column major 4x4 matrices, as glGetFloatv returns them.
+
+    static Frustum fromGL();
+        /// Reads the matrices and the viewport of the current context.
+
+    int test(const BoundingBox& box,int& planes) const;
+        /// Classifies box against the planes whose bits are set in
+        /// planes; the bits of planes box is inside of are cleared, so
+        /// children of a box need not test them again.
+
+    float pixels(const BoundingBox& box) const;
+        /// Roughly the diameter of box on screen in pixels, or a huge
+        /// value if its center is behind the eye.
+
+private:
+    float           plane[6][4];    ///< a*x+b*y+c*z+d>=0 inside
+    float           wRow[4];        ///< the clip space w of a point
+    float           pixelScale;
+};
+
+class BVH
+    /// A bounding volume hierarchy over the boxes of a list of objects.
+    ///
+    /// Built top down by median splits on the longest axis; when the
+    /// boxes move, refit() updates the node boxes bottom up in linear
+    /// time. The hierarchy is built again once refitting has made the
+    /// nodes much larger than when they were built.
+{
+public:
+    BVH():_builtArea(0){}
+
+    void build(const std::vector<BoundingBox>& boxes,const std::vector<int>& items);
+        /// Indexes items (indices into boxes).
+
+    bool refit(const std::vector<BoundingBox>& boxes);
+        /// Updates the nodes from the boxes at the same indices; returns
+        /// false if the hierarchy degraded and should be built again.
+
+    template<class F>
+    void query(const Frustum& frustum,float minPixels,const std::vector<BoundingBox>& boxes,
+               CullStats& stats,F visible) const
+        /// Calls visible(item) for every item whose box, in boxes as given
+        /// to build() or refit(), is inside the frustum and at least
+        /// minPixels large.
+    {
+        if(!_nodes.empty()) query(0,0x3f,frustum,minPixels,boxes,stats,visible);
+    }
+
+    size_t size() const{return _items.size();}
+    void   clear(){_nodes.clear();_items.clear();_builtArea=0;}
+
+private:
+    struct Node
+    {
+        BoundingBox box;
+        int         first,count;    ///< the items below the node
+        int         right;          ///< the right child, the left one follows the node; -1 for leaves
+    };
+
+    int   build(const std::vector<BoundingBox>& boxes,int first,int count);
+    float leafArea() const;
+
+    template<class F>
+    void query(int n,int planes,const Frustum& frustum,float minPixels,
+               const std::vector<BoundingBox>& boxes,CullStats& stats,F& visible) const
+    {
+        const Node& node=_nodes[n];
+        stats.nodes++;
+        int result=planes?frustum.test(node.box,planes):Frustum::Inside;
+        if(result==Frustum::Outside){
+            stats.outside+=node.count;
+            return;
+        }
+        if(minPixels>0&&frustum.pixels(node.box)<minPixels){
+            stats.small+=node.count;
+            return;
+        }
+        if(node.right>=0){
+            query(n+1,planes,frustum,minPixels,boxes,stats,visible);
+            query(node.right,planes,frustum,minPixels,boxes,stats,visible);
+            return;
+        }
+        for(int i=node.first;i<node.first+node.count;i++){
+            // the items of a leaf crossing planes or the size limit are tested one by one
+            const BoundingBox& box=boxes[_items[i]];
+            int itemPlanes=planes;
+            if(itemPlanes&&frustum.test(box,itemPlanes)==Frustum::Outside) stats.outside++;
+            else if(minPixels>0&&frustum.pixels(box)<minPixels) stats.small++;
+            else visible(_items[i]);
+        }
+    }
+
+    std::vector<Node>   _nodes;
+    std::vector<int>    _items;
+    float               _builtArea; ///< leafArea() when built
+};
+
+}}
+#endif // CULLING_H
@@ -0,0 +1,139 @@
+#include "GL_FatherObject.h"
+#include "PosedObject.h"
+
+#include <algorithm>
+
+namespace pi{
+namespace gl{
+
+bool Father_Object::insert(const GL_ObjectPtr& obj)
+{
+    if(!obj.get()) return false;
+    commands.push(Command(Command::Insert,obj));
+    return true;
+}
+
+bool Father_Object::insert(const GL_Object& obj)
+{
+    SPtr<PrimitiveBatch> copy(new PrimitiveBatch);
+    if(!obj.batch(*copy)) return false;
+    commands.push(Command(Command::InsertCopy,copy));
+    return true;
+}
+
+void Father_Object::remove(const GL_ObjectPtr& obj)
+{
+    commands.push(Command(Command::Remove,obj));
+}
+
+void Father_Object::setPose(const GL_ObjectPtr& obj,const pi::SE3f& pose)
+{
+    Command command(Command::SetPose,obj);
+    command.pose=pose;
+    commands.push(command);
+}
+
+void Father_Object::clear()
+{
+    commands.push(Command(Command::Clear));
+}
+
+void Father_Object::draw()
+{
+    apply();
+    if(!culling){
+        for(ObjectPtrVec::iterator it=children.begin();it!=children.end();it++)
+            (*it)->draw();
+        batched.draw();
+        return;
+    }
+
+    bool drawBatched=cull();
+    for(size_t i=0;i<children.size();i++)
+        if(visible[i]) children[i]->draw();
+    if(drawBatched) batched.draw();
+}
+
+bool Father_Object::cull()
+{
+    size_t n=children.size();
+    size_t rebuilds=stats.rebuilds;
+    stats.reset();
+    stats.objects=n;
+    stats.rebuilds=rebuilds;
+
+    boxes.resize(n);
+    visible.assign(n,0);
+    current.clear();
+    for(size_t i=0;i<n;i++){
+        BoundingBox& box=boxes[i];
+        if(children[i]->bounds(box)&&!box.empty()) current.push_back((int)i);
+        else{
+            visible[i]=1;
+            stats.unbounded++;
+        }
+    }
+
+    BoundingBox batchedBox;
+    batched.bounds(batchedBox);
+    if(current.empty()&&batchedBox.empty()){
+        stats.drawn=stats.unbounded;
+        return false;
+    }
+
+    Frustum frustum=Frustum::fromGL();
+    if(changed||current!=bounded){
+        bounded.swap(current);
+        bvh.build(boxes,bounded);
+        changed=false;
+        stats.rebuilds++;
+    }
+    else if(!bvh.refit(boxes)){
+        bvh.build(boxes,bounded);
+        stats.rebuilds++;
+    }
+    bvh.query(frustum,minPixels,boxes,stats,[this](int i){visible[i]=1;});
+    stats.drawn=stats.unbounded+(bounded.size()-stats.outside-stats.small);
+
+    int planes=0x3f;
+    return !batchedBox.empty()&&frustum.test(batchedBox,planes)!=Frustum::Outside;
+}
+
+size_t Father_Object::apply()
+{
+    return commands.consume([this](Command& command){run(command);});
+}
+
+void Father_Object::run(Command& command)
+{
+    switch(command.type)
+    {
+    case Command::Insert:
+        children.push_back(command.object);
+        changed=true;
+        break;
+    case Command::InsertCopy:
+        command.object->batch(batched);
+        break;
+    case Command::Remove:
+        {
+            ObjectPtrVec::iterator it=std::find(children.begin(),children.end(),command.object);
+            if(it!=children.end()) children.erase(it);
+            changed=true;
+        }
+        break;
+    case Command::SetPose:
+        {
+            PosedObject* posed=dynamic_cast<PosedObject*>(command.object.get());
+            if(posed) posed->setPose(command.pose);
+        }
+        break;
+    case Command::Clear:
+        children.clear();
+        batched.clear();
+        changed=true;
+        break;
+    }
+}
+
+}}
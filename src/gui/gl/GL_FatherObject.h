@@ -2,37 +2,104 @@
 #define GL_FATHEROBJECT_H
 
 #include "GL_Object.h"
+#include "PrimitiveBatch.h"
+#include "Culling.h"
 #include <base/Types/SPtr.h>
-#include <base/Thread/Thread.h>
+#include <base/Types/SE3.h>
+#include <base/Thread/MPSCQueue.h>
 #include <vector>
 
 namespace pi{
 namespace gl{
 
 typedef SPtr<GL_Object>           GL_ObjectPtr;
-typedef std::vector<GL_Object>    ObjectVec;
 typedef std::vector<GL_ObjectPtr> ObjectPtrVec;
 
 struct Father_Object:public GL_Object
+    /// A scene of child objects, changed by producer threads while the
+    /// render thread draws it.
+    ///
+    /// insert(), remove(), setPose() and clear() only queue a command and
+    /// never wait for the renderer; draw() runs the queued commands before
+    /// drawing, so the children are only ever touched by the render thread.
+    /// Without a window, apply() runs them as well.
+    ///
+    /// Objects inserted by pointer stay children, which can be removed
+    /// and whose later changes are drawn. Objects inserted by reference
+    /// are copied into a PrimitiveBatch of the scene and drawn with a few
+    /// glDrawArrays; they cannot be removed except by clear().
+    ///
+    /// Children with bounds() are kept in a BVH, and those outside the
+    /// view frustum of the current GL matrices, or smaller on screen than
+    /// setMinPixels(), are not drawn. The others are drawn in insertion
+    /// order.
 {
-    virtual void draw()
-    {
-        pi::ScopedMutex lock(m_mutex);
-        for(ObjectVec::iterator it=children.begin();it!=children.end();it++)
-            it->draw();
-        for(ObjectPtrVec::iterator it=ptr_children.begin();it!=ptr_children.end();it++)
-            (*it)->draw();
-    }
+    Father_Object():culling(true),minPixels(0),changed(true){}
+
+    virtual void draw();
+
+    bool insert(const GL_ObjectPtr& obj);
+    bool insert(const GL_Object& obj);
+        /// Copies what obj batches; returns false for objects which cannot
+        /// be batched, since they would be sliced.
 
-    bool insert(const GL_ObjectPtr& obj){pi::ScopedMutex lock(m_mutex);ptr_children.push_back(obj);return true;}
-    bool insert(const GL_Object& obj){pi::ScopedMutex lock(m_mutex);children.push_back(obj);return true;}
+    void remove(const GL_ObjectPtr& obj);
+    void setPose(const GL_ObjectPtr& obj,const pi::SE3f& pose);
+        /// Sets the pose of a PosedObject in order with the other
+        /// commands, when apply() runs them.
+    void clear();
 
-    void clear(){pi::ScopedMutex lock(m_mutex);children.clear();ptr_children.clear();}
+    size_t apply();
+        /// Runs the queued commands and returns their number. Must be
+        /// called from the thread which draws.
+
+    size_t size() const {return children.size();}
+        /// The children not batched, as of the last apply().
+
+    void setCulling(bool enable){culling=enable;}
+        /// On by default.
+    void setMinPixels(float pixels){minPixels=pixels;}
+        /// Children whose bounds are smaller on screen are not drawn; 0,
+        /// the default, draws them all.
+    const CullStats& cullStats() const{return stats;}
+        /// What the last draw() culled.
 
 private:
-    ObjectVec       children;
-    ObjectPtrVec    ptr_children;
-    Mutex           m_mutex;
+    struct Command
+    {
+        enum Type
+        {
+            Insert,
+            InsertCopy,     ///< of a PrimitiveBatch only this scene holds
+            Remove,
+            SetPose,
+            Clear
+        };
+
+        Command(int t,const GL_ObjectPtr& obj=GL_ObjectPtr())
+            :type(t),object(obj){}
+
+        int             type;
+        GL_ObjectPtr    object;
+        pi::SE3f        pose;
+    };
+
+    void run(Command& command);
+    bool cull();
+
+    ObjectPtrVec            children;
+    PrimitiveBatch          batched;
+    pi::MPSCQueue<Command>  commands;
+
+    bool                        culling;
+    float                       minPixels;
+    bool                        changed;    ///< children inserted or removed since the BVH was built
+    BVH                         bvh;
+    std::vector<BoundingBox>    boxes;      ///< per child
+    std::vector<int>            bounded;    ///< the children in the BVH
+    std::vector<int>            current;
+    std::vector<char>           visible;
+    CullStats                   stats;
 };
 
 }}
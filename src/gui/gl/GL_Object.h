@@ -4,10 +4,24 @@
 namespace pi{
 namespace gl{
 
+class PrimitiveBatch;
+struct BoundingBox;
+
 struct GL_Object
 {
+    virtual ~GL_Object(){}
+
     virtual void draw(){};
     virtual void fastDraw(){draw();}
+
+    /// Appends the object's points, lines or poses to the batch and
+    /// returns true, or returns false if the object has to draw itself.
+    virtual bool batch(PrimitiveBatch&) const {return false;}
+
+    /// Sets the box to the extent of what draw() draws, in the coordinates
+    /// it is drawn in, and returns true; objects returning false are never
+    /// culled.
+    virtual bool bounds(BoundingBox&){return false;}
 };
 
 }}
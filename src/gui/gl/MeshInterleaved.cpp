@@ -1,24 +1,184 @@
 #include "MeshInterleaved.h"
 #include <stdio.h>
+#include <string.h>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <stddef.h>
 #include <stdint.h>
 #include "OpenGL.h"
 #include "ply/TinyPly.h"
+#include "ply/PlyIO.h"
+#include "obj/ObjIO.h"
+#include "base/Thread/Event.h"
+#include "base/Thread/Mutex.h"
+#include "base/Thread/Thread.h"
 
 namespace pi {
 namespace gl{
 
 using namespace std;
 
+namespace {
+
+/// One vertex of the interleaved buffer.
+struct PackedVertex
+{
+    float   position[3];
+    float   normal[3];
+    uchar   color[4];
+};
+
+const size_t MIN_STREAM_BYTES = 64*1024;   // first capacity of a streaming buffer
+
+}
+
+/// Counts the vertices no face uses. The render thread only hands over
+/// the indices uploaded since the last check; the counting runs here.
+class MeshValidator
+{
+public:
+    MeshValidator():_stop(false),_reset(false),_vertexCount(0),_lone(0)
+    {
+        _thread.setName("MeshValidator");
+        _thread.startFunc([this](){run();});
+    }
+
+    ~MeshValidator()
+    {
+        {
+            pi::FastMutex::ScopedLock lock(_mutex);
+            _stop=true;
+        }
+        _wake.set();
+        _thread.join();
+    }
+
+    void post(bool reset,size_t vertexCount,const unsigned int* indices,size_t n)
+    {
+        {
+            pi::FastMutex::ScopedLock lock(_mutex);
+            if(reset){
+                _pending.clear();
+                _reset=true;
+            }
+            _pending.insert(_pending.end(),indices,indices+n);
+            _vertexCount=vertexCount;
+        }
+        _wake.set();
+    }
+
+    size_t lone() const {return _lone;}
+
+private:
+    void run()
+    {
+        std::vector<uchar>        used;
+        std::vector<unsigned int> work;
+        size_t usedCount=0,reported=0;
+        for(;;){
+            _wake.wait();
+            bool   reset;
+            size_t vertexCount;
+            {
+                pi::FastMutex::ScopedLock lock(_mutex);
+                if(_stop) return;
+                work.swap(_pending);
+                reset=_reset;
+                _reset=false;
+                vertexCount=_vertexCount;
+            }
+
+            if(reset){
+                used.assign(vertexCount,0);
+                usedCount=0;
+            }
+            else if(used.size()<vertexCount) used.resize(vertexCount,0);
+
+            size_t invalid=0;
+            for(size_t i=0;i<work.size();i++){
+                unsigned int v=work[i];
+                if(v>=used.size()) invalid++;
+                else if(!used[v]){
+                    used[v]=1;
+                    usedCount++;
+                }
+            }
+            work.clear();
+
+            size_t lone=vertexCount-usedCount;
+            _lone=lone;
+            if(invalid) fprintf(stderr,"\nThere were %lu face indices out of range!",(unsigned long)invalid);
+            if(lone&&lone!=reported) fprintf(stderr,"\nThere were %lu lone Vertices!",(unsigned long)lone);
+            reported=lone;
+        }
+    }
+
+    pi::Thread                _thread;
+    pi::FastMutex             _mutex;
+    pi::Event                 _wake;
+    bool                      _stop,_reset;
+    std::vector<unsigned int> _pending;
+    size_t                    _vertexCount;
+    std::atomic<size_t>       _lone;
+};
+
+
 MeshInterleaved::MeshInterleaved(unsigned int verticesPerFace)
-:_verticesPerFace(verticesPerFace),_currentNV(0),_currentNF(0),_vertexBuffer(0),
-  _colorEnabled(true),_updatingMesh(false),_displayMode(LineMode){}
+:_verticesPerFace(verticesPerFace),_colorEnabled(true),_updatingMesh(false),_displayMode(LineMode),
+  _uploadMode(StaticUpload),_persistent(false),_uploadedNV(0),_uploadedNF(0),
+  _uploadedNormals(false),_uploadedColors(false),
+  _dirtyVertexBegin(0),_dirtyVertexEnd(0),_dirtyFaceBegin(0),_dirtyFaceEnd(0),
+  _fence(0),_validator(0),_boundedNV(0)
+{
+    StreamBuffer none={0,0,0};
+    _vertexBuffer=_faceBuffer=none;
+}
+
+MeshInterleaved::MeshInterleaved(const MeshInterleaved& mesh)
+:GL_Object(mesh),_uploadMode(mesh._uploadMode),_persistent(false),_uploadedNV(0),_uploadedNF(0),
+  _uploadedNormals(false),_uploadedColors(false),
+  _dirtyVertexBegin(0),_dirtyVertexEnd(0),_dirtyFaceBegin(0),_dirtyFaceEnd(0),
+  _fence(0),_validator(0),_boundedNV(0)
+{
+    StreamBuffer none={0,0,0};
+    _vertexBuffer=_faceBuffer=none;
+    *this=mesh;
+}
+
+MeshInterleaved::~MeshInterleaved()
+{
+    // the GL buffers belong to a context which may be gone
+    delete _validator;
+}
+
+MeshInterleaved &MeshInterleaved::operator=(const MeshInterleaved &mesh)
+{
+    if(this==&mesh) return *this;
+    vertices=mesh.vertices;
+    faces=mesh.faces;
+    normals=mesh.normals;
+    colors=mesh.colors;
+    edges=mesh.edges;
+    texcoords=mesh.texcoords;
+    materialIndices=mesh.materialIndices;
+    textures=mesh.textures;
+    _verticesPerFace=mesh._verticesPerFace;
+    _colorEnabled=mesh._colorEnabled;
+    _updatingMesh=mesh._updatingMesh;
+    _displayMode=mesh._displayMode;
+    setValidation(mesh._validator!=0);
+    _uploadedNV=_uploadedNF=0;
+    _boundedNV=0;
+    return *this;
+}
 
 
 void MeshInterleaved::clear()
 {
+    _uploadedNV=_uploadedNF=_boundedNV=0;
     vertices.clear();
     faces.clear();
     normals.clear();
@@ -37,121 +197,76 @@ bool MeshInterleaved::writeOBJ(std::string filename)
     std::string filenameMaterial = filename + ".mtl";
     std::string filenameMaterialRelative = stem + ".mtl";
 
-
-    std::fstream file;
-    file.open(filenameObject.c_str(),std::ios::out);
-    if(!file.is_open()){
-        fprintf(stderr,"\nERROR: Could not open File %s for writing!",filenameObject.c_str());
-        return false;
-    }
-    else
-        fprintf(stderr,"\nOpen File %s for writing!",filenameObject.c_str());
-
-
     std::vector<std::string> materialNames;
     bool useTexture = textures.size() > 0
             && texcoords.size() == faces.size();
     if(useTexture){
-        fprintf(stderr,"\nThe Mesh has %li Textures of the following Sizes:\n",textures.size());
         for(size_t i=0;i<textures.size();i++){
-            fprintf(stderr," %i*%i",textures[i].width(),textures[i].height());
-            char buffer[500];
-            sprintf(buffer,"material%.5li",i);
+            char buffer[32];
+            snprintf(buffer,sizeof(buffer),"material%.5li",(long)i);
             materialNames.push_back(buffer);
         }
     }
 
-
-    file << "\n#Written from Volume";
-    std::cerr<<"#Written from Volume\n";
-    flush(std::cerr);
-    if(useTexture) file << "\nmtllib " << filenameMaterialRelative;
-    for(unsigned int i=0;i<vertices.size();i++){
-        file << "\nv " << vertices[i].x << " " << vertices[i].y << " " << vertices[i].z;
-        if(colors.size()){
-            file << " " << (float)(colors[i].x)/255.0f << " " << (float)(colors[i].y)/255.0f << " " << (float)(colors[i].z)/255.0f;
-        }
-    }
-
-    //Normals
-    std::cerr<<"#Writting normals.\n";
-    flush(std::cerr);
-    for(unsigned int i=0;i<normals.size();i++){
-        file << "\nvn " << normals[i].x << " " << normals[i].y << " " << normals[i].z;
-    }
-
-
-    //Texture
-    std::cerr<<"#Writting Texture.\n";
-    flush(std::cerr);
-    if(useTexture){
-        for(unsigned int t=0;t<texcoords.size();t++){
-            file << "\nvt " << texcoords[t].x << " " << texcoords[t].y;
-        }
-//		file << "\nusemtl material0";
-    }
-
-    if(normals.size()){
-        //Normals are given
-        for(unsigned int i=0;i<faces.size();i+=_verticesPerFace){
-            file << "\nf";
-            for(unsigned int j=0;j<_verticesPerFace;j++)
-                file << " " << faces[i+j]+1 << "//" << faces[i+j];
+    try{
+        pi::ObjWriter file(filenameObject);
+        file.comment("Written from Volume");
+        if(useTexture) file.line("mtllib",filenameMaterialRelative);
+
+        bool useColor = colors.size() == vertices.size();
+        for(size_t i=0;i<vertices.size();i++){
+            if(useColor)
+                file.vertex(vertices[i].x,vertices[i].y,vertices[i].z,
+                            colors[i].x/255.0f,colors[i].y/255.0f,colors[i].z/255.0f);
+            else
+                file.vertex(vertices[i].x,vertices[i].y,vertices[i].z);
         }
-    }
-    else{
-        //No normals
+        for(size_t i=0;i<normals.size();i++)
+            file.normal(normals[i].x,normals[i].y,normals[i].z);
         if(useTexture){
-            unsigned int currentMaterialNumber = 0;
-            unsigned int nextMaterialIndex = 0;
-            //No Normals, Texture Coordinates
-            for(unsigned int i=0;i<faces.size();i+=_verticesPerFace){
-                if(nextMaterialIndex==i){
-                    file << "\nusemtl " << materialNames[currentMaterialNumber++];
-                    nextMaterialIndex =
-                            materialIndices.size()>currentMaterialNumber ?
-                                    materialIndices[currentMaterialNumber] : faces.size();
-                }
-                file << "\nf";
-                for(unsigned int j=0;j<_verticesPerFace;j++)
-                    file << " " << faces[i+j]+1 << "/" << (i+j+1);
-            }
+            for(size_t t=0;t<texcoords.size();t++)
+                file.texcoord(texcoords[t].x,texcoords[t].y);
         }
-        else{
-            //No Texture, No Normals
-            for(unsigned int i=0;i<faces.size();i+=_verticesPerFace){
-                file << "\nf";
-                for(unsigned int j=0;j<_verticesPerFace;j++)
-                    file << " " << faces[i+j]+1;
+
+        // normals belong to the vertices, texture coordinates to the face corners
+        bool useNormals = normals.size() == vertices.size();
+        unsigned int currentMaterialNumber = 0;
+        size_t nextMaterialIndex = 0;
+        std::vector<unsigned int> corners(_verticesPerFace);
+        for(size_t i=0;i+_verticesPerFace<=faces.size();i+=_verticesPerFace){
+            if(useTexture&&nextMaterialIndex==i&&currentMaterialNumber<materialNames.size()){
+                file.line("usemtl",materialNames[currentMaterialNumber++]);
+                nextMaterialIndex =
+                        materialIndices.size()>currentMaterialNumber ?
+                                materialIndices[currentMaterialNumber] : faces.size();
             }
+            for(unsigned int j=0;j<_verticesPerFace;j++) corners[j]=i+j;
+            file.face(&faces[i],useTexture?&corners[0]:0,useNormals?&faces[i]:0,_verticesPerFace);
         }
-    }
-
+        file.close();
 
-    file.close();
-
-    if(useTexture){
-        std::fstream materialfile;
-        materialfile.open(filenameMaterial.c_str(),std::ios::out);
-        for(unsigned int i=0;i<textures.size();i++){
-            char filenameTexture[500]; sprintf(filenameTexture,"%s_%.5i.png",filename.c_str(),i);
-            char filenameTextureRelative[500]; sprintf(filenameTextureRelative,"%s_%.5i.png",stem.c_str(),i);
-            if(!materialfile.is_open()){
-                fprintf(stderr,"\nERROR: Could not open Material File %s for writing!",filenameMaterial.c_str());
-                return false;
+        if(useTexture){
+            pi::ObjWriter materialfile(filenameMaterial);
+            for(unsigned int i=0;i<textures.size();i++){
+                char filenameTexture[500]; snprintf(filenameTexture,sizeof(filenameTexture),"%s_%.5i.png",filename.c_str(),i);
+                char filenameTextureRelative[500]; snprintf(filenameTextureRelative,sizeof(filenameTextureRelative),"%s_%.5i.png",stem.c_str(),i);
+                materialfile.line("newmtl",materialNames[i]);
+                materialfile.line("Ka","1.000000 1.000000 1.000000");
+                materialfile.line("Kd","1.000000 1.000000 1.000000");
+                materialfile.line("Ks","0.000000 0.000000 0.000000");
+                materialfile.line("Tr","1.000000");
+                materialfile.line("illum","1");
+                materialfile.line("Ns","0.000000");
+                materialfile.line("map_Kd",filenameTextureRelative);
+                if(!textures[i].isNull()) textures[i].save(QString::fromLocal8Bit(filenameTexture));
             }
-            if(i) materialfile << "\n";
-            materialfile << "newmtl " << materialNames[i]
-                         << "\nKa 1.000000 1.000000 1.000000"
-                     << "\nKd 1.000000 1.000000 1.000000"
-                     << "\nKs 0.000000 0.000000 0.000000"
-                     << "\nTr 1.000000"
-                     << "\nillum 1"
-                     << "\nNs 0.000000"
-                     << "\nmap_Kd " << filenameTextureRelative;
-//            cv::imwrite(filenameTexture,textures[i]);
+            materialfile.close();
         }
-        materialfile.close();
+    }
+    catch(std::exception& e)
+    {
+        cerr<<"Failed to write mesh "<<filenameObject<<" since "<<e.what()<<endl;
+        return false;
     }
 
     return true;
@@ -159,65 +274,29 @@ bool MeshInterleaved::writeOBJ(std::string filename)
 
 
 bool MeshInterleaved::writePLY(std::string filename, bool binary){
-    std::fstream file;
-    file.open((filename+".ply").c_str(),std::ios::out|std::ios::binary);
-    if(!file.is_open()){
-        fprintf(stderr,"\nERROR: Could not open File %s for writing!",(filename+".ply").c_str());
-        return false;
-    }
-
-    file << "ply";
-    if(binary)file << "\nformat binary_little_endian 1.0";
-    else file << "\nformat ascii 1.0";
-    file << "\nelement vertex " << vertices.size();
-    file << "\nproperty float32 x\nproperty float32 y\nproperty float32 z";
-    if(colors.size())
-        file << "\nproperty uchar red\nproperty uchar green\nproperty uchar blue";
-    if(faces.size()){
-        file << "\nelement face " << faces.size()/_verticesPerFace;
-        file << "\nproperty list uint8 int32 vertex_indices";
-    }
-    if(edges.size()){
-        file << "\nElement edge " << edges.size()/2;
-        file << "\nproperty int vertex1\nproperty int vertex2";
-    }
-    file << "\nend_header";
-    if(binary) file << "\n";
-
-    for(unsigned int i=0;i<vertices.size();i++){
-        if(binary){
-            file.write((char*)(&(vertices[i])),sizeof(Vertex3f));
-        }
-        else file << "\n" << vertices[i].x << " " << vertices[i].y << " " << vertices[i].z;
-        if(colors.size()){
-            if(binary){
-                file.write((char*)(&(colors[i])),sizeof(Color3b));
-            }
-            else file << " " << (int)(colors[i].x) << " " << (int)(colors[i].y) << " " << (int)(colors[i].z);
+    try{
+        pi::PlyWriter ply(filename+".ply",binary);
+        ply.addElement("vertex",vertices.size());
+        if(vertices.size())
+            ply.addProperties({"x","y","z"},PlyProperty::Type::FLOAT32,&vertices[0].x,sizeof(Vertex3f));
+        if(colors.size()==vertices.size()&&colors.size())
+            ply.addProperties({"red","green","blue"},PlyProperty::Type::UINT8,&colors[0].x,sizeof(Color3b));
+        if(faces.size()){
+            ply.addElement("face",faces.size()/_verticesPerFace);
+            ply.addList("vertex_indices",PlyProperty::Type::UINT8,PlyProperty::Type::UINT32,
+                        faces.data(),_verticesPerFace);
         }
-    }
-    for(unsigned int i=0;i<faces.size();i+=_verticesPerFace){
-        if(binary){
-            file.write((char*)(&_verticesPerFace),sizeof(uchar));
+        if(edges.size()){
+            ply.addElement("edge",edges.size()/2);
+            ply.addProperties({"vertex1","vertex2"},PlyProperty::Type::UINT32,edges.data(),2*sizeof(unsigned int));
         }
-        else file << "\n" << (int)_verticesPerFace;
-        for(unsigned int j=0;j<_verticesPerFace;j++)
-            if(binary){
-                unsigned int idx = faces[i+j];
-                file.write((char*)(&idx),sizeof(unsigned int));
-            }
-            else file << " " << (faces[i+j]);
+        ply.write();
     }
-    for(unsigned int i=0;i<edges.size();i+=2){
-        if(binary){
-            unsigned int idx = edges[i];
-            file.write((char*)(&idx),sizeof(unsigned int));
-            idx = edges[i+1]; file.write((char*)(&idx),sizeof(unsigned int));
-        }
-        else file << "\n " << edges[i] << " " << edges[i+1];
+    catch(std::exception& e)
+    {
+        cerr<<"Failed to write mesh "<<filename<<".ply since "<<e.what()<<endl;
+        return false;
     }
-
-    file.close();
     return true;
 }
 
@@ -225,23 +304,58 @@ bool MeshInterleaved::writePLY(std::string filename, bool binary){
 bool MeshInterleaved::loadPLY(std::string filename)
 {
     try{
-        // Read the file and create a std::istringstream suitable
-        // for the lib -- tinyply does not perform any file i/o.
+        // Binary files are decoded straight from a memory mapping
+        pi::PlyReader ply(filename);
+        if(ply.isBinary())
+        {
+            clear();
+            vertices.resize(ply.count("vertex"));
+            if(vertices.empty()||
+               !ply.read("vertex",{"x","y","z"},&vertices[0].x,PlyProperty::Type::FLOAT32,sizeof(Vertex3f)))
+            {
+                clear();
+                return false;
+            }
+
+            if(ply.has("vertex","nx")){
+                normals.resize(vertices.size());
+                if(!ply.read("vertex",{"nx","ny","nz"},&normals[0].x,PlyProperty::Type::FLOAT32,sizeof(Vertex3f)))
+                    normals.clear();
+            }
+            if(ply.has("vertex","red")){
+                colors.resize(vertices.size());
+                if(!ply.read("vertex",{"red","green","blue"},&colors[0].x,PlyProperty::Type::UINT8,sizeof(Color3b)))
+                    colors.clear();
+            }
+
+            std::vector<uint32_t> counts;
+            int perFace=ply.readList("face","vertex_indices",faces,&counts);
+            if(perFace<0) perFace=ply.readList("face","vertex_index",faces,&counts);
+            if(perFace>0) _verticesPerFace=perFace;
+            else if(perFace==0) triangulate(counts);
+
+            if(ply.count("edge")){
+                edges.resize(ply.count("edge")*2);
+                if(!ply.read("edge",{"vertex1","vertex2"},&edges[0],PlyProperty::Type::UINT32,2*sizeof(unsigned int)))
+                    edges.clear();
+            }
+            return true;
+        }
+    }
+    catch(std::exception& e)
+    {
+        clear();
+        cerr<<"Failed to load mesh "<<filename<<" since "<<e.what()<<endl;
+        return false;
+    }
+
+    try{
+        // ASCII files go through tinyply
         std::ifstream ss(filename.c_str(), std::ios::binary);
 
         // Parse the ASCII header fields
         pi::PlyFile file(ss);
 
-//        for (PlyElement& e : file.get_elements())
-//        {
-//            std::cout << "element - " << e.name << " (" << e.size << ")" << std::endl;
-//            for (PlyProperty& p : e.properties)
-//            {
-//                std::cout << "\tproperty - " << p.name << " (" << PropertyTable[p.propertyType].str << ")" << std::endl;
-//            }
-//        }
-//        std::cout << std::endl;
-
         // Define containers to hold the extracted data. The type must match
         // the property type given in the header. Tinyply will interally allocate the
         // the appropriate amount of memory.
@@ -250,50 +364,39 @@ bool MeshInterleaved::loadPLY(std::string filename)
         std::vector<uint8_t> colors;
 
         std::vector<uint32_t> faces;
-        std::vector<float> uvCoords;
-        std::vector<uint8_t> faceColors;
 
-        uint32_t vertexCount, normalCount, colorCount, faceCount, faceTexcoordCount, faceColorCount;
-        vertexCount = normalCount = colorCount = faceCount = faceTexcoordCount = faceColorCount = 0;
+        uint32_t vertexCount, normalCount, colorCount, faceCount;
+        vertexCount = normalCount = colorCount = faceCount = 0;
 
         // The count returns the number of instances of the property group. The vectors
         // above will be resized into a multiple of the property group size as
         // they are "flattened"... i.e. verts = {x, y, z, x, y, z, ...}
         vertexCount = file.request_properties_from_element("vertex", {"x", "y", "z"}, verts);
         normalCount = file.request_properties_from_element("vertex", {"nx", "ny", "nz"}, norms);
-        colorCount = file.request_properties_from_element("vertex", {"red", "green", "blue", "alpha"}, colors);
+        colorCount = file.request_properties_from_element("vertex", {"red", "green", "blue"}, colors);
 
         // For properties that are list types, it is possibly to specify the expected count (ideal if a
         // consumer of this library knows the layout of their format a-priori). Otherwise, tinyply
         // defers allocation of memory until the first instance of the property has been found
         // as implemented in file.read(ss)
         faceCount = file.request_properties_from_element("face", {"vertex_indices"}, faces, 3);
-        faceTexcoordCount = file.request_properties_from_element("face", {"texcoord"}, uvCoords, 6);
-        faceColorCount = file.request_properties_from_element("face", {"red", "green", "blue", "alpha"}, faceColors);
 
         file.read(ss);
 
-        // Good place to put a breakpoint!
-//        std::cout << "\tRead " << verts.size() << " total vertices (" << vertexCount << " properties)." << std::endl;
-//        std::cout << "\tRead " << norms.size() << " total normals (" << normalCount << " properties)." << std::endl;
-//        std::cout << "\tRead " << colors.size() << " total vertex colors (" << colorCount << " properties)." << std::endl;
-//        std::cout << "\tRead " << faces.size() << " total faces (triangles) (" << faceCount << " properties)." << std::endl;
-//        std::cout << "\tRead " << uvCoords.size() << " total texcoords (" << faceTexcoordCount << " properties)." << std::endl;
-//        std::cout << "\tRead " << faceColors.size() << " total face colors (" << faceColorCount << " properties)." << std::endl;
-
-
         if(verts.size()!=vertexCount*3||norms.size()!=normalCount*3||colors.size()!=colorCount*3
-                ||faces.size()!=faceCount*3||uvCoords.size()!=faceTexcoordCount*2||faceColors.size()!=faceColorCount*3)
+                ||faces.size()!=faceCount*3)
         {
             return false;
         }
+        clear();
         vertices.resize(vertexCount);
         memcpy(vertices.data(),verts.data(),sizeof(Vertex3f)*vertexCount);
 
         normals.resize(normalCount);
-        memcpy(normals.data(),normals.data(),sizeof(Vertex3f)*normalCount);
+        memcpy(normals.data(),norms.data(),sizeof(Vertex3f)*normalCount);
 
         this->faces=faces;
+        _verticesPerFace=3;
 
         this->colors.resize(colorCount);
         memcpy(this->colors.data(),colors.data(),sizeof(Color3b)*colorCount);
@@ -304,112 +407,339 @@ bool MeshInterleaved::loadPLY(std::string filename)
         cerr<<"Failed to load mesh "<<filename<<" since "<<e.what()<<endl;
         return false;
     }
-    return false;
+    return true;
+}
+
+void MeshInterleaved::triangulate(const std::vector<uint32_t>& counts)
+{
+    // polygons of different sizes become triangle fans
+    std::vector<unsigned int> triangles;
+    triangles.reserve(faces.size()*2);
+    size_t pos=0;
+    for(size_t f=0;f<counts.size();f++){
+        for(uint32_t j=1;j+1<counts[f];j++){
+            triangles.push_back(faces[pos]);
+            triangles.push_back(faces[pos+j]);
+            triangles.push_back(faces[pos+j+1]);
+        }
+        pos+=counts[f];
+    }
+    faces.swap(triangles);
+    _verticesPerFace=3;
 }
 
 bool MeshInterleaved::loadOBJ(std::string filename)
 {
-    return false;
+    try{
+        pi::ObjReader obj(filename);
+        clear();
+
+        size_t n=obj.vertexCount();
+        vertices.resize(n);
+        const float* p=obj.positions().data();
+        for(size_t i=0;i<n;i++) vertices[i]=Vertex3f(p[i*3],p[i*3+1],p[i*3+2]);
+        if(obj.normals().size()){
+            normals.resize(n);
+            const float* v=obj.normals().data();
+            for(size_t i=0;i<n;i++) normals[i]=Vertex3f(v[i*3],v[i*3+1],v[i*3+2]);
+        }
+        if(obj.colors().size()){
+            colors.resize(n);
+            const float* c=obj.colors().data();
+            for(size_t i=0;i<n;i++)
+                colors[i]=Color3b(std::min(c[i*3]*255.0f+0.5f,255.0f),
+                                  std::min(c[i*3+1]*255.0f+0.5f,255.0f),
+                                  std::min(c[i*3+2]*255.0f+0.5f,255.0f));
+        }
+
+        faces.assign(obj.indices().begin(),obj.indices().end());
+        _verticesPerFace=3;
+
+        // texture coordinates are kept per face corner, as writeOBJ expects
+        if(obj.texcoords().size()){
+            const float* uv=obj.texcoords().data();
+            texcoords.resize(faces.size());
+            for(size_t k=0;k<faces.size();k++)
+                texcoords[k]=Vertex2f(uv[faces[k]*2],uv[faces[k]*2+1]);
+        }
+
+        // one texture per run of faces, each image loaded once
+        const std::vector<pi::ObjMaterial>& materials=obj.materials();
+        std::vector<QImage> images(materials.size());
+        std::vector<bool>   loaded(materials.size(),false);
+        for(size_t r=0;r<obj.materialRuns().size();r++){
+            int m=obj.materialRuns()[r].material;
+            if(m>=0&&!loaded[m]){
+                if(materials[m].diffuseMap.size())
+                    images[m]=QImage(QString::fromLocal8Bit(materials[m].diffuseMap.c_str()));
+                loaded[m]=true;
+            }
+            materialIndices.push_back(obj.materialRuns()[r].first);
+            textures.push_back(m>=0?images[m]:QImage());
+        }
+    }
+    catch(std::exception& e)
+    {
+        clear();
+        cerr<<"Failed to load mesh "<<filename<<" since "<<e.what()<<endl;
+        return false;
+    }
+    return true;
 }
 
 MeshInterleaved &MeshInterleaved::operator+=(const MeshInterleaved &mesh)
 {
+    merge(std::vector<const MeshInterleaved*>(1,&mesh),1);
+    return *this;
+}
 
-    unsigned int oldVertexSize = vertices.size();
-    unsigned int oldFaceSize = faces.size();
+void MeshInterleaved::setUploadMode(int mode)
+{
+    if(mode==_uploadMode) return;
+    _uploadMode=mode;
+    // the buffers are made again by the next draw
+    release();
+}
 
-    for(unsigned int i=0;i<mesh.vertices.size();i++){
-        vertices.push_back(mesh.vertices[i]);
+void MeshInterleaved::release()
+{
+    if(_vertexBuffer.id){
+        waitForGPU();
+        unsigned int ids[2]={_vertexBuffer.id,_faceBuffer.id};
+        glDeleteBuffers(2,ids);
     }
-    if(mesh.colors.size()){
-        for(unsigned int i=0;i<mesh.colors.size();i++){
-            colors.push_back(mesh.colors[i]);
-        }
+    StreamBuffer none={0,0,0};
+    _vertexBuffer=_faceBuffer=none;
+    _uploadedNV=_uploadedNF=0;
+}
+
+bool MeshInterleaved::bounds(BoundingBox& box)
+{
+    if(_boundedNV==0||_boundedNV>vertices.size()){
+        _bounds=BoundingBox();
+        _boundedNV=0;
     }
-    if(mesh.faces.size()){
-        for(unsigned int i=0;i<mesh.faces.size();i++){
-            faces.push_back(mesh.faces[i]+oldVertexSize);
-        }
+    if(_boundedNV<vertices.size()){
+        _bounds.extend(&vertices[_boundedNV].x,vertices.size()-_boundedNV);
+        _boundedNV=vertices.size();
     }
-    if(mesh.edges.size()){
-        for(unsigned int i=0;i<mesh.edges.size();i++){
-            edges.push_back(mesh.edges[i]+oldVertexSize);
-        }
+    box=_bounds;
+    return true;
+}
+
+void MeshInterleaved::invalidateVertices(size_t first, size_t count)
+{
+    if(!count) return;
+    _boundedNV=0;
+    if(_dirtyVertexBegin==_dirtyVertexEnd){
+        _dirtyVertexBegin=first;
+        _dirtyVertexEnd=first+count;
     }
+    else{
+        _dirtyVertexBegin=std::min(_dirtyVertexBegin,first);
+        _dirtyVertexEnd=std::max(_dirtyVertexEnd,first+count);
+    }
+}
 
-    if(mesh.textures.size()){
-        for(unsigned int i=0;i<mesh.textures.size();i++){
-            materialIndices.push_back(mesh.materialIndices[i]+oldFaceSize);
-            textures.push_back(mesh.textures[i]);
-        }
+void MeshInterleaved::invalidateFaces(size_t first, size_t count)
+{
+    if(!count) return;
+    if(_dirtyFaceBegin==_dirtyFaceEnd){
+        _dirtyFaceBegin=first;
+        _dirtyFaceEnd=first+count;
     }
-    if(mesh.texcoords.size()){
-        for(unsigned int i=0;i<mesh.texcoords.size();i++){
-            texcoords.push_back(mesh.texcoords[i]);
-        }
+    else{
+        _dirtyFaceBegin=std::min(_dirtyFaceBegin,first);
+        _dirtyFaceEnd=std::max(_dirtyFaceEnd,first+count);
     }
+}
 
-    return *this;
+void MeshInterleaved::setValidation(bool enable)
+{
+    if(enable==(_validator!=0)) return;
+    if(enable){
+        _validator=new MeshValidator;
+        _validator->post(true,vertices.size(),faces.data(),faces.size());
+    }
+    else{
+        delete _validator;
+        _validator=0;
+    }
+}
+
+size_t MeshInterleaved::loneVertices() const
+{
+    return _validator?_validator->lone():0;
 }
 
 void MeshInterleaved::generateBuffers(){
     glewInit();
-    glGenBuffers(1, &_vertexBuffer);
-    glGenBuffers(1, &_faceBuffer);
-    glGenBuffers(1, &_colorBuffer);
-    glGenBuffers(1, &_normalBuffer);
+    unsigned int ids[2];
+    glGenBuffers(2, ids);
+    _vertexBuffer.id=ids[0];
+    _faceBuffer.id=ids[1];
+    _persistent=_uploadMode==StreamingUpload&&GLEW_ARB_buffer_storage&&GLEW_ARB_sync;
 }
 
-void MeshInterleaved::draw()
+void MeshInterleaved::waitForGPU()
 {
-    if(faces.size()<1) return;
+    if(!_fence) return;
+    GLsync fence=(GLsync)_fence;
+    while(glClientWaitSync(fence,GL_SYNC_FLUSH_COMMANDS_BIT,1000000)==GL_TIMEOUT_EXPIRED);
+    glDeleteSync(fence);
+    _fence=0;
+}
 
-    if(vertices.size() != _currentNV ||
-            faces.size() != _currentNF){
-        if(!_vertexBuffer){
-            generateBuffers();
-        }
-        _currentNV = vertices.size();
-        _currentNF = faces.size();
-
-        glBindBuffer(GL_ARRAY_BUFFER,_vertexBuffer);
-        glBufferData(GL_ARRAY_BUFFER,vertices.size()*sizeof(Vertex3f),vertices.data(), GL_STATIC_DRAW);
-        if(colors.size()){
-            glBindBuffer(GL_ARRAY_BUFFER,_colorBuffer);
-            glBufferData(GL_ARRAY_BUFFER,colors.size()*3,colors.data(), GL_STATIC_DRAW);
+bool MeshInterleaved::reserve(unsigned int target, StreamBuffer& buffer, size_t bytes)
+{
+    if(bytes<=buffer.capacity&&buffer.id) return false;
+
+    size_t capacity=bytes;
+    if(_uploadMode==StreamingUpload)
+        capacity=std::max(std::max(buffer.capacity*2,bytes),MIN_STREAM_BYTES);
+
+    if(_persistent){
+        // the storage of a buffer is immutable, a larger one is a new buffer
+        waitForGPU();
+        if(buffer.mapped){
+            glBindBuffer(target,buffer.id);
+            glUnmapBuffer(target);
         }
+        if(buffer.id) glDeleteBuffers(1,&buffer.id);
+        glGenBuffers(1,&buffer.id);
+        glBindBuffer(target,buffer.id);
+        GLbitfield flags=GL_MAP_WRITE_BIT|GL_MAP_PERSISTENT_BIT|GL_MAP_COHERENT_BIT;
+        glBufferStorage(target,capacity,0,flags);
+        buffer.mapped=glMapBufferRange(target,0,capacity,flags);
+    }
+    else{
+        glBindBuffer(target,buffer.id);
+        glBufferData(target,capacity,0,_uploadMode==StreamingUpload?GL_DYNAMIC_DRAW:GL_STATIC_DRAW);
+    }
+    buffer.capacity=capacity;
+    return true;
+}
 
-        if(faces.size()){
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,_faceBuffer);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size()*sizeof(unsigned int),
-                         faces.data(), GL_STATIC_DRAW);
-        }
+void MeshInterleaved::uploadRange(unsigned int target, StreamBuffer& buffer, size_t used,
+                                  size_t first, size_t last, const void* data)
+{
+    if(first>=last) return;
+    if(buffer.mapped){
+        waitForGPU();
+        memcpy((char*)buffer.mapped+first,(const char*)data+first,last-first);
+        return;
+    }
 
-        std::vector<bool> checks(vertices.size(),false);
-        for(size_t i=0;i<faces.size();i++)
-            checks[faces[i]] = true;
+    glBindBuffer(target,buffer.id);
+    if(_uploadMode==StreamingUpload&&last-first>used/2){
+        // most of it changes: orphan the storage instead of waiting for
+        // draws still reading it
+        glBufferData(target,buffer.capacity,0,GL_DYNAMIC_DRAW);
+        glBufferSubData(target,0,used,data);
+    }
+    else
+        glBufferSubData(target,first,last-first,(const char*)data+first);
+}
 
-        bool loneVertex = false;
-        for(size_t i=0;i<checks.size();i++) loneVertex |= !checks[i];
-        if(loneVertex){
-            fprintf(stderr,"\nThere were lone Vertices!");
+void MeshInterleaved::packVertices(size_t first, size_t last, void* dest) const
+{
+    bool hasNormals=normals.size()==vertices.size();
+    bool hasColors=colors.size()==vertices.size();
+    PackedVertex* out=(PackedVertex*)dest;
+    for(size_t i=first;i<last;i++,out++){
+        out->position[0]=vertices[i].x;
+        out->position[1]=vertices[i].y;
+        out->position[2]=vertices[i].z;
+        if(hasNormals){
+            out->normal[0]=normals[i].x;
+            out->normal[1]=normals[i].y;
+            out->normal[2]=normals[i].z;
+        }
+        else out->normal[0]=out->normal[1]=out->normal[2]=0;
+        if(hasColors){
+            out->color[0]=colors[i].x;
+            out->color[1]=colors[i].y;
+            out->color[2]=colors[i].z;
         }
-//        printf("\nMesh Check done");
+        else out->color[0]=out->color[1]=out->color[2]=128;
+        out->color[3]=255;
     }
+}
 
+void MeshInterleaved::upload()
+{
+    size_t nv=vertices.size(),nf=faces.size();
+    bool   hasNormals=normals.size()==nv,hasColors=colors.size()==nv;
+
+    // what changed since the last draw
+    size_t vertexBegin=_uploadedNV,vertexEnd=nv;
+    if(nv<_uploadedNV||hasNormals!=_uploadedNormals||hasColors!=_uploadedColors) vertexBegin=0;
+    if(_dirtyVertexBegin<_dirtyVertexEnd){
+        vertexBegin=std::min(vertexBegin,_dirtyVertexBegin);
+        vertexEnd=std::max(vertexEnd,std::min(_dirtyVertexEnd,nv));
+    }
+    size_t faceBegin=nf<_uploadedNF?0:_uploadedNF,faceEnd=nf;
+    if(_dirtyFaceBegin<_dirtyFaceEnd){
+        faceBegin=std::min(faceBegin,_dirtyFaceBegin);
+        faceEnd=std::max(faceEnd,std::min(_dirtyFaceEnd,nf));
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER,_vertexBuffer);
-    glVertexPointer(3, GL_FLOAT, 0, 0);
-    if(colors.size()){
-        glBindBuffer(GL_ARRAY_BUFFER,_colorBuffer);
-        glColorPointer(3, GL_UNSIGNED_BYTE, 0, 0);
+    if(_validator&&(faceBegin<faceEnd||nv!=_uploadedNV)){
+        // indices changed in place may free vertices, so count again
+        bool reset=faceBegin==0||faceBegin<_uploadedNF||nv<_uploadedNV;
+        if(reset) _validator->post(true,nv,faces.data(),nf);
+        else _validator->post(false,nv,faces.data()+faceBegin,faceEnd-faceBegin);
     }
-    else{
-        glColor3f(0.5f,0.5f,0.5f);
+
+    if(reserve(GL_ARRAY_BUFFER,_vertexBuffer,nv*sizeof(PackedVertex))) vertexBegin=0;
+    if(vertexBegin<vertexEnd){
+        size_t first=vertexBegin*sizeof(PackedVertex),last=vertexEnd*sizeof(PackedVertex);
+        if(_vertexBuffer.mapped){
+            waitForGPU();
+            packVertices(vertexBegin,vertexEnd,(char*)_vertexBuffer.mapped+first);
+        }
+        else{
+            // the whole buffer is needed when it gets orphaned
+            bool whole=_uploadMode==StreamingUpload&&last-first>nv*sizeof(PackedVertex)/2;
+            if(whole) vertexBegin=0;
+            _staging.resize(nv*sizeof(PackedVertex));
+            packVertices(vertexBegin,vertexEnd,&_staging[vertexBegin*sizeof(PackedVertex)]);
+            uploadRange(GL_ARRAY_BUFFER,_vertexBuffer,nv*sizeof(PackedVertex),
+                        vertexBegin*sizeof(PackedVertex),last,_staging.data());
+        }
     }
 
+    if(reserve(GL_ELEMENT_ARRAY_BUFFER,_faceBuffer,nf*sizeof(unsigned int))) faceBegin=0;
+    if(faceBegin<faceEnd)
+        uploadRange(GL_ELEMENT_ARRAY_BUFFER,_faceBuffer,nf*sizeof(unsigned int),
+                    faceBegin*sizeof(unsigned int),faceEnd*sizeof(unsigned int),faces.data());
+
+    _uploadedNV=nv;
+    _uploadedNF=nf;
+    _uploadedNormals=hasNormals;
+    _uploadedColors=hasColors;
+    _dirtyVertexBegin=_dirtyVertexEnd=0;
+    _dirtyFaceBegin=_dirtyFaceEnd=0;
+}
+
+void MeshInterleaved::draw()
+{
+    if(vertices.empty()) return;
+    if(faces.empty()&&_displayMode!=PointCloudMode) return;
+
+    if(!_vertexBuffer.id) generateBuffers();
+    upload();
+
+    const GLsizei stride=sizeof(PackedVertex);
+    glBindBuffer(GL_ARRAY_BUFFER,_vertexBuffer.id);
+    glVertexPointer(3, GL_FLOAT, stride, (void*)offsetof(PackedVertex,position));
     glEnableClientState(GL_VERTEX_ARRAY);
-    if(_colorEnabled&&colors.size()==vertices.size()) {
+    if(_uploadedNormals){
+        glNormalPointer(GL_FLOAT, stride, (void*)offsetof(PackedVertex,normal));
+        glEnableClientState(GL_NORMAL_ARRAY);
+    }
+    if(_colorEnabled&&_uploadedColors) {
+        glColorPointer(3, GL_UNSIGNED_BYTE, stride, (void*)offsetof(PackedVertex,color));
         glEnableClientState(GL_COLOR_ARRAY);
     }
     else{
@@ -429,15 +759,24 @@ void MeshInterleaved::draw()
 
     if(_displayMode==PointCloudMode){
         glPointSize(2.0);
-        glBindBuffer(GL_ARRAY_BUFFER,_vertexBuffer);
         glDrawArrays(GL_POINTS,0,vertices.size());
     }
     else{
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,_faceBuffer.id);
         glDrawElements(GL_TRIANGLES, faces.size(), GL_UNSIGNED_INT,0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
     }
 
-    if(_colorEnabled&&colors.size()==vertices.size()) glDisableClientState(GL_COLOR_ARRAY);
+    if(_colorEnabled&&_uploadedColors) glDisableClientState(GL_COLOR_ARRAY);
+    if(_uploadedNormals) glDisableClientState(GL_NORMAL_ARRAY);
     glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+
+    // the next write into the mapped buffers waits for this draw
+    if(_persistent){
+        if(_fence) glDeleteSync((GLsync)_fence);
+        _fence=glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+    }
 }
 
 }}
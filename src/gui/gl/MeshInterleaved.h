@@ -1,8 +1,10 @@
 #ifndef MESHINTERLEAVED_H
 #define MESHINTERLEAVED_H
 #include "GL_Object.h"
+#include "Culling.h"
 #include "base/Types/Point.h"
 #include <vector>
+#include <stdint.h>
 #include <QImage>
 
 namespace pi{
@@ -13,6 +15,8 @@ typedef pi::Point2f Vertex2f;
 typedef pi::Point3ub Color3b;
 typedef unsigned char uchar;
 
+class MeshValidator;
+
 class MeshInterleaved : public GL_Object
 {
 public:
@@ -22,9 +26,24 @@ public:
         LineMode=1,
         PointCloudMode=2
     };
+
+    enum UploadMode
+    {
+        StaticUpload=0,     ///< buffers of the exact size, rewritten when the mesh changes
+        StreamingUpload=1   ///< buffers grow by doubling, only changed ranges are written
+    };
+
     MeshInterleaved(unsigned int verticesPerFace=3);
+    MeshInterleaved(const MeshInterleaved& mesh);
+    ~MeshInterleaved();
 
+    MeshInterleaved &operator=(const MeshInterleaved &mesh);
+        /// Copies the mesh data; the copy gets its own GL buffers.
     MeshInterleaved &operator+=(const MeshInterleaved &mesh);
+    void merge(const std::vector<const MeshInterleaved*>& meshes, int threads=-1);
+        /// Appends all meshes at once: every array grows once and the
+        /// meshes are copied on threads threads, -1 for one per processor.
+        /// Normals and colors are kept where all meshes have them.
 
     void clear();
 
@@ -35,6 +54,62 @@ public:
     bool writePLY(std::string filename, bool binary = true);
 
     virtual void draw();
+        /// Draws the mesh from one interleaved position/normal/color
+        /// buffer and an index buffer. Vertices and faces appended since
+        /// the last draw are uploaded; changes in place must be announced
+        /// with invalidateVertices() and invalidateFaces().
+
+    virtual bool bounds(BoundingBox& box);
+        /// The box around the vertices, extended as vertices are appended
+        /// and computed again after invalidateVertices() or clear().
+
+    void setUploadMode(int mode);
+        /// StaticUpload by default. StreamingUpload suits meshes which grow
+        /// every frame; it maps the buffers persistently where
+        /// GL_ARB_buffer_storage is available and orphans them otherwise.
+
+    void release();
+        /// Deletes the GL buffers, with the context which drew the mesh
+        /// current; the next draw uploads the mesh again. The destructor
+        /// leaves them to the context, which may be gone.
+
+    void invalidateVertices(size_t first, size_t count);
+        /// Marks vertices, normals or colors changed in place.
+    void invalidateFaces(size_t first, size_t count);
+        /// Marks face indices changed in place.
+
+    // Processing of triangle meshes; threads is the number of threads,
+    // -1 for one per processor. The results are uploaded in full by the
+    // next draw.
+
+    size_t weldVertices(float epsilon,int threads=-1);
+        /// Merges vertices at most epsilon apart, found through a spatial
+        /// hash, into the one with the lowest index, whose attributes are
+        /// kept; 0 merges equal positions only. Triangles which collapse are
+        /// removed. Returns the number of vertices removed.
+        /// Texture coordinates belong to the face corners and are kept.
+
+    void computeNormals(int threads=-1);
+        /// Sets per-vertex normals to the area weighted mean of the normals
+        /// of the triangles around each vertex.
+
+    size_t decimate(size_t targetFaces,float maxError=1e30f,int threads=-1);
+        /// Collapses the edges of least quadric error until at most
+        /// targetFaces triangles are left or every collapse would move the
+        /// surface more than sqrt(maxError). Collapses which flip triangles
+        /// are skipped and boundaries are kept in place. Normals, if there
+        /// were any, are computed again. Returns the triangles removed.
+
+    void optimizeVertexCache(unsigned int cacheSize=32);
+        /// Reorders the triangles of each material for a post-transform
+        /// vertex cache of cacheSize entries, then the vertices in the
+        /// order the triangles first use them.
+
+    void   setValidation(bool enable);
+        /// Checks for vertices no face uses on a worker thread whenever the
+        /// faces are uploaded, and reports them to stderr. Off by default.
+    size_t loneVertices() const;
+        /// The result of the last check, 0 if validation is off.
 
     std::vector<Vertex3f>       vertices;
     std::vector<unsigned int>   faces;
@@ -45,22 +120,45 @@ public:
 
     uchar                       _verticesPerFace;
 
-    // gl buffer things
-    unsigned int                _currentNV,_currentNF;
-    uint                        _vertexBuffer;
-    uint                        _faceBuffer;
-    uint                        _edgeBuffer;
-    uint                        _normalBuffer;
-    uint                        _colorBuffer;
-
     bool                        _colorEnabled,_updatingMesh;
     int                         _displayMode;
 
 protected:
+    struct StreamBuffer
+        /// A GL buffer object and the part of it in use.
+    {
+        unsigned int id;
+        size_t       capacity;      ///< bytes
+        void*        mapped;        ///< the persistent mapping, or null
+    };
+
     void generateBuffers();
+    void upload();
+    void uploadRange(unsigned int target, StreamBuffer& buffer, size_t used,
+                     size_t first, size_t last, const void* data);
+    bool reserve(unsigned int target, StreamBuffer& buffer, size_t bytes);
+    void waitForGPU();
+    void packVertices(size_t first, size_t last, void* dest) const;
+    void triangulate(const std::vector<uint32_t>& counts);
+    void remapVertices(const std::vector<unsigned int>& remap,const std::vector<unsigned int>& order,int threads);
+    void removeFaces(const std::vector<char>& keep);
 
     std::vector<unsigned int>   materialIndices;
     std::vector<QImage>         textures;
+
+    // gl buffer things
+    int                         _uploadMode;
+    bool                        _persistent;
+    StreamBuffer                _vertexBuffer, _faceBuffer;
+    size_t                      _uploadedNV, _uploadedNF;
+    bool                        _uploadedNormals, _uploadedColors;
+    size_t                      _dirtyVertexBegin, _dirtyVertexEnd;
+    size_t                      _dirtyFaceBegin, _dirtyFaceEnd;
+    std::vector<char>           _staging;
+    void*                       _fence;         ///< GLsync of the last draw
+    MeshValidator*              _validator;
+    BoundingBox                 _bounds;
+    size_t                      _boundedNV;     ///< vertices inside _bounds
 };
 
 }}
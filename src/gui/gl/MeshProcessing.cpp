@@ -0,0 +1,737 @@
+#include "MeshInterleaved.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "base/Thread/AtomicCounter.h"
+#include "base/Thread/Thread.h"
+#include "base/Utils/Environment.h"
+
+// Processing members of MeshInterleaved: merging, welding, normals,
+// decimation and vertex cache ordering.
+
+namespace pi{
+namespace gl{
+
+namespace {
+
+/// Elements per task of the parallel loops.
+const size_t GRAIN=1<<15;
+
+const unsigned int NONE=~0u;
+
+/// Scales the planes through boundary edges, which keep boundaries in place.
+const double BOUNDARY_WEIGHT=100.;
+
+int threadCount(int threads)
+{
+    return threads<0?std::max(1,(int)pi::Environment::processorCount()):std::max(1,threads);
+}
+
+/// Calls func(first,last) for ranges of [0,n) on threads workers, the
+/// calling thread included.
+template<class F>
+void parallelRanges(size_t n,int threads,F func)
+{
+    size_t tasks=(n+GRAIN-1)/GRAIN;
+    if(threads<=1||tasks<=1){
+        if(n) func((size_t)0,n);
+        return;
+    }
+
+    pi::AtomicCounter next(0);
+    auto work=[&](){
+        for(;;){
+            size_t task=(size_t)(next++);
+            if(task>=tasks) break;
+            func(task*GRAIN,std::min(n,(task+1)*GRAIN));
+        }
+    };
+
+    int workers=(int)std::min((size_t)threads,tasks)-1;
+    std::vector<pi::Thread*> pool;
+    for(int i=0;i<workers;i++){
+        pool.push_back(new pi::Thread);
+        pool.back()->setName("MeshWorker");
+        pool.back()->startFunc(work);
+    }
+    work();
+    for(size_t i=0;i<pool.size();i++){
+        pool[i]->join();
+        delete pool[i];
+    }
+}
+
+/// For every vertex the triangles using it, as offsets into one list.
+void vertexTriangles(const std::vector<unsigned int>& faces,size_t nv,
+                     std::vector<unsigned int>& offsets,std::vector<unsigned int>& triangles)
+{
+    offsets.assign(nv+1,0);
+    for(size_t k=0;k<faces.size();k++) offsets[faces[k]+1]++;
+    for(size_t v=0;v<nv;v++) offsets[v+1]+=offsets[v];
+    triangles.resize(faces.size());
+    std::vector<unsigned int> fill(offsets.begin(),offsets.end()-1);
+    for(size_t k=0;k<faces.size();k++) triangles[fill[faces[k]]++]=(unsigned int)(k/3);
+}
+
+/// A symmetric 4x4 matrix summing the squared distances to planes.
+struct Quadric
+{
+    Quadric(){memset(a,0,sizeof(a));}
+
+    void addPlane(double nx,double ny,double nz,double d,double w)
+    {
+        a[0]+=w*nx*nx; a[1]+=w*nx*ny; a[2]+=w*nx*nz; a[3]+=w*nx*d;
+        a[4]+=w*ny*ny; a[5]+=w*ny*nz; a[6]+=w*ny*d;
+        a[7]+=w*nz*nz; a[8]+=w*nz*d;
+        a[9]+=w*d*d;
+    }
+
+    Quadric& operator+=(const Quadric& q)
+    {
+        for(int i=0;i<10;i++) a[i]+=q.a[i];
+        return *this;
+    }
+
+    double error(const Vertex3f& p) const
+    {
+        double x=p.x,y=p.y,z=p.z;
+        return a[0]*x*x+2*a[1]*x*y+2*a[2]*x*z+2*a[3]*x
+              +a[4]*y*y+2*a[5]*y*z+2*a[6]*y
+              +a[7]*z*z+2*a[8]*z
+              +a[9];
+    }
+
+    bool minimum(Vertex3f& p) const
+        /// The point of least error, unless the planes are nearly parallel.
+    {
+        double det=a[0]*(a[4]*a[7]-a[5]*a[5])-a[1]*(a[1]*a[7]-a[5]*a[2])+a[2]*(a[1]*a[5]-a[4]*a[2]);
+        double scale=a[0]+a[4]+a[7];
+        if(fabs(det)<=1e-9*scale*scale*scale||scale<=0) return false;
+        double b0=-a[3],b1=-a[6],b2=-a[8];
+        double x=(b0*(a[4]*a[7]-a[5]*a[5])-a[1]*(b1*a[7]-a[5]*b2)+a[2]*(b1*a[5]-a[4]*b2))/det;
+        double y=(a[0]*(b1*a[7]-b2*a[5])-b0*(a[1]*a[7]-a[5]*a[2])+a[2]*(a[1]*b2-b1*a[2]))/det;
+        double z=(a[0]*(a[4]*b2-a[5]*b1)-a[1]*(a[1]*b2-b1*a[2])+b0*(a[1]*a[5]-a[4]*a[2]))/det;
+        p=Vertex3f((float)x,(float)y,(float)z);
+        return true;
+    }
+
+    double a[10];   ///< xx xy xz xw yy yz yw zz zw ww
+};
+
+/// A candidate collapse of edge u,v to pos, valid while the stamps of both
+/// vertices are unchanged.
+struct Collapse
+{
+    float        cost;
+    unsigned int u,v;
+    unsigned int stampU,stampV;
+    Vertex3f     pos;
+
+    bool operator<(const Collapse& c) const{return cost>c.cost;}
+};
+
+Collapse bestCollapse(const std::vector<Quadric>& quadrics,const std::vector<Vertex3f>& vertices,
+                      unsigned int u,unsigned int v)
+{
+    Quadric q=quadrics[u];
+    q+=quadrics[v];
+    Collapse c;
+    c.u=u;
+    c.v=v;
+    c.stampU=c.stampV=0;
+    Vertex3f candidates[3]={vertices[u],vertices[v],(vertices[u]+vertices[v])*0.5f};
+    double   best=1e300;
+    Vertex3f p;
+    if(q.minimum(p)){
+        best=q.error(p);
+        c.pos=p;
+    }
+    for(int i=0;i<3;i++){
+        double e=q.error(candidates[i]);
+        if(e<best){
+            best=e;
+            c.pos=candidates[i];
+        }
+    }
+    c.cost=(float)std::max(best,0.);
+    return c;
+}
+
+/// Tom Forsyth's vertex score for a vertex at position in the cache, -1
+/// if it is not cached, with triangles left to draw.
+float vertexScore(int position,unsigned int triangles,unsigned int cacheSize)
+{
+    if(!triangles) return -1.f;
+    float score=0;
+    if(position>=0){
+        if(position<3) score=0.75f;
+        else score=powf(1.f-(position-3)/(float)(cacheSize-3),1.5f);
+    }
+    return score+2.f*powf((float)triangles,-0.5f);
+}
+
+}
+
+void MeshInterleaved::merge(const std::vector<const MeshInterleaved*>& meshes,int threads)
+{
+    for(size_t m=0;m<meshes.size();m++){
+        if(meshes[m]!=this) continue;
+        // appending to itself, the source must not move while it grows
+        MeshInterleaved copy(*this);
+        std::vector<const MeshInterleaved*> sources(meshes);
+        for(size_t k=0;k<sources.size();k++) if(sources[k]==this) sources[k]=&copy;
+        merge(sources,threads);
+        return;
+    }
+    threads=threadCount(threads);
+
+    size_t nv=vertices.size(),nf=faces.size(),ne=edges.size();
+    bool   withNormals=normals.size()==nv,withColors=colors.size()==nv,withTexcoords=texcoords.size()==nf;
+    std::vector<size_t> vertexOffsets(1,nv),faceOffsets(1,nf),edgeOffsets(1,ne);
+    for(size_t m=0;m<meshes.size();m++){
+        const MeshInterleaved& mesh=*meshes[m];
+        withNormals&=mesh.normals.size()==mesh.vertices.size();
+        withColors&=mesh.colors.size()==mesh.vertices.size();
+        withTexcoords&=mesh.texcoords.size()==mesh.faces.size();
+        vertexOffsets.push_back(vertexOffsets.back()+mesh.vertices.size());
+        faceOffsets.push_back(faceOffsets.back()+mesh.faces.size());
+        edgeOffsets.push_back(edgeOffsets.back()+mesh.edges.size());
+    }
+    size_t totalVertices=vertexOffsets.back(),totalFaces=faceOffsets.back();
+
+    vertices.resize(totalVertices);
+    faces.resize(totalFaces);
+    edges.resize(edgeOffsets.back());
+    if(withNormals) normals.resize(totalVertices);
+    else normals.clear();
+    if(withColors) colors.resize(totalVertices);
+    else colors.clear();
+    if(withTexcoords) texcoords.resize(totalFaces);
+    else texcoords.clear();
+
+    // the appended elements in pieces of GRAIN, across mesh borders
+    auto pieces=[&](const std::vector<size_t>& offsets,const std::function<void(size_t,size_t,size_t)>& copy){
+        size_t first=offsets.front(),n=offsets.back()-first;
+        parallelRanges(n,threads,[&](size_t begin,size_t end){
+            begin+=first;
+            end+=first;
+            size_t m=std::upper_bound(offsets.begin(),offsets.end(),begin)-offsets.begin()-1;
+            for(;begin<end;m++){
+                size_t last=std::min(end,offsets[m+1]);
+                if(last>begin) copy(m,begin-offsets[m],last-begin);
+                begin=last;
+            }
+        });
+    };
+
+    pieces(vertexOffsets,[&](size_t m,size_t from,size_t n){
+        const MeshInterleaved& mesh=*meshes[m];
+        size_t to=vertexOffsets[m]+from;
+        memcpy(&vertices[to],&mesh.vertices[from],n*sizeof(Vertex3f));
+        if(withNormals) memcpy(&normals[to],&mesh.normals[from],n*sizeof(Vertex3f));
+        if(withColors) memcpy(&colors[to],&mesh.colors[from],n*sizeof(Color3b));
+    });
+    pieces(faceOffsets,[&](size_t m,size_t from,size_t n){
+        const MeshInterleaved& mesh=*meshes[m];
+        unsigned int offset=(unsigned int)vertexOffsets[m];
+        size_t       to=faceOffsets[m]+from;
+        for(size_t i=0;i<n;i++) faces[to+i]=mesh.faces[from+i]+offset;
+        if(withTexcoords) memcpy(&texcoords[to],&mesh.texcoords[from],n*sizeof(Vertex2f));
+    });
+    pieces(edgeOffsets,[&](size_t m,size_t from,size_t n){
+        const MeshInterleaved& mesh=*meshes[m];
+        unsigned int offset=(unsigned int)vertexOffsets[m];
+        for(size_t i=0;i<n;i++) edges[edgeOffsets[m]+from+i]=mesh.edges[from+i]+offset;
+    });
+
+    for(size_t m=0;m<meshes.size();m++){
+        const MeshInterleaved& mesh=*meshes[m];
+        for(size_t i=0;i<mesh.textures.size()&&i<mesh.materialIndices.size();i++){
+            materialIndices.push_back(mesh.materialIndices[i]+(unsigned int)faceOffsets[m]);
+            textures.push_back(mesh.textures[i]);
+        }
+    }
+}
+
+void MeshInterleaved::remapVertices(const std::vector<unsigned int>& remap,const std::vector<unsigned int>& order,int threads)
+{
+    size_t nv=vertices.size(),n=order.size();
+    bool   withNormals=normals.size()==nv,withColors=colors.size()==nv;
+
+    std::vector<Vertex3f> newVertices(n),newNormals(withNormals?n:0);
+    std::vector<Color3b>  newColors(withColors?n:0);
+    parallelRanges(n,threads,[&](size_t first,size_t last){
+        for(size_t i=first;i<last;i++){
+            newVertices[i]=vertices[order[i]];
+            if(withNormals) newNormals[i]=normals[order[i]];
+            if(withColors) newColors[i]=colors[order[i]];
+        }
+    });
+    parallelRanges(faces.size(),threads,[&](size_t first,size_t last){
+        for(size_t k=first;k<last;k++) faces[k]=remap[faces[k]];
+    });
+
+    size_t kept=0;
+    for(size_t k=0;k+1<edges.size();k+=2){
+        unsigned int a=remap[edges[k]],b=remap[edges[k+1]];
+        if(a==b) continue;
+        edges[kept++]=a;
+        edges[kept++]=b;
+    }
+    edges.resize(kept);
+
+    vertices.swap(newVertices);
+    if(withNormals) normals.swap(newNormals);
+    if(withColors) colors.swap(newColors);
+    _uploadedNV=_uploadedNF=_boundedNV=0;
+}
+
+void MeshInterleaved::removeFaces(const std::vector<char>& keep)
+{
+    size_t nt=faces.size()/3;
+    bool   withTexcoords=texcoords.size()==faces.size();
+    std::vector<unsigned int> keptBefore(nt+1,0);
+    size_t kept=0;
+    for(size_t t=0;t<nt;t++){
+        keptBefore[t]=(unsigned int)kept;
+        if(!keep[t]) continue;
+        if(kept!=t){
+            memmove(&faces[kept*3],&faces[t*3],3*sizeof(unsigned int));
+            if(withTexcoords) memmove(&texcoords[kept*3],&texcoords[t*3],3*sizeof(Vertex2f));
+        }
+        kept++;
+    }
+    keptBefore[nt]=(unsigned int)kept;
+    faces.resize(kept*3);
+    if(withTexcoords) texcoords.resize(kept*3);
+    for(size_t i=0;i<materialIndices.size();i++)
+        materialIndices[i]=keptBefore[std::min<size_t>(materialIndices[i]/3,nt)]*3;
+    _uploadedNF=0;
+}
+
+size_t MeshInterleaved::weldVertices(float epsilon,int threads)
+{
+    size_t nv=vertices.size();
+    if(!nv||_verticesPerFace!=3) return 0;
+    threads=threadCount(threads);
+
+    // cells twice epsilon wide: a vertex closer than epsilon to one of
+    // the two cells along each axis lies in the cell it is closer to
+    bool  exact=epsilon<=0;
+    float inv=exact?0.f:0.5f/epsilon,epsilon2=epsilon*epsilon;
+    auto cellKey=[&](int64_t x,int64_t y,int64_t z)->uint64_t{
+        uint64_t h=(uint64_t)x*0x9E3779B97F4A7C15ULL;
+        h^=(uint64_t)y*0xC2B2AE3D27D4EB4FULL+(h<<6)+(h>>2);
+        h^=(uint64_t)z*0x165667B19E3779F9ULL+(h<<6)+(h>>2);
+        return h;
+    };
+    auto exactKey=[&](const Vertex3f& p)->uint64_t{
+        int32_t b[3];
+        float   c[3]={p.x+0.f,p.y+0.f,p.z+0.f};     // -0 and 0 alike
+        memcpy(b,c,sizeof(b));
+        return cellKey(b[0],b[1],b[2]);
+    };
+
+    std::vector<std::pair<uint64_t,unsigned int> > cells(nv);
+    parallelRanges(nv,threads,[&](size_t first,size_t last){
+        for(size_t i=first;i<last;i++){
+            const Vertex3f& p=vertices[i];
+            uint64_t key=exact?exactKey(p):cellKey((int64_t)floorf(p.x*inv),(int64_t)floorf(p.y*inv),(int64_t)floorf(p.z*inv));
+            cells[i]=std::make_pair(key,(unsigned int)i);
+        }
+    });
+    std::sort(cells.begin(),cells.end());
+
+    // each vertex finds the lowest index within epsilon
+    std::vector<unsigned int> rep(nv);
+    parallelRanges(nv,threads,[&](size_t first,size_t last){
+        for(size_t i=first;i<last;i++){
+            const Vertex3f& p=vertices[i];
+            unsigned int best=(unsigned int)i;
+            int64_t c[3]={0,0,0},d[3]={0,0,0};
+            if(!exact){
+                float f[3]={p.x*inv,p.y*inv,p.z*inv};
+                for(int a=0;a<3;a++){
+                    float cell=floorf(f[a]);
+                    c[a]=(int64_t)cell;
+                    d[a]=f[a]-cell<0.5f?-1:1;
+                }
+            }
+            for(int n=0;n<(exact?1:8);n++){
+                uint64_t key=exact?exactKey(p):cellKey(c[0]+(n&1?d[0]:0),c[1]+(n&2?d[1]:0),c[2]+(n&4?d[2]:0));
+                std::vector<std::pair<uint64_t,unsigned int> >::const_iterator it=
+                        std::lower_bound(cells.begin(),cells.end(),std::make_pair(key,0u));
+                for(;it!=cells.end()&&it->first==key&&it->second<best;++it){
+                    Vertex3f q=vertices[it->second]-p;
+                    bool within=exact?(q.x==0&&q.y==0&&q.z==0):q*q<=epsilon2;
+                    if(within){
+                        best=it->second;
+                        break;
+                    }
+                }
+            }
+            rep[i]=best;
+        }
+    });
+
+    // chains resolve in index order, since a vertex only points lower
+    std::vector<unsigned int> remap(nv),order;
+    for(size_t i=0;i<nv;i++){
+        rep[i]=rep[rep[i]];
+        if(rep[i]==i){
+            remap[i]=(unsigned int)order.size();
+            order.push_back((unsigned int)i);
+        }
+        else remap[i]=remap[rep[i]];
+    }
+    size_t removed=nv-order.size();
+    if(!removed) return 0;
+
+    remapVertices(remap,order,threads);
+    size_t nt=faces.size()/3;
+    std::vector<char> keep(nt);
+    parallelRanges(nt,threads,[&](size_t first,size_t last){
+        for(size_t t=first;t<last;t++){
+            const unsigned int* f=&faces[t*3];
+            keep[t]=f[0]!=f[1]&&f[1]!=f[2]&&f[0]!=f[2];
+        }
+    });
+    removeFaces(keep);
+    return removed;
+}
+
+void MeshInterleaved::computeNormals(int threads)
+{
+    size_t nv=vertices.size(),nt=faces.size()/3;
+    if(_verticesPerFace!=3) return;
+    threads=threadCount(threads);
+
+    // cross products are twice the area along the normal
+    std::vector<Vertex3f> faceNormals(nt);
+    parallelRanges(nt,threads,[&](size_t first,size_t last){
+        for(size_t t=first;t<last;t++){
+            const unsigned int* f=&faces[t*3];
+            faceNormals[t]=(vertices[f[1]]-vertices[f[0]])^(vertices[f[2]]-vertices[f[0]]);
+        }
+    });
+
+    std::vector<unsigned int> offsets,triangles;
+    vertexTriangles(faces,nv,offsets,triangles);
+    normals.resize(nv);
+    parallelRanges(nv,threads,[&](size_t first,size_t last){
+        for(size_t v=first;v<last;v++){
+            Vertex3f sum(0,0,0);
+            for(unsigned int k=offsets[v];k<offsets[v+1];k++) sum=sum+faceNormals[triangles[k]];
+            float n=sum.norm();
+            normals[v]=n>0?sum/n:Vertex3f(0,0,1);
+        }
+    });
+    _uploadedNormals=false;
+}
+
+size_t MeshInterleaved::decimate(size_t targetFaces,float maxError,int threads)
+{
+    size_t nv=vertices.size(),nt=faces.size()/3;
+    if(_verticesPerFace!=3||nt<=targetFaces) return 0;
+    threads=threadCount(threads);
+    bool hadNormals=normals.size()==nv;
+
+    // the plane of every triangle, weighted by its area
+    std::vector<Quadric> facePlanes(nt);
+    std::vector<Vertex3f> faceNormals(nt);
+    parallelRanges(nt,threads,[&](size_t first,size_t last){
+        for(size_t t=first;t<last;t++){
+            const unsigned int* f=&faces[t*3];
+            Vertex3f n=(vertices[f[1]]-vertices[f[0]])^(vertices[f[2]]-vertices[f[0]]);
+            double   len=n.norm();
+            faceNormals[t]=n;
+            if(len<=0) continue;
+            double nx=n.x/len,ny=n.y/len,nz=n.z/len;
+            const Vertex3f& p=vertices[f[0]];
+            facePlanes[t].addPlane(nx,ny,nz,-(nx*p.x+ny*p.y+nz*p.z),len*0.5);
+        }
+    });
+
+    std::vector<unsigned int> offsets,triangles;
+    vertexTriangles(faces,nv,offsets,triangles);
+    std::vector<Quadric> quadrics(nv);
+    parallelRanges(nv,threads,[&](size_t first,size_t last){
+        for(size_t v=first;v<last;v++)
+            for(unsigned int k=offsets[v];k<offsets[v+1];k++) quadrics[v]+=facePlanes[triangles[k]];
+    });
+    std::vector<Quadric>().swap(facePlanes);
+
+    // every edge once, with the triangle it was found in; edges of one
+    // triangle only are boundaries, held by planes through them
+    std::vector<std::pair<uint64_t,unsigned int> > halfEdges(nt*3);
+    parallelRanges(nt,threads,[&](size_t first,size_t last){
+        for(size_t t=first;t<last;t++)
+            for(int j=0;j<3;j++){
+                uint64_t a=faces[t*3+j],b=faces[t*3+(j+1)%3];
+                halfEdges[t*3+j]=std::make_pair(a<b?(a<<32|b):(b<<32|a),(unsigned int)t);
+            }
+    });
+    std::sort(halfEdges.begin(),halfEdges.end());
+    std::vector<std::pair<unsigned int,unsigned int> > edgeList;
+    edgeList.reserve(halfEdges.size()/2+1);
+    for(size_t i=0;i<halfEdges.size();){
+        size_t j=i+1;
+        while(j<halfEdges.size()&&halfEdges[j].first==halfEdges[i].first) j++;
+        unsigned int a=(unsigned int)(halfEdges[i].first>>32),b=(unsigned int)halfEdges[i].first;
+        if(a!=b) edgeList.push_back(std::make_pair(a,b));
+        if(j==i+1&&a!=b){
+            Vertex3f e=vertices[b]-vertices[a];
+            Vertex3f n=e^faceNormals[halfEdges[i].second];
+            double   len=n.norm();
+            if(len>0){
+                double nx=n.x/len,ny=n.y/len,nz=n.z/len;
+                const Vertex3f& p=vertices[a];
+                Quadric q;
+                q.addPlane(nx,ny,nz,-(nx*p.x+ny*p.y+nz*p.z),BOUNDARY_WEIGHT*(e*e));
+                quadrics[a]+=q;
+                quadrics[b]+=q;
+            }
+        }
+        i=j;
+    }
+    std::vector<std::pair<uint64_t,unsigned int> >().swap(halfEdges);
+
+    std::vector<Collapse> initial(edgeList.size());
+    parallelRanges(edgeList.size(),threads,[&](size_t first,size_t last){
+        for(size_t e=first;e<last;e++)
+            initial[e]=bestCollapse(quadrics,vertices,edgeList[e].first,edgeList[e].second);
+    });
+    std::priority_queue<Collapse> heap(std::less<Collapse>(),std::move(initial));
+    std::vector<std::pair<unsigned int,unsigned int> >().swap(edgeList);
+
+    // the triangles around each vertex, updated as edges collapse
+    std::vector<std::vector<unsigned int> > around(nv);
+    for(size_t v=0;v<nv;v++) around[v].assign(triangles.begin()+offsets[v],triangles.begin()+offsets[v+1]);
+    std::vector<unsigned int>().swap(triangles);
+    std::vector<unsigned int>().swap(offsets);
+
+    std::vector<unsigned int> stamp(nv,0),into(nv,NONE);
+    std::vector<char>         alive(nt,1);
+    std::vector<unsigned int> neighborsU,neighborsV;
+    size_t live=nt;
+
+    auto neighbors=[&](unsigned int v,std::vector<unsigned int>& out){
+        out.clear();
+        for(size_t k=0;k<around[v].size();k++){
+            if(!alive[around[v][k]]) continue;
+            const unsigned int* f=&faces[around[v][k]*3];
+            for(int j=0;j<3;j++) if(f[j]!=v) out.push_back(f[j]);
+        }
+        std::sort(out.begin(),out.end());
+        out.erase(std::unique(out.begin(),out.end()),out.end());
+    };
+    // whether moving v to p turns a triangle not shared with other over
+    auto flips=[&](unsigned int v,unsigned int other,const Vertex3f& p){
+        for(size_t k=0;k<around[v].size();k++){
+            unsigned int t=around[v][k];
+            const unsigned int* f=&faces[t*3];
+            if(!alive[t]||f[0]==other||f[1]==other||f[2]==other) continue;
+            Vertex3f c[3];
+            for(int j=0;j<3;j++) c[j]=f[j]==v?p:vertices[f[j]];
+            Vertex3f n=(c[1]-c[0])^(c[2]-c[0]);
+            if(n*faceNormals[t]<=0) return true;
+        }
+        return false;
+    };
+
+    while(live>targetFaces&&!heap.empty()){
+        Collapse c=heap.top();
+        heap.pop();
+        unsigned int u=c.u,v=c.v;
+        if(into[u]!=NONE||into[v]!=NONE||stamp[u]!=c.stampU||stamp[v]!=c.stampV) continue;
+        if(c.cost>maxError) break;
+
+        // the link condition keeps the surface manifold
+        size_t shared=0;
+        for(size_t k=0;k<around[u].size();k++){
+            const unsigned int* f=&faces[around[u][k]*3];
+            shared+=alive[around[u][k]]&&(f[0]==v||f[1]==v||f[2]==v);
+        }
+        neighbors(u,neighborsU);
+        neighbors(v,neighborsV);
+        size_t common=0;
+        for(size_t i=0,j=0;i<neighborsU.size()&&j<neighborsV.size();){
+            if(neighborsU[i]<neighborsV[j]) i++;
+            else if(neighborsU[i]>neighborsV[j]) j++;
+            else{common++;i++;j++;}
+        }
+        if(common!=shared||flips(u,v,c.pos)||flips(v,u,c.pos)) continue;
+
+        for(size_t k=0;k<around[v].size();k++){
+            unsigned int  t=around[v][k];
+            unsigned int* f=&faces[t*3];
+            if(!alive[t]) continue;
+            if(f[0]==u||f[1]==u||f[2]==u){
+                alive[t]=0;
+                live--;
+                continue;
+            }
+            for(int j=0;j<3;j++) if(f[j]==v) f[j]=u;
+            around[u].push_back(t);
+        }
+        std::vector<unsigned int>().swap(around[v]);
+        std::vector<unsigned int>& list=around[u];
+        size_t kept=0;
+        for(size_t k=0;k<list.size();k++)
+            if(alive[list[k]]) list[kept++]=list[k];
+        list.resize(kept);
+
+        vertices[u]=c.pos;
+        quadrics[u]+=quadrics[v];
+        into[v]=u;
+        stamp[u]++;
+        for(size_t k=0;k<list.size();k++){
+            // the normals are those after the move
+            const unsigned int* f=&faces[list[k]*3];
+            faceNormals[list[k]]=(vertices[f[1]]-vertices[f[0]])^(vertices[f[2]]-vertices[f[0]]);
+        }
+
+        neighbors(u,neighborsU);
+        for(size_t k=0;k<neighborsU.size();k++){
+            unsigned int w=neighborsU[k];
+            Collapse next=bestCollapse(quadrics,vertices,u,w);
+            next.stampU=stamp[u];
+            next.stampV=stamp[w];
+            heap.push(next);
+        }
+    }
+
+    // vertices which collapsed take the index of the one they went into
+    std::vector<unsigned int> remap(nv,NONE),order;
+    for(size_t v=0;v<nv;v++){
+        if(into[v]!=NONE) continue;
+        remap[v]=(unsigned int)order.size();
+        order.push_back((unsigned int)v);
+    }
+    for(size_t v=0;v<nv;v++){
+        unsigned int w=(unsigned int)v;
+        while(into[w]!=NONE) w=into[w];
+        remap[v]=remap[w];
+    }
+    removeFaces(alive);
+    remapVertices(remap,order,threads);
+    if(hadNormals) computeNormals(threads);
+    return nt-live;
+}
+
+void MeshInterleaved::optimizeVertexCache(unsigned int cacheSize)
+{
+    size_t nv=vertices.size(),nt=faces.size()/3;
+    if(_verticesPerFace!=3||!nt) return;
+    cacheSize=std::max(cacheSize,4u);
+
+    // each material is reordered on its own
+    std::vector<size_t> runs(1,0);
+    for(size_t i=0;i<materialIndices.size();i++) runs.push_back(std::min<size_t>(materialIndices[i]/3,nt));
+    runs.push_back(nt);
+    std::sort(runs.begin(),runs.end());
+    runs.erase(std::unique(runs.begin(),runs.end()),runs.end());
+
+    std::vector<unsigned int> offsets,triangles;
+    vertexTriangles(faces,nv,offsets,triangles);
+    std::vector<unsigned int> remaining(nv);
+    for(size_t v=0;v<nv;v++) remaining[v]=offsets[v+1]-offsets[v];
+    std::vector<int>          position(nv,-1);
+    std::vector<float>        vertexScores(nv),triangleScores(nt,0);
+    std::vector<char>         added(nt,0);
+    std::vector<unsigned int> order;
+    order.reserve(nt);
+    for(size_t v=0;v<nv;v++) vertexScores[v]=vertexScore(-1,remaining[v],cacheSize);
+    for(size_t t=0;t<nt;t++)
+        for(int j=0;j<3;j++) triangleScores[t]+=vertexScores[faces[t*3+j]];
+
+    std::vector<unsigned int> cache,next;
+    for(size_t r=0;r+1<runs.size();r++){
+        size_t runBegin=runs[r],runEnd=runs[r+1],cursor=runBegin;
+        for(;;){
+            // the best triangle around the cached vertices, or the next one not drawn
+            long   best=-1;
+            float  bestScore=-1e30f;
+            for(size_t i=0;i<cache.size();i++){
+                unsigned int v=cache[i];
+                for(unsigned int k=offsets[v];k<offsets[v]+remaining[v];k++){
+                    unsigned int t=triangles[k];
+                    if(t>=runBegin&&t<runEnd&&triangleScores[t]>bestScore){
+                        bestScore=triangleScores[t];
+                        best=t;
+                    }
+                }
+            }
+            if(best<0){
+                while(cursor<runEnd&&added[cursor]) cursor++;
+                if(cursor==runEnd) break;
+                best=(long)cursor;
+            }
+
+            added[best]=1;
+            order.push_back((unsigned int)best);
+            next.clear();
+            for(int j=0;j<3;j++){
+                unsigned int v=faces[best*3+j];
+                // the triangle leaves the list of its vertex
+                unsigned int* list=&triangles[offsets[v]];
+                for(unsigned int k=0;k<remaining[v];k++)
+                    if(list[k]==(unsigned int)best){
+                        std::swap(list[k],list[remaining[v]-1]);
+                        break;
+                    }
+                remaining[v]--;
+                next.push_back(v);
+            }
+            for(size_t i=0;i<cache.size();i++)
+                if(std::find(next.begin(),next.end(),cache[i])==next.end()) next.push_back(cache[i]);
+            // the vertices pushed out score as uncached again
+            for(size_t i=cacheSize;i<next.size();i++) position[next[i]]=-1;
+            for(size_t i=0;i<next.size();i++){
+                unsigned int v=next[i];
+                if(i<cacheSize) position[v]=(int)i;
+                float score=vertexScore(position[v],remaining[v],cacheSize);
+                float delta=score-vertexScores[v];
+                vertexScores[v]=score;
+                for(unsigned int k=offsets[v];k<offsets[v]+remaining[v];k++) triangleScores[triangles[k]]+=delta;
+            }
+            if(next.size()>cacheSize) next.resize(cacheSize);
+            cache.swap(next);
+        }
+        for(size_t i=0;i<cache.size();i++) position[cache[i]]=-1;
+        cache.clear();
+    }
+
+    std::vector<unsigned int> newFaces(faces.size());
+    bool withTexcoords=texcoords.size()==faces.size();
+    std::vector<Vertex2f> newTexcoords(withTexcoords?faces.size():0);
+    for(size_t t=0;t<nt;t++){
+        memcpy(&newFaces[t*3],&faces[order[t]*3],3*sizeof(unsigned int));
+        if(withTexcoords) memcpy(&newTexcoords[t*3],&texcoords[order[t]*3],3*sizeof(Vertex2f));
+    }
+    faces.swap(newFaces);
+    if(withTexcoords) texcoords.swap(newTexcoords);
+
+    // vertices in the order they are first used, unused ones last
+    std::vector<unsigned int> remap(nv,NONE),vertexOrder;
+    vertexOrder.reserve(nv);
+    for(size_t k=0;k<faces.size();k++)
+        if(remap[faces[k]]==NONE){
+            remap[faces[k]]=(unsigned int)vertexOrder.size();
+            vertexOrder.push_back(faces[k]);
+        }
+    for(size_t v=0;v<nv;v++)
+        if(remap[v]==NONE){
+            remap[v]=(unsigned int)vertexOrder.size();
+            vertexOrder.push_back((unsigned int)v);
+        }
+    remapVertices(remap,vertexOrder,1);
+}
+
+}}
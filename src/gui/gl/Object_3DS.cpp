@@ -17,30 +17,155 @@
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#include <map>
 
 namespace pi{
 namespace gl{
 
-Object_3DS::Object_3DS(const char* filename):file(NULL)
+#ifdef HAS_LIB3DS
+namespace {
+
+typedef std::map<std::string,unsigned int> MaterialIds;
+
+// column major as in GL, m[column][row]
+void multiply(const float a[4][4],const float b[4][4],float out[4][4])
+{
+    for(int c=0;c<4;c++)
+        for(int r=0;r<4;r++){
+            out[c][r]=0;
+            for(int k=0;k<4;k++) out[c][r]+=a[k][r]*b[c][k];
+        }
+}
+
+unsigned int materialId(Lib3dsFile* file,const char* name,StaticModel& model,MaterialIds& ids)
+{
+    MaterialIds::iterator it=ids.find(name);
+    if(it!=ids.end()) return it->second;
+
+    StaticModel::Material material;
+    Lib3dsMaterial* mat=name[0]?lib3ds_file_material_by_name(file,name):0;
+    if(mat){
+        static const float a[4]={0,0,0,1};
+        memcpy(material.ambient,a,sizeof(a));
+        memcpy(material.diffuse,mat->diffuse,sizeof(material.diffuse));
+        memcpy(material.specular,mat->specular,sizeof(material.specular));
+        material.shininess=pow(2,10.0*mat->shininess);
+        if(material.shininess>128.0) material.shininess=128.0;
+    }
+    else{
+        static const float a[4]={0.2,0.2,0.2,1.0},d[4]={0.8,0.8,0.8,1.0},s[4]={0.0,0.0,0.0,1.0};
+        memcpy(material.ambient,a,sizeof(a));
+        memcpy(material.diffuse,d,sizeof(d));
+        memcpy(material.specular,s,sizeof(s));
+        material.shininess=0;
+    }
+    return ids[name]=model.addMaterial(material);
+}
+
+// the triangles of node and its children, moved where the node draws them
+void addNode(Lib3dsFile* file,Lib3dsNode* node,StaticModel& model,MaterialIds& ids)
+{
+    for(Lib3dsNode* p=node->childs;p!=0;p=p->next)
+        addNode(file,p,model,ids);
+
+    if(node->type!=LIB3DS_OBJECT_NODE||strcmp(node->name,"$$$DUMMY")==0) return;
+    Lib3dsMesh* mesh=lib3ds_file_mesh_by_name(file,node->name);
+    if(!mesh) return;
+
+    // node matrix * pivot translation * inverse mesh matrix
+    Lib3dsObjectData* d=&node->data.object;
+    float pivot[4][4]={{1,0,0,0},{0,1,0,0},{0,0,1,0},{-d->pivot[0],-d->pivot[1],-d->pivot[2],1}};
+    Lib3dsMatrix meshInverse,placed,transform,normalMatrix;
+    lib3ds_matrix_copy(meshInverse,mesh->matrix);
+    lib3ds_matrix_inv(meshInverse);
+    multiply(node->matrix,pivot,placed);
+    multiply(placed,meshInverse,transform);
+    // normals go with the inverse transpose
+    lib3ds_matrix_copy(normalMatrix,transform);
+    lib3ds_matrix_inv(normalMatrix);
+
+    Lib3dsVector* normalL=new Lib3dsVector[3*mesh->faces];
+    lib3ds_mesh_calculate_normals(mesh,normalL);
+
+    for(unsigned int p=0;p<mesh->faces;++p){
+        Lib3dsFace* f=&mesh->faceL[p];
+        StaticModel::Vertex corners[3];
+        for(int i=0;i<3;++i){
+            const float* pos=mesh->pointL[f->points[i]].pos;
+            const float* n=normalL[3*p+i];
+            float length=0;
+            for(int r=0;r<3;r++){
+                corners[i].position[r]=transform[3][r];
+                corners[i].normal[r]=0;
+                for(int c=0;c<3;c++){
+                    corners[i].position[r]+=transform[c][r]*pos[c];
+                    corners[i].normal[r]+=normalMatrix[r][c]*n[c];
+                }
+                length+=corners[i].normal[r]*corners[i].normal[r];
+            }
+            if(length>0){
+                length=1/sqrtf(length);
+                for(int r=0;r<3;r++) corners[i].normal[r]*=length;
+            }
+        }
+        model.addTriangle(materialId(file,f->material,model,ids),corners);
+    }
+    delete[] normalL;
+}
+
+}
+#endif
+
+SPtr<StaticModel> Object_3DS::load(const std::string& filename)
 {
 #ifdef HAS_LIB3DS
-    file=lib3ds_file_load(filename);
+    Lib3dsFile* file=lib3ds_file_load(filename.c_str());
     if(!file)
     {
-        MSG_ERROR("Can't load 3ds file %s",filename);
+        MSG_ERROR("Can't load 3ds file %s",filename.c_str());
+        return SPtr<StaticModel>();
     }
-    else
-        lib3ds_file_eval(file,0);
+    lib3ds_file_eval(file,0);
+
+    SPtr<StaticModel> model(new StaticModel);
+    MaterialIds ids;
+    for(Lib3dsNode* p=file->nodes;p!=0;p=p->next)
+        addNode(file,p,*model,ids);
+
+    for(Lib3dsLight* l=file->lights;l;l=l->next)
+    {
+        StaticModel::Light light;
+        for(int i=0;i<3;i++){
+            light.position[i]=l->position[i];
+            light.direction[i]=l->spot[i]-l->position[i];
+        }
+        light.spot=l->spot_light;
+        model->lights.push_back(light);
+    }
+    MSG_INFO("Loaded %s: %d triangles, %d vertices, %d materials",filename.c_str(),
+             (int)model->triangles(),(int)model->vertices().size(),(int)model->materials().size());
+
+    lib3ds_file_free(file);
+    return model;
 #else
+    (void)filename;
+    return SPtr<StaticModel>();
+#endif
+}
+
+Object_3DS::Object_3DS(const char* filename)
+{
+#ifdef HAS_LIB3DS
+    model=StaticModel::cached(filename,load);
+#else
+    (void)filename;
     std::cerr<<("Object_3DS can't be used. Please ensure lib3ds is linked correctly!");
 #endif
 }
 
 void Object_3DS::init()
 {
-#ifdef HAS_LIB3DS
-    if(!file) return ;
-    lib3ds_file_eval(file,0);
+    if(!model) return ;
 
     // Lights
     GLfloat amb[] = {0.0, 0.0, 0.0, 1.0};
@@ -48,136 +173,46 @@ void Object_3DS::init()
     GLfloat spe[] = {1.0, 1.0, 1.0, 1.0};
     GLfloat pos[] = {0.0, 0.0, 0.0, 1.0};
     int li=GL_LIGHT0;
-    for (Lib3dsLight* l=file->lights; l; l=l->next)
+    for (size_t i=0; i<model->lights.size(); i++)
       {
+        const StaticModel::Light& l=model->lights[i];
         glEnable(li);
 
         glLightfv(li, GL_AMBIENT,  amb);
         glLightfv(li, GL_DIFFUSE,  dif);
         glLightfv(li, GL_SPECULAR, spe);
 
-        pos[0] = l->position[0];
-        pos[1] = l->position[1];
-        pos[2] = l->position[2];
+        pos[0] = l.position[0];
+        pos[1] = l.position[1];
+        pos[2] = l.position[2];
         glLightfv(li, GL_POSITION, pos);
 
-        if (!l->spot_light)
+        if (!l.spot)
         continue;
 
-        pos[0] = l->spot[0] - l->position[0];
-        pos[1] = l->spot[1] - l->position[1];
-        pos[2] = l->spot[2] - l->position[2];
-        glLightfv(li, GL_SPOT_DIRECTION, pos);
+        glLightfv(li, GL_SPOT_DIRECTION, l.direction);
         ++li;
       }
-#endif
 }
 
-void Object_3DS::renderNode(Lib3dsNode *node)
+void Object_3DS::draw()
 {
-#ifdef HAS_LIB3DS
-    for (Lib3dsNode* p=node->childs; p!=0; p=p->next)
-      renderNode(p);
+    if(!model) return ;
 
-    if (node->type == LIB3DS_OBJECT_NODE)
-      {
-        if (strcmp(node->name,"$$$DUMMY")==0)
-      return;
+    glPushMatrix();
+    glMatrixMode(GL_MODELVIEW);
 
-        if (!node->user.d)
-      {
-        Lib3dsMesh *mesh=lib3ds_file_mesh_by_name(file, node->name);
-        if (!mesh)
-          return;
-        MSG_INFO("Rendering node %s",node->name);
-        MSG_INFO("Face number: %d",mesh->faces);
-//        return ;
-        node->user.d = glGenLists(1);
-        glNewList(node->user.d, GL_COMPILE);
-
-        Lib3dsVector *normalL = new Lib3dsVector[3*mesh->faces];
-
-        Lib3dsMatrix M;
-        lib3ds_matrix_copy(M, mesh->matrix);
-        lib3ds_matrix_inv(M);
-        glMultMatrixf(&M[0][0]);
-
-        lib3ds_mesh_calculate_normals(mesh, normalL);
-
-        for (unsigned int p=0; p<mesh->faces; ++p)
-          {
-            Lib3dsFace *f=&mesh->faceL[p];
-            Lib3dsMaterial *mat=0;
-            if (f->material[0])
-          mat=lib3ds_file_material_by_name(file, f->material);
-
-            if (mat)
-          {
-            static GLfloat a[4]={0,0,0,1};
-            float s;
-            glMaterialfv(GL_FRONT, GL_AMBIENT, a);
-            glMaterialfv(GL_FRONT, GL_DIFFUSE, mat->diffuse);
-            glMaterialfv(GL_FRONT, GL_SPECULAR, mat->specular);
-            s = pow(2, 10.0*mat->shininess);
-            if (s>128.0)
-              s=128.0;
-            glMaterialf(GL_FRONT, GL_SHININESS, s);
-          }
-            else
-          {
-            Lib3dsRgba a={0.2, 0.2, 0.2, 1.0};
-            Lib3dsRgba d={0.8, 0.8, 0.8, 1.0};
-            Lib3dsRgba s={0.0, 0.0, 0.0, 1.0};
-            glMaterialfv(GL_FRONT, GL_AMBIENT, a);
-            glMaterialfv(GL_FRONT, GL_DIFFUSE, d);
-            glMaterialfv(GL_FRONT, GL_SPECULAR, s);
-          }
-
-            glBegin(GL_TRIANGLES);
-            glNormal3fv(f->normal);
-            for (int i=0; i<3; ++i)
-          {
-            glNormal3fv(normalL[3*p+i]);
-            glVertex3fv(mesh->pointL[f->points[i]].pos);
-          }
-            glEnd();
-          }
-
-        delete[] normalL;
-
-        glEndList();
-      }
+    glMultMatrix(pose.read());
+    model->draw();
 
-        if (node->user.d)
-      {
-        glPushMatrix();
-        Lib3dsObjectData* d = &node->data.object;
-        glMultMatrixf(&node->matrix[0][0]);
-        glTranslatef(-d->pivot[0], -d->pivot[1], -d->pivot[2]);
-        glCallList(node->user.d);
-        glPopMatrix();
-      }
-      }
-#endif
+    glPopMatrix();
 }
 
-
-void Object_3DS::draw()
+bool Object_3DS::bounds(BoundingBox& box)
 {
-#ifdef HAS_LIB3DS
-
-if(!file) return ;
-
-glPushMatrix();
-glMatrixMode(GL_MODELVIEW);
-
-glMultMatrix(pose);
-
-for (Lib3dsNode* p=file->nodes; p!=0; p=p->next)
-  renderNode(p);
-
-glPopMatrix();
-#endif
+    if(!model||model->box().empty()) return false;
+    box=model->box().transformed(pose.read());
+    return true;
 }
 
 
@@ -2,32 +2,41 @@
 #define OBJECT_3DS_H
 
 #include "PosedObject.h"
+#include "StaticModel.h"
 
-class Lib3dsFile;
-class Lib3dsNode;
 namespace pi{
 namespace gl{
 
 
 class Object_3DS:public GL_Object
+    /// A 3DS model at a pose. The file is converted once into a
+    /// StaticModel, with the node transforms applied to the vertices, and
+    /// every Object_3DS of the same file shares it and its GL buffers.
 {
 public:
     Object_3DS(const char* filename);
 
     void init();
+        /// Enables the lights of the file.
 
     virtual void draw();
+    virtual bool bounds(BoundingBox& box);
 
-    bool isOpened(){return file;}
+    bool isOpened(){return model.get()!=NULL;}
 
-    void setPose(const pi::SE3f& ps){ScopedMutex lock(m_mutex);pose=ps;}
-    const pi::SE3f& getPose(){ScopedMutex lock(m_mutex);return pose;}
+    void setPose(const pi::SE3f& ps){written=ps;pose.write(ps);}
+    pi::SE3f getPose() const{return written;}
+
+    const SPtr<StaticModel>& getModel() const{return model;}
+
+    static SPtr<StaticModel> load(const std::string& filename);
+        /// Reads a 3DS file into a new model, null if it can't be read;
+        /// Object_3DS goes through StaticModel::cached() instead.
 
 private:
-    void renderNode(Lib3dsNode *node);
-    Lib3dsFile *file;
-    pi::Mutex  m_mutex;
-    pi::SE3f   pose;
+    SPtr<StaticModel>           model;
+    pi::TripleBuffer<pi::SE3f>  pose;    ///< as in PosedObject
+    pi::SE3f                    written;
 };
 
 
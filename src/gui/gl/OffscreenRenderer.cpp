@@ -0,0 +1,366 @@
+#include "OffscreenRenderer.h"
+#include "OpenGL.h"
+#include "glHelper.h"
+
+#include <string.h>
+#include <algorithm>
+
+#ifdef HAS_EGL
+// keep X11 and its macros out, the context needs no display
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <base/Time/Timestamp.h>
+#include <base/Debug/Exception.h>
+
+#ifdef _WIN32
+#define popen  _popen
+#define pclose _pclose
+#endif
+
+namespace pi{
+namespace gl{
+
+OffscreenRenderer::OffscreenRenderer(int width,int height,bool createContext,int depth)
+    :_width(width),_height(height),_display(0),_context(0),_framebuffer(0),_color(0),_depth(0),
+     _next(0),_frames(0),_fx(0),_fy(0),_cx(0),_cy(0),_near(0.1),_far(1000),
+     _background(0x33,0x33,0x33),_sink(0),_queueLimit(64),_sumDraw(0),_sumGpu(0),_sumRead(0)
+{
+    if(width<=0||height<=0||depth<1)
+        throw pi::InvalidArgumentException("OffscreenRenderer: bad size or depth");
+    if(createContext) this->createContext();
+
+    glewInit();
+    if(!GLEW_VERSION_3_0&&!GLEW_ARB_framebuffer_object){
+        destroyContext();
+        throw pi::NotImplementedException("OffscreenRenderer: no framebuffer objects");
+    }
+
+    GLint previous=0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING,&previous);
+    glGenFramebuffers(1,&_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER,_framebuffer);
+    glGenRenderbuffers(1,&_color);
+    glBindRenderbuffer(GL_RENDERBUFFER,_color);
+    glRenderbufferStorage(GL_RENDERBUFFER,GL_RGBA8,width,height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_RENDERBUFFER,_color);
+    glGenRenderbuffers(1,&_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER,_depth);
+    glRenderbufferStorage(GL_RENDERBUFFER,GL_DEPTH_COMPONENT24,width,height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_DEPTH_ATTACHMENT,GL_RENDERBUFFER,_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER,0);
+    GLenum status=glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER,previous);
+    if(status!=GL_FRAMEBUFFER_COMPLETE){
+        glDeleteRenderbuffers(1,&_color);
+        glDeleteRenderbuffers(1,&_depth);
+        glDeleteFramebuffers(1,&_framebuffer);
+        destroyContext();
+        throw pi::SystemException("OffscreenRenderer: incomplete framebuffer");
+    }
+
+    _readbacks.resize(depth);
+    bool timer=GLEW_ARB_timer_query||GLEW_VERSION_3_3;
+    for(size_t i=0;i<_readbacks.size();i++){
+        Readback& readback=_readbacks[i];
+        memset(&readback,0,sizeof(readback));
+        glGenBuffers(1,&readback.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER,readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER,(size_t)width*height*3,0,GL_STREAM_READ);
+        if(timer) glGenQueries(1,&readback.query);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+    resetStats();
+}
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+    // a context of the caller's may be gone, only its own is sure to exist
+    if(!_context) return;
+    makeCurrent();
+    release();
+    destroyContext();
+}
+
+void OffscreenRenderer::release()
+{
+    if(!_framebuffer) return;
+    for(size_t i=0;i<_readbacks.size();i++){
+        Readback& readback=_readbacks[i];
+        if(readback.fence) glDeleteSync((GLsync)readback.fence);
+        if(readback.query) glDeleteQueries(1,&readback.query);
+        glDeleteBuffers(1,&readback.buffer);
+    }
+    _readbacks.clear();
+    glDeleteRenderbuffers(1,&_color);
+    glDeleteRenderbuffers(1,&_depth);
+    glDeleteFramebuffers(1,&_framebuffer);
+    _framebuffer=0;
+}
+
+void OffscreenRenderer::createContext()
+{
+#ifdef HAS_EGL
+    // the Mesa surfaceless platform needs neither a display nor a GPU
+    EGLDisplay display=EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay=
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(getPlatformDisplay)
+        display=getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,EGL_DEFAULT_DISPLAY,NULL);
+#endif
+    EGLint major,minor;
+    if(display==EGL_NO_DISPLAY||!eglInitialize(display,&major,&minor)){
+        display=eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if(display==EGL_NO_DISPLAY||!eglInitialize(display,&major,&minor))
+            throw pi::SystemException("OffscreenRenderer: no EGL display");
+    }
+
+    EGLint attributes[]={EGL_SURFACE_TYPE,EGL_PBUFFER_BIT,EGL_RENDERABLE_TYPE,EGL_OPENGL_BIT,EGL_NONE};
+    EGLConfig config;
+    EGLint configs=0;
+    if(!eglBindAPI(EGL_OPENGL_API)||!eglChooseConfig(display,attributes,&config,1,&configs)||!configs)
+        throw pi::SystemException("OffscreenRenderer: no EGL config for desktop OpenGL");
+    EGLContext context=eglCreateContext(display,config,EGL_NO_CONTEXT,NULL);
+    if(context==EGL_NO_CONTEXT)
+        throw pi::SystemException("OffscreenRenderer: can't create an EGL context");
+    _display=display;
+    _context=context;
+    if(!eglMakeCurrent(display,EGL_NO_SURFACE,EGL_NO_SURFACE,context)){
+        destroyContext();
+        throw pi::SystemException("OffscreenRenderer: EGL contexts without surfaces are not supported");
+    }
+#else
+    throw pi::NotImplementedException("OffscreenRenderer: built without EGL, render in a current context");
+#endif
+}
+
+void OffscreenRenderer::destroyContext()
+{
+#ifdef HAS_EGL
+    if(!_context) return;
+    // the display stays initialized for other contexts on it
+    eglMakeCurrent((EGLDisplay)_display,EGL_NO_SURFACE,EGL_NO_SURFACE,EGL_NO_CONTEXT);
+    eglDestroyContext((EGLDisplay)_display,(EGLContext)_context);
+    _context=0;
+#endif
+}
+
+void OffscreenRenderer::makeCurrent()
+{
+#ifdef HAS_EGL
+    if(_context) eglMakeCurrent((EGLDisplay)_display,EGL_NO_SURFACE,EGL_NO_SURFACE,(EGLContext)_context);
+#endif
+}
+
+void OffscreenRenderer::setCamera(double fx,double fy,double cx,double cy)
+{
+    _fx=fx;_fy=fy;_cx=cx;_cy=cy;
+}
+
+void OffscreenRenderer::setClipping(double zNear,double zFar)
+{
+    _near=zNear;_far=zFar;
+}
+
+void OffscreenRenderer::loadCamera()
+{
+    double fx=_fx,fy=_fy,cx=_cx,cy=_cy;
+    if(fx<=0||fy<=0){
+        fx=fy=_height;
+        cx=_width*0.5;cy=_height*0.5;
+    }
+    // as Win3D::loadProjectionMatrix, cy counted from the top
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glFrustum(-cx/fx*_near,(_width-cx)/fx*_near,-(_height-cy)/fy*_near,cy/fy*_near,_near,_far);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glMultMatrix(_pose.inverse());
+}
+
+uint64_t OffscreenRenderer::render(GL_Object& scene)
+{
+    if(!_framebuffer) throw pi::IllegalStateException("OffscreenRenderer: rendering after release()");
+    // the oldest frame gives up its pixel buffer
+    Readback& readback=_readbacks[_next];
+    if(readback.pending) deliver(readback);
+
+    GLint previous=0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING,&previous);
+    glBindFramebuffer(GL_FRAMEBUFFER,_framebuffer);
+    glPushAttrib(GL_ALL_ATTRIB_BITS);
+    glPushClientAttrib(GL_CLIENT_ALL_ATTRIB_BITS);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+
+    // the state Win3D::initializeGL sets up
+    glViewport(0,0,_width,_height);
+    glEnable(GL_LIGHT0);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_COLOR_MATERIAL);
+    glClearColor(_background.x/255.f,_background.y/255.f,_background.z/255.f,1.f);
+    glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+    loadCamera();
+
+    if(readback.query) glBeginQuery(GL_TIME_ELAPSED,readback.query);
+    pi::Timestamp start;
+    scene.draw();
+    readback.drawMs=start.elapsed()*1e-3;
+    if(readback.query) glEndQuery(GL_TIME_ELAPSED);
+
+    // into the pixel buffer, the copy happens later on the GPU side
+    glPixelStorei(GL_PACK_ALIGNMENT,1);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER,readback.buffer);
+    glReadPixels(0,0,_width,_height,GL_BGR,GL_UNSIGNED_BYTE,0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+    readback.fence=glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+    glFlush();
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glPopClientAttrib();
+    glPopAttrib();
+    glBindFramebuffer(GL_FRAMEBUFFER,previous);
+
+    readback.pending=true;
+    readback.number=_frames++;
+    _next=(_next+1)%_readbacks.size();
+    _stats.rendered++;
+
+    collect(false);
+    return readback.number;
+}
+
+void OffscreenRenderer::finish()
+{
+    collect(true);
+}
+
+void OffscreenRenderer::collect(bool wait)
+{
+    // oldest first, stopping at the first transfer still running
+    for(size_t i=0;i<_readbacks.size();i++){
+        Readback& readback=_readbacks[(_next+i)%_readbacks.size()];
+        if(!readback.pending) continue;
+        if(!wait){
+            GLenum state=glClientWaitSync((GLsync)readback.fence,0,0);
+            if(state!=GL_ALREADY_SIGNALED&&state!=GL_CONDITION_SATISFIED) break;
+        }
+        deliver(readback);
+    }
+}
+
+void OffscreenRenderer::deliver(Readback& readback)
+{
+    pi::Timestamp start;
+    GLsync fence=(GLsync)readback.fence;
+    while(glClientWaitSync(fence,GL_SYNC_FLUSH_COMMANDS_BIT,1000000)==GL_TIMEOUT_EXPIRED);
+    glDeleteSync(fence);
+    readback.fence=0;
+    readback.pending=false;
+
+    _frame.number=readback.number;
+    _frame.width=_width;
+    _frame.height=_height;
+    _frame.drawMs=readback.drawMs;
+    _frame.gpuMs=-1;
+    if(readback.query){
+        GLuint64 ns=0;
+        glGetQueryObjectui64v(readback.query,GL_QUERY_RESULT,&ns);
+        _frame.gpuMs=ns*1e-6;
+    }
+
+    // GL rows go bottom up
+    size_t row=(size_t)_width*3;
+    _frame.pixels.resize(row*_height);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER,readback.buffer);
+    const uint8_t* data=(const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER,0,row*_height,GL_MAP_READ_BIT);
+    if(data){
+        for(int y=0;y<_height;y++)
+            memcpy(&_frame.pixels[y*row],data+(_height-1-y)*row,row);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+    double readMs=start.elapsed()*1e-3;
+
+    _stats.delivered++;
+    _stats.drawMs=_frame.drawMs;
+    _stats.gpuMs=_frame.gpuMs;
+    _stats.readMs=readMs;
+    _sumDraw+=_frame.drawMs;
+    _sumGpu+=_frame.gpuMs;
+    _sumRead+=readMs;
+    _stats.meanDrawMs=_sumDraw/_stats.delivered;
+    _stats.meanGpuMs=_frame.gpuMs<0?-1:_sumGpu/_stats.delivered;
+    _stats.meanReadMs=_sumRead/_stats.delivered;
+    _stats.maxDrawMs=std::max(_stats.maxDrawMs,_frame.drawMs);
+    _stats.maxGpuMs=std::max(_stats.maxGpuMs,_frame.gpuMs);
+    _stats.maxReadMs=std::max(_stats.maxReadMs,readMs);
+
+    if(_sink){
+        _sink->write(_frame);
+        return;
+    }
+    if(_queue.size()>=_queueLimit){
+        _scratch.swap(_queue.front().pixels);
+        _queue.pop_front();
+        _stats.dropped++;
+    }
+    _queue.push_back(Frame());
+    std::swap(_queue.back(),_frame);
+    _frame.pixels.swap(_scratch);
+}
+
+bool OffscreenRenderer::takeFrame(Frame& frame)
+{
+    if(_queue.empty()) return false;
+    std::swap(frame,_queue.front());
+    // the pixels frame had are reused for a later frame
+    if(_scratch.capacity()<_queue.front().pixels.capacity()) _scratch.swap(_queue.front().pixels);
+    _queue.pop_front();
+    return true;
+}
+
+void OffscreenRenderer::resetStats()
+{
+    memset(&_stats,0,sizeof(_stats));
+    _stats.gpuMs=_stats.meanGpuMs=_stats.maxGpuMs=-1;
+    _sumDraw=_sumGpu=_sumRead=0;
+}
+
+VideoPipe::VideoPipe(const std::string& command):_pipe(0),_width(0),_height(0),_frames(0)
+{
+#ifdef _WIN32
+    _pipe=popen(command.c_str(),"wb");
+#else
+    _pipe=popen(command.c_str(),"w");
+#endif
+    if(!_pipe) throw pi::SystemException("VideoPipe: can't run "+command);
+}
+
+VideoPipe::~VideoPipe()
+{
+    if(_pipe) pclose(_pipe);
+}
+
+void VideoPipe::write(const OffscreenRenderer::Frame& frame)
+{
+    if(!_frames){
+        _width=frame.width;
+        _height=frame.height;
+    }
+    if(frame.width!=_width||frame.height!=_height) return;
+    if(fwrite(frame.pixels.data(),1,frame.pixels.size(),_pipe)==frame.pixels.size()) _frames++;
+}
+
+}}
@@ -0,0 +1,211 @@
+#ifndef OFFSCREENRENDERER_H
+#define OFFSCREENRENDERER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <base/Types/Point.h>
+#include <base/Types/SE3.h>
+#include "GL_Object.h"
+
+#ifdef HAS_OPENCV
+#include <opencv2/core/core.hpp>
+#endif
+
+namespace pi{
+namespace gl{
+
+typedef pi::Point3ub Color3b;
+
+class OffscreenRenderer
+    /// Renders GL_Objects, such as the Father_Object of a Win3D, into a
+    /// framebuffer object without any window, and reads the frames back
+    /// through a ring of pixel buffers so that rendering does not wait
+    /// for the transfer:
+    ///
+    ///     OffscreenRenderer renderer(640,480);   // a headless EGL context
+    ///     renderer.setCamera(500,500,320,240);
+    ///     for(size_t i=0;i<poses.size();i++){
+    ///         renderer.setPose(poses[i]);
+    ///         renderer.render(scene);
+    ///         OffscreenRenderer::Frame frame;
+    ///         while(renderer.takeFrame(frame)) cv::imwrite(...,toMat(frame));
+    ///     }
+    ///     renderer.finish();
+    ///
+    /// Frame n is read back while frames n+1 to n+depth-1 are drawn; it is
+    /// handed out by the first render() which finds the transfer done, at
+    /// the latest when its pixel buffer is needed again, or by finish().
+    /// With HAS_EGL the renderer can create its own context on the Mesa
+    /// surfaceless platform, which works without a GPU or a display;
+    /// otherwise it renders in the context current when it is created.
+    /// All members must be called on the thread the context is current on.
+{
+public:
+    struct Frame
+    {
+        uint64_t             number;    ///< counted from 0 in the order rendered
+        int                  width,height;
+        std::vector<uint8_t> pixels;    ///< BGR, rows top down without padding
+        double               drawMs;    ///< CPU time of drawing the scene
+        double               gpuMs;     ///< GPU time of the frame, -1 without GL_ARB_timer_query
+    };
+
+    class FrameSink
+        /// Receives the frames read back instead of takeFrame().
+    {
+    public:
+        virtual ~FrameSink(){}
+        virtual void write(const Frame& frame)=0;
+            /// Called from render() and finish().
+    };
+
+    struct Stats
+    {
+        size_t   rendered;      ///< frames drawn
+        size_t   delivered;     ///< frames read back
+        size_t   dropped;       ///< frames discarded from a full queue
+        double   drawMs,gpuMs,readMs;            ///< of the last frame read back
+        double   meanDrawMs,meanGpuMs,meanReadMs;
+        double   maxDrawMs,maxGpuMs,maxReadMs;
+            /// readMs is the time to wait for and copy out the pixels.
+    };
+
+    OffscreenRenderer(int width,int height,bool createContext=true,int depth=3);
+        /// Creates a framebuffer of width x height pixels with depth
+        /// pixel buffers. With createContext a headless context of its own
+        /// is made current, which needs HAS_EGL; otherwise the current
+        /// context is used. Throws a NotImplementedException or a
+        /// SystemException if there is no context to render in.
+    ~OffscreenRenderer();
+        /// Delivers nothing more; call finish() for the frames in flight.
+        /// Destroys the context of its own with all GL objects; in the
+        /// context of the caller, which may be gone, they are left alone
+        /// as by MeshInterleaved, so call release() first.
+
+    void release();
+        /// Deletes the framebuffer and the pixel buffers, discarding the
+        /// frames in flight, with the context rendered in current. Later
+        /// render() calls throw an IllegalStateException.
+
+    void makeCurrent();
+        /// Makes the context of its own current on the calling thread.
+
+    int width() const{return _width;}
+    int height() const{return _height;}
+
+    void setCamera(double fx,double fy,double cx,double cy);
+        /// Pinhole intrinsics as for Win3D::setCamera. By default fx=fy=height
+        /// and the principal point is the center.
+    void setClipping(double zNear,double zFar);
+        /// 0.1 and 1000 by default.
+    void setPose(const pi::SE3f& pose){_pose=pose;}
+    pi::SE3f getPose() const{return _pose;}
+        /// The camera in world coordinates, looking down its -z axis with
+        /// y up, as the camera of Win3D.
+    void setBackground(const Color3b& color){_background=color;}
+        /// #333333 by default, as Win3D.
+
+    uint64_t render(GL_Object& scene);
+        /// Clears the framebuffer, draws scene with the camera, starts
+        /// reading the frame back and delivers the frames read meanwhile.
+        /// Returns the number of the frame.
+
+    void finish();
+        /// Waits for all frames in flight and delivers them.
+
+    void setSink(FrameSink* sink){_sink=sink;}
+        /// Frames go to sink if it is not null, otherwise into a queue for
+        /// takeFrame().
+    bool takeFrame(Frame& frame);
+        /// The oldest queued frame, false if there is none.
+    void setQueueLimit(size_t frames){_queueLimit=frames;}
+        /// Beyond this the oldest queued frames are dropped, 64 by default.
+
+    const Stats& stats() const{return _stats;}
+    void resetStats();
+
+private:
+    OffscreenRenderer(const OffscreenRenderer&);
+    OffscreenRenderer& operator=(const OffscreenRenderer&);
+
+    struct Readback
+    {
+        unsigned int buffer;    ///< GL_PIXEL_PACK_BUFFER
+        unsigned int query;     ///< GL_TIME_ELAPSED, 0 without timer queries
+        void*        fence;     ///< GLsync of the glReadPixels
+        bool         pending;
+        uint64_t     number;
+        double       drawMs;
+    };
+
+    void createContext();
+    void destroyContext();
+    void loadCamera();
+    void collect(bool wait);
+    void deliver(Readback& readback);
+
+    int                     _width,_height;
+    void*                   _display;       ///< EGLDisplay of the context of its own
+    void*                   _context;       ///< EGLContext, or null
+    unsigned int            _framebuffer,_color,_depth;
+    std::vector<Readback>   _readbacks;
+    size_t                  _next;          ///< the readback the next frame goes to
+    uint64_t                _frames;
+
+    double                  _fx,_fy,_cx,_cy,_near,_far;
+    pi::SE3f                _pose;
+    Color3b                 _background;
+
+    FrameSink*              _sink;
+    Frame                   _frame;         ///< the frame being read back
+    std::deque<Frame>       _queue;
+    size_t                  _queueLimit;
+    std::vector<uint8_t>    _scratch;       ///< pixels given back by takeFrame()
+    Stats                   _stats;
+    double                  _sumDraw,_sumGpu,_sumRead;
+};
+
+class VideoPipe : public OffscreenRenderer::FrameSink
+    /// Writes frames as raw bgr24 video into the standard input of a
+    /// command, for example an encoder:
+    ///
+    ///     VideoPipe video("ffmpeg -y -f rawvideo -pix_fmt bgr24 -s 640x480 "
+    ///                     "-r 30 -i - -c:v libx264 flight.mp4");
+    ///     renderer.setSink(&video);
+    ///
+    /// Frames of another size than the first are skipped.
+{
+public:
+    VideoPipe(const std::string& command);
+        /// Throws a SystemException if the command can't be started.
+    ~VideoPipe();
+        /// Closes the pipe and waits for the command to exit.
+
+    virtual void write(const OffscreenRenderer::Frame& frame);
+
+    size_t frames() const{return _frames;}
+
+private:
+    VideoPipe(const VideoPipe&);
+    VideoPipe& operator=(const VideoPipe&);
+
+    FILE*   _pipe;
+    int     _width,_height;
+    size_t  _frames;
+};
+
+#ifdef HAS_OPENCV
+inline cv::Mat toMat(const OffscreenRenderer::Frame& frame)
+    /// A CV_8UC3 image sharing the pixels of frame.
+{
+    return cv::Mat(frame.height,frame.width,CV_8UC3,(void*)frame.pixels.data());
+}
+#endif
+
+}}
+
+#endif // OFFSCREENRENDERER_H
@@ -1,5 +1,6 @@
 #include "PosedObject.h"
 #include "glHelper.h"
+#include "Culling.h"
 
 #include <GL/gl.h>
 
@@ -9,16 +10,25 @@ namespace gl{
 
 void PosedObject::draw()
 {
-    if(obj.get())
+    const State& current=state.read();
+    if(current.obj.get())
     {
         glPushMatrix();
         glMatrixMode(GL_MODELVIEW);
 
-        glMultMatrix(pose);
-        obj->draw();
+        glMultMatrix(current.pose);
+        current.obj->draw();
 
         glPopMatrix();
     }
 }
 
+bool PosedObject::bounds(BoundingBox& box)
+{
+    const State& current=state.read();
+    if(!current.obj.get()||!current.obj->bounds(box)) return false;
+    box=box.transformed(current.pose);
+    return true;
+}
+
 }}
@@ -2,6 +2,7 @@
 #define POSEDOBJECT_H
 
 #include <base/Types/SE3.h>
+#include <base/Thread/TripleBuffer.h>
 #include "GL_FatherObject.h"
 
 
@@ -9,21 +10,36 @@ namespace pi{
 namespace gl{
 
 class PosedObject:public GL_Object
+    /// Draws an object at a pose. The object and the pose pass to the
+    /// render thread through a TripleBuffer, so drawing never waits for
+    /// the setters. Setters and getPose() share a mutex, so any thread
+    /// may call them.
 {
 public:
-    PosedObject(const GL_ObjectPtr& object=GL_ObjectPtr()):obj(object){}
+    PosedObject(const GL_ObjectPtr& object=GL_ObjectPtr()):state(State(object)),written(object){}
 
-    void setObject(const GL_ObjectPtr& object){ScopedMutex lock(m_mutex);obj=object;}
+    void setObject(const GL_ObjectPtr& object){ScopedMutex lock(m_mutex);written.obj=object;state.write(written);}
 
-    void setPose(const pi::SE3f& ps){ScopedMutex lock(m_mutex);pose=ps;}
-    const pi::SE3f& getPose(){ScopedMutex lock(m_mutex);return pose;}
+    void setPose(const pi::SE3f& ps){ScopedMutex lock(m_mutex);written.pose=ps;state.write(written);}
+    pi::SE3f getPose() const{ScopedMutex lock(m_mutex);return written.pose;}
+        /// The pose last set, which the next frame draws.
 
     virtual void draw();
+    virtual bool bounds(BoundingBox& box);
+        /// The bounds of the object moved to the pose drawn next.
 
 private:
-    GL_ObjectPtr    obj;
-    pi::SE3f        pose;
-    Mutex           m_mutex;
+    struct State
+    {
+        State(const GL_ObjectPtr& object=GL_ObjectPtr()):obj(object){}
+
+        GL_ObjectPtr    obj;
+        pi::SE3f        pose;
+    };
+
+    pi::TripleBuffer<State> state;
+    State                   written;    ///< the latest setting, guarded by m_mutex
+    mutable Mutex           m_mutex;    ///< serializes the setters, never taken by draw()
 };
 
 }}
@@ -0,0 +1,223 @@
+#include "PrimitiveBatch.h"
+#include "OpenGL.h"
+
+#include <algorithm>
+
+namespace pi{
+namespace gl{
+
+namespace {
+
+/// Smallest buffer, in vertices.
+const size_t MIN_BATCH_VERTICES=1024;
+
+const GLenum categoryModes[PrimitiveBatch::CategoryCount]={GL_POINTS,GL_LINES,GL_LINES};
+
+}
+
+PrimitiveBatch::PrimitiveBatch()
+    :_pointSize(1.f),_lineWidth(1.f)
+{
+    for(int i=0;i<CategoryCount;i++)
+        _buffers[i]=_capacity[i]=_uploaded[i]=0;
+}
+
+PrimitiveBatch::PrimitiveBatch(const PrimitiveBatch& batch)
+    :GL_Object(batch),_pointSize(batch._pointSize),_lineWidth(batch._lineWidth)
+{
+    for(int i=0;i<CategoryCount;i++)
+        _buffers[i]=_capacity[i]=_uploaded[i]=0;
+    pi::ScopedMutex lock(const_cast<pi::Mutex&>(batch._mutex));
+    for(int i=0;i<CategoryCount;i++)
+        _arrays[i]=batch._arrays[i];
+    _bounds=batch._bounds;
+}
+
+PrimitiveBatch::~PrimitiveBatch()
+{
+    // the GL buffers belong to a context which may be gone
+}
+
+PrimitiveBatch& PrimitiveBatch::operator=(const PrimitiveBatch& batch)
+{
+    if(&batch==this) return *this;
+    PrimitiveBatch copy(batch);
+    pi::ScopedMutex lock(_mutex);
+    for(int i=0;i<CategoryCount;i++){
+        _arrays[i].positions.swap(copy._arrays[i].positions);
+        _arrays[i].colors.swap(copy._arrays[i].colors);
+        _uploaded[i]=0;
+    }
+    _pointSize=copy._pointSize;
+    _lineWidth=copy._lineWidth;
+    _bounds=copy._bounds;
+    return *this;
+}
+
+void PrimitiveBatch::addPoint(const pi::Point3f& point,const Color3b& color)
+{
+    pi::ScopedMutex lock(_mutex);
+    push(_arrays[Points],point,color);
+}
+
+void PrimitiveBatch::addPoints(const float* xyz,const uint8_t* rgb,size_t n,int stride)
+{
+    pi::ScopedMutex lock(_mutex);
+    Arrays& arrays=_arrays[Points];
+    size_t first=arrays.positions.size();
+    arrays.positions.resize(first+n*3);
+    arrays.colors.resize(first+n*3,255);
+    float*   p=&arrays.positions[first];
+    uint8_t* c=&arrays.colors[first];
+    for(size_t i=0;i<n;i++,xyz+=stride,p+=3){
+        p[0]=xyz[0];p[1]=xyz[1];p[2]=xyz[2];
+        _bounds.extend(pi::Point3f(p[0],p[1],p[2]));
+    }
+    if(rgb){
+        for(size_t i=0;i<n;i++,rgb+=stride,c+=3){
+            c[0]=rgb[0];c[1]=rgb[1];c[2]=rgb[2];
+        }
+    }
+}
+
+void PrimitiveBatch::addLine(const pi::Point3f& from,const pi::Point3f& to,
+                             const Color3b& fromColor,const Color3b& toColor)
+{
+    pi::ScopedMutex lock(_mutex);
+    push(_arrays[Lines],from,fromColor);
+    push(_arrays[Lines],to,toColor);
+}
+
+void PrimitiveBatch::addLineStrip(const pi::Point3f* points,const Color3b* colors,size_t n)
+{
+    if(n<2) return;
+    pi::ScopedMutex lock(_mutex);
+    Arrays& arrays=_arrays[Lines];
+    arrays.positions.reserve(arrays.positions.size()+(n-1)*6);
+    arrays.colors.reserve(arrays.colors.size()+(n-1)*6);
+    Color3b white(255,255,255);
+    for(size_t i=0;i+1<n;i++){
+        push(arrays,points[i],colors?colors[i]:white);
+        push(arrays,points[i+1],colors?colors[i+1]:white);
+    }
+}
+
+void PrimitiveBatch::addPose(const pi::SE3f& pose,float scale)
+{
+    pi::ScopedMutex lock(_mutex);
+    Arrays& arrays=_arrays[Poses];
+    pi::Point3f origin=pose.get_translation();
+    const Color3b axisColors[3]={Color3b(255,0,0),Color3b(0,255,0),Color3b(0,0,255)};
+    for(int i=0;i<3;i++){
+        pi::Point3f axis(i==0?scale:0,i==1?scale:0,i==2?scale:0);
+        push(arrays,origin,axisColors[i]);
+        push(arrays,pose*axis,axisColors[i]);
+    }
+}
+
+void PrimitiveBatch::clear()
+{
+    pi::ScopedMutex lock(_mutex);
+    for(int i=0;i<CategoryCount;i++){
+        _arrays[i].positions.clear();
+        _arrays[i].colors.clear();
+        _uploaded[i]=0;
+    }
+    _bounds=BoundingBox();
+}
+
+size_t PrimitiveBatch::size(int category) const
+{
+    pi::ScopedMutex lock(const_cast<pi::Mutex&>(_mutex));
+    size_t vertices=_arrays[category].positions.size()/3;
+    if(category==Lines) return vertices/2;
+    if(category==Poses) return vertices/6;
+    return vertices;
+}
+
+bool PrimitiveBatch::empty() const
+{
+    pi::ScopedMutex lock(const_cast<pi::Mutex&>(_mutex));
+    for(int i=0;i<CategoryCount;i++)
+        if(!_arrays[i].positions.empty()) return false;
+    return true;
+}
+
+bool PrimitiveBatch::batch(PrimitiveBatch& target) const
+{
+    if(&target==this) return true;
+    pi::ScopedMutex lock(const_cast<pi::Mutex&>(_mutex));
+    pi::ScopedMutex targetLock(target._mutex);
+    for(int i=0;i<CategoryCount;i++){
+        const Arrays& from=_arrays[i];
+        Arrays&       to=target._arrays[i];
+        to.positions.insert(to.positions.end(),from.positions.begin(),from.positions.end());
+        to.colors.insert(to.colors.end(),from.colors.begin(),from.colors.end());
+    }
+    target._bounds.extend(_bounds);
+    return true;
+}
+
+bool PrimitiveBatch::bounds(BoundingBox& box)
+{
+    pi::ScopedMutex lock(_mutex);
+    box=_bounds;
+    return true;
+}
+
+void PrimitiveBatch::draw()
+{
+    pi::ScopedMutex lock(_mutex);
+    if(!_buffers[0]){
+        bool any=false;
+        for(int i=0;i<CategoryCount;i++) any|=!_arrays[i].positions.empty();
+        if(!any) return;
+        glewInit();
+        glGenBuffers(CategoryCount,_buffers);
+    }
+
+    glPushAttrib(GL_POINT_BIT|GL_LINE_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glPointSize(_pointSize);
+    glLineWidth(_lineWidth);
+
+    for(int i=0;i<CategoryCount;i++){
+        const Arrays& arrays=_arrays[i];
+        size_t n=arrays.positions.size()/3;
+        if(!n) continue;
+
+        glBindBuffer(GL_ARRAY_BUFFER,_buffers[i]);
+        if(n>_capacity[i]){
+            // positions in front, colors behind, both growing by doubling
+            _capacity[i]=std::max(std::max(n,_capacity[i]*2),MIN_BATCH_VERTICES);
+            glBufferData(GL_ARRAY_BUFFER,_capacity[i]*(3*sizeof(float)+3),0,GL_DYNAMIC_DRAW);
+            _uploaded[i]=0;
+        }
+        if(_uploaded[i]<n){
+            size_t first=_uploaded[i]*3;
+            glBufferSubData(GL_ARRAY_BUFFER,first*sizeof(float),(n*3-first)*sizeof(float),&arrays.positions[first]);
+            glBufferSubData(GL_ARRAY_BUFFER,_capacity[i]*3*sizeof(float)+first,n*3-first,&arrays.colors[first]);
+            _uploaded[i]=n;
+        }
+
+        glVertexPointer(3,GL_FLOAT,0,0);
+        glColorPointer(3,GL_UNSIGNED_BYTE,0,(const GLvoid*)(_capacity[i]*3*sizeof(float)));
+        glDrawArrays(categoryModes[i],0,(GLsizei)n);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    glPopClientAttrib();
+    glPopAttrib();
+}
+
+void PrimitiveBatch::release()
+{
+    pi::ScopedMutex lock(_mutex);
+    if(_buffers[0]) glDeleteBuffers(CategoryCount,_buffers);
+    for(int i=0;i<CategoryCount;i++)
+        _buffers[i]=_capacity[i]=_uploaded[i]=0;
+}
+
+}}
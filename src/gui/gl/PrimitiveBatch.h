@@ -0,0 +1,118 @@
+#ifndef PRIMITIVEBATCH_H
+#define PRIMITIVEBATCH_H
+
+#include <vector>
+#include <stdint.h>
+
+#include <base/Types/Point.h>
+#include <base/Types/SE3.h>
+#include <base/Thread/Mutex.h>
+#include "GL_Object.h"
+#include "Culling.h"
+
+namespace pi{
+namespace gl{
+
+typedef pi::Point3ub Color3b;
+
+class PrimitiveBatch : public GL_Object
+    /// Collects points, line segments and pose axes into one position
+    /// array and one color array per category, and draws each category
+    /// with a single glDrawArrays from a vertex buffer:
+    ///
+    ///     PrimitiveBatch batch;
+    ///     for(size_t i=0;i<trajectory.size();i++)
+    ///         batch.addPose(trajectory[i],0.1);
+    ///     batch.addPoints(&cloud[0].x,&colors[0].x,cloud.size());
+    ///     win3d.insert(batch);    // or call batch.draw() every frame
+    ///
+    /// Only the primitives appended since the last draw are uploaded; the
+    /// buffers grow by doubling. Small GL_Objects append themselves
+    /// through GL_Object::batch(), which lets Father_Object draw them here
+    /// instead of one by one. As for MeshInterleaved, the destructor leaves
+    /// the buffers to the context, which may be gone; release() frees them
+    /// in a context which lives on.
+{
+public:
+    enum Category
+    {
+        Points=0,
+        Lines=1,
+        Poses=2,
+        CategoryCount=3
+    };
+
+    PrimitiveBatch();
+    PrimitiveBatch(const PrimitiveBatch& batch);
+    ~PrimitiveBatch();
+
+    PrimitiveBatch& operator=(const PrimitiveBatch& batch);
+        /// Copies the primitives; the copy gets its own GL buffers.
+
+    void addPoint(const pi::Point3f& point,const Color3b& color=Color3b(255,255,255));
+    void addPoints(const float* xyz,const uint8_t* rgb,size_t n,int stride=3);
+        /// Appends n points, xyz and rgb being the first of n records
+        /// stride floats and stride bytes apart (3 for packed arrays).
+        /// rgb may be null for white.
+
+    void addLine(const pi::Point3f& from,const pi::Point3f& to,
+                 const Color3b& fromColor=Color3b(255,255,255),
+                 const Color3b& toColor=Color3b(255,255,255));
+    void addLineStrip(const pi::Point3f* points,const Color3b* colors,size_t n);
+        /// Appends the n-1 segments between consecutive points; colors
+        /// may be null for white.
+
+    void addPose(const pi::SE3f& pose,float scale=1.f);
+        /// Appends the x, y and z axes of the pose in red, green and blue.
+
+    void clear();
+
+    size_t size(int category) const;
+        /// Number of points, segments or poses.
+
+    bool empty() const;
+
+    void setPointSize(float size){_pointSize=size;}
+    void setLineWidth(float width){_lineWidth=width;}
+
+    virtual void draw();
+        /// Must be called with a current GL context.
+
+    virtual bool batch(PrimitiveBatch& target) const;
+        /// Appends all primitives of this batch to target.
+
+    virtual bool bounds(BoundingBox& box);
+
+    void release();
+        /// Deletes the buffers, with the context which drew the batch
+        /// current. The next draw() uploads all primitives again.
+
+protected:
+    struct Arrays
+    {
+        std::vector<float>      positions;  ///< x,y,z per vertex
+        std::vector<uint8_t>    colors;     ///< r,g,b per vertex
+    };
+
+    void push(Arrays& arrays,const pi::Point3f& p,const Color3b& c)
+    {
+        _bounds.extend(p);
+        arrays.positions.push_back(p.x);
+        arrays.positions.push_back(p.y);
+        arrays.positions.push_back(p.z);
+        arrays.colors.push_back(c.x);
+        arrays.colors.push_back(c.y);
+        arrays.colors.push_back(c.z);
+    }
+
+    Arrays          _arrays[CategoryCount];
+    unsigned int    _buffers[CategoryCount];    ///< positions then colors, 0 until first drawn
+    size_t          _capacity[CategoryCount];   ///< vertices the buffer holds
+    size_t          _uploaded[CategoryCount];   ///< vertices written to the buffer
+    float           _pointSize,_lineWidth;
+    BoundingBox     _bounds;
+    pi::Mutex       _mutex;
+};
+
+}}
+#endif // PRIMITIVEBATCH_H
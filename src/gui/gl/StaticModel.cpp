@@ -0,0 +1,178 @@
+#include "StaticModel.h"
+#include "OpenGL.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <map>
+
+#include <base/Thread/Mutex.h>
+#include <base/Debug/Exception.h>
+
+namespace pi{
+namespace gl{
+
+namespace {
+
+// filename -> model, not keeping the models alive
+typedef std::map<std::string,WPtr<StaticModel> > ModelCache;
+
+pi::Mutex& cacheMutex()
+{
+    static pi::Mutex mutex;
+    return mutex;
+}
+
+ModelCache& modelCache()
+{
+    static ModelCache cache;
+    return cache;
+}
+
+}
+
+size_t StaticModel::VertexHash::operator()(const Vertex& v) const
+{
+    // FNV-1a over the bytes, as VertexEqual compares them
+    const unsigned char* bytes=(const unsigned char*)&v;
+    uint64_t hash=14695981039346656037ULL;
+    for(size_t i=0;i<sizeof(Vertex);i++) hash=(hash^bytes[i])*1099511628211ULL;
+    return (size_t)hash;
+}
+
+bool StaticModel::VertexEqual::operator()(const Vertex& l,const Vertex& r) const
+{
+    return memcmp(&l,&r,sizeof(Vertex))==0;
+}
+
+StaticModel::StaticModel():_triangles(0),_sorted(true),_uploaded(false)
+{
+    _buffers[0]=_buffers[1]=0;
+}
+
+StaticModel::~StaticModel()
+{
+    // the GL buffers belong to a context which may be gone
+}
+
+unsigned int StaticModel::addMaterial(const Material& material)
+{
+    _materials.push_back(material);
+    _byMaterial.resize(_materials.size());
+    return _materials.size()-1;
+}
+
+void StaticModel::addTriangle(unsigned int material,const Vertex corners[3])
+{
+    if(_uploaded) throw pi::IllegalStateException("StaticModel: triangle added after the upload");
+    std::vector<unsigned int>& indices=_byMaterial.at(material);
+    for(int i=0;i<3;i++){
+        std::pair<std::unordered_map<Vertex,unsigned int,VertexHash,VertexEqual>::iterator,bool> found=
+                _lookup.insert(std::make_pair(corners[i],(unsigned int)_vertices.size()));
+        if(found.second){
+            _vertices.push_back(corners[i]);
+            _box.extend(pi::Point3f(corners[i].position[0],corners[i].position[1],corners[i].position[2]));
+        }
+        indices.push_back(found.first->second);
+    }
+    _triangles++;
+    _sorted=false;
+}
+
+const std::vector<unsigned int>& StaticModel::indices() const
+{
+    sort();
+    return _indices;
+}
+
+const std::vector<StaticModel::Group>& StaticModel::groups() const
+{
+    sort();
+    return _groups;
+}
+
+void StaticModel::sort() const
+{
+    if(_sorted) return;
+    _indices.clear();
+    _indices.reserve(_triangles*3);
+    _groups.clear();
+    for(size_t m=0;m<_byMaterial.size();m++){
+        if(_byMaterial[m].empty()) continue;
+        Group group={(unsigned int)m,_indices.size(),_byMaterial[m].size()};
+        _groups.push_back(group);
+        _indices.insert(_indices.end(),_byMaterial[m].begin(),_byMaterial[m].end());
+    }
+    _sorted=true;
+}
+
+void StaticModel::upload()
+{
+    sort();
+    glewInit();
+    glGenBuffers(2,_buffers);
+    glBindBuffer(GL_ARRAY_BUFFER,_buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER,_vertices.size()*sizeof(Vertex),&_vertices[0],GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,_buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,_indices.size()*sizeof(unsigned int),&_indices[0],GL_STATIC_DRAW);
+
+    if(_uploaded) return;
+    // the sorted indices hold everything now; the lookup is only for adding
+    std::unordered_map<Vertex,unsigned int,VertexHash,VertexEqual>().swap(_lookup);
+    std::vector<std::vector<unsigned int> >(_byMaterial.size()).swap(_byMaterial);
+    _uploaded=true;
+}
+
+void StaticModel::release()
+{
+    if(_buffers[0]) glDeleteBuffers(2,_buffers);
+    _buffers[0]=_buffers[1]=0;
+}
+
+void StaticModel::draw(bool materials)
+{
+    if(!_triangles) return;
+    if(!_buffers[0]) upload();
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glBindBuffer(GL_ARRAY_BUFFER,_buffers[0]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,_buffers[1]);
+    glVertexPointer(3,GL_FLOAT,sizeof(Vertex),(void*)offsetof(Vertex,position));
+    glNormalPointer(GL_FLOAT,sizeof(Vertex),(void*)offsetof(Vertex,normal));
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+
+    for(size_t i=0;i<_groups.size();i++){
+        const Group& group=_groups[i];
+        if(materials){
+            const Material& material=_materials[group.material];
+            glMaterialfv(GL_FRONT,GL_AMBIENT,material.ambient);
+            glMaterialfv(GL_FRONT,GL_DIFFUSE,material.diffuse);
+            glMaterialfv(GL_FRONT,GL_SPECULAR,material.specular);
+            glMaterialf(GL_FRONT,GL_SHININESS,material.shininess);
+        }
+        glDrawElements(GL_TRIANGLES,(GLsizei)group.count,GL_UNSIGNED_INT,
+                       (const GLvoid*)(group.first*sizeof(unsigned int)));
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    glPopClientAttrib();
+}
+
+SPtr<StaticModel> StaticModel::cached(const std::string& filename,Loader load)
+{
+    // loading under the lock keeps two objects from loading the same file
+    pi::ScopedMutex lock(cacheMutex());
+    ModelCache& cache=modelCache();
+    ModelCache::iterator it=cache.find(filename);
+    if(it!=cache.end()){
+        SPtr<StaticModel> model=it->second.lock();
+        if(model) return model;
+        cache.erase(it);
+    }
+    SPtr<StaticModel> model=load(filename);
+    if(model) cache[filename]=model;
+    return model;
+}
+
+}}
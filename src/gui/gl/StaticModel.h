@@ -0,0 +1,135 @@
+#ifndef STATICMODEL_H
+#define STATICMODEL_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <base/Types/SPtr.h>
+#include "Culling.h"
+
+namespace pi{
+namespace gl{
+
+class StaticModel
+    /// Triangles which do not change after loading, kept the way the GPU
+    /// draws them: one interleaved position/normal vertex buffer and one
+    /// index buffer, with the triangles sorted by material so that every
+    /// material is a single glDrawElements:
+    ///
+    ///     SPtr<StaticModel> model=StaticModel::cached(filename,loadModel);
+    ///     ...
+    ///     model->draw();
+    ///
+    /// Corners with equal position and normal share one vertex. The
+    /// buffers are created by the first draw(); models from cached() are
+    /// shared by everyone loading the same file, so they are uploaded
+    /// once however many objects show them. As for MeshInterleaved, the
+    /// destructor leaves the buffers to the context, which may be gone;
+    /// release() frees them in a context which lives on.
+{
+public:
+    struct Vertex
+    {
+        float position[3];
+        float normal[3];
+    };
+
+    struct Material
+    {
+        float ambient[4];
+        float diffuse[4];
+        float specular[4];
+        float shininess;        ///< the GL_SHININESS exponent, 0 to 128
+    };
+
+    struct Group
+        /// The triangles of one material, a range of indices.
+    {
+        unsigned int material;
+        size_t       first;
+        size_t       count;
+    };
+
+    struct Light
+        /// The lights some model files carry, in model coordinates.
+    {
+        float position[3];
+        float direction[3];     ///< of spot lights
+        bool  spot;
+    };
+
+    typedef SPtr<StaticModel> (*Loader)(const std::string& filename);
+
+    StaticModel();
+    ~StaticModel();
+
+    unsigned int addMaterial(const Material& material);
+        /// Returns the number to pass to addTriangle().
+
+    void addTriangle(unsigned int material,const Vertex corners[3]);
+        /// Triangles may come in any order of materials, but all of them
+        /// must be added before the first draw(); later ones throw an
+        /// IllegalStateException.
+
+    std::vector<Light> lights;
+
+    const std::vector<Vertex>&       vertices() const{return _vertices;}
+    const std::vector<unsigned int>& indices() const;
+    const std::vector<Group>&        groups() const;
+        /// The triangles sorted by material; groups without triangles are
+        /// left out.
+    const std::vector<Material>&     materials() const{return _materials;}
+    const BoundingBox&               box() const{return _box;}
+    size_t                           triangles() const{return _triangles;}
+
+    void draw(bool materials=true);
+        /// Uploads the buffers on the first call, then draws each group
+        /// with its material, or in the current color if materials is
+        /// false. Only called on the render thread.
+
+    void release();
+        /// Deletes the buffers, to be made again by the next draw(). Only
+        /// called on the render thread, with the context which drew the
+        /// model current.
+
+    static SPtr<StaticModel> cached(const std::string& filename,Loader load);
+        /// The model of filename if it is loaded already and still used
+        /// somewhere, otherwise load(filename), kept for the next caller.
+        /// A null result is not kept.
+
+private:
+    StaticModel(const StaticModel&);
+    StaticModel& operator=(const StaticModel&);
+
+    struct VertexHash
+    {
+        size_t operator()(const Vertex& v) const;
+    };
+    struct VertexEqual
+    {
+        bool operator()(const Vertex& l,const Vertex& r) const;
+    };
+
+    void sort() const;
+    void upload();
+
+    std::vector<Vertex>                             _vertices;
+    std::vector<Material>                           _materials;
+    std::vector<std::vector<unsigned int> >         _byMaterial;    ///< indices as added
+    std::unordered_map<Vertex,unsigned int,VertexHash,VertexEqual> _lookup;
+    size_t                                          _triangles;
+    BoundingBox                                     _box;
+
+    mutable std::vector<unsigned int>               _indices;
+    mutable std::vector<Group>                      _groups;
+    mutable bool                                    _sorted;
+
+    unsigned int                                    _buffers[2];
+    bool                                            _uploaded;      ///< triangles can't be added any more
+};
+
+}}
+
+#endif // STATICMODEL_H
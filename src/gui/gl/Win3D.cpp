@@ -1,5 +1,8 @@
 #include "Win3D.h"
 
+#include <iostream>
+#include <typeinfo>
+
 #include <base/Svar/Svar.h>
 #include <base/Svar/Scommand.h>
 
@@ -23,6 +26,14 @@ Win3D::Win3D(QWidget *parent)
     infos.push_back(&info);
 }
 
+bool Win3D::insert(const GL_Object& obj)
+{
+    if(scence.insert(obj)) return true;
+    cerr<<"Win3D: a "<<typeid(obj).name()<<" can't be inserted by reference, "
+          "insert it through a GL_ObjectPtr so that it is not copied"<<endl;
+    return false;
+}
+
 void Win3D::keyPressEvent(QKeyEvent *e)
 {
     if( event_handle != NULL ) {
@@ -47,9 +58,9 @@ void Win3D::drawWithNames()
 {
     bDrawWithNames=true;
     //Draw scence & objects
+    scence.draw();
     {
         pi::ScopedMutex lock(m_mutex);
-        scence.draw();
         for(size_t i=0;i<draw_opengl.size();i++)
             draw_opengl[i]->Draw_Something();
     }
@@ -175,8 +186,19 @@ void Win3D::preDraw()
     Q_EMIT drawNeeded();
 }
 
+void Win3D::applyInfo()
+{
+    infoCommands.consume([this](InfoCommand& command){
+        if(command.stream) infos.push_back(command.stream);
+        else if(command.clear) info.str("");
+        else info<<command.text;
+    });
+}
+
 void Win3D::draw()
 {
+    applyInfo();
+
     //Draw text
     if( svar.GetInt("Win3D.DrawInfoText", 1) ) {
         int j=1;
@@ -191,12 +213,23 @@ void Win3D::draw()
             for(;getline(tmp,str);j++)
                 this->drawText(10, 25*j, QString::fromStdString(str),QFont("",12,2,false));
         }
+
+        if( svar.GetInt("Win3D.ShowCullStats", 0) ) {
+            const CullStats& stats=scence.cullStats();
+            stringstream str;
+            str<<"Objects "<<stats.objects<<" drawn "<<stats.drawn<<" outside "<<stats.outside
+               <<" small "<<stats.small<<" nodes "<<stats.nodes<<" rebuilds "<<stats.rebuilds;
+            glColor3ub(0x00, 0xFF, 0xFF);
+            this->drawText(10, 25*j, QString::fromStdString(str.str()),QFont("",12,2,false));
+        }
     }
 
-    //Draw scence & objects
+    //Draw scence & objects, culled with the camera's matrices
+    scence.setCulling(svar.GetInt("Win3D.Culling", 1));
+    scence.setMinPixels(svar.GetDouble("Win3D.CullPixels", 0));
+    scence.draw();
     {
         pi::ScopedMutex lock(m_mutex);
-        scence.draw();
         for(size_t i=0;i<draw_opengl.size();i++)
             draw_opengl[i]->Draw_Something();
     }
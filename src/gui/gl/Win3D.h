@@ -18,6 +18,7 @@
 #include <base/Types/Point.h>
 #include <base/Types/SE3.h>
 #include <base/Thread/Thread.h>
+#include <base/Thread/MPSCQueue.h>
 #include <base/Types/SPtr.h>
 
 
@@ -35,15 +36,21 @@ class Win3D: public QGLViewer
 public:
     Win3D(QWidget *parent=NULL);
 
-    void insert(const GL_Object& obj)   {pi::ScopedMutex lock(m_mutex);scence.insert(obj);}
-    void insert(const GL_ObjectPtr& obj){pi::ScopedMutex lock(m_mutex);scence.insert(obj);}
-    void insert(GL_Object* obj){pi::ScopedMutex lock(m_mutex);scence.insert(GL_ObjectPtr(obj));}
+    // The scene and the info text are changed through command queues
+    // which draw() runs at the start of a frame, so these never wait
+    // for rendering.
+    bool insert(const GL_Object& obj);
+        // Only objects which append themselves to a PrimitiveBatch can be
+        // inserted by reference; others are reported and left out.
+    void insert(const GL_ObjectPtr& obj){scence.insert(obj);}
+    void insert(GL_Object* obj){scence.insert(GL_ObjectPtr(obj));}
+    void remove(const GL_ObjectPtr& obj){scence.remove(obj);}
 
     template <class T>
-    void InsertInfo(T msg){pi::ScopedMutex lock(m_mutex);info<<msg;}
-    void ClearInfo(){pi::ScopedMutex lock(m_mutex);info.str("");}
-    void ShowStream(std::stringstream* str){pi::ScopedMutex lock(m_mutex);infos.push_back(str);}
-    void ShowStream(std::stringstream& str){pi::ScopedMutex lock(m_mutex);infos.push_back(&str);}
+    void InsertInfo(T msg){std::stringstream str;str<<msg;infoCommands.push(InfoCommand(str.str()));}
+    void ClearInfo(){infoCommands.push(InfoCommand(std::string(),true));}
+    void ShowStream(std::stringstream* str){infoCommands.push(InfoCommand(str));}
+    void ShowStream(std::stringstream& str){infoCommands.push(InfoCommand(&str));}
 
     void SetEventHandle(EventHandle *handle) {
         pi::ScopedMutex lock(m_mutex);
@@ -56,6 +63,14 @@ public:
     }
 
     void clear(){scence.clear();}
+    Father_Object& scene(){return scence;}
+        /// For an OffscreenRenderer drawing the same objects; it has to
+        /// render in the context of this window, createContext=false, as
+        /// the GL buffers of the objects are not shared between contexts.
+    const CullStats& cullStats() const{return scence.cullStats();}
+        /// Culling is tuned with the Svars Win3D.Culling (on by default)
+        /// and Win3D.CullPixels; Win3D.ShowCullStats shows these numbers.
+
     void update(){emit update_signal();}
     void Show(){emit show_signal();}
 
@@ -97,7 +112,20 @@ public:
     std::vector<std::stringstream*> infos;
 
 protected:
+    struct InfoCommand
+    {
+        InfoCommand(const std::string& str,bool clr=false):text(str),stream(NULL),clear(clr){}
+        InfoCommand(std::stringstream* str):stream(str),clear(false){}
+
+        std::string         text;
+        std::stringstream*  stream;
+        bool                clear;
+    };
+
+    void applyInfo();
+
     Father_Object                   scence;
+    pi::MPSCQueue<InfoCommand>      infoCommands;
 
     EventHandle *                   event_handle;
     std::vector<Draw_Opengl*>       draw_opengl;
@@ -0,0 +1,410 @@
+#include "OctreeCloud.h"
+#include "../OpenGL.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/Debug/Exception.h"
+
+
+namespace pi {
+namespace gl {
+
+
+namespace {
+
+enum
+{
+    MAX_REQUESTS = 64   // nodes handed to the loader per frame
+};
+
+
+/// Older first, and children before parents among nodes used in the
+/// same frame, which the children always follow in the file.
+struct EvictionOrder
+{
+    EvictionOrder(const std::vector<uint64_t>& used): lastUsed(used) {}
+
+    bool operator () (int l, int r) const
+    {
+        if (lastUsed[l] != lastUsed[r]) return lastUsed[l] < lastUsed[r];
+        return l > r;
+    }
+
+    const std::vector<uint64_t>& lastUsed;
+};
+
+
+/// A triangle corner as uploaded, with the normal of its face.
+struct ShadedVertex
+{
+    float   x, y, z;
+    uint8_t r, g, b, a;
+    float   nx, ny, nz;
+};
+
+
+void shade(const std::vector<OctreePoint>& corners, std::vector<ShadedVertex>& vertices)
+{
+    vertices.resize(corners.size());
+    for (size_t i = 0; i + 2 < corners.size(); i += 3)
+    {
+        const OctreePoint* t = &corners[i];
+        float ux = t[1].x - t[0].x, uy = t[1].y - t[0].y, uz = t[1].z - t[0].z;
+        float vx = t[2].x - t[0].x, vy = t[2].y - t[0].y, vz = t[2].z - t[0].z;
+        float nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+        float length = sqrtf(nx * nx + ny * ny + nz * nz);
+        if (length > 0) { nx /= length; ny /= length; nz /= length; }
+        for (int j = 0; j < 3; j++)
+        {
+            ShadedVertex& v = vertices[i + j];
+            v.x  = t[j].x; v.y  = t[j].y; v.z  = t[j].z;
+            v.r  = t[j].r; v.g  = t[j].g; v.b  = t[j].b; v.a = t[j].a;
+            v.nx = nx;     v.ny = ny;     v.nz = nz;
+        }
+    }
+}
+
+
+} // namespace
+
+
+OctreeCloud::OctreeCloud(const std::string& filename):
+    _file(filename),
+    _slots(_file.nodes().size()),
+    _frame(0),
+    _bytes(0),
+    _maxError(2.f),
+    _budget(256 << 20),
+    _pointSize(1.f),
+    _stop(false)
+{
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.nodes = _slots.size();
+    _loader.startFunc([this]() { load(); });
+}
+
+
+OctreeCloud::~OctreeCloud()
+{
+    {
+        pi::FastMutex::ScopedLock lock(_mutex);
+        _stop = true;
+    }
+    _wake.set();
+    _loader.join();
+
+    // the GL buffers belong to a context which may be gone
+}
+
+
+void OctreeCloud::release()
+{
+    for (size_t i = 0; i < _slots.size(); i++)
+    {
+        Slot& slot = _slots[i];
+        if (!slot.buffer) continue;
+        // the host copy went with the upload, so the node is read again
+        _deadBuffers.push_back(slot.buffer);
+        slot.buffer = 0;
+        slot.state  = Unloaded;
+        _bytes -= _file.nodes()[i].points * sizeof(OctreePoint);
+    }
+    if (!_deadBuffers.empty()) glDeleteBuffers((GLsizei) _deadBuffers.size(), &_deadBuffers[0]);
+    _deadBuffers.clear();
+    _selected.clear();
+}
+
+
+bool OctreeCloud::bounds(BoundingBox& box)
+{
+    if (_file.nodes().empty()) return false;
+    box = _file.nodes()[0].box;
+    return true;
+}
+
+
+bool OctreeCloud::nodePoints(int node, std::vector<OctreePoint>& points) const
+{
+    const Slot& slot = _slots.at(node);
+    if (slot.state != Loaded || slot.buffer) return false;
+    points = slot.host;
+    return true;
+}
+
+
+void OctreeCloud::update(const Frustum& frustum)
+{
+    _frame++;
+    const std::vector<PointOctreeFile::Node>& nodes = _file.nodes();
+
+    _results.consume([this, &nodes](Result& result)
+    {
+        Slot& slot = _slots[result.node];
+        if (!result.points)
+        {
+            slot.state = Failed;
+            _stats.failures++;
+            return;
+        }
+        slot.host.swap(*result.points);
+        slot.state    = Loaded;
+        slot.lastUsed = _frame;
+        _bytes += nodes[result.node].points * sizeof(OctreePoint);
+        _stats.loads++;
+    });
+
+    // take back what the loader did not start on; what it did is in flight
+    std::vector<int> untaken;
+    {
+        pi::FastMutex::ScopedLock lock(_mutex);
+        untaken.swap(_requests);
+    }
+    for (size_t i = 0; i < untaken.size(); i++)
+        if (_slots[untaken[i]].state == Queued) _slots[untaken[i]].state = Unloaded;
+    for (size_t i = 0; i < _queued.size(); i++)
+        if (_slots[_queued[i]].state == Queued) _slots[_queued[i]].state = Loading;
+    _queued.clear();
+
+    _selected.clear();
+    _stats.visible = _stats.points = 0;
+    std::vector<std::pair<float, int> > wanted;
+    if (!nodes.empty())
+    {
+        if (_file.triangles()) visitMesh(0, 0x3f, frustum, wanted);
+        else                   visit(0, 0x3f, frustum, wanted);
+    }
+    _stats.drawn = _selected.size();
+
+    evict();
+
+    if (_bytes < _budget && !wanted.empty())
+    {
+        // the coarsest on screen last, where the loader takes from
+        std::sort(wanted.begin(), wanted.end());
+        size_t first = wanted.size() > MAX_REQUESTS ? wanted.size() - MAX_REQUESTS : 0;
+        for (size_t i = first; i < wanted.size(); i++)
+        {
+            _queued.push_back(wanted[i].second);
+            _slots[wanted[i].second].state = Queued;
+        }
+        {
+            pi::FastMutex::ScopedLock lock(_mutex);
+            _requests = _queued;
+        }
+        _wake.set();
+    }
+
+    _stats.loaded = _stats.queued = 0;
+    for (size_t i = 0; i < _slots.size(); i++)
+    {
+        int state = _slots[i].state;
+        _stats.loaded += state == Loaded;
+        _stats.queued += state == Queued || state == Loading;
+    }
+    _stats.bytes = _bytes;
+}
+
+
+void OctreeCloud::visit(int n, int planes, const Frustum& frustum, std::vector<std::pair<float, int> >& wanted)
+{
+    const PointOctreeFile::Node& node = _file.nodes()[n];
+    if (planes && frustum.test(node.box, planes) == Frustum::Outside) return;
+    _stats.visible++;
+
+    // the spacing of the points of the node on screen
+    float error = frustum.pixels(node.box) / _file.grid();
+
+    Slot& slot = _slots[n];
+    if (slot.state != Loaded)
+    {
+        if (slot.state == Unloaded) wanted.push_back(std::make_pair(error, n));
+        return;
+    }
+    slot.lastUsed = _frame;
+    _selected.push_back(n);
+    _stats.points += node.points;
+
+    if (error <= _maxError) return;
+    for (int k = 0; k < 8; k++)
+        if (node.children[k] >= 0) visit(node.children[k], planes, frustum, wanted);
+}
+
+
+void OctreeCloud::visitMesh(int n, int planes, const Frustum& frustum, std::vector<std::pair<float, int> >& wanted)
+{
+    const std::vector<PointOctreeFile::Node>& nodes = _file.nodes();
+    const PointOctreeFile::Node& node = nodes[n];
+    if (planes && frustum.test(node.box, planes) == Frustum::Outside) return;
+    _stats.visible++;
+
+    float error = frustum.pixels(node.box) / _file.grid();
+
+    Slot& slot = _slots[n];
+    if (slot.state != Loaded)
+    {
+        if (slot.state == Unloaded) wanted.push_back(std::make_pair(error, n));
+        return;
+    }
+    slot.lastUsed = _frame;
+
+    // the children replace this node only once all of them in view are here
+    bool refine = false;
+    if (error > _maxError)
+    {
+        bool complete = true;
+        for (int k = 0; k < 8; k++)
+        {
+            int c = node.children[k];
+            if (c < 0) continue;
+            int childPlanes = planes;
+            if (childPlanes && frustum.test(nodes[c].box, childPlanes) == Frustum::Outside) continue;
+            refine = true;
+
+            Slot& child = _slots[c];
+            if (child.state == Loaded) continue;
+            if (child.state == Unloaded) wanted.push_back(std::make_pair(frustum.pixels(nodes[c].box) / _file.grid(), c));
+            complete = false;
+        }
+        refine = refine && complete;
+    }
+    if (!refine)
+    {
+        _selected.push_back(n);
+        _stats.points += node.points;
+        return;
+    }
+    for (int k = 0; k < 8; k++)
+        if (node.children[k] >= 0) visitMesh(node.children[k], planes, frustum, wanted);
+}
+
+
+void OctreeCloud::evict()
+{
+    if (_bytes <= _budget) return;
+
+    std::vector<uint64_t> lastUsed(_slots.size());
+    std::vector<int>      candidates;
+    for (size_t i = 0; i < _slots.size(); i++)
+    {
+        lastUsed[i] = _slots[i].lastUsed;
+        if (_slots[i].state == Loaded && _slots[i].lastUsed < _frame) candidates.push_back((int) i);
+    }
+    std::sort(candidates.begin(), candidates.end(), EvictionOrder(lastUsed));
+
+    for (size_t i = 0; i < candidates.size() && _bytes > _budget; i++)
+    {
+        Slot& slot = _slots[candidates[i]];
+        std::vector<OctreePoint>().swap(slot.host);
+        if (slot.buffer) _deadBuffers.push_back(slot.buffer);
+        slot.buffer = 0;
+        slot.state  = Unloaded;
+        _bytes -= _file.nodes()[candidates[i]].points * sizeof(OctreePoint);
+        _stats.evictions++;
+    }
+}
+
+
+void OctreeCloud::draw()
+{
+    update(Frustum::fromGL());
+
+    if (!_deadBuffers.empty())
+    {
+        glDeleteBuffers((GLsizei) _deadBuffers.size(), &_deadBuffers[0]);
+        _deadBuffers.clear();
+    }
+    if (_selected.empty()) return;
+
+    bool triangles = _file.triangles();
+    std::vector<ShadedVertex> shaded;
+
+    glPushAttrib(GL_POINT_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    if (triangles) glEnableClientState(GL_NORMAL_ARRAY);
+    glPointSize(_pointSize);
+
+    for (size_t i = 0; i < _selected.size(); i++)
+    {
+        int   n    = _selected[i];
+        Slot& slot = _slots[n];
+        if (!slot.buffer)
+        {
+            glewInit();
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, slot.buffer);
+            if (triangles)
+            {
+                shade(slot.host, shaded);
+                glBufferData(GL_ARRAY_BUFFER, shaded.size() * sizeof(ShadedVertex), shaded.data(), GL_STATIC_DRAW);
+            }
+            else glBufferData(GL_ARRAY_BUFFER, slot.host.size() * sizeof(OctreePoint), slot.host.data(), GL_STATIC_DRAW);
+            std::vector<OctreePoint>().swap(slot.host);
+        }
+        else glBindBuffer(GL_ARRAY_BUFFER, slot.buffer);
+
+        if (triangles)
+        {
+            glVertexPointer(3, GL_FLOAT, sizeof(ShadedVertex), 0);
+            glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ShadedVertex), (const GLvoid*) offsetof(ShadedVertex, r));
+            glNormalPointer(GL_FLOAT, sizeof(ShadedVertex), (const GLvoid*) offsetof(ShadedVertex, nx));
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei) _file.nodes()[n].points);
+        }
+        else
+        {
+            glVertexPointer(3, GL_FLOAT, sizeof(OctreePoint), 0);
+            glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(OctreePoint), (const GLvoid*) offsetof(OctreePoint, r));
+            glDrawArrays(GL_POINTS, 0, (GLsizei) _file.nodes()[n].points);
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glPopClientAttrib();
+    glPopAttrib();
+}
+
+
+void OctreeCloud::load()
+{
+    std::vector<uint8_t> scratch;
+    for (;;)
+    {
+        int node = -1;
+        {
+            pi::FastMutex::ScopedLock lock(_mutex);
+            if (_stop) return;
+            if (!_requests.empty())
+            {
+                node = _requests.back();
+                _requests.pop_back();
+            }
+        }
+        if (node < 0)
+        {
+            _wake.wait();
+            continue;
+        }
+
+        Result result;
+        result.node = node;
+        try
+        {
+            SPtr<std::vector<OctreePoint> > points(new std::vector<OctreePoint>);
+            _file.read(node, *points, scratch);
+            result.points = points;
+        }
+        catch (pi::Exception&)
+        {
+            // reported as a failed node
+        }
+        _results.push(result);
+    }
+}
+
+
+} } // namespace pi::gl
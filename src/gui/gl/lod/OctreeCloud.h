@@ -0,0 +1,156 @@
+#ifndef PIL_OctreeCloud_INCLUDED
+#define PIL_OctreeCloud_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "PointOctree.h"
+#include "../GL_Object.h"
+#include "../Culling.h"
+#include "base/Thread/Event.h"
+#include "base/Thread/Mutex.h"
+#include "base/Thread/Thread.h"
+#include "base/Thread/MPSCQueue.h"
+#include "base/Types/SPtr.h"
+
+
+namespace pi {
+namespace gl {
+
+
+class OctreeCloud: public GL_Object
+    /// Draws a point cloud or triangle mesh of any size from an octree
+    /// file written by PointOctreeBuilder, keeping only the nodes in view
+    /// in memory.
+    ///
+    /// Each frame the octree is walked from the root through the loaded
+    /// nodes in the view frustum, and a node is refined while the spacing
+    /// of its points on screen is larger than setMaxError() pixels. The
+    /// points of a node add to those of its parent. The triangles of a
+    /// node replace those of its parent, which is drawn instead until all
+    /// of its children in view are loaded; triangles get the normal of
+    /// their face when uploaded.
+    /// Children which are needed but not loaded are handed to a loader
+    /// thread, the coarsest on screen first, which reads and decompresses
+    /// them; until they arrive their parents are drawn alone. Nodes not
+    /// drawn for the longest time are dropped once the loaded ones exceed
+    /// setMemoryBudget(). A node is uploaded to a vertex buffer the first
+    /// time it is drawn and its host copy is freed. As for MeshInterleaved,
+    /// the destructor leaves the buffers to the context, which may be
+    /// gone; release() frees them in a context which lives on.
+    ///
+    ///     win3d->insert(SPtr<GL_Object>(new OctreeCloud("survey.pct")));
+    ///
+    /// All members are called from the render thread.
+{
+public:
+    struct Stats
+    {
+        size_t nodes;       ///< in the file
+        size_t loaded;      ///< in memory
+        size_t queued;      ///< waiting for or being read by the loader
+        size_t visible;     ///< nodes in the view frustum, last frame
+        size_t drawn;       ///< nodes drawn, last frame
+        size_t points;      ///< points drawn, last frame
+        size_t bytes;       ///< of the loaded nodes
+        size_t loads;       ///< nodes loaded since construction
+        size_t evictions;   ///< nodes dropped since construction
+        size_t failures;    ///< nodes which could not be read
+    };
+
+    OctreeCloud(const std::string& filename);
+        /// Reads the node table and starts the loader thread. Throws a
+        /// FileNotFoundException, ReadFileException or DataFormatException.
+
+    ~OctreeCloud();
+        /// Stops the loader thread.
+
+    void  setMaxError(float pixels) { _maxError = pixels; }
+    float maxError() const          { return _maxError; }
+        /// 2 pixels by default.
+
+    void   setMemoryBudget(size_t bytes) { _budget = bytes; }
+    size_t memoryBudget() const          { return _budget; }
+        /// 256 MB by default. The nodes drawn in one frame are kept even
+        /// if they need more.
+
+    void setPointSize(float size) { _pointSize = size; }
+
+    virtual void draw();
+    virtual bool bounds(BoundingBox& box);
+
+    void release();
+        /// Deletes the vertex buffers, with the context which drew the
+        /// cloud current. The nodes they held are read again as needed.
+
+    void update(const Frustum& frustum);
+        /// Takes the nodes loaded meanwhile, selects the nodes to draw for
+        /// frustum, queues those missing and evicts. Makes no GL calls;
+        /// draw() calls it with the current GL matrices.
+
+    const Stats& stats() const { return _stats; }
+
+    const std::vector<int>& selected() const { return _selected; }
+        /// The nodes selected by the last update(). For a mesh, no node
+        /// is selected together with one of its ancestors.
+
+    const PointOctreeFile& file() const { return _file; }
+
+    bool nodePoints(int node, std::vector<OctreePoint>& points) const;
+        /// Copies the points of a loaded node which is not uploaded yet.
+
+private:
+    OctreeCloud(const OctreeCloud&);
+    OctreeCloud& operator = (const OctreeCloud&);
+
+    enum State { Unloaded, Queued, Loading, Loaded, Failed };
+
+    struct Slot
+    {
+        Slot(): state(Unloaded), lastUsed(0), buffer(0) {}
+
+        int                         state;
+        uint64_t                    lastUsed;   ///< the frame it was last drawn in
+        std::vector<OctreePoint>    host;       ///< until uploaded
+        unsigned int                buffer;
+    };
+
+    struct Result
+    {
+        int                                 node;
+        SPtr<std::vector<OctreePoint> >     points;     ///< null if reading failed
+    };
+
+    void visit(int node, int planes, const Frustum& frustum, std::vector<std::pair<float, int> >& wanted);
+    void visitMesh(int node, int planes, const Frustum& frustum, std::vector<std::pair<float, int> >& wanted);
+    void evict();
+    void load();
+
+    PointOctreeFile         _file;
+    std::vector<Slot>       _slots;
+    std::vector<int>        _selected;
+    std::vector<int>        _queued;        ///< the requests last handed to the loader
+    std::vector<unsigned>   _deadBuffers;   ///< of evicted nodes, deleted by the next draw()
+    uint64_t                _frame;
+    size_t                  _bytes;
+    float                   _maxError;
+    size_t                  _budget;
+    float                   _pointSize;
+    Stats                   _stats;
+
+    pi::FastMutex           _mutex;         ///< guards _requests and _stop
+    std::vector<int>        _requests;      ///< most important last
+    bool                    _stop;
+    pi::Event               _wake;
+    pi::MPSCQueue<Result>   _results;
+    pi::Thread              _loader;
+};
+
+
+} } // namespace pi::gl
+
+
+#endif // PIL_OctreeCloud_INCLUDED
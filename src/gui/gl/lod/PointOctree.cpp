@@ -0,0 +1,613 @@
+#include "PointOctree.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "base/Environment.h"
+#include "base/Debug/Exception.h"
+#include "base/Compress/LZFSEStream.h"
+
+extern "C" {
+#include "base/Compress/lzfse.h"
+}
+
+#ifdef PIL_OS_FAMILY_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+
+namespace pi {
+namespace gl {
+
+
+namespace {
+
+enum
+{
+    VERSION         = 1,
+    MAX_DEPTH       = 21,       // deeper nodes keep all their points
+    READ_BLOCK      = 1 << 16   // points read at once while splitting
+};
+
+
+const char MAGIC[8] = {'P', 'I', 'L', 'O', 'C', 'T', '\r', '\n'};
+
+
+struct FileHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t grid;
+    uint64_t nodeCount;
+    uint64_t tableOffset;       ///< of the FileNode table, after the node data
+    uint64_t pointCount;
+    uint32_t triangles;         ///< 1 if the nodes hold triangles
+    uint32_t reserved;
+};
+
+
+/// Closes a FILE on every way out of a scope.
+struct ScopedFile
+{
+    ScopedFile(FILE* f = 0): fp(f) {}
+    ~ScopedFile() { if (fp) fclose(fp); }
+
+    FILE* fp;
+};
+
+
+BoundingBox octant(const BoundingBox& box, int k)
+{
+    pi::Point3f c = box.center();
+    return BoundingBox(pi::Point3f(k & 1 ? c.x : box.min.x, k & 2 ? c.y : box.min.y, k & 4 ? c.z : box.min.z),
+                       pi::Point3f(k & 1 ? box.max.x : c.x, k & 2 ? box.max.y : c.y, k & 4 ? box.max.z : c.z));
+}
+
+
+void setPoint(OctreePoint& p, const float* xyz, const uint8_t* rgb)
+{
+    p.x = xyz[0];
+    p.y = xyz[1];
+    p.z = xyz[2];
+    if (rgb)
+    {
+        p.r = rgb[0];
+        p.g = rgb[1];
+        p.b = rgb[2];
+    }
+    else p.r = p.g = p.b = 255;
+    p.a = 255;
+}
+
+
+/// The cell of p in a grid of grid cells along each axis of box, which
+/// are scale cells per unit.
+uint32_t cellOf(const OctreePoint& p, const BoundingBox& box, float scale, int grid)
+{
+    int ix = std::min(std::max((int) ((p.x - box.min.x) * scale), 0), grid - 1);
+    int iy = std::min(std::max((int) ((p.y - box.min.y) * scale), 0), grid - 1);
+    int iz = std::min(std::max((int) ((p.z - box.min.z) * scale), 0), grid - 1);
+    return (uint32_t) ((iz * grid + iy) * grid + ix);
+}
+
+
+/// The cells of the corners of a triangle, sorted.
+struct CellTriangle
+{
+    uint32_t c[3];
+
+    bool operator == (const CellTriangle& t) const
+    {
+        return c[0] == t.c[0] && c[1] == t.c[1] && c[2] == t.c[2];
+    }
+};
+
+
+struct CellTriangleHash
+{
+    size_t operator () (const CellTriangle& t) const
+    {
+        uint64_t h = t.c[0];
+        h = h * 0x9E3779B97F4A7C15ULL ^ t.c[1];
+        h = h * 0x9E3779B97F4A7C15ULL ^ t.c[2];
+        return (size_t) (h ^ (h >> 32));
+    }
+};
+
+
+} // namespace
+
+
+struct PointOctreeBuilder::FileNode
+{
+    float    min[3], max[3];
+    int32_t  children[8];
+    uint32_t points;
+    uint32_t packedBytes;
+    uint64_t offset;
+};
+
+
+PointOctreeBuilder::PointOctreeBuilder(const std::string& filename, int maxNodePoints, int grid):
+    _filename(filename),
+    _maxNodePoints(std::max(maxNodePoints, 1)),
+    _grid(std::min(std::max(grid, 1), 1024)),
+    _pointsFile(0),
+    _count(0),
+    _triangles(false),
+    _out(0),
+    _offset(0),
+    _nodes(0)
+{
+    _points = temporary();
+}
+
+
+PointOctreeBuilder::~PointOctreeBuilder()
+{
+    if (_pointsFile) fclose(_pointsFile);
+    if (_out) fclose(_out);
+    for (size_t i = 0; i < _temporaries.size(); i++)
+        remove(_temporaries[i].c_str());
+}
+
+
+std::string PointOctreeBuilder::temporary()
+{
+    char suffix[32];
+    sprintf(suffix, ".%d.tmp", (int) _temporaries.size());
+    _temporaries.push_back(_filename + suffix);
+    return _temporaries.back();
+}
+
+
+void PointOctreeBuilder::open()
+{
+    if (!_pointsFile)
+    {
+        _pointsFile = fopen(_points.c_str(), "wb");
+        if (!_pointsFile) throw CreateFileException(_points);
+    }
+}
+
+
+void PointOctreeBuilder::add(const float* xyz, const uint8_t* rgb, size_t n, int stride)
+{
+    if (_count && _triangles) throw IllegalStateException(_filename, "cannot add points to a mesh octree");
+    _triangles = false;
+    open();
+
+    OctreePoint block[1024];
+    while (n > 0)
+    {
+        size_t m = std::min(n, sizeof(block) / sizeof(block[0]));
+        for (size_t i = 0; i < m; i++, xyz += stride)
+        {
+            OctreePoint& p = block[i];
+            setPoint(p, xyz, rgb);
+            if (rgb) rgb += stride;
+            _bounds.extend(pi::Point3f(p.x, p.y, p.z));
+        }
+        if (fwrite(block, sizeof(OctreePoint), m, _pointsFile) != m) throw WriteFileException(_points);
+        _count += m;
+        n      -= m;
+    }
+}
+
+
+void PointOctreeBuilder::addTriangles(const float* xyz, const uint8_t* rgb, size_t vertexCount,
+                                      const uint32_t* indices, size_t triangleCount, int stride)
+{
+    if (_count && !_triangles) throw IllegalStateException(_filename, "cannot add triangles to a point octree");
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        if (indices[i] >= vertexCount) throw InvalidArgumentException(_filename, "triangle index out of range");
+    _triangles = true;
+    open();
+
+    // the corners of each triangle, one after the other
+    OctreePoint block[1023];
+    while (triangleCount > 0)
+    {
+        size_t m = std::min(triangleCount, sizeof(block) / sizeof(block[0]) / 3);
+        for (size_t i = 0; i < m * 3; i++)
+        {
+            size_t       v = *indices++;
+            OctreePoint& p = block[i];
+            setPoint(p, xyz + v * stride, rgb ? rgb + v * stride : 0);
+            _bounds.extend(pi::Point3f(p.x, p.y, p.z));
+        }
+        if (fwrite(block, sizeof(OctreePoint), m * 3, _pointsFile) != m * 3) throw WriteFileException(_points);
+        _count        += m;
+        triangleCount -= m;
+    }
+}
+
+
+size_t PointOctreeBuilder::build()
+{
+    if (_pointsFile)
+    {
+        FILE* fp = _pointsFile;
+        _pointsFile = 0;
+        if (fclose(fp) != 0) throw WriteFileException(_points);
+    }
+
+    _out = fopen(_filename.c_str(), "wb");
+    if (!_out) throw CreateFileException(_filename);
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    write(&header, sizeof(header));
+    _offset = sizeof(header);
+
+    std::vector<FileNode> nodes;
+    _nodes = &nodes;
+    if (_count)
+    {
+        // a cube, so that the cells of the grid are cubes too
+        pi::Point3f c    = _bounds.center();
+        pi::Point3f d    = _bounds.max - _bounds.min;
+        float       half = std::max(std::max(d.x, d.y), d.z) * 0.5f;
+        half = half * 1.0001f + 1e-6f;
+        BoundingBox cube(c - pi::Point3f(half, half, half), c + pi::Point3f(half, half, half));
+        if (_triangles) splitTriangles(_points, _count, cube, 0);
+        else            split(_points, _count, cube, 0);
+    }
+    _nodes = 0;
+
+    uint64_t points = 0;
+    for (size_t i = 0; i < nodes.size(); i++) points += nodes[i].points;
+
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version     = VERSION;
+    header.grid        = _grid;
+    header.nodeCount   = nodes.size();
+    header.tableOffset = _offset;
+    header.pointCount  = points;
+    header.triangles   = _triangles;
+    if (!nodes.empty()) write(&nodes[0], nodes.size() * sizeof(FileNode));
+    if (fseek(_out, 0, SEEK_SET) != 0) throw WriteFileException(_filename);
+    write(&header, sizeof(header));
+
+    FILE* fp = _out;
+    _out = 0;
+    if (fclose(fp) != 0) throw WriteFileException(_filename);
+
+    _count     = 0;
+    _triangles = false;
+    _bounds    = BoundingBox();
+    return nodes.size();
+}
+
+
+int PointOctreeBuilder::split(const std::string& file, uint64_t count, const BoundingBox& box, int depth)
+{
+    int index = (int) _nodes->size();
+    FileNode node;
+    memset(&node, 0, sizeof(node));
+    for (int i = 0; i < 3; i++)
+    {
+        node.min[i] = box.min[i];
+        node.max[i] = box.max[i];
+    }
+    for (int k = 0; k < 8; k++) node.children[k] = -1;
+    _nodes->push_back(node);
+
+    ScopedFile in(fopen(file.c_str(), "rb"));
+    if (!in.fp) throw ReadFileException(file);
+
+    std::vector<OctreePoint> kept;
+    if (count <= (uint64_t) _maxNodePoints || depth >= MAX_DEPTH)
+    {
+        kept.resize(count);
+        if (fread(&kept[0], sizeof(OctreePoint), count, in.fp) != count) throw ReadFileException(file);
+        fclose(in.fp);
+        in.fp = 0;
+        remove(file.c_str());
+        writeNode(index, kept);
+        return index;
+    }
+
+    // the first point in each cell stays, the others go down to the octants
+    pi::Point3f                  center = box.center();
+    float                        scale  = _grid / (box.max.x - box.min.x);
+    std::unordered_set<uint32_t> cells;
+    cells.reserve((size_t) std::min<uint64_t>(count, (uint64_t) _grid * _grid * 4));
+
+    ScopedFile  children[8];
+    std::string childFiles[8];
+    uint64_t    childCounts[8] = {0};
+
+    std::vector<OctreePoint> block(READ_BLOCK);
+    size_t n;
+    while ((n = fread(&block[0], sizeof(OctreePoint), block.size(), in.fp)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            const OctreePoint& p = block[i];
+            if (cells.insert(cellOf(p, box, scale, _grid)).second)
+            {
+                kept.push_back(p);
+                continue;
+            }
+            int k = (p.x >= center.x) | (p.y >= center.y) << 1 | (p.z >= center.z) << 2;
+            if (!children[k].fp)
+            {
+                childFiles[k]  = temporary();
+                children[k].fp = fopen(childFiles[k].c_str(), "wb");
+                if (!children[k].fp) throw CreateFileException(childFiles[k]);
+            }
+            if (fwrite(&p, sizeof(OctreePoint), 1, children[k].fp) != 1) throw WriteFileException(childFiles[k]);
+            childCounts[k]++;
+        }
+    }
+    if (ferror(in.fp)) throw ReadFileException(file);
+    fclose(in.fp);
+    in.fp = 0;
+    remove(file.c_str());
+
+    for (int k = 0; k < 8; k++)
+    {
+        if (!children[k].fp) continue;
+        FILE* fp = children[k].fp;
+        children[k].fp = 0;
+        if (fclose(fp) != 0) throw WriteFileException(childFiles[k]);
+    }
+
+    writeNode(index, kept);
+    std::vector<OctreePoint>().swap(kept);
+    std::unordered_set<uint32_t>().swap(cells);
+
+    for (int k = 0; k < 8; k++)
+    {
+        if (!childCounts[k]) continue;
+        int child = split(childFiles[k], childCounts[k], octant(box, k), depth + 1);
+        (*_nodes)[index].children[k] = child;
+    }
+    return index;
+}
+
+
+int PointOctreeBuilder::splitTriangles(const std::string& file, uint64_t count, const BoundingBox& box, int depth)
+{
+    int index = (int) _nodes->size();
+    FileNode node;
+    memset(&node, 0, sizeof(node));
+    for (int k = 0; k < 8; k++) node.children[k] = -1;
+    _nodes->push_back(node);
+
+    ScopedFile in(fopen(file.c_str(), "rb"));
+    if (!in.fp) throw ReadFileException(file);
+
+    BoundingBox              extent = box;
+    std::vector<OctreePoint> kept;
+    std::vector<int>         childIndices;
+    if (count * 3 <= (uint64_t) _maxNodePoints || depth >= MAX_DEPTH)
+    {
+        kept.resize(count * 3);
+        if (fread(kept.data(), sizeof(OctreePoint), kept.size(), in.fp) != kept.size()) throw ReadFileException(file);
+        fclose(in.fp);
+        in.fp = 0;
+        remove(file.c_str());
+        for (size_t i = 0; i < kept.size(); i++) extent.extend(pi::Point3f(kept[i].x, kept[i].y, kept[i].z));
+        writeNode(index, kept);
+    }
+    else
+    {
+        // vertex clustering: the corners in a cell merge into the first
+        // one seen, and triangles with two corners in a cell vanish
+        pi::Point3f                                         center = box.center() * 3.f;
+        float                                               scale  = _grid / (box.max.x - box.min.x);
+        std::unordered_map<uint32_t, OctreePoint>           representatives;
+        std::unordered_set<CellTriangle, CellTriangleHash>  faces;
+
+        ScopedFile  children[8];
+        std::string childFiles[8];
+        uint64_t    childCounts[8] = {0};
+
+        std::vector<OctreePoint> block(READ_BLOCK / 3 * 3);
+        size_t n;
+        while ((n = fread(&block[0], sizeof(OctreePoint), block.size(), in.fp)) > 0)
+        {
+            if (n % 3) throw ReadFileException(file);
+            for (size_t i = 0; i < n; i += 3)
+            {
+                const OctreePoint* t = &block[i];
+                CellTriangle       cells;
+                for (int j = 0; j < 3; j++)
+                {
+                    extent.extend(pi::Point3f(t[j].x, t[j].y, t[j].z));
+                    cells.c[j] = cellOf(t[j], box, scale, _grid);
+                    representatives.insert(std::make_pair(cells.c[j], t[j]));
+                }
+                if (cells.c[0] != cells.c[1] && cells.c[1] != cells.c[2] && cells.c[0] != cells.c[2])
+                {
+                    CellTriangle key = cells;
+                    std::sort(key.c, key.c + 3);
+                    if (faces.insert(key).second)
+                        for (int j = 0; j < 3; j++) kept.push_back(representatives[cells.c[j]]);
+                }
+
+                // every triangle goes on to the octant of its centroid
+                int k = (t[0].x + t[1].x + t[2].x >= center.x) |
+                        (t[0].y + t[1].y + t[2].y >= center.y) << 1 |
+                        (t[0].z + t[1].z + t[2].z >= center.z) << 2;
+                if (!children[k].fp)
+                {
+                    childFiles[k]  = temporary();
+                    children[k].fp = fopen(childFiles[k].c_str(), "wb");
+                    if (!children[k].fp) throw CreateFileException(childFiles[k]);
+                }
+                if (fwrite(t, sizeof(OctreePoint), 3, children[k].fp) != 3) throw WriteFileException(childFiles[k]);
+                childCounts[k]++;
+            }
+        }
+        if (ferror(in.fp)) throw ReadFileException(file);
+        fclose(in.fp);
+        in.fp = 0;
+        remove(file.c_str());
+
+        for (int k = 0; k < 8; k++)
+        {
+            if (!children[k].fp) continue;
+            FILE* fp = children[k].fp;
+            children[k].fp = 0;
+            if (fclose(fp) != 0) throw WriteFileException(childFiles[k]);
+        }
+
+        writeNode(index, kept);
+        std::vector<OctreePoint>().swap(kept);
+        std::unordered_map<uint32_t, OctreePoint>().swap(representatives);
+        std::unordered_set<CellTriangle, CellTriangleHash>().swap(faces);
+
+        for (int k = 0; k < 8; k++)
+        {
+            if (!childCounts[k]) continue;
+            int child = splitTriangles(childFiles[k], childCounts[k], octant(box, k), depth + 1);
+            (*_nodes)[index].children[k] = child;
+        }
+    }
+
+    // the cube grown to the triangles of the subtree, for culling
+    FileNode& written = (*_nodes)[index];
+    for (int i = 0; i < 3; i++)
+    {
+        written.min[i] = extent.min[i];
+        written.max[i] = extent.max[i];
+    }
+    return index;
+}
+
+
+void PointOctreeBuilder::writeNode(int index, const std::vector<OctreePoint>& points)
+{
+    size_t raw = points.size() * sizeof(OctreePoint);
+    if (_scratch.empty()) _scratch.resize(lzfse_encode_scratch_size() + 1);
+    _packed.resize(raw + 12);    // enough for incompressible data
+
+    size_t n = lzfse_encode_buffer(&_packed[0], _packed.size(), (const uint8_t*) points.data(), raw, &_scratch[0]);
+    if (n == 0) throw WriteFileException(_filename, "cannot compress octree node");
+
+    FileNode& node   = (*_nodes)[index];
+    node.points      = (uint32_t) points.size();
+    node.packedBytes = (uint32_t) n;
+    node.offset      = _offset;
+    write(&_packed[0], n);
+    _offset += n;
+}
+
+
+void PointOctreeBuilder::write(const void* data, size_t bytes)
+{
+    if (fwrite(data, 1, bytes, _out) != bytes) throw WriteFileException(_filename);
+}
+
+
+PointOctreeFile::PointOctreeFile(const std::string& filename):
+    _filename(filename),
+    _fd(-1),
+    _pointCount(0),
+    _grid(0),
+    _triangles(false)
+{
+#ifdef PIL_OS_FAMILY_UNIX
+    _fd = ::open(filename.c_str(), O_RDONLY);
+#else
+    _fd = ::_open(filename.c_str(), _O_RDONLY | _O_BINARY);
+#endif
+    if (_fd < 0) throw FileNotFoundException(filename);
+
+    try
+    {
+        pi::compress::FileChunkSource source(_fd);
+        uint64_t size = source.size();
+
+        FileHeader header;
+        if (size < sizeof(header)) throw DataFormatException(filename, "not an octree file");
+        source.readAt(0, &header, sizeof(header));
+        if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) throw DataFormatException(filename, "not an octree file");
+        if (header.version != VERSION) throw DataFormatException(filename, "unsupported octree version");
+        if (header.tableOffset > size || (size - header.tableOffset) / sizeof(PointOctreeBuilder::FileNode) != header.nodeCount)
+            throw DataFormatException(filename, "octree node table truncated");
+
+        std::vector<PointOctreeBuilder::FileNode> table((size_t) header.nodeCount);
+        if (!table.empty()) source.readAt(header.tableOffset, &table[0], table.size() * sizeof(table[0]));
+
+        _nodes.resize(table.size());
+        uint64_t points = 0;
+        for (size_t i = 0; i < table.size(); i++)
+        {
+            const PointOctreeBuilder::FileNode& from = table[i];
+            Node& node = _nodes[i];
+            node.box         = BoundingBox(pi::Point3f(from.min[0], from.min[1], from.min[2]),
+                                           pi::Point3f(from.max[0], from.max[1], from.max[2]));
+            node.points      = from.points;
+            node.offset      = from.offset;
+            node.packedBytes = from.packedBytes;
+            for (int k = 0; k < 8; k++)
+            {
+                // children come after their parent, so the table has no cycles
+                int child = from.children[k];
+                if (child != -1 && (child <= (int) i || child >= (int) table.size()))
+                    throw DataFormatException(filename, "octree child out of range");
+                node.children[k] = child;
+            }
+            if (from.offset < sizeof(header) || from.offset + from.packedBytes > header.tableOffset)
+                throw DataFormatException(filename, "octree node out of range");
+            if (header.triangles && from.points % 3)
+                throw DataFormatException(filename, "octree node with a partial triangle");
+            points += from.points;
+        }
+        if (points != header.pointCount) throw DataFormatException(filename, "octree point count mismatch");
+        _pointCount = header.pointCount;
+        _grid       = header.grid;
+        _triangles  = header.triangles != 0;
+    }
+    catch (...)
+    {
+#ifdef PIL_OS_FAMILY_UNIX
+        ::close(_fd);
+#else
+        ::_close(_fd);
+#endif
+        throw;
+    }
+}
+
+
+PointOctreeFile::~PointOctreeFile()
+{
+#ifdef PIL_OS_FAMILY_UNIX
+    ::close(_fd);
+#else
+    ::_close(_fd);
+#endif
+}
+
+
+void PointOctreeFile::read(int index, std::vector<OctreePoint>& points, std::vector<uint8_t>& scratch) const
+{
+    const Node& node = _nodes.at(index);
+    size_t work = lzfse_decode_scratch_size();
+    scratch.resize(std::max<size_t>(work, 1) + node.packedBytes);
+    uint8_t* packed = &scratch[0] + std::max<size_t>(work, 1);
+    pi::compress::FileChunkSource(_fd).readAt(node.offset, packed, node.packedBytes);
+
+    // a spare point tells a complete node from one decoded up to the end of the buffer
+    size_t raw = node.points * sizeof(OctreePoint);
+    points.resize(node.points + 1);
+    size_t n = lzfse_decode_buffer((uint8_t*) &points[0], raw + 1, packed, node.packedBytes, &scratch[0]);
+    if (n != raw) throw DataFormatException(_filename, "corrupt octree node");
+    points.resize(node.points);
+}
+
+
+} } // namespace pi::gl
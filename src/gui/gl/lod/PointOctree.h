@@ -0,0 +1,162 @@
+#ifndef PIL_PointOctree_INCLUDED
+#define PIL_PointOctree_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "../Culling.h"
+
+
+namespace pi {
+namespace gl {
+
+
+struct OctreePoint
+    /// A point as stored in octree nodes and vertex buffers.
+{
+    float   x, y, z;
+    uint8_t r, g, b, a;
+};
+
+
+class PointOctreeBuilder
+    /// Tiles a point cloud into an octree file for OctreeCloud.
+    ///
+    /// Points are appended to a temporary file, so clouds larger than
+    /// memory can be tiled. build() then splits them top down: every
+    /// node keeps one point per cell of a grid over its box and hands the
+    /// others to its eight children, until at most maxNodePoints are
+    /// left. A node therefore holds a uniform sample of its box, and a
+    /// node together with its ancestors holds every point within it.
+    /// Each node is compressed with LZFSE and written as one block:
+    ///
+    ///     PointOctreeBuilder octree("survey.pct");
+    ///     octree.add(&cloud[0].x, &colors[0].x, cloud.size());
+    ///     octree.add(&scan[0].x, &scanColors[0].x, scan.size());
+    ///     octree.build();
+    ///
+    /// Triangle meshes are tiled with addTriangles() instead. Triangles go
+    /// to the octant of their centroid, down to leaves of at most
+    /// maxNodePoints vertices which keep them as they are. Every inner
+    /// node holds its whole box simplified by vertex clustering: the
+    /// vertices of a grid cell merge into the first of them, and
+    /// triangles with two corners in one cell vanish. A node therefore
+    /// replaces its children rather than adding to them, and the box of
+    /// a node grows to hold the triangles reaching out of its cube.
+    ///
+    /// The temporary files go next to the output file. The file is in
+    /// host byte order.
+{
+public:
+    PointOctreeBuilder(const std::string& filename, int maxNodePoints = 20000, int grid = 128);
+        /// grid is the number of cells along each axis of a node.
+        /// Throws a CreateFileException.
+
+    ~PointOctreeBuilder();
+        /// Removes the temporary files.
+
+    void add(const float* xyz, const uint8_t* rgb, size_t n, int stride = 3);
+        /// Appends n points, xyz and rgb being the first of n records
+        /// stride floats and stride bytes apart; rgb may be null for
+        /// white. Throws a WriteFileException.
+
+    void addTriangles(const float* xyz, const uint8_t* rgb, size_t vertexCount,
+                      const uint32_t* indices, size_t triangleCount, int stride = 3);
+        /// Appends a mesh of vertexCount vertices, laid out as for add(),
+        /// and triangleCount triangles of three indices each. A file holds
+        /// either points or triangles, so mixing them throws an
+        /// IllegalStateException; indices out of range throw an
+        /// InvalidArgumentException. Throws a WriteFileException.
+
+    size_t build();
+        /// Writes the octree file and returns its number of nodes; the
+        /// builder is empty afterwards. Throws a CreateFileException, ReadFileException or
+        /// WriteFileException.
+
+private:
+    PointOctreeBuilder(const PointOctreeBuilder&);
+    PointOctreeBuilder& operator = (const PointOctreeBuilder&);
+
+    friend class PointOctreeFile;
+    struct FileNode;
+
+    std::string temporary();
+    void open();
+    int  split(const std::string& file, uint64_t count, const BoundingBox& box, int depth);
+    int  splitTriangles(const std::string& file, uint64_t count, const BoundingBox& box, int depth);
+    void writeNode(int node, const std::vector<OctreePoint>& points);
+    void write(const void* data, size_t bytes);
+
+    std::string                 _filename;
+    int                         _maxNodePoints;
+    int                         _grid;
+    std::string                 _points;        ///< the temporary file of add()
+    FILE*                       _pointsFile;
+    uint64_t                    _count;         ///< of points or triangles
+    bool                        _triangles;
+    BoundingBox                 _bounds;
+    std::vector<std::string>    _temporaries;   ///< removed by the destructor, if still there
+    FILE*                       _out;
+    uint64_t                    _offset;
+    std::vector<FileNode>*      _nodes;
+    std::vector<uint8_t>        _packed, _scratch;
+};
+
+
+class PointOctreeFile
+    /// The node table of an octree file written by PointOctreeBuilder,
+    /// and reads of its nodes, which may happen on several threads.
+{
+public:
+    struct Node
+    {
+        BoundingBox box;            ///< the cube of the node, grown to its triangles
+        int         children[8];    ///< indices of the child nodes, -1 where there is none
+        uint32_t    points;         ///< three per triangle in a mesh
+        uint64_t    offset;         ///< of the compressed points in the file
+        uint32_t    packedBytes;
+    };
+
+    PointOctreeFile(const std::string& filename);
+        /// Reads the node table. Throws a FileNotFoundException,
+        /// ReadFileException or DataFormatException.
+
+    ~PointOctreeFile();
+
+    const std::vector<Node>& nodes() const { return _nodes; }
+        /// The root comes first.
+
+    uint64_t pointCount() const { return _pointCount; }
+        /// The points of all nodes; for a mesh, the vertices of the
+        /// triangles of all nodes.
+
+    int      grid() const       { return _grid; }
+    bool     triangles() const  { return _triangles; }
+        /// Whether the nodes hold triangles rather than points.
+
+    void read(int node, std::vector<OctreePoint>& points, std::vector<uint8_t>& scratch) const;
+        /// Decompresses the points of node; scratch is working memory of
+        /// the calling thread. Throws a ReadFileException or
+        /// DataFormatException.
+
+private:
+    PointOctreeFile(const PointOctreeFile&);
+    PointOctreeFile& operator = (const PointOctreeFile&);
+
+    std::string         _filename;
+    int                 _fd;
+    std::vector<Node>   _nodes;
+    uint64_t            _pointCount;
+    int                 _grid;
+    bool                _triangles;
+};
+
+
+} } // namespace pi::gl
+
+
+#endif // PIL_PointOctree_INCLUDED
@@ -0,0 +1,951 @@
+#include "ObjIO.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "base/Environment.h"
+#include "base/Debug/Exception.h"
+#include "base/Thread/AtomicCounter.h"
+#include "base/Thread/Thread.h"
+#include "base/Utils/Environment.h"
+#include "base/Utils/format/format.h"
+
+#ifdef PIL_OS_FAMILY_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+
+namespace pi {
+
+
+namespace {
+
+enum
+{
+    CHUNK_BYTES  = 1 << 20,     // smallest piece of the file parsed by one task
+    GRAIN        = 1 << 18,     // corners per task of the passes over all corners
+    PARTITIONS   = 64,          // position ranges deduplicated independently
+    WRITE_BUFFER = 4 << 20
+};
+
+
+const double POW10[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+inline bool isDigit(char c)
+{
+    return (unsigned) (c - '0') < 10;
+}
+
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+inline const char* skipBlanks(const char* p, const char* end)
+{
+    while (p < end && isBlank(*p)) p++;
+    return p;
+}
+
+
+/// The rest of the line without surrounding blanks.
+std::string restOfLine(const char* p, const char* end)
+{
+    p = skipBlanks(p, end);
+    while (end > p && isBlank(end[-1])) end--;
+    return std::string(p, end);
+}
+
+
+/// Whether the text at p starts with the lower case word, in any case.
+inline bool startsWith(const char* p, const char* end, const char* word)
+{
+    for (; *word; p++, word++)
+        if (p == end || (*p | 0x20) != *word) return false;
+    return true;
+}
+
+
+/// Parses a float at p. Up to 19 significant digits and exponents within
+/// +-22 are converted exactly with one multiplication or division; other
+/// numbers are scaled in double precision, which is still far finer than
+/// a float. Unlike strtod the decimal point is '.' in any locale. Returns
+/// p if there is no number, nan or inf.
+const char* parseFloat(const char* p, const char* end, float& value)
+{
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int      exponent = 0, digits = 0;
+    bool     any      = false;
+    for (; p < end && isDigit(*p); p++, any = true)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        }
+        else exponent++;
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && isDigit(*p); p++, any = true)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+        }
+    }
+
+    if (!any)
+    {
+        // as printf writes them
+        if (startsWith(p, end, "nan"))
+        {
+            value = negative ? -std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::quiet_NaN();
+            return p + 3;
+        }
+        if (startsWith(p, end, "inf"))
+        {
+            value = negative ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+            return p + (startsWith(p, end, "infinity") ? 8 : 3);
+        }
+        return start;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+')) negativeExponent = *q++ == '-';
+        if (q < end && isDigit(*q))
+        {
+            int e = 0;
+            for (; q < end && isDigit(*q); q++)
+                if (e < 10000) e = e * 10 + (*q - '0');
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    double v;
+    if (exponent >= -22 && exponent <= 22 && mantissa < (1ULL << 53))
+        v = exponent < 0 ? mantissa / POW10[-exponent] : mantissa * POW10[exponent];
+    else if (!mantissa || exponent < -80)
+        v = 0;          // below the smallest float even with 19 digits
+    else if (exponent > 60)
+        v = HUGE_VAL;   // above the largest float
+    else
+        v = mantissa * pow(10.0, exponent);
+    value = (float) (negative ? -v : v);
+    return p;
+}
+
+
+/// Parses a non zero, possibly negative OBJ index. Returns p if there is none.
+inline const char* parseIndex(const char* p, const char* end, int64_t& index)
+{
+    const char* start = p;
+    bool negative = p < end && *p == '-';
+    if (negative) p++;
+    if (p == end || !isDigit(*p)) return start;
+
+    int64_t v = 0;
+    for (; p < end && isDigit(*p); p++)
+        if (v < (1LL << 40)) v = v * 10 + (*p - '0');
+    index = negative ? -v : v;
+    return p;
+}
+
+
+inline char* append(char* p, const fmt::FormatInt& number)
+{
+    memcpy(p, number.data(), number.size());
+    return p + number.size();
+}
+
+
+/// Calls func(task) for every task in [0, tasks) on threads workers, the
+/// calling thread included.
+template <class F>
+void parallelFor(size_t tasks, int threads, F func)
+{
+    if (threads <= 1 || tasks <= 1)
+    {
+        for (size_t i = 0; i < tasks; i++) func(i);
+        return;
+    }
+
+    AtomicCounter next(0);
+    auto work = [&]() {
+        for (;;)
+        {
+            size_t task = (size_t) (next++);
+            if (task >= tasks) break;
+            func(task);
+        }
+    };
+
+    int workers = (int) std::min((size_t) threads, tasks) - 1;
+    std::vector<Thread*> pool;
+    for (int i = 0; i < workers; i++)
+    {
+        pool.push_back(new Thread);
+        pool.back()->setName("ObjWorker");
+        pool.back()->startFunc(work);
+    }
+    work();
+    for (size_t i = 0; i < pool.size(); i++)
+    {
+        pool[i]->join();
+        delete pool[i];
+    }
+}
+
+
+/// A read only view of a whole file, mapped where possible.
+class MappedFile
+{
+public:
+    MappedFile(const std::string& filename): _data(0), _size(0), _mapped(false)
+    {
+#ifdef PIL_OS_FAMILY_UNIX
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) throw FileNotFoundException(filename);
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw ReadFileException(filename);
+        }
+        _size = (size_t) st.st_size;
+        if (_size)
+        {
+            void* p = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                ::close(fd);
+                throw ReadFileException(filename);
+            }
+            madvise(p, _size, MADV_SEQUENTIAL);
+            _data   = (const char*) p;
+            _mapped = true;
+        }
+        ::close(fd);
+#else
+        FILE* fp = fopen(filename.c_str(), "rb");
+        if (!fp) throw FileNotFoundException(filename);
+        fseek(fp, 0, SEEK_END);
+        _buffer.resize((size_t) ftell(fp));
+        fseek(fp, 0, SEEK_SET);
+        if (!_buffer.empty() && fread(&_buffer[0], 1, _buffer.size(), fp) != _buffer.size())
+        {
+            fclose(fp);
+            throw ReadFileException(filename);
+        }
+        fclose(fp);
+        _size = _buffer.size();
+        _data = _buffer.empty() ? 0 : &_buffer[0];
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef PIL_OS_FAMILY_UNIX
+        if (_mapped) munmap((void*) _data, _size);
+#endif
+    }
+
+    const char* data() const { return _data; }
+    size_t      size() const { return _size; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator = (const MappedFile&);
+
+    const char*         _data;
+    size_t              _size;
+    bool                _mapped;
+    std::vector<char>   _buffer;
+};
+
+
+/// One triangle corner: 0 based indices of position, texcoord and
+/// normal, -1 where missing.
+struct Corner
+{
+    int32_t v, t, n;
+};
+
+
+/// What the parsing of one line aligned piece of the file found. Indices
+/// relative to the end of the lists ("f -1 -2 -3") depend on the pieces
+/// before, they are kept relative to this one and listed in relative.
+struct Chunk
+{
+    const char*             begin;
+    const char*             end;
+
+    std::vector<float>      positions;
+    std::vector<float>      colors;     // empty until a colored position
+    std::vector<float>      texcoords;
+    std::vector<float>      normals;
+    size_t                  colored;
+
+    std::vector<Corner>     corners;
+    std::vector<size_t>     relative;   // corner * 3 + component
+    std::vector<std::pair<size_t, std::string> > materials;   // usemtl at a corner
+    std::vector<std::string> libraries;
+
+    std::string             error;
+
+    void parse();
+
+private:
+    void parseFace(const char* p, const char* end);
+
+    std::vector<Corner>     _polygon;
+    std::vector<uint8_t>    _polygonRelative;
+};
+
+
+void Chunk::parse()
+{
+    colored = 0;
+    for (const char* p = begin; p < end; )
+    {
+        const char* eol = (const char*) memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+
+        p = skipBlanks(p, eol);
+        if (eol - p >= 2 && p[0] == 'v' && isBlank(p[1]))
+        {
+            float v[7];
+            int   n = 0;
+            for (const char* q = p + 2; n < 7; n++)
+            {
+                const char* r = parseFloat(skipBlanks(q, eol), eol, v[n]);
+                if (r == skipBlanks(q, eol)) break;
+                q = r;
+            }
+            if (n < 3) throw DataFormatException("OBJ vertex with less than three coordinates");
+            positions.insert(positions.end(), v, v + 3);
+
+            // x y z r g b, or x y z w r g b
+            if (n >= 6)
+            {
+                if (colors.size() < (positions.size() / 3 - 1) * 3)
+                    colors.resize((positions.size() / 3 - 1) * 3, 1.0f);
+                colors.insert(colors.end(), v + n - 3, v + n);
+                colored++;
+            }
+            else if (!colors.empty())
+            {
+                colors.resize(colors.size() + 3, 1.0f);
+            }
+        }
+        else if (eol - p >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2]))
+        {
+            float       uv[2] = { 0, 0 };
+            const char* q     = p + 3;
+            for (int i = 0; i < 2; i++)
+                q = parseFloat(skipBlanks(q, eol), eol, uv[i]);
+            texcoords.insert(texcoords.end(), uv, uv + 2);
+        }
+        else if (eol - p >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]))
+        {
+            float       xyz[3] = { 0, 0, 0 };
+            const char* q      = p + 3;
+            for (int i = 0; i < 3; i++)
+                q = parseFloat(skipBlanks(q, eol), eol, xyz[i]);
+            normals.insert(normals.end(), xyz, xyz + 3);
+        }
+        else if (eol - p >= 2 && p[0] == 'f' && isBlank(p[1]))
+        {
+            parseFace(p + 2, eol);
+        }
+        else if (eol - p >= 7 && memcmp(p, "usemtl", 6) == 0 && isBlank(p[6]))
+        {
+            materials.push_back(std::make_pair(corners.size(), restOfLine(p + 7, eol)));
+        }
+        else if (eol - p >= 7 && memcmp(p, "mtllib", 6) == 0 && isBlank(p[6]))
+        {
+            libraries.push_back(restOfLine(p + 7, eol));
+        }
+
+        p = eol + 1;
+    }
+}
+
+
+void Chunk::parseFace(const char* p, const char* end)
+{
+    _polygon.clear();
+    _polygonRelative.clear();
+
+    size_t counts[3] = { positions.size() / 3, texcoords.size() / 2, normals.size() / 3 };
+    for (p = skipBlanks(p, end); p < end && *p != '#'; p = skipBlanks(p, end))
+    {
+        // v, v/t, v//n or v/t/n
+        Corner   c         = { -1, -1, -1 };
+        int32_t* fields[3] = { &c.v, &c.t, &c.n };
+        uint8_t  relative  = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            int64_t     index = 0;
+            const char* q     = parseIndex(p, end, index);
+            if (q != p)
+            {
+                if (index == 0 || index > 0x7FFFFFFF || index < -0x7FFFFFFF)
+                    throw DataFormatException("OBJ index out of range");
+                if (index > 0)
+                    *fields[i] = (int32_t) (index - 1);
+                else
+                {
+                    *fields[i] = (int32_t) ((int64_t) counts[i] + index);
+                    relative  |= 1 << i;
+                }
+                p = q;
+            }
+            else if (i == 0)
+                throw DataFormatException("OBJ face without a position index");
+
+            if (p < end && *p == '/') p++;
+            else break;
+        }
+        if (p < end && !isBlank(*p)) throw DataFormatException("OBJ face malformed");
+        _polygon.push_back(c);
+        _polygonRelative.push_back(relative);
+    }
+
+    // a triangle fan
+    for (size_t j = 1; j + 1 < _polygon.size(); j++)
+    {
+        size_t picks[3] = { 0, j, j + 1 };
+        for (int k = 0; k < 3; k++)
+        {
+            uint8_t r = _polygonRelative[picks[k]];
+            for (int i = 0; i < 3; i++)
+                if (r & (1 << i)) relative.push_back(corners.size() * 3 + i);
+            corners.push_back(_polygon[picks[k]]);
+        }
+    }
+}
+
+
+inline int32_t& component(Corner& c, size_t i)
+{
+    return i == 0 ? c.v : (i == 1 ? c.t : c.n);
+}
+
+
+/// A distinct position/texcoord/normal triple of one partition.
+struct Unique
+{
+    int32_t  v, t, n;
+    uint32_t next;      // of the same position
+};
+
+} // namespace
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ObjReader
+////////////////////////////////////////////////////////////////////////////////
+
+ObjReader::ObjReader(const std::string& filename, int threads)
+{
+    threads = threads < 0 ? std::max(1, (int) Environment::processorCount()) : std::max(1, threads);
+
+    MappedFile file(filename);
+    const char* data = file.data();
+    size_t      size = file.size();
+
+    // line aligned chunks, a few per thread
+    size_t pieces = std::max<size_t>(1, std::min<size_t>(size / CHUNK_BYTES, threads * 4));
+    std::vector<Chunk> chunks(pieces);
+    const char* begin = data;
+    for (size_t i = 0; i < pieces; i++)
+    {
+        const char* end = data + size * (i + 1) / pieces;
+        if (i + 1 < pieces)
+        {
+            const char* eol = (const char*) memchr(end, '\n', data + size - end);
+            end = eol ? eol + 1 : data + size;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end   = std::max(begin, end);
+        begin = chunks[i].end;
+    }
+
+    parallelFor(pieces, threads, [&](size_t i) {
+        try
+        {
+            chunks[i].parse();
+        }
+        catch (std::exception& e)
+        {
+            chunks[i].error = e.what();
+        }
+    });
+
+    // offsets of the chunks in the whole file
+    size_t totalPositions = 0, totalTexcoords = 0, totalNormals = 0, totalCorners = 0, totalColored = 0;
+    std::vector<size_t> positionBase(pieces), texcoordBase(pieces), normalBase(pieces), cornerBase(pieces);
+    for (size_t i = 0; i < pieces; i++)
+    {
+        if (!chunks[i].error.empty()) throw DataFormatException(filename, chunks[i].error);
+        positionBase[i] = totalPositions;
+        texcoordBase[i] = totalTexcoords;
+        normalBase[i]   = totalNormals;
+        cornerBase[i]   = totalCorners;
+        totalPositions += chunks[i].positions.size() / 3;
+        totalTexcoords += chunks[i].texcoords.size() / 2;
+        totalNormals   += chunks[i].normals.size() / 3;
+        totalCorners   += chunks[i].corners.size();
+        totalColored   += chunks[i].colored;
+    }
+    if (totalCorners > 0xFFFFFFFFu || totalPositions > 0x7FFFFFFFu ||
+        totalTexcoords > 0x7FFFFFFFu || totalNormals > 0x7FFFFFFFu)
+        throw DataFormatException(filename, "OBJ file too large");
+
+    // gather the lists and resolve the relative indices
+    std::vector<float>  positions(totalPositions * 3), texcoords(totalTexcoords * 2), normals(totalNormals * 3);
+    std::vector<float>  colors(totalColored == totalPositions ? totalPositions * 3 : 0);
+    std::vector<Corner> corners(totalCorners);
+    std::vector<int>    usage(pieces, 0);  // bit 0 texcoords, bit 1 normals, bit 2 bad index
+    parallelFor(pieces, threads, [&](size_t i) {
+        Chunk& c = chunks[i];
+        if (!c.positions.empty()) memcpy(&positions[positionBase[i] * 3], &c.positions[0], c.positions.size() * sizeof(float));
+        if (!c.texcoords.empty()) memcpy(&texcoords[texcoordBase[i] * 2], &c.texcoords[0], c.texcoords.size() * sizeof(float));
+        if (!c.normals.empty())   memcpy(&normals[normalBase[i] * 3], &c.normals[0], c.normals.size() * sizeof(float));
+        if (!colors.empty() && !c.colors.empty()) memcpy(&colors[positionBase[i] * 3], &c.colors[0], c.colors.size() * sizeof(float));
+        std::vector<float>().swap(c.positions);
+        std::vector<float>().swap(c.texcoords);
+        std::vector<float>().swap(c.normals);
+        std::vector<float>().swap(c.colors);
+
+        size_t n = c.corners.size();
+        if (!n) return;
+        Corner* out = &corners[cornerBase[i]];
+        memcpy(out, &c.corners[0], n * sizeof(Corner));
+        const int32_t base[3] = { (int32_t) positionBase[i], (int32_t) texcoordBase[i], (int32_t) normalBase[i] };
+        for (size_t r = 0; r < c.relative.size(); r++)
+            component(out[c.relative[r] / 3], c.relative[r] % 3) += base[c.relative[r] % 3];
+        std::vector<Corner>().swap(c.corners);
+
+        int u = 0;
+        for (size_t k = 0; k < n; k++)
+        {
+            const Corner& x = out[k];
+            if (x.t >= 0) u |= 1;
+            if (x.n >= 0) u |= 2;
+            if (x.v < 0 || x.v >= (int64_t) totalPositions ||
+                x.t < -1 || x.t >= (int64_t) totalTexcoords ||
+                x.n < -1 || x.n >= (int64_t) totalNormals)
+                u |= 4;
+        }
+        usage[i] = u;
+    });
+
+    int used = 0;
+    for (size_t i = 0; i < pieces; i++) used |= usage[i];
+    if (used & 4) throw DataFormatException(filename, "OBJ index out of range");
+
+    // the material runs, in corners
+    std::vector<std::string> libraries, runNames;
+    std::vector<size_t>      runStarts;
+    for (size_t i = 0; i < pieces; i++)
+    {
+        for (size_t m = 0; m < chunks[i].materials.size(); m++)
+        {
+            size_t first = cornerBase[i] + chunks[i].materials[m].first;
+            if (!runStarts.empty() && runStarts.back() == first)
+                runNames.back() = chunks[i].materials[m].second;    // an empty run
+            else
+            {
+                runStarts.push_back(first);
+                runNames.push_back(chunks[i].materials[m].second);
+            }
+        }
+        for (size_t l = 0; l < chunks[i].libraries.size(); l++)
+            if (std::find(libraries.begin(), libraries.end(), chunks[i].libraries[l]) == libraries.end())
+                libraries.push_back(chunks[i].libraries[l]);
+    }
+    chunks.clear();
+
+    if (!(used & 3))
+    {
+        // positions only: keep them as they are
+        _positions.swap(positions);
+        _colors.swap(colors);
+        _indices.resize(totalCorners);
+        parallelFor((totalCorners + GRAIN - 1) / GRAIN, threads, [&](size_t task) {
+            size_t last = std::min<size_t>(totalCorners, (task + 1) * GRAIN);
+            for (size_t k = task * GRAIN; k < last; k++) _indices[k] = (uint32_t) corners[k].v;
+        });
+    }
+    else if (totalCorners)
+    {
+        // Triples of different positions are always different, so the
+        // positions are cut into ranges deduplicated on their own. The
+        // corners are first sorted by range, stably.
+        size_t blocks = std::max<size_t>(1, std::min<size_t>(totalCorners / GRAIN + 1, threads * 4));
+        std::vector<size_t> slots(blocks * PARTITIONS, 0);
+        auto partitionOf = [&](int64_t v) { return (size_t) ((uint64_t) v * PARTITIONS / totalPositions); };
+        auto blockRange  = [&](size_t b, size_t& first, size_t& last) {
+            first = totalCorners * b / blocks;
+            last  = totalCorners * (b + 1) / blocks;
+        };
+
+        parallelFor(blocks, threads, [&](size_t b) {
+            size_t first, last;
+            blockRange(b, first, last);
+            for (size_t k = first; k < last; k++) slots[b * PARTITIONS + partitionOf(corners[k].v)]++;
+        });
+
+        std::vector<size_t> partitionStart(PARTITIONS + 1, 0);
+        size_t running = 0;
+        for (size_t p = 0; p < PARTITIONS; p++)
+        {
+            partitionStart[p] = running;
+            for (size_t b = 0; b < blocks; b++)
+            {
+                size_t n = slots[b * PARTITIONS + p];
+                slots[b * PARTITIONS + p] = running;
+                running += n;
+            }
+        }
+        partitionStart[PARTITIONS] = running;
+
+        std::vector<uint32_t> order(totalCorners);
+        parallelFor(blocks, threads, [&](size_t b) {
+            size_t first, last;
+            blockRange(b, first, last);
+            for (size_t k = first; k < last; k++) order[slots[b * PARTITIONS + partitionOf(corners[k].v)]++] = (uint32_t) k;
+        });
+
+        _indices.resize(totalCorners);
+        std::vector<std::vector<Unique> > uniques(PARTITIONS);
+        parallelFor(PARTITIONS, threads, [&](size_t p) {
+            size_t lo = (totalPositions * p + PARTITIONS - 1) / PARTITIONS;
+            size_t hi = (totalPositions * (p + 1) + PARTITIONS - 1) / PARTITIONS;
+            std::vector<uint32_t> head(hi - lo, 0xFFFFFFFFu);
+            std::vector<Unique>&  list = uniques[p];
+            for (size_t o = partitionStart[p]; o < partitionStart[p + 1]; o++)
+            {
+                const Corner& c = corners[order[o]];
+                uint32_t&     h = head[c.v - lo];
+                uint32_t      u = h;
+                while (u != 0xFFFFFFFFu && (list[u].t != c.t || list[u].n != c.n)) u = list[u].next;
+                if (u == 0xFFFFFFFFu)
+                {
+                    Unique x = { c.v, c.t, c.n, h };
+                    u = h = (uint32_t) list.size();
+                    list.push_back(x);
+                }
+                _indices[order[o]] = u;
+            }
+        });
+        std::vector<uint32_t>().swap(order);
+
+        std::vector<size_t> vertexBase(PARTITIONS + 1, 0);
+        for (size_t p = 0; p < PARTITIONS; p++) vertexBase[p + 1] = vertexBase[p] + uniques[p].size();
+        size_t vertexCount = vertexBase[PARTITIONS];
+
+        _positions.resize(vertexCount * 3);
+        if (!colors.empty()) _colors.resize(vertexCount * 3);
+        if (used & 1) _texcoords.resize(vertexCount * 2, 0.0f);
+        if (used & 2) _normals.resize(vertexCount * 3, 0.0f);
+
+        parallelFor(PARTITIONS, threads, [&](size_t p) {
+            const std::vector<Unique>& list = uniques[p];
+            for (size_t u = 0; u < list.size(); u++)
+            {
+                size_t out = vertexBase[p] + u;
+                memcpy(&_positions[out * 3], &positions[list[u].v * 3], 3 * sizeof(float));
+                if (!_colors.empty()) memcpy(&_colors[out * 3], &colors[list[u].v * 3], 3 * sizeof(float));
+                if (list[u].t >= 0 && !_texcoords.empty()) memcpy(&_texcoords[out * 2], &texcoords[list[u].t * 2], 2 * sizeof(float));
+                if (list[u].n >= 0 && !_normals.empty())   memcpy(&_normals[out * 3], &normals[list[u].n * 3], 3 * sizeof(float));
+            }
+        });
+        // from indices within the partitions to vertex indices
+        parallelFor(blocks, threads, [&](size_t b) {
+            size_t first, last;
+            blockRange(b, first, last);
+            for (size_t k = first; k < last; k++) _indices[k] += (uint32_t) vertexBase[partitionOf(corners[k].v)];
+        });
+    }
+    else
+    {
+        _positions.swap(positions);
+        _colors.swap(colors);
+    }
+
+    // materials
+    std::string directory = filename.substr(0, filename.find_last_of("/\\") + 1);
+    for (size_t l = 0; l < libraries.size(); l++)
+    {
+        std::string path = libraries[l];
+        if (path.empty() || (path[0] != '/' && path[0] != '\\' && path.find(':') == std::string::npos))
+            path = directory + path;
+        try
+        {
+            readMaterials(path);
+        }
+        catch (FileNotFoundException&)
+        {
+        }
+    }
+
+    if (!runStarts.empty() && runStarts[0] != 0)
+    {
+        runStarts.insert(runStarts.begin(), 0);
+        runNames.insert(runNames.begin(), std::string());
+    }
+    for (size_t r = 0; r < runStarts.size(); r++)
+    {
+        MaterialRun run = { runStarts[r], -1 };
+        for (size_t m = 0; m < _materials.size(); m++)
+            if (_materials[m].name == runNames[r]) run.material = (int) m;
+        _runs.push_back(run);
+    }
+}
+
+
+void ObjReader::readMaterials(const std::string& filename)
+{
+    MappedFile  file(filename);
+    const char* end       = file.data() + file.size();
+    std::string directory = filename.substr(0, filename.find_last_of("/\\") + 1);
+
+    for (const char* p = file.data(); p < end; )
+    {
+        const char* eol = (const char*) memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        p = skipBlanks(p, eol);
+
+        if (eol - p >= 7 && memcmp(p, "newmtl", 6) == 0 && isBlank(p[6]))
+        {
+            ObjMaterial m;
+            m.name       = restOfLine(p + 7, eol);
+            m.diffuse[0] = m.diffuse[1] = m.diffuse[2] = 1.0f;
+            _materials.push_back(m);
+        }
+        else if (!_materials.empty() && eol - p >= 3 && p[0] == 'K' && p[1] == 'd' && isBlank(p[2]))
+        {
+            const char* q = p + 3;
+            for (int i = 0; i < 3; i++)
+                q = parseFloat(skipBlanks(q, eol), eol, _materials.back().diffuse[i]);
+        }
+        else if (!_materials.empty() && eol - p >= 7 && memcmp(p, "map_Kd", 6) == 0 && isBlank(p[6]))
+        {
+            // options come first, "map_Kd -s 1 1 1 texture.png"; then the name
+            // is taken to be the last word
+            std::string name = restOfLine(p + 7, eol);
+            if (!name.empty() && name[0] == '-')
+                name = name.substr(name.find_last_of(" \t") + 1);
+            if (!name.empty() && name[0] != '/' && name[0] != '\\' && name.find(':') == std::string::npos)
+                name = directory + name;
+            _materials.back().diffuseMap = name;
+        }
+
+        p = eol + 1;
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ObjWriter
+////////////////////////////////////////////////////////////////////////////////
+
+ObjWriter::ObjWriter(const std::string& filename):
+    _filename(filename), _used(0)
+{
+#ifdef PIL_OS_FAMILY_UNIX
+    _fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#else
+    _fd = ::_open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#endif
+    if (_fd < 0) throw CreateFileException(filename);
+    _buffer.resize(WRITE_BUFFER);
+}
+
+
+ObjWriter::~ObjWriter()
+{
+    if (_fd < 0) return;
+    try
+    {
+        flush();
+    }
+    catch (...)
+    {
+    }
+#ifdef PIL_OS_FAMILY_UNIX
+    ::close(_fd);
+#else
+    ::_close(_fd);
+#endif
+}
+
+
+char* ObjWriter::reserve(size_t n)
+{
+    if (_used + n > _buffer.size())
+    {
+        flush();
+        if (n > _buffer.size()) _buffer.resize(n);
+    }
+    return &_buffer[_used];
+}
+
+
+void ObjWriter::flush()
+{
+    const char* p    = &_buffer[0];
+    size_t      left = _used;
+    while (left)
+    {
+#ifdef PIL_OS_FAMILY_UNIX
+        ssize_t n = ::write(_fd, p, left);
+        if (n < 0 && errno == EINTR) continue;
+#else
+        int n = ::_write(_fd, p, (unsigned int) std::min<size_t>(left, 1 << 30));
+#endif
+        if (n <= 0) throw WriteFileException(_filename);
+        p    += n;
+        left -= n;
+    }
+    _used = 0;
+}
+
+
+void ObjWriter::close()
+{
+    if (_fd < 0) return;
+    flush();
+    int fd = _fd;
+    _fd = -1;
+#ifdef PIL_OS_FAMILY_UNIX
+    if (::close(fd) != 0) throw WriteFileException(_filename);
+#else
+    if (::_close(fd) != 0) throw WriteFileException(_filename);
+#endif
+}
+
+
+void ObjWriter::comment(const std::string& text)
+{
+    line("#", text);
+}
+
+
+void ObjWriter::line(const std::string& keyword, const std::string& value)
+{
+    char* p = reserve(keyword.size() + value.size() + 2);
+    memcpy(p, keyword.data(), keyword.size());
+    p += keyword.size();
+    *p++ = ' ';
+    memcpy(p, value.data(), value.size());
+    p += value.size();
+    *p++ = '\n';
+    _used = p - &_buffer[0];
+}
+
+
+void ObjWriter::vertex(float x, float y, float z)
+{
+    float v[3] = { x, y, z };
+    values("v", v, 3);
+}
+
+
+void ObjWriter::vertex(float x, float y, float z, float r, float g, float b)
+{
+    float v[6] = { x, y, z, r, g, b };
+    values("v", v, 6);
+}
+
+
+void ObjWriter::normal(float x, float y, float z)
+{
+    float v[3] = { x, y, z };
+    values("vn", v, 3);
+}
+
+
+void ObjWriter::texcoord(float u, float v)
+{
+    float uv[2] = { u, v };
+    values("vt", uv, 2);
+}
+
+
+void ObjWriter::values(const std::string& keyword, const float* v, int n)
+{
+    // the inline buffer of a MemoryWriter holds a line of a few values
+    // without allocating
+    fmt::MemoryWriter text;
+    for (int i = 0; i < n; i++) text << ' ' << v[i];
+
+    char* p = reserve(keyword.size() + text.size() + 1);
+    memcpy(p, keyword.data(), keyword.size());
+    p += keyword.size();
+    const char* number = text.data();
+    for (size_t i = 0; i < text.size(); i++)
+        *p++ = number[i] == ',' ? '.' : number[i];     // a locale decimal point
+    *p++ = '\n';
+    _used = p - &_buffer[0];
+}
+
+
+void ObjWriter::face(const unsigned int* v, const unsigned int* vt, const unsigned int* vn, int n)
+{
+    char* p = reserve(2 + n * 36);
+    *p++ = 'f';
+    for (int i = 0; i < n; i++)
+    {
+        *p++ = ' ';
+        p = append(p, fmt::FormatInt((unsigned long long) v[i] + 1));
+        if (vt || vn)
+        {
+            *p++ = '/';
+            if (vt) p = append(p, fmt::FormatInt((unsigned long long) vt[i] + 1));
+        }
+        if (vn)
+        {
+            *p++ = '/';
+            p = append(p, fmt::FormatInt((unsigned long long) vn[i] + 1));
+        }
+    }
+    *p++ = '\n';
+    _used = p - &_buffer[0];
+}
+
+
+} // namespace pi
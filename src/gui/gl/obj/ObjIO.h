@@ -0,0 +1,138 @@
+#ifndef PIL_ObjIO_INCLUDED
+#define PIL_ObjIO_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+
+namespace pi {
+
+
+struct ObjMaterial
+    /// A material of an MTL file.
+{
+    std::string name;
+    float       diffuse[3];     ///< Kd
+    std::string diffuseMap;     ///< map_Kd, relative paths resolved against the MTL file
+};
+
+
+class ObjReader
+    /// Reads Wavefront OBJ files with their MTL materials.
+    ///
+    /// The file is memory mapped and cut into line aligned chunks which
+    /// are parsed on worker threads. Polygons become triangle fans, and
+    /// every distinct position/texcoord/normal triple of the faces
+    /// becomes one vertex, so all attributes share the indices:
+    ///
+    ///     ObjReader obj("model.obj");
+    ///     const std::vector<float>& xyz = obj.positions();   // x, y, z per vertex
+    ///     const std::vector<float>& uv  = obj.texcoords();   // u, v per vertex, or empty
+    ///     const std::vector<uint32_t>& tris = obj.indices();
+    ///
+    /// Files whose faces reference positions only keep the positions in
+    /// file order, unreferenced ones included. Line elements are ignored.
+{
+public:
+    struct MaterialRun
+        /// Triangles from first (an index into indices()) on use material.
+    {
+        size_t first;
+        int    material;    ///< index into materials(), -1 if unknown
+    };
+
+    ObjReader(const std::string& filename, int threads = -1);
+        /// Reads the file and the MTL files it names. threads is the
+        /// number of parsing threads, -1 for one per processor. Throws a
+        /// FileNotFoundException, ReadFileException or DataFormatException;
+        /// a missing MTL file only leaves the materials empty.
+
+    const std::vector<float>&       positions() const { return _positions; }
+    const std::vector<float>&       normals() const   { return _normals; }
+    const std::vector<float>&       texcoords() const { return _texcoords; }
+    const std::vector<float>&       colors() const    { return _colors; }
+        /// r, g, b in [0, 1] of the "v x y z r g b" extension, empty unless
+        /// every position has them.
+
+    const std::vector<uint32_t>&    indices() const   { return _indices; }
+    const std::vector<ObjMaterial>& materials() const { return _materials; }
+    const std::vector<MaterialRun>& materialRuns() const { return _runs; }
+
+    size_t vertexCount() const { return _positions.size() / 3; }
+
+private:
+    ObjReader(const ObjReader&);
+    ObjReader& operator = (const ObjReader&);
+
+    void readMaterials(const std::string& filename);
+
+    std::vector<float>          _positions;
+    std::vector<float>          _normals;
+    std::vector<float>          _texcoords;
+    std::vector<float>          _colors;
+    std::vector<uint32_t>       _indices;
+    std::vector<ObjMaterial>    _materials;
+    std::vector<MaterialRun>    _runs;
+};
+
+
+class ObjWriter
+    /// Writes OBJ and MTL text straight to a file descriptor through a
+    /// large buffer. Numbers are formatted with the bundled fmt instead of
+    /// iostreams; floats keep the six significant digits of "%g", with a
+    /// '.' for the decimal point in any locale.
+    ///
+    ///     ObjWriter obj("model.obj");
+    ///     obj.vertex(0, 0, 0);
+    ///     ...
+    ///     unsigned int v[3] = { 0, 1, 2 };
+    ///     obj.face(v, 0, 0, 3);
+    ///     obj.close();
+    ///
+    /// Indices passed in are 0 based, the file gets them 1 based.
+{
+public:
+    ObjWriter(const std::string& filename);
+        /// Creates the file. Throws a CreateFileException.
+
+    ~ObjWriter();
+        /// Closes the file if close() was not called, ignoring errors.
+
+    void comment(const std::string& text);
+    void line(const std::string& keyword, const std::string& value);
+        /// Writes "keyword value", e.g. mtllib, usemtl or newmtl.
+
+    void vertex(float x, float y, float z);
+    void vertex(float x, float y, float z, float r, float g, float b);
+    void normal(float x, float y, float z);
+    void texcoord(float u, float v);
+    void values(const std::string& keyword, const float* v, int n);
+        /// Writes "keyword v[0] ... v[n-1]", e.g. Kd 1 1 1.
+
+    void face(const unsigned int* v, const unsigned int* vt, const unsigned int* vn, int n);
+        /// Writes a face of n corners; vt and vn may be null.
+
+    void close();
+        /// Flushes and closes the file. Throws a WriteFileException.
+
+private:
+    ObjWriter(const ObjWriter&);
+    ObjWriter& operator = (const ObjWriter&);
+
+    char* reserve(size_t n);
+    void  flush();
+
+    std::string         _filename;
+    int                 _fd;
+    std::vector<char>   _buffer;
+    size_t              _used;
+};
+
+
+} // namespace pi
+
+
+#endif // PIL_ObjIO_INCLUDED
@@ -0,0 +1,1001 @@
+#include "PlyIO.h"
+
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "base/Environment.h"
+#include "base/Debug/Exception.h"
+#include "base/Thread/AtomicCounter.h"
+#include "base/Thread/Thread.h"
+#include "base/Utils/Environment.h"
+
+#ifdef PIL_OS_FAMILY_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+namespace pi {
+
+
+namespace {
+
+typedef PlyProperty::Type Type;
+
+enum
+{
+    PARALLEL_MINIMUM = 1 << 16,     // fewer records are decoded on the calling thread
+    CHUNK_RECORDS    = 1 << 16,     // records per chunk of a variable size element
+    WRITE_BUFFER     = 4 << 20
+};
+
+
+inline size_t typeSize(Type t)
+{
+    switch (t)
+    {
+        case Type::INT8:    case Type::UINT8:   return 1;
+        case Type::INT16:   case Type::UINT16:  return 2;
+        case Type::INT32:   case Type::UINT32:
+        case Type::FLOAT32:                     return 4;
+        case Type::FLOAT64:                     return 8;
+        default:                                return 0;
+    }
+}
+
+
+template <class T>
+inline T load(const uint8_t* p)
+{
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+
+/// Loads a value stored in the other byte order than the host's.
+template <class T>
+inline T loadSwapped(const uint8_t* p)
+{
+    uint8_t b[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); i++) b[i] = p[sizeof(T) - 1 - i];
+    return load<T>(b);
+}
+
+
+template <class T>
+inline T load(const uint8_t* p, bool swap)
+{
+    return swap ? loadSwapped<T>(p) : load<T>(p);
+}
+
+
+/// Reads a list count, which is a non negative integer.
+inline uint32_t loadCount(Type t, const uint8_t* p, bool swap)
+{
+    switch (t)
+    {
+        case Type::INT8:    return (uint32_t) std::max<int8_t>(load<int8_t>(p), 0);
+        case Type::UINT8:   return load<uint8_t>(p);
+        case Type::INT16:   return (uint32_t) std::max<int16_t>(load<int16_t>(p, swap), 0);
+        case Type::UINT16:  return load<uint16_t>(p, swap);
+        case Type::INT32:   return (uint32_t) std::max<int32_t>(load<int32_t>(p, swap), 0);
+        case Type::UINT32:  return load<uint32_t>(p, swap);
+        default:            throw DataFormatException("PLY list count is not an integer");
+    }
+}
+
+
+/// Converts n values from src to dst, src and dst advancing by their strides.
+typedef void (*ConvertFunc)(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t n);
+
+template <class S, class D, bool Swap>
+void convertN(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t n)
+{
+    for (size_t i = 0; i < n; i++, src += srcStride, dst += dstStride)
+    {
+        D v = (D) (Swap ? loadSwapped<S>(src) : load<S>(src));
+        memcpy(dst, &v, sizeof(D));
+    }
+}
+
+template <class S, bool Swap>
+ConvertFunc selectConvert(Type dst)
+{
+    switch (dst)
+    {
+        case Type::INT8:    return &convertN<S, int8_t, Swap>;
+        case Type::UINT8:   return &convertN<S, uint8_t, Swap>;
+        case Type::INT16:   return &convertN<S, int16_t, Swap>;
+        case Type::UINT16:  return &convertN<S, uint16_t, Swap>;
+        case Type::INT32:   return &convertN<S, int32_t, Swap>;
+        case Type::UINT32:  return &convertN<S, uint32_t, Swap>;
+        case Type::FLOAT32: return &convertN<S, float, Swap>;
+        case Type::FLOAT64: return &convertN<S, double, Swap>;
+        default:            return 0;
+    }
+}
+
+template <bool Swap>
+ConvertFunc selectConvert(Type src, Type dst)
+{
+    switch (src)
+    {
+        case Type::INT8:    return selectConvert<int8_t, Swap>(dst);
+        case Type::UINT8:   return selectConvert<uint8_t, Swap>(dst);
+        case Type::INT16:   return selectConvert<int16_t, Swap>(dst);
+        case Type::UINT16:  return selectConvert<uint16_t, Swap>(dst);
+        case Type::INT32:   return selectConvert<int32_t, Swap>(dst);
+        case Type::UINT32:  return selectConvert<uint32_t, Swap>(dst);
+        case Type::FLOAT32: return selectConvert<float, Swap>(dst);
+        case Type::FLOAT64: return selectConvert<double, Swap>(dst);
+        default:            return 0;
+    }
+}
+
+ConvertFunc selectConvert(Type src, Type dst, bool swap)
+{
+    return swap ? selectConvert<true>(src, dst) : selectConvert<false>(src, dst);
+}
+
+
+/// Calls func(first, last) for ranges of [0, n) on threads workers, the
+/// calling thread included.
+template <class F>
+void parallelRanges(size_t n, size_t grain, int threads, F func)
+{
+    size_t tasks = (n + grain - 1) / grain;
+    if (threads <= 1 || tasks <= 1)
+    {
+        if (n) func((size_t) 0, n);
+        return;
+    }
+
+    AtomicCounter next(0);
+    auto work = [&]() {
+        for (;;)
+        {
+            size_t task = (size_t) (next++);
+            if (task >= tasks) break;
+            func(task * grain, std::min(n, (task + 1) * grain));
+        }
+    };
+
+    int workers = (int) std::min((size_t) threads, tasks) - 1;
+    std::vector<Thread*> pool;
+    for (int i = 0; i < workers; i++)
+    {
+        pool.push_back(new Thread);
+        pool.back()->setName("PlyWorker");
+        pool.back()->startFunc(work);
+    }
+    work();
+    for (size_t i = 0; i < pool.size(); i++)
+    {
+        pool[i]->join();
+        delete pool[i];
+    }
+}
+
+} // namespace
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PlyReader
+////////////////////////////////////////////////////////////////////////////////
+
+PlyReader::PlyReader(const std::string& filename, int threads):
+    _data(0), _size(0), _bodyOffset(0), _binary(false), _swap(false), _mapped(false)
+{
+    _threads = threads < 0 ? std::max(1, (int) Environment::processorCount()) : std::max(1, threads);
+
+#ifdef PIL_OS_FAMILY_UNIX
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw FileNotFoundException(filename);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw ReadFileException(filename);
+    }
+    _size = (uint64_t) st.st_size;
+    if (_size)
+    {
+        void* p = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            ::close(fd);
+            throw ReadFileException(filename);
+        }
+        madvise(p, _size, MADV_SEQUENTIAL);
+        _data   = (const uint8_t*) p;
+        _mapped = true;
+    }
+    ::close(fd);
+#else
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp) throw FileNotFoundException(filename);
+    fseek(fp, 0, SEEK_END);
+    _buffer.resize((size_t) ftell(fp));
+    fseek(fp, 0, SEEK_SET);
+    if (!_buffer.empty() && fread(&_buffer[0], 1, _buffer.size(), fp) != _buffer.size())
+    {
+        fclose(fp);
+        throw ReadFileException(filename);
+    }
+    fclose(fp);
+    _size = _buffer.size();
+    _data = _buffer.empty() ? 0 : &_buffer[0];
+#endif
+
+    try
+    {
+        parseHeader();
+    }
+    catch (...)
+    {
+#ifdef PIL_OS_FAMILY_UNIX
+        if (_mapped) munmap((void*) _data, _size);
+#endif
+        throw;
+    }
+}
+
+
+PlyReader::~PlyReader()
+{
+#ifdef PIL_OS_FAMILY_UNIX
+    if (_mapped) munmap((void*) _data, _size);
+#endif
+}
+
+
+void PlyReader::parseHeader()
+{
+    static const char endHeader[] = "end_header";
+
+    // the header is text up to the line end_header
+    const char* begin = (const char*) _data;
+    const char* end   = begin + std::min<uint64_t>(_size, 1 << 20);
+    const char* p     = begin;
+    const char* bodyStart = 0;
+    while (p < end)
+    {
+        const char* eol = (const char*) memchr(p, '\n', end - p);
+        if (!eol) break;
+        if ((size_t) (eol - p) >= sizeof(endHeader) - 1 && memcmp(p, endHeader, sizeof(endHeader) - 1) == 0)
+        {
+            bodyStart = eol + 1;
+            break;
+        }
+        p = eol + 1;
+    }
+    if (_size < 3 || memcmp(begin, "ply", 3) != 0 || !bodyStart)
+        throw DataFormatException("not a PLY file");
+
+    std::string header(begin, bodyStart);
+    _bodyOffset = (uint64_t) (bodyStart - begin);
+
+#if defined(PIL_ARCH_BIG_ENDIAN)
+    const bool bigEndianHost = true;
+#else
+    const bool bigEndianHost = false;
+#endif
+    if (header.find("format binary_little_endian") != std::string::npos)
+    {
+        _binary = true;
+        _swap   = bigEndianHost;
+    }
+    else if (header.find("format binary_big_endian") != std::string::npos)
+    {
+        _binary = true;
+        _swap   = !bigEndianHost;
+
+        // PlyFile only parses the elements here, but refuses big endian
+        size_t format = header.find("binary_big_endian");
+        header.replace(format, sizeof("binary_big_endian") - 1, "binary_little_endian");
+    }
+
+    std::istringstream is(header);
+    try
+    {
+        PlyFile file(is);
+        _elements = file.get_elements();
+    }
+    catch (std::exception& e)
+    {
+        throw DataFormatException("PLY header", e.what());
+    }
+
+    for (size_t i = 0; i < _elements.size(); i++)
+    {
+        if (_elements[i].size < 0) throw DataFormatException("PLY element size", _elements[i].name);
+        for (size_t k = 0; k < _elements[i].properties.size(); k++)
+        {
+            const PlyProperty& prop = _elements[i].properties[k];
+            if (!typeSize(prop.propertyType) || (prop.isList && !typeSize(prop.listType)))
+                throw DataFormatException("PLY property type", prop.name);
+        }
+    }
+
+    _layouts.resize(_elements.size());
+    _laidOut.assign(_elements.size(), false);
+}
+
+
+int PlyReader::findElement(const std::string& element) const
+{
+    for (size_t i = 0; i < _elements.size(); i++)
+        if (_elements[i].name == element) return (int) i;
+    return -1;
+}
+
+
+size_t PlyReader::count(const std::string& element) const
+{
+    int e = findElement(element);
+    return e < 0 ? 0 : (size_t) _elements[e].size;
+}
+
+
+bool PlyReader::has(const std::string& element, const std::string& property) const
+{
+    int e = findElement(element);
+    if (e < 0) return false;
+    for (size_t k = 0; k < _elements[e].properties.size(); k++)
+        if (_elements[e].properties[k].name == property) return true;
+    return false;
+}
+
+
+const PlyReader::Layout& PlyReader::layout(int e)
+{
+    if (_laidOut[e]) return _layouts[e];
+    if (!_binary) throw DataFormatException("ASCII PLY files are read with PlyFile");
+
+    const PlyElement& element = _elements[e];
+    Layout&           l       = _layouts[e];
+    l.offset = e ? layout(e - 1).offset + layout(e - 1).size : _bodyOffset;
+    l.chunks.clear();
+
+    const std::vector<PlyProperty>& props = element.properties;
+    size_t n = (size_t) element.size;
+
+    // the size of the first record, which is the size of all records if
+    // there are no lists or all lists have the same length
+    size_t stride = 0;
+    bool   lists  = false;
+    std::vector<uint32_t> firstCounts;
+    for (size_t k = 0; k < props.size(); k++)
+    {
+        if (!props[k].isList)
+        {
+            stride += typeSize(props[k].propertyType);
+            continue;
+        }
+        lists = true;
+        if (!n) break;
+        if (l.offset + stride + typeSize(props[k].listType) > _size)
+            throw DataFormatException("PLY file is truncated");
+        uint32_t c = loadCount(props[k].listType, _data + l.offset + stride, _swap);
+        firstCounts.push_back(c);
+        stride += typeSize(props[k].listType) + (size_t) c * typeSize(props[k].propertyType);
+    }
+
+    bool uniform = true;
+    if (lists && n)
+    {
+        uniform = l.offset + (uint64_t) n * stride <= _size;
+
+        // check the counts of all records, assuming they are uniform
+        const uint8_t* base = _data + l.offset;
+        if (uniform)
+        {
+            AtomicCounter failed(0);
+            parallelRanges(n, std::max((size_t) PARALLEL_MINIMUM, n / (_threads * 4) + 1), _threads,
+                           [&](size_t first, size_t last) {
+                for (size_t r = first; r < last && !failed.value(); r++)
+                {
+                    const uint8_t* rec = base + r * stride;
+                    size_t off = 0, li = 0;
+                    for (size_t k = 0; k < props.size(); k++)
+                    {
+                        if (!props[k].isList)
+                        {
+                            off += typeSize(props[k].propertyType);
+                            continue;
+                        }
+                        if (loadCount(props[k].listType, rec + off, _swap) != firstCounts[li++])
+                        {
+                            failed++;
+                            return;
+                        }
+                        off += typeSize(props[k].listType) + firstCounts[li - 1] * typeSize(props[k].propertyType);
+                    }
+                }
+            });
+            uniform = failed.value() == 0;
+        }
+
+        if (!uniform)
+        {
+            // walk the records once, remembering where the chunks start
+            uint64_t off = l.offset;
+            for (size_t r = 0; r < n; r++)
+            {
+                if (r % CHUNK_RECORDS == 0)
+                {
+                    Chunk c = { off, r };
+                    l.chunks.push_back(c);
+                }
+                for (size_t k = 0; k < props.size(); k++)
+                {
+                    size_t ts = typeSize(props[k].propertyType);
+                    if (!props[k].isList)
+                    {
+                        off += ts;
+                        continue;
+                    }
+                    size_t cs = typeSize(props[k].listType);
+                    if (off + cs > _size) throw DataFormatException("PLY file is truncated");
+                    off += cs + (uint64_t) loadCount(props[k].listType, _data + off, _swap) * ts;
+                }
+            }
+            if (off > _size) throw DataFormatException("PLY file is truncated");
+            l.stride = 0;
+            l.size   = off - l.offset;
+        }
+    }
+
+    if (uniform)
+    {
+        l.stride = stride;
+        l.size   = (uint64_t) n * stride;
+        if (l.offset + l.size > _size) throw DataFormatException("PLY file is truncated");
+    }
+
+    _laidOut[e] = true;
+    return l;
+}
+
+
+size_t PlyReader::read(const std::string& elementName, const std::vector<std::string>& properties,
+                       void* dest, PlyProperty::Type destType, size_t destStride)
+{
+    int e = findElement(elementName);
+    if (e < 0 || properties.empty() || !typeSize(destType)) return 0;
+
+    const PlyElement& element = _elements[e];
+    const std::vector<PlyProperty>& props = element.properties;
+
+    // which property of the record goes to which place of the destination
+    std::vector<int> index(properties.size(), -1);
+    for (size_t i = 0; i < properties.size(); i++)
+    {
+        for (size_t k = 0; k < props.size(); k++)
+            if (props[k].name == properties[i] && !props[k].isList) index[i] = (int) k;
+        if (index[i] < 0) return 0;
+    }
+
+    const Layout& l = layout(e);
+    size_t   n     = (size_t) element.size;
+    uint8_t* out   = (uint8_t*) dest;
+    size_t   dsize = typeSize(destType);
+    if (!n) return 0;
+
+    std::vector<ConvertFunc> convert(properties.size());
+    for (size_t i = 0; i < properties.size(); i++)
+        convert[i] = selectConvert(props[index[i]].propertyType, destType, _swap);
+
+    if (l.stride)
+    {
+        // fixed size records: the property offsets are those of the first one
+        std::vector<size_t> offset(props.size());
+        size_t off = 0;
+        const uint8_t* first = _data + l.offset;
+        for (size_t k = 0; k < props.size(); k++)
+        {
+            offset[k] = off;
+            off += props[k].isList
+                 ? typeSize(props[k].listType) + loadCount(props[k].listType, first + off, _swap) * typeSize(props[k].propertyType)
+                 : typeSize(props[k].propertyType);
+        }
+
+        // the destination has the layout of the file, and its byte order
+        bool same = !_swap && destStride == l.stride && dsize * properties.size() == l.stride;
+        for (size_t i = 0; same && i < properties.size(); i++)
+            same = props[index[i]].propertyType == destType && offset[index[i]] == i * dsize;
+        if (same)
+        {
+            parallelRanges(l.size, 16 << 20, _threads, [&](size_t a, size_t b) {
+                memcpy(out + a, first + a, b - a);
+            });
+            return n;
+        }
+
+        parallelRanges(n, std::max((size_t) PARALLEL_MINIMUM, n / (_threads * 4) + 1), _threads,
+                       [&](size_t a, size_t b) {
+            for (size_t i = 0; i < properties.size(); i++)
+                convert[i](first + a * l.stride + offset[index[i]], l.stride,
+                           out + a * destStride + i * dsize, destStride, b - a);
+        });
+        return n;
+    }
+
+    // variable size records: walk every chunk
+    std::vector<int> wanted(props.size(), -1);
+    for (size_t i = 0; i < index.size(); i++) wanted[index[i]] = (int) i;
+
+    parallelRanges(l.chunks.size(), 1, _threads, [&](size_t a, size_t b) {
+        for (size_t c = a; c < b; c++)
+        {
+            const uint8_t* p    = _data + l.chunks[c].offset;
+            size_t         last = c + 1 < l.chunks.size() ? l.chunks[c + 1].first : n;
+            for (size_t r = l.chunks[c].first; r < last; r++)
+            {
+                for (size_t k = 0; k < props.size(); k++)
+                {
+                    size_t ts = typeSize(props[k].propertyType);
+                    if (props[k].isList)
+                    {
+                        p += typeSize(props[k].listType) + loadCount(props[k].listType, p, _swap) * ts;
+                        continue;
+                    }
+                    if (wanted[k] >= 0)
+                        convert[wanted[k]](p, ts, out + r * destStride + wanted[k] * dsize, dsize, 1);
+                    p += ts;
+                }
+            }
+        }
+    });
+    return n;
+}
+
+
+int PlyReader::readList(const std::string& elementName, const std::string& property,
+                        const ListTarget& target, std::vector<uint32_t>* counts)
+{
+    int e = findElement(elementName);
+    if (e < 0 || !typeSize(target.type)) return -1;
+
+    const PlyElement& element = _elements[e];
+    const std::vector<PlyProperty>& props = element.properties;
+    int list = -1;
+    for (size_t k = 0; k < props.size(); k++)
+        if (props[k].name == property && props[k].isList) list = (int) k;
+    if (list < 0) return -1;
+
+    const Layout& l  = layout(e);
+    size_t        n  = (size_t) element.size;
+    size_t        ts = typeSize(props[list].propertyType);
+    size_t        cs = typeSize(props[list].listType);
+    size_t        ds = typeSize(target.type);
+    ConvertFunc   convert = selectConvert(props[list].propertyType, target.type, _swap);
+
+    if (counts) counts->resize(n);
+    if (!n)
+    {
+        target.resize(target.vector, 0);
+        return 0;
+    }
+
+    if (l.stride)
+    {
+        // all lists have the length of the first one
+        const uint8_t* first = _data + l.offset;
+        size_t off = 0;
+        for (int k = 0; k < list; k++)
+            off += props[k].isList
+                 ? typeSize(props[k].listType) + loadCount(props[k].listType, first + off, _swap) * typeSize(props[k].propertyType)
+                 : typeSize(props[k].propertyType);
+        uint32_t size = loadCount(props[list].listType, first + off, _swap);
+
+        uint8_t* out = target.resize(target.vector, (size_t) size * n);
+        if (counts) std::fill(counts->begin(), counts->end(), size);
+        if (!out) return (int) size;
+
+        size_t rowBytes = size * ds;
+        parallelRanges(n, std::max((size_t) PARALLEL_MINIMUM, n / (_threads * 4) + 1), _threads,
+                       [&](size_t a, size_t b) {
+            // one strided pass per list position: gathers (i0, i1, i2) of
+            // all faces of the range
+            for (uint32_t j = 0; j < size; j++)
+                convert(first + a * l.stride + off + cs + j * ts, l.stride,
+                        out + a * rowBytes + j * ds, rowBytes, b - a);
+        });
+        return (int) size;
+    }
+
+    // variable lengths: count the values of every chunk, then decode the
+    // chunks into their place
+    size_t chunks = l.chunks.size();
+    std::vector<uint64_t> values(chunks + 1, 0);
+    std::vector<uint32_t> minSize(chunks, 0xFFFFFFFF), maxSize(chunks, 0);
+
+    auto walk = [&](size_t c, uint8_t* out) {
+        const uint8_t* p    = _data + l.chunks[c].offset;
+        size_t         last = c + 1 < chunks ? l.chunks[c + 1].first : n;
+        uint64_t       v    = out ? values[c] : 0;
+        for (size_t r = l.chunks[c].first; r < last; r++)
+        {
+            for (size_t k = 0; k < props.size(); k++)
+            {
+                size_t pts = typeSize(props[k].propertyType);
+                if (!props[k].isList)
+                {
+                    p += pts;
+                    continue;
+                }
+                uint32_t size = loadCount(props[k].listType, p, _swap);
+                p += typeSize(props[k].listType);
+                if ((int) k == list)
+                {
+                    if (out)
+                    {
+                        convert(p, ts, out + v * ds, ds, size);
+                        if (counts) (*counts)[r] = size;
+                    }
+                    else
+                    {
+                        minSize[c] = std::min(minSize[c], size);
+                        maxSize[c] = std::max(maxSize[c], size);
+                    }
+                    v += size;
+                }
+                p += (size_t) size * pts;
+            }
+        }
+        if (!out) values[c + 1] = v;
+    };
+
+    parallelRanges(chunks, 1, _threads, [&](size_t a, size_t b) {
+        for (size_t c = a; c < b; c++) walk(c, 0);
+    });
+
+    uint32_t lo = 0xFFFFFFFF, hi = 0;
+    for (size_t c = 0; c < chunks; c++)
+    {
+        values[c + 1] += values[c];
+        lo = std::min(lo, minSize[c]);
+        hi = std::max(hi, maxSize[c]);
+    }
+
+    uint8_t* out = target.resize(target.vector, (size_t) values[chunks]);
+    if (out)
+    {
+        parallelRanges(chunks, 1, _threads, [&](size_t a, size_t b) {
+            for (size_t c = a; c < b; c++) walk(c, out);
+        });
+    }
+    else if (counts)
+    {
+        std::fill(counts->begin(), counts->end(), 0);
+    }
+    return lo == hi ? (int) lo : 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PlyWriter
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+/// Buffered output to a file descriptor.
+class PlySink
+{
+public:
+    PlySink(const std::string& filename): _filename(filename), _used(0)
+    {
+#ifdef PIL_OS_FAMILY_UNIX
+        _fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (_fd < 0) throw CreateFileException(filename);
+#else
+        _fp = fopen(filename.c_str(), "wb");
+        if (!_fp) throw CreateFileException(filename);
+#endif
+        _buffer.resize(WRITE_BUFFER);
+    }
+
+    ~PlySink()
+    {
+#ifdef PIL_OS_FAMILY_UNIX
+        if (_fd >= 0) ::close(_fd);
+#else
+        if (_fp) fclose(_fp);
+#endif
+    }
+
+    /// Room for at least bytes more bytes.
+    char* reserve(size_t bytes)
+    {
+        if (_used + bytes > _buffer.size())
+        {
+            flush();
+            if (bytes > _buffer.size()) _buffer.resize(bytes);
+        }
+        return &_buffer[_used];
+    }
+
+    void commit(size_t bytes)
+    {
+        _used += bytes;
+    }
+
+    void append(const void* data, size_t bytes)
+    {
+        memcpy(reserve(bytes), data, bytes);
+        _used += bytes;
+    }
+
+    void flush()
+    {
+        const char* p    = _buffer.empty() ? 0 : &_buffer[0];
+        size_t      left = _used;
+#ifdef PIL_OS_FAMILY_UNIX
+        while (left)
+        {
+            ssize_t n = ::write(_fd, p, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) throw WriteFileException(_filename);
+            p    += n;
+            left -= n;
+        }
+#else
+        if (left && fwrite(p, 1, left, _fp) != left) throw WriteFileException(_filename);
+#endif
+        _used = 0;
+    }
+
+    void close()
+    {
+        flush();
+#ifdef PIL_OS_FAMILY_UNIX
+        int fd = _fd;
+        _fd = -1;
+        if (::close(fd) != 0) throw WriteFileException(_filename);
+#else
+        FILE* fp = _fp;
+        _fp = 0;
+        if (fclose(fp) != 0) throw WriteFileException(_filename);
+#endif
+    }
+
+private:
+    std::string       _filename;
+#ifdef PIL_OS_FAMILY_UNIX
+    int               _fd;
+#else
+    FILE*             _fp;
+#endif
+    std::vector<char> _buffer;
+    size_t            _used;
+};
+
+
+/// Prints one value, returns the number of characters. PLY wants a '.'
+/// whatever the locale of the application is.
+int formatValue(char* out, Type t, const uint8_t* p, char point)
+{
+    if (t == Type::FLOAT32 || t == Type::FLOAT64)
+    {
+        int n = t == Type::FLOAT32 ? sprintf(out, "%.9g", (double) load<float>(p))
+                                   : sprintf(out, "%.17g", load<double>(p));
+        if (point != '.')
+        {
+            char* c = (char*) memchr(out, point, n);
+            if (c) *c = '.';
+        }
+        return n;
+    }
+
+    switch (t)
+    {
+        case Type::INT8:    return sprintf(out, "%d", (int) load<int8_t>(p));
+        case Type::UINT8:   return sprintf(out, "%u", (unsigned) load<uint8_t>(p));
+        case Type::INT16:   return sprintf(out, "%d", (int) load<int16_t>(p));
+        case Type::UINT16:  return sprintf(out, "%u", (unsigned) load<uint16_t>(p));
+        case Type::INT32:   return sprintf(out, "%d", load<int32_t>(p));
+        case Type::UINT32:  return sprintf(out, "%u", load<uint32_t>(p));
+        default:            return 0;
+    }
+}
+
+
+/// Stores count as a value of type t.
+size_t storeCount(uint8_t* out, Type t, uint32_t count)
+{
+    switch (t)
+    {
+        case Type::INT8:    { int8_t   v = (int8_t) count;   memcpy(out, &v, 1); return 1; }
+        case Type::UINT8:   { uint8_t  v = (uint8_t) count;  memcpy(out, &v, 1); return 1; }
+        case Type::INT16:   { int16_t  v = (int16_t) count;  memcpy(out, &v, 2); return 2; }
+        case Type::UINT16:  { uint16_t v = (uint16_t) count; memcpy(out, &v, 2); return 2; }
+        case Type::INT32:   { int32_t  v = (int32_t) count;  memcpy(out, &v, 4); return 4; }
+        case Type::UINT32:  { uint32_t v = count;            memcpy(out, &v, 4); return 4; }
+        default:            throw InvalidArgumentException("PLY list count type");
+    }
+}
+
+} // namespace
+
+
+PlyWriter::PlyWriter(const std::string& filename, bool binary):
+    _filename(filename), _binary(binary)
+{
+}
+
+
+PlyWriter::~PlyWriter()
+{
+}
+
+
+void PlyWriter::addComment(const std::string& comment)
+{
+    _comments.push_back(comment);
+}
+
+
+void PlyWriter::addElement(const std::string& name, size_t count)
+{
+    Element e;
+    e.name  = name;
+    e.count = count;
+    _elements.push_back(e);
+}
+
+
+void PlyWriter::addProperties(const std::vector<std::string>& names, PlyProperty::Type type,
+                              const void* data, size_t stride)
+{
+    if (_elements.empty()) throw IllegalStateException("PlyWriter::addProperties() before addElement()");
+    if (!typeSize(type)) throw InvalidArgumentException("PLY property type");
+
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        Column c;
+        c.name      = names[i];
+        c.type      = type;
+        c.countType = Type::INVALID;
+        c.data      = (const uint8_t*) data + i * typeSize(type);
+        c.stride    = stride;
+        c.listSize  = 0;
+        _elements.back().columns.push_back(c);
+    }
+}
+
+
+void PlyWriter::addList(const std::string& name, PlyProperty::Type countType, PlyProperty::Type type,
+                        const void* data, uint32_t listSize)
+{
+    if (_elements.empty()) throw IllegalStateException("PlyWriter::addList() before addElement()");
+    if (!typeSize(type) || !typeSize(countType) || countType == Type::FLOAT32 || countType == Type::FLOAT64)
+        throw InvalidArgumentException("PLY list type");
+
+    Column c;
+    c.name      = name;
+    c.type      = type;
+    c.countType = countType;
+    c.data      = (const uint8_t*) data;
+    c.stride    = listSize * typeSize(type);
+    c.listSize  = listSize;
+    _elements.back().columns.push_back(c);
+}
+
+
+void PlyWriter::write()
+{
+    std::ostringstream header;
+    header.imbue(std::locale::classic());
+#if defined(PIL_ARCH_BIG_ENDIAN)
+    const char* format = "format binary_big_endian 1.0\n";
+#else
+    const char* format = "format binary_little_endian 1.0\n";
+#endif
+    header << "ply\n"
+           << (_binary ? format : "format ascii 1.0\n");
+    for (size_t i = 0; i < _comments.size(); i++)
+        header << "comment " << _comments[i] << "\n";
+    for (size_t i = 0; i < _elements.size(); i++)
+    {
+        const Element& e = _elements[i];
+        header << "element " << e.name << " " << e.count << "\n";
+        for (size_t k = 0; k < e.columns.size(); k++)
+        {
+            const Column& c = e.columns[k];
+            if (c.countType != Type::INVALID)
+                header << "property list " << PropertyTable[c.countType].str << " ";
+            else
+                header << "property ";
+            header << PropertyTable[c.type].str << " " << c.name << "\n";
+        }
+    }
+    header << "end_header\n";
+
+    char point = *localeconv()->decimal_point;
+
+    PlySink sink(_filename);
+    std::string h = header.str();
+    sink.append(h.data(), h.size());
+
+    for (size_t i = 0; i < _elements.size(); i++)
+    {
+        const Element& e = _elements[i];
+
+        // the largest record, as binary or text
+        size_t recordBytes = 0;
+        for (size_t k = 0; k < e.columns.size(); k++)
+        {
+            const Column& c = e.columns[k];
+            recordBytes += c.countType == Type::INVALID ? typeSize(c.type)
+                                                        : typeSize(c.countType) + c.stride;
+        }
+        size_t values = 0;
+        for (size_t k = 0; k < e.columns.size(); k++)
+            values += e.columns[k].countType == Type::INVALID ? 1 : 1 + e.columns[k].listSize;
+        if (!_binary) recordBytes = values * 26 + 2;
+
+        for (size_t r = 0; r < e.count; r++)
+        {
+            char* out = sink.reserve(recordBytes);
+            char* p   = out;
+            for (size_t k = 0; k < e.columns.size(); k++)
+            {
+                const Column&  c   = e.columns[k];
+                const uint8_t* src = c.data + r * c.stride;
+                size_t         ts  = typeSize(c.type);
+
+                if (_binary)
+                {
+                    if (c.countType == Type::INVALID)
+                    {
+                        memcpy(p, src, ts);
+                        p += ts;
+                    }
+                    else
+                    {
+                        p += storeCount((uint8_t*) p, c.countType, c.listSize);
+                        memcpy(p, src, c.stride);
+                        p += c.stride;
+                    }
+                    continue;
+                }
+
+                if (c.countType == Type::INVALID)
+                {
+                    p += formatValue(p, c.type, src, point);
+                    *p++ = ' ';
+                }
+                else
+                {
+                    p += sprintf(p, "%u ", c.listSize);
+                    for (uint32_t j = 0; j < c.listSize; j++, src += ts)
+                    {
+                        p += formatValue(p, c.type, src, point);
+                        *p++ = ' ';
+                    }
+                }
+            }
+            if (!_binary)
+            {
+                if (p > out) p--;   // the last blank
+                *p++ = '\n';
+            }
+            sink.commit(p - out);
+        }
+    }
+
+    sink.close();
+}
+
+
+} // namespace pi
@@ -0,0 +1,211 @@
+#ifndef PIL_PlyIO_INCLUDED
+#define PIL_PlyIO_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "TinyPly.h"
+
+
+namespace pi {
+
+
+class PlyReader
+    /// Reads binary PLY files through a memory mapping.
+    ///
+    /// PlyFile reads every property of every record with its own
+    /// istream::read(); PlyReader instead decodes straight from the
+    /// mapped file. Elements without list properties have a fixed record
+    /// size, so a group of properties is gathered with one strided loop,
+    /// or copied with memcpy when the destination has the layout of the
+    /// file. Elements with list properties (faces) are cut into chunks
+    /// which are decoded on worker threads.
+    ///
+    ///     PlyReader ply("mesh.ply");
+    ///     std::vector<Vertex3f> v(ply.count("vertex"));
+    ///     ply.read("vertex", {"x", "y", "z"}, &v[0].x, PlyProperty::Type::FLOAT32, sizeof(Vertex3f));
+    ///     std::vector<uint32_t> faces;
+    ///     int perFace = ply.readList("face", "vertex_indices", faces);
+    ///
+    /// Files of the other byte order than the host are swapped value by
+    /// value while decoding, so they never take the memcpy path. ASCII
+    /// files are not handled; isBinary() tells, and PlyFile reads them.
+{
+public:
+    PlyReader(const std::string& filename, int threads = -1);
+        /// Maps the file and parses its header. threads is the number of
+        /// decoding threads, -1 for one per processor. Throws a
+        /// FileNotFoundException, ReadFileException or DataFormatException.
+
+    ~PlyReader();
+
+    bool isBinary() const { return _binary; }
+
+    const std::vector<PlyElement>& elements() const { return _elements; }
+
+    size_t count(const std::string& element) const;
+        /// Returns the number of records of element, 0 if there is none.
+
+    bool has(const std::string& element, const std::string& property) const;
+
+    size_t read(const std::string& element, const std::vector<std::string>& properties,
+                void* dest, PlyProperty::Type destType, size_t destStride);
+        /// Converts the properties of every record of element to destType
+        /// and stores them at dest + i * destStride, one after the other.
+        /// Returns the number of records, or 0 (writing nothing) if the
+        /// element or one of the properties does not exist or is a list.
+
+    template <class T>
+    size_t read(const std::string& element, const std::vector<std::string>& properties,
+                std::vector<T>& values)
+        /// Reads the properties into a flat vector, {x, y, z, x, y, z, ...}.
+    {
+        std::vector<T> probe;
+        values.resize(count(element) * properties.size());
+        if (values.empty()) return 0;
+        size_t n = read(element, properties, &values[0], property_type_for_type(probe),
+                        sizeof(T) * properties.size());
+        if (!n) values.clear();
+        return n;
+    }
+
+    template <class T>
+    int readList(const std::string& element, const std::string& property,
+                 std::vector<T>& values, std::vector<uint32_t>* counts = 0)
+        /// Reads a list property of all records into a flat vector. Returns
+        /// the list size when all lists have the same size (3 for a
+        /// triangle mesh), 0 if they differ, and -1 if there is no such
+        /// list. counts receives the size of every list if not null.
+    {
+        std::vector<T> probe;
+        ListTarget target = { &values, property_type_for_type(probe), &resizeVector<T> };
+        return readList(element, property, target, counts);
+    }
+
+private:
+    PlyReader(const PlyReader&);
+    PlyReader& operator = (const PlyReader&);
+
+    struct ListTarget
+    {
+        void*             vector;
+        PlyProperty::Type type;
+        uint8_t*          (*resize)(void* vector, size_t size);
+    };
+
+    template <class T>
+    static uint8_t* resizeVector(void* vector, size_t size)
+    {
+        std::vector<T>& v = *(std::vector<T>*) vector;
+        v.resize(size);
+        return v.empty() ? 0 : (uint8_t*) &v[0];
+    }
+
+    struct Chunk
+    {
+        uint64_t offset;    ///< of the first record in the file
+        size_t   first;     ///< index of the first record
+    };
+
+    struct Layout
+    {
+        uint64_t            offset;     ///< of the element in the file
+        uint64_t            size;       ///< bytes of all records
+        size_t              stride;     ///< record size, 0 if it varies
+        std::vector<Chunk>  chunks;     ///< record boundaries if it varies
+    };
+
+    int  readList(const std::string& element, const std::string& property,
+                  const ListTarget& target, std::vector<uint32_t>* counts);
+    int  findElement(const std::string& element) const;
+    const Layout& layout(int element);
+    void parseHeader();
+
+    const uint8_t*          _data;
+    uint64_t                _size;
+    uint64_t                _bodyOffset;
+    bool                    _binary;
+    bool                    _swap;      // the file is not in host byte order
+    bool                    _mapped;
+    int                     _threads;
+    std::vector<uint8_t>    _buffer;    // the file contents where there is no mmap
+    std::vector<PlyElement> _elements;
+    std::vector<Layout>     _layouts;
+    std::vector<bool>       _laidOut;
+};
+
+
+class PlyWriter
+    /// Writes PLY files directly to a file descriptor through a large
+    /// buffer, gathering the records from the caller's arrays. Binary
+    /// files are in the byte order of the host.
+    ///
+    ///     PlyWriter ply("mesh.ply");
+    ///     ply.addElement("vertex", v.size());
+    ///     ply.addProperties({"x", "y", "z"}, PlyProperty::Type::FLOAT32, &v[0].x, sizeof(Vertex3f));
+    ///     ply.addElement("face", faces.size() / 3);
+    ///     ply.addList("vertex_indices", PlyProperty::Type::UINT8, PlyProperty::Type::UINT32, &faces[0], 3);
+    ///     ply.write();
+    ///
+    /// The arrays must stay valid until write() returns.
+{
+public:
+    PlyWriter(const std::string& filename, bool binary = true);
+        /// Prepares writing filename; it is created by write().
+
+    ~PlyWriter();
+
+    void addComment(const std::string& comment);
+
+    void addElement(const std::string& name, size_t count);
+        /// Starts a new element, the following properties belong to it.
+
+    void addProperties(const std::vector<std::string>& names, PlyProperty::Type type,
+                       const void* data, size_t stride);
+        /// Adds properties of the current element, taken from data, with
+        /// stride bytes from one record to the next; the properties of a
+        /// record follow each other.
+
+    void addList(const std::string& name, PlyProperty::Type countType, PlyProperty::Type type,
+                 const void* data, uint32_t listSize);
+        /// Adds a list property of listSize values per record.
+
+    void write();
+        /// Writes the file. Throws a CreateFileException or a
+        /// WriteFileException.
+
+private:
+    PlyWriter(const PlyWriter&);
+    PlyWriter& operator = (const PlyWriter&);
+
+    struct Column
+    {
+        std::string       name;
+        PlyProperty::Type type;
+        PlyProperty::Type countType;    ///< INVALID unless a list
+        const uint8_t*    data;
+        size_t            stride;
+        uint32_t          listSize;
+    };
+
+    struct Element
+    {
+        std::string         name;
+        size_t              count;
+        std::vector<Column> columns;
+    };
+
+    std::string                 _filename;
+    bool                        _binary;
+    std::vector<std::string>    _comments;
+    std::vector<Element>        _elements;
+};
+
+
+} // namespace pi
+
+
+#endif // PIL_PlyIO_INCLUDED
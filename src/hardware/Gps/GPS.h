@@ -7,6 +7,7 @@
 
 #include <base/Types/Int.h>
 #include <base/Types/Point.h>
+#include <base/Types/Serialization.h>
 #include <base/Utils/utils_str.h>
 
 namespace pi {
@@ -70,6 +71,8 @@ struct GPSData
     static bool   preciseConvert;
 };
 
+PIL_SERIALIZABLE(GPSData, 1, lng, lat, alt, timestamp, HDOP, nSat, fixQuality)
+
 class GPS
 {
 public:
@@ -0,0 +1,91 @@
+#include "DatagramBatch.h"
+#include "base/Debug/Exception.h"
+#include <string.h>
+
+
+namespace pi {
+
+
+#if PIL_OS == PIL_OS_LINUX
+// room for an SCM_TIMESTAMPNS and an UDP_GRO control message per packet
+static const size_t CONTROL_SIZE = CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(int));
+#endif
+
+
+DatagramBatch::DatagramBatch(int capacity, int packetSize):
+    _packetSize(packetSize),
+    _count(0)
+{
+    if (capacity <= 0 || packetSize <= 0)
+        throw InvalidArgumentException("DatagramBatch capacity and packet size must be positive");
+
+    _buffer.resize((size_t) capacity * packetSize);
+    _packets.resize(capacity);
+    memset(&_packets[0], 0, _packets.size() * sizeof(Packet));
+
+#if PIL_OS == PIL_OS_LINUX
+    _control.resize(capacity * CONTROL_SIZE);
+    _iovecs.resize(capacity);
+    _headers.resize(capacity);
+    memset(&_headers[0], 0, _headers.size() * sizeof(struct mmsghdr));
+    for (int i = 0; i < capacity; ++i)
+    {
+        _iovecs[i].iov_base = data(i);
+        _iovecs[i].iov_len  = packetSize;
+        _headers[i].msg_hdr.msg_iov    = &_iovecs[i];
+        _headers[i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+}
+
+
+DatagramBatch::~DatagramBatch()
+{
+}
+
+
+int DatagramBatch::add(const void* buffer, int length)
+{
+    if (_count >= capacity())
+        throw RangeException("DatagramBatch is full");
+    if (length < 0 || length > _packetSize)
+        throw InvalidArgumentException("Datagram exceeds the packet size of the batch");
+
+    Packet& packet = _packets[_count];
+    packet.length        = length;
+    packet.addressLength = 0;
+    packet.segmentSize   = 0;
+    packet.truncated     = false;
+    packet.timestamp     = 0;
+    memcpy(data(_count), buffer, length);
+    return _count++;
+}
+
+
+int DatagramBatch::add(const void* buffer, int length, const SocketAddress& address)
+{
+    int index = add(buffer, length);
+    Packet& packet = _packets[index];
+    memcpy(&packet.address, address.addr(), address.length());
+    packet.addressLength = address.length();
+    return index;
+}
+
+
+SocketAddress DatagramBatch::address(int index) const
+{
+    check(index);
+    const Packet& packet = _packets[index];
+    if (packet.addressLength == 0) return SocketAddress();
+    return SocketAddress(reinterpret_cast<const struct sockaddr*>(&packet.address), packet.addressLength);
+}
+
+
+void DatagramBatch::check(int index) const
+{
+    if (index < 0 || index >= _count)
+        throw RangeException("Invalid DatagramBatch packet index");
+}
+
+
+} // namespace pi
@@ -0,0 +1,197 @@
+#ifndef Net_DatagramBatch_INCLUDED
+#define Net_DatagramBatch_INCLUDED
+
+
+#include "Net.h"
+#include "SocketDefs.h"
+#include "SocketAddress.h"
+#include <vector>
+
+
+namespace pi {
+
+
+class PIL_API DatagramBatch
+    /// A preallocated pool of datagram buffers for batched
+    /// UDP I/O with DatagramSocket::sendBatch() and
+    /// DatagramSocket::receiveBatch().
+    ///
+    /// All packet buffers, sender addresses and the kernel
+    /// message headers are allocated once in the constructor,
+    /// so a batch can be reused for any number of calls without
+    /// further allocations. Sender addresses are kept in their
+    /// native form and only converted into a SocketAddress
+    /// when address() is called.
+    ///
+    /// On Linux, a whole batch is transferred with a single
+    /// recvmmsg()/sendmmsg() call. On other platforms, the
+    /// batch calls fall back to one syscall per datagram.
+{
+public:
+    DatagramBatch(int capacity = 64, int packetSize = 2048);
+        /// Creates a batch of capacity packets, each able to hold
+        /// up to packetSize bytes.
+        ///
+        /// When receiving with generic receive offload enabled,
+        /// the kernel may coalesce several datagrams into one
+        /// packet, so packetSize should be 65535 then.
+
+    ~DatagramBatch();
+        /// Destroys the DatagramBatch.
+
+    int capacity() const;
+        /// Returns the maximum number of packets in the batch.
+
+    int packetSize() const;
+        /// Returns the size of each packet buffer.
+
+    int count() const;
+        /// Returns the number of valid packets, i.e. the packets
+        /// added with add() or filled by the last receiveBatch().
+
+    void clear();
+        /// Discards all packets.
+
+    int add(const void* data, int length);
+        /// Appends a packet for a connected socket and returns
+        /// its index.
+        ///
+        /// Throws a RangeException if the batch is full, or
+        /// an InvalidArgumentException if length exceeds
+        /// packetSize().
+
+    int add(const void* data, int length, const SocketAddress& address);
+        /// Appends a packet to be sent to the given address
+        /// and returns its index.
+
+    char* data(int index);
+        /// Returns the buffer of the packet with the given index.
+
+    const char* data(int index) const;
+        /// Returns the buffer of the packet with the given index.
+
+    int length(int index) const;
+        /// Returns the number of valid bytes of the packet.
+
+    bool truncated(int index) const;
+        /// Returns true iff the received datagram was larger
+        /// than packetSize() and has been truncated.
+
+    SocketAddress address(int index) const;
+        /// Returns the sender address of a received packet, or
+        /// the destination address of a packet to be sent.
+        ///
+        /// Returns a wildcard address if there is none.
+
+    pi::Int64 timestamp(int index) const;
+        /// Returns the kernel receive time of the packet in
+        /// nanoseconds since the epoch, or zero if receive
+        /// timestamps are not enabled on the socket.
+        ///
+        /// See DatagramSocket::setReceiveTimestamps().
+
+    int segmentSize(int index) const;
+        /// Returns the size of the individual datagrams if the
+        /// kernel coalesced several datagrams of the same size
+        /// into this packet with generic receive offload.
+        /// The last segment may be shorter.
+        ///
+        /// Returns zero if the packet holds a single datagram.
+
+private:
+    DatagramBatch(const DatagramBatch&);
+    DatagramBatch& operator = (const DatagramBatch&);
+
+    struct Packet
+    {
+        int                     length;
+        pil_socklen_t           addressLength;
+        int                     segmentSize;
+        bool                    truncated;
+        pi::Int64               timestamp;
+        struct sockaddr_storage address;
+    };
+
+    void check(int index) const;
+
+    int                 _packetSize;
+    int                 _count;
+    std::vector<char>   _buffer;
+    std::vector<Packet> _packets;
+#if PIL_OS == PIL_OS_LINUX
+    std::vector<char>           _control;
+    std::vector<struct iovec>   _iovecs;
+    std::vector<struct mmsghdr> _headers;
+#endif
+
+    friend class SocketImpl;
+};
+
+
+//
+// inlines
+//
+inline int DatagramBatch::capacity() const
+{
+    return (int) _packets.size();
+}
+
+
+inline int DatagramBatch::packetSize() const
+{
+    return _packetSize;
+}
+
+
+inline int DatagramBatch::count() const
+{
+    return _count;
+}
+
+
+inline void DatagramBatch::clear()
+{
+    _count = 0;
+}
+
+
+inline char* DatagramBatch::data(int index)
+{
+    return &_buffer[(size_t) index * _packetSize];
+}
+
+
+inline const char* DatagramBatch::data(int index) const
+{
+    return &_buffer[(size_t) index * _packetSize];
+}
+
+
+inline int DatagramBatch::length(int index) const
+{
+    return _packets[index].length;
+}
+
+
+inline bool DatagramBatch::truncated(int index) const
+{
+    return _packets[index].truncated;
+}
+
+
+inline pi::Int64 DatagramBatch::timestamp(int index) const
+{
+    return _packets[index].timestamp;
+}
+
+
+inline int DatagramBatch::segmentSize(int index) const
+{
+    return _packets[index].segmentSize;
+}
+
+
+} // namespace pi
+
+
+#endif // Net_DatagramBatch_INCLUDED
@@ -1,6 +1,15 @@
 #include "DatagramSocket.h"
 #include "DatagramSocketImpl.h"
 #include "base/Debug/Exception.h"
+#if PIL_OS == PIL_OS_LINUX
+#include <netinet/udp.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
 
 namespace pi {
 
@@ -85,4 +94,46 @@ int DatagramSocket::receiveFrom(void* buffer, int length, SocketAddress& address
 }
 
 
+int DatagramSocket::sendBatch(const DatagramBatch& batch, int flags)
+{
+    return impl()->sendBatch(batch, flags);
+}
+
+
+int DatagramSocket::receiveBatch(DatagramBatch& batch, int flags)
+{
+    return impl()->receiveBatch(batch, flags);
+}
+
+
+void DatagramSocket::setReceiveTimestamps(bool flag)
+{
+#if PIL_OS == PIL_OS_LINUX
+    impl()->setOption(SOL_SOCKET, SO_TIMESTAMPNS, flag ? 1 : 0);
+#else
+    throw NotImplementedException("setReceiveTimestamps() is only supported on Linux");
+#endif
+}
+
+
+void DatagramSocket::setSegmentSize(int size)
+{
+#if PIL_OS == PIL_OS_LINUX
+    impl()->setOption(SOL_UDP, UDP_SEGMENT, size);
+#else
+    throw NotImplementedException("setSegmentSize() is only supported on Linux");
+#endif
+}
+
+
+void DatagramSocket::setGenericReceiveOffload(bool flag)
+{
+#if PIL_OS == PIL_OS_LINUX
+    impl()->setOption(SOL_UDP, UDP_GRO, flag ? 1 : 0);
+#else
+    throw NotImplementedException("setGenericReceiveOffload() is only supported on Linux");
+#endif
+}
+
+
 } // namespace pi
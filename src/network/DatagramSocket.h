@@ -4,6 +4,7 @@
 
 #include "Net.h"
 #include "Socket.h"
+#include "DatagramBatch.h"
 
 
 namespace pi {
@@ -90,6 +91,62 @@ public:
         ///
         /// Returns the number of bytes received.
 
+    int sendBatch(const DatagramBatch& batch, int flags = 0);
+        /// Sends all packets of the batch, each as a separate
+        /// datagram. Packets without an address go to the
+        /// connected peer.
+        ///
+        /// On Linux, the whole batch is sent with sendmmsg(), and
+        /// if setSegmentSize() is enabled, the kernel splits every
+        /// packet into datagrams of that size.
+        ///
+        /// Returns the number of packets sent, which may be
+        /// less than batch.count() if the socket is non-blocking.
+
+    int receiveBatch(DatagramBatch& batch, int flags = 0);
+        /// Receives up to batch.capacity() datagrams into the batch.
+        /// Only waits for the first datagram, the ones already
+        /// queued after it are returned in the same call.
+        ///
+        /// On Linux, the batch is filled with one recvmmsg() call,
+        /// together with the receive timestamps and coalesced
+        /// segment sizes if these are enabled.
+        ///
+        /// Returns the number of packets received, or -1 if the
+        /// socket is non-blocking and no datagram is available.
+
+    void setReceiveTimestamps(bool flag);
+        /// Sets the value of the SO_TIMESTAMPNS socket option.
+        ///
+        /// If enabled, receiveBatch() reports the time the kernel
+        /// received each datagram in DatagramBatch::timestamp(),
+        /// which is independent of the scheduling latency of
+        /// the receiving thread.
+        ///
+        /// Throws a NotImplementedException on platforms
+        /// other than Linux.
+
+    void setSegmentSize(int size);
+        /// Enables UDP generic segmentation offload (UDP_SEGMENT)
+        /// for packets sent with sendBatch(). Each packet may then
+        /// hold up to 64 segments of the given size, which are
+        /// split into individual datagrams by the kernel or the
+        /// network card. A size of zero disables it.
+        ///
+        /// Throws a NotImplementedException on platforms
+        /// other than Linux.
+
+    void setGenericReceiveOffload(bool flag);
+        /// Enables UDP generic receive offload (UDP_GRO).
+        ///
+        /// The kernel may then coalesce consecutive datagrams of
+        /// the same size from one sender into a single packet,
+        /// see DatagramBatch::segmentSize(). The batch should use
+        /// a packet size of 65535 in this case.
+        ///
+        /// Throws a NotImplementedException on platforms
+        /// other than Linux.
+
     void setBroadcast(bool flag);
         /// Sets the value of the SO_BROADCAST socket option.
         ///
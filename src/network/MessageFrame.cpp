@@ -0,0 +1,126 @@
+#include "MessageFrame.h"
+#include "base/Debug/Exception.h"
+#include <string.h>
+
+
+namespace pi {
+
+
+Message::Message():
+    timestamp(0)
+{
+}
+
+
+void Message::toStream(RDataStream& stream) const
+{
+    stream.fromRawData((uint8_t*) payload.data(), (uint32_t) payload.size());
+}
+
+
+int MessageFrame::frameSize(const std::string& topic, int length)
+{
+    // header, topic length, topic, NUL, timestamp, payload
+    return HEADER_SIZE + 4 + (int) topic.size() + 1 + 8 + length;
+}
+
+
+void MessageFrame::encode(std::string& out, const std::string& topic, const void* data, int length, pi::Int64 timestamp)
+{
+    uint32_t size = (uint32_t) frameSize(topic, length);
+    if (size > MAX_FRAME_SIZE)
+        throw DataFormatException("Message exceeds the maximum frame size");
+
+    std::size_t pos = out.size();
+    out.resize(pos + size);
+    char* p = &out[pos];
+
+    datastream_set_header((uint8_t*) p, FRAME_MAGIC, FRAME_VERSION, size);
+    p += HEADER_SIZE;
+
+    uint32_t topicLength = (uint32_t) topic.size();
+    memcpy(p, &topicLength, 4);
+    p += 4;
+    memcpy(p, topic.data(), topicLength);
+    p += topicLength;
+    *p++ = 0;
+    memcpy(p, &timestamp, 8);
+    p += 8;
+    if (length > 0) memcpy(p, data, length);
+}
+
+
+int MessageFrame::peekSize(const char* data, int length)
+{
+    if (length < HEADER_SIZE) return 0;
+
+    uint32_t magic, version;
+    datastream_get_header((uint8_t*) data, magic, version);
+    uint32_t size = datastream_get_length((uint8_t*) data);
+    if (magic != FRAME_MAGIC || version != FRAME_VERSION)
+        throw DataFormatException("Invalid message frame header");
+    if (size < (uint32_t) frameSize(std::string(), 0) || size > MAX_FRAME_SIZE)
+        throw DataFormatException("Invalid message frame size");
+    return (int) size;
+}
+
+
+void MessageFrame::decode(const char* frame, int length, Message& message)
+{
+    if (peekSize(frame, length) != length)
+        throw DataFormatException("Incomplete message frame");
+
+    const char* p   = frame + HEADER_SIZE;
+    const char* end = frame + length;
+    uint32_t topicLength;
+    memcpy(&topicLength, p, 4);
+    p += 4;
+    if (topicLength > (uint32_t) (end - p) - 9)
+        throw DataFormatException("Invalid message frame topic");
+    message.topic.assign(p, topicLength);
+    p += topicLength + 1;
+    memcpy(&message.timestamp, p, 8);
+    p += 8;
+    message.payload.assign(p, end - p);
+}
+
+
+MessageFrameReader::MessageFrameReader():
+    _offset(0)
+{
+}
+
+
+void MessageFrameReader::feed(const char* data, int length)
+{
+    // drop the already consumed frames before the buffer grows
+    if (_offset > 0 && _offset >= _buffer.size() / 2)
+    {
+        _buffer.erase(0, _offset);
+        _offset = 0;
+    }
+    _buffer.append(data, length);
+}
+
+
+bool MessageFrameReader::next(const char*& frame, int& length)
+{
+    int available = buffered();
+    int size = MessageFrame::peekSize(_buffer.data() + _offset, available);
+    if (size == 0 || size > available) return false;
+
+    frame  = _buffer.data() + _offset;
+    length = size;
+    _offset += size;
+    return true;
+}
+
+
+void MessageFrameReader::reset()
+{
+    _buffer.clear();
+    _offset = 0;
+}
+
+
+} // namespace pi
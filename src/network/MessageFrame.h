@@ -0,0 +1,121 @@
+#ifndef Net_MessageFrame_INCLUDED
+#define Net_MessageFrame_INCLUDED
+
+
+#include "Net.h"
+#include "base/Types/Int.h"
+#include "base/Types/DataStream.h"
+#include <string>
+
+
+namespace pi {
+
+
+class PIL_API Message
+    /// A message received from a MessageTransport.
+{
+public:
+    Message();
+        /// Creates an empty Message.
+
+    std::string topic;
+        /// The topic the message was published on.
+
+    pi::Int64 timestamp;
+        /// The time the message was published, in microseconds
+        /// since the epoch.
+
+    std::string payload;
+        /// The message contents.
+
+    void toStream(RDataStream& stream) const;
+        /// Copies the payload into the given RDataStream, for
+        /// payloads that were published as RDataStream.
+};
+
+
+class PIL_API MessageFrame
+    /// Encodes and decodes the length-prefixed frames used by the
+    /// message transports.
+    ///
+    /// A frame starts with the same 8 byte header as an RDataStream:
+    /// magic number and version in the first word, the total frame
+    /// size including the header in the second. It is followed by
+    /// the topic in RDataStream string encoding, the publish
+    /// timestamp as int64 and the payload. A frame can therefore
+    /// also be read with RDataStream, and datastream_get_length()
+    /// gives its size.
+{
+public:
+    enum
+    {
+        FRAME_MAGIC      = 0x5046, ///< "PF"
+        FRAME_VERSION    = 1,
+        HEADER_SIZE      = 8,
+        MAX_FRAME_SIZE   = 64*1024*1024
+    };
+
+    static void encode(std::string& out, const std::string& topic, const void* data, int length, pi::Int64 timestamp);
+        /// Appends a frame for the given topic and payload to out.
+
+    static int frameSize(const std::string& topic, int length);
+        /// Returns the size of the frame encode() would create.
+
+    static void decode(const char* frame, int length, Message& message);
+        /// Decodes a complete frame, as returned by
+        /// MessageFrameReader::next(), into message.
+        ///
+        /// Throws a DataFormatException if the frame is malformed.
+
+    static int peekSize(const char* data, int length);
+        /// Returns the size of the frame starting at data, or zero
+        /// if less than HEADER_SIZE bytes are available.
+        ///
+        /// Throws a DataFormatException if the header is invalid.
+};
+
+
+class PIL_API MessageFrameReader
+    /// Splits a byte stream, as received from a StreamSocket,
+    /// into complete frames.
+{
+public:
+    MessageFrameReader();
+        /// Creates an empty MessageFrameReader.
+
+    void feed(const char* data, int length);
+        /// Appends received bytes.
+
+    bool next(const char*& frame, int& length);
+        /// Returns the next complete frame, if any. The returned
+        /// pointer stays valid until the next call to feed().
+        ///
+        /// Throws a DataFormatException if the stream does not
+        /// contain valid frames. The stream is out of sync then
+        /// and should be closed.
+
+    int buffered() const;
+        /// Returns the number of bytes not yet returned as frames.
+
+    void reset();
+        /// Discards all buffered bytes.
+
+private:
+    std::string _buffer;
+    std::size_t _offset;
+};
+
+
+//
+// inlines
+//
+inline int MessageFrameReader::buffered() const
+{
+    return (int) (_buffer.size() - _offset);
+}
+
+
+} // namespace pi
+
+
+#endif // Net_MessageFrame_INCLUDED
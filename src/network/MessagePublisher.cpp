@@ -0,0 +1,152 @@
+#include "MessagePublisher.h"
+#include "MessageFrame.h"
+#include "base/Debug/ErrorHandler.h"
+
+
+namespace pi {
+
+
+MessagePublisher::MessagePublisher(MessageTransport& transport, const pi::Timespan& latencyBudget, int batchSize):
+    _transport(transport),
+    _latencyBudget(latencyBudget),
+    _batchSize(batchSize),
+    _stopped(false),
+    _thread("MessagePublisher")
+{
+    _pending.reserve(batchSize);
+    if (_latencyBudget.totalMicroseconds() > 0)
+        _thread.start(*this);
+}
+
+
+MessagePublisher::~MessagePublisher()
+{
+    try
+    {
+        if (_thread.isRunning())
+        {
+            {
+                FastMutex::ScopedLock lock(_mutex);
+                _stopped = true;
+            }
+            _wakeUp.set();
+            _thread.join();
+        }
+        flush();
+    }
+    catch (pi::Exception& exc)
+    {
+        ErrorHandler::handle(exc);
+    }
+    catch (...)
+    {
+        pi_dbg_error("Failed");
+    }
+}
+
+
+void MessagePublisher::publish(const std::string& topic, const void* data, int length)
+{
+    bool sendNow;
+    {
+        FastMutex::ScopedLock lock(_mutex);
+
+        bool wasEmpty = _pending.empty();
+        MessageFrame::encode(_pending, topic, data, length, pi::Timestamp().epochMicroseconds());
+        _statistics[topic].count(length);
+        if (wasEmpty)
+        {
+            _oldest.update();
+            if (_latencyBudget.totalMicroseconds() > 0) _wakeUp.set();
+        }
+        sendNow = _latencyBudget.totalMicroseconds() <= 0 || (int) _pending.size() >= _batchSize;
+    }
+    if (sendNow) flush();
+}
+
+
+void MessagePublisher::publish(const std::string& topic, RDataStream& stream)
+{
+    publish(topic, stream.data(), (int) stream.size());
+}
+
+
+void MessagePublisher::flush()
+{
+    // Swapping and sending under _sendMutex keeps the batches in order.
+    FastMutex::ScopedLock sendLock(_sendMutex);
+    {
+        FastMutex::ScopedLock lock(_mutex);
+
+        if (_pending.empty()) return;
+        _sending.clear();
+        _sending.swap(_pending);
+    }
+    _transport.send(_sending.data(), (int) _sending.size());
+}
+
+
+TopicStatistics MessagePublisher::statistics(const std::string& topic) const
+{
+    FastMutex::ScopedLock lock(_mutex);
+
+    StatisticsMap::const_iterator it = _statistics.find(topic);
+    return it != _statistics.end() ? it->second : TopicStatistics();
+}
+
+
+std::vector<std::string> MessagePublisher::topics() const
+{
+    FastMutex::ScopedLock lock(_mutex);
+
+    std::vector<std::string> result;
+    for (StatisticsMap::const_iterator it = _statistics.begin(); it != _statistics.end(); ++it)
+        result.push_back(it->first);
+    return result;
+}
+
+
+int MessagePublisher::pendingBytes() const
+{
+    FastMutex::ScopedLock lock(_mutex);
+
+    return (int) _pending.size();
+}
+
+
+void MessagePublisher::run()
+{
+    for (;;)
+    {
+        long waitTime = -1;
+        {
+            FastMutex::ScopedLock lock(_mutex);
+
+            if (_stopped) break;
+            if (!_pending.empty())
+            {
+                pi::Timestamp::TimeDiff remaining = _latencyBudget.totalMicroseconds() - _oldest.elapsed();
+                waitTime = remaining > 0 ? (long) ((remaining + 999) / 1000) : 0;
+            }
+        }
+
+        if (waitTime == 0)
+        {
+            try
+            {
+                flush();
+            }
+            catch (pi::Exception& exc)
+            {
+                ErrorHandler::handle(exc);
+            }
+        }
+        else if (waitTime < 0)
+            _wakeUp.wait();
+        else
+            _wakeUp.tryWait(waitTime);
+    }
+}
+
+
+} // namespace pi
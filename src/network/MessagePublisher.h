@@ -0,0 +1,88 @@
+#ifndef Net_MessagePublisher_INCLUDED
+#define Net_MessagePublisher_INCLUDED
+
+
+#include "Net.h"
+#include "MessageTransport.h"
+#include "TopicStatistics.h"
+#include "base/Types/DataStream.h"
+#include "base/Thread/Thread.h"
+#include "base/Thread/Runnable.h"
+#include "base/Thread/Event.h"
+#include "base/Thread/Mutex.h"
+#include "base/Time/Timespan.h"
+#include <map>
+
+
+namespace pi {
+
+
+class PIL_API MessagePublisher: private Runnable
+    /// Publishes messages on topics through a MessageTransport.
+    ///
+    /// Messages are encoded as frames (see MessageFrame) and
+    /// coalesced: instead of one send per message, the frames
+    /// published within the latency budget are sent together,
+    /// or as soon as batchSize bytes are pending. This gives the
+    /// throughput of Nagle's algorithm with a bounded delay and
+    /// lets the transports run with TCP_NODELAY. A latency budget
+    /// of zero sends every message immediately.
+    ///
+    /// Messages published from one thread are sent in order.
+    /// All methods are thread-safe.
+{
+public:
+    MessagePublisher(MessageTransport& transport, const pi::Timespan& latencyBudget = pi::Timespan(1000), int batchSize = 64*1024);
+        /// Creates the MessagePublisher. The transport must outlive it.
+        ///
+        /// The latency budget is enforced with millisecond resolution.
+
+    ~MessagePublisher();
+        /// Sends the pending messages and destroys the publisher.
+
+    void publish(const std::string& topic, const void* data, int length);
+        /// Publishes a message on the given topic.
+
+    void publish(const std::string& topic, RDataStream& stream);
+        /// Publishes the contents of the RDataStream, including its
+        /// header. Receivers get it back with Message::toStream().
+
+    void flush();
+        /// Sends all pending messages now.
+
+    TopicStatistics statistics(const std::string& topic) const;
+        /// Returns the counters of the given topic.
+
+    std::vector<std::string> topics() const;
+        /// Returns all topics published so far.
+
+    int pendingBytes() const;
+        /// Returns the number of bytes waiting to be sent.
+
+private:
+    MessagePublisher(const MessagePublisher&);
+    MessagePublisher& operator = (const MessagePublisher&);
+
+    void run();
+
+    typedef std::map<std::string, TopicStatistics> StatisticsMap;
+
+    MessageTransport&     _transport;
+    pi::Timespan          _latencyBudget;
+    int                   _batchSize;
+    std::string           _pending;
+    std::string           _sending;
+    pi::Timestamp         _oldest;
+    StatisticsMap         _statistics;
+    bool                  _stopped;
+    pi::Event             _wakeUp;
+    pi::Thread            _thread;
+    mutable pi::FastMutex _mutex;
+    pi::FastMutex         _sendMutex;
+};
+
+
+} // namespace pi
+
+
+#endif // Net_MessagePublisher_INCLUDED
@@ -0,0 +1,208 @@
+#include "MessageSubscriber.h"
+#include "base/Debug/ErrorHandler.h"
+#include <vector>
+
+
+namespace pi {
+
+
+MessageSubscriber::MessageSubscriber(MessageTransport& transport):
+    _transport(transport),
+    _stopped(false),
+    _thread("MessageSubscriber")
+{
+    _thread.start(*this);
+    _transport.setListener(this);
+}
+
+
+MessageSubscriber::~MessageSubscriber()
+{
+    try
+    {
+        {
+            FastMutex::ScopedLock lock(_mutex);
+            _stopped = true;
+        }
+        // wake up a transport thread blocked on a full queue
+        for (TopicMap::iterator it = _topics.begin(); it != _topics.end(); ++it)
+            it->second->spaceAvailable.set();
+        _transport.setListener(0);
+
+        _ready.set();
+        _thread.join();
+    }
+    catch (...)
+    {
+        pi_dbg_error("Failed");
+    }
+    for (TopicMap::iterator it = _topics.begin(); it != _topics.end(); ++it)
+        delete it->second;
+}
+
+
+void MessageSubscriber::subscribe(const std::string& topic, MessageHandler* pHandler, int queueCapacity, DropPolicy policy)
+{
+    pi_check_ptr (pHandler);
+
+    pi::Mutex::ScopedLock dispatchLock(_dispatchMutex);
+    FastMutex::ScopedLock lock(_mutex);
+
+    Topic*& pTopic = _topics[topic];
+    if (!pTopic) pTopic = new Topic;
+    pTopic->pHandler = pHandler;
+    pTopic->capacity = queueCapacity > 0 ? queueCapacity : 1;
+    pTopic->policy   = policy;
+}
+
+
+void MessageSubscriber::unsubscribe(const std::string& topic)
+{
+    pi::Mutex::ScopedLock dispatchLock(_dispatchMutex);
+    FastMutex::ScopedLock lock(_mutex);
+
+    // Topics are kept until destruction, as the transport
+    // thread may be waiting on their queue.
+    TopicMap::iterator it = _topics.find(topic);
+    if (it == _topics.end()) return;
+    Topic* pTopic = it->second;
+    pTopic->pHandler = 0;
+    pTopic->statistics.queued = 0;
+    pTopic->queue.clear();
+    pTopic->spaceAvailable.set();
+}
+
+
+TopicStatistics MessageSubscriber::statistics(const std::string& topic) const
+{
+    FastMutex::ScopedLock lock(_mutex);
+
+    TopicMap::const_iterator it = _topics.find(topic);
+    return it != _topics.end() ? it->second->statistics : TopicStatistics();
+}
+
+
+void MessageSubscriber::onFrame(const char* frame, int length)
+{
+    Message message;
+    try
+    {
+        MessageFrame::decode(frame, length, message);
+    }
+    catch (pi::Exception& exc)
+    {
+        ErrorHandler::handle(exc);
+        return;
+    }
+
+    FastMutex::ScopedLock lock(_mutex);
+
+    TopicMap::iterator it = _topics.find(message.topic);
+    if (it == _topics.end() || !it->second->pHandler) return;
+
+    Topic* pTopic = it->second;
+    pTopic->statistics.count((pi::Int64) message.payload.size());
+    while ((int) pTopic->queue.size() >= pTopic->capacity)
+    {
+        if (pTopic->policy == DROP_OLDEST)
+        {
+            pTopic->queue.pop_front();
+            ++pTopic->statistics.dropped;
+        }
+        else if (pTopic->policy == DROP_NEWEST)
+        {
+            ++pTopic->statistics.dropped;
+            return;
+        }
+        else
+        {
+            _mutex.unlock();
+            pTopic->spaceAvailable.tryWait(100);
+            _mutex.lock();
+            if (_stopped || !pTopic->pHandler) return;
+        }
+    }
+
+    pTopic->queue.push_back(Message());
+    Message& queued = pTopic->queue.back();
+    queued.topic.swap(message.topic);
+    queued.payload.swap(message.payload);
+    queued.timestamp = message.timestamp;
+    pTopic->statistics.queued = (pi::Int64) pTopic->queue.size();
+    _ready.set();
+}
+
+
+void MessageSubscriber::run()
+{
+    std::vector<Topic*>  topics;
+    std::vector<Message> messages;
+    for (;;)
+    {
+        _ready.wait();
+
+        // Take one message per topic and round, so all
+        // topics are served fairly.
+        for (;;)
+        {
+            topics.clear();
+            messages.clear();
+            {
+                FastMutex::ScopedLock lock(_mutex);
+
+                if (_stopped) return;
+                for (TopicMap::iterator it = _topics.begin(); it != _topics.end(); ++it)
+                {
+                    Topic* pTopic = it->second;
+                    if (pTopic->queue.empty()) continue;
+
+                    topics.push_back(pTopic);
+                    messages.push_back(Message());
+                    Message& front = pTopic->queue.front();
+                    messages.back().topic.swap(front.topic);
+                    messages.back().payload.swap(front.payload);
+                    messages.back().timestamp = front.timestamp;
+                    pTopic->queue.pop_front();
+                    pTopic->statistics.queued = (pi::Int64) pTopic->queue.size();
+                    pTopic->spaceAvailable.set();
+                }
+            }
+            if (topics.empty()) break;
+
+            std::vector<pi::Int64> latencies(topics.size(), -1);
+            {
+                pi::Mutex::ScopedLock dispatchLock(_dispatchMutex);
+
+                for (std::size_t i = 0; i < topics.size(); ++i)
+                {
+                    // the handler may have been unsubscribed meanwhile
+                    MessageHandler* pHandler = topics[i]->pHandler;
+                    if (!pHandler) continue;
+
+                    latencies[i] = pi::Timestamp().epochMicroseconds() - messages[i].timestamp;
+                    try
+                    {
+                        pHandler->onMessage(messages[i]);
+                    }
+                    catch (pi::Exception& exc)
+                    {
+                        ErrorHandler::handle(exc);
+                    }
+                    catch (std::exception& exc)
+                    {
+                        ErrorHandler::handle(exc);
+                    }
+                }
+            }
+
+            FastMutex::ScopedLock lock(_mutex);
+            for (std::size_t i = 0; i < topics.size(); ++i)
+            {
+                if (latencies[i] >= 0) topics[i]->statistics.countDelivery(latencies[i]);
+            }
+        }
+    }
+}
+
+
+} // namespace pi
@@ -0,0 +1,106 @@
+#ifndef Net_MessageSubscriber_INCLUDED
+#define Net_MessageSubscriber_INCLUDED
+
+
+#include "Net.h"
+#include "MessageTransport.h"
+#include "MessageFrame.h"
+#include "TopicStatistics.h"
+#include "base/Thread/Thread.h"
+#include "base/Thread/Runnable.h"
+#include "base/Thread/Event.h"
+#include "base/Thread/Mutex.h"
+#include <deque>
+#include <map>
+
+
+namespace pi {
+
+
+class PIL_API MessageHandler
+    /// Receives the messages of a subscribed topic.
+{
+public:
+    virtual ~MessageHandler() {}
+
+    virtual void onMessage(const Message& message) = 0;
+        /// Called from the dispatcher thread of the
+        /// MessageSubscriber for every message of the topic.
+};
+
+
+class PIL_API MessageSubscriber: private MessageTransportListener, private Runnable
+    /// Receives the messages of subscribed topics from a
+    /// MessageTransport and dispatches them to handlers.
+    ///
+    /// Each topic has its own bounded queue between the transport
+    /// thread and the dispatcher thread. When a queue is full, its
+    /// DropPolicy decides whether the oldest or the newest message
+    /// is discarded, or whether the transport waits. Queues are
+    /// served round-robin, so a busy topic cannot starve the others.
+    ///
+    /// Frames of topics without a subscription are discarded.
+{
+public:
+    enum DropPolicy
+    {
+        DROP_OLDEST, ///< discard the oldest queued message, e.g. for sensor data
+        DROP_NEWEST, ///< discard the arriving message
+        BLOCK        ///< make the transport wait for the dispatcher
+    };
+
+    MessageSubscriber(MessageTransport& transport);
+        /// Creates the MessageSubscriber, installs it as the
+        /// listener of the transport and starts the dispatcher
+        /// thread. The transport must outlive the subscriber.
+
+    ~MessageSubscriber();
+        /// Removes the listener and stops the dispatcher thread.
+        /// Queued messages are discarded.
+
+    void subscribe(const std::string& topic, MessageHandler* pHandler, int queueCapacity = 1024, DropPolicy policy = DROP_OLDEST);
+        /// Subscribes the handler to the given topic, replacing
+        /// a previous subscription of the topic.
+
+    void unsubscribe(const std::string& topic);
+        /// Removes the subscription of the topic and discards
+        /// its queued messages. After the call returns, the
+        /// handler is no longer called.
+
+    TopicStatistics statistics(const std::string& topic) const;
+        /// Returns the counters of the given topic.
+
+private:
+    MessageSubscriber(const MessageSubscriber&);
+    MessageSubscriber& operator = (const MessageSubscriber&);
+
+    struct Topic
+    {
+        Topic(): pHandler(0), capacity(0), policy(DROP_OLDEST) {}
+
+        MessageHandler*     pHandler;
+        int                 capacity;
+        DropPolicy          policy;
+        std::deque<Message> queue;
+        TopicStatistics     statistics;
+        pi::Event           spaceAvailable;
+    };
+    typedef std::map<std::string, Topic*> TopicMap;
+
+    void onFrame(const char* frame, int length);
+    void run();
+
+    MessageTransport&     _transport;
+    TopicMap              _topics;
+    bool                  _stopped;
+    pi::Event             _ready;
+    pi::Thread            _thread;
+    mutable pi::FastMutex _mutex;
+    pi::Mutex             _dispatchMutex;
+};
+
+
+} // namespace pi
+
+
+#endif // Net_MessageSubscriber_INCLUDED
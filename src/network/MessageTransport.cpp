@@ -0,0 +1,99 @@
+#include "MessageTransport.h"
+#include "MessageFrame.h"
+#include "base/Debug/Exception.h"
+#include <map>
+#include <algorithm>
+
+
+namespace pi {
+
+
+MessageTransport::MessageTransport():
+    _pListener(0)
+{
+}
+
+
+MessageTransport::~MessageTransport()
+{
+}
+
+
+void MessageTransport::setListener(MessageTransportListener* pListener)
+{
+    FastMutex::ScopedLock lock(_listenerMutex);
+
+    _pListener = pListener;
+}
+
+
+void MessageTransport::deliver(const char* frame, int length)
+{
+    FastMutex::ScopedLock lock(_listenerMutex);
+
+    if (_pListener) _pListener->onFrame(frame, length);
+}
+
+
+namespace
+{
+    typedef std::map<std::string, std::vector<InProcessTransport*> > ChannelMap;
+
+    // Delivery happens with the mutex held, so a transport
+    // cannot be destroyed while frames are passed to it.
+    pi::Mutex& channelMutex()
+    {
+        static pi::Mutex mutex;
+        return mutex;
+    }
+
+    ChannelMap& channels()
+    {
+        static ChannelMap map;
+        return map;
+    }
+}
+
+
+InProcessTransport::InProcessTransport(const std::string& channel):
+    _channel(channel)
+{
+    pi::Mutex::ScopedLock lock(channelMutex());
+
+    channels()[_channel].push_back(this);
+}
+
+
+InProcessTransport::~InProcessTransport()
+{
+    pi::Mutex::ScopedLock lock(channelMutex());
+
+    std::vector<InProcessTransport*>& members = channels()[_channel];
+    members.erase(std::remove(members.begin(), members.end(), this), members.end());
+    if (members.empty()) channels().erase(_channel);
+}
+
+
+void InProcessTransport::send(const char* frames, int length)
+{
+    pi::Mutex::ScopedLock lock(channelMutex());
+
+    std::vector<InProcessTransport*>& members = channels()[_channel];
+    int offset = 0;
+    while (offset < length)
+    {
+        int size = MessageFrame::peekSize(frames + offset, length - offset);
+        if (size == 0 || size > length - offset)
+            throw DataFormatException("Incomplete message frame");
+
+        for (std::size_t i = 0; i < members.size(); ++i)
+        {
+            if (members[i] != this)
+                members[i]->deliver(frames + offset, size);
+        }
+        offset += size;
+    }
+}
+
+
+} // namespace pi
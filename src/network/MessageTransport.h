@@ -0,0 +1,104 @@
+#ifndef Net_MessageTransport_INCLUDED
+#define Net_MessageTransport_INCLUDED
+
+
+#include "Net.h"
+#include "base/Thread/Mutex.h"
+#include <string>
+#include <vector>
+
+
+namespace pi {
+
+
+class PIL_API MessageTransportListener
+    /// Receives the frames arriving at a MessageTransport.
+{
+public:
+    virtual ~MessageTransportListener() {}
+
+    virtual void onFrame(const char* frame, int length) = 0;
+        /// Called for every complete frame received. The frame is
+        /// only valid during the call.
+        ///
+        /// Network transports call it from their I/O thread, so
+        /// implementations should return quickly.
+};
+
+
+class PIL_API MessageTransport
+    /// The abstract base class for the transports used by
+    /// MessagePublisher and MessageSubscriber.
+    ///
+    /// A transport moves complete frames, as created by
+    /// MessageFrame::encode(), to all its peers. It does not know
+    /// about topics; subscribers filter the frames they receive.
+{
+public:
+    MessageTransport();
+        /// Creates the MessageTransport.
+
+    virtual ~MessageTransport();
+        /// Destroys the MessageTransport.
+
+    virtual void send(const char* frames, int length) = 0;
+        /// Sends one or more complete frames to all peers.
+        ///
+        /// Must be thread-safe.
+
+    void setListener(MessageTransportListener* pListener);
+        /// Sets the listener for received frames, replacing the
+        /// previous one. Pass a null pointer to remove it.
+
+protected:
+    void deliver(const char* frame, int length);
+        /// Passes a received frame to the listener.
+
+private:
+    MessageTransport(const MessageTransport&);
+    MessageTransport& operator = (const MessageTransport&);
+
+    MessageTransportListener* _pListener;
+    pi::FastMutex             _listenerMutex;
+};
+
+
+class PIL_API InProcessTransport: public MessageTransport
+    /// A MessageTransport between objects in the same process.
+    ///
+    /// All InProcessTransports created with the same channel name
+    /// are connected; send() synchronously delivers the frames to
+    /// all other transports of the channel. It is mainly intended
+    /// for testing publishers and subscribers without a network.
+{
+public:
+    explicit InProcessTransport(const std::string& channel = "default");
+        /// Creates the InProcessTransport and connects it to
+        /// the given channel.
+
+    ~InProcessTransport();
+        /// Disconnects the InProcessTransport from its channel.
+
+    void send(const char* frames, int length);
+
+    const std::string& channel() const;
+        /// Returns the channel name.
+
+private:
+    std::string _channel;
+};
+
+
+//
+// inlines
+//
+inline const std::string& InProcessTransport::channel() const
+{
+    return _channel;
+}
+
+
+} // namespace pi
+
+
+#endif // Net_MessageTransport_INCLUDED
@@ -0,0 +1,123 @@
+#include "MulticastMessageTransport.h"
+
+
+#ifdef PIL_NET_HAS_INTERFACE
+
+
+#include "MessageFrame.h"
+#include "base/Debug/Exception.h"
+#include "base/Debug/ErrorHandler.h"
+
+
+namespace pi {
+
+
+MulticastMessageTransport::MulticastMessageTransport(const SocketAddress& groupAddress, int maxDatagramSize, unsigned timeToLive):
+    _group(groupAddress),
+    _maxDatagramSize(maxDatagramSize),
+    _batch(16, 65536),
+    _thread("MulticastMessageTransport")
+{
+    _socket.bind(SocketAddress(IPAddress(), _group.port()), true);
+    _socket.joinGroup(_group.host());
+
+    _sendSocket.setLoopback(true);
+    _sendSocket.setTimeToLive(timeToLive);
+
+    _reactor.addSocket(_socket, this, SocketReactor::EVENT_READ, true);
+    _thread.start(_reactor);
+}
+
+
+MulticastMessageTransport::~MulticastMessageTransport()
+{
+    try
+    {
+        _reactor.stop();
+        _thread.join();
+        _reactor.removeSocket(_socket);
+        _socket.leaveGroup(_group.host());
+    }
+    catch (...)
+    {
+        pi_dbg_error("Failed");
+    }
+}
+
+
+void MulticastMessageTransport::send(const char* frames, int length)
+{
+    // check all frames first, so that a bad one sends nothing
+    for (int offset = 0; offset < length; )
+    {
+        int size = MessageFrame::peekSize(frames + offset, length - offset);
+        if (size == 0 || size > length - offset)
+            throw DataFormatException("Incomplete message frame");
+        if (size > _maxDatagramSize)
+            throw DataFormatException("Message frame exceeds the datagram size");
+        offset += size;
+    }
+
+    FastMutex::ScopedLock lock(_sendMutex);
+
+    int start = 0;
+    int end   = 0;
+    while (end < length)
+    {
+        int size = MessageFrame::peekSize(frames + end, length - end);
+        if (end + size - start > _maxDatagramSize)
+        {
+            _sendSocket.sendTo(frames + start, end - start, _group);
+            start = end;
+        }
+        end += size;
+    }
+    if (end > start)
+        _sendSocket.sendTo(frames + start, end - start, _group);
+}
+
+
+void MulticastMessageTransport::onSocketReady(Socket& /*socket*/, int /*events*/)
+{
+    for (;;)
+    {
+        int n;
+        try
+        {
+            n = _socket.receiveBatch(_batch);
+        }
+        catch (pi::Exception& exc)
+        {
+            ErrorHandler::handle(exc);
+            return;
+        }
+        if (n <= 0) return;
+
+        for (int i = 0; i < n; ++i)
+        {
+            const char* data   = _batch.data(i);
+            int         length = _batch.length(i);
+            int         offset = 0;
+            try
+            {
+                while (offset < length)
+                {
+                    int size = MessageFrame::peekSize(data + offset, length - offset);
+                    if (size == 0 || size > length - offset) break; // truncated datagram
+                    deliver(data + offset, size);
+                    offset += size;
+                }
+            }
+            catch (pi::Exception&)
+            {
+                // not one of our datagrams, ignore the rest of it
+            }
+        }
+    }
+}
+
+
+} // namespace pi
+
+
+#endif // PIL_NET_HAS_INTERFACE
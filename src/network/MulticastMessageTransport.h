@@ -0,0 +1,84 @@
+#ifndef Net_MulticastMessageTransport_INCLUDED
+#define Net_MulticastMessageTransport_INCLUDED
+
+
+#include "Net.h"
+
+
+#ifdef PIL_NET_HAS_INTERFACE
+
+
+#include "MessageTransport.h"
+#include "MulticastSocket.h"
+#include "DatagramBatch.h"
+#include "SocketReactor.h"
+#include "base/Thread/Thread.h"
+
+
+namespace pi {
+
+
+class PIL_API MulticastMessageTransport: public MessageTransport, private SocketEventHandler
+    /// A MessageTransport over UDP multicast.
+    ///
+    /// send() packs as many complete frames into each datagram as
+    /// fit into maxDatagramSize; a frame is never split, so frames
+    /// larger than a datagram cannot be sent. Datagrams may be lost
+    /// or reordered like any UDP traffic.
+    ///
+    /// Received datagrams are read in batches with
+    /// DatagramSocket::receiveBatch() by a SocketReactor thread.
+    /// Loopback is enabled, so subscribers on the same host, including
+    /// the sending transport itself, receive the frames as well.
+{
+public:
+    MulticastMessageTransport(const SocketAddress& groupAddress, int maxDatagramSize = 1472, unsigned timeToLive = 1);
+        /// Creates the transport, joins the given multicast group
+        /// on the default interface and starts the reactor thread.
+        ///
+        /// The default datagram size avoids IP fragmentation
+        /// on Ethernet.
+
+    ~MulticastMessageTransport();
+        /// Leaves the group and stops the reactor thread.
+
+    void send(const char* frames, int length);
+        /// Sends the frames to the group.
+        ///
+        /// Throws a DataFormatException, before sending any of
+        /// them, if a frame is incomplete or larger than
+        /// maxDatagramSize.
+
+    const SocketAddress& group() const;
+        /// Returns the multicast group address.
+
+private:
+    void onSocketReady(Socket& socket, int events);
+
+    SocketAddress   _group;
+    int             _maxDatagramSize;
+    MulticastSocket _socket;
+    MulticastSocket _sendSocket;
+    DatagramBatch   _batch;
+    SocketReactor   _reactor;
+    pi::Thread      _thread;
+    pi::FastMutex   _sendMutex;
+};
+
+
+//
+// inlines
+//
+inline const SocketAddress& MulticastMessageTransport::group() const
+{
+    return _group;
+}
+
+
+} // namespace pi
+
+
+#endif // PIL_NET_HAS_INTERFACE
+
+
+#endif // Net_MulticastMessageTransport_INCLUDED
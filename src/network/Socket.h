@@ -267,6 +267,10 @@ public:
     static bool supportsIPv6();
         /// Returns true if the system supports IPv6.
 
+    static SocketBuf makeBuffer(void* buffer, std::size_t length);
+        /// Creates a SocketBuf for scatter/gather I/O from the
+        /// given buffer and length.
+
     void init(int af);
         /// Creates the underlying system socket for the given
         /// address family.
@@ -602,6 +606,20 @@ inline bool Socket::supportsIPv6()
 }
 
 
+inline SocketBuf Socket::makeBuffer(void* buffer, std::size_t length)
+{
+    SocketBuf buf;
+#if defined(PIL_OS_FAMILY_WINDOWS)
+    buf.buf = reinterpret_cast<char*>(buffer);
+    buf.len = static_cast<ULONG>(length);
+#else
+    buf.iov_base = buffer;
+    buf.iov_len  = length;
+#endif
+    return buf;
+}
+
+
 inline void Socket::init(int af)
 {
     _pImpl->init(af);
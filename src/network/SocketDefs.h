@@ -130,6 +130,7 @@
     #include <netinet/in.h>
     #include <netinet/tcp.h>
     #include <netdb.h>
+    #include <sys/uio.h>
     #if defined(PIL_OS_FAMILY_UNIX)
         #if (PIL_OS == PIL_OS_LINUX)
             // Net/src/NetworkInterface.cpp changed #include <linux/if.h> to #include <net/if.h>
@@ -1,6 +1,7 @@
 #include "SocketImpl.h"
 #include "NetException.h"
 #include "StreamSocketImpl.h"
+#include "DatagramBatch.h"
 //#include "NumberFormatter.h"
 #include <base/Utils/utils_str.h>
 #include "base/Time/Timestamp.h"
@@ -12,6 +13,14 @@
 #endif
 
 
+#if PIL_OS == PIL_OS_LINUX
+#include <netinet/udp.h>
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+
 #if defined(sun) || defined(__sun) || defined(__sun__)
 #include <unistd.h>
 #include <stropts.h>
@@ -345,6 +354,223 @@ int SocketImpl::receiveFrom(void* buffer, int length, SocketAddress& address, in
 }
 
 
+int SocketImpl::sendv(const SocketBufVec& buffers, int flags)
+{
+#if defined(PIL_BROKEN_TIMEOUTS)
+    if (_sndTimeout.totalMicroseconds() != 0)
+    {
+        if (!poll(_sndTimeout, SELECT_WRITE))
+            throw TimeoutException();
+    }
+#endif
+
+    if (buffers.empty()) return 0;
+
+    int rc;
+    do
+    {
+        if (_sockfd == PIL_INVALID_SOCKET) throw InvalidSocketException();
+#if defined(PIL_OS_FAMILY_WINDOWS)
+        DWORD sent = 0;
+        rc = WSASend(_sockfd, const_cast<LPWSABUF>(&buffers[0]), (DWORD) buffers.size(), &sent, (DWORD) flags, 0, 0);
+        if (rc == 0) rc = (int) sent;
+#else
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov    = const_cast<struct iovec*>(&buffers[0]);
+        msg.msg_iovlen = buffers.size();
+        rc = (int) ::sendmsg(_sockfd, &msg, flags);
+#endif
+    }
+    while (_blocking && rc < 0 && lastError() == PIL_EINTR);
+    if (rc < 0) error();
+    return rc;
+}
+
+
+int SocketImpl::receivev(SocketBufVec& buffers, int flags)
+{
+#if defined(PIL_BROKEN_TIMEOUTS)
+    if (_recvTimeout.totalMicroseconds() != 0)
+    {
+        if (!poll(_recvTimeout, SELECT_READ))
+            throw TimeoutException();
+    }
+#endif
+
+    if (buffers.empty()) return 0;
+
+    int rc;
+    do
+    {
+        if (_sockfd == PIL_INVALID_SOCKET) throw InvalidSocketException();
+#if defined(PIL_OS_FAMILY_WINDOWS)
+        DWORD received = 0;
+        DWORD dwFlags  = (DWORD) flags;
+        rc = WSARecv(_sockfd, &buffers[0], (DWORD) buffers.size(), &received, &dwFlags, 0, 0);
+        if (rc == 0) rc = (int) received;
+#else
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov    = &buffers[0];
+        msg.msg_iovlen = buffers.size();
+        rc = (int) ::recvmsg(_sockfd, &msg, flags);
+#endif
+    }
+    while (_blocking && rc < 0 && lastError() == PIL_EINTR);
+    if (rc < 0)
+    {
+        int err = lastError();
+        if (err == PIL_EAGAIN && !_blocking)
+            ;
+        else if (err == PIL_EAGAIN || err == PIL_ETIMEDOUT)
+            throw TimeoutException(err);
+        else
+            error(err);
+    }
+    return rc;
+}
+
+
+int SocketImpl::sendBatch(const DatagramBatch& batch, int flags)
+{
+    if (_sockfd == PIL_INVALID_SOCKET) throw InvalidSocketException();
+
+#if PIL_OS == PIL_OS_LINUX
+    DatagramBatch& b = const_cast<DatagramBatch&>(batch);
+    for (int i = 0; i < b._count; ++i)
+    {
+        const DatagramBatch::Packet& packet = b._packets[i];
+        struct msghdr& msg = b._headers[i].msg_hdr;
+        b._iovecs[i].iov_len = packet.length;
+        msg.msg_name       = packet.addressLength ? (void*) &packet.address : 0;
+        msg.msg_namelen    = packet.addressLength;
+        msg.msg_control    = 0;
+        msg.msg_controllen = 0;
+        msg.msg_flags      = 0;
+    }
+
+    int sent = 0;
+    while (sent < b._count)
+    {
+        int rc = ::sendmmsg(_sockfd, &b._headers[sent], b._count - sent, flags);
+        if (rc < 0)
+        {
+            int err = lastError();
+            if (err == PIL_EINTR && _blocking) continue;
+            if (sent > 0 && (err == PIL_EAGAIN || err == PIL_EWOULDBLOCK)) break;
+            error(err);
+        }
+        sent += rc;
+    }
+    return sent;
+#else
+    int sent = 0;
+    for (; sent < batch.count(); ++sent)
+    {
+        const DatagramBatch::Packet& packet = batch._packets[sent];
+        if (packet.addressLength)
+            sendTo(batch.data(sent), batch.length(sent), batch.address(sent), flags);
+        else
+            sendBytes(batch.data(sent), batch.length(sent), flags);
+    }
+    return sent;
+#endif
+}
+
+
+int SocketImpl::receiveBatch(DatagramBatch& batch, int flags)
+{
+#if defined(PIL_BROKEN_TIMEOUTS)
+    if (_recvTimeout.totalMicroseconds() != 0)
+    {
+        if (!poll(_recvTimeout, SELECT_READ))
+            throw TimeoutException();
+    }
+#endif
+
+    batch._count = 0;
+    if (_sockfd == PIL_INVALID_SOCKET) throw InvalidSocketException();
+
+#if PIL_OS == PIL_OS_LINUX
+    const int    capacity    = batch.capacity();
+    const size_t controlSize = batch._control.size() / capacity;
+    for (int i = 0; i < capacity; ++i)
+    {
+        struct msghdr& msg = batch._headers[i].msg_hdr;
+        batch._iovecs[i].iov_len = batch._packetSize;
+        msg.msg_name       = &batch._packets[i].address;
+        msg.msg_namelen    = sizeof(struct sockaddr_storage);
+        msg.msg_control    = &batch._control[i * controlSize];
+        msg.msg_controllen = controlSize;
+        msg.msg_flags      = 0;
+    }
+
+    int rc;
+    do
+    {
+        rc = ::recvmmsg(_sockfd, &batch._headers[0], capacity, flags | MSG_WAITFORONE, 0);
+    }
+    while (_blocking && rc < 0 && lastError() == PIL_EINTR);
+    if (rc < 0)
+    {
+        int err = lastError();
+        if (err == PIL_EAGAIN && !_blocking)
+            ;
+        else if (err == PIL_EAGAIN || err == PIL_ETIMEDOUT)
+            throw TimeoutException(err);
+        else
+            error(err);
+        return rc;
+    }
+
+    for (int i = 0; i < rc; ++i)
+    {
+        struct msghdr& msg = batch._headers[i].msg_hdr;
+        DatagramBatch::Packet& packet = batch._packets[i];
+        packet.length        = (int) batch._headers[i].msg_len;
+        packet.addressLength = msg.msg_namelen;
+        packet.truncated     = (msg.msg_flags & MSG_TRUNC) != 0;
+        packet.segmentSize   = 0;
+        packet.timestamp     = 0;
+        if (packet.length > batch._packetSize) packet.length = batch._packetSize;
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+            {
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                packet.timestamp = (pi::Int64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+            }
+            else if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+            {
+                int segmentSize;
+                memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof(segmentSize));
+                if (segmentSize < packet.length) packet.segmentSize = segmentSize;
+            }
+        }
+    }
+    batch._count = rc;
+    return rc;
+#else
+    SocketAddress address;
+    int n = receiveFrom(batch.data(0), batch.packetSize(), address, flags);
+    if (n < 0) return n;
+
+    DatagramBatch::Packet& packet = batch._packets[0];
+    packet.length        = n;
+    packet.addressLength = address.length();
+    packet.truncated     = false;
+    packet.segmentSize   = 0;
+    packet.timestamp     = 0;
+    memcpy(&packet.address, address.addr(), address.length());
+    batch._count = 1;
+    return 1;
+#endif
+}
+
+
 void SocketImpl::sendUrgent(unsigned char data)
 {
     if (_sockfd == PIL_INVALID_SOCKET) throw InvalidSocketException();
@@ -7,10 +7,26 @@
 #include "SocketAddress.h"
 #include "base/Types/RefCountedObject.h"
 #include "base/Time/Timespan.h"
+#include <vector>
 
 
 namespace pi {
 
+
+class DatagramBatch;
+
+
+// A single buffer of a scatter/gather I/O operation,
+// see SocketImpl::sendv() and SocketImpl::receivev().
+#if defined(PIL_OS_FAMILY_WINDOWS)
+typedef WSABUF SocketBuf;
+#else
+typedef struct iovec SocketBuf;
+#endif
+
+typedef std::vector<SocketBuf> SocketBufVec;
+
+
 class PIL_API SocketImpl: public pi::RefCountedObject
     /// This class encapsulates the Berkeley sockets API.
     ///
@@ -139,6 +155,40 @@ public:
         ///
         /// Returns the number of bytes received.
 
+    virtual int sendv(const SocketBufVec& buffers, int flags = 0);
+        /// Sends the contents of the given buffers through the
+        /// socket with a single gather write (sendmsg() or
+        /// WSASend()), without copying them into one buffer.
+        ///
+        /// Returns the number of bytes sent, which may be
+        /// less than the total size of the buffers.
+
+    virtual int receivev(SocketBufVec& buffers, int flags = 0);
+        /// Receives data from the socket and scatters it into the
+        /// given buffers with a single read (recvmsg() or WSARecv()),
+        /// filling them in order.
+        ///
+        /// Returns the number of bytes received, or -1 if the
+        /// socket is non-blocking and no data is available.
+        /// A return value of 0 means a graceful shutdown
+        /// of the connection from the peer.
+
+    virtual int sendBatch(const DatagramBatch& batch, int flags = 0);
+        /// Sends all packets of the batch, each as a separate
+        /// datagram, with as few syscalls as possible.
+        ///
+        /// Returns the number of packets sent, which may be
+        /// less than batch.count() if the socket is non-blocking.
+
+    virtual int receiveBatch(DatagramBatch& batch, int flags = 0);
+        /// Receives up to batch.capacity() datagrams with as few
+        /// syscalls as possible. Waits for the first datagram only
+        /// if the socket is blocking, and returns the datagrams
+        /// already queued after it.
+        ///
+        /// Returns the number of packets received, or -1 if the
+        /// socket is non-blocking and no datagram is available.
+
     virtual void sendUrgent(unsigned char data);
         /// Sends one byte of urgent data through
         /// the socket.
@@ -0,0 +1,432 @@
+#include "SocketReactor.h"
+#include "SocketImpl.h"
+#include "NetException.h"
+#include "base/Debug/ErrorHandler.h"
+#include "base/Thread/Thread.h"
+#include <string.h>
+#if PIL_OS == PIL_OS_LINUX
+#include <sys/eventfd.h>
+#endif
+
+
+namespace pi {
+
+
+SocketReactor::SocketReactor():
+    _idleTimeout(250000),
+    _stopped(false),
+    _nextTimerId(1)
+{
+    init();
+}
+
+
+SocketReactor::SocketReactor(const pi::Timespan& idleTimeout):
+    _idleTimeout(idleTimeout),
+    _stopped(false),
+    _nextTimerId(1)
+{
+    init();
+}
+
+
+SocketReactor::~SocketReactor()
+{
+#if PIL_OS == PIL_OS_LINUX
+    ::close(_eventfd);
+    ::close(_epollfd);
+#endif
+}
+
+
+void SocketReactor::init()
+{
+#if PIL_OS == PIL_OS_LINUX
+    _epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epollfd < 0)
+        throw NetException("Can't create epoll queue", errno);
+
+    _eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_eventfd < 0)
+    {
+        int err = errno;
+        ::close(_epollfd);
+        throw NetException("Can't create eventfd", err);
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events  = EPOLLIN;
+    ev.data.fd = _eventfd;
+    if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, _eventfd, &ev) < 0)
+    {
+        int err = errno;
+        ::close(_eventfd);
+        ::close(_epollfd);
+        throw NetException("Can't insert eventfd to epoll queue", err);
+    }
+    _events.resize(64);
+#else
+    _wokenUp = false;
+#endif
+}
+
+
+void SocketReactor::control(int op, const SocketEntry& entry)
+{
+#if PIL_OS == PIL_OS_LINUX
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = entry.socket.impl()->sockfd();
+    if (op != EPOLL_CTL_DEL)
+    {
+        ev.events = EPOLLRDHUP;
+        if (entry.events & EVENT_READ)  ev.events |= EPOLLIN;
+        if (entry.events & EVENT_WRITE) ev.events |= EPOLLOUT;
+        if (entry.edgeTriggered)        ev.events |= EPOLLET;
+    }
+    if (epoll_ctl(_epollfd, op, entry.socket.impl()->sockfd(), &ev) < 0)
+        throw NetException("Can't update epoll queue", errno);
+#else
+    (void) op;
+    (void) entry;
+#endif
+}
+
+
+void SocketReactor::addSocket(const Socket& socket, SocketEventHandler* pHandler, int events, bool edgeTriggered)
+{
+    pi_check_ptr (pHandler);
+    if (socket.impl()->sockfd() == PIL_INVALID_SOCKET) throw InvalidSocketException();
+
+    SocketEntry entry;
+    entry.socket        = socket;
+    entry.pHandler      = pHandler;
+    entry.events        = events;
+    entry.edgeTriggered = edgeTriggered;
+    entry.socket.setBlocking(false);
+
+    FastMutex::ScopedLock lock(_mutex);
+    SocketMap::iterator it = _sockets.find(socket.impl()->sockfd());
+#if PIL_OS == PIL_OS_LINUX
+    control(it == _sockets.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, entry);
+#endif
+    if (it == _sockets.end())
+        _sockets.insert(SocketMap::value_type(socket.impl()->sockfd(), entry));
+    else
+        it->second = entry;
+}
+
+
+void SocketReactor::modifySocket(const Socket& socket, int events)
+{
+    FastMutex::ScopedLock lock(_mutex);
+    SocketMap::iterator it = _sockets.find(socket.impl()->sockfd());
+    if (it == _sockets.end()) throw NotFoundException("Socket not registered with reactor");
+    if (it->second.events == events) return;
+
+    it->second.events = events;
+#if PIL_OS == PIL_OS_LINUX
+    control(EPOLL_CTL_MOD, it->second);
+#endif
+}
+
+
+void SocketReactor::removeSocket(const Socket& socket)
+{
+    FastMutex::ScopedLock lock(_mutex);
+    SocketMap::iterator it = _sockets.find(socket.impl()->sockfd());
+    if (it == _sockets.end()) return;
+
+#if PIL_OS == PIL_OS_LINUX
+    try
+    {
+        control(EPOLL_CTL_DEL, it->second);
+    }
+    catch (NetException&)
+    {
+        // the socket may already have been closed,
+        // which removes it from the epoll set anyway.
+    }
+#endif
+    _sockets.erase(it);
+}
+
+
+bool SocketReactor::hasSocket(const Socket& socket) const
+{
+    FastMutex::ScopedLock lock(_mutex);
+    return _sockets.find(socket.impl()->sockfd()) != _sockets.end();
+}
+
+
+int SocketReactor::countSockets() const
+{
+    FastMutex::ScopedLock lock(_mutex);
+    return (int) _sockets.size();
+}
+
+
+int SocketReactor::addTimer(const pi::Timespan& delay, SocketTimerHandler* pHandler, const pi::Timespan& interval)
+{
+    pi_check_ptr (pHandler);
+
+    TimerEntry entry;
+    entry.due      = pi::Timestamp() + delay.totalMicroseconds();
+    entry.interval = interval;
+    entry.pHandler = pHandler;
+
+    int id;
+    {
+        FastMutex::ScopedLock lock(_mutex);
+        id = _nextTimerId++;
+        _timers.insert(TimerMap::value_type(id, entry));
+    }
+    wakeUp();
+    return id;
+}
+
+
+void SocketReactor::cancelTimer(int timerId)
+{
+    FastMutex::ScopedLock lock(_mutex);
+    _timers.erase(timerId);
+}
+
+
+void SocketReactor::wakeUp()
+{
+#if PIL_OS == PIL_OS_LINUX
+    UInt64 one = 1;
+    ssize_t rc;
+    do
+    {
+        rc = ::write(_eventfd, &one, sizeof(one));
+    }
+    while (rc < 0 && errno == EINTR);
+#else
+    FastMutex::ScopedLock lock(_mutex);
+    _wokenUp = true;
+#endif
+}
+
+
+pi::Timespan SocketReactor::nextTimeout(const pi::Timespan& timeout) const
+{
+    pi::Timespan result(timeout);
+    FastMutex::ScopedLock lock(_mutex);
+    if (_timers.empty()) return result;
+
+    pi::Timestamp now;
+    for (TimerMap::const_iterator it = _timers.begin(); it != _timers.end(); ++it)
+    {
+        pi::Timestamp::TimeDiff diff = it->second.due - now;
+        if (diff <= 0) return pi::Timespan(0);
+        if (diff < result.totalMicroseconds()) result = diff;
+    }
+    return result;
+}
+
+
+int SocketReactor::dispatchTimers()
+{
+    std::vector<std::pair<int, SocketTimerHandler*> > due;
+    {
+        FastMutex::ScopedLock lock(_mutex);
+        if (_timers.empty()) return 0;
+
+        pi::Timestamp now;
+        TimerMap::iterator it = _timers.begin();
+        while (it != _timers.end())
+        {
+            if (it->second.due > now)
+            {
+                ++it;
+                continue;
+            }
+            due.push_back(std::make_pair(it->first, it->second.pHandler));
+            if (it->second.interval.totalMicroseconds() > 0)
+            {
+                it->second.due = now + it->second.interval.totalMicroseconds();
+                ++it;
+            }
+            else _timers.erase(it++);
+        }
+    }
+
+    for (size_t i = 0; i < due.size(); ++i)
+    {
+        try
+        {
+            due[i].second->onTimer(due[i].first);
+        }
+        catch (pi::Exception& exc)
+        {
+            ErrorHandler::handle(exc);
+        }
+        catch (std::exception& exc)
+        {
+            ErrorHandler::handle(exc);
+        }
+        catch (...)
+        {
+            ErrorHandler::handle();
+        }
+    }
+    return (int) due.size();
+}
+
+
+int SocketReactor::dispatch(pil_socket_t fd, int events)
+{
+    Socket socket;
+    SocketEventHandler* pHandler = 0;
+    {
+        FastMutex::ScopedLock lock(_mutex);
+        SocketMap::iterator it = _sockets.find(fd);
+        if (it == _sockets.end()) return 0; // removed by a previous handler
+        socket   = it->second.socket;
+        pHandler = it->second.pHandler;
+    }
+
+    try
+    {
+        pHandler->onSocketReady(socket, events);
+    }
+    catch (pi::Exception& exc)
+    {
+        ErrorHandler::handle(exc);
+    }
+    catch (std::exception& exc)
+    {
+        ErrorHandler::handle(exc);
+    }
+    catch (...)
+    {
+        ErrorHandler::handle();
+    }
+    return 1;
+}
+
+
+int SocketReactor::waitEvents(const pi::Timespan& timeout)
+{
+    int dispatched = 0;
+
+#if PIL_OS == PIL_OS_LINUX
+
+    int rc;
+    do
+    {
+        rc = epoll_wait(_epollfd, &_events[0], (int) _events.size(), (int) ((timeout.totalMicroseconds() + 999)/1000));
+    }
+    while (rc < 0 && errno == EINTR);
+    if (rc < 0) throw NetException("epoll_wait failed", errno);
+
+    for (int i = 0; i < rc; ++i)
+    {
+        const struct epoll_event& ev = _events[i];
+        if (ev.data.fd == _eventfd)
+        {
+            UInt64 counter;
+            while (::read(_eventfd, &counter, sizeof(counter)) > 0);
+            continue;
+        }
+
+        int events = 0;
+        if (ev.events & EPOLLIN)  events |= EVENT_READ;
+        if (ev.events & EPOLLOUT) events |= EVENT_WRITE;
+        if (ev.events & EPOLLERR) events |= EVENT_ERROR;
+        if (ev.events & (EPOLLHUP | EPOLLRDHUP)) events |= EVENT_HANGUP;
+        dispatched += dispatch(ev.data.fd, events);
+    }
+
+    // grow the event buffer if the kernel had more to report
+    if (rc == (int) _events.size()) _events.resize(_events.size() * 2);
+
+#else
+
+    Socket::SocketList readList;
+    Socket::SocketList writeList;
+    Socket::SocketList exceptList;
+    {
+        FastMutex::ScopedLock lock(_mutex);
+        for (SocketMap::iterator it = _sockets.begin(); it != _sockets.end(); ++it)
+        {
+            if (it->second.events & EVENT_READ)  readList.push_back(it->second.socket);
+            if (it->second.events & EVENT_WRITE) writeList.push_back(it->second.socket);
+            exceptList.push_back(it->second.socket);
+        }
+    }
+
+    // select() can not be interrupted by wakeUp(), so wait in short slices.
+    pi::Timespan slice(timeout < pi::Timespan(10000) ? timeout : pi::Timespan(10000));
+    pi::Timestamp start;
+    int rc = 0;
+    while (true)
+    {
+        Socket::SocketList r(readList), w(writeList), e(exceptList);
+        if (r.empty() && w.empty() && e.empty())
+            Thread::sleep((long) slice.totalMilliseconds());
+        else
+            rc = Socket::select(r, w, e, slice);
+        {
+            FastMutex::ScopedLock lock(_mutex);
+            if (_wokenUp || rc > 0 || start.isElapsed(timeout.totalMicroseconds()))
+            {
+                _wokenUp = false;
+                readList.swap(r);
+                writeList.swap(w);
+                exceptList.swap(e);
+                break;
+            }
+        }
+    }
+
+    std::map<pil_socket_t, int> ready;
+    for (Socket::SocketList::iterator it = readList.begin(); it != readList.end(); ++it)
+        ready[it->impl()->sockfd()] |= EVENT_READ;
+    for (Socket::SocketList::iterator it = writeList.begin(); it != writeList.end(); ++it)
+        ready[it->impl()->sockfd()] |= EVENT_WRITE;
+    for (Socket::SocketList::iterator it = exceptList.begin(); it != exceptList.end(); ++it)
+        ready[it->impl()->sockfd()] |= EVENT_ERROR;
+    for (std::map<pil_socket_t, int>::iterator it = ready.begin(); it != ready.end(); ++it)
+        dispatched += dispatch(it->first, it->second);
+
+#endif
+
+    return dispatched;
+}
+
+
+int SocketReactor::runOnce(const pi::Timespan& timeout)
+{
+    int dispatched = waitEvents(nextTimeout(timeout));
+    dispatched += dispatchTimers();
+    return dispatched;
+}
+
+
+void SocketReactor::run()
+{
+    while (!_stopped)
+    {
+        if (runOnce(_idleTimeout) == 0 && !_stopped)
+            onIdle();
+    }
+}
+
+
+void SocketReactor::stop()
+{
+    _stopped = true;
+    wakeUp();
+}
+
+
+void SocketReactor::onIdle()
+{
+}
+
+
+} // namespace pi
@@ -0,0 +1,214 @@
+#ifndef Net_SocketReactor_INCLUDED
+#define Net_SocketReactor_INCLUDED
+
+
+#include "Net.h"
+#include "Socket.h"
+#include "base/Thread/Runnable.h"
+#include "base/Thread/Mutex.h"
+#include "base/Time/Timespan.h"
+#include "base/Time/Timestamp.h"
+#include <map>
+#include <vector>
+#if PIL_OS == PIL_OS_LINUX
+#include <sys/epoll.h>
+#endif
+
+
+namespace pi {
+
+
+class PIL_API SocketEventHandler
+    /// The interface for objects that want to be notified
+    /// by a SocketReactor when a registered socket becomes ready.
+{
+public:
+    virtual ~SocketEventHandler() {}
+
+    virtual void onSocketReady(Socket& socket, int events) = 0;
+        /// Called from the reactor thread when the socket becomes
+        /// ready. events is a combination of SocketReactor::EventMode
+        /// values.
+        ///
+        /// In edge-triggered mode the handler is only called again
+        /// after the readiness state has changed, so it must read
+        /// or write until the operation would block.
+};
+
+
+class PIL_API SocketTimerHandler
+    /// The interface for objects that want to be notified
+    /// by a SocketReactor when a timer expires.
+{
+public:
+    virtual ~SocketTimerHandler() {}
+
+    virtual void onTimer(int timerId) = 0;
+        /// Called from the reactor thread when the timer expires.
+};
+
+
+class PIL_API SocketReactor: public pi::Runnable
+    /// This class implements a long-lived event loop for
+    /// StreamSocket, DatagramSocket and ServerSocket objects.
+    ///
+    /// In contrast to Socket::poll() and Socket::select(), which
+    /// set up the wait on every call, the reactor keeps a single
+    /// epoll instance (on Linux) for its whole lifetime. Sockets
+    /// are registered once with addSocket() and the given
+    /// SocketEventHandler is called whenever they become ready.
+    ///
+    /// Besides sockets, the reactor manages one-shot and periodic
+    /// timers, and it can be woken up from any thread with wakeUp()
+    /// (using an eventfd on Linux), e.g. after more data has been
+    /// queued for sending.
+    ///
+    /// All handlers are called from the thread executing run() or
+    /// runOnce(). Registration methods are thread-safe and may also
+    /// be called from within a handler.
+    ///
+    /// On platforms without epoll, the reactor falls back to
+    /// Socket::select() with level-triggered semantics.
+{
+public:
+    enum EventMode
+    {
+        EVENT_READ   = 1,
+        EVENT_WRITE  = 2,
+        EVENT_ERROR  = 4,
+        EVENT_HANGUP = 8
+    };
+
+    SocketReactor();
+        /// Creates the SocketReactor.
+
+    explicit SocketReactor(const pi::Timespan& idleTimeout);
+        /// Creates the SocketReactor, using the given maximum
+        /// time to block in the event loop if no timer is pending.
+        ///
+        /// The default is 250 milliseconds.
+
+    virtual ~SocketReactor();
+        /// Destroys the SocketReactor. Registered sockets are
+        /// not closed.
+
+    void addSocket(const Socket& socket, SocketEventHandler* pHandler, int events = EVENT_READ, bool edgeTriggered = true);
+        /// Registers the socket with the reactor. pHandler is
+        /// called when any of the given events occurs.
+        ///
+        /// The socket is put into non-blocking mode. The reactor
+        /// does not take ownership of the handler.
+        ///
+        /// If the socket is already registered, its handler and
+        /// event mask are replaced.
+
+    void modifySocket(const Socket& socket, int events);
+        /// Changes the events the reactor waits for on the given
+        /// socket, e.g. to enable EVENT_WRITE while output is pending.
+        ///
+        /// Throws a NotFoundException if the socket is not registered.
+
+    void removeSocket(const Socket& socket);
+        /// Unregisters the socket. Does nothing if the socket
+        /// is not registered.
+
+    bool hasSocket(const Socket& socket) const;
+        /// Returns true iff the socket is registered.
+
+    int countSockets() const;
+        /// Returns the number of registered sockets.
+
+    int addTimer(const pi::Timespan& delay, SocketTimerHandler* pHandler, const pi::Timespan& interval = 0);
+        /// Schedules pHandler to be called after delay has elapsed.
+        /// If interval is not zero, the timer is repeated with the
+        /// given interval until it is cancelled.
+        ///
+        /// Returns the id of the timer.
+
+    void cancelTimer(int timerId);
+        /// Cancels the timer with the given id. Does nothing
+        /// if there is no such timer.
+
+    void wakeUp();
+        /// Interrupts a blocking wait of the event loop.
+        /// Can be called from any thread.
+
+    int runOnce(const pi::Timespan& timeout);
+        /// Waits at most timeout for events and dispatches them,
+        /// as well as all expired timers.
+        ///
+        /// Returns the number of handlers called.
+
+    void run();
+        /// Runs the event loop until stop() is called.
+
+    void stop();
+        /// Stops the event loop. Can be called from any thread,
+        /// also before run() has been entered.
+
+    bool isStopped() const;
+        /// Returns true iff stop() has been called.
+
+protected:
+    virtual void onIdle();
+        /// Called by run() whenever a wait returned without any
+        /// event. The default implementation does nothing.
+
+private:
+    SocketReactor(const SocketReactor&);
+    SocketReactor& operator = (const SocketReactor&);
+
+    struct SocketEntry
+    {
+        Socket              socket;
+        SocketEventHandler* pHandler;
+        int                 events;
+        bool                edgeTriggered;
+    };
+
+    struct TimerEntry
+    {
+        pi::Timestamp       due;
+        pi::Timespan        interval;
+        SocketTimerHandler* pHandler;
+    };
+
+    typedef std::map<pil_socket_t, SocketEntry> SocketMap;
+    typedef std::map<int, TimerEntry>           TimerMap;
+
+    void init();
+    void control(int op, const SocketEntry& entry);
+    pi::Timespan nextTimeout(const pi::Timespan& timeout) const;
+    int  dispatchTimers();
+    int  dispatch(pil_socket_t fd, int events);
+    int  waitEvents(const pi::Timespan& timeout);
+
+    pi::Timespan         _idleTimeout;
+    bool                 _stopped;
+    SocketMap            _sockets;
+    TimerMap             _timers;
+    int                  _nextTimerId;
+    mutable pi::FastMutex _mutex;
+#if PIL_OS == PIL_OS_LINUX
+    int                  _epollfd;
+    int                  _eventfd;
+    std::vector<struct epoll_event> _events;
+#else
+    bool                 _wokenUp;
+#endif
+};
+
+
+//
+// inlines
+//
+inline bool SocketReactor::isStopped() const
+{
+    return _stopped;
+}
+
+
+} // namespace pi
+
+
+#endif // Net_SocketReactor_INCLUDED
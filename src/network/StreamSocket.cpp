@@ -119,6 +119,48 @@ int StreamSocket::receiveBytes(FIFOBuffer& fifoBuf)
 }
 
 
+int StreamSocket::sendv(const SocketBufVec& buffers, int flags)
+{
+    return impl()->sendv(buffers, flags);
+}
+
+
+int StreamSocket::receivev(SocketBufVec& buffers, int flags)
+{
+    return impl()->receivev(buffers, flags);
+}
+
+
+pi::Int64 StreamSocket::sendFile(const std::string& path, pi::UInt64 offset, pi::Int64 length)
+{
+    return static_cast<StreamSocketImpl*>(impl())->sendFile(path, offset, length);
+}
+
+
+int StreamSocket::sendBytesZeroCopy(const void* buffer, int length)
+{
+    return static_cast<StreamSocketImpl*>(impl())->sendBytesZeroCopy(buffer, length);
+}
+
+
+pi::UInt32 StreamSocket::zeroCopySent() const
+{
+    return static_cast<StreamSocketImpl*>(impl())->zeroCopySent();
+}
+
+
+pi::UInt32 StreamSocket::zeroCopyCompleted(const pi::Timespan& timeout)
+{
+    return static_cast<StreamSocketImpl*>(impl())->zeroCopyCompleted(timeout);
+}
+
+
+bool StreamSocket::zeroCopyCopied() const
+{
+    return static_cast<StreamSocketImpl*>(impl())->zeroCopyCopied();
+}
+
+
 void StreamSocket::sendUrgent(unsigned char data)
 {
     impl()->sendUrgent(data);
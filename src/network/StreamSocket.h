@@ -129,6 +129,62 @@ public:
         /// been set and nothing is received within that interval.
         /// Throws a NetException (or a subclass) in case of other errors.
 
+    int sendv(const SocketBufVec& buffers, int flags = 0);
+        /// Sends the contents of the given buffers through the
+        /// socket with a single gather write, e.g. a message header
+        /// and a separately allocated payload, without copying
+        /// them into one contiguous buffer first.
+        /// Use Socket::makeBuffer() to create the buffers.
+        ///
+        /// Ensures that all data is sent if the socket is blocking.
+        /// Returns the number of bytes sent.
+
+    int receivev(SocketBufVec& buffers, int flags = 0);
+        /// Receives data from the socket and scatters it into
+        /// the given buffers, filling them in order.
+        ///
+        /// Returns the number of bytes received.
+        /// A return value of 0 means a graceful shutdown
+        /// of the connection from the peer.
+
+    pi::Int64 sendFile(const std::string& path, pi::UInt64 offset = 0, pi::Int64 length = -1);
+        /// Sends length bytes of the given file, starting at
+        /// offset. If length is negative, the file is sent
+        /// up to its end.
+        ///
+        /// On Linux, sendfile() is used, so the data does not
+        /// pass through user space.
+        ///
+        /// Returns the number of bytes sent.
+        /// Throws an OpenFileException if the file cannot be opened.
+
+    int sendBytesZeroCopy(const void* buffer, int length);
+        /// Sends the contents of the given buffer with MSG_ZEROCOPY
+        /// on Linux, so the kernel does not copy large buffers into
+        /// socket buffers. Small buffers and other platforms use
+        /// a normal send.
+        ///
+        /// The buffer must neither be modified nor freed until
+        /// zeroCopyCompleted() returns zeroCopySent().
+        ///
+        /// Returns the number of bytes sent.
+
+    pi::UInt32 zeroCopySent() const;
+        /// Returns the number of zero-copy send operations issued.
+
+    pi::UInt32 zeroCopyCompleted(const pi::Timespan& timeout = pi::Timespan(0));
+        /// Reads the zero-copy completion notifications from the
+        /// socket error queue, waiting up to timeout for them if
+        /// sends are outstanding.
+        ///
+        /// Returns the number of completed zero-copy sends. When
+        /// it equals zeroCopySent(), all buffers may be reused.
+
+    bool zeroCopyCopied() const;
+        /// Returns true if the kernel had to copy zero-copy data
+        /// anyway, e.g. on the loopback interface. MSG_ZEROCOPY
+        /// only adds overhead then.
+
     void sendUrgent(unsigned char data);
         /// Sends one byte of urgent data through
         /// the socket.
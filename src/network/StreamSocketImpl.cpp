@@ -1,18 +1,51 @@
 #include "StreamSocketImpl.h"
 #include "IPAddress.h"
+#include "NetException.h"
 #include "base/Debug/Exception.h"
 #include "base/Thread/Thread.h"
+#include "base/Types/Buffer.h"
+#include <string.h>
+#include <algorithm>
+#include <cstdio>
+#if defined(PIL_OS_FAMILY_UNIX)
+#include <sys/stat.h>
+#endif
+#if PIL_OS == PIL_OS_LINUX
+#include <sys/sendfile.h>
+#include <poll.h>
+#include <linux/errqueue.h>
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+#endif
 
 
 namespace pi {
 
 
-StreamSocketImpl::StreamSocketImpl()
+StreamSocketImpl::StreamSocketImpl():
+    _zeroCopyMode(0),
+    _zeroCopyCopied(false),
+    _zeroCopySent(0),
+    _zeroCopyCompleted(0)
 {
 }
 
 
-StreamSocketImpl::StreamSocketImpl(IPAddress::Family family)
+StreamSocketImpl::StreamSocketImpl(IPAddress::Family family):
+    _zeroCopyMode(0),
+    _zeroCopyCopied(false),
+    _zeroCopySent(0),
+    _zeroCopyCompleted(0)
 {
     if (family == IPAddress::IPv4)
         init(AF_INET);
@@ -24,7 +57,12 @@ StreamSocketImpl::StreamSocketImpl(IPAddress::Family family)
 }
 
 
-StreamSocketImpl::StreamSocketImpl(pil_socket_t sockfd): SocketImpl(sockfd)
+StreamSocketImpl::StreamSocketImpl(pil_socket_t sockfd):
+    SocketImpl(sockfd),
+    _zeroCopyMode(0),
+    _zeroCopyCopied(false),
+    _zeroCopySent(0),
+    _zeroCopyCompleted(0)
 {
 }
 
@@ -56,4 +94,220 @@ int StreamSocketImpl::sendBytes(const void* buffer, int length, int flags)
 }
 
 
+int StreamSocketImpl::sendv(const SocketBufVec& buffers, int flags)
+{
+    int sent = SocketImpl::sendv(buffers, flags);
+    if (!getBlocking()) return sent;
+
+    // After a short write, skip the completely sent buffers
+    // and resume within the partially sent one.
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < buffers.size(); ++i)
+#if defined(PIL_OS_FAMILY_WINDOWS)
+        total += buffers[i].len;
+#else
+        total += buffers[i].iov_len;
+#endif
+    if (sent < 0 || (std::size_t) sent >= total) return sent;
+
+    std::size_t done = sent;
+    while (done < total)
+    {
+        std::size_t skip  = done;
+        std::size_t first = 0;
+        for (; first < buffers.size(); ++first)
+        {
+#if defined(PIL_OS_FAMILY_WINDOWS)
+            std::size_t len = buffers[first].len;
+#else
+            std::size_t len = buffers[first].iov_len;
+#endif
+            if (skip < len) break;
+            skip -= len;
+        }
+        SocketBufVec rest(buffers.begin() + first, buffers.end());
+#if defined(PIL_OS_FAMILY_WINDOWS)
+        rest[0].buf += skip;
+        rest[0].len -= (ULONG) skip;
+#else
+        rest[0].iov_base = static_cast<char*>(rest[0].iov_base) + skip;
+        rest[0].iov_len -= skip;
+#endif
+        pi::Thread::yield();
+        int n = SocketImpl::sendv(rest, flags);
+        pi_assert_dbg (n >= 0);
+        done += n;
+    }
+    return (int) done;
+}
+
+
+pi::Int64 StreamSocketImpl::sendFile(const std::string& path, pi::UInt64 offset, pi::Int64 length)
+{
+#if PIL_OS == PIL_OS_LINUX
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw OpenFileException(path, errno);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        int err = errno;
+        ::close(fd);
+        throw ReadFileException(path, err);
+    }
+    if (length < 0)
+        length = offset < (pi::UInt64) st.st_size ? (pi::Int64) (st.st_size - offset) : 0;
+
+    off_t     pos  = (off_t) offset;
+    pi::Int64 sent = 0;
+    while (sent < length)
+    {
+        if (sockfd() == PIL_INVALID_SOCKET)
+        {
+            ::close(fd);
+            throw InvalidSocketException();
+        }
+        // sendfile() moves at most 0x7ffff000 bytes per call
+        std::size_t chunk = (std::size_t) std::min<pi::Int64>(length - sent, 0x7ffff000);
+        ssize_t rc = ::sendfile(sockfd(), fd, &pos, chunk);
+        if (rc < 0)
+        {
+            int err = lastError();
+            if (err == PIL_EINTR && getBlocking()) continue;
+            if ((err == PIL_EAGAIN || err == PIL_EWOULDBLOCK) && sent > 0) break;
+            ::close(fd);
+            error(err);
+        }
+        if (rc == 0) break; // file shorter than expected
+        sent += rc;
+    }
+    ::close(fd);
+    return sent;
+#else
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) throw OpenFileException(path);
+    if (fseek(file, (long) offset, SEEK_SET) != 0)
+    {
+        fclose(file);
+        throw ReadFileException(path);
+    }
+
+    pi::Buffer<char> buffer(65536);
+    pi::Int64 sent = 0;
+    try
+    {
+        while (length < 0 || sent < length)
+        {
+            std::size_t chunk = buffer.size();
+            if (length >= 0 && (pi::Int64) chunk > length - sent) chunk = (std::size_t) (length - sent);
+            std::size_t n = fread(buffer.begin(), 1, chunk, file);
+            if (n == 0) break;
+            int rc = sendBytes(buffer.begin(), (int) n);
+            sent += rc;
+            if (rc < (int) n) break;
+        }
+    }
+    catch (...)
+    {
+        fclose(file);
+        throw;
+    }
+    fclose(file);
+    return sent;
+#endif
+}
+
+
+int StreamSocketImpl::sendBytesZeroCopy(const void* buffer, int length)
+{
+#if PIL_OS == PIL_OS_LINUX
+    if (length >= ZEROCOPY_THRESHOLD && _zeroCopyMode == 0)
+    {
+        int one = 1;
+        _zeroCopyMode = ::setsockopt(sockfd(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0 ? 1 : -1;
+    }
+    if (length < ZEROCOPY_THRESHOLD || _zeroCopyMode < 0)
+        return sendBytes(buffer, length);
+
+    const char* p = reinterpret_cast<const char*>(buffer);
+    int  sent     = 0;
+    bool blocking = getBlocking();
+    while (sent < length)
+    {
+        if (sockfd() == PIL_INVALID_SOCKET) throw InvalidSocketException();
+        int rc = (int) ::send(sockfd(), p + sent, length - sent, MSG_ZEROCOPY);
+        if (rc < 0)
+        {
+            int err = lastError();
+            if (err == PIL_EINTR && blocking) continue;
+            if (err == PIL_ENOBUFS)
+            {
+                // the locked memory limit for pinned pages is exhausted
+                rc = SocketImpl::sendBytes(p + sent, length - sent);
+            }
+            else if ((err == PIL_EAGAIN || err == PIL_EWOULDBLOCK) && sent > 0)
+                break;
+            else
+                error(err);
+        }
+        else
+        {
+            ++_zeroCopySent;
+        }
+        sent += rc;
+        if (!blocking) break;
+    }
+    return sent;
+#else
+    return sendBytes(buffer, length);
+#endif
+}
+
+
+pi::UInt32 StreamSocketImpl::zeroCopyCompleted(const pi::Timespan& timeout)
+{
+#if PIL_OS == PIL_OS_LINUX
+    if (_zeroCopyCompleted == _zeroCopySent) return _zeroCopyCompleted;
+
+    struct pollfd pfd;
+    pfd.fd      = sockfd();
+    pfd.events  = 0; // POLLERR is always reported
+    pfd.revents = 0;
+    int ms = (int) ((timeout.totalMicroseconds() + 999) / 1000);
+    if (::poll(&pfd, 1, ms) <= 0 || !(pfd.revents & POLLERR))
+        return _zeroCopyCompleted;
+
+    for (;;)
+    {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(sockfd(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break;
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                  (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+                continue;
+
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+            // notifications cover the inclusive range [ee_info, ee_data]
+            _zeroCopyCompleted += err.ee_data - err.ee_info + 1;
+            if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                _zeroCopyCopied = true;
+        }
+    }
+    return _zeroCopyCompleted;
+#else
+    return _zeroCopySent;
+#endif
+}
+
+
 } // namespace pi
@@ -31,11 +31,84 @@ public:
         /// Returns the number of bytes sent. The return value may also be
         /// negative to denote some special condition.
 
+    virtual int sendv(const SocketBufVec& buffers, int flags = 0);
+        /// Ensures that all data in buffers is sent if the socket
+        /// is blocking. In case of a non-blocking socket, sends as
+        /// many bytes as possible.
+        ///
+        /// Returns the number of bytes sent.
+
+    pi::Int64 sendFile(const std::string& path, pi::UInt64 offset = 0, pi::Int64 length = -1);
+        /// Sends length bytes of the given file, starting at offset.
+        /// If length is negative, the file is sent up to its end.
+        ///
+        /// On Linux, the data is moved from the page cache to the
+        /// socket by the kernel with sendfile(), without passing
+        /// through user space. Elsewhere, the file is read in chunks.
+        ///
+        /// Returns the number of bytes sent, which may be less
+        /// than requested if the socket is non-blocking.
+
+    int sendBytesZeroCopy(const void* buffer, int length);
+        /// Sends the buffer with MSG_ZEROCOPY where available, so the
+        /// kernel transmits the pages of the buffer directly instead
+        /// of copying them. Buffers smaller than ZEROCOPY_THRESHOLD,
+        /// for which pinning the pages costs more than the copy,
+        /// and platforms without MSG_ZEROCOPY use a normal send.
+        ///
+        /// The buffer must neither be modified nor freed until
+        /// zeroCopyCompleted() has caught up with zeroCopySent().
+        ///
+        /// Returns the number of bytes sent, with the same semantics
+        /// as sendBytes().
+
+    pi::UInt32 zeroCopySent() const;
+        /// Returns the number of zero-copy send operations
+        /// issued so far.
+
+    pi::UInt32 zeroCopyCompleted(const pi::Timespan& timeout = pi::Timespan(0));
+        /// Collects the completion notifications of zero-copy sends
+        /// from the socket error queue, waiting up to timeout for
+        /// the first one if sends are outstanding.
+        ///
+        /// Returns the number of completed zero-copy send operations.
+
+    bool zeroCopyCopied() const;
+        /// Returns true if the kernel reported that it had to copy
+        /// the data of a zero-copy send anyway, e.g. because
+        /// the peer is on the loopback interface.
+
+    enum
+    {
+        ZEROCOPY_THRESHOLD = 16384
+    };
+
 protected:
     virtual ~StreamSocketImpl();
+
+private:
+    int        _zeroCopyMode; // 0 untried, 1 enabled, -1 unsupported
+    bool       _zeroCopyCopied;
+    pi::UInt32 _zeroCopySent;
+    pi::UInt32 _zeroCopyCompleted;
 };
 
 
+//
+// inlines
+//
+inline pi::UInt32 StreamSocketImpl::zeroCopySent() const
+{
+    return _zeroCopySent;
+}
+
+
+inline bool StreamSocketImpl::zeroCopyCopied() const
+{
+    return _zeroCopyCopied;
+}
+
+
 } // namespace pi
 
 
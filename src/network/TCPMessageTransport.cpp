@@ -0,0 +1,228 @@
+#include "TCPMessageTransport.h"
+#include "NetException.h"
+#include "base/Debug/ErrorHandler.h"
+
+
+namespace pi {
+
+
+#if defined(MSG_NOSIGNAL)
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+
+TCPMessageTransport::TCPMessageTransport(Role role, const SocketAddress& address, int maxPendingBytes):
+    _role(role),
+    _maxPendingBytes(maxPendingBytes),
+    _port(0),
+    _thread("TCPMessageTransport")
+{
+    if (role == ROLE_SERVER)
+    {
+        _server.bind(address, true);
+        _server.listen();
+        _port = _server.address().port();
+        _reactor.addSocket(_server, this, SocketReactor::EVENT_READ, false);
+    }
+    else
+    {
+        StreamSocket socket(address);
+        _port = socket.address().port();
+        addPeer(socket);
+    }
+    _thread.start(_reactor);
+}
+
+
+TCPMessageTransport::~TCPMessageTransport()
+{
+    try
+    {
+        _reactor.stop();
+        _thread.join();
+
+        for (PeerMap::iterator it = _peers.begin(); it != _peers.end(); ++it)
+        {
+            it->second->socket.close();
+            delete it->second;
+        }
+        _peers.clear();
+        if (_role == ROLE_SERVER) _server.close();
+    }
+    catch (...)
+    {
+        pi_dbg_error("Failed");
+    }
+}
+
+
+int TCPMessageTransport::peers() const
+{
+    FastMutex::ScopedLock lock(_mutex);
+
+    return (int) _peers.size();
+}
+
+
+void TCPMessageTransport::send(const char* frames, int length)
+{
+    FastMutex::ScopedLock lock(_mutex);
+
+    for (PeerMap::iterator it = _peers.begin(); it != _peers.end(); ++it)
+    {
+        Peer* pPeer = it->second;
+        int sent = 0;
+        if (pPeer->output.size() == pPeer->offset)
+        {
+            try
+            {
+                sent = pPeer->socket.sendBytes(frames, length, SEND_FLAGS);
+            }
+            catch (IOException& exc)
+            {
+                if (exc.code() != PIL_EWOULDBLOCK && exc.code() != PIL_EAGAIN)
+                {
+                    // the reactor thread removes the peer
+                    try { pPeer->socket.shutdown(); } catch (pi::Exception&) { }
+                    continue;
+                }
+            }
+            if (sent < 0) sent = 0;
+        }
+        if (sent == length) continue;
+
+        bool wasEmpty = pPeer->output.size() == pPeer->offset;
+        if ((int) (pPeer->output.size() - pPeer->offset) + length - sent > _maxPendingBytes)
+        {
+            // slow subscriber, disconnect instead of buffering without limit
+            try { pPeer->socket.shutdown(); } catch (pi::Exception&) { }
+            continue;
+        }
+        pPeer->output.append(frames + sent, length - sent);
+        if (wasEmpty)
+            _reactor.modifySocket(pPeer->socket, SocketReactor::EVENT_READ | SocketReactor::EVENT_WRITE);
+    }
+}
+
+
+void TCPMessageTransport::onSocketReady(Socket& socket, int events)
+{
+    if (_role == ROLE_SERVER && socket == _server)
+    {
+        try
+        {
+            addPeer(_server.acceptConnection());
+        }
+        catch (pi::Exception& exc)
+        {
+            ErrorHandler::handle(exc);
+        }
+        return;
+    }
+
+    Peer* pPeer = 0;
+    {
+        FastMutex::ScopedLock lock(_mutex);
+
+        PeerMap::iterator it = _peers.find(socket.impl());
+        if (it == _peers.end()) return;
+        pPeer = it->second;
+        if ((events & SocketReactor::EVENT_WRITE) && !flush(pPeer))
+            events |= SocketReactor::EVENT_ERROR;
+    }
+
+    // Peers are only removed by this thread, so pPeer stays valid.
+    if (events & (SocketReactor::EVENT_READ | SocketReactor::EVENT_ERROR | SocketReactor::EVENT_HANGUP))
+        receive(pPeer);
+}
+
+
+void TCPMessageTransport::addPeer(const StreamSocket& socket)
+{
+    StreamSocket ss(socket);
+    ss.setNoDelay(true); // frames are already coalesced by the publisher
+
+    Peer* pPeer = new Peer(ss);
+    {
+        FastMutex::ScopedLock lock(_mutex);
+
+        _peers[ss.impl()] = pPeer;
+    }
+    _reactor.addSocket(ss, this, SocketReactor::EVENT_READ, true);
+}
+
+
+void TCPMessageTransport::removePeer(Peer* pPeer)
+{
+    {
+        FastMutex::ScopedLock lock(_mutex);
+
+        _peers.erase(pPeer->socket.impl());
+    }
+    _reactor.removeSocket(pPeer->socket);
+    pPeer->socket.close();
+    delete pPeer;
+}
+
+
+bool TCPMessageTransport::flush(Peer* pPeer)
+{
+    while (pPeer->offset < pPeer->output.size())
+    {
+        int n = 0;
+        try
+        {
+            n = pPeer->socket.sendBytes(pPeer->output.data() + pPeer->offset, (int) (pPeer->output.size() - pPeer->offset), SEND_FLAGS);
+        }
+        catch (IOException& exc)
+        {
+            return exc.code() == PIL_EWOULDBLOCK || exc.code() == PIL_EAGAIN;
+        }
+        if (n <= 0) return true;
+        pPeer->offset += n;
+    }
+    pPeer->output.clear();
+    pPeer->offset = 0;
+    _reactor.modifySocket(pPeer->socket, SocketReactor::EVENT_READ);
+    return true;
+}
+
+
+void TCPMessageTransport::receive(Peer* pPeer)
+{
+    char buffer[65536];
+    for (;;)
+    {
+        int n;
+        try
+        {
+            n = pPeer->socket.receiveBytes(buffer, sizeof(buffer));
+        }
+        catch (pi::Exception&)
+        {
+            n = 0;
+        }
+        if (n < 0) return; // would block, wait for the next edge
+        if (n == 0) break;
+
+        try
+        {
+            pPeer->reader.feed(buffer, n);
+            const char* frame;
+            int length;
+            while (pPeer->reader.next(frame, length))
+                deliver(frame, length);
+        }
+        catch (pi::Exception& exc)
+        {
+            ErrorHandler::handle(exc);
+            break;
+        }
+    }
+    removePeer(pPeer);
+}
+
+
+} // namespace pi
@@ -0,0 +1,110 @@
+#ifndef Net_TCPMessageTransport_INCLUDED
+#define Net_TCPMessageTransport_INCLUDED
+
+
+#include "Net.h"
+#include "MessageTransport.h"
+#include "MessageFrame.h"
+#include "SocketReactor.h"
+#include "ServerSocket.h"
+#include "StreamSocket.h"
+#include "base/Thread/Thread.h"
+#include <map>
+
+
+namespace pi {
+
+
+class PIL_API TCPMessageTransport: public MessageTransport, private SocketEventHandler
+    /// A MessageTransport over TCP connections.
+    ///
+    /// In the server role, the transport listens on the given
+    /// address and sends every frame to all connected peers. In
+    /// the client role, it connects to a server. Frames received
+    /// from any peer are delivered to the listener. A publisher
+    /// usually runs the server and its subscribers connect as
+    /// clients, but both directions work in both roles.
+    ///
+    /// All sockets are non-blocking and served by one SocketReactor
+    /// thread. send() writes directly to the sockets and only queues
+    /// what the kernel does not accept immediately. A peer whose
+    /// queue exceeds maxPendingBytes is disconnected, so one slow
+    /// subscriber cannot stall the publisher.
+    ///
+    /// A client does not reconnect if the connection is lost.
+{
+public:
+    enum Role
+    {
+        ROLE_SERVER,
+        ROLE_CLIENT
+    };
+
+    TCPMessageTransport(Role role, const SocketAddress& address, int maxPendingBytes = 16*1024*1024);
+        /// Creates the transport, either listening on or
+        /// connecting to the given address, and starts its
+        /// reactor thread.
+
+    ~TCPMessageTransport();
+        /// Closes all connections and stops the reactor thread.
+
+    void send(const char* frames, int length);
+
+    int peers() const;
+        /// Returns the number of connected peers.
+
+    pi::UInt16 port() const;
+        /// Returns the port the server listens on, or the local
+        /// port of the client connection.
+
+    Role role() const;
+        /// Returns the role of the transport.
+
+private:
+    struct Peer
+    {
+        Peer(const StreamSocket& s): socket(s), offset(0) {}
+
+        StreamSocket       socket;
+        MessageFrameReader reader;
+        std::string        output;
+        std::size_t        offset;
+    };
+    typedef std::map<SocketImpl*, Peer*> PeerMap;
+
+    void onSocketReady(Socket& socket, int events);
+    void addPeer(const StreamSocket& socket);
+    void removePeer(Peer* pPeer);
+    bool flush(Peer* pPeer);
+    void receive(Peer* pPeer);
+
+    Role                  _role;
+    int                   _maxPendingBytes;
+    pi::UInt16            _port;
+    ServerSocket          _server;
+    SocketReactor         _reactor;
+    pi::Thread            _thread;
+    PeerMap               _peers;
+    mutable pi::FastMutex _mutex;
+};
+
+
+//
+// inlines
+//
+inline pi::UInt16 TCPMessageTransport::port() const
+{
+    return _port;
+}
+
+
+inline TCPMessageTransport::Role TCPMessageTransport::role() const
+{
+    return _role;
+}
+
+
+} // namespace pi
+
+
+#endif // Net_TCPMessageTransport_INCLUDED
@@ -0,0 +1,196 @@
+#include "TCPReactorConnection.h"
+#include "TCPReactorServer.h"
+#include "NetException.h"
+#include "base/Debug/ErrorHandler.h"
+
+
+namespace pi {
+
+
+#if defined(MSG_NOSIGNAL)
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+
+TCPReactorConnection::TCPReactorConnection(const StreamSocket& socket):
+    _socket(socket),
+    _pServer(0),
+    _pReactor(0),
+    _shard(0),
+    _outputOffset(0),
+    _closing(false),
+    _closed(false)
+{
+}
+
+
+TCPReactorConnection::~TCPReactorConnection()
+{
+}
+
+
+void TCPReactorConnection::onOpen()
+{
+}
+
+
+void TCPReactorConnection::onClose()
+{
+}
+
+
+void TCPReactorConnection::attach(TCPReactorServer* pServer, SocketReactor* pReactor, int shard)
+{
+    _pServer  = pServer;
+    _pReactor = pReactor;
+    _shard    = shard;
+}
+
+
+int TCPReactorConnection::send(const void* buffer, int length)
+{
+    if (_closed || _closing || length <= 0) return 0;
+
+    int sent = 0;
+    if (pendingBytes() == 0)
+    {
+        try
+        {
+            sent = _socket.sendBytes(buffer, length, SEND_FLAGS);
+        }
+        catch (IOException& exc)
+        {
+            if (exc.code() != PIL_EWOULDBLOCK && exc.code() != PIL_EAGAIN)
+            {
+                teardown();
+                return 0;
+            }
+        }
+        if (sent < 0) sent = 0;
+    }
+    if (sent < length)
+    {
+        bool wasEmpty = pendingBytes() == 0;
+        _output.append(static_cast<const char*>(buffer) + sent, length - sent);
+        if (wasEmpty)
+            _pReactor->modifySocket(_socket, SocketReactor::EVENT_READ | SocketReactor::EVENT_WRITE);
+    }
+    return sent;
+}
+
+
+void TCPReactorConnection::close()
+{
+    if (_closed) return;
+
+    if (pendingBytes() == 0)
+        teardown();
+    else
+        _closing = true;
+}
+
+
+bool TCPReactorConnection::flush()
+{
+    while (pendingBytes() > 0)
+    {
+        int n = 0;
+        try
+        {
+            n = _socket.sendBytes(_output.data() + _outputOffset, pendingBytes(), SEND_FLAGS);
+        }
+        catch (IOException& exc)
+        {
+            if (exc.code() == PIL_EWOULDBLOCK || exc.code() == PIL_EAGAIN)
+                return false;
+            teardown();
+            return false;
+        }
+        if (n <= 0) return false;
+        _outputOffset += n;
+    }
+
+    _output.clear();
+    _outputOffset = 0;
+    if (_closing)
+        teardown();
+    else
+        _pReactor->modifySocket(_socket, SocketReactor::EVENT_READ);
+    return true;
+}
+
+
+void TCPReactorConnection::teardown()
+{
+    if (_closed) return;
+    _closed = true;
+
+    _pReactor->removeSocket(_socket);
+    try
+    {
+        onClose();
+    }
+    catch (pi::Exception& exc)
+    {
+        ErrorHandler::handle(exc);
+    }
+    catch (std::exception& exc)
+    {
+        ErrorHandler::handle(exc);
+    }
+    _socket.close();
+}
+
+
+void TCPReactorConnection::onSocketReady(Socket& /*socket*/, int events)
+{
+    if ((events & SocketReactor::EVENT_WRITE) && pendingBytes() > 0)
+        flush();
+
+    if (events & (SocketReactor::EVENT_READ | SocketReactor::EVENT_ERROR | SocketReactor::EVENT_HANGUP))
+    {
+        char buffer[16384];
+        while (!_closed)
+        {
+            int n;
+            try
+            {
+                n = _socket.receiveBytes(buffer, sizeof(buffer));
+            }
+            catch (pi::Exception&)
+            {
+                teardown();
+                break;
+            }
+            if (n < 0) break; // would block, wait for the next edge
+
+            if (n == 0)
+            {
+                teardown(); // graceful shutdown by the peer
+                break;
+            }
+
+            try
+            {
+                onData(buffer, n);
+            }
+            catch (pi::Exception& exc)
+            {
+                ErrorHandler::handle(exc);
+                teardown();
+            }
+            catch (std::exception& exc)
+            {
+                ErrorHandler::handle(exc);
+                teardown();
+            }
+        }
+    }
+
+    if (_closed) _pServer->connectionClosed(this); // deletes this
+}
+
+
+} // namespace pi
@@ -0,0 +1,128 @@
+#ifndef Net_TCPReactorConnection_INCLUDED
+#define Net_TCPReactorConnection_INCLUDED
+
+
+#include "Net.h"
+#include "StreamSocket.h"
+#include "SocketReactor.h"
+#include <string>
+
+
+namespace pi {
+
+
+class TCPReactorServer;
+
+
+class PIL_API TCPReactorConnection: public SocketEventHandler
+    /// The abstract base class for non-blocking TCP server
+    /// connections created by TCPReactorServer.
+    ///
+    /// In contrast to TCPServerConnection, a TCPReactorConnection
+    /// does not own a thread. It is a state machine driven by the
+    /// SocketReactor of one of the server's reactor threads:
+    /// onData() is called whenever data has arrived and must
+    /// return without blocking. Thus, a few reactor threads can
+    /// serve any number of (mostly idle) connections.
+    ///
+    /// Derived classes must override onData(). Furthermore, a
+    /// TCPReactorConnectionFactory must be provided for the subclass.
+    ///
+    /// All methods must be called from the reactor thread, i.e.
+    /// from within onOpen(), onData() or onClose().
+{
+public:
+    TCPReactorConnection(const StreamSocket& socket);
+        /// Creates the TCPReactorConnection using the given
+        /// stream socket.
+
+    virtual ~TCPReactorConnection();
+        /// Destroys the TCPReactorConnection.
+
+    int send(const void* buffer, int length);
+        /// Sends the contents of the given buffer to the peer.
+        ///
+        /// Sends as much as possible immediately and queues the
+        /// rest, which is written as soon as the socket becomes
+        /// writable again. Never blocks.
+        ///
+        /// Returns the number of bytes sent immediately.
+
+    void close();
+        /// Closes the connection as soon as all queued data has
+        /// been sent. The connection object is deleted afterwards.
+
+    int pendingBytes() const;
+        /// Returns the number of bytes queued for sending.
+
+protected:
+    virtual void onOpen();
+        /// Called after the connection has been accepted and
+        /// registered with the reactor.
+        ///
+        /// The default implementation does nothing.
+
+    virtual void onData(const char* data, int length) = 0;
+        /// Called when length bytes have been received.
+
+    virtual void onClose();
+        /// Called before the connection is closed, either because
+        /// close() was called, the peer has shut down the connection
+        /// or an error occurred.
+        ///
+        /// The default implementation does nothing.
+
+    StreamSocket& socket();
+        /// Returns a reference to the underlying socket.
+
+    SocketReactor& reactor();
+        /// Returns the reactor driving this connection.
+
+private:
+    TCPReactorConnection();
+    TCPReactorConnection(const TCPReactorConnection&);
+    TCPReactorConnection& operator = (const TCPReactorConnection&);
+
+    void onSocketReady(Socket& socket, int events);
+    void attach(TCPReactorServer* pServer, SocketReactor* pReactor, int shard);
+    bool flush();
+    void teardown();
+
+    StreamSocket      _socket;
+    TCPReactorServer* _pServer;
+    SocketReactor*    _pReactor;
+    int               _shard;
+    std::string       _output;
+    size_t            _outputOffset;
+    bool              _closing;
+    bool              _closed;
+
+    friend class TCPReactorServer;
+};
+
+
+//
+// inlines
+//
+inline StreamSocket& TCPReactorConnection::socket()
+{
+    return _socket;
+}
+
+
+inline SocketReactor& TCPReactorConnection::reactor()
+{
+    return *_pReactor;
+}
+
+
+inline int TCPReactorConnection::pendingBytes() const
+{
+    return (int) (_output.size() - _outputOffset);
+}
+
+
+} // namespace pi
+
+
+#endif // Net_TCPReactorConnection_INCLUDED
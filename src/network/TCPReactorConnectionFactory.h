@@ -0,0 +1,70 @@
+#ifndef Net_TCPReactorConnectionFactory_INCLUDED
+#define Net_TCPReactorConnectionFactory_INCLUDED
+
+
+#include "Net.h"
+#include "TCPReactorConnection.h"
+#include "base/Types/SharedPtr.h"
+
+
+namespace pi {
+
+
+class PIL_API TCPReactorConnectionFactory
+    /// A factory for TCPReactorConnection objects.
+    ///
+    /// The TCPReactorServer class uses a TCPReactorConnectionFactory
+    /// to create a connection object for each new connection
+    /// it accepts. The factory is called from the reactor threads,
+    /// so createConnection() must be thread-safe.
+    ///
+    /// The TCPReactorConnectionFactoryImpl template class
+    /// can be used to automatically instantiate a
+    /// TCPReactorConnectionFactory for a given subclass
+    /// of TCPReactorConnection.
+{
+public:
+    typedef pi::SharedPtr<TCPReactorConnectionFactory> Ptr;
+
+    virtual ~TCPReactorConnectionFactory(){}
+        /// Destroys the TCPReactorConnectionFactory.
+
+    virtual TCPReactorConnection* createConnection(const StreamSocket& socket) = 0;
+        /// Creates an instance of a subclass of TCPReactorConnection,
+        /// using the given StreamSocket.
+
+protected:
+    TCPReactorConnectionFactory(){}
+        /// Creates the TCPReactorConnectionFactory.
+
+private:
+    TCPReactorConnectionFactory(const TCPReactorConnectionFactory&);
+    TCPReactorConnectionFactory& operator = (const TCPReactorConnectionFactory&);
+};
+
+
+template <class S>
+class TCPReactorConnectionFactoryImpl: public TCPReactorConnectionFactory
+    /// This template provides a basic implementation of
+    /// TCPReactorConnectionFactory.
+{
+public:
+    TCPReactorConnectionFactoryImpl()
+    {
+    }
+
+    ~TCPReactorConnectionFactoryImpl()
+    {
+    }
+
+    TCPReactorConnection* createConnection(const StreamSocket& socket)
+    {
+        return new S(socket);
+    }
+};
+
+
+} // namespace pi
+
+
+#endif // Net_TCPReactorConnectionFactory_INCLUDED
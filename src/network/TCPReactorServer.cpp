@@ -0,0 +1,231 @@
+#include "TCPReactorServer.h"
+#include "SocketReactor.h"
+#include "base/Thread/Thread.h"
+#include "base/Debug/ErrorHandler.h"
+#include "base/Utils/Environment.h"
+#include <set>
+
+
+namespace pi {
+
+
+class TCPReactorServer::Shard: public SocketEventHandler
+    /// One reactor thread of the TCPReactorServer
+    /// together with its listening socket.
+{
+public:
+    Shard(TCPReactorServer* pServer, int index, const ServerSocket& listener):
+        listener(listener),
+        thread("TCPReactorServer"),
+        index(index),
+        _pServer(pServer)
+    {
+        reactor.addSocket(listener, this, SocketReactor::EVENT_READ, false);
+    }
+
+    void onSocketReady(Socket& /*socket*/, int /*events*/)
+    {
+        _pServer->accept(index, listener);
+    }
+
+    SocketReactor                   reactor;
+    ServerSocket                    listener;
+    pi::Thread                      thread;
+    std::set<TCPReactorConnection*> connections;
+    int                             index;
+
+private:
+    TCPReactorServer* _pServer;
+};
+
+
+TCPReactorServer::TCPReactorServer(TCPReactorConnectionFactory::Ptr pFactory, pi::UInt16 portNumber, int threads):
+    _pFactory(pFactory),
+    _sharded(false),
+    _stopped(true),
+    _port(0),
+    _totalConnections(0),
+    _currentConnections(0),
+    _maxConcurrentConnections(0)
+{
+    init(SocketAddress(IPAddress(), portNumber), threads, 64);
+}
+
+
+TCPReactorServer::TCPReactorServer(TCPReactorConnectionFactory::Ptr pFactory, const SocketAddress& address, int threads, int backlog):
+    _pFactory(pFactory),
+    _sharded(false),
+    _stopped(true),
+    _port(0),
+    _totalConnections(0),
+    _currentConnections(0),
+    _maxConcurrentConnections(0)
+{
+    init(address, threads, backlog);
+}
+
+
+TCPReactorServer::~TCPReactorServer()
+{
+    try
+    {
+        stop();
+    }
+    catch (...)
+    {
+        pi_dbg_error("Failed");
+    }
+    for (size_t i = 0; i < _shards.size(); ++i)
+        delete _shards[i];
+}
+
+
+void TCPReactorServer::init(const SocketAddress& address, int threads, int backlog)
+{
+    pi_check_ptr (_pFactory);
+
+    if (threads <= 0) threads = (int) Environment::processorCount();
+    if (threads <= 0) threads = 1;
+
+    // The first listener picks the port, the others join it with SO_REUSEPORT.
+    ServerSocket first(address, backlog);
+    _port    = first.address().port();
+    _sharded = threads > 1 && first.getReusePort();
+
+    for (int i = 0; i < threads; ++i)
+    {
+        ServerSocket listener(first);
+        if (i > 0 && _sharded)
+        {
+            try
+            {
+                listener = ServerSocket(SocketAddress(address.host(), _port), backlog);
+            }
+            catch (pi::Exception&)
+            {
+                _sharded = false;
+            }
+        }
+        _shards.push_back(new Shard(this, i, listener));
+    }
+}
+
+
+void TCPReactorServer::start()
+{
+    pi_assert (_stopped);
+
+    _stopped = false;
+    for (size_t i = 0; i < _shards.size(); ++i)
+        _shards[i]->thread.start(_shards[i]->reactor);
+}
+
+
+void TCPReactorServer::stop()
+{
+    if (!_stopped)
+    {
+        _stopped = true;
+        for (size_t i = 0; i < _shards.size(); ++i)
+            _shards[i]->reactor.stop();
+        for (size_t i = 0; i < _shards.size(); ++i)
+            _shards[i]->thread.join();
+    }
+
+    for (size_t i = 0; i < _shards.size(); ++i)
+    {
+        Shard* pShard = _shards[i];
+        std::set<TCPReactorConnection*> connections;
+        {
+            FastMutex::ScopedLock lock(_mutex);
+            connections.swap(pShard->connections);
+            _currentConnections -= (int) connections.size();
+        }
+        for (std::set<TCPReactorConnection*>::iterator it = connections.begin(); it != connections.end(); ++it)
+        {
+            (*it)->teardown();
+            delete *it;
+        }
+        pShard->reactor.removeSocket(pShard->listener);
+        pShard->listener.close();
+    }
+}
+
+
+void TCPReactorServer::accept(int shard, ServerSocket& listener)
+{
+    StreamSocket ss;
+    try
+    {
+        ss = listener.acceptConnection();
+    }
+    catch (pi::Exception&)
+    {
+        // another reactor thread sharing the listener was faster
+        return;
+    }
+    // enable nodelay per default, like TCPServer does
+    ss.setNoDelay(true);
+
+    Shard* pShard = _shards[shard];
+    TCPReactorConnection* pConnection = _pFactory->createConnection(ss);
+    pConnection->attach(this, &pShard->reactor, shard);
+    {
+        FastMutex::ScopedLock lock(_mutex);
+        pShard->connections.insert(pConnection);
+        ++_totalConnections;
+        ++_currentConnections;
+        if (_currentConnections > _maxConcurrentConnections)
+            _maxConcurrentConnections = _currentConnections;
+    }
+
+    try
+    {
+        pShard->reactor.addSocket(ss, pConnection, SocketReactor::EVENT_READ, true);
+        pConnection->onOpen();
+    }
+    catch (pi::Exception& exc)
+    {
+        ErrorHandler::handle(exc);
+        pConnection->teardown();
+    }
+    if (pConnection->_closed) connectionClosed(pConnection);
+}
+
+
+void TCPReactorServer::connectionClosed(TCPReactorConnection* pConnection)
+{
+    {
+        FastMutex::ScopedLock lock(_mutex);
+        if (_shards[pConnection->_shard]->connections.erase(pConnection))
+            --_currentConnections;
+    }
+    delete pConnection;
+}
+
+
+int TCPReactorServer::totalConnections() const
+{
+    FastMutex::ScopedLock lock(_mutex);
+
+    return _totalConnections;
+}
+
+
+int TCPReactorServer::currentConnections() const
+{
+    FastMutex::ScopedLock lock(_mutex);
+
+    return _currentConnections;
+}
+
+
+int TCPReactorServer::maxConcurrentConnections() const
+{
+    FastMutex::ScopedLock lock(_mutex);
+
+    return _maxConcurrentConnections;
+}
+
+
+} // namespace pi
@@ -0,0 +1,127 @@
+#ifndef Net_TCPReactorServer_INCLUDED
+#define Net_TCPReactorServer_INCLUDED
+
+
+#include "Net.h"
+#include "ServerSocket.h"
+#include "TCPReactorConnectionFactory.h"
+#include "base/Thread/Mutex.h"
+#include <vector>
+
+
+namespace pi {
+
+
+class PIL_API TCPReactorServer
+    /// This class implements an event-driven TCP server.
+    ///
+    /// It is an alternative to TCPServer for servers with many
+    /// mostly idle connections. Instead of running one blocking
+    /// TCPServerConnection per pooled thread, TCPReactorServer runs
+    /// a fixed number of reactor threads, each with its own
+    /// SocketReactor, and drives non-blocking TCPReactorConnection
+    /// state machines from them. The number of connections is thus
+    /// independent of the number of threads.
+    ///
+    /// Every reactor thread has its own listening socket bound to
+    /// the same port with SO_REUSEPORT, so the kernel distributes
+    /// incoming connections among the threads. A connection stays
+    /// on the thread that accepted it. If the platform does not
+    /// support SO_REUSEPORT, all threads share one listening socket.
+    ///
+    /// To stop the server, call stop() or destroy it. All open
+    /// connections are closed then.
+{
+public:
+    TCPReactorServer(TCPReactorConnectionFactory::Ptr pFactory, pi::UInt16 portNumber = 0, int threads = 0);
+        /// Creates the TCPReactorServer, listening on the given port
+        /// of all interfaces. Default port is zero, allowing any
+        /// available port. The port number can be queried through
+        /// TCPReactorServer::port().
+        ///
+        /// If threads is zero, one reactor thread per processor
+        /// is used.
+
+    TCPReactorServer(TCPReactorConnectionFactory::Ptr pFactory, const SocketAddress& address, int threads = 0, int backlog = 64);
+        /// Creates the TCPReactorServer, listening on the given address.
+
+    ~TCPReactorServer();
+        /// Destroys the TCPReactorServer and closes all connections.
+
+    void start();
+        /// Starts the reactor threads. The call returns immediately.
+
+    void stop();
+        /// Stops the reactor threads and closes all connections.
+        ///
+        /// Once the server has been stopped, it cannot be restarted.
+
+    int threads() const;
+        /// Returns the number of reactor threads.
+
+    int totalConnections() const;
+        /// Returns the total number of handled connections.
+
+    int currentConnections() const;
+        /// Returns the number of currently open connections.
+
+    int maxConcurrentConnections() const;
+        /// Returns the maximum number of concurrently open connections.
+
+    bool sharded() const;
+        /// Returns true iff every reactor thread has its own
+        /// SO_REUSEPORT listening socket.
+
+    pi::UInt16 port() const;
+        /// Returns the port the server listens on.
+
+private:
+    TCPReactorServer();
+    TCPReactorServer(const TCPReactorServer&);
+    TCPReactorServer& operator = (const TCPReactorServer&);
+
+    class Shard;
+
+    void init(const SocketAddress& address, int threads, int backlog);
+    void accept(int shard, ServerSocket& listener);
+    void connectionClosed(TCPReactorConnection* pConnection);
+
+    TCPReactorConnectionFactory::Ptr _pFactory;
+    std::vector<Shard*>   _shards;
+    bool                  _sharded;
+    bool                  _stopped;
+    pi::UInt16            _port;
+    int                   _totalConnections;
+    int                   _currentConnections;
+    int                   _maxConcurrentConnections;
+    mutable pi::FastMutex _mutex;
+
+    friend class TCPReactorConnection;
+};
+
+
+//
+// inlines
+//
+inline int TCPReactorServer::threads() const
+{
+    return (int) _shards.size();
+}
+
+
+inline bool TCPReactorServer::sharded() const
+{
+    return _sharded;
+}
+
+
+inline pi::UInt16 TCPReactorServer::port() const
+{
+    return _port;
+}
+
+
+} // namespace pi
+
+
+#endif // Net_TCPReactorServer_INCLUDED
@@ -0,0 +1,84 @@
+#ifndef Net_TopicStatistics_INCLUDED
+#define Net_TopicStatistics_INCLUDED
+
+
+#include "Net.h"
+#include "base/Time/Timestamp.h"
+
+
+namespace pi {
+
+
+class TopicStatistics
+    /// Throughput and latency counters of one topic of a
+    /// MessagePublisher or MessageSubscriber.
+{
+public:
+    TopicStatistics():
+        messages(0),
+        bytes(0),
+        dropped(0),
+        queued(0),
+        latencySum(0),
+        latencyMax(0),
+        delivered(0),
+        firstTime(0),
+        lastTime(0)
+    {
+    }
+
+    pi::Int64 messages;   ///< messages published or received
+    pi::Int64 bytes;      ///< payload bytes published or received
+    pi::Int64 dropped;    ///< messages dropped because the queue was full
+    pi::Int64 queued;     ///< messages waiting for dispatch
+    pi::Int64 latencySum; ///< sum of publish-to-dispatch latencies [us]
+    pi::Int64 latencyMax; ///< maximum publish-to-dispatch latency [us]
+    pi::Int64 delivered;  ///< messages passed to the handler
+    pi::Int64 firstTime;  ///< time of the first message [us since epoch]
+    pi::Int64 lastTime;   ///< time of the last message [us since epoch]
+
+    void count(pi::Int64 payloadBytes)
+        /// Counts a message published or received now.
+    {
+        lastTime = pi::Timestamp().epochMicroseconds();
+        if (messages == 0) firstTime = lastTime;
+        ++messages;
+        bytes += payloadBytes;
+    }
+
+    void countDelivery(pi::Int64 latency)
+        /// Counts a message passed to the handler with the
+        /// given latency in microseconds.
+    {
+        ++delivered;
+        latencySum += latency;
+        if (latency > latencyMax) latencyMax = latency;
+    }
+
+    double messagesPerSecond() const
+        /// Returns the average message rate between the first
+        /// and the last message.
+    {
+        return lastTime > firstTime ? (messages - 1) * 1e6 / (lastTime - firstTime) : 0;
+    }
+
+    double bytesPerSecond() const
+        /// Returns the average payload throughput between the
+        /// first and the last message.
+    {
+        return lastTime > firstTime ? bytes * 1e6 / (lastTime - firstTime) : 0;
+    }
+
+    double averageLatency() const
+        /// Returns the average publish-to-dispatch latency
+        /// in microseconds.
+    {
+        return delivered ? (double) latencySum / delivered : 0;
+    }
+};
+
+
+} // namespace pi
+
+
+#endif // Net_TopicStatistics_INCLUDED